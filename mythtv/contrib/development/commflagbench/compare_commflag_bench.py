@@ -0,0 +1,141 @@
+#!/usr/bin/env python
+# -*- coding: UTF-8 -*-
+#
+# Compares the output of two "mythcommflag --benchmark" runs, such as
+# before and after a change.  For each method it prints the median
+# frames a second over the runs of each recording, summed over the
+# corpus, the peak memory and the accuracy, for both, side by side.
+#
+# Usage: compare_commflag_bench.py [--files] before.json after.json
+
+import json
+import optparse
+import sys
+
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if not n:
+        return None
+    if n % 2:
+        return values[n // 2]
+    return (values[n // 2 - 1] + values[n // 2]) / 2.0
+
+
+def ratio(num, den):
+    if not den:
+        return None
+    return float(num) / den
+
+
+def load(filename):
+    """The runs which worked, by method, then by file."""
+    runs = {}
+    with open(filename) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            obj = json.loads(line)
+            if obj.get('type') != 'run' or not obj.get('ok'):
+                continue
+            methods = runs.setdefault(obj['method'], {})
+            methods.setdefault(obj['file'], []).append(obj)
+    return runs
+
+
+def stats(runs):
+    """The median speed and the accuracy of the runs of a recording."""
+    first = runs[0]
+    return {
+        'frames': first['frames'],
+        'seconds': median([r['seconds'] for r in runs]),
+        'peak_rss_kb': max(r['peak_rss_kb'] for r in runs),
+        'breaks': first['breaks'],
+        'true_breaks': first['true_breaks'],
+        'matched_breaks': first['matched_breaks'],
+    }
+
+
+def total(files):
+    """Sums the stats of the recordings of a method."""
+    t = {'frames': 0, 'seconds': 0.0, 'peak_rss_kb': 0,
+         'breaks': 0, 'true_breaks': 0, 'matched_breaks': 0}
+    for s in files.values():
+        for key in t:
+            if key == 'peak_rss_kb':
+                t[key] = max(t[key], s[key])
+            else:
+                t[key] += s[key]
+    return t
+
+
+def fmt(value, spec):
+    if value is None:
+        return '-'
+    return spec % value
+
+
+def row(name, before, after):
+    def fps(s):
+        return ratio(s['frames'], s['seconds']) if s else None
+
+    def precision(s):
+        return ratio(s['matched_breaks'], s['breaks']) if s else None
+
+    def recall(s):
+        return ratio(s['matched_breaks'], s['true_breaks']) if s else None
+
+    def rss(s):
+        return s['peak_rss_kb'] / 1024.0 if s else None
+
+    change = None
+    if fps(before) and fps(after):
+        change = (fps(after) / fps(before) - 1.0) * 100.0
+
+    print('%-30s %9s %9s %7s  %7s %7s  %5s %5s  %5s %5s' % (
+        name[-30:],
+        fmt(fps(before), '%.1f'), fmt(fps(after), '%.1f'),
+        fmt(change, '%+.1f%%'),
+        fmt(rss(before), '%.0f'), fmt(rss(after), '%.0f'),
+        fmt(precision(before), '%.2f'), fmt(precision(after), '%.2f'),
+        fmt(recall(before), '%.2f'), fmt(recall(after), '%.2f')))
+
+
+def main():
+    parser = optparse.OptionParser(
+        usage='%prog [--files] before.json after.json')
+    parser.add_option('--files', action='store_true', default=False,
+                      help='compare each recording too')
+    opts, args = parser.parse_args()
+    if len(args) != 2:
+        parser.error('expected two benchmark outputs')
+
+    before = load(args[0])
+    after = load(args[1])
+
+    print('%-30s %9s %9s %7s  %7s %7s  %5s %5s  %5s %5s' % (
+        '', 'fps', '', '', 'MB', '', 'prec', '', 'recall', ''))
+    for method in sorted(set(before) | set(after)):
+        b = dict((f, stats(r)) for f, r in before.get(method, {}).items())
+        a = dict((f, stats(r)) for f, r in after.get(method, {}).items())
+
+        # only the recordings both flagged are comparable
+        common = set(b) & set(a)
+        if not common:
+            print('%s: no recording was flagged by both' % method)
+            continue
+        row(method,
+            total(dict((f, b[f]) for f in common)),
+            total(dict((f, a[f]) for f in common)))
+
+        if opts.files:
+            for f in sorted(common):
+                row('  ' + f.split('/')[-1], b[f], a[f])
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,259 @@
+#!/usr/bin/env python
+# -*- coding: UTF-8 -*-
+#
+# Writes SQL for a synthetic scheduler fixture to stdout, for use with
+# "mythbackend --benchsched".  Scale 1 is about the size of a large
+# real setup: 600 channels on 2 sources, two weeks of guide data and
+# 300 recording rules.  Everything grows with the scale, so 10 and 100
+# give something to measure how the scheduler copes with growth.
+#
+# All times are relative to UTC_TIMESTAMP() when the SQL is loaded, so
+# a fixture can be generated once and loaded again on any day.  The
+# same scale and seed always give the same SQL.
+#
+# Usage: gen_sched_fixture.py [--scale N] [--days N] [--seed N] | mysql ...
+
+import optparse
+import random
+import sys
+
+CHANNELS_PER_SOURCE = 300
+CHANNELS_PER_MPLEX  = 6
+BATCH = 500
+
+GENRES = ['Drama', 'Comedy', 'News', 'Sports', 'Documentary', 'Children',
+          'Reality', 'Movie', 'Talk', 'Music']
+WORDS = ['Night', 'City', 'Blue', 'Garden', 'Court', 'Kitchen', 'Island',
+         'Doctor', 'Family', 'River', 'Station', 'Empire', 'Harbour', 'Wild',
+         'Summer', 'House', 'Line', 'Street', 'Lost', 'Secret', 'Royal',
+         'Road', 'Star', 'Ocean', 'Mountain', 'Crime', 'Money', 'Game']
+
+
+def quote(s):
+    return "'" + s.replace('\\', '\\\\').replace("'", "\\'") + "'"
+
+
+def at(minutes):
+    return '@base + INTERVAL %d MINUTE' % minutes
+
+
+class Inserter(object):
+    """Writes rows as multi-row INSERTs of at most BATCH rows."""
+
+    def __init__(self, out, table, columns):
+        self.out = out
+        self.head = 'INSERT INTO %s (%s) VALUES\n' % (table, ', '.join(columns))
+        self.rows = []
+
+    def add(self, *values):
+        self.rows.append('(' + ', '.join(str(v) for v in values) + ')')
+        if len(self.rows) >= BATCH:
+            self.flush()
+
+    def flush(self):
+        if self.rows:
+            self.out.write(self.head + ',\n'.join(self.rows) + ';\n')
+            self.rows = []
+
+
+class Show(object):
+    def __init__(self, rnd, num):
+        self.num = num
+        self.title = '%s %s %d' % (rnd.choice(WORDS), rnd.choice(WORDS), num)
+        self.seriesid = 'SH%08d' % num
+        self.category = rnd.choice(GENRES)
+        self.length = rnd.choice([30, 30, 60, 60, 60, 90, 120])
+        self.episodes = rnd.randint(5, 120)
+        self.airings = []       # (chanid, callsign, start minute, episode)
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] > fixture.sql')
+    parser.add_option('--scale', type='int', default=1,
+                      help='size relative to a large real setup [%default]')
+    parser.add_option('--days', type='int', default=14,
+                      help='days of guide data from today [%default]')
+    parser.add_option('--seed', type='int', default=1,
+                      help='random seed [%default]')
+    parser.add_option('--hostname', default='schedbench',
+                      help='hostname of the inputs [%default]')
+    opts, args = parser.parse_args()
+
+    rnd = random.Random(opts.seed)
+    out = sys.stdout
+
+    nchannels = 600 * opts.scale
+    nsources = max(1, nchannels // CHANNELS_PER_SOURCE)
+    nrules = 300 * opts.scale
+    nshows = 8 * nchannels
+
+    out.write('-- schedbench fixture: scale %d, %d days, seed %d\n'
+              % (opts.scale, opts.days, opts.seed))
+    out.write("SET @base = DATE_FORMAT(UTC_TIMESTAMP(), '%Y-%m-%d 00:00:00');\n")
+    for table in ['videosource', 'capturecard', 'channel', 'program',
+                  'programgenres', 'credits', 'record', 'recordmatch',
+                  'oldrecorded', 'recorded', 'powerpriority']:
+        out.write('DELETE FROM %s;\n' % table)
+
+    # Sources, each with 3 tuners of 2 inputs which record at once
+    src = Inserter(out, 'videosource', ['sourceid', 'name', 'xmltvgrabber'])
+    cards = Inserter(out, 'capturecard',
+                     ['cardid', 'parentid', 'videodevice', 'cardtype',
+                      'hostname', 'inputname', 'sourceid', 'displayname',
+                      'schedorder', 'livetvorder', 'reclimit'])
+    cardid = 0
+    for sourceid in range(1, nsources + 1):
+        src.add(sourceid, quote('Source %d' % sourceid), quote('schedulesdirect1'))
+        for tuner in range(3):
+            cardid += 1
+            parent = cardid
+            cards.add(cardid, 0, quote('1010%04X-%d' % (sourceid, tuner)),
+                      quote('HDHOMERUN'), quote(opts.hostname),
+                      quote('MPEG2TS'), sourceid,
+                      quote('S%dT%d' % (sourceid, tuner)), cardid, cardid, 2)
+            cardid += 1
+            cards.add(cardid, parent, quote('1010%04X-%d' % (sourceid, tuner)),
+                      quote('HDHOMERUN'), quote(opts.hostname),
+                      quote('MPEG2TS'), sourceid,
+                      quote('S%dT%dV' % (sourceid, tuner)), cardid, cardid, 2)
+    src.flush()
+    cards.flush()
+
+    # Channels, a few of them hidden
+    chans = Inserter(out, 'channel',
+                     ['chanid', 'channum', 'sourceid', 'callsign', 'name',
+                      'xmltvid', 'visible', 'mplexid', 'last_record'])
+    channels = []
+    for i in range(nchannels):
+        sourceid = i // CHANNELS_PER_SOURCE + 1
+        num = i % CHANNELS_PER_SOURCE + 1
+        chanid = sourceid * 10000 + num
+        callsign = 'C%dS%d' % (num, sourceid)
+        visible = 0 if rnd.random() < 0.05 else 1
+        mplexid = i // CHANNELS_PER_MPLEX + 1
+        chans.add(chanid, quote(str(num)), sourceid, quote(callsign),
+                  quote('Channel %d' % num), quote('I%d.example' % chanid),
+                  visible, mplexid, "'0000-00-00 00:00:00'")
+        channels.append((chanid, callsign))
+    chans.flush()
+
+    # Guide data, each channel showing a handful of the shows, some of
+    # which are also shown on other channels
+    shows = [Show(rnd, n + 1) for n in range(nshows)]
+    progs = Inserter(out, 'program',
+                     ['chanid', 'starttime', 'endtime', 'title', 'subtitle',
+                      'description', 'category', 'seriesid', 'programid',
+                      'originalairdate', 'previouslyshown', 'generic',
+                      'audioprop', 'subtitletypes', 'videoprop'])
+    genres = Inserter(out, 'programgenres',
+                      ['chanid', 'starttime', 'relevance', 'genre'])
+    for idx, (chanid, callsign) in enumerate(channels):
+        own = shows[idx * 8:idx * 8 + 8]
+        lineup = own + [rnd.choice(shows) for n in range(4)]
+        minute = -6 * 60
+        while minute < opts.days * 24 * 60:
+            show = rnd.choice(lineup)
+            episode = rnd.randint(1, show.episodes)
+            generic = 1 if rnd.random() < 0.02 else 0
+            programid = 'EP%08d%04d' % (show.num, episode)
+            if generic:
+                programid = 'SH%08d0000' % show.num
+            end = minute + show.length
+            progs.add(chanid, at(minute), at(end), quote(show.title),
+                      quote('' if generic else 'Episode %d' % episode),
+                      quote('Episode %d of %s.' % (episode, show.title)),
+                      quote(show.category), quote(show.seriesid),
+                      quote(programid),
+                      "DATE(@base - INTERVAL %d DAY)" % (episode * 7),
+                      1 if rnd.random() < 0.6 else 0, generic,
+                      "''", "''", "''")
+            genres.add(chanid, at(minute), "'0'", quote(show.category))
+            show.airings.append((chanid, callsign, minute, episode))
+            minute = end
+    progs.flush()
+    genres.flush()
+
+    # Recording rules of the usual kinds in the usual proportions
+    cols = ['recordid', 'type', 'chanid', 'starttime', 'startdate',
+            'endtime', 'enddate', 'title', 'description', 'station',
+            'seriesid', 'search', 'recpriority', 'dupmethod', 'dupin',
+            'findday', 'findtime', 'inactive', 'filter', 'inetref',
+            'season', 'episode',
+            'next_record', 'last_record', 'last_delete']
+    rules = Inserter(out, 'record', cols)
+    old = Inserter(out, 'oldrecorded',
+                   ['chanid', 'starttime', 'endtime', 'title', 'subtitle',
+                    'description', 'seriesid', 'programid', 'inetref',
+                    'season', 'episode', 'recordid', 'station', 'rectype', 'duplicate',
+                    'recstatus', 'generic', 'future'])
+    aired = [s for s in shows if s.airings]
+    oldkeys = set()
+    for recordid in range(1, nrules + 1):
+        show = rnd.choice(aired)
+        chanid, callsign, minute, episode = rnd.choice(show.airings)
+        kind = rnd.random()
+        rtype, search, desc, station, chan = 4, 0, '', '', 'NULL'
+        findday, findtime = 0, "'00:00:00'"
+        start, end = minute, minute + show.length
+        if kind < 0.55:
+            pass                                    # all, any channel
+        elif kind < 0.65:
+            station, chan = callsign, chanid        # all, one channel
+        elif kind < 0.72:
+            rtype = 6                               # one
+        elif kind < 0.78:
+            rtype = 1                               # single
+            station, chan = callsign, chanid
+        elif kind < 0.82:
+            rtype = rnd.choice([2, 5])              # daily, weekly
+            station, chan = callsign, chanid
+            findday = 'DAYOFWEEK(%s)' % at(minute)
+            findtime = 'TIME(%s)' % at(minute)
+        elif kind < 0.88:
+            search = 2                              # title search
+            desc = show.title.split(' ', 1)[1]
+        elif kind < 0.94:
+            search = 3                              # keyword search
+            desc = 'Episode %d of' % episode
+        else:
+            search = 1                              # power search
+            desc = ("program.category = %s AND channel.channum < %d"
+                    % (quote(show.category), rnd.randint(10, 200)))
+
+        title = show.title
+        if search:
+            title = '%s (%s)' % (desc[:40], ['', 'Power Search',
+                                             'Title Search',
+                                             'Keyword Search'][search])
+        rules.add(recordid, rtype, chan,
+                  'TIME(%s)' % at(start), 'DATE(%s)' % at(start),
+                  'TIME(%s)' % at(end), 'DATE(%s)' % at(end),
+                  quote(title), quote(desc), quote(station),
+                  quote('' if search else show.seriesid), search,
+                  rnd.choice([0, 0, 0, 1, 2, -1]),
+                  rnd.choice([6, 6, 6, 2, 1]), 15, findday,
+                  findtime, 1 if rnd.random() < 0.03 else 0, 0,
+                  "''", 0, 0, "'0000-00-00 00:00:00'",
+                  "'0000-00-00 00:00:00'", "'0000-00-00 00:00:00'")
+
+        # Half the episodes of a series rule recorded already
+        if rtype != 4 or search:
+            continue
+        for episode in range(1, show.episodes + 1, 2):
+            key = (callsign, show.num, episode)
+            if key in oldkeys:
+                continue
+            oldkeys.add(key)
+            when = -(show.episodes - episode + 1) * 24 * 60 - show.num % 60
+            old.add(chanid, at(when), at(when + show.length),
+                    quote(show.title), quote('Episode %d' % episode),
+                    quote('Episode %d of %s.' % (episode, show.title)),
+                    quote(show.seriesid),
+                    quote('EP%08d%04d' % (show.num, episode)), "''",
+                    0, 0, recordid, quote(callsign), rtype, 1, -3, 0, 0)
+    rules.flush()
+    old.flush()
+
+
+if __name__ == '__main__':
+    main()
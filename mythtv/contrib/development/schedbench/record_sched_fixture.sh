@@ -0,0 +1,56 @@
+#!/bin/sh
+
+# Saves the scheduler's view of a MythTV database as a fixture for
+# "mythbackend --benchsched".  The dates are moved forward by whole
+# weeks when it is loaded, so the guide data still reaches into the
+# future and Weekly rules fall on the same day as when it was saved.
+#
+# Usage: record_sched_fixture.sh [mysql options] database > fixture.sql
+#
+# The fixture holds titles, descriptions and recording history, so look
+# at what is in it before handing it to anyone else.
+
+if [ $# -lt 1 ] ; then
+    echo "Usage: $0 [mysql options] database > fixture.sql" >&2
+    exit 1
+fi
+
+TABLES="videosource capturecard channel program programgenres
+        programrating credits people record oldrecorded recorded
+        powerpriority"
+
+SAVED=`date -u +%Y-%m-%d`
+
+echo "-- schedbench fixture, saved $SAVED"
+echo "SET @shift = (DATEDIFF(UTC_DATE(), '$SAVED') DIV 7) * 7;"
+for t in $TABLES ; do
+    echo "DELETE FROM $t;"
+done
+echo "DELETE FROM recordmatch;"
+
+mysqldump --no-create-info --skip-triggers --skip-add-locks \
+          --extended-insert "$@" $TABLES || exit 1
+
+# Settings the scheduler reads, which are not per host
+mysqldump --no-create-info --skip-triggers --skip-add-locks \
+          --replace --where="hostname IS NULL AND
+              (value LIKE 'Sched%' OR value LIKE '%Priority' OR
+               value LIKE '%Conflict%' OR value = 'DefaultStartOffset')" \
+          "$@" settings || exit 1
+
+cat <<EOF
+UPDATE program SET starttime = starttime + INTERVAL @shift DAY,
+                   endtime = endtime + INTERVAL @shift DAY;
+UPDATE programgenres SET starttime = starttime + INTERVAL @shift DAY;
+UPDATE programrating SET starttime = starttime + INTERVAL @shift DAY;
+UPDATE credits SET starttime = starttime + INTERVAL @shift DAY;
+UPDATE record SET startdate = startdate + INTERVAL @shift DAY,
+                  enddate = enddate + INTERVAL @shift DAY
+    WHERE type IN (1, 7, 8);
+UPDATE oldrecorded SET starttime = starttime + INTERVAL @shift DAY,
+                       endtime = endtime + INTERVAL @shift DAY;
+UPDATE recorded SET starttime = starttime + INTERVAL @shift DAY,
+                    endtime = endtime + INTERVAL @shift DAY,
+                    progstart = progstart + INTERVAL @shift DAY,
+                    progend = progend + INTERVAL @shift DAY;
+EOF
@@ -3236,6 +3236,22 @@ TranscodingStatus ProgramInfo::QueryTranscodeStatus(void) const
     return TRANSCODING_NOT_TRANSCODED;
 }
 
+/// \brief Returns the "commflagged" field in "recorded" table.
+CommFlagStatus ProgramInfo::QueryCommFlagStatus(void) const
+{
+    MSqlQuery query(MSqlQuery::InitCon());
+
+    query.prepare("SELECT commflagged FROM recorded"
+                 " WHERE chanid = :CHANID"
+                 " AND starttime = :STARTTIME ;");
+    query.bindValue(":CHANID", chanid);
+    query.bindValue(":STARTTIME", recstartts);
+
+    if (query.exec() && query.next())
+        return (CommFlagStatus) query.value(0).toUInt();
+    return COMM_FLAG_NOT_FLAGGED;
+}
+
 /** \brief Set "transcoded" field in "recorded" table to "trans".
  *  \note Also sets the FL_TRANSCODED flag if the status is
  *        TRASCODING_COMPLETE and clears it otherwise.
@@ -3737,6 +3753,47 @@ void ProgramInfo::QueryPositionMap(
         posMap[query.value(0).toULongLong()] = query.value(1).toULongLong();
 }
 
+/** \brief Returns the number of position map entries of a type in the
+ *         database, and the largest mark and offset among them.
+ *
+ *  This is enough to tell whether a copy of the position map kept
+ *  elsewhere is still the one in the database, without fetching it.
+ *  \return false if there is no database copy to compare against
+ */
+bool ProgramInfo::QueryPositionMapSummary(
+    MarkTypes type, uint64_t &count,
+    uint64_t &last_mark, uint64_t &last_offset) const
+{
+    count = last_mark = last_offset = 0;
+
+    if (positionMapDBReplacement || !IsRecording())
+        return false;
+
+    MSqlQuery query(MSqlQuery::InitCon());
+    query.prepare("SELECT COUNT(*), MAX(mark), MAX(offset) FROM recordedseek"
+                  " WHERE chanid = :CHANID"
+                  " AND starttime = :STARTTIME"
+                  " AND type = :TYPE ;");
+    query.bindValue(":CHANID", chanid);
+    query.bindValue(":STARTTIME", recstartts);
+    query.bindValue(":TYPE", type);
+
+    if (!query.exec())
+    {
+        MythDB::DBError("QueryPositionMapSummary", query);
+        return false;
+    }
+
+    if (!query.next())
+        return false;
+
+    count       = query.value(0).toULongLong();
+    last_mark   = query.value(1).toULongLong();
+    last_offset = query.value(2).toULongLong();
+
+    return true;
+}
+
 void ProgramInfo::ClearPositionMap(MarkTypes type) const
 {
     if (positionMapDBReplacement)
@@ -3990,6 +4047,116 @@ void ProgramInfo::SavePositionMapDelta(
     }
 }
 
+/** \brief Replaces all of the seek table, the keyframe positions
+ *         by frame as MARK_GOP_BYFRAME and their durations as
+ *         MARK_DURATION_MS, in one transaction.
+ *
+ *  The MARK_KEYFRAME and MARK_GOP_START maps of older recorders are
+ *  deleted with it. The rows are inserted a thousand at a time, so a
+ *  long recording doesn't need a statement bigger than the server's
+ *  max_allowed_packet.
+ *
+ *  \return false if anything failed, the old seek table is kept then
+ */
+bool ProgramInfo::SaveSeekTable(
+    frm_pos_map_t &posMap, frm_pos_map_t &durMap) const
+{
+    if (positionMapDBReplacement)
+    {
+        ClearPositionMap(MARK_KEYFRAME);
+        ClearPositionMap(MARK_GOP_START);
+        SavePositionMap(posMap, MARK_GOP_BYFRAME);
+        SavePositionMap(durMap, MARK_DURATION_MS);
+        return true;
+    }
+
+    QString videoPath;
+    QString table;
+    QString qfields;
+    if (IsVideo())
+    {
+        videoPath = StorageGroup::GetRelativePathname(pathname);
+        table = "filemarkup (filename, type, mark, offset)";
+        // ideally, this should be escaped
+        qfields = QString("('%1',").arg(videoPath);
+    }
+    else if (IsRecording())
+    {
+        table = "recordedseek (chanid, starttime, type, mark, offset)";
+        qfields = QString("(%1,'%2',")
+            .arg(chanid).arg(recstartts.toString(Qt::ISODate));
+    }
+    else
+    {
+        return false;
+    }
+
+    MSqlQuery query(MSqlQuery::InitCon());
+    if (!query.exec("START TRANSACTION;"))
+    {
+        MythDB::DBError("seek table transaction", query);
+        return false;
+    }
+
+    if (IsVideo())
+    {
+        query.prepare("DELETE FROM filemarkup"
+                      " WHERE filename = :PATH"
+                      " AND type IN (:KEYFRAME,:GOPSTART,:GOP,:DURATION);");
+        query.bindValue(":PATH", videoPath);
+    }
+    else
+    {
+        query.prepare("DELETE FROM recordedseek"
+                      " WHERE chanid = :CHANID"
+                      " AND starttime = :STARTTIME"
+                      " AND type IN (:KEYFRAME,:GOPSTART,:GOP,:DURATION);");
+        query.bindValue(":CHANID", chanid);
+        query.bindValue(":STARTTIME", recstartts);
+    }
+    query.bindValue(":KEYFRAME", MARK_KEYFRAME);
+    query.bindValue(":GOPSTART", MARK_GOP_START);
+    query.bindValue(":GOP",      MARK_GOP_BYFRAME);
+    query.bindValue(":DURATION", MARK_DURATION_MS);
+
+    bool ok = query.exec();
+    if (!ok)
+        MythDB::DBError("seek table clear", query);
+
+    const int kRowsPerInsert = 1000;
+    const frm_pos_map_t *maps[2]  = { &posMap, &durMap };
+    const MarkTypes      types[2] = { MARK_GOP_BYFRAME, MARK_DURATION_MS };
+    for (uint i = 0; ok && i < 2; i++)
+    {
+        QString fields = qfields + QString("%1,").arg(types[i]);
+        frm_pos_map_t::const_iterator it = maps[i]->begin();
+        while (ok && it != maps[i]->end())
+        {
+            QStringList q("INSERT INTO ");
+            q << table << " VALUES ";
+            for (int rows = 0; rows < kRowsPerInsert &&
+                     it != maps[i]->end(); ++rows, ++it)
+            {
+                if (rows)
+                    q << ",";
+                q << fields << QString("%1,%2)").arg(it.key()).arg(*it);
+            }
+
+            ok = query.exec(q.join(""));
+            if (!ok)
+                MythDB::DBError("seek table insert", query);
+        }
+    }
+
+    if (!query.exec(ok ? "COMMIT;" : "ROLLBACK;"))
+    {
+        MythDB::DBError("seek table commit", query);
+        ok = false;
+    }
+
+    return ok;
+}
+
 static const char *from_filemarkup_offset_asc =
     "SELECT mark, offset FROM filemarkup"
     " WHERE filename = :PATH"
@@ -485,6 +485,7 @@ class MPUBLIC ProgramInfo
     void SetTitle(const QString &t) { title = t; title.detach(); }
     void SetProgramInfoType(ProgramInfoType t)
         { programflags &= ~FL_TYPEMASK; programflags |= ((uint32_t)t<<20); }
+    void SetProgramFlags(uint32_t flags) { programflags = flags; }
     void SetPathname(const QString&) const;
     void SetChanID(uint _chanid) { chanid = _chanid; }
     void SetScheduledStartTime(const QDateTime &dt) { startts      = dt;    }
@@ -565,6 +566,7 @@ class MPUBLIC ProgramInfo
     bool        QueryIsDeleteCandidate(bool one_player_allowed = false) const;
     AutoExpireType QueryAutoExpire(void) const;
     TranscodingStatus QueryTranscodeStatus(void) const;
+    CommFlagStatus QueryCommFlagStatus(void) const;
     bool        QueryTuningInfo(QString &channum, QString &input) const;
     QString     QueryInputDisplayName(void) const;
     uint        QueryAverageWidth(void) const;
@@ -622,10 +624,15 @@ class MPUBLIC ProgramInfo
 
     // Keyframe positions map
     void QueryPositionMap(frm_pos_map_t &, MarkTypes type) const;
+    bool QueryPositionMapSummary(MarkTypes type, uint64_t &count,
+                                 uint64_t &last_mark,
+                                 uint64_t &last_offset) const;
     void ClearPositionMap(MarkTypes type) const;
     void SavePositionMap(frm_pos_map_t &, MarkTypes type,
                          int64_t min_frm = -1, int64_t max_frm = -1) const;
     void SavePositionMapDelta(frm_pos_map_t &, MarkTypes type) const;
+    bool SaveSeekTable(frm_pos_map_t &posMap,
+                       frm_pos_map_t &durMap) const;
 
     // Get position/duration for keyframe and vice versa
     bool QueryKeyFrameInfo(uint64_t *, uint64_t position_or_keyframe,
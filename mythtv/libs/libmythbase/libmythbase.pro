@@ -30,7 +30,9 @@ HEADERS += plist.h bswap.h signalhandling.h mythtimezone.h mythdate.h
 HEADERS += mythplugin.h mythpluginapi.h housekeeper.h
 HEADERS += ffmpeg-mmx.h
 HEADERS += mythsystemlegacy.h mythtypes.h
-HEADERS += threadedfilewriter.h mythsingledownload.h codecutil.h
+HEADERS += threadedfilewriter.h threadedfilewriterbackend.h
+HEADERS += threadedfilewriterpool.h remotefilestream.h
+HEADERS += mythsingledownload.h codecutil.h
 HEADERS += mythsession.h
 HEADERS += ../../external/qjsonwrapper/qjsonwrapper/Json.h
 HEADERS += cleanupguard.h portchecker.h
@@ -51,7 +53,9 @@ SOURCES += filesysteminfo.cpp hardwareprofile.cpp serverpool.cpp
 SOURCES += plist.cpp signalhandling.cpp mythtimezone.cpp mythdate.cpp
 SOURCES += mythplugin.cpp housekeeper.cpp
 SOURCES += mythsystemlegacy.cpp mythtypes.cpp
-SOURCES += threadedfilewriter.cpp mythsingledownload.cpp codecutil.cpp
+SOURCES += threadedfilewriter.cpp threadedfilewriterbackend.cpp
+SOURCES += threadedfilewriterpool.cpp remotefilestream.cpp
+SOURCES += mythsingledownload.cpp codecutil.cpp
 SOURCES += mythsession.cpp
 SOURCES += ../../external/qjsonwrapper/qjsonwrapper/Json.cpp
 SOURCES += cleanupguard.cpp portchecker.cpp
@@ -83,7 +87,8 @@ inc.files += filesysteminfo.h hardwareprofile.h bonjourregister.h serverpool.h
 inc.files += plist.h bswap.h signalhandling.h ffmpeg-mmx.h mythdate.h
 inc.files += mythplugin.h mythpluginapi.h mythqtcompat.h
 inc.files += remotefile.h mythsystemlegacy.h mythtypes.h
-inc.files += threadedfilewriter.h mythsingledownload.h mythsession.h
+inc.files += threadedfilewriter.h threadedfilewriterpool.h remotefilestream.h
+inc.files += mythsingledownload.h mythsession.h
 
 # Allow both #include <blah.h> and #include <libmythbase/blah.h>
 inc2.path  = $${PREFIX}/include/mythtv/libmythbase
@@ -132,6 +137,11 @@ using_libdns_sd {
     !macx: LIBS += -ldns_sd
 }
 
+using_liburing {
+    DEFINES += USING_LIBURING
+    LIBS += -luring
+}
+
 using_x11:DEFINES += USING_X11
 
 mingw:LIBS += -lws2_32
@@ -1540,9 +1540,10 @@ bool MythCoreContext::CheckProtoVersion(MythSocket *socket, uint timeout_ms,
     if (!socket)
         return false;
 
-    QStringList strlist(QString("MYTH_PROTO_VERSION %1 %2")
+    QStringList strlist(QString("MYTH_PROTO_VERSION %1 %2 %3")
                         .arg(MYTH_PROTO_VERSION)
-                        .arg(QString::fromUtf8(MYTH_PROTO_TOKEN)));
+                        .arg(QString::fromUtf8(MYTH_PROTO_TOKEN))
+                        .arg(MythSocket::kBinaryFramingToken));
     socket->WriteStringList(strlist);
 
     if (!socket->ReadStringList(strlist, timeout_ms) || strlist.empty())
@@ -1573,6 +1574,10 @@ bool MythCoreContext::CheckProtoVersion(MythSocket *socket, uint timeout_ms,
     }
     else if (strlist[0] == "ACCEPT")
     {
+        // only servers that understand the binary framing offer it
+        socket->SetBinaryFraming(
+            strlist.contains(MythSocket::kBinaryFramingToken));
+
         if (!d->m_announcedProtocol)
         {
             d->m_announcedProtocol = true;
@@ -8,6 +8,7 @@
 #include <QHostInfo>
 #include <QThread>
 #include <QMetaType>
+#include <QtEndian>
 
 // setsockopt -- has to be after Qt includes for Q_OS_WIN definition
 #if defined(Q_OS_WIN)
@@ -18,6 +19,7 @@
 #include <sys/socket.h>
 #endif
 #include <unistd.h> // for usleep (and socket code on Q_OS_WIN)
+#include <cstring> // for memcmp
 #include <algorithm> // for min/max
 using std::max;
 using std::min;
@@ -42,6 +44,15 @@ const uint MythSocket::kShortTimeout = kMythSocketShortTimeout;
 const uint MythSocket::kLongTimeout  = kMythSocketLongTimeout;
 
 const int MythSocket::kSocketReceiveBufferSize = 128 * 1024;
+const char *MythSocket::kBinaryFramingToken = "BINARY";
+
+/// Starts a binary frame, where a legacy one has ASCII digits
+static const char kBinaryMagic[4] = { '\xff', 'M', 'B', '\x01' };
+/// Set in a string's length when it is sent as a 64 bit integer
+static const quint32 kIntegerString = 0x80000000;
+/// The largest frame the 8 digits of a legacy size prefix can give,
+/// which binary frames are held to as well
+static const qint64 kMaxFrameSize = 99999999;
 
 QMutex MythSocket::s_loopbackCacheLock;
 QHash<QString, QHostAddress::SpecialAddress> MythSocket::s_loopbackCache;
@@ -79,6 +90,37 @@ static QString to_sample(const QByteArray &payload)
     return sample;
 }
 
+/// True if str is a number that QString::number() gives back unchanged
+static bool to_integer(const QString &str, qint64 &val)
+{
+    int len = str.length();
+    if (len == 0 || len > 18)
+        return false;
+
+    const QChar *c = str.unicode();
+    bool neg = (c[0] == '-');
+    int i = (neg) ? 1 : 0;
+    if (i == len || (c[i] == '0' && (neg || len > 1)))
+        return false;
+
+    qint64 v = 0;
+    for (; i < len; i++)
+    {
+        uint d = c[i].unicode() - '0';
+        if (d > 9)
+            return false;
+        v = v * 10 + d;
+    }
+
+    val = (neg) ? -v : v;
+    return true;
+}
+
+static inline void put_uint32(QByteArray &buf, int offset, quint32 val)
+{
+    qToBigEndian<quint32>(val, (uchar*) buf.data() + offset);
+}
+
 MythSocket::MythSocket(
     qt_socket_fd_t socket, MythSocketCBs *cb, bool use_shared_thread) :
     ReferenceCounter(QString("MythSocket(%1)").arg(socket)),
@@ -89,6 +131,7 @@ MythSocket::MythSocket(
     m_callback(cb),
     m_useSharedThread(use_shared_thread),
     m_disableReadyReadCallback(false),
+    m_binaryFraming(0),
     m_connected(false),
     m_dataAvailable(0),
     m_isValidated(false),
@@ -415,9 +458,10 @@ bool MythSocket::Validate(uint timeout_ms, bool error_dialog_desired)
     if (m_isValidated)
         return true;
 
-    QStringList strlist(QString("MYTH_PROTO_VERSION %1 %2")
+    QStringList strlist(QString("MYTH_PROTO_VERSION %1 %2 %3")
                         .arg(MYTH_PROTO_VERSION)
-                        .arg(QString::fromUtf8(MYTH_PROTO_TOKEN)));
+                        .arg(QString::fromUtf8(MYTH_PROTO_TOKEN))
+                        .arg(kBinaryFramingToken));
 
     WriteStringList(strlist);
 
@@ -452,6 +496,7 @@ bool MythSocket::Validate(uint timeout_ms, bool error_dialog_desired)
         LOG(VB_GENERAL, LOG_NOTICE, QString("Using protocol version %1 %2")
             .arg(MYTH_PROTO_VERSION).arg(QString::fromUtf8(MYTH_PROTO_TOKEN)));
         m_isValidated = true;
+        SetBinaryFraming(strlist.contains(kBinaryFramingToken));
     }
     else
     {
@@ -556,6 +601,28 @@ void MythSocket::Reset(void)
         Qt::BlockingQueuedConnection : Qt::DirectConnection);
 }
 
+/// Raises SO_RCVBUF above kSocketReceiveBufferSize for bulk transfers
+bool MythSocket::SetReceiveBufferSize(int bytes)
+{
+    int fd = GetSocketDescriptor();
+    if (fd < 0)
+        return false;
+
+    int val = max(bytes, kSocketReceiveBufferSize);
+#if defined(Q_OS_WIN)
+    int ret = setsockopt(fd, SOL_SOCKET, SO_RCVBUF,
+                         (char*) &val, sizeof(val));
+#else
+    int ret = setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val));
+#endif
+    if (ret < 0)
+    {
+        LOG(VB_SOCKET, LOG_INFO, LOC + "Failed to set SO_RCVBUF" + ENO);
+        return false;
+    }
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 bool MythSocket::IsConnected(void) const
@@ -714,8 +781,9 @@ void MythSocket::WriteStringListReal(const QStringList *list, bool *ret)
         return;
     }
 
-    QString str = list->join("[]:[]");
-    if (str.isEmpty())
+    bool binary = IsBinaryFraming();
+    QByteArray payload = EncodeStringList(*list, binary);
+    if (payload.isEmpty())
     {
         LOG(VB_GENERAL, LOG_ERR, LOC +
             "WriteStringList: Error, joined null string.");
@@ -723,22 +791,16 @@ void MythSocket::WriteStringListReal(const QStringList *list, bool *ret)
         return;
     }
 
-    QByteArray utf8 = str.toUtf8();
-    int size = utf8.length();
+    int size = payload.length();
     int written = 0;
     int written_since_timer_restart = 0;
 
-    QByteArray payload;
-    payload = payload.setNum(size);
-    payload += "        ";
-    payload.truncate(8);
-    payload += utf8;
-    size = payload.length();
-
     if (VERBOSE_LEVEL_CHECK(VB_NETWORK, LOG_INFO))
     {
         QString msg = QString("write -> %1 %2")
-            .arg(m_tcpSocket->socketDescriptor(), 2).arg(payload.data());
+            .arg(m_tcpSocket->socketDescriptor(), 2)
+            .arg((binary) ? QString("[binary %1 bytes] %2").arg(size)
+                 .arg(list->join("[]:[]")) : QString(payload.data()));
 
         if (logLevel < LOG_DEBUG && msg.length() > 88)
         {
@@ -841,16 +903,28 @@ void MythSocket::ReadStringListReal(
         return;
     }
 
-    QString sizes = sizestr;
-    qint64 btr = sizes.trimmed().toInt();
+    // Only a peer which has agreed to the binary framing may send it
+    bool binary = IsBinaryFraming() &&
+        !memcmp(sizestr.constData(), kBinaryMagic, 4);
+    qint64 btr;
+    if (binary)
+    {
+        btr = qFromBigEndian<quint32>((const uchar*) sizestr.constData() + 4);
+    }
+    else
+    {
+        QString sizes = sizestr;
+        btr = sizes.trimmed().toInt();
+    }
 
-    if (btr < 1)
+    if (btr < 1 || btr > kMaxFrameSize)
     {
         int pending = m_tcpSocket->bytesAvailable();
         LOG(VB_GENERAL, LOG_ERR, LOC +
             QString("Protocol error: '%1' is not a valid size "
                     "prefix. %2 bytes pending.")
-                .arg(sizestr.data()).arg(pending));
+                .arg(binary ? QString::number(btr) : QString(sizestr.data()))
+                .arg(pending));
         ResetReal();
         return;
     }
@@ -927,6 +1001,40 @@ void MythSocket::ReadStringListReal(
         }
     }
 
+    if (binary)
+    {
+        if (!DecodeStringList(utf8.constData(), readoffset, *list))
+        {
+            LOG(VB_GENERAL, LOG_ERR, LOC +
+                QString("Protocol error: invalid binary string list "
+                        "of %1 bytes").arg(readoffset));
+            list->clear();
+            m_dataAvailable.fetchAndStoreOrdered(
+                (m_tcpSocket->bytesAvailable() > 0) ? 1 : 0);
+            return;
+        }
+
+        if (VERBOSE_LEVEL_CHECK(VB_NETWORK, LOG_INFO))
+        {
+            QString msg = QString("read  <- %1 [binary %2 bytes] %3")
+                .arg(m_tcpSocket->socketDescriptor(), 2)
+                .arg(readoffset).arg(list->join("[]:[]"));
+
+            if (logLevel < LOG_DEBUG && msg.length() > 88)
+            {
+                msg.truncate(85);
+                msg += "...";
+            }
+            LOG(VB_NETWORK, LOG_INFO, LOC + msg);
+        }
+
+        m_dataAvailable.fetchAndStoreOrdered(
+            (m_tcpSocket->bytesAvailable() > 0) ? 1 : 0);
+
+        *ret = true;
+        return;
+    }
+
     QString str = QString::fromUtf8(utf8.data());
 
     QByteArray payload;
@@ -957,6 +1065,136 @@ void MythSocket::ReadStringListReal(
     *ret = true;
 }
 
+/** \brief Builds the frame that WriteStringList() sends.
+ *
+ *  The legacy frame is its size in ASCII, padded to 8 bytes, followed
+ *  by the strings joined with "[]:[]" in UTF-8.
+ *
+ *  Once both ends have agreed to it in the MYTH_PROTO_VERSION exchange
+ *  the binary frame is used instead. It starts with kBinaryMagic and
+ *  the size of the rest, then has the number of strings and each string
+ *  with its own length, so the reader neither searches for separators
+ *  nor converts the whole reply at once. A string that is a plain
+ *  decimal number, like most ProgramInfo fields, goes as a 64 bit
+ *  integer. All of these are in network byte order. ReadStringList()
+ *  takes either kind of frame.
+ *
+ *  \return the frame, or an empty one if there is nothing to send
+ */
+QByteArray MythSocket::EncodeStringList(const QStringList &list, bool binary)
+{
+    if (!binary)
+    {
+        QByteArray utf8 = list.join("[]:[]").toUtf8();
+        if (utf8.isEmpty())
+            return QByteArray();
+
+        QByteArray payload;
+        payload = payload.setNum(utf8.length());
+        payload += "        ";
+        payload.truncate(8);
+        payload += utf8;
+        return payload;
+    }
+
+    int estimate = 12;
+    for (int i = 0; i < list.size(); i++)
+        estimate += 4 + list[i].length();
+
+    QByteArray payload;
+    payload.reserve(estimate + estimate / 8);
+    payload.resize(12);
+    memcpy(payload.data(), kBinaryMagic, 4);
+    put_uint32(payload, 8, list.size());
+
+    for (int i = 0; i < list.size(); i++)
+    {
+        const QString &str = list[i];
+        int offset = payload.size();
+
+        qint64 val;
+        if (to_integer(str, val))
+        {
+            payload.resize(offset + 12);
+            put_uint32(payload, offset, kIntegerString);
+            qToBigEndian<qint64>(val, (uchar*) payload.data() + offset + 4);
+            continue;
+        }
+
+        // Copy ASCII as is, anything else goes through toUtf8()
+        int len = str.length();
+        const QChar *c = str.unicode();
+        int j = 0;
+        while (j < len && c[j].unicode() < 0x80)
+            j++;
+
+        if (j == len)
+        {
+            payload.resize(offset + 4 + len);
+            char *p = payload.data() + offset + 4;
+            for (j = 0; j < len; j++)
+                p[j] = (char) c[j].unicode();
+        }
+        else
+        {
+            QByteArray utf8 = str.toUtf8();
+            len = utf8.length();
+            payload.resize(offset + 4);
+            payload += utf8;
+        }
+        put_uint32(payload, offset, len);
+    }
+
+    put_uint32(payload, 4, payload.size() - 8);
+    return payload;
+}
+
+/** \brief Unpacks the part of a binary frame after its size.
+ *  \return false if the data is not a complete string list
+ */
+bool MythSocket::DecodeStringList(const char *data, int size,
+                                  QStringList &list)
+{
+    list.clear();
+
+    const uchar *p = (const uchar*) data;
+    const uchar *end = p + size;
+    if (size < 4)
+        return false;
+
+    quint32 count = qFromBigEndian<quint32>(p);
+    p += 4;
+    // every string takes at least 4 bytes
+    if (count > (quint32) size / 4)
+        return false;
+
+    list.reserve(count);
+    for (quint32 i = 0; i < count; i++)
+    {
+        if (end - p < 4)
+            return false;
+        quint32 len = qFromBigEndian<quint32>(p);
+        p += 4;
+
+        if (len == kIntegerString)
+        {
+            if (end - p < 8)
+                return false;
+            list.push_back(QString::number(qFromBigEndian<qint64>(p)));
+            p += 8;
+        }
+        else
+        {
+            if ((quint32) (end - p) < len)
+                return false;
+            list.push_back(QString::fromUtf8((const char*) p, len));
+            p += len;
+        }
+    }
+
+    return p == end;
+}
+
 void MythSocket::WriteReal(const char *data, int size, int *ret)
 {
     *ret = m_tcpSocket->write(data, size);
@@ -49,6 +49,12 @@ class MBASE_PUBLIC MythSocket : public QObject, public ReferenceCounter
     void SetReadyReadCallbackEnabled(bool enabled)
         { m_disableReadyReadCallback.fetchAndStoreOrdered((enabled) ? 0 : 1); }
 
+    /// Sends string lists in the binary framing, see EncodeStringList()
+    void SetBinaryFraming(bool enabled)
+        { m_binaryFraming.fetchAndStoreOrdered((enabled) ? 1 : 0); }
+    bool IsBinaryFraming(void) const
+        { return m_binaryFraming.testAndSetOrdered(1,1); }
+
     bool SendReceiveStringList(
         QStringList &list, uint min_reply_length = 0,
         uint timeoutMS = kLongTimeout);
@@ -67,10 +73,19 @@ class MBASE_PUBLIC MythSocket : public QObject, public ReferenceCounter
     int Write(const char*, int size);
     int Read(char*, int size, int max_wait_ms);
     void Reset(void);
+    bool SetReceiveBufferSize(int bytes);
 
     static const uint kShortTimeout;
     static const uint kLongTimeout;
 
+    static QByteArray EncodeStringList(const QStringList &list, bool binary);
+    static bool DecodeStringList(const char *data, int size,
+                                 QStringList &list);
+
+    /// Added to MYTH_PROTO_VERSION and its ACCEPT to agree on the
+    /// binary framing
+    static const char *kBinaryFramingToken;
+
   signals:
     void CallReadyRead(void);
 
@@ -105,6 +120,7 @@ class MBASE_PUBLIC MythSocket : public QObject, public ReferenceCounter
     MythSocketCBs  *m_callback; // only set in ctor
     bool            m_useSharedThread; // only set in ctor
     QAtomicInt      m_disableReadyReadCallback;
+    mutable QAtomicInt m_binaryFraming;
     bool            m_connected; // protected by m_lock
     /// This is used internally as a hint that there might be
     /// data available for reading.
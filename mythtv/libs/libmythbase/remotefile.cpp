@@ -25,6 +25,7 @@ using namespace std;
 
 #include "mythdb.h"
 #include "remotefile.h"
+#include "remotefilestream.h"
 #include "mythcorecontext.h"
 #include "mythsocket.h"
 #include "compat.h"
@@ -79,6 +80,7 @@ RemoteFile::RemoteFile(const QString &_path, bool write, bool useRA,
     canresume(false),     recordernum(0),
     lock(QMutex::NonRecursive),
     controlSock(NULL),    sock(NULL),
+    stream(NULL),
     query("QUERY_FILETRANSFER %1"),
     writemode(write),     completed(false),
     localFile(-1),        fileWriter(NULL)
@@ -100,6 +102,8 @@ RemoteFile::RemoteFile(const QString &_path, bool write, bool useRA,
 RemoteFile::~RemoteFile()
 {
     Close();
+    delete stream;
+    stream = NULL;
     if (controlSock)
     {
         controlSock->DecrRef();
@@ -346,6 +350,42 @@ bool RemoteFile::OpenInternal()
     }
     canresume = true;
 
+    if (!writemode && usereadahead)
+        StartStream();
+
+    return true;
+}
+
+/** \fn RemoteFile::StartStream(void)
+ *  \brief Asks the backend to take block requests on the data socket,
+ *         see RemoteFileStream. Must have lock
+ *  \return True if the backend agreed, otherwise Read() keeps using
+ *          REQUEST_BLOCK
+ */
+bool RemoteFile::StartStream(void)
+{
+    uint window = gCoreContext->GetNumSetting(
+        "RemoteFileStreamWindow", RemoteFileStream::kDefaultWindow);
+    if (!window)
+        return false;
+
+    QStringList strlist( QString(query).arg(recordernum) );
+    strlist << "START_STREAM";
+
+    if (!controlSock->SendReceiveStringList(strlist) ||
+        strlist.isEmpty() || strlist[0] != "OK")
+    {
+        LOG(VB_FILE, LOG_INFO, QString("RemoteFile::StartStream(%1): "
+                "Not supported by the server").arg(path));
+        return false;
+    }
+
+    stream = new RemoteFileStream(sock, window);
+
+    LOG(VB_FILE, LOG_INFO, QString("RemoteFile::StartStream(%1): "
+            "%2 requests of %3 KB in flight").arg(path).arg(window)
+            .arg(stream->GetBlockSize() / 1024));
+
     return true;
 }
 
@@ -410,6 +450,9 @@ void RemoteFile::Close(bool haslock)
         LOG(VB_GENERAL, LOG_ERR, "Remote file timeout.");
     }
 
+    delete stream;
+    stream = NULL;
+
     if (sock)
     {
         sock->DecrRef();
@@ -765,7 +808,9 @@ void RemoteFile::Reset(void)
         LOG(VB_NETWORK, LOG_ERR, "RemoteFile::Reset(): Called with no socket");
         return;
     }
-    sock->Reset();
+    // streamed replies are framed, anything on the socket is expected
+    if (!stream)
+        sock->Reset();
 }
 
 long long RemoteFile::Seek(long long pos, int whence, long long curpos)
@@ -822,6 +867,14 @@ long long RemoteFile::SeekInternal(long long pos, int whence, long long curpos)
         return -1;
     }
 
+    if (stream && whence == SEEK_CUR)
+    {
+        // The server has read ahead of us, so it can not work out
+        // where we are
+        pos += (curpos > 0) ? curpos : lastposition;
+        whence = SEEK_SET;
+    }
+
     QStringList strlist( QString(query).arg(recordernum) );
     strlist << "SEEK";
     strlist << QString::number(pos);
@@ -830,13 +883,16 @@ long long RemoteFile::SeekInternal(long long pos, int whence, long long curpos)
         strlist << QString::number(curpos);
     else
         strlist << QString::number(readposition);
+    if (stream)
+        strlist << QString::number(stream->Cancel());
 
     bool ok = controlSock->SendReceiveStringList(strlist);
 
     if (ok && !strlist.isEmpty())
     {
         lastposition = readposition = strlist[0].toLongLong();
-        sock->Reset();
+        if (!stream)
+            sock->Reset();
         return strlist[0].toLongLong();
     }
     else
@@ -979,6 +1035,20 @@ int RemoteFile::Read(void *data, int size)
         return -1;
     }
 
+    if (stream)
+    {
+        recv = stream->Read((char *)data, size, 10000);
+        if (recv < 0)
+        {
+            // Replies may still be on their way, start over
+            LOG(VB_GENERAL, LOG_ERR, "RemoteFile::Read(): Stream failed");
+            Resume();
+            return -1;
+        }
+        lastposition += recv;
+        return recv;
+    }
+
     if (sock->IsDataAvailable())
     {
         LOG(VB_NETWORK, LOG_ERR,
@@ -13,6 +13,7 @@
 class MythSocket;
 class QFile;
 class ThreadedFileWriter;
+class RemoteFileStream;
 
 class MBASE_PUBLIC RemoteFile
 {
@@ -71,6 +72,7 @@ class MBASE_PUBLIC RemoteFile
     bool CheckConnection(bool repos = true);
     bool IsConnected(void);
     bool Resume(bool repos = true);
+    bool StartStream(void);
     long long SeekInternal(long long pos, int whence, long long curpos = -1);
 
     MythSocket     *openSocket(bool control);
@@ -88,6 +90,7 @@ class MBASE_PUBLIC RemoteFile
     mutable QMutex  lock;
     MythSocket     *controlSock;
     MythSocket     *sock;
+    RemoteFileStream *stream;
     QString         query;
 
     bool            writemode;
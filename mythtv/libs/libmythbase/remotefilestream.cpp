@@ -0,0 +1,249 @@
+// -*- Mode: c++ -*-
+
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#include <QtEndian>
+
+#include "remotefilestream.h"
+#include "mythsocket.h"
+#include "mythtimer.h"
+#include "mythlogging.h"
+
+#define LOC QString("RemoteFileStream(%1): ") \
+    .arg(m_sock ? m_sock->GetSocketDescriptor() : -1)
+
+const uint RemoteFileStream::kHeaderSize;
+const uint RemoteFileStream::kDefaultWindow;
+const uint RemoteFileStream::kDefaultBlockSize;
+const uint RemoteFileStream::kMaxBlockSize;
+
+RemoteFileStream::RemoteFileStream(
+    MythSocket *sock, uint window, uint block_size) :
+    m_sock(sock),
+    m_window(max(window, 1U)),
+    m_blockSize(min(max(block_size, 1U), kMaxBlockSize)),
+    m_nextSeq(0), m_fence(0), m_bufferPos(0)
+{
+    // Keep the buffer allocated when it runs empty
+    m_buffer.reserve(m_window * m_blockSize + m_blockSize);
+
+    // MythSocket asks for a fixed receive buffer, which would cap
+    // the data in flight well below the window on a slow link
+    m_sock->SetReceiveBufferSize(m_window * m_blockSize);
+}
+
+/** \brief Reads up to size bytes, sending more requests as needed.
+ *
+ *  \return the number of bytes read, which is less than size only
+ *          at the end of the file, or -1 if the backend reported an
+ *          error or no reply came within timeout_ms
+ */
+int RemoteFileStream::Read(char *data, int size, int timeout_ms)
+{
+    MythTimer timer;
+    timer.start();
+    bool eof = false;
+
+    while ((int)GetBuffered() < size && !eof)
+    {
+        while (m_requests.size() < m_window)
+        {
+            if (!SendRequest())
+                return -1;
+        }
+
+        int left = timeout_ms - timer.elapsed();
+        if (left <= 0)
+        {
+            LOG(VB_NETWORK, LOG_ERR, LOC +
+                QString("Read(%1): No reply after %2 ms")
+                    .arg(size).arg(timeout_ms));
+            return -1;
+        }
+
+        if (ReadReply(eof, left) < 0)
+            return -1;
+    }
+
+    int len = min(size, (int)GetBuffered());
+    memcpy(data, m_buffer.constData() + m_bufferPos, len);
+    m_bufferPos += len;
+
+    if (m_bufferPos == m_buffer.size())
+    {
+        m_buffer.resize(0);
+        m_bufferPos = 0;
+    }
+    else if (m_bufferPos > m_buffer.size() / 2)
+    {
+        // most of it has been read, move the rest to the front
+        m_buffer.remove(0, m_bufferPos);
+        m_bufferPos = 0;
+    }
+
+    return len;
+}
+
+/** \brief Drops the data read ahead and marks the requests in flight
+ *         as stale.
+ *
+ *  \return the sequence number of the first request that will be
+ *          used again, for the SEEK that follows
+ */
+uint32_t RemoteFileStream::Cancel(void)
+{
+    m_stats.discarded += GetBuffered();
+    m_buffer.resize(0);
+    m_bufferPos = 0;
+    m_fence = m_nextSeq;
+    return m_fence;
+}
+
+bool RemoteFileStream::SendRequest(void)
+{
+    char hdr[kHeaderSize];
+    PutHeader(hdr, m_nextSeq, m_blockSize);
+    if (m_sock->Write(hdr, kHeaderSize) != (int)kHeaderSize)
+    {
+        LOG(VB_NETWORK, LOG_ERR, LOC + "Block request failed");
+        return false;
+    }
+
+    Request req;
+    req.seq  = m_nextSeq++;
+    req.size = m_blockSize;
+    req.sent.start();
+    m_requests.push_back(req);
+
+    return true;
+}
+
+/** \brief Reads the reply to the oldest request into the buffer, or
+ *         throws it away if it is stale.
+ *
+ *  \return the length of the reply, 0 for a stale one, -1 on error
+ */
+int RemoteFileStream::ReadReply(bool &eof, int timeout_ms)
+{
+    MythTimer timer;
+    timer.start();
+
+    char hdr[kHeaderSize];
+    int ret = ReadFull(m_sock, hdr, kHeaderSize, timeout_ms);
+    if (ret != (int)kHeaderSize)
+    {
+        LOG(VB_NETWORK, LOG_ERR, LOC +
+            QString("No reply after %1 ms").arg(timeout_ms));
+        return -1;
+    }
+
+    uint32_t seq;
+    int32_t len;
+    GetHeader(hdr, seq, len);
+
+    if (m_requests.empty() || seq != m_requests.front().seq ||
+        len > m_requests.front().size)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Unexpected reply %1 of %2 bytes").arg(seq).arg(len));
+        return -1;
+    }
+
+    Request req = m_requests.front();
+    m_requests.pop_front();
+
+    // signed difference, so this still works once seq wraps
+    bool stale = (int32_t)(seq - m_fence) < 0;
+
+    if (len > 0)
+    {
+        int old = m_buffer.size();
+        char *dst;
+        if (stale)
+        {
+            m_scratch.resize(len);
+            dst = m_scratch.data();
+        }
+        else
+        {
+            m_buffer.resize(old + len);
+            dst = m_buffer.data() + old;
+        }
+
+        int left = max(timeout_ms - timer.elapsed(), 1);
+        if (ReadFull(m_sock, dst, len, left) != len)
+        {
+            LOG(VB_NETWORK, LOG_ERR, LOC +
+                QString("Short reply to request %1").arg(seq));
+            if (!stale)
+                m_buffer.resize(old);
+            return -1;
+        }
+    }
+
+    uint64_t usecs = req.sent.nsecsElapsed() / 1000;
+    m_stats.blocks++;
+    m_stats.latency_total += usecs;
+    m_stats.latency_max = max(m_stats.latency_max, usecs);
+
+    if (stale)
+    {
+        m_stats.discarded += max(len, 0);
+        return 0;
+    }
+
+    if (len < 0)
+    {
+        LOG(VB_NETWORK, LOG_ERR, LOC +
+            QString("Backend failed request %1").arg(seq));
+        return -1;
+    }
+
+    m_stats.bytes += len;
+    if (len < req.size)
+        eof = true;
+
+    return len;
+}
+
+/** \brief Reads exactly size bytes unless timeout_ms passes first.
+ *
+ *  \return the number of bytes read or -1 if the socket failed
+ */
+int RemoteFileStream::ReadFull(MythSocket *sock, char *data, int size,
+                               int timeout_ms)
+{
+    MythTimer timer;
+    timer.start();
+    int got = 0;
+
+    while (got < size)
+    {
+        int left = timeout_ms - timer.elapsed();
+        if (left <= 0)
+            break;
+
+        int ret = sock->Read(data + got, size - got, left);
+        if (ret < 0)
+            return -1;
+        if (ret == 0 && !sock->IsConnected())
+            return -1;
+        got += ret;
+    }
+
+    return got;
+}
+
+void RemoteFileStream::PutHeader(char *buf, uint32_t seq, int32_t len)
+{
+    qToBigEndian<quint32>(seq, (uchar*) buf);
+    qToBigEndian<qint32>(len, (uchar*) buf + 4);
+}
+
+void RemoteFileStream::GetHeader(const char *buf, uint32_t &seq, int32_t &len)
+{
+    seq = qFromBigEndian<quint32>((const uchar*) buf);
+    len = qFromBigEndian<qint32>((const uchar*) buf + 4);
+}
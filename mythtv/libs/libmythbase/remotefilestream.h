@@ -0,0 +1,102 @@
+// -*- Mode: c++ -*-
+#ifndef REMOTEFILESTREAM_H_
+#define REMOTEFILESTREAM_H_
+
+#include <stdint.h>
+
+#include <deque>
+using namespace std;
+
+#include <QElapsedTimer>
+#include <QByteArray>
+
+#include "mythbaseexp.h"
+
+class MythSocket;
+
+/// Counters of a RemoteFileStream, latencies are in microseconds
+class MBASE_PUBLIC RemoteFileStreamStats
+{
+  public:
+    RemoteFileStreamStats() :
+        blocks(0), bytes(0), discarded(0),
+        latency_total(0), latency_max(0) {}
+
+    uint64_t blocks;        ///< replies received
+    uint64_t bytes;         ///< payload bytes received
+    uint64_t discarded;     ///< payload bytes dropped after a seek
+    uint64_t latency_total; ///< sum of request to reply times
+    uint64_t latency_max;
+};
+
+/** \class RemoteFileStream
+ *  \brief Keeps a window of block requests outstanding on the data
+ *         socket of a file transfer.
+ *
+ *  The legacy REQUEST_BLOCK goes over the control socket and waits for
+ *  its reply before the next block is asked for, so each block costs a
+ *  full round trip. Once the backend has agreed to START_STREAM the
+ *  client instead writes requests straight to the data socket and the
+ *  backend answers them in order, each reply carrying its own length:
+ *
+ *      request: seq (uint32), size (int32)
+ *      reply:   seq (uint32), len (int32), len bytes of data
+ *
+ *  in network byte order. A len of less than size means end of file,
+ *  -1 an error. Read() keeps up to the window size of requests in
+ *  flight, buffering what arrives beyond what the caller wanted.
+ *
+ *  A seek has to discard both what is buffered and the replies to
+ *  requests that are still in flight. Cancel() does the former and
+ *  returns the first sequence number that is not stale; the SEEK sent
+ *  on the control socket carries it, the backend answers older
+ *  requests without reading the file and Read() drops their replies.
+ */
+class MBASE_PUBLIC RemoteFileStream
+{
+  public:
+    RemoteFileStream(MythSocket *sock, uint window,
+                     uint block_size = kDefaultBlockSize);
+
+    int      Read(char *data, int size, int timeout_ms);
+    uint32_t Cancel(void);
+
+    uint GetWindow(void) const { return m_window; }
+    uint GetBlockSize(void) const { return m_blockSize; }
+    uint GetBuffered(void) const { return m_buffer.size() - m_bufferPos; }
+    RemoteFileStreamStats GetStats(void) const { return m_stats; }
+
+    static int  ReadFull(MythSocket *sock, char *data, int size,
+                         int timeout_ms);
+    static void PutHeader(char *buf, uint32_t seq, int32_t len);
+    static void GetHeader(const char *buf, uint32_t &seq, int32_t &len);
+
+    static const uint kHeaderSize       = 8;
+    static const uint kDefaultWindow    = 8;
+    static const uint kDefaultBlockSize = 128 * 1024;
+    static const uint kMaxBlockSize     = 4 * 1024 * 1024;
+
+  private:
+    typedef struct
+    {
+        uint32_t      seq;
+        int32_t       size;
+        QElapsedTimer sent;
+    } Request;
+
+    bool SendRequest(void);
+    int  ReadReply(bool &eof, int timeout_ms);
+
+    MythSocket     *m_sock;
+    uint            m_window;
+    uint            m_blockSize;
+    uint32_t        m_nextSeq;
+    uint32_t        m_fence;      ///< replies below this are stale
+    deque<Request>  m_requests;   ///< in flight, oldest first
+    QByteArray      m_buffer;
+    int             m_bufferPos;
+    QByteArray      m_scratch;
+    RemoteFileStreamStats m_stats;
+};
+
+#endif
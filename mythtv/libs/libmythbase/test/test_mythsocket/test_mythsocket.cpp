@@ -0,0 +1,206 @@
+/*
+ *  Class TestMythSocket
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QElapsedTimer>
+#include <QtEndian>
+
+#include "test_mythsocket.h"
+
+#include "mythsocket.h"
+
+/// What ReadStringList() does with a frame
+static bool decode(const QByteArray &frame, QStringList &list)
+{
+    if (frame.size() < 8)
+        return false;
+    if ((uchar) frame[0] == 0xff)
+    {
+        return MythSocket::DecodeStringList(
+            frame.constData() + 8, frame.size() - 8, list);
+    }
+    list = QString::fromUtf8(frame.constData() + 8, frame.size() - 8)
+        .split("[]:[]");
+    return true;
+}
+
+/// The 52 fields ProgramInfo::ToStringList() sends, more or less
+static void add_recording(QStringList &list, uint i)
+{
+    uint start = 1400000000 + i * 3600;
+    list << QString("Title %1").arg(i % 500)
+         << QString("Episode %1").arg(i)
+         << QString("A description of episode %1, long enough to look "
+                    "like the ones in the guide data.").arg(i)
+         << QString::number(i % 12) << QString::number(i % 24) << "0"
+         << "" << "Drama"
+         << QString::number(1000 + i % 50) << QString::number(i % 50)
+         << "CALL" << "Channel Name"
+         << QString("myth://Default@backend/%1_%2.ts").arg(1000 + i % 50)
+            .arg(start)
+         << QString::number(2000000000LL + i * 12345)
+         << QString::number(start) << QString::number(start + 3600)
+         << "0" << "backend" << "1" << "1" << "1" << "0" << "-3"
+         << QString::number(i % 300) << "1" << "15" << "6"
+         << QString::number(start - 60) << QString::number(start + 3660)
+         << "0" << "Default" << "" << QString("SH%1").arg(i, 8, 10, QChar('0'))
+         << QString("EP%1").arg(i, 10, 10, QChar('0')) << "ttvdb.py_12345"
+         << QString::number(start + 7200) << "0.000000" << "2014-05-13"
+         << "Default" << "0" << "0" << "Default" << "0" << "5" << "0"
+         << "2014" << "0" << "0" << "3" << QString::number(i + 1)
+         << "Input 1" << "0";
+}
+
+void TestMythSocket::Framing_test_data(void)
+{
+    QTest::addColumn<QStringList>("list");
+    QTest::addColumn<bool>("legacy");
+
+    QTest::newRow("command") << QStringList("QUERY_RECORDINGS Play") << true;
+    QTest::newRow("numbers") << (QStringList()
+        << "0" << "-1" << "42" << "1234567890123" << "-0" << "007" << "+5"
+        << "1e3" << "-" << "123456789012345678" << "1234567890123456789")
+        << true;
+    QTest::newRow("text") << (QStringList()
+        << "Hello" << "" << "a b" << QString::fromUtf8("Ünïcödé ✓")
+        << QString::fromUtf8("日本語") << "") << true;
+    QTest::newRow("one empty") << QStringList("") << false;
+    QTest::newRow("separator") << (QStringList() << "a[]:[]b" << "c")
+        << false;
+
+    QStringList recordings("2");
+    add_recording(recordings, 0);
+    add_recording(recordings, 1);
+    QTest::newRow("recordings") << recordings << true;
+}
+
+void TestMythSocket::Framing_test(void)
+{
+    QFETCH(QStringList, list);
+    QFETCH(bool, legacy);
+
+    QByteArray frame = MythSocket::EncodeStringList(list, true);
+    QVERIFY (frame.size() >= 12);
+    QCOMPARE (frame.left(4), QByteArray("\xff" "MB\x01", 4));
+    QCOMPARE (qFromBigEndian<quint32>((const uchar*) frame.constData() + 4),
+              (quint32) frame.size() - 8);
+
+    QStringList out;
+    QVERIFY (decode(frame, out));
+    QCOMPARE (out, list);
+
+    if (!legacy)
+        return;
+
+    frame = MythSocket::EncodeStringList(list, false);
+    QVERIFY (frame.size() > 8);
+    QVERIFY (frame[0] >= '0' && frame[0] <= '9');
+    QVERIFY (decode(frame, out));
+    QCOMPARE (out, list);
+}
+
+void TestMythSocket::Integer_test(void)
+{
+    // 12 bytes of header and count, then 4 for the length of each
+    // string and 8 for an integer or the string itself
+    QCOMPARE (MythSocket::EncodeStringList(QStringList("12345"), true)
+              .size(), 12 + 4 + 8);
+    QCOMPARE (MythSocket::EncodeStringList(QStringList("-12345"), true)
+              .size(), 12 + 4 + 8);
+    QCOMPARE (MythSocket::EncodeStringList(
+                  QStringList("123456789012345678"), true).size(), 12 + 4 + 8);
+
+    // these would not come back the same
+    QCOMPARE (MythSocket::EncodeStringList(QStringList("007"), true)
+              .size(), 12 + 4 + 3);
+    QCOMPARE (MythSocket::EncodeStringList(QStringList("-0"), true)
+              .size(), 12 + 4 + 2);
+    QCOMPARE (MythSocket::EncodeStringList(
+                  QStringList("1234567890123456789"), true).size(),
+              12 + 4 + 19);
+}
+
+void TestMythSocket::Invalid_test(void)
+{
+    QStringList list;
+    list << "abc" << "123" << "";
+    QByteArray payload = MythSocket::EncodeStringList(list, true).mid(8);
+    QStringList out;
+
+    QVERIFY (MythSocket::DecodeStringList(
+                 payload.constData(), payload.size(), out));
+    QCOMPARE (out, list);
+
+    for (int len = 0; len < payload.size(); len++)
+    {
+        QVERIFY (!MythSocket::DecodeStringList(
+                     payload.constData(), len, out));
+    }
+
+    QByteArray padded = payload + 'x';
+    QVERIFY (!MythSocket::DecodeStringList(
+                 padded.constData(), padded.size(), out));
+
+    QByteArray count = payload;
+    qToBigEndian<quint32>(1000, (uchar*) count.data());
+    QVERIFY (!MythSocket::DecodeStringList(
+                 count.constData(), count.size(), out));
+}
+
+void TestMythSocket::Recordings_benchmark_data(void)
+{
+    QTest::addColumn<bool>("binary");
+    QTest::newRow("legacy") << false;
+    QTest::newRow("binary") << true;
+}
+
+void TestMythSocket::Recordings_benchmark(void)
+{
+    QFETCH(bool, binary);
+
+    uint count = qgetenv("MYTHTV_SOCKET_RECORDINGS").toUInt();
+    count = count ? count : 9000;
+
+    QStringList list(QString::number(count));
+    for (uint i = 0; i < count; i++)
+        add_recording(list, i);
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray frame = MythSocket::EncodeStringList(list, binary);
+    qint64 encode = timer.nsecsElapsed();
+
+    QStringList out;
+    timer.start();
+    QVERIFY (decode(frame, out));
+    qint64 decoded = timer.nsecsElapsed();
+    QCOMPARE (out, list);
+
+    qDebug() << qPrintable(QString(
+        "%1 recordings, %2 strings: %3 KB, encode %4 ms, decode %5 ms")
+        .arg(count).arg(list.size()).arg(frame.size() / 1024)
+        .arg(encode / 1000000.0, 0, 'f', 1)
+        .arg(decoded / 1000000.0, 0, 'f', 1));
+
+    QBENCHMARK
+    {
+        frame = MythSocket::EncodeStringList(list, binary);
+        decode(frame, out);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestMythSocket)
@@ -0,0 +1,44 @@
+/*
+ *  Class TestMythSocket
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+class TestMythSocket: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    /** test that string lists come back unchanged from both framings
+     */
+    void Framing_test_data(void);
+    void Framing_test(void);
+
+    /** test which strings are sent as integers
+     */
+    void Integer_test(void);
+
+    /** test that a truncated or padded binary frame is refused
+     */
+    void Invalid_test(void);
+
+    /** encodes and decodes a QUERY_RECORDINGS sized reply
+     *  MYTHTV_SOCKET_RECORDINGS  number of recordings (default 9000)
+     */
+    void Recordings_benchmark_data(void);
+    void Recordings_benchmark(void);
+};
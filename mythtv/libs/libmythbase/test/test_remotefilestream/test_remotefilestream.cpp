@@ -0,0 +1,350 @@
+/*
+ *  Class TestRemoteFileStream
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <deque>
+using namespace std;
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QSemaphore>
+#include <QThread>
+#include <QMutex>
+
+#include "test_remotefilestream.h"
+
+#include "remotefilestream.h"
+#include "mythsocket.h"
+
+static QByteArray make_pattern(uint size, uint seed)
+{
+    QByteArray data;
+    data.resize(size);
+    for (uint i = 0; i < size; i++)
+        data[i] = char((i * 31 + seed) ^ (i >> 9));
+    return data;
+}
+
+/** \brief Answers requests the way FileTransfer::StreamBlock() does,
+ *         each one only after the round trip time has passed.
+ */
+class FakeBackend : public QThread
+{
+  public:
+    FakeBackend(const QByteArray &data, int rtt_ms) :
+        m_data(data), m_rtt(rtt_ms), m_port(0),
+        m_pos(0), m_fence(0), m_stop(false) {}
+
+    ~FakeBackend()
+    {
+        m_stop = true;
+        wait();
+    }
+
+    bool Listen(void)
+    {
+        start();
+        m_ready.acquire();
+        return m_port != 0;
+    }
+
+    quint16 GetPort(void) const { return m_port; }
+
+    /// What FileTransfer::Seek() does for a streaming client
+    void Seek(qint64 pos, uint32_t fence)
+    {
+        QMutexLocker locker(&m_lock);
+        m_pos = pos;
+        m_fence = fence;
+    }
+
+    void run(void)
+    {
+        QTcpServer server;
+        if (server.listen(QHostAddress::LocalHost))
+            m_port = server.serverPort();
+        m_ready.release();
+        if (!m_port || !server.waitForNewConnection(10000))
+            return;
+
+        QTcpSocket *sock = server.nextPendingConnection();
+        sock->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+        const int hsize = RemoteFileStream::kHeaderSize;
+        deque<Pending> pending;
+        QByteArray in;
+        QElapsedTimer clock;
+        clock.start();
+
+        while (!m_stop && sock->state() == QAbstractSocket::ConnectedState)
+        {
+            qint64 wait = 10;
+            if (!pending.empty())
+                wait = max(pending.front().due - clock.elapsed(), 0LL);
+            sock->waitForReadyRead(wait);
+            in += sock->readAll();
+
+            for (; in.size() >= hsize; in.remove(0, hsize))
+            {
+                Pending req;
+                RemoteFileStream::GetHeader(in.constData(), req.seq, req.size);
+                req.due = clock.elapsed() + m_rtt;
+                pending.push_back(req);
+            }
+
+            while (!pending.empty() && pending.front().due <= clock.elapsed())
+            {
+                Answer(sock, pending.front());
+                pending.pop_front();
+            }
+            sock->flush();
+        }
+
+        delete sock;
+    }
+
+  private:
+    typedef struct
+    {
+        uint32_t seq;
+        int32_t  size;
+        qint64   due;
+    } Pending;
+
+    void Answer(QTcpSocket *sock, const Pending &req)
+    {
+        QMutexLocker locker(&m_lock);
+
+        int32_t len = 0;
+        if ((int32_t)(req.seq - m_fence) >= 0)
+            len = max(min((qint64)req.size, m_data.size() - m_pos), 0LL);
+
+        char hdr[RemoteFileStream::kHeaderSize];
+        RemoteFileStream::PutHeader(hdr, req.seq, len);
+        sock->write(hdr, sizeof(hdr));
+        sock->write(m_data.constData() + m_pos, len);
+        m_pos += len;
+    }
+
+    QByteArray    m_data;
+    int           m_rtt;
+    quint16       m_port;
+    QSemaphore    m_ready;
+
+    QMutex        m_lock;
+    qint64        m_pos;
+    uint32_t      m_fence;
+    volatile bool m_stop;
+};
+
+static MythSocket *connect_to(const FakeBackend &backend)
+{
+    MythSocket *sock = new MythSocket();
+    if (!sock->ConnectToHost(QHostAddress(QHostAddress::LocalHost),
+                             backend.GetPort()))
+    {
+        sock->DecrRef();
+        return NULL;
+    }
+    return sock;
+}
+
+/// Reads len bytes in odd sized pieces, less at the end of the file
+static QByteArray read_some(RemoteFileStream &stream, int len)
+{
+    QByteArray out;
+    QByteArray buf(64 * 1024, 0);
+    uint step = 1;
+    while (out.size() < len)
+    {
+        int want = min((int)(step * 1013) % buf.size() + 1, len - out.size());
+        int ret = stream.Read(buf.data(), want, 5000);
+        if (ret <= 0)
+            break;
+        out.append(buf.constData(), ret);
+        step = (step % 97) + 1;
+    }
+    return out;
+}
+
+void TestRemoteFileStream::Header_test(void)
+{
+    char buf[RemoteFileStream::kHeaderSize];
+    uint32_t seq;
+    int32_t len;
+
+    RemoteFileStream::PutHeader(buf, 0x01020304, 0x05060708);
+    QCOMPARE (buf[0], (char) 0x01);
+    QCOMPARE (buf[7], (char) 0x08);
+    RemoteFileStream::GetHeader(buf, seq, len);
+    QCOMPARE (seq, (uint32_t) 0x01020304);
+    QCOMPARE (len, (int32_t) 0x05060708);
+
+    RemoteFileStream::PutHeader(buf, 0xffffffff, -1);
+    RemoteFileStream::GetHeader(buf, seq, len);
+    QCOMPARE (seq, (uint32_t) 0xffffffff);
+    QCOMPARE (len, (int32_t) -1);
+}
+
+void TestRemoteFileStream::Read_test_data(void)
+{
+    QTest::addColumn<uint>("window");
+    QTest::addColumn<uint>("block");
+    QTest::newRow("stop and wait") << 1U << 4096U;
+    QTest::newRow("window 3")      << 3U << 4096U;
+    QTest::newRow("window 16")     << 16U << 1000U;
+}
+
+void TestRemoteFileStream::Read_test(void)
+{
+    QFETCH(uint, window);
+    QFETCH(uint, block);
+
+    QByteArray data = make_pattern(1024 * 1024 + 777, 1);
+    FakeBackend backend(data, 0);
+    QVERIFY (backend.Listen());
+    MythSocket *sock = connect_to(backend);
+    QVERIFY (sock);
+
+    RemoteFileStream stream(sock, window, block);
+    QByteArray out = read_some(stream, data.size() + 1000);
+    QCOMPARE (out.size(), data.size());
+    QVERIFY (out == data);
+
+    char c;
+    QCOMPARE (stream.Read(&c, 1, 5000), 0);
+
+    RemoteFileStreamStats stats = stream.GetStats();
+    QCOMPARE (stats.bytes, (uint64_t) data.size());
+    QCOMPARE (stats.discarded, (uint64_t) 0);
+    QVERIFY (stats.latency_max >= stats.latency_total / stats.blocks);
+
+    sock->DecrRef();
+}
+
+void TestRemoteFileStream::Seek_test_data(void)
+{
+    QTest::addColumn<uint>("window");
+    QTest::addColumn<int>("rtt");
+    QTest::newRow("stop and wait") << 1U << 0;
+    QTest::newRow("window 8")      << 8U << 0;
+    QTest::newRow("window 8, 20ms") << 8U << 20;
+}
+
+void TestRemoteFileStream::Seek_test(void)
+{
+    QFETCH(uint, window);
+    QFETCH(int, rtt);
+
+    QByteArray data = make_pattern(2 * 1024 * 1024, 2);
+    FakeBackend backend(data, rtt);
+    QVERIFY (backend.Listen());
+    MythSocket *sock = connect_to(backend);
+    QVERIFY (sock);
+
+    RemoteFileStream stream(sock, window, 4096);
+    QVERIFY (read_some(stream, 100000) == data.left(100000));
+
+    // forward, with the replies to the read ahead still on their way
+    backend.Seek(333333, stream.Cancel());
+    QVERIFY (read_some(stream, 50000) == data.mid(333333, 50000));
+
+    // and back
+    backend.Seek(10, stream.Cancel());
+    QVERIFY (read_some(stream, 70000) == data.mid(10, 70000));
+
+    // to the end
+    backend.Seek(data.size() - 100, stream.Cancel());
+    QVERIFY (read_some(stream, 1000) == data.right(100));
+
+    QVERIFY (stream.GetStats().discarded > 0);
+
+    sock->DecrRef();
+}
+
+void TestRemoteFileStream::Throughput_benchmark_data(void)
+{
+    QTest::addColumn<uint>("window");
+    QTest::addColumn<int>("rtt");
+    int rtts[] = { 0, 10, 40 };
+    uint windows[] = { 1, RemoteFileStream::kDefaultWindow };
+    for (uint i = 0; i < sizeof(rtts) / sizeof(int); i++)
+    {
+        for (uint j = 0; j < sizeof(windows) / sizeof(uint); j++)
+        {
+            QString name = QString("rtt %1ms, window %2")
+                .arg(rtts[i]).arg(windows[j]);
+            QTest::newRow(name.toLatin1().constData())
+                << windows[j] << rtts[i];
+        }
+    }
+}
+
+void TestRemoteFileStream::Throughput_benchmark(void)
+{
+    QFETCH(uint, window);
+    QFETCH(int, rtt);
+
+    qint64 mb = qgetenv("MYTHTV_RFS_MB").toLongLong();
+    mb = mb ? mb : 4;
+
+    QByteArray data = make_pattern(mb * 1024 * 1024, 3);
+    FakeBackend backend(data, rtt);
+    QVERIFY (backend.Listen());
+    MythSocket *sock = connect_to(backend);
+    QVERIFY (sock);
+
+    RemoteFileStream stream(sock, window);
+    QByteArray buf(RemoteFileStream::kDefaultBlockSize, 0);
+    qint64 total = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE
+    {
+        int ret;
+        while ((ret = stream.Read(buf.data(), buf.size(), 10000)) > 0)
+            total += ret;
+    }
+    qint64 elapsed = max(timer.elapsed(), 1LL);
+
+    QCOMPARE (total, (qint64) data.size());
+
+    RemoteFileStreamStats stats = stream.GetStats();
+    qDebug() << qPrintable(QString(
+        "rtt %1 ms, window %2 x %3 KB: %4 MB/s, request to reply "
+        "avg %5 ms max %6 ms")
+        .arg(rtt).arg(window).arg(stream.GetBlockSize() / 1024)
+        .arg(total / 1048576.0 * 1000.0 / elapsed, 0, 'f', 1)
+        .arg(stats.latency_total / 1000.0 / stats.blocks, 0, 'f', 2)
+        .arg(stats.latency_max / 1000.0, 0, 'f', 2));
+
+    sock->DecrRef();
+}
+
+int main(int argc, char *argv[])
+{
+    // MythSocket needs an event loop in its thread
+    QCoreApplication app(argc, argv);
+    TestRemoteFileStream test;
+    return QTest::qExec(&test, argc, argv);
+}
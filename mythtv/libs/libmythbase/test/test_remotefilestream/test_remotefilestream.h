@@ -0,0 +1,50 @@
+/*
+ *  Class TestRemoteFileStream
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+class TestRemoteFileStream: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    /** test that headers survive the trip through network byte order
+     */
+    void Header_test(void);
+
+    /** test that odd sized reads through a window get the file back
+     *  in order and stop at its end
+     */
+    void Read_test_data(void);
+    void Read_test(void);
+
+    /** test that a seek with requests still in flight continues
+     *  with the data at the new position
+     */
+    void Seek_test_data(void);
+    void Seek_test(void);
+
+    /** streams a file from a loopback server that holds each request
+     *  for an injected round trip time, and reports MB/s and the
+     *  time from request to reply. A window of 1 is the same stop
+     *  and wait as REQUEST_BLOCK.
+     *  MYTHTV_RFS_MB   MB read for each row (default 4)
+     */
+    void Throughput_benchmark_data(void);
+    void Throughput_benchmark(void);
+};
@@ -0,0 +1,337 @@
+/*
+ *  Class TestThreadedFileWriter
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QFile>
+#include <QDir>
+
+#include "test_threadedfilewriter.h"
+
+#include "threadedfilewriter.h"
+#include "threadedfilewriterpool.h"
+#include "mythcorecontext.h"
+
+#ifndef O_LARGEFILE
+#define O_LARGEFILE 0
+#endif
+
+static const int kFlags = O_WRONLY | O_TRUNC | O_CREAT | O_LARGEFILE;
+static const mode_t kMode = 0644;
+
+/// Same sized reads as a DeviceReadBuffer hands to a recorder
+static const uint kTSChunk = 188 * 348;
+
+static QByteArray make_pattern(uint size, uint seed)
+{
+    QByteArray data;
+    data.resize(size);
+    for (uint i = 0; i < size; i++)
+        data[i] = char((i * 31 + seed) ^ (i >> 9));
+    return data;
+}
+
+static QByteArray read_file(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+/// One recorder writing its stream through its own ThreadedFileWriter
+class TSWriter : public QThread
+{
+  public:
+    TSWriter(const QString &fname, const QString &backend,
+             const QByteArray &ts, qint64 bytes, double mbps) :
+        m_tfw(fname, kFlags, kMode), m_ts(ts), m_bytes(bytes), m_mbps(mbps),
+        m_ok(false)
+    {
+        m_tfw.SetWriteBackend(backend);
+        m_tfw.SetBlocking(true);
+    }
+
+    void run(void)
+    {
+        if (!m_tfw.Open())
+            return;
+
+        const char *ts = m_ts.constData();
+        uint tslen = m_ts.size() - (m_ts.size() % kTSChunk);
+        qint64 done = 0;
+        uint pos = 0;
+        QElapsedTimer clock, op;
+        clock.start();
+
+        m_latency.reserve(m_bytes / kTSChunk + 1);
+        while (done < m_bytes)
+        {
+            if (m_mbps > 0)
+            {
+                qint64 due = (qint64)(done * 8 / m_mbps); // usecs
+                qint64 now = clock.nsecsElapsed() / 1000;
+                if (due > now)
+                    usleep(due - now);
+            }
+
+            op.start();
+            if (m_tfw.Write(ts + pos, kTSChunk) < 0)
+                return;
+            m_latency.push_back(op.nsecsElapsed() / 1000);
+
+            done += kTSChunk;
+            pos   = (pos + kTSChunk) % tslen;
+        }
+        m_tfw.Flush();
+        m_ok = !m_tfw.WritesFailing();
+    }
+
+    ThreadedFileWriter m_tfw;
+    QByteArray         m_ts;
+    qint64             m_bytes;
+    double             m_mbps;
+    bool               m_ok;
+    vector<qint64>     m_latency; ///< usecs per Write()
+};
+
+void TestThreadedFileWriter::initTestCase(void)
+{
+    gCoreContext = new MythCoreContext("bin_version", NULL);
+
+    m_dir = QString::fromLocal8Bit(qgetenv("MYTHTV_TFW_DIR"));
+    if (m_dir.isEmpty())
+        m_dir = QDir::tempPath();
+    m_dir += QString("/test_tfw_%1").arg(getpid());
+    QVERIFY (QDir().mkpath(m_dir));
+
+    QString path = QString::fromLocal8Bit(qgetenv("MYTHTV_TEST_TS"));
+    if (!path.isEmpty())
+        m_ts = read_file(path);
+    if (m_ts.size() < (int)kTSChunk)
+    {
+        // 64 chunks of packets with only the sync byte and PID set
+        m_ts = make_pattern(64 * kTSChunk, 7);
+        for (uint i = 0; i < (uint)m_ts.size(); i += 188)
+        {
+            m_ts[i + 0] = 0x47;
+            m_ts[i + 1] = char((i / 188) % 4);
+        }
+    }
+}
+
+void TestThreadedFileWriter::cleanupTestCase(void)
+{
+    QDir dir(m_dir);
+    QStringList files = dir.entryList(QDir::Files);
+    for (int i = 0; i < files.size(); i++)
+        dir.remove(files[i]);
+    QDir().rmdir(m_dir);
+
+    delete gCoreContext;
+    gCoreContext = NULL;
+}
+
+static void add_backend_rows(void)
+{
+    QTest::addColumn<QString>("backend");
+    QStringList backends = ThreadedFileWriter::GetWriteBackends();
+    for (int i = 0; i < backends.size(); i++)
+        QTest::newRow(backends[i].toLatin1().constData()) << backends[i];
+}
+
+void TestThreadedFileWriter::Contents_test_data(void)
+{
+    add_backend_rows();
+}
+
+void TestThreadedFileWriter::Contents_test(void)
+{
+    QFETCH(QString, backend);
+
+    QString fname1 = m_dir + "/contents1_" + backend;
+    QString fname2 = m_dir + "/contents2_" + backend;
+    // not a multiple of any alignment, and more than one chunk
+    QByteArray data1 = make_pattern(3 * 1024 * 1024 + 4097, 1);
+    QByteArray data2 = make_pattern(777777, 2);
+
+    ThreadedFileWriter *tfw = new ThreadedFileWriter(fname1, kFlags, kMode);
+    tfw->SetWriteBackend(backend);
+    QVERIFY (tfw->Open());
+
+    // odd sized writes, with a Flush() in the middle
+    uint pos = 0, step = 1;
+    while (pos < (uint)data1.size())
+    {
+        uint len = min(step * 1013, (uint)data1.size() - pos);
+        QCOMPARE (tfw->Write(data1.constData() + pos, len), (int)len);
+        pos  += len;
+        step  = (step % 97) + 1;
+        if (pos > (uint)data1.size() / 2 && step == 1)
+        {
+            tfw->Flush();
+            QVERIFY (read_file(fname1) == data1.left(pos));
+        }
+    }
+    tfw->Flush();
+    QVERIFY (read_file(fname1) == data1);
+
+    QVERIFY (tfw->ReOpen(fname2));
+    QCOMPARE (tfw->Write(data2.constData(), data2.size()), data2.size());
+    QVERIFY (!tfw->WritesFailing());
+    delete tfw;
+
+    QVERIFY (read_file(fname1) == data1);
+    QVERIFY (read_file(fname2) == data2);
+}
+
+void TestThreadedFileWriter::Seek_test_data(void)
+{
+    add_backend_rows();
+}
+
+void TestThreadedFileWriter::Seek_test(void)
+{
+    QFETCH(QString, backend);
+
+    QString fname = m_dir + "/seek_" + backend;
+    QByteArray data = make_pattern(2 * 1024 * 1024 + 100, 3);
+    QByteArray header = make_pattern(300, 4);
+    QByteArray tail = make_pattern(5000, 5);
+
+    ThreadedFileWriter *tfw = new ThreadedFileWriter(fname, kFlags, kMode);
+    tfw->SetWriteBackend(backend);
+    QVERIFY (tfw->Open());
+    QCOMPARE (tfw->Write(data.constData(), data.size()), data.size());
+    QCOMPARE (tfw->Seek(0, SEEK_END), (long long)data.size());
+    QCOMPARE (tfw->Write(tail.constData(), tail.size()), tail.size());
+    QCOMPARE (tfw->Seek(100, SEEK_SET), 100LL);
+    QCOMPARE (tfw->Write(header.constData(), header.size()), header.size());
+    delete tfw;
+
+    QByteArray expected = data + tail;
+    expected.replace(100, header.size(), header);
+    QVERIFY (read_file(fname) == expected);
+}
+
+void TestThreadedFileWriter::BufferPool_test(void)
+{
+    TFWBufferPool *pool = TFWBufferPool::GetPool();
+    TFWBufferPoolStats before = pool->GetStats();
+    const uint k = TFWBufferPool::kMinClassSize;
+
+    uint cap1, cap2, cap3;
+    char *b1 = pool->Get(1, cap1);
+    char *b2 = pool->Get(k + 1, cap2);
+    QVERIFY (b1 && b2);
+    QCOMPARE (cap1, k);
+    QCOMPARE (cap2, 2 * k);
+
+    TFWBufferPoolStats s = pool->GetStats();
+    QCOMPARE (s.in_use, before.in_use + 3 * k);
+    QVERIFY (s.in_use_max >= s.in_use);
+
+    // a released block is handed out again for the same class
+    pool->Put(b2, cap2);
+    char *b3 = pool->Get(2 * k, cap3);
+    QVERIFY (b3 == b2);
+    QCOMPARE (pool->GetStats().reuses, before.reuses + 1);
+
+    // nothing is kept beyond the cap
+    pool->SetCap(0);
+    pool->Put(b1, cap1);
+    pool->Put(b3, cap3);
+    s = pool->GetStats();
+    QCOMPARE (s.pooled, (uint64_t) 0);
+    QCOMPARE (s.in_use, before.in_use);
+    QVERIFY (s.frees >= before.frees + 2);
+    pool->SetCap(TFWBufferPool::kDefaultCap);
+}
+
+void TestThreadedFileWriter::ConcurrentWriters_benchmark_data(void)
+{
+    add_backend_rows();
+}
+
+void TestThreadedFileWriter::ConcurrentWriters_benchmark(void)
+{
+    QFETCH(QString, backend);
+
+    uint writers = qgetenv("MYTHTV_TFW_WRITERS").toUInt();
+    qint64 mb = qgetenv("MYTHTV_TFW_MB").toLongLong();
+    double mbps = qgetenv("MYTHTV_TFW_MBPS").toDouble();
+    writers = writers ? writers : 4;
+    mb = mb ? mb : 16;
+
+    vector<TSWriter*> threads;
+    for (uint i = 0; i < writers; i++)
+    {
+        QString fname = m_dir + QString("/bench_%1_%2.ts").arg(backend).arg(i);
+        threads.push_back(new TSWriter(fname, backend, m_ts,
+                                       mb * 1024 * 1024, mbps));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE
+    {
+        for (uint i = 0; i < threads.size(); i++)
+            threads[i]->start();
+        for (uint i = 0; i < threads.size(); i++)
+            threads[i]->wait();
+    }
+    qint64 elapsed = max(timer.elapsed(), 1LL);
+
+    vector<qint64> latency;
+    bool ok = true;
+    for (uint i = 0; i < threads.size(); i++)
+    {
+        ok &= threads[i]->m_ok;
+        latency.insert(latency.end(), threads[i]->m_latency.begin(),
+                       threads[i]->m_latency.end());
+        delete threads[i];
+    }
+    QVERIFY (ok);
+    QVERIFY (!latency.empty());
+
+    TFWBufferPoolStats pool = TFWBufferPool::GetPool()->GetStats();
+    qDebug() << qPrintable(QString(
+        "buffer pool: peak %1 KB in use, %2 KB pooled, %3 reuses, "
+        "%4 allocations").arg(pool.in_use_max >> 10)
+        .arg(pool.pooled_max >> 10).arg(pool.reuses).arg(pool.allocs));
+
+    sort(latency.begin(), latency.end());
+    uint n = latency.size();
+    double total_mb = writers * mb;
+    qDebug() << qPrintable(QString(
+        "%1: %2 writers, %3 MB/s total, Write() usecs "
+        "p50 %4 p99 %5 p99.9 %6 max %7")
+        .arg(backend).arg(writers)
+        .arg(total_mb * 1000.0 / elapsed, 0, 'f', 1)
+        .arg(latency[n / 2]).arg(latency[n * 99 / 100])
+        .arg(latency[n * 999 / 1000]).arg(latency[n - 1]));
+}
+
+QTEST_APPLESS_MAIN(TestThreadedFileWriter)
@@ -0,0 +1,67 @@
+/*
+ *  Class TestThreadedFileWriter
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#define MSKIP(MSG) QSKIP(MSG, SkipSingle)
+#else
+#define MSKIP(MSG) QSKIP(MSG)
+#endif
+
+class TestThreadedFileWriter: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase(void);
+    void cleanupTestCase(void);
+
+    /** test that every backend writes the same bytes, that Flush()
+     *  makes them visible and that ReOpen() starts a new file
+     */
+    void Contents_test_data(void);
+    void Contents_test(void);
+
+    /** test that a Seek() and overwrite lands where it should
+     */
+    void Seek_test_data(void);
+    void Seek_test(void);
+
+    /** test size classes, reuse, the cap and the statistics
+     *  of the shared buffer pool
+     */
+    void BufferPool_test(void);
+
+    /** replays N concurrent TS writers against each backend and
+     *  reports throughput and Write() tail latency.
+     *  MYTHTV_TFW_DIR    directory to write to (default: temp dir,
+     *                    which is often tmpfs without O_DIRECT)
+     *  MYTHTV_TFW_WRITERS number of writers (default 4)
+     *  MYTHTV_TFW_MB     MB written by each writer (default 16)
+     *  MYTHTV_TFW_MBPS   per writer rate limit in Mbit/s, 0 for
+     *                    unpaced (default 0)
+     *  MYTHTV_TEST_TS    TS file to replay instead of synthetic data
+     */
+    void ConcurrentWriters_benchmark_data(void);
+    void ConcurrentWriters_benchmark(void);
+
+  private:
+    QString    m_dir;
+    QByteArray m_ts;
+};
@@ -11,11 +11,16 @@
 #include <fcntl.h>
 #include <string.h>
 
+#include <algorithm>
+using namespace std;
+
 // Qt headers
 #include <QString>
 
 // MythTV headers
 #include "threadedfilewriter.h"
+#include "threadedfilewriterbackend.h"
+#include "threadedfilewriterpool.h"
 #include "mythlogging.h"
 #include "mythcorecontext.h"
 
@@ -41,6 +46,17 @@ void TFWSyncThread::run(void)
     RunEpilog();
 }
 
+ThreadedFileWriter::TFWBuffer::TFWBuffer(uint min_capacity) :
+    data(NULL), size(0), capacity(0)
+{
+    data = TFWBufferPool::GetPool()->Get(min_capacity, capacity);
+}
+
+ThreadedFileWriter::TFWBuffer::~TFWBuffer()
+{
+    TFWBufferPool::GetPool()->Put(data, capacity);
+}
+
 const uint ThreadedFileWriter::kMaxBufferSize   = 8 * 1024 * 1024;
 const uint ThreadedFileWriter::kMinWriteSize    = 64 * 1024;
 const uint ThreadedFileWriter::kMaxBlockSize    = 1 * 1024 * 1024;
@@ -54,6 +70,12 @@ const uint ThreadedFileWriter::kMaxBlockSize    = 1 * 1024 * 1024;
  *   using another thread. The goal here so to block as little as
  *   possible when the classes using this class want to add data
  *   to the stream.
+ *
+ *   How the write thread gets data to disk is up to a TFWBackend,
+ *   chosen with the "TFWWriteBackend" setting or SetWriteBackend().
+ *   The default is plain write(2); "pwritev" and "io_uring" use
+ *   O_DIRECT so that many simultaneous recordings don't push
+ *   everything else out of the page cache.
  */
 
 /** \fn ThreadedFileWriter::ThreadedFileWriter(const QString&,int,mode_t)
@@ -64,10 +86,12 @@ ThreadedFileWriter::ThreadedFileWriter(const QString &fname,
     // file stuff
     filename(fname),                     flags(pflags),
     mode(pmode),                         fd(-1),
+    backend(NULL),
     // state
     flush(false),                        in_dtor(false),
     ignore_writes(false),                tfw_min_write_size(kMinWriteSize),
-    totalBufferUse(0),
+    totalBufferUse(0),                   backend_pending(false),
+    write_failed(false),
     // threads
     writeThread(NULL),                   syncThread(NULL),
     m_warned(false),                     m_blocking(false),
@@ -88,11 +112,9 @@ bool ThreadedFileWriter::ReOpen(QString newFilename)
 
     buflock.lock();
 
-    if (fd >= 0)
-    {
-        close(fd);
-        fd = -1;
-    }
+    if (backend)
+        backend->Close();
+    fd = -1;
 
     if (m_registered)
     {
@@ -114,13 +136,24 @@ bool ThreadedFileWriter::ReOpen(QString newFilename)
 bool ThreadedFileWriter::Open(void)
 {
     ignore_writes = false;
+    write_failed = false;
+
+    if (!backend)
+    {
+        QString name = backend_name;
+        if (name.isEmpty())
+            name = gCoreContext->GetSetting("TFWWriteBackend", "write");
+        backend = TFWBackend::Create(name);
+    }
 
     if (filename == "-")
+    {
         fd = fileno(stdout);
+        backend->Attach(fd);
+    }
     else
     {
-        QByteArray fname = filename.toLocal8Bit();
-        fd = open(fname.constData(), flags, mode);
+        fd = backend->Open(filename, flags, mode);
     }
 
     if (fd < 0)
@@ -133,7 +166,8 @@ bool ThreadedFileWriter::Open(void)
     gCoreContext->RegisterFileForWrite(filename);
     m_registered = true;
 
-    LOG(VB_FILE, LOG_INFO, LOC + "Open() successful");
+    LOG(VB_FILE, LOG_INFO, LOC + QString("Open() successful, using %1")
+        .arg(backend->GetName()));
 
 #ifdef _WIN32
     _setmode(fd, _O_BINARY);
@@ -180,12 +214,6 @@ ThreadedFileWriter::~ThreadedFileWriter()
         writeBuffers.pop_front();
     }
 
-    while (!emptyBuffers.empty())
-    {
-        delete emptyBuffers.front();
-        emptyBuffers.pop_front();
-    }
-
     if (syncThread)
     {
         syncThread->wait();
@@ -193,11 +221,13 @@ ThreadedFileWriter::~ThreadedFileWriter()
         syncThread = NULL;
     }
 
-    if (fd >= 0)
+    if (backend)
     {
-        close(fd);
-        fd = -1;
+        backend->Close();
+        delete backend;
+        backend = NULL;
     }
+    fd = -1;
 
     gCoreContext->UnregisterFileForWrite(filename);
     m_registered = false;
@@ -263,34 +293,36 @@ int ThreadedFileWriter::Write(const void *data, uint count)
         TFWBuffer *buf = NULL;
 
         if (!writeBuffers.empty() &&
-            (writeBuffers.back()->data.size() + towrite) < kMinWriteSize)
+            (writeBuffers.back()->size + towrite) < kMinWriteSize &&
+            (writeBuffers.back()->size + towrite) <= writeBuffers.back()->capacity)
         {
             buf = writeBuffers.back();
             writeBuffers.pop_back();
         }
         else
         {
-            if (!emptyBuffers.empty())
-            {
-                buf = emptyBuffers.front();
-                emptyBuffers.pop_front();
-                buf->data.clear();
-            }
-            else
+            // Size for the appends that follow small writes
+            buf = new TFWBuffer(max(towrite, kMinWriteSize));
+            if (!buf->data)
             {
-                buf = new TFWBuffer();
+                // the pool has logged it, what was written so far stays
+                LOG(VB_GENERAL, LOG_ERR, LOC +
+                    QString("Write(*, %1) failed, out of memory after %2")
+                    .arg(count).arg(written));
+                delete buf;
+                return -1;
             }
         }
 
         totalBufferUse += towrite;
 
         const char *cdata = (const char*) data + written;
-        buf->data.insert(buf->data.end(), cdata, cdata+towrite);
-        buf->lastUsed = MythDate::current();
+        memcpy(buf->data + buf->size, cdata, towrite);
+        buf->size += towrite;
 
         writeBuffers.push_back(buf);
 
-        if ((writeBuffers.size() > 1) || (buf->data.size() >= kMinWriteSize))
+        if ((writeBuffers.size() > 1) || (buf->size >= kMinWriteSize))
         {
             bufferHasData.wakeAll();
         }
@@ -320,7 +352,7 @@ long long ThreadedFileWriter::Seek(long long pos, int whence)
 {
     QMutexLocker locker(&buflock);
     flush = true;
-    while (!writeBuffers.empty())
+    while (!writeBuffers.empty() || backend_pending)
     {
         bufferHasData.wakeAll();
         if (!bufferEmpty.wait(locker.mutex(), 2000))
@@ -331,17 +363,20 @@ long long ThreadedFileWriter::Seek(long long pos, int whence)
         }
     }
     flush = false;
-    return lseek(fd, pos, whence);
+    return backend ? backend->Seek(pos, whence) : -1;
 }
 
 /** \fn ThreadedFileWriter::Flush(void)
  *  \brief Allow DiskLoop() to flush buffer completely ignoring low watermark.
+ *
+ *  Returns once the backend has drained, so the data is visible to
+ *  readers of the file.
  */
 void ThreadedFileWriter::Flush(void)
 {
     QMutexLocker locker(&buflock);
     flush = true;
-    while (!writeBuffers.empty())
+    while (!writeBuffers.empty() || backend_pending)
     {
         bufferHasData.wakeAll();
         if (!bufferEmpty.wait(locker.mutex(), 2000))
@@ -376,19 +411,38 @@ void ThreadedFileWriter::Flush(void)
  */
 void ThreadedFileWriter::Sync(void)
 {
-    if (fd >= 0)
+    if (backend)
+        backend->Sync();
+}
+
+/** \brief Selects the TFWBackend by name, "write", "pwritev" or "io_uring".
+ *
+ *  Takes effect on the next Open(), an unavailable backend falls back
+ *  to the nearest one available. Overrides the "TFWWriteBackend" setting.
+ */
+void ThreadedFileWriter::SetWriteBackend(const QString &name)
+{
+    QMutexLocker locker(&buflock);
+    backend_name = name;
+    if (backend && fd < 0)
     {
-#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
-        // fdatasync tries to avoid updating metadata, but will in
-        // practice always update metadata if any data is written
-        // as the file will usually have grown.
-        fdatasync(fd);
-#else
-        fsync(fd);
-#endif
+        delete backend;
+        backend = NULL;
     }
 }
 
+QString ThreadedFileWriter::GetWriteBackend(void) const
+{
+    QMutexLocker locker(&buflock);
+    return backend ? backend->GetName() : backend_name;
+}
+
+/// Names of the backends available in this build
+QStringList ThreadedFileWriter::GetWriteBackends(void)
+{
+    return TFWBackend::GetAvailable();
+}
+
 /** \fn ThreadedFileWriter::SetWriteBufferMinWriteSize(uint)
  *  \brief Sets the minumum number of bytes to write to disk in a single write.
  *         This is ignored during a Flush(void)
@@ -440,9 +494,10 @@ void ThreadedFileWriter::DiskLoop(void)
     // Even if the bytes buffered is less than the minimum write
     // size we do want to write to the OS buffers periodically.
     // This timer makes sure we do.
-    MythTimer minWriteTimer, lastRegisterTimer;
+    MythTimer minWriteTimer, lastRegisterTimer, drainTimer;
     minWriteTimer.start();
     lastRegisterTimer.start();
+    drainTimer.start();
 
     uint64_t total_written = 0LL;
 
@@ -455,11 +510,7 @@ void ThreadedFileWriter::DiskLoop(void)
                 delete writeBuffers.front();
                 writeBuffers.pop_front();
             }
-            while (!emptyBuffers.empty())
-            {
-                delete emptyBuffers.front();
-                emptyBuffers.pop_front();
-            }
+            backend_pending = false;
             bufferEmpty.wakeAll();
             bufferHasData.wait(locker.mutex());
             continue;
@@ -467,9 +518,34 @@ void ThreadedFileWriter::DiskLoop(void)
 
         if (writeBuffers.empty())
         {
+            int wait = 1000;
+            if (backend_pending)
+            {
+                // Flush(), Seek() and ReOpen() wait for everything
+                // queued to reach the file. Otherwise what the backend
+                // holds is written out every 250 ms like the buffers
+                // below, so readers of a recording in progress see it,
+                // and in between the completed writes are collected.
+                int dte = drainTimer.elapsed();
+                bool drain = flush || (dte >= 250);
+                locker.unlock();
+                bool ok = drain ? backend->Drain() : backend->Poll();
+                locker.relock();
+                if (drain)
+                {
+                    backend_pending = false;
+                    drainTimer.start();
+                }
+                else
+                {
+                    wait = 250 - dte;
+                }
+                if (!ok)
+                    write_failed = true;
+            }
             bufferEmpty.wakeAll();
-            bufferHasData.wait(locker.mutex(), 1000);
-            TrimEmptyBuffers();
+            bufferHasData.wait(locker.mutex(), wait);
+            TFWBufferPool::GetPool()->Trim();
             continue;
         }
 
@@ -477,27 +553,28 @@ void ThreadedFileWriter::DiskLoop(void)
         if (!flush && (mwte < 250) && (totalBufferUse < kMinWriteSize))
         {
             bufferHasData.wait(locker.mutex(), 250 - mwte);
-            TrimEmptyBuffers();
+            TFWBufferPool::GetPool()->Trim();
             continue;
         }
 
         if (fd == -1)
         {
             bufferHasData.wait(locker.mutex(), 200);
-            TrimEmptyBuffers();
+            TFWBufferPool::GetPool()->Trim();
             continue;
         }
 
         TFWBuffer *buf = writeBuffers.front();
         writeBuffers.pop_front();
-        totalBufferUse -= buf->data.size();
+        totalBufferUse -= buf->size;
+        backend_pending = true; // until drained, for Flush()
         bufferWasFreed.wakeAll();
         minWriteTimer.start();
 
         //////////////////////////////////////////
 
-        const void *data = &(buf->data[0]);
-        uint sz = buf->data.size();
+        const void *data = buf->data;
+        uint sz = buf->size;
 
         bool write_ok = true;
         uint tot = 0;
@@ -514,7 +591,7 @@ void ThreadedFileWriter::DiskLoop(void)
         {
             locker.unlock();
 
-            int ret = write(fd, (char *)data + tot, sz - tot);
+            int ret = backend->Write((const char *)data + tot, sz - tot);
 
             if (ret < 0)
             {
@@ -560,8 +637,23 @@ void ThreadedFileWriter::DiskLoop(void)
             lastRegisterTimer.restart();
         }
 
-        buf->lastUsed = MythDate::current();
-        emptyBuffers.push_back(buf);
+        delete buf;
+
+        if (!write_ok)
+            write_failed = true;
+
+        // Under a steady load the loop is never idle, still let readers
+        // see what the backend holds every 250 ms
+        if (write_ok && backend_pending && (drainTimer.elapsed() >= 250))
+        {
+            locker.unlock();
+            bool ok = backend->Drain();
+            locker.relock();
+            backend_pending = false;
+            drainTimer.start();
+            if (!ok)
+                write_failed = true;
+        }
 
         if (writeTimer.elapsed() > 1000)
         {
@@ -604,26 +696,6 @@ void ThreadedFileWriter::DiskLoop(void)
     }
 }
 
-void ThreadedFileWriter::TrimEmptyBuffers(void)
-{
-    QDateTime cur = MythDate::current();
-    QDateTime cur_m_60 = cur.addSecs(-60);
-
-    QList<TFWBuffer*>::iterator it = emptyBuffers.begin();
-    while (it != emptyBuffers.end())
-    {
-        if (((*it)->lastUsed < cur_m_60) ||
-            ((*it)->data.capacity() > 3 * (*it)->data.size() &&
-             (*it)->data.capacity() > 64 * 1024))
-        {
-            delete *it;
-            it = emptyBuffers.erase(it);
-            continue;
-        }
-        ++it;
-    }
-}
-
 /** \fn ThreadedFileWriter::SetBlocking(void)
  *  \brief Set write blocking mode
  *  While in blocking mode, ThreadedFileWriter::Write will wait for buffers
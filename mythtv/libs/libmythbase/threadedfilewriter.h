@@ -7,6 +7,7 @@ using namespace std;
 
 #include <QWaitCondition>
 #include <QDateTime>
+#include <QStringList>
 #include <QString>
 #include <QMutex>
 
@@ -17,6 +18,7 @@ using namespace std;
 #include "mthread.h"
 
 class ThreadedFileWriter;
+class TFWBackend;
 
 class TFWWriteThread : public MThread
 {
@@ -53,16 +55,18 @@ class MBASE_PUBLIC ThreadedFileWriter
     int Write(const void *data, uint count);
 
     void SetWriteBufferMinWriteSize(uint newMinSize = kMinWriteSize);
+    void SetWriteBackend(const QString &name);
+    QString GetWriteBackend(void) const;
+    static QStringList GetWriteBackends(void);
 
     void Sync(void);
     void Flush(void);
     bool SetBlocking(bool block = true);
-    bool WritesFailing(void) const { return ignore_writes; }
+    bool WritesFailing(void) const { return ignore_writes || write_failed; }
 
   protected:
     void DiskLoop(void);
     void SyncLoop(void);
-    void TrimEmptyBuffers(void);
 
   private:
     // file info
@@ -70,6 +74,8 @@ class MBASE_PUBLIC ThreadedFileWriter
     int             flags;
     mode_t          mode;
     int             fd;
+    QString         backend_name;
+    TFWBackend     *backend;
 
     // state
     bool            flush;              // protected by buflock
@@ -77,17 +83,21 @@ class MBASE_PUBLIC ThreadedFileWriter
     bool            ignore_writes;      // protected by buflock
     uint            tfw_min_write_size; // protected by buflock
     uint            totalBufferUse;     // protected by buflock
+    bool            backend_pending;    // protected by buflock
+    bool            write_failed;       // protected by buflock
 
-    // buffers
+    // buffers, the memory comes from the TFWBufferPool
     class TFWBuffer
     {
       public:
-        vector<char> data;
-        QDateTime    lastUsed;
+        explicit TFWBuffer(uint min_capacity);
+        ~TFWBuffer();
+        char *data;
+        uint  size;
+        uint  capacity;
     };
     mutable QMutex    buflock;
     QList<TFWBuffer*> writeBuffers;     // protected by buflock
-    QList<TFWBuffer*> emptyBuffers;     // protected by buflock
 
     // threads
     TFWWriteThread *writeThread;
@@ -0,0 +1,566 @@
+// ANSI C headers
+#include <cstdlib>
+#include <cerrno>
+
+// Unix C headers
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+#ifdef USING_LIBURING
+#include <liburing.h>
+#endif
+
+#include <algorithm>
+using namespace std;
+
+// MythTV headers
+#include "threadedfilewriterbackend.h"
+#include "mythlogging.h"
+#include "compat.h"
+
+#if defined(O_DIRECT) && !defined(_WIN32)
+#define USING_TFW_DIRECT 1
+#endif
+
+#define LOC QString("TFWBackend(%1:%2): ").arg(GetName()).arg(m_fd)
+
+/** \brief Returns the backend called name.
+ *
+ *  "write" is plain write(2), "pwritev" and "io_uring" write through
+ *  O_DIRECT. Unknown or unsupported names fall back to the nearest
+ *  available backend.
+ */
+TFWBackend *TFWBackend::Create(const QString &name)
+{
+#ifdef USING_TFW_DIRECT
+    if (name == "io_uring")
+    {
+#ifdef USING_LIBURING
+        return new TFWDirectBackend(true);
+#else
+        LOG(VB_GENERAL, LOG_WARNING, "TFWBackend: io_uring support "
+            "not compiled in, using pwritev");
+        return new TFWDirectBackend(false);
+#endif
+    }
+    if (name == "pwritev")
+        return new TFWDirectBackend(false);
+#endif
+
+    if (!name.isEmpty() && name != "write")
+    {
+        LOG(VB_GENERAL, LOG_WARNING,
+            QString("TFWBackend: '%1' is not available, using write")
+            .arg(name));
+    }
+    return new TFWBufferedBackend();
+}
+
+QStringList TFWBackend::GetAvailable(void)
+{
+    QStringList list;
+    list << "write";
+#ifdef USING_TFW_DIRECT
+    list << "pwritev";
+#endif
+#ifdef USING_LIBURING
+    list << "io_uring";
+#endif
+    return list;
+}
+
+/// \brief Syncs data written to the file descriptor to disk.
+void TFWBackend::Sync(void)
+{
+    if (m_fd >= 0)
+    {
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+        // fdatasync tries to avoid updating metadata, but will in
+        // practice always update metadata if any data is written
+        // as the file will usually have grown.
+        fdatasync(m_fd);
+#else
+        fsync(m_fd);
+#endif
+    }
+}
+
+int TFWBufferedBackend::Open(const QString &filename, int flags, mode_t mode)
+{
+    QByteArray fname = filename.toLocal8Bit();
+    m_error = 0;
+    m_fd = open(fname.constData(), flags, mode);
+    return m_fd;
+}
+
+void TFWBufferedBackend::Close(void)
+{
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+}
+
+int TFWBufferedBackend::Write(const char *data, uint count)
+{
+    int ret = write(m_fd, data, count);
+    if (ret < 0 && errno != EAGAIN)
+        m_error = errno;
+    return ret;
+}
+
+long long TFWBufferedBackend::Seek(long long pos, int whence)
+{
+    return lseek(m_fd, pos, whence);
+}
+
+#ifdef USING_TFW_DIRECT
+
+const uint TFWDirectBackend::kAlignment;
+const uint TFWDirectBackend::kChunkSize;
+const uint TFWDirectBackend::kMaxInFlight;
+
+/// Writes all of len at off, returns 0 or the errno of the failure
+static int pwrite_all(int fd, const char *buf, uint len, long long off)
+{
+    uint done = 0;
+    while (done < len)
+    {
+        ssize_t ret = pwrite(fd, buf + done, len - done, off + done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return errno;
+        if (ret == 0)
+            return EIO;
+        done += ret;
+    }
+    return 0;
+}
+
+TFWDirectBackend::TFWDirectBackend(bool use_uring) :
+    m_use_uring(use_uring), m_degraded(true), m_tail_fd(-1),
+    m_cur(-1), m_in_flight(0), m_offset(0), m_ring(NULL)
+{
+}
+
+TFWDirectBackend::~TFWDirectBackend()
+{
+    Close();
+    for (uint i = 0; i < m_chunks.size(); ++i)
+        free(m_chunks[i].buf);
+    m_chunks.clear();
+}
+
+QString TFWDirectBackend::GetName(void) const
+{
+    return m_use_uring ? "io_uring" : "pwritev";
+}
+
+int TFWDirectBackend::Open(const QString &filename, int flags, mode_t mode)
+{
+    QByteArray fname = filename.toLocal8Bit();
+
+    m_error     = 0;
+    m_offset    = 0;
+    m_cur       = -1;
+    m_in_flight = 0;
+    m_pending.clear();
+
+    // pwrite(2) ignores the offset on O_APPEND files
+    m_degraded = (flags & O_APPEND);
+
+    if (m_chunks.empty() && !m_degraded)
+    {
+        for (uint i = 0; i < kMaxInFlight + 1; ++i)
+        {
+            void *buf = NULL;
+            if (posix_memalign(&buf, kAlignment, kChunkSize))
+            {
+                LOG(VB_GENERAL, LOG_ERR, LOC +
+                    "Could not allocate aligned buffers");
+                m_degraded = true;
+                break;
+            }
+            Chunk c = { (char*) buf, 0, 0, false };
+            m_chunks.push_back(c);
+        }
+    }
+
+    if (!m_degraded)
+    {
+        m_fd = open(fname.constData(), flags | O_DIRECT, mode);
+        if (m_fd < 0 && errno != EINVAL)
+            return -1;
+        if (m_fd < 0)
+        {
+            LOG(VB_FILE, LOG_INFO, LOC + QString("'%1' does not support "
+                "O_DIRECT, using buffered writes").arg(filename));
+            m_degraded = true;
+        }
+    }
+
+    if (!m_degraded)
+    {
+        int tflags = flags & ~(O_CREAT | O_EXCL | O_TRUNC);
+        m_tail_fd = open(fname.constData(), tflags, mode);
+        if (m_tail_fd < 0)
+        {
+            LOG(VB_GENERAL, LOG_WARNING, LOC +
+                "Could not open tail descriptor, using buffered writes" + ENO);
+            close(m_fd);
+            m_degraded = true;
+            flags &= ~O_EXCL;
+        }
+    }
+
+#ifdef USING_LIBURING
+    if (!m_degraded && m_use_uring && !m_ring)
+    {
+        m_ring = new struct io_uring;
+        int ret = io_uring_queue_init(kMaxInFlight, m_ring, 0);
+        if (ret < 0)
+        {
+            delete m_ring;
+            m_ring = NULL;
+            LOG(VB_GENERAL, LOG_WARNING, LOC + QString("io_uring setup "
+                "failed: %1, using pwritev").arg(strerror(-ret)));
+            m_use_uring = false;
+        }
+    }
+#endif
+
+    if (m_degraded)
+        m_fd = open(fname.constData(), flags, mode);
+
+    return m_fd;
+}
+
+void TFWDirectBackend::Attach(int fd)
+{
+    m_fd       = fd;
+    m_error    = 0;
+    m_degraded = true;
+}
+
+void TFWDirectBackend::Close(void)
+{
+    if (m_fd >= 0 && !m_degraded)
+        Drain();
+
+#ifdef USING_LIBURING
+    if (m_ring)
+    {
+        io_uring_queue_exit(m_ring);
+        delete m_ring;
+        m_ring = NULL;
+    }
+#endif
+
+    if (m_tail_fd >= 0)
+        close(m_tail_fd);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_tail_fd   = -1;
+    m_fd        = -1;
+    m_cur       = -1;
+    m_in_flight = 0;
+    m_pending.clear();
+    for (uint i = 0; i < m_chunks.size(); ++i)
+        m_chunks[i].busy = false;
+}
+
+int TFWDirectBackend::Write(const char *data, uint count)
+{
+    if (m_degraded)
+    {
+        int ret = write(m_fd, data, count);
+        if (ret < 0 && errno != EAGAIN)
+            m_error = errno;
+        return ret;
+    }
+
+    // Errors from earlier asynchronous writes are reported here
+    if (m_error)
+    {
+        errno = m_error;
+        return -1;
+    }
+
+    uint done = 0;
+    while (done < count)
+    {
+        if (m_cur < 0)
+        {
+            m_cur = NextFreeChunk();
+            if (m_cur < 0)
+                break;
+            m_chunks[m_cur].offset = m_offset;
+            m_chunks[m_cur].len    = 0;
+        }
+
+        Chunk &c = m_chunks[m_cur];
+        uint n = min(count - done, kChunkSize - c.len);
+        memcpy(c.buf + c.len, data + done, n);
+        c.len += n;
+        done  += n;
+
+        if (c.len == kChunkSize)
+        {
+            m_offset = c.offset + c.len;
+            uint idx = m_cur;
+            m_cur = -1;
+            if (!Submit(idx))
+                break;
+        }
+    }
+
+    if (!done && m_error)
+    {
+        errno = m_error;
+        return -1;
+    }
+    return done;
+}
+
+bool TFWDirectBackend::Drain(void)
+{
+    if (m_degraded || m_fd < 0)
+        return true;
+
+    if (!(m_use_uring ? Reap(true) : WritePending()))
+        return false;
+
+    if (m_cur < 0)
+        return true;
+
+    Chunk &c = m_chunks[m_cur];
+    uint aligned = c.len & ~(kAlignment - 1);
+    if (aligned)
+    {
+        int err = pwrite_all(m_fd, c.buf, aligned, c.offset);
+        if (err)
+            return SetError(err);
+        memmove(c.buf, c.buf + aligned, c.len - aligned);
+        c.len    -= aligned;
+        c.offset += aligned;
+    }
+
+    if (c.len)
+    {
+        int err = pwrite_all(m_tail_fd, c.buf, c.len, c.offset);
+        if (err)
+            return SetError(err);
+    }
+
+    return true;
+}
+
+/** \brief Frees the chunks of io_uring writes which have completed.
+ *
+ *  Chunks queued for pwritev(2) stay queued, they are written once
+ *  enough have gathered or on Drain().
+ */
+bool TFWDirectBackend::Poll(void)
+{
+    if (m_degraded || m_fd < 0)
+        return !m_error;
+
+    return m_use_uring ? Reap(true, false) : !m_error;
+}
+
+long long TFWDirectBackend::Seek(long long pos, int whence)
+{
+    if (!m_degraded && m_fd >= 0)
+    {
+        Drain();
+
+        long long end = m_offset;
+        if (m_cur >= 0)
+            end = m_chunks[m_cur].offset + m_chunks[m_cur].len;
+
+        // Random access writes can't be staged in aligned chunks,
+        // continue with buffered writes from the current end.
+        int fl = fcntl(m_fd, F_GETFL);
+        if (fl < 0 || fcntl(m_fd, F_SETFL, fl & ~O_DIRECT) < 0)
+            LOG(VB_GENERAL, LOG_ERR, LOC + "Could not clear O_DIRECT" + ENO);
+        lseek(m_fd, end, SEEK_SET);
+
+        if (m_tail_fd >= 0)
+            close(m_tail_fd);
+        m_tail_fd  = -1;
+        m_cur      = -1;
+        m_degraded = true;
+
+        LOG(VB_FILE, LOG_INFO, LOC + "Seek, continuing with buffered writes");
+    }
+
+    return lseek(m_fd, pos, whence);
+}
+
+bool TFWDirectBackend::SetError(int err)
+{
+    if (!m_error)
+    {
+        m_error = err;
+        LOG(VB_GENERAL, LOG_ERR, LOC + QString("Write failed: %1")
+            .arg(strerror(err)));
+    }
+    return false;
+}
+
+int TFWDirectBackend::NextFreeChunk(void)
+{
+    while (true)
+    {
+        for (uint i = 0; i < m_chunks.size(); ++i)
+        {
+            if (!m_chunks[i].busy && (int)i != m_cur)
+                return i;
+        }
+        if (!(m_use_uring ? Reap(false) : WritePending()))
+            return -1;
+    }
+}
+
+/// Queues a full chunk, may block while kMaxInFlight writes are pending
+bool TFWDirectBackend::Submit(uint idx)
+{
+    Chunk &c = m_chunks[idx];
+    c.busy = true;
+
+#ifdef USING_LIBURING
+    if (m_use_uring)
+    {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(m_ring);
+        while (!sqe)
+        {
+            if (!Reap(false))
+            {
+                c.busy = false;
+                return false;
+            }
+            sqe = io_uring_get_sqe(m_ring);
+        }
+        io_uring_prep_write(sqe, m_fd, c.buf, c.len, c.offset);
+        io_uring_sqe_set_data(sqe, (void*)(intptr_t) idx);
+        int ret = io_uring_submit(m_ring);
+        if (ret < 0)
+        {
+            c.busy = false;
+            return SetError(-ret);
+        }
+        m_in_flight++;
+        return true;
+    }
+#endif
+
+    m_pending.push_back(idx);
+    if (m_pending.size() >= kMaxInFlight)
+        return WritePending();
+    return true;
+}
+
+/** \brief Waits for one (or all) io_uring completions
+ *
+ *  Unless block is set only completions already queued are collected.
+ */
+bool TFWDirectBackend::Reap(bool wait_all, bool block)
+{
+#ifdef USING_LIBURING
+    while (m_in_flight > 0)
+    {
+        struct io_uring_cqe *cqe = NULL;
+        int ret = block ? io_uring_wait_cqe(m_ring, &cqe) :
+                          io_uring_peek_cqe(m_ring, &cqe);
+        if (ret == -EAGAIN && !block)
+            break;
+        if (ret == -EINTR)
+            continue;
+        if (ret < 0)
+            return SetError(-ret);
+
+        uint idx = (uint)(intptr_t) io_uring_cqe_get_data(cqe);
+        int  res = cqe->res;
+        io_uring_cqe_seen(m_ring, cqe);
+        m_in_flight--;
+
+        Chunk &c = m_chunks[idx];
+        if (res < 0)
+            SetError(-res);
+        else if ((uint)res < c.len)
+        {
+            // short write, finish it synchronously
+            int err = pwrite_all(m_fd, c.buf + res, c.len - res,
+                                 c.offset + res);
+            if (err)
+                SetError(err);
+        }
+        c.busy = false;
+
+        if (!wait_all)
+            break;
+    }
+#else
+    (void) wait_all;
+    (void) block;
+#endif
+    return !m_error;
+}
+
+/// Writes all queued chunks with one pwritev(2)
+bool TFWDirectBackend::WritePending(void)
+{
+    if (m_pending.empty())
+        return !m_error;
+
+    struct iovec iov[kMaxInFlight];
+    uint cnt = m_pending.size();
+    long long off = m_chunks[m_pending[0]].offset;
+    for (uint i = 0; i < cnt; ++i)
+    {
+        iov[i].iov_base = m_chunks[m_pending[i]].buf;
+        iov[i].iov_len  = m_chunks[m_pending[i]].len;
+    }
+
+    uint first = 0;
+    while (first < cnt && !m_error)
+    {
+        ssize_t ret = pwritev(m_fd, iov + first, cnt - first, off);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+        {
+            SetError(ret < 0 ? errno : EIO);
+            break;
+        }
+        off += ret;
+        while (ret > 0 && first < cnt)
+        {
+            if ((size_t)ret >= iov[first].iov_len)
+            {
+                ret -= iov[first].iov_len;
+                first++;
+            }
+            else
+            {
+                iov[first].iov_base = (char*) iov[first].iov_base + ret;
+                iov[first].iov_len -= ret;
+                ret = 0;
+            }
+        }
+    }
+
+    for (uint i = 0; i < cnt; ++i)
+        m_chunks[m_pending[i]].busy = false;
+    m_pending.clear();
+
+    return !m_error;
+}
+
+#endif // USING_TFW_DIRECT
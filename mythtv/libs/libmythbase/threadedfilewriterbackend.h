@@ -0,0 +1,140 @@
+// -*- Mode: c++ -*-
+#ifndef TFW_BACKEND_H_
+#define TFW_BACKEND_H_
+
+#include <vector>
+using namespace std;
+
+#include <QStringList>
+#include <QString>
+
+#include <sys/types.h>
+#include <stdint.h>
+
+struct io_uring;
+
+/** \class TFWBackend
+ *  \brief Gets the buffers of a ThreadedFileWriter to disk.
+ *
+ *  Write() has write(2) semantics: it returns the number of bytes
+ *  accepted or -1 with errno set. A backend may keep accepted bytes
+ *  queued; Drain() waits for them and makes everything written so
+ *  far visible to readers of the file, the writer calls it at least
+ *  every 250 ms while anything is queued. Poll() only collects writes
+ *  which have already completed, and never waits.
+ *
+ *  Write(), Poll() and Drain() are only called from the TFWWriteThread. Open(),
+ *  Close() and Seek() are called with that thread idle. Sync() may be
+ *  called at any time from the TFWSyncThread.
+ */
+class TFWBackend
+{
+  public:
+    static TFWBackend *Create(const QString &name);
+    static QStringList GetAvailable(void);
+
+    virtual ~TFWBackend() {}
+
+    virtual QString GetName(void) const = 0;
+
+    /// Opens the file, returns the file descriptor or -1 and sets errno
+    virtual int Open(const QString &filename, int flags, mode_t mode) = 0;
+    /// Uses an already open descriptor, e.g. stdout
+    virtual void Attach(int fd) = 0;
+    virtual void Close(void) = 0;
+
+    virtual int  Write(const char *data, uint count) = 0;
+    virtual bool Drain(void) = 0;
+    /// Collects completed writes, returns false on an earlier error
+    virtual bool Poll(void) { return !m_error; }
+    virtual long long Seek(long long pos, int whence) = 0;
+    virtual void Sync(void);
+
+    int GetFD(void) const { return m_fd; }
+    /// Last error reported by the backend, 0 if none
+    int GetError(void) const { return m_error; }
+
+  protected:
+    TFWBackend() : m_fd(-1), m_error(0) {}
+
+    int m_fd;
+    int m_error;
+};
+
+/// Plain buffered write(2) backend, the default.
+class TFWBufferedBackend : public TFWBackend
+{
+  public:
+    QString GetName(void) const { return "write"; }
+    int  Open(const QString &filename, int flags, mode_t mode);
+    void Attach(int fd) { m_fd = fd; m_error = 0; }
+    void Close(void);
+    int  Write(const char *data, uint count);
+    bool Drain(void) { return true; }
+    long long Seek(long long pos, int whence);
+};
+
+/** \class TFWDirectBackend
+ *  \brief Writes through O_DIRECT with aligned buffers.
+ *
+ *  Data is staged in kChunkSize aligned chunks; full chunks are
+ *  submitted to io_uring when available, otherwise up to
+ *  kMaxInFlight of them are gathered into one pwritev(2). At most
+ *  kMaxInFlight chunks are outstanding per file, when all are busy
+ *  Write() waits for the oldest to complete.
+ *
+ *  Drain() writes the aligned part of the partial chunk directly and
+ *  the unaligned tail through a second, buffered descriptor so readers
+ *  see every byte. The tail stays staged and is rewritten directly once
+ *  its chunk fills up.
+ *
+ *  If the file system refuses O_DIRECT, the file was opened with
+ *  O_APPEND, or the writer seeks, the backend degrades to plain
+ *  write(2) for the rest of the file.
+ */
+class TFWDirectBackend : public TFWBackend
+{
+  public:
+    explicit TFWDirectBackend(bool use_uring);
+    ~TFWDirectBackend();
+
+    QString GetName(void) const;
+    int  Open(const QString &filename, int flags, mode_t mode);
+    void Attach(int fd);
+    void Close(void);
+    int  Write(const char *data, uint count);
+    bool Drain(void);
+    bool Poll(void);
+    long long Seek(long long pos, int whence);
+
+    static const uint kAlignment  = 4096;
+    static const uint kChunkSize  = 1024 * 1024;
+    static const uint kMaxInFlight = 4;
+
+  private:
+    struct Chunk
+    {
+        char     *buf;
+        long long offset;
+        uint      len;
+        bool      busy;
+    };
+
+    bool Submit(uint idx);
+    bool Reap(bool wait_all, bool block = true);
+    bool WritePending(void);
+    bool SetError(int err);
+    int  NextFreeChunk(void);
+
+    bool           m_use_uring;
+    bool           m_degraded;   ///< plain write(2) on m_fd
+    int            m_tail_fd;    ///< buffered descriptor for partial blocks
+    vector<Chunk>  m_chunks;
+    int            m_cur;        ///< chunk being filled, -1 if none
+    uint           m_in_flight;
+    vector<uint>   m_pending;    ///< full chunks queued for pwritev
+    long long      m_offset;     ///< file offset of the next chunk
+    struct io_uring *m_ring;     ///< NULL unless io_uring is in use
+};
+
+#endif
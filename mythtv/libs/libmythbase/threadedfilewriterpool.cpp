@@ -0,0 +1,181 @@
+// ANSI C headers
+#include <cstdlib>
+
+#include <algorithm>
+using namespace std;
+
+// MythTV headers
+#include "threadedfilewriterpool.h"
+#include "mythlogging.h"
+
+#define LOC QString("TFWBufferPool: ")
+
+const uint TFWBufferPool::kMinClassSize;
+const uint TFWBufferPool::kMaxClassSize;
+const uint TFWBufferPool::kNumClasses;
+const uint TFWBufferPool::kDefaultCap;
+const int  TFWBufferPool::kMaxIdleTime;
+
+TFWBufferPool *TFWBufferPool::GetPool(void)
+{
+    // Never destroyed, ThreadedFileWriters may outlive static destructors
+    static TFWBufferPool *pool = new TFWBufferPool();
+    return pool;
+}
+
+TFWBufferPool::TFWBufferPool()
+{
+    m_stats.cap = kDefaultCap;
+    m_clock.start();
+}
+
+/// Returns the size class for size, -1 if it is too large to pool
+int TFWBufferPool::SizeClass(uint size)
+{
+    uint class_size = kMinClassSize;
+    for (uint i = 0; i < kNumClasses; ++i, class_size <<= 1)
+    {
+        if (size <= class_size)
+            return i;
+    }
+    return -1;
+}
+
+/** \brief Returns a block of at least size bytes, or NULL with a
+ *         capacity of 0 if it could not be allocated.
+ *
+ *  \param capacity set to the usable size of the block, which must
+ *                  be passed back to Put()
+ */
+char *TFWBufferPool::Get(uint size, uint &capacity)
+{
+    int cls = SizeClass(size);
+    capacity = (cls < 0) ? size : (kMinClassSize << cls);
+
+    QMutexLocker locker(&m_lock);
+
+    m_stats.in_use += capacity;
+
+    if (cls >= 0 && !m_free[cls].empty())
+    {
+        char *block = m_free[cls].back().data;
+        m_free[cls].pop_back();
+        m_stats.pooled -= capacity;
+        m_stats.reuses++;
+        UpdateMax();
+        return block;
+    }
+
+    m_stats.allocs++;
+    UpdateMax();
+    locker.unlock();
+
+    char *block = (char*) malloc(capacity);
+    if (!block)
+    {
+        LOG(VB_GENERAL, LOG_CRIT, LOC +
+            QString("Could not allocate %1 bytes").arg(capacity));
+        locker.relock();
+        m_stats.in_use -= capacity;
+        m_stats.allocs--;
+        capacity = 0;
+    }
+    return block;
+}
+
+void TFWBufferPool::Put(char *block, uint capacity)
+{
+    if (!block)
+        return;
+
+    int cls = SizeClass(capacity);
+
+    QMutexLocker locker(&m_lock);
+
+    m_stats.in_use -= capacity;
+
+    if (cls >= 0 && (kMinClassSize << cls) == capacity &&
+        m_stats.pooled + capacity <= m_stats.cap)
+    {
+        m_free[cls].push_back(Block(block, m_clock.elapsed()));
+        m_stats.pooled += capacity;
+        UpdateMax();
+        return;
+    }
+
+    m_stats.frees++;
+    locker.unlock();
+
+    free(block);
+}
+
+/// Frees pooled blocks that have not been used for kMaxIdleTime
+void TFWBufferPool::Trim(void)
+{
+    vector<char*> expired;
+
+    {
+        QMutexLocker locker(&m_lock);
+        qint64 now = m_clock.elapsed();
+        for (uint i = 0; i < kNumClasses; ++i)
+        {
+            // the least recently released blocks are at the front
+            vector<Block>::iterator it = m_free[i].begin();
+            while (it != m_free[i].end() &&
+                   (now - it->released) > kMaxIdleTime)
+            {
+                expired.push_back(it->data);
+                ++it;
+            }
+            uint cnt = it - m_free[i].begin();
+            m_stats.pooled -= (uint64_t) cnt * (kMinClassSize << i);
+            m_stats.frees  += cnt;
+            m_free[i].erase(m_free[i].begin(), it);
+        }
+    }
+
+    for (uint i = 0; i < expired.size(); ++i)
+        free(expired[i]);
+}
+
+/// Limits the memory kept pooled, blocks beyond it are freed
+void TFWBufferPool::SetCap(uint64_t bytes)
+{
+    vector<char*> excess;
+
+    {
+        QMutexLocker locker(&m_lock);
+        m_stats.cap = bytes;
+        for (uint i = kNumClasses; i-- > 0 && m_stats.pooled > bytes;)
+        {
+            while (!m_free[i].empty() && m_stats.pooled > bytes)
+            {
+                excess.push_back(m_free[i].front().data);
+                m_free[i].erase(m_free[i].begin());
+                m_stats.pooled -= kMinClassSize << i;
+                m_stats.frees++;
+            }
+        }
+    }
+
+    for (uint i = 0; i < excess.size(); ++i)
+        free(excess[i]);
+
+    LOG(VB_FILE, LOG_INFO, LOC + QString("Pooling at most %1 MB")
+        .arg(bytes >> 20));
+}
+
+TFWBufferPoolStats TFWBufferPool::GetStats(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
+
+/// Must be called with m_lock held
+void TFWBufferPool::UpdateMax(void)
+{
+    m_stats.in_use_max = max(m_stats.in_use_max, m_stats.in_use);
+    m_stats.pooled_max = max(m_stats.pooled_max, m_stats.pooled);
+    m_stats.total_max  = max(m_stats.total_max,
+                             m_stats.in_use + m_stats.pooled);
+}
@@ -0,0 +1,83 @@
+// -*- Mode: c++ -*-
+#ifndef TFW_POOL_H_
+#define TFW_POOL_H_
+
+#include <vector>
+using namespace std;
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <stdint.h>
+
+#include "mythbaseexp.h"
+
+/// Snapshot of the TFWBufferPool counters, sizes are in bytes
+class MBASE_PUBLIC TFWBufferPoolStats
+{
+  public:
+    TFWBufferPoolStats() :
+        in_use(0), in_use_max(0), pooled(0), pooled_max(0),
+        total_max(0), cap(0), allocs(0), reuses(0), frees(0) {}
+
+    uint64_t in_use;      ///< handed out to ThreadedFileWriters
+    uint64_t in_use_max;
+    uint64_t pooled;      ///< free blocks kept for reuse
+    uint64_t pooled_max;
+    uint64_t total_max;   ///< high-water mark of in_use + pooled
+    uint64_t cap;         ///< limit on pooled
+    uint64_t allocs;      ///< blocks taken from the heap
+    uint64_t reuses;      ///< blocks taken from the pool
+    uint64_t frees;       ///< blocks returned to the heap
+};
+
+/** \class TFWBufferPool
+ *  \brief Process wide pool of ThreadedFileWriter write buffers.
+ *
+ *  Blocks come in power of two size classes from kMinClassSize to
+ *  kMaxClassSize. Released blocks are kept per class and handed out
+ *  again most recently used first, so a steady recording load is
+ *  served without touching the heap. At most the cap is kept pooled,
+ *  and blocks that have sat unused for kMaxIdleTime are freed by
+ *  Trim(), so the pool shrinks back after a burst.
+ */
+class MBASE_PUBLIC TFWBufferPool
+{
+  public:
+    static TFWBufferPool *GetPool(void);
+
+    char *Get(uint size, uint &capacity);
+    void  Put(char *block, uint capacity);
+    void  Trim(void);
+
+    void  SetCap(uint64_t bytes);
+    TFWBufferPoolStats GetStats(void) const;
+
+    static const uint kMinClassSize = 64 * 1024;
+    static const uint kMaxClassSize = 1024 * 1024;
+    static const uint kNumClasses   = 5;
+    static const uint kDefaultCap   = 64 * 1024 * 1024;
+    /// milliseconds a pooled block may stay unused
+    static const int  kMaxIdleTime  = 5 * 60 * 1000;
+
+  private:
+    TFWBufferPool();
+
+    static int SizeClass(uint size);
+    void UpdateMax(void);
+
+    class Block
+    {
+      public:
+        Block(char *d, qint64 t) : data(d), released(t) {}
+        char   *data;
+        qint64  released;   ///< m_clock time of Put()
+    };
+
+    mutable QMutex     m_lock;
+    vector<Block>      m_free[kNumClasses];  ///< most recent last
+    QElapsedTimer      m_clock;
+    TFWBufferPoolStats m_stats;
+};
+
+#endif
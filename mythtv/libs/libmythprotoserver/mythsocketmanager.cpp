@@ -374,8 +374,15 @@ void MythSocketManager::HandleVersion(MythSocket *socket,
     }
 
     LOG(VB_SOCKET, LOG_DEBUG, LOC + "Client validated");
+    // A client that asks for the binary framing gets it once it has
+    // read this reply, which still goes out in the legacy one
+    bool binary = slist.contains(MythSocket::kBinaryFramingToken);
+
     retlist << "ACCEPT" << MYTH_PROTO_VERSION;
+    if (binary)
+        retlist << MythSocket::kBinaryFramingToken;
     socket->WriteStringList(retlist);
+    socket->SetBinaryFraming(binary);
     socket->m_isValidated = true;
 }
 
@@ -3242,10 +3242,9 @@ void AvFormatDecoder::HandleGopStart(
             m_positionMap.push_back(entry);
             if (trackTotalDuration)
             {
-                m_frameToDurMap[framesRead] =
+                m_durationMap.Insert(framesRead,
                     (int64_t)totalDuration.num * 1000.0 / totalDuration.den
-                    + 0.5;
-                m_durToFrameMap[m_frameToDurMap[framesRead]] = framesRead;
+                    + 0.5);
             }
         }
 
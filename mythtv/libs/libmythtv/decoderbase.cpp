@@ -9,6 +9,7 @@ using namespace std;
 #include "decoderbase.h"
 #include "programinfo.h"
 #include "iso639.h"
+#include "seekindex.h"
 #include "DVD/dvdringbuffer.h"
 #include "Bluray/bdringbuffer.h"
 
@@ -34,6 +35,7 @@ DecoderBase::DecoderBase(MythPlayer *parent, const ProgramInfo &pginfo)
 
       m_positionMapLock(QMutex::Recursive),
       dontSyncPositionMap(false),
+      m_seekIndex(NULL), m_seekIndexRead(0),
 
       seeksnap(UINT64_MAX), livetv(false), watchingrecording(false),
 
@@ -56,6 +58,7 @@ DecoderBase::~DecoderBase()
 {
     if (m_playbackinfo)
         delete m_playbackinfo;
+    delete m_seekIndex;
 }
 
 void DecoderBase::SetProgramInfo(const ProgramInfo &pginfo)
@@ -117,6 +120,8 @@ bool DecoderBase::PosMapFromDb(void)
 
     // Overwrites current positionmap with entire contents of database
     frm_pos_map_t posMap, durMap;
+    MythTimer timer;
+    timer.start();
 
     if (ringBuffer && ringBuffer->IsDVD())
     {
@@ -145,6 +150,10 @@ bool DecoderBase::PosMapFromDb(void)
                 .arg(ringBuffer->BD()->GetTotalReadPosition()).arg(fps));
 #endif
     }
+    else if (PosMapFromSeekIndexFile())
+    {
+        return true;
+    }
     else if ((positionMapType == MARK_UNSET) ||
         (keyframedist == -1))
     {
@@ -193,8 +202,8 @@ bool DecoderBase::PosMapFromDb(void)
     QMutexLocker locker(&m_positionMapLock);
     m_positionMap.clear();
     m_positionMap.reserve(posMap.size());
-    m_frameToDurMap.clear();
-    m_durToFrameMap.clear();
+    m_durationMap.Clear();
+    m_durationMap.Reserve(durMap.size());
 
     for (frm_pos_map_t::const_iterator it = posMap.begin();
          it != posMap.end(); ++it)
@@ -209,23 +218,21 @@ bool DecoderBase::PosMapFromDb(void)
     if (!m_positionMap.empty())
     {
         LOG(VB_PLAYBACK, LOG_INFO, LOC +
-            QString("Position map filled from DB to: %1")
-                .arg(m_positionMap.back().index));
+            QString("Position map filled from DB to: %1 in %2 ms")
+                .arg(m_positionMap.back().index).arg(timer.elapsed()));
     }
 
-    uint64_t last = 0;
     for (frm_pos_map_t::const_iterator it = durMap.begin();
          it != durMap.end(); ++it)
     {
-        m_frameToDurMap[it.key()] = it.value();
-        m_durToFrameMap[it.value()] = it.key();
-        last = it.key();
+        m_durationMap.Insert(it.key(), it.value());
     }
 
-    if (!m_durToFrameMap.empty())
+    if (!m_durationMap.empty())
     {
         LOG(VB_PLAYBACK, LOG_INFO, LOC +
-            QString("Duration map filled from DB to: %1").arg(last));
+            QString("Duration map filled from DB to: %1")
+                .arg(m_durationMap.back().key));
     }
 
     return true;
@@ -252,8 +259,11 @@ bool DecoderBase::PosMapFromEnc(void)
     }
 
     frm_pos_map_t posMap, durMap;
-    if (!m_parent->PosMapFromEnc(start, posMap, durMap))
+    if (!PosMapFromSeekIndex(posMap, durMap) &&
+        !m_parent->PosMapFromEnc(start, posMap, durMap))
+    {
         return false;
+    }
 
     QMutexLocker locker(&m_positionMapLock);
 
@@ -283,33 +293,195 @@ bool DecoderBase::PosMapFromEnc(void)
                 .arg(m_positionMap.back().index));
     }
 
-    bool isEmpty = m_frameToDurMap.empty();
+    bool isEmpty = m_durationMap.empty();
     if (!isEmpty)
-    {
-        frm_pos_map_t::const_iterator it = m_frameToDurMap.end();
-        --it;
-        last_index = it.key();
-    }
+        last_index = m_durationMap.back().key;
     for (frm_pos_map_t::const_iterator it = durMap.begin();
          it != durMap.end(); ++it)
     {
         if (!isEmpty && it.key() <= last_index)
             continue; // we released the m_positionMapLock for a few ms...
-        m_frameToDurMap[it.key()] = it.value();
-        m_durToFrameMap[it.value()] = it.key();
+        m_durationMap.Insert(it.key(), it.value());
     }
 
-    if (!m_frameToDurMap.empty())
+    if (!m_durationMap.empty())
     {
-        frm_pos_map_t::const_iterator it = m_frameToDurMap.end();
-        --it;
         LOG(VB_PLAYBACK, LOG_INFO, LOC +
-            QString("Duration map filled from Encoder to: %1").arg(it.key()));
+            QString("Duration map filled from Encoder to: %1")
+                .arg(m_durationMap.back().key));
     }
 
     return true;
 }
 
+/** \fn DecoderBase::OpenSeekIndex(void)
+ *  \brief Maps the seek index file next to the recording, if it is a
+ *         local file and has one.
+ *
+ *  For a remote recording the database or the encoder has to be asked
+ *  over the network instead.
+ */
+bool DecoderBase::OpenSeekIndex(void)
+{
+    if (!ringBuffer || ringBuffer->IsDisc())
+        return false;
+
+    QString filename = ringBuffer->GetFilename();
+    if (!filename.startsWith('/'))
+        return false;
+    filename = SeekIndex::GetFilename(filename);
+
+    if (!m_seekIndex || m_seekIndex->GetFilename() != filename)
+    {
+        delete m_seekIndex;
+        m_seekIndex = NULL;
+        m_seekIndexRead = 0;
+
+        if (!QFile::exists(filename))
+            return false;
+        m_seekIndex = new SeekIndexReader(filename);
+    }
+
+    m_seekIndex->Refresh();
+    return m_seekIndex->IsOpen();
+}
+
+/** \fn DecoderBase::PosMapFromSeekIndex(frm_pos_map_t&,frm_pos_map_t&)
+ *  \brief Reads the entries the recorder has appended to the seek
+ *         index file since the last call.
+ *
+ *  \return false if nothing new was read, the encoder is asked then
+ */
+bool DecoderBase::PosMapFromSeekIndex(frm_pos_map_t &posMap,
+                                      frm_pos_map_t &durMap)
+{
+    if (!OpenSeekIndex() ||
+        m_seekIndex->GetPositionMapType() != positionMapType)
+    {
+        return false;
+    }
+
+    m_seekIndexRead = m_seekIndex->Read(
+        m_seekIndexRead, &posMap, positionMapType, &durMap);
+
+    LOG(VB_PLAYBACK, LOG_INFO, LOC +
+        QString("Read %1 positions from seek index").arg(posMap.size()));
+
+    return !posMap.empty();
+}
+
+/** \fn DecoderBase::PosMapFromSeekIndexFile(void)
+ *  \brief Fills the position and duration maps straight from the
+ *         mapped seek index of a finished recording.
+ *
+ *  This skips fetching and converting every recordedseek row. The
+ *  file is only trusted if the database holds the same number of
+ *  keyframe and duration entries and the same last entry of each, so
+ *  a map that has since been rebuilt or a transcoded recording falls
+ *  back to the database.
+ */
+bool DecoderBase::PosMapFromSeekIndexFile(void)
+{
+    MythTimer timer;
+    timer.start();
+
+    if (!m_playbackinfo || !OpenSeekIndex())
+        return false;
+
+    MarkTypes type = m_seekIndex->GetPositionMapType();
+    if (type == MARK_UNSET ||
+        (positionMapType != MARK_UNSET && positionMapType != type))
+    {
+        return false;
+    }
+
+    const SeekIndexRecord *recs = m_seekIndex->GetRecords();
+    uint count = m_seekIndex->GetCount();
+    uint64_t posCount = 0, durCount = 0;
+    const SeekIndexRecord *last = NULL, *lastDur = NULL;
+    for (uint i = 0; i < count; ++i)
+    {
+        if (recs[i].type == (uint32_t) type)
+        {
+            posCount++;
+            last = &recs[i];
+        }
+        else if (recs[i].type == (uint32_t) MARK_DURATION_MS)
+        {
+            durCount++;
+            lastDur = &recs[i];
+        }
+    }
+
+    uint64_t dbCount = 0, dbMark = 0, dbOffset = 0;
+    if (!last ||
+        !m_playbackinfo->QueryPositionMapSummary(type, dbCount,
+                                                 dbMark, dbOffset) ||
+        dbCount != posCount || dbMark != (uint64_t) last->mark ||
+        dbOffset != (uint64_t) last->offset)
+    {
+        LOG(VB_PLAYBACK, LOG_INFO, LOC +
+            QString("Seek index does not match the DB (%1 vs %2 entries)")
+                .arg(posCount).arg(dbCount));
+        return false;
+    }
+
+    // The duration map is rewritten with the keyframes, but check it
+    // as well, seeking by time uses it
+    uint64_t durMark = lastDur ? (uint64_t) lastDur->mark   : 0;
+    uint64_t durMs   = lastDur ? (uint64_t) lastDur->offset : 0;
+    if (!m_playbackinfo->QueryPositionMapSummary(MARK_DURATION_MS, dbCount,
+                                                 dbMark, dbOffset) ||
+        dbCount != durCount || dbMark != durMark || dbOffset != durMs)
+    {
+        LOG(VB_PLAYBACK, LOG_INFO, LOC +
+            QString("Seek index durations do not match the DB "
+                    "(%1 vs %2 entries)").arg(durCount).arg(dbCount));
+        return false;
+    }
+
+    positionMapType = type;
+    if (keyframedist == -1)
+    {
+        if (type == MARK_GOP_BYFRAME)
+            keyframedist = 1;
+        else if (type == MARK_GOP_START)
+            keyframedist = (fps < 26 && fps > 24) ? 12 : 15;
+    }
+
+    QMutexLocker locker(&m_positionMapLock);
+    m_positionMap.clear();
+    m_positionMap.reserve(posCount);
+    m_durationMap.Clear();
+    m_durationMap.Reserve(durCount);
+
+    for (uint i = 0; i < count; ++i)
+    {
+        if (recs[i].type == (uint32_t) type)
+        {
+            PosMapEntry e = {recs[i].mark, recs[i].mark * keyframedist,
+                             recs[i].offset};
+            m_positionMap.push_back(e);
+        }
+        else if (recs[i].type == (uint32_t) MARK_DURATION_MS)
+        {
+            m_durationMap.Insert(recs[i].mark, recs[i].offset);
+        }
+    }
+    m_seekIndexRead = count;
+
+    indexOffset = m_positionMap[0].index;
+
+    LOG(VB_PLAYBACK, LOG_INFO, LOC +
+        QString("Position map filled from seek index to: %1 in %2 ms, "
+                "%3 KB")
+            .arg(m_positionMap.back().index).arg(timer.elapsed())
+            .arg((m_positionMap.capacity() * sizeof(PosMapEntry) +
+                  m_durationMap.GetMemoryUsage()) >> 10));
+
+    return true;
+}
+
 unsigned long DecoderBase::GetPositionMapSize(void) const
 {
     QMutexLocker locker(&m_positionMapLock);
@@ -542,14 +714,10 @@ uint64_t DecoderBase::SavePositionMapDelta(long long first, long long last)
     }
 
     frm_pos_map_t durMap;
-    for (frm_pos_map_t::const_iterator it = m_frameToDurMap.begin();
-         it != m_frameToDurMap.end(); ++it)
+    for (size_t i = m_durationMap.LowerBound(first);
+         i < m_durationMap.size() && m_durationMap[i].key <= last; i++)
     {
-        if (it.key() < first)
-            continue;
-        if (it.key() > last)
-            break;
-        durMap[it.key()] = it.value();
+        durMap[m_durationMap[i].key] = m_durationMap[i].value;
     }
 
     locker.unlock();
@@ -665,8 +833,8 @@ void DecoderBase::ResetPosMap(void)
     QMutexLocker locker(&m_positionMapLock);
     posmapStarted = false;
     m_positionMap.clear();
-    m_frameToDurMap.clear();
-    m_durToFrameMap.clear();
+    m_durationMap.Clear();
+    m_seekIndexRead = 0;
 }
 
 long long DecoderBase::GetLastFrameInPosMap(void) const
@@ -1222,59 +1390,6 @@ void DecoderBase::SaveTotalFrames(void)
     m_playbackinfo->SaveTotalFrames(framesRead);
 }
 
-// Linearly interpolate the value for a given key in the map.  If the
-// key is outside the range of keys in the map, linearly extrapolate
-// using the fallback ratio.
-uint64_t DecoderBase::TranslatePosition(const frm_pos_map_t &map,
-                                        long long key,
-                                        float fallback_ratio)
-{
-    uint64_t key1, key2;
-    uint64_t val1, val2;
-
-    frm_pos_map_t::const_iterator lower = map.lowerBound(key);
-    // QMap::lowerBound() finds a key >= the given key.  We want one
-    // <= the given key, so back up one element upon > condition.
-    if (lower != map.begin() && (lower == map.end() || lower.key() > key))
-        --lower;
-    if (lower == map.end() || lower.key() > key)
-    {
-        key1 = 0;
-        val1 = 0;
-        LOG(VB_PLAYBACK, LOG_DEBUG, LOC +
-            QString("TranslatePosition(key=%1): extrapolating to (0,0)")
-            .arg(key));
-    }
-    else
-    {
-        key1 = lower.key();
-        val1 = lower.value();
-    }
-    // Find the next key >= the given key.  QMap::lowerBound() is
-    // precisely correct in this case.
-    frm_pos_map_t::const_iterator upper = map.lowerBound(key);
-    if (upper == map.end())
-    {
-        // Extrapolate from (key1,val1) based on fallback_ratio
-        key2 = key;
-        val2 = val1 + fallback_ratio * (key2 - key1) + 0.5;
-        LOG(VB_PLAYBACK, LOG_DEBUG, LOC +
-            QString("TranslatePosition(key=%1, ratio=%2): "
-                    "extrapolating to (%3,%4)")
-            .arg(key).arg(fallback_ratio).arg(key2).arg(val2));
-        return val2;
-    }
-    else
-    {
-        key2 = upper.key();
-        val2 = upper.value();
-    }
-    if (key1 == key2) // this happens for an exact keyframe match
-        return val2; // can also set key2 = key1 + 1 avoid dividing by zero
-
-    return val1 + (double) (key - key1) * (val2 - val1) / (key2 - key1) + 0.5;
-}
-
 // Convert from an absolute frame number (not cutlist adjusted) to its
 // cutlist-adjusted position in milliseconds.
 uint64_t DecoderBase::TranslatePositionFrameToMs(long long position,
@@ -1287,11 +1402,9 @@ uint64_t DecoderBase::TranslatePositionFrameToMs(long long position,
     // almost always appear to be past the end of the duration map, so
     // we limit duration map syncing to once every 3 seconds (a
     // somewhat arbitrary value).
-    if (!m_frameToDurMap.empty())
+    if (!m_durationMap.empty())
     {
-        frm_pos_map_t::const_iterator it = m_frameToDurMap.end();
-        --it;
-        if (position > it.key())
+        if (position > m_durationMap.back().key)
         {
             if (!m_lastPositionMapUpdate.isValid() ||
                 (QDateTime::currentDateTime() >
@@ -1299,7 +1412,7 @@ uint64_t DecoderBase::TranslatePositionFrameToMs(long long position,
                 SyncPositionMap();
         }
     }
-    return TranslatePositionAbsToRel(cutlist, position, m_frameToDurMap,
+    return TranslatePositionAbsToRel(cutlist, position, m_durationMap,
                                      1000 / fallback_framerate);
 }
 
@@ -1312,11 +1425,11 @@ uint64_t DecoderBase::TranslatePositionMsToFrame(uint64_t dur_ms,
     QMutexLocker locker(&m_positionMapLock);
     // Convert relative position in milliseconds (cutlist-adjusted) to
     // its absolute position in milliseconds (not cutlist-adjusted).
-    uint64_t ms = TranslatePositionRelToAbs(cutlist, dur_ms, m_frameToDurMap,
+    uint64_t ms = TranslatePositionRelToAbs(cutlist, dur_ms, m_durationMap,
                                             1000 / fallback_framerate);
     // Convert absolute position in milliseconds to its absolute frame
     // number.
-    return TranslatePosition(m_durToFrameMap, ms, fallback_framerate / 1000);
+    return m_durationMap.TranslateValue(ms, fallback_framerate / 1000);
 }
 
 // Convert from an "absolute" (not cutlist-adjusted) value to its
@@ -1331,7 +1444,7 @@ uint64_t DecoderBase::TranslatePositionMsToFrame(uint64_t dur_ms,
 uint64_t
 DecoderBase::TranslatePositionAbsToRel(const frm_dir_map_t &deleteMap,
                                        uint64_t absPosition, // frames
-                                       const frm_pos_map_t &map, // frame->ms
+                                       const SeekTable &map, // frame->ms
                                        float fallback_ratio)
 {
     uint64_t subtraction = 0;
@@ -1346,7 +1459,7 @@ DecoderBase::TranslatePositionAbsToRel(const frm_dir_map_t &deleteMap,
         first = false;
         if (i.key() > absPosition)
             break;
-        uint64_t mappedKey = TranslatePosition(map, i.key(), fallback_ratio);
+        uint64_t mappedKey = map.Translate(i.key(), fallback_ratio);
         if (i.value() == MARK_CUT_START && !withinCut)
         {
             withinCut = true;
@@ -1358,7 +1471,7 @@ DecoderBase::TranslatePositionAbsToRel(const frm_dir_map_t &deleteMap,
             subtraction += (mappedKey - startOfCutRegion);
         }
     }
-    uint64_t mappedPos = TranslatePosition(map, absPosition, fallback_ratio);
+    uint64_t mappedPos = map.Translate(absPosition, fallback_ratio);
     if (withinCut)
         subtraction += (mappedPos - startOfCutRegion);
     return mappedPos - subtraction;
@@ -1380,7 +1493,7 @@ DecoderBase::TranslatePositionAbsToRel(const frm_dir_map_t &deleteMap,
 uint64_t
 DecoderBase::TranslatePositionRelToAbs(const frm_dir_map_t &deleteMap,
                                        uint64_t relPosition, // ms
-                                       const frm_pos_map_t &map, // frame->ms
+                                       const SeekTable &map, // frame->ms
                                        float fallback_ratio)
 {
     uint64_t addition = 0;
@@ -1393,7 +1506,7 @@ DecoderBase::TranslatePositionRelToAbs(const frm_dir_map_t &deleteMap,
         if (first)
             withinCut = (i.value() == MARK_CUT_END);
         first = false;
-        uint64_t mappedKey = TranslatePosition(map, i.key(), fallback_ratio);
+        uint64_t mappedKey = map.Translate(i.key(), fallback_ratio);
         if (i.value() == MARK_CUT_START && !withinCut)
         {
             withinCut = true;
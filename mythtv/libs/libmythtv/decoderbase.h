@@ -13,8 +13,10 @@ using namespace std;
 #include "programinfo.h"
 #include "mythcodecid.h"
 #include "mythavutil.h"
+#include "seektable.h"
 
 class RingBuffer;
+class SeekIndexReader;
 class TeletextViewer;
 class MythPlayer;
 class AudioPlayer;
@@ -169,16 +171,13 @@ class DecoderBase
     static uint64_t
         TranslatePositionAbsToRel(const frm_dir_map_t &deleteMap,
                                   uint64_t absPosition,
-                                  const frm_pos_map_t &map = frm_pos_map_t(),
+                                  const SeekTable &map = SeekTable(),
                                   float fallback_ratio = 1.0);
     static uint64_t
         TranslatePositionRelToAbs(const frm_dir_map_t &deleteMap,
                                   uint64_t relPosition,
-                                  const frm_pos_map_t &map = frm_pos_map_t(),
+                                  const SeekTable &map = SeekTable(),
                                   float fallback_ratio = 1.0);
-    static uint64_t TranslatePosition(const frm_pos_map_t &map,
-                                      long long key,
-                                      float fallback_ratio);
     uint64_t TranslatePositionFrameToMs(long long position,
                                         float fallback_framerate,
                                         const frm_dir_map_t &cutlist);
@@ -219,6 +218,9 @@ class DecoderBase
     virtual bool SyncPositionMap(void);
     virtual bool PosMapFromDb(void);
     virtual bool PosMapFromEnc(void);
+    bool OpenSeekIndex(void);
+    bool PosMapFromSeekIndex(frm_pos_map_t &posMap, frm_pos_map_t &durMap);
+    bool PosMapFromSeekIndexFile(void);
 
     virtual bool FindPosition(long long desired_value, bool search_adjusted,
                               int &lower_bound, int &upper_bound);
@@ -328,10 +330,11 @@ class DecoderBase
 
     mutable QMutex m_positionMapLock;
     vector<PosMapEntry> m_positionMap;
-    frm_pos_map_t m_frameToDurMap; // guarded by m_positionMapLock
-    frm_pos_map_t m_durToFrameMap; // guarded by m_positionMapLock
+    SeekTable m_durationMap; // frame->ms, guarded by m_positionMapLock
     bool dontSyncPositionMap;
     mutable QDateTime m_lastPositionMapUpdate; // guarded by m_positionMapLock
+    SeekIndexReader *m_seekIndex;
+    uint m_seekIndexRead; // next seek index record to read
 
     uint64_t seeksnap;
     bool livetv;
@@ -9,6 +9,8 @@ using namespace std;
 #include "eitfixup.h"
 #include "eitcache.h"
 #include "mythdb.h"
+#include "mythcorecontext.h"
+#include "mythevent.h"
 #include "atsctables.h"
 #include "dvbtables.h"
 #include "premieretables.h"
@@ -71,6 +73,9 @@ uint EITHelper::ProcessEvents(void)
     if (db_events.empty())
         return 0;
 
+    // first start and last end of the events inserted on each channel
+    QMap<uint, QPair<QDateTime, QDateTime> > changed;
+
     MSqlQuery query(MSqlQuery::InitCon());
     for (uint i = 0; (i < kChunkSize) && (db_events.size() > 0); i++)
     {
@@ -79,9 +84,24 @@ uint EITHelper::ProcessEvents(void)
 
         eitfixup->Fix(*event);
 
-        insertCount += event->UpdateDB(query, 1000);
+        uint count = event->UpdateDB(query, 1000);
+        insertCount += count;
         maxStarttime = max (maxStarttime, event->starttime);
 
+        if (count)
+        {
+            QMap<uint, QPair<QDateTime, QDateTime> >::iterator it =
+                changed.find(event->chanid);
+            if (it == changed.end())
+                changed[event->chanid] = qMakePair(event->starttime,
+                                                   event->endtime);
+            else
+            {
+                (*it).first  = min((*it).first,  event->starttime);
+                (*it).second = max((*it).second, event->endtime);
+            }
+        }
+
         delete event;
         eitList_lock.lock();
     }
@@ -89,6 +109,18 @@ uint EITHelper::ProcessEvents(void)
     if (!insertCount)
         return 0;
 
+    // Let the guide cache of the Services API know what changed
+    QStringList extra;
+    QMap<uint, QPair<QDateTime, QDateTime> >::const_iterator it =
+        changed.begin();
+    for (; it != changed.end(); ++it)
+    {
+        extra << QString::number(it.key())
+              << MythDate::toString((*it).first,  MythDate::ISODate)
+              << MythDate::toString((*it).second, MythDate::ISODate);
+    }
+    gCoreContext->SendEvent(MythEvent("LOCAL_GUIDE_CHANGED CHANNELS", extra));
+
     if (incomplete_events.size() || unmatched_etts.size())
     {
         LOG(VB_EIT, LOG_INFO,
@@ -695,7 +727,10 @@ void EITHelper::AddEIT(const DVBEventInformationTable *eit)
             season, episode, totalepisodes);
         event->items = items;
 
+        // ProcessEvents() takes these off on the EIT thread
+        eitList_lock.lock();
         db_events.enqueue(event);
+        eitList_lock.unlock();
     }
 }
 
@@ -806,7 +841,9 @@ void EITHelper::AddEIT(const PremiereContentInformationTable *cit)
                 season, episode, totalepisodes);
             event->items = items;
 
+            eitList_lock.lock();
             db_events.enqueue(event);
+            eitList_lock.unlock();
         }
     }
 }
@@ -0,0 +1,938 @@
+// -*- Mode: c++ -*-
+
+// C++ headers
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+using namespace std;
+
+// MythTV headers
+#include "mythconfig.h"
+#include "framekernels.h"
+
+extern "C" {
+#include "libavutil/cpu.h"
+}
+
+// The vector versions are built with per function target attributes,
+// so the rest of libmythtv keeps its baseline instruction set. They are
+// left out on 32 bit x86, where the scalar convolution may be done with
+// the wider x87 doubles and so round differently.
+#if ARCH_X86_64 && (defined(__clang__) || \
+    (defined(__GNUC__) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define FRAMEKERNELS_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FRAMEKERNELS_X86 0
+#endif
+
+const FrameKernels::Table *FrameKernels::s_best = NULL;
+
+/*
+ * Scalar versions, also used for what is left over at the end of a row
+ * by the vector versions.
+ */
+
+static inline void row_stats_tail(const uint8_t *row, const uint8_t *mask,
+                                  int i, int count, uint8_t *colmax,
+                                  uint8_t &lo, uint8_t &hi, uint32_t &sum)
+{
+    for (; i < count; ++i)
+    {
+        if (!mask[i])
+            continue;
+        uint8_t p = row[i];
+        lo = min(lo, p);
+        hi = max(hi, p);
+        sum += p;
+        colmax[i] = max(colmax[i], p);
+    }
+}
+
+static void row_stats_scalar(const uint8_t *row, const uint8_t *mask,
+                             int count, uint8_t *colmax, uint8_t *pmin,
+                             uint8_t *pmax, uint32_t *psum)
+{
+    uint8_t lo = 255, hi = 0;
+    uint32_t sum = 0;
+    row_stats_tail(row, mask, 0, count, colmax, lo, hi, sum);
+    *pmin = lo;
+    *pmax = hi;
+    *psum = sum;
+}
+
+static void gather_scalar(const uint8_t *src, int count, int step,
+                          uint8_t *dst)
+{
+    if (step == 1)
+    {
+        memcpy(dst, src, count);
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+        dst[i] = src[i * step];
+}
+
+static inline void count_bins(const uint8_t *src, int count, int *bins)
+{
+    for (int i = 0; i < count; ++i)
+        bins[src[i]]++;
+}
+
+static inline void add_sums(const uint8_t *src, int i, int count,
+                            uint64_t &sum, uint64_t &sumsq)
+{
+    for (; i < count; ++i)
+    {
+        sum += src[i];
+        sumsq += src[i] * src[i];
+    }
+}
+
+static void histogram_scalar(const uint8_t *src, int count, int *bins,
+                             uint64_t *psum, uint64_t *psumsq)
+{
+    count_bins(src, count, bins);
+    if (!psum && !psumsq)
+        return;
+
+    uint64_t sum = 0, sumsq = 0;
+    add_sums(src, 0, count, sum, sumsq);
+    if (psum)
+        *psum += sum;
+    if (psumsq)
+        *psumsq += sumsq;
+}
+
+static inline bool edge_diff(int a, int p, int diff)
+{
+    return abs(a - p) >= diff;
+}
+
+static inline void edge_flags_tail(const uint8_t *src, int pitch, int i,
+                                   int count, int radius, int diff,
+                                   uint8_t *flags)
+{
+    const int rp = radius * pitch;
+    for (; i < count; ++i)
+    {
+        const uint8_t *p = src + i;
+        uint8_t f = 0;
+        if (edge_diff(p[-radius], *p, diff) || edge_diff(p[radius], *p, diff))
+            f |= FrameKernels::kEdgeHoriz;
+        if (edge_diff(p[-rp], *p, diff) || edge_diff(p[rp], *p, diff))
+            f |= FrameKernels::kEdgeVert;
+        if (edge_diff(p[-rp - radius], *p, diff) ||
+            edge_diff(p[rp + radius], *p, diff))
+            f |= FrameKernels::kEdgeLDiag;
+        if (edge_diff(p[-rp + radius], *p, diff) ||
+            edge_diff(p[rp - radius], *p, diff))
+            f |= FrameKernels::kEdgeRDiag;
+        flags[i] = f;
+    }
+}
+
+static void edge_flags_scalar(const uint8_t *src, int pitch, int count,
+                              int radius, int diff, uint8_t *flags)
+{
+    edge_flags_tail(src, pitch, 0, count, radius, diff, flags);
+}
+
+static inline uint32_t popcount8(uint8_t x)
+{
+    x = x - ((x >> 1) & 0x55);
+    x = (x & 0x33) + ((x >> 2) & 0x33);
+    return (x + (x >> 4)) & 0x0f;
+}
+
+static inline uint32_t count_bits_tail(const uint8_t *a, const uint8_t *b,
+                                       int i, int count)
+{
+    uint32_t n = 0;
+    for (; i < count; ++i)
+        n += popcount8(a[i] & b[i]);
+    return n;
+}
+
+static uint32_t count_bits_scalar(const uint8_t *a, const uint8_t *b,
+                                  int count)
+{
+    return count_bits_tail(a, b, 0, count);
+}
+
+static inline uint32_t count_both_tail(const uint8_t *a, const uint8_t *b,
+                                       int i, int count)
+{
+    uint32_t n = 0;
+    for (; i < count; ++i)
+        n += (a[i] && b[i]) ? 1 : 0;
+    return n;
+}
+
+static uint32_t count_both_scalar(const uint8_t *a, const uint8_t *b,
+                                  int count)
+{
+    return count_both_tail(a, b, 0, count);
+}
+
+static inline void gradient_tail(const uint8_t *r0, const uint8_t *r1,
+                                 int i, int count, uint32_t *sgm)
+{
+    for (; i < count; ++i)
+    {
+        int dx = r1[i + 1] - r0[i];     /* southeast - northwest */
+        int dy = r1[i] - r0[i + 1];     /* southwest - northeast */
+        sgm[i] = dx * dx + dy * dy;
+    }
+}
+
+static void gradient_scalar(const uint8_t *r0, const uint8_t *r1, int count,
+                            uint32_t *sgm)
+{
+    gradient_tail(r0, r1, 0, count, sgm);
+}
+
+static inline void convolve_tail(const uint8_t *src, int tap, int i,
+                                 int count, const double *mask, int radius,
+                                 uint8_t *dst)
+{
+    for (; i < count; ++i)
+    {
+        double sum = 0;
+        for (int k = -radius; k <= radius; ++k)
+            sum += mask[k + radius] * src[i + k * tap];
+        dst[i] = (uint8_t)(sum + 0.5);
+    }
+}
+
+static void convolve_scalar(const uint8_t *src, int tap, int count,
+                            const double *mask, int radius, uint8_t *dst)
+{
+    convolve_tail(src, tap, 0, count, mask, radius, dst);
+}
+
+static int range_run_scalar(const uint8_t *src, int count, uint8_t *pmin,
+                            uint8_t *pmax, int maxrange)
+{
+    uint8_t lo = *pmin, hi = *pmax;
+    int i = 0;
+    for (; i < count; ++i)
+    {
+        uint8_t val = src[i];
+        if (max(hi, val) - min(lo, val) + 1 > maxrange)
+            break;
+        lo = min(lo, val);
+        hi = max(hi, val);
+    }
+    *pmin = lo;
+    *pmax = hi;
+    return i;
+}
+
+#if FRAMEKERNELS_X86
+
+/*
+ * SSE2 versions
+ */
+
+TARGET_SSE2
+static inline uint8_t hmin_epu8(__m128i v)
+{
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 4));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 2));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 1));
+    return _mm_cvtsi128_si32(v) & 0xff;
+}
+
+TARGET_SSE2
+static inline uint8_t hmax_epu8(__m128i v)
+{
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 1));
+    return _mm_cvtsi128_si32(v) & 0xff;
+}
+
+TARGET_SSE2
+static inline uint64_t hsum_epi64(__m128i v)
+{
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, v);
+    return lanes[0] + lanes[1];
+}
+
+/// |a - c| >= d in each byte lane, as 0xff or 0
+TARGET_SSE2
+static inline __m128i ge_diff_sse2(__m128i a, __m128i c, __m128i d)
+{
+    __m128i ad = _mm_or_si128(_mm_subs_epu8(a, c), _mm_subs_epu8(c, a));
+    return _mm_cmpeq_epi8(_mm_max_epu8(ad, d), ad);
+}
+
+TARGET_SSE2
+static inline __m128i popcount_sse2(__m128i x)
+{
+    const __m128i m1 = _mm_set1_epi8(0x55);
+    const __m128i m2 = _mm_set1_epi8(0x33);
+    const __m128i m4 = _mm_set1_epi8(0x0f);
+    x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+    x = _mm_add_epi8(_mm_and_si128(x, m2),
+                     _mm_and_si128(_mm_srli_epi16(x, 2), m2));
+    return _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+}
+
+TARGET_SSE2
+static void row_stats_sse2(const uint8_t *row, const uint8_t *mask,
+                           int count, uint8_t *colmax, uint8_t *pmin,
+                           uint8_t *pmax, uint32_t *psum)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8(-1);
+    __m128i vmin = ones, vmax = zero, vsum = zero;
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i m = _mm_loadu_si128((const __m128i*)(mask + i));
+        __m128i pm = _mm_and_si128(p, m);
+        vmax = _mm_max_epu8(vmax, pm);
+        vmin = _mm_min_epu8(vmin, _mm_or_si128(p, _mm_andnot_si128(m, ones)));
+        vsum = _mm_add_epi64(vsum, _mm_sad_epu8(pm, zero));
+        __m128i c = _mm_loadu_si128((const __m128i*)(colmax + i));
+        _mm_storeu_si128((__m128i*)(colmax + i), _mm_max_epu8(c, pm));
+    }
+
+    uint8_t lo = hmin_epu8(vmin), hi = hmax_epu8(vmax);
+    uint32_t sum = hsum_epi64(vsum);
+    row_stats_tail(row, mask, i, count, colmax, lo, hi, sum);
+    *pmin = lo;
+    *pmax = hi;
+    *psum = sum;
+}
+
+/// Every second or fourth pixel is packed down, the rest is scalar
+TARGET_SSE2
+static void gather_sse2(const uint8_t *src, int count, int step,
+                        uint8_t *dst)
+{
+    int i = 0;
+    if (step == 2)
+    {
+        const __m128i low = _mm_set1_epi16(0x00ff);
+        // 16 samples read 32 bytes, up to src[(i + 15) * 2 + 1]
+        for (; i + 17 <= count; i += 16)
+        {
+            const uint8_t *p = src + i * 2;
+            __m128i a = _mm_and_si128(
+                _mm_loadu_si128((const __m128i*)p), low);
+            __m128i b = _mm_and_si128(
+                _mm_loadu_si128((const __m128i*)(p + 16)), low);
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+        }
+    }
+    else if (step == 4)
+    {
+        const __m128i low = _mm_set1_epi32(0x000000ff);
+        // 16 samples read 64 bytes, up to src[(i + 15) * 4 + 3]
+        for (; i + 17 <= count; i += 16)
+        {
+            const uint8_t *p = src + i * 4;
+            __m128i a = _mm_and_si128(
+                _mm_loadu_si128((const __m128i*)p), low);
+            __m128i b = _mm_and_si128(
+                _mm_loadu_si128((const __m128i*)(p + 16)), low);
+            __m128i c = _mm_and_si128(
+                _mm_loadu_si128((const __m128i*)(p + 32)), low);
+            __m128i d = _mm_and_si128(
+                _mm_loadu_si128((const __m128i*)(p + 48)), low);
+            _mm_storeu_si128((__m128i*)(dst + i),
+                             _mm_packus_epi16(_mm_packs_epi32(a, b),
+                                              _mm_packs_epi32(c, d)));
+        }
+    }
+    gather_scalar(src + i * step, count - i, step, dst + i);
+}
+
+/// Only the sums are vectors, bytes can not be scattered to the bins
+TARGET_SSE2
+static void histogram_sse2(const uint8_t *src, int count, int *bins,
+                           uint64_t *psum, uint64_t *psumsq)
+{
+    count_bins(src, count, bins);
+    if (!psum && !psumsq)
+        return;
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vsum = zero, vsq = zero;
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(p, zero);
+        __m128i hi = _mm_unpackhi_epi8(p, zero);
+        __m128i sq = _mm_add_epi32(_mm_madd_epi16(lo, lo),
+                                   _mm_madd_epi16(hi, hi));
+        vsum = _mm_add_epi64(vsum, _mm_sad_epu8(p, zero));
+        vsq = _mm_add_epi64(vsq, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero),
+                                               _mm_unpackhi_epi32(sq, zero)));
+    }
+
+    uint64_t sum = hsum_epi64(vsum), sumsq = hsum_epi64(vsq);
+    add_sums(src, i, count, sum, sumsq);
+    if (psum)
+        *psum += sum;
+    if (psumsq)
+        *psumsq += sumsq;
+}
+
+TARGET_SSE2
+static void edge_flags_sse2(const uint8_t *src, int pitch, int count,
+                            int radius, int diff, uint8_t *flags)
+{
+    // every pixel or none is an edge, which the byte compares can not say
+    if (diff <= 0 || diff > 255)
+    {
+        edge_flags_scalar(src, pitch, count, radius, diff, flags);
+        return;
+    }
+
+    const int rp = radius * pitch;
+    const __m128i d = _mm_set1_epi8((char)diff);
+    const __m128i horiz = _mm_set1_epi8(FrameKernels::kEdgeHoriz);
+    const __m128i vert  = _mm_set1_epi8(FrameKernels::kEdgeVert);
+    const __m128i ldiag = _mm_set1_epi8(FrameKernels::kEdgeLDiag);
+    const __m128i rdiag = _mm_set1_epi8(FrameKernels::kEdgeRDiag);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const uint8_t *p = src + i;
+        __m128i c = _mm_loadu_si128((const __m128i*)p);
+#define GE(off) ge_diff_sse2(_mm_loadu_si128((const __m128i*)(p + (off))), c, d)
+        __m128i h  = _mm_or_si128(GE(-radius), GE(radius));
+        __m128i v  = _mm_or_si128(GE(-rp), GE(rp));
+        __m128i ld = _mm_or_si128(GE(-rp - radius), GE(rp + radius));
+        __m128i rd = _mm_or_si128(GE(-rp + radius), GE(rp - radius));
+#undef GE
+        __m128i f = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(h, horiz), _mm_and_si128(v, vert)),
+            _mm_or_si128(_mm_and_si128(ld, ldiag), _mm_and_si128(rd, rdiag)));
+        _mm_storeu_si128((__m128i*)(flags + i), f);
+    }
+
+    edge_flags_tail(src, pitch, i, count, radius, diff, flags);
+}
+
+TARGET_SSE2
+static uint32_t count_bits_sse2(const uint8_t *a, const uint8_t *b,
+                                int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i x = _mm_and_si128(_mm_loadu_si128((const __m128i*)(a + i)),
+                                  _mm_loadu_si128((const __m128i*)(b + i)));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(popcount_sse2(x), zero));
+    }
+
+    return hsum_epi64(acc) + count_bits_tail(a, b, i, count);
+}
+
+TARGET_SSE2
+static uint32_t count_both_sse2(const uint8_t *a, const uint8_t *b,
+                                int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i acc = zero;
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i za = _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(a + i)), zero);
+        __m128i zb = _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(b + i)), zero);
+        __m128i both = _mm_andnot_si128(_mm_or_si128(za, zb), one);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(both, zero));
+    }
+
+    return hsum_epi64(acc) + count_both_tail(a, b, i, count);
+}
+
+TARGET_SSE2
+static void gradient_sse2(const uint8_t *r0, const uint8_t *r1, int count,
+                          uint32_t *sgm)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(r0 + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(r0 + i + 1));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(r1 + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(r1 + i + 1));
+
+        // dx and dy interleaved, so madd gives dx * dx + dy * dy
+        __m128i dx = _mm_sub_epi16(_mm_unpacklo_epi8(b1, zero),
+                                   _mm_unpacklo_epi8(a0, zero));
+        __m128i dy = _mm_sub_epi16(_mm_unpacklo_epi8(b0, zero),
+                                   _mm_unpacklo_epi8(a1, zero));
+        __m128i lo = _mm_unpacklo_epi16(dx, dy);
+        __m128i hi = _mm_unpackhi_epi16(dx, dy);
+        _mm_storeu_si128((__m128i*)(sgm + i), _mm_madd_epi16(lo, lo));
+        _mm_storeu_si128((__m128i*)(sgm + i + 4), _mm_madd_epi16(hi, hi));
+
+        dx = _mm_sub_epi16(_mm_unpackhi_epi8(b1, zero),
+                           _mm_unpackhi_epi8(a0, zero));
+        dy = _mm_sub_epi16(_mm_unpackhi_epi8(b0, zero),
+                           _mm_unpackhi_epi8(a1, zero));
+        lo = _mm_unpacklo_epi16(dx, dy);
+        hi = _mm_unpackhi_epi16(dx, dy);
+        _mm_storeu_si128((__m128i*)(sgm + i + 8), _mm_madd_epi16(lo, lo));
+        _mm_storeu_si128((__m128i*)(sgm + i + 12), _mm_madd_epi16(hi, hi));
+    }
+
+    gradient_tail(r0, r1, i, count, sgm);
+}
+
+/// Four pixels at a time, as doubles in the order of the scalar sum
+TARGET_SSE2
+static void convolve_sse2(const uint8_t *src, int tap, int count,
+                          const double *mask, int radius, uint8_t *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128d half = _mm_set1_pd(0.5);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+        for (int k = -radius; k <= radius; ++k)
+        {
+            int32_t word;
+            memcpy(&word, src + i + k * tap, sizeof(word));
+            __m128i v = _mm_unpacklo_epi16(
+                _mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero), zero);
+            __m128d m = _mm_set1_pd(mask[k + radius]);
+            s0 = _mm_add_pd(s0, _mm_mul_pd(m, _mm_cvtepi32_pd(v)));
+            s1 = _mm_add_pd(s1, _mm_mul_pd(
+                               m, _mm_cvtepi32_pd(_mm_srli_si128(v, 8))));
+        }
+        __m128i r = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(s0, half)),
+                                       _mm_cvttpd_epi32(_mm_add_pd(s1, half)));
+        r = _mm_packs_epi32(r, r);
+        int32_t word = _mm_cvtsi128_si32(_mm_packus_epi16(r, r));
+        memcpy(dst + i, &word, sizeof(word));
+    }
+
+    convolve_tail(src, tap, i, count, mask, radius, dst);
+}
+
+/// A block is taken whole when it fits, then each of its prefixes did
+TARGET_SSE2
+static int range_run_sse2(const uint8_t *src, int count, uint8_t *pmin,
+                          uint8_t *pmax, int maxrange)
+{
+    uint8_t lo = *pmin, hi = *pmax;
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        uint8_t nlo = min(lo, hmin_epu8(v));
+        uint8_t nhi = max(hi, hmax_epu8(v));
+        if (nhi - nlo + 1 > maxrange)
+            break;
+        lo = nlo;
+        hi = nhi;
+    }
+
+    *pmin = lo;
+    *pmax = hi;
+    return i + range_run_scalar(src + i, count - i, pmin, pmax, maxrange);
+}
+
+/*
+ * AVX2 versions, the gather is left to SSE2 as the 256 bit packs work
+ * within each half.
+ */
+
+TARGET_AVX2
+static inline uint64_t hsum_epi64_avx2(__m256i v)
+{
+    return hsum_epi64(_mm_add_epi64(_mm256_castsi256_si128(v),
+                                    _mm256_extracti128_si256(v, 1)));
+}
+
+TARGET_AVX2
+static inline __m256i ge_diff_avx2(__m256i a, __m256i c, __m256i d)
+{
+    __m256i ad = _mm256_or_si256(_mm256_subs_epu8(a, c),
+                                 _mm256_subs_epu8(c, a));
+    return _mm256_cmpeq_epi8(_mm256_max_epu8(ad, d), ad);
+}
+
+TARGET_AVX2
+static inline __m256i popcount_avx2(__m256i x)
+{
+    const __m256i m1 = _mm256_set1_epi8(0x55);
+    const __m256i m2 = _mm256_set1_epi8(0x33);
+    const __m256i m4 = _mm256_set1_epi8(0x0f);
+    x = _mm256_sub_epi8(x, _mm256_and_si256(_mm256_srli_epi16(x, 1), m1));
+    x = _mm256_add_epi8(_mm256_and_si256(x, m2),
+                        _mm256_and_si256(_mm256_srli_epi16(x, 2), m2));
+    return _mm256_and_si256(_mm256_add_epi8(x, _mm256_srli_epi16(x, 4)), m4);
+}
+
+TARGET_AVX2
+static void row_stats_avx2(const uint8_t *row, const uint8_t *mask,
+                           int count, uint8_t *colmax, uint8_t *pmin,
+                           uint8_t *pmax, uint32_t *psum)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8(-1);
+    __m256i vmin = ones, vmax = zero, vsum = zero;
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(row + i));
+        __m256i m = _mm256_loadu_si256((const __m256i*)(mask + i));
+        __m256i pm = _mm256_and_si256(p, m);
+        vmax = _mm256_max_epu8(vmax, pm);
+        vmin = _mm256_min_epu8(
+            vmin, _mm256_or_si256(p, _mm256_andnot_si256(m, ones)));
+        vsum = _mm256_add_epi64(vsum, _mm256_sad_epu8(pm, zero));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(colmax + i));
+        _mm256_storeu_si256((__m256i*)(colmax + i), _mm256_max_epu8(c, pm));
+    }
+
+    uint8_t lo = hmin_epu8(_mm_min_epu8(_mm256_castsi256_si128(vmin),
+                                        _mm256_extracti128_si256(vmin, 1)));
+    uint8_t hi = hmax_epu8(_mm_max_epu8(_mm256_castsi256_si128(vmax),
+                                        _mm256_extracti128_si256(vmax, 1)));
+    uint32_t sum = hsum_epi64_avx2(vsum);
+    row_stats_tail(row, mask, i, count, colmax, lo, hi, sum);
+    *pmin = lo;
+    *pmax = hi;
+    *psum = sum;
+}
+
+TARGET_AVX2
+static void histogram_avx2(const uint8_t *src, int count, int *bins,
+                           uint64_t *psum, uint64_t *psumsq)
+{
+    count_bins(src, count, bins);
+    if (!psum && !psumsq)
+        return;
+
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i vsum = zero, vsq = zero;
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(p));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(p, 1));
+        __m256i sq = _mm256_add_epi32(_mm256_madd_epi16(lo, lo),
+                                      _mm256_madd_epi16(hi, hi));
+        vsum = _mm256_add_epi64(vsum, _mm256_sad_epu8(p, zero));
+        vsq = _mm256_add_epi64(vsq, _mm256_add_epi64(
+            _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sq)),
+            _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sq, 1))));
+    }
+
+    uint64_t sum = hsum_epi64_avx2(vsum), sumsq = hsum_epi64_avx2(vsq);
+    add_sums(src, i, count, sum, sumsq);
+    if (psum)
+        *psum += sum;
+    if (psumsq)
+        *psumsq += sumsq;
+}
+
+TARGET_AVX2
+static void edge_flags_avx2(const uint8_t *src, int pitch, int count,
+                            int radius, int diff, uint8_t *flags)
+{
+    if (diff <= 0 || diff > 255)
+    {
+        edge_flags_scalar(src, pitch, count, radius, diff, flags);
+        return;
+    }
+
+    const int rp = radius * pitch;
+    const __m256i d = _mm256_set1_epi8((char)diff);
+    const __m256i horiz = _mm256_set1_epi8(FrameKernels::kEdgeHoriz);
+    const __m256i vert  = _mm256_set1_epi8(FrameKernels::kEdgeVert);
+    const __m256i ldiag = _mm256_set1_epi8(FrameKernels::kEdgeLDiag);
+    const __m256i rdiag = _mm256_set1_epi8(FrameKernels::kEdgeRDiag);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const uint8_t *p = src + i;
+        __m256i c = _mm256_loadu_si256((const __m256i*)p);
+#define GE(off) \
+    ge_diff_avx2(_mm256_loadu_si256((const __m256i*)(p + (off))), c, d)
+        __m256i h  = _mm256_or_si256(GE(-radius), GE(radius));
+        __m256i v  = _mm256_or_si256(GE(-rp), GE(rp));
+        __m256i ld = _mm256_or_si256(GE(-rp - radius), GE(rp + radius));
+        __m256i rd = _mm256_or_si256(GE(-rp + radius), GE(rp - radius));
+#undef GE
+        __m256i f = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(h, horiz),
+                            _mm256_and_si256(v, vert)),
+            _mm256_or_si256(_mm256_and_si256(ld, ldiag),
+                            _mm256_and_si256(rd, rdiag)));
+        _mm256_storeu_si256((__m256i*)(flags + i), f);
+    }
+
+    edge_flags_tail(src, pitch, i, count, radius, diff, flags);
+}
+
+TARGET_AVX2
+static uint32_t count_bits_avx2(const uint8_t *a, const uint8_t *b,
+                                int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i x = _mm256_and_si256(
+            _mm256_loadu_si256((const __m256i*)(a + i)),
+            _mm256_loadu_si256((const __m256i*)(b + i)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(popcount_avx2(x), zero));
+    }
+
+    return hsum_epi64_avx2(acc) + count_bits_tail(a, b, i, count);
+}
+
+TARGET_AVX2
+static uint32_t count_both_avx2(const uint8_t *a, const uint8_t *b,
+                                int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    __m256i acc = zero;
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i za = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(a + i)), zero);
+        __m256i zb = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(b + i)), zero);
+        __m256i both = _mm256_andnot_si256(_mm256_or_si256(za, zb), one);
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(both, zero));
+    }
+
+    return hsum_epi64_avx2(acc) + count_both_tail(a, b, i, count);
+}
+
+TARGET_AVX2
+static void gradient_avx2(const uint8_t *r0, const uint8_t *r1, int count,
+                          uint32_t *sgm)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+#define LOAD16(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(p)))
+        __m256i dx = _mm256_sub_epi16(LOAD16(r1 + i + 1), LOAD16(r0 + i));
+        __m256i dy = _mm256_sub_epi16(LOAD16(r1 + i), LOAD16(r0 + i + 1));
+#undef LOAD16
+        // unpack works within each half, giving pixels 0-3 and 8-11 in
+        // lo and 4-7 and 12-15 in hi
+        __m256i lo = _mm256_unpacklo_epi16(dx, dy);
+        __m256i hi = _mm256_unpackhi_epi16(dx, dy);
+        lo = _mm256_madd_epi16(lo, lo);
+        hi = _mm256_madd_epi16(hi, hi);
+        _mm256_storeu_si256((__m256i*)(sgm + i),
+                            _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(sgm + i + 8),
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    gradient_tail(r0, r1, i, count, sgm);
+}
+
+TARGET_AVX2
+static void convolve_avx2(const uint8_t *src, int tap, int count,
+                          const double *mask, int radius, uint8_t *dst)
+{
+    const __m256d half = _mm256_set1_pd(0.5);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+        for (int k = -radius; k <= radius; ++k)
+        {
+            __m256i v = _mm256_cvtepu8_epi32(
+                _mm_loadl_epi64((const __m128i*)(src + i + k * tap)));
+            __m256d m = _mm256_set1_pd(mask[k + radius]);
+            s0 = _mm256_add_pd(s0, _mm256_mul_pd(
+                m, _mm256_cvtepi32_pd(_mm256_castsi256_si128(v))));
+            s1 = _mm256_add_pd(s1, _mm256_mul_pd(
+                m, _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1))));
+        }
+        __m128i r = _mm_packs_epi32(
+            _mm256_cvttpd_epi32(_mm256_add_pd(s0, half)),
+            _mm256_cvttpd_epi32(_mm256_add_pd(s1, half)));
+        _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(r, r));
+    }
+
+    convolve_tail(src, tap, i, count, mask, radius, dst);
+}
+
+TARGET_AVX2
+static int range_run_avx2(const uint8_t *src, int count, uint8_t *pmin,
+                          uint8_t *pmax, int maxrange)
+{
+    uint8_t lo = *pmin, hi = *pmax;
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m128i a = _mm256_castsi256_si128(v);
+        __m128i b = _mm256_extracti128_si256(v, 1);
+        uint8_t nlo = min(lo, hmin_epu8(_mm_min_epu8(a, b)));
+        uint8_t nhi = max(hi, hmax_epu8(_mm_max_epu8(a, b)));
+        if (nhi - nlo + 1 > maxrange)
+            break;
+        lo = nlo;
+        hi = nhi;
+    }
+
+    *pmin = lo;
+    *pmax = hi;
+    return i + range_run_sse2(src + i, count - i, pmin, pmax, maxrange);
+}
+
+#endif // FRAMEKERNELS_X86
+
+static const FrameKernels::Table kScalarTable =
+{
+    row_stats_scalar,
+    gather_scalar,
+    histogram_scalar,
+    edge_flags_scalar,
+    count_bits_scalar,
+    count_both_scalar,
+    gradient_scalar,
+    convolve_scalar,
+    range_run_scalar,
+};
+
+#if FRAMEKERNELS_X86
+static const FrameKernels::Table kSSE2Table =
+{
+    row_stats_sse2,
+    gather_sse2,
+    histogram_sse2,
+    edge_flags_sse2,
+    count_bits_sse2,
+    count_both_sse2,
+    gradient_sse2,
+    convolve_sse2,
+    range_run_sse2,
+};
+
+static const FrameKernels::Table kAVX2Table =
+{
+    row_stats_avx2,
+    gather_sse2,
+    histogram_avx2,
+    edge_flags_avx2,
+    count_bits_avx2,
+    count_both_avx2,
+    gradient_avx2,
+    convolve_avx2,
+    range_run_avx2,
+};
+#endif // FRAMEKERNELS_X86
+
+/// The best kernels for this CPU, found the first time they are used
+const FrameKernels::Table &FrameKernels::Get(void)
+{
+    if (!s_best)
+        s_best = &Get(kAuto);
+    return *s_best;
+}
+
+/** \fn FrameKernels::Get(Implementation)
+ *  \brief The kernels of a specific implementation.
+ *
+ *  Mostly useful for testing, an implementation that is not available
+ *  on this CPU falls back to the scalar one.
+ */
+const FrameKernels::Table &FrameKernels::Get(Implementation impl)
+{
+    if (impl == kAuto)
+        impl = GetBest();
+    if (!IsAvailable(impl))
+        return kScalarTable;
+
+    switch (impl)
+    {
+#if FRAMEKERNELS_X86
+        case kSSE2: return kSSE2Table;
+        case kAVX2: return kAVX2Table;
+#endif
+        default:    return kScalarTable;
+    }
+}
+
+bool FrameKernels::IsAvailable(Implementation impl)
+{
+    switch (impl)
+    {
+        case kAuto:
+        case kScalar:
+            return true;
+#if FRAMEKERNELS_X86
+        case kSSE2:
+            return av_get_cpu_flags() & AV_CPU_FLAG_SSE2;
+        case kAVX2:
+            return av_get_cpu_flags() & AV_CPU_FLAG_AVX2;
+#endif
+        default:
+            return false;
+    }
+}
+
+FrameKernels::Implementation FrameKernels::GetBest(void)
+{
+    if (IsAvailable(kAVX2))
+        return kAVX2;
+    if (IsAvailable(kSSE2))
+        return kSSE2;
+    return kScalar;
+}
+
+QString FrameKernels::toString(Implementation impl)
+{
+    switch (impl)
+    {
+        case kAuto:   return "auto";
+        case kScalar: return "scalar";
+        case kSSE2:   return "sse2";
+        case kAVX2:   return "avx2";
+    }
+    return "unknown";
+}
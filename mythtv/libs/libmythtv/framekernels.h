@@ -0,0 +1,110 @@
+// -*- Mode: c++ -*-
+#ifndef _FRAME_KERNELS_H_
+#define _FRAME_KERNELS_H_
+
+#include <stdint.h>
+
+#include <QString>
+
+#include "mythtvexp.h"
+
+/** \class FrameKernels
+ *  \brief The per pixel loops of commercial flagging, with SSE2 and
+ *         AVX2 versions.
+ *
+ *  The classic detector and the analyzers of CommDetector2 both call
+ *  these through Get(), which picks the best version for the CPU the
+ *  first time it is called. Every version gives exactly the same
+ *  results as the scalar one, so which one is used never changes what
+ *  is flagged.
+ *
+ *  The caller makes sure every pixel a kernel reads, as given for each
+ *  of them below, is inside the image. The vector versions read no
+ *  further than the scalar ones.
+ */
+class MTV_PUBLIC FrameKernels
+{
+  public:
+    typedef enum
+    {
+        kAuto = 0,
+        kScalar,
+        kSSE2,
+        kAVX2,
+    } Implementation;
+
+    /// The directions edgeFlags() found an edge in
+    enum
+    {
+        kEdgeHoriz = 0x01,
+        kEdgeVert  = 0x02,
+        kEdgeLDiag = 0x04,
+        kEdgeRDiag = 0x08,
+    };
+
+    class Table
+    {
+      public:
+        /** The min, max and sum of the pixels of a row whose mask byte
+         *  is 0xff, the others having a mask byte of 0. Those pixels
+         *  also raise colmax[i]. Without any, min is 255 and max 0.
+         */
+        void (*rowStats)(const uint8_t *row, const uint8_t *mask, int count,
+                         uint8_t *colmax, uint8_t *min, uint8_t *max,
+                         uint32_t *sum);
+
+        /// Copies every step'th pixel, dst[i] = src[i * step]
+        void (*gather)(const uint8_t *src, int count, int step, uint8_t *dst);
+
+        /** Counts the pixels in the 256 bins, and adds their sum and sum
+         *  of squares to *sum and *sumsq unless those are NULL.
+         */
+        void (*histogram)(const uint8_t *src, int count, int *bins,
+                          uint64_t *sum, uint64_t *sumsq);
+
+        /** The kEdge directions in which a pixel differs by diff or more
+         *  from either of its neighbours radius pixels away, reading
+         *  radius rows and columns around the count pixels.
+         */
+        void (*edgeFlags)(const uint8_t *src, int pitch, int count,
+                          int radius, int diff, uint8_t *flags);
+
+        /// The number of bits set in both a[i] and b[i]
+        uint32_t (*countBits)(const uint8_t *a, const uint8_t *b, int count);
+
+        /// The number of pixels non-zero in both a and b
+        uint32_t (*countBoth)(const uint8_t *a, const uint8_t *b, int count);
+
+        /** The squared gradient magnitude along the diagonals, between a
+         *  row r0 and the row r1 below it. Reads r0[count] and r1[count].
+         */
+        void (*gradient)(const uint8_t *r0, const uint8_t *r1, int count,
+                         uint32_t *sgm);
+
+        /** Convolves pixels tap bytes apart with the 2 * radius + 1
+         *  weights of mask, and rounds to the nearest pixel value. A tap
+         *  of 1 convolves along a row and the pitch down a column.
+         */
+        void (*convolve)(const uint8_t *src, int tap, int count,
+                         const double *mask, int radius, uint8_t *dst);
+
+        /** Widens [*min, *max] with the leading pixels until one would
+         *  make it span more than maxrange values, and returns the number
+         *  of pixels taken.
+         */
+        int (*rangeRun)(const uint8_t *src, int count, uint8_t *min,
+                        uint8_t *max, int maxrange);
+    };
+
+    static const Table &Get(void);
+    static const Table &Get(Implementation impl);
+
+    static bool IsAvailable(Implementation impl);
+    static Implementation GetBest(void);
+    static QString toString(Implementation impl);
+
+  private:
+    static const Table *s_best;
+};
+
+#endif // _FRAME_KERNELS_H_
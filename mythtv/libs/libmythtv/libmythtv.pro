@@ -141,7 +141,9 @@ HEADERS += ringbuffer.h             fileringbuffer.h
 HEADERS += streamingringbuffer.h    metadataimagehelper.h
 HEADERS += icringbuffer.h
 HEADERS += mythavutil.h
-HEADERS += recordingfile.h
+HEADERS += recordingfile.h          seekindex.h
+HEADERS += seektable.h              seektablebuilder.h
+HEADERS += framekernels.h
 HEADERS += driveroption.h
 
 SOURCES += recordinginfo.cpp
@@ -171,7 +173,9 @@ SOURCES += ringbuffer.cpp           fileringBuffer.cpp
 SOURCES += streamingringbuffer.cpp  metadataimagehelper.cpp
 SOURCES += icringbuffer.cpp
 SOURCES += mythframe.cpp            mythavutil.cpp
-SOURCES += recordingfile.cpp
+SOURCES += recordingfile.cpp        seekindex.cpp
+SOURCES += seektable.cpp            seektablebuilder.cpp
+SOURCES += framekernels.cpp
 
 # DiSEqC
 HEADERS += diseqc.h                 diseqcsettings.h
@@ -207,7 +211,9 @@ HEADERS += mpeg/freesat_huffman.h   mpeg/freesat_tables.h
 HEADERS += mpeg/iso6937tables.h
 HEADERS += mpeg/tsstats.h           mpeg/streamlisteners.h
 HEADERS += mpeg/H264Parser.h
-HEADERS += mpeg/tablestatus.h
+HEADERS += mpeg/tablestatus.h       mpeg/tssync.h
+HEADERS += mpeg/sectionworkerpool.h
+HEADERS += mpeg/mpegcrc.h
 
 SOURCES += mpeg/tspacket.cpp        mpeg/pespacket.cpp
 SOURCES += mpeg/mpegtables.cpp      mpeg/atsctables.cpp
@@ -223,7 +229,9 @@ SOURCES += mpeg/atsc_huffman.cpp
 SOURCES += mpeg/freesat_huffman.cpp
 SOURCES += mpeg/iso6937tables.cpp
 SOURCES += mpeg/H264Parser.cpp
-SOURCES += mpeg/tablestatus.cpp
+SOURCES += mpeg/tablestatus.cpp     mpeg/tssync.cpp
+SOURCES += mpeg/sectionworkerpool.cpp
+SOURCES += mpeg/mpegcrc.cpp
 
 # Channels, and the multiplexes that transmit them
 HEADERS += frequencies.h            frequencytables.h
@@ -601,9 +609,11 @@ using_backend {
     HEADERS += recorders/recorderbase.h
     HEADERS += recorders/DeviceReadBuffer.h
     HEADERS += recorders/dtvrecorder.h
+    HEADERS += recorders/livecommdetector.h
     SOURCES += recorders/recorderbase.cpp
     SOURCES += recorders/DeviceReadBuffer.cpp
     SOURCES += recorders/dtvrecorder.cpp
+    SOURCES += recorders/livecommdetector.cpp
 
     # Import recorder
     HEADERS += recorders/importrecorder.h
@@ -700,6 +710,7 @@ using_backend {
     HEADERS += recorders/iptvsignalmonitor.h
     HEADERS += recorders/iptvstreamhandler.h
     HEADERS *= recorders/streamhandler.h
+    HEADERS *= recorders/packetring.h
 
     HEADERS += recorders/rtp/udppacket.h
     HEADERS += recorders/rtp/udppacketbuffer.h
@@ -715,6 +726,7 @@ using_backend {
     SOURCES += recorders/iptvsignalmonitor.cpp
     SOURCES += recorders/iptvstreamhandler.cpp
     SOURCES *= recorders/streamhandler.cpp
+    SOURCES *= recorders/packetring.cpp
 
     SOURCES += recorders/rtp/packetbuffer.cpp
     SOURCES += recorders/rtp/rtppacketbuffer.cpp
@@ -767,7 +779,9 @@ using_backend {
         SOURCES += recorders/hdhrstreamhandler.cpp
 
         HEADERS *= recorders/streamhandler.h
+        HEADERS *= recorders/packetring.h
         SOURCES *= recorders/streamhandler.cpp
+        SOURCES *= recorders/packetring.cpp
 
         DEFINES += USING_HDHOMERUN
     }
@@ -797,7 +811,9 @@ using_backend {
         SOURCES += recorders/cetonstreamhandler.cpp
 
         HEADERS *= recorders/streamhandler.h
+        HEADERS *= recorders/packetring.h
         SOURCES *= recorders/streamhandler.cpp
+        SOURCES *= recorders/packetring.cpp
 
         DEFINES += USING_CETON
     }
@@ -843,7 +859,9 @@ using_backend {
         SOURCES += recorders/dvbstreamhandler.cpp
 
         HEADERS *= recorders/streamhandler.h
+        HEADERS *= recorders/packetring.h
         SOURCES *= recorders/streamhandler.cpp
+        SOURCES *= recorders/packetring.cpp
 
         # Misc
         HEADERS += recorders/dvbdev/dvbci.h
@@ -866,7 +884,9 @@ using_backend {
         SOURCES += recorders/asistreamhandler.cpp
 
         HEADERS *= recorders/streamhandler.h
+        HEADERS *= recorders/packetring.h
         SOURCES *= recorders/streamhandler.cpp
+        SOURCES *= recorders/packetring.cpp
 
         DEFINES += USING_ASI
     }
@@ -8,6 +8,7 @@ using namespace std;
 #include "dvbtables.h"
 #include "premieretables.h"
 #include "eithelper.h"
+#include "sectionworkerpool.h"
 
 #define PREMIERE_ONID 133
 #define FREESAT_EIT_PID 3842
@@ -22,7 +23,9 @@ DVBStreamData::DVBStreamData(uint desired_netid,  uint desired_tsid,
                              int desired_program, int cardnum, bool cacheTables)
     : MPEGStreamData(desired_program, cardnum, cacheTables),
       _desired_netid(desired_netid), _desired_tsid(desired_tsid),
-      _dvb_real_network_id(-1), _dvb_eit_dishnet_long(false)
+      _dvb_real_network_id(-1), _dvb_eit_dishnet_long(false),
+      _eit_dispatch_lock(QMutex::Recursive),
+      _section_workers(NULL)
 {
     _nit_status.SetVersion(-1,0);
     _nito_status.SetVersion(-1,0);
@@ -33,6 +36,8 @@ DVBStreamData::DVBStreamData(uint desired_netid,  uint desired_tsid,
 
 DVBStreamData::~DVBStreamData()
 {
+    SetSectionWorkers(false);
+
     Reset(_desired_netid, _desired_tsid, _desired_program);
 
     QMutexLocker locker(&_listener_lock);
@@ -53,15 +58,18 @@ void DVBStreamData::SetDesiredService(uint netid, uint tsid, int serviceid)
         if (networkID == netid)
         {
             reset = false;
-            _desired_netid = netid;
-            _desired_tsid = tsid;
+            {
+                QMutexLocker locker(&_listener_lock);
+                _desired_netid = netid;
+                _desired_tsid = tsid;
+            }
             uint last_section = first_sdt->LastSection();
-            ProcessSDT(_desired_tsid, first_sdt);
+            ProcessSDT(tsid, first_sdt);
             ReturnCachedTable(first_sdt);
             for (uint i = 1; i <= last_section; ++i)
             {
-                sdt_const_ptr_t sdt = GetCachedSDT(_desired_tsid, i, true);
-                ProcessSDT(_desired_tsid, sdt);
+                sdt_const_ptr_t sdt = GetCachedSDT(tsid, i, true);
+                ProcessSDT(tsid, sdt);
                 ReturnCachedTable(sdt);
             }
             SetDesiredProgram(serviceid);
@@ -169,8 +177,11 @@ void DVBStreamData::Reset(uint desired_netid, uint desired_tsid,
 {
     MPEGStreamData::Reset(desired_serviceid);
 
-    _desired_netid = desired_netid;
-    _desired_tsid  = desired_tsid;
+    {
+        QMutexLocker locker(&_listener_lock);
+        _desired_netid = desired_netid;
+        _desired_tsid  = desired_tsid;
+    }
 
     _nit_status.SetVersion(-1,0);
     _sdt_status.clear();
@@ -181,6 +192,12 @@ void DVBStreamData::Reset(uint desired_netid, uint desired_tsid,
     _sdto_status.clear();
     _bat_status.clear();
 
+    {
+        QMutexLocker locker(&_section_workers_lock);
+        if (_section_workers)
+            _section_workers->Clear();
+    }
+
     {
         _cache_lock.lock();
 
@@ -253,26 +270,9 @@ bool DVBStreamData::HandleTables(uint pid, const PSIPTable &psip)
             return true;
         }
         case TableID::SDT:
-        {
-            uint tsid = psip.TableIDExtension();
-            _sdt_status.SetSectionSeen(tsid, psip.Version(), psip.Section(),
-                                        psip.LastSection());
-
-            if (_cache_tables)
-            {
-                ServiceDescriptionTable *sdt =
-                    new ServiceDescriptionTable(psip);
-                CacheSDT(sdt);
-                ProcessSDT(tsid, sdt);
-            }
-            else
-            {
-                ServiceDescriptionTable sdt(psip);
-                ProcessSDT(tsid, &sdt);
-            }
-
-            return true;
-        }
+        case TableID::SDTo:
+        case TableID::BAT:
+            return QueueTable(pid, psip);
         case TableID::TDT:
         {
             TimeDateTable tdt(psip);
@@ -310,24 +310,167 @@ bool DVBStreamData::HandleTables(uint pid, const PSIPTable &psip)
 
             return true;
         }
+    }
+
+    if (IsEITTable(pid, psip) || IsCITTable(pid, psip))
+    {
+        {
+            QMutexLocker locker(&_listener_lock);
+            if (!_dvb_eit_listeners.size() && !_eit_helper)
+                return true;
+        }
+        return QueueTable(pid, psip);
+    }
+
+    return false;
+}
+
+uint DVBStreamData::DesiredNetworkID(void) const
+{
+    QMutexLocker locker(&_listener_lock);
+    return _desired_netid;
+}
+
+uint DVBStreamData::DesiredTransportID(void) const
+{
+    QMutexLocker locker(&_listener_lock);
+    return _desired_tsid;
+}
+
+bool DVBStreamData::IsEITTable(uint pid, const PSIPTable &psip) const
+{
+    if (!DVBEventInformationTable::IsEIT(psip.TableID()))
+        return false;
+
+    if (DVB_EIT_PID == pid || DVB_DNLONG_EIT_PID == pid ||
+        FREESAT_EIT_PID == pid || DVB_BVLONG_EIT_PID == pid)
+        return true;
+
+    if (MCA_EIT_PID != pid)
+        return false;
+
+    // called on the section workers too
+    QMutexLocker locker(&_listener_lock);
+    return (MCA_ONID == _desired_netid) && (MCA_EIT_TSID == _desired_tsid);
+}
+
+bool DVBStreamData::IsCITTable(uint pid, const PSIPTable &psip) const
+{
+    return (PREMIERE_EIT_DIREKT_PID == pid || PREMIERE_EIT_SPORT_PID == pid) &&
+        PremiereContentInformationTable::IsEIT(psip.TableID()) &&
+        DesiredNetworkID() == PREMIERE_ONID;
+}
+
+/** \fn DVBStreamData::QueueTable(uint, const PSIPTable&)
+ *  \brief Hands an SDT, BAT or EIT section to the section workers,
+ *         or processes it right away when there are none.
+ *
+ *  The section is only marked as seen once it has been queued. One
+ *  that was refused because its table id has too much queued already
+ *  is taken the next time it comes round in the carousel.
+ */
+bool DVBStreamData::QueueTable(uint pid, const PSIPTable &psip)
+{
+    {
+        QMutexLocker locker(&_section_workers_lock);
+        if (_section_workers)
+        {
+            if (_section_workers->Enqueue(pid, psip))
+                SetSectionSeen(pid, psip);
+            return true;
+        }
+    }
+
+    SetSectionSeen(pid, psip);
+    HandleQueuedTable(pid, psip);
+    return true;
+}
+
+void DVBStreamData::SetSectionSeen(uint pid, const PSIPTable &psip)
+{
+    uint ext = psip.TableIDExtension();
+    switch (psip.TableID())
+    {
+        case TableID::SDT:
+            _sdt_status.SetSectionSeen(ext, psip.Version(), psip.Section(),
+                                        psip.LastSection());
+            return;
+        case TableID::SDTo:
+            _sdto_status.SetSectionSeen(ext, psip.Version(), psip.Section(),
+                                        psip.LastSection());
+            return;
+        case TableID::BAT:
+            _bat_status.SetSectionSeen(ext, psip.Version(), psip.Section(),
+                                        psip.LastSection());
+            return;
+    }
+
+    if (IsEITTable(pid, psip))
+    {
+        uint key = (psip.TableID()<<16) | ext;
+        _eit_status.SetSectionSeen(key, psip.Version(), psip.Section(),
+                                    psip.LastSection());
+    }
+    else if (IsCITTable(pid, psip))
+    {
+        PremiereContentInformationTable cit(psip);
+        _cit_status.SetSectionSeen(cit.ContentID(), psip.Version(),
+                                   psip.Section(), psip.LastSection());
+    }
+}
+
+/** \fn DVBStreamData::HandleQueuedTable(uint, const PSIPTable&)
+ *  \brief Parses an SDT, BAT or EIT section and hands it to the
+ *         listeners.
+ *
+ *  This runs on a section worker when they are enabled, the table
+ *  status has already been updated by QueueTable().
+ */
+void DVBStreamData::HandleQueuedTable(uint pid, const PSIPTable &psip)
+{
+    switch (psip.TableID())
+    {
+        case TableID::SDT:
+        {
+            uint tsid = psip.TableIDExtension();
+            if (_cache_tables)
+            {
+                ServiceDescriptionTable *sdt =
+                    new ServiceDescriptionTable(psip);
+                CacheSDT(sdt);
+                ProcessSDT(tsid, sdt);
+            }
+            else
+            {
+                ServiceDescriptionTable sdt(psip);
+                ProcessSDT(tsid, &sdt);
+            }
+
+            return;
+        }
         case TableID::SDTo:
         {
             uint tsid = psip.TableIDExtension();
-            _sdto_status.SetSectionSeen(tsid, psip.Version(), psip.Section(),
-                                        psip.LastSection());
             ServiceDescriptionTable sdt(psip);
 
+            uint desired_netid, desired_tsid;
+            {
+                QMutexLocker locker(&_listener_lock);
+                desired_netid = _desired_netid;
+                desired_tsid  = _desired_tsid;
+            }
+
             // some providers send the SDT for the current multiplex as SDTo
             // this routine changes the TableID to SDT and recalculates the CRC
-            if (_desired_netid == sdt.OriginalNetworkID() &&
-                _desired_tsid  == tsid)
+            if (desired_netid == sdt.OriginalNetworkID() &&
+                desired_tsid  == tsid)
             {
                 ServiceDescriptionTable *sdta =
                     new ServiceDescriptionTable(psip);
                 if (!sdta->Mutate())
                 {
                     delete sdta;
-                    return true;
+                    return;
                 }
                 if (_cache_tables)
                 {
@@ -339,76 +482,106 @@ bool DVBStreamData::HandleTables(uint pid, const PSIPTable &psip)
                     ProcessSDT(tsid, sdta);
                     delete sdta;
                 }
-                return true;
+                return;
             }
 
             QMutexLocker locker(&_listener_lock);
             for (uint i = 0; i < _dvb_other_listeners.size(); i++)
                 _dvb_other_listeners[i]->HandleSDTo(tsid, &sdt);
 
-            return true;
+            return;
         }
         case TableID::BAT:
         {
-            uint bid = psip.TableIDExtension();
-            _bat_status.SetSectionSeen(bid, psip.Version(), psip.Section(),
-                                        psip.LastSection());
             BouquetAssociationTable bat(psip);
 
             QMutexLocker locker(&_listener_lock);
             for (uint i = 0; i < _dvb_other_listeners.size(); i++)
                 _dvb_other_listeners[i]->HandleBAT(&bat);
 
-            return true;
+            return;
         }
     }
 
-    if ((DVB_EIT_PID == pid || DVB_DNLONG_EIT_PID == pid || FREESAT_EIT_PID == pid ||
-        ((MCA_ONID == _desired_netid) && (MCA_EIT_TSID == _desired_tsid) &&
-        (MCA_EIT_PID == pid)) || DVB_BVLONG_EIT_PID == pid) &&
+    bool is_eit = IsEITTable(pid, psip);
+    if (!is_eit && !IsCITTable(pid, psip))
+        return;
 
-        DVBEventInformationTable::IsEIT(psip.TableID()))
+    // The listeners are called without _listener_lock, AddEIT can take
+    // a while. Removing a listener or the helper waits for this instead.
+    QMutexLocker dispatch_locker(&_eit_dispatch_lock);
+    dvb_eit_listener_vec_t eit_listeners;
+    EITHelper *eit_helper;
     {
         QMutexLocker locker(&_listener_lock);
-        if (!_dvb_eit_listeners.size() && !_eit_helper)
-            return true;
-
-        uint service_id = psip.TableIDExtension();
-        uint key = (psip.TableID()<<16) | service_id;
-        _eit_status.SetSectionSeen(key, psip.Version(), psip.Section(),
-                                    psip.LastSection());
+        eit_listeners = _dvb_eit_listeners;
+        eit_helper    = _eit_helper;
+    }
 
+    if (is_eit)
+    {
         DVBEventInformationTable eit(psip);
-        for (uint i = 0; i < _dvb_eit_listeners.size(); i++)
-            _dvb_eit_listeners[i]->HandleEIT(&eit);
 
-        if (_eit_helper)
-            _eit_helper->AddEIT(&eit);
+        for (uint i = 0; i < eit_listeners.size(); i++)
+            eit_listeners[i]->HandleEIT(&eit);
 
-        return true;
+        if (eit_helper)
+            eit_helper->AddEIT(&eit);
     }
-
-    if (_desired_netid == PREMIERE_ONID &&
-        (PREMIERE_EIT_DIREKT_PID == pid || PREMIERE_EIT_SPORT_PID == pid) &&
-        PremiereContentInformationTable::IsEIT(psip.TableID()))
+    else
     {
-        QMutexLocker locker(&_listener_lock);
-        if (!_dvb_eit_listeners.size() && !_eit_helper)
-            return true;
-
         PremiereContentInformationTable cit(psip);
-        _cit_status.SetSectionSeen(cit.ContentID(), psip.Version(), psip.Section(), psip.LastSection());
 
-        for (uint i = 0; i < _dvb_eit_listeners.size(); i++)
-            _dvb_eit_listeners[i]->HandleEIT(&cit);
+        for (uint i = 0; i < eit_listeners.size(); i++)
+            eit_listeners[i]->HandleEIT(&cit);
 
-        if (_eit_helper)
-            _eit_helper->AddEIT(&cit);
+        if (eit_helper)
+            eit_helper->AddEIT(&cit);
+    }
+}
 
-        return true;
+/** \fn DVBStreamData::SetSectionWorkers(bool)
+ *  \brief Starts or stops the threads the SDT, BAT and EIT sections
+ *         are parsed on.
+ *
+ *  Without them these tables are parsed on the thread that feeds
+ *  ProcessData(), which is what channel scanning wants. PAT, PMT,
+ *  NIT and TDT are always handled right away.
+ */
+void DVBStreamData::SetSectionWorkers(bool enable)
+{
+    SectionWorkerPool *old = NULL;
+    {
+        QMutexLocker locker(&_section_workers_lock);
+        if (enable == bool(_section_workers))
+            return;
+        if (enable)
+        {
+            _section_workers =
+                new SectionWorkerPool(this, QString::number(_cardid));
+            return;
+        }
+        old = _section_workers;
+        _section_workers = NULL;
     }
+    // waits for the section being handled, which may need _listener_lock
+    delete old;
+}
 
-    return false;
+/// Parses EIT on the section workers for as long as it is collected
+void DVBStreamData::SetEITHelper(EITHelper *eit_helper)
+{
+    if (!eit_helper)
+        SetSectionWorkers(false);
+
+    MPEGStreamData::SetEITHelper(eit_helper);
+
+    // wait for HandleQueuedTable() to be done with the old helper
+    _eit_dispatch_lock.lock();
+    _eit_dispatch_lock.unlock();
+
+    if (eit_helper)
+        SetSectionWorkers(true);
 }
 
 void DVBStreamData::ProcessSDT(uint tsid, const ServiceDescriptionTable *sdt)
@@ -902,15 +1075,20 @@ void DVBStreamData::AddDVBEITListener(DVBEITStreamListener *val)
 
 void DVBStreamData::RemoveDVBEITListener(DVBEITStreamListener *val)
 {
-    QMutexLocker locker(&_listener_lock);
-
-    dvb_eit_listener_vec_t::iterator it = _dvb_eit_listeners.begin();
-    for (; it != _dvb_eit_listeners.end(); ++it)
     {
-        if (((void*)val) == ((void*)*it))
+        QMutexLocker locker(&_listener_lock);
+
+        dvb_eit_listener_vec_t::iterator it = _dvb_eit_listeners.begin();
+        for (; it != _dvb_eit_listeners.end(); ++it)
         {
-            _dvb_eit_listeners.erase(it);
-            return;
+            if (((void*)val) == ((void*)*it))
+            {
+                _dvb_eit_listeners.erase(it);
+                break;
+            }
         }
     }
+
+    // wait for HandleQueuedTable() to be done with the listener
+    QMutexLocker dispatch_locker(&_eit_dispatch_lock);
 }
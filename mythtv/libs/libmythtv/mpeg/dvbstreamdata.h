@@ -6,6 +6,7 @@
 #include "mpegstreamdata.h"
 #include "mythtvexp.h"
 #include "tablestatus.h"
+#include "sectionworkerpool.h"
 
 typedef NetworkInformationTable* nit_ptr_t;
 typedef NetworkInformationTable const* nit_const_ptr_t;
@@ -24,7 +25,8 @@ typedef vector<DVBEITStreamListener*>    dvb_eit_listener_vec_t;
 
 typedef QMap<uint, bool>                 dvb_has_eit_t;
 
-class MTV_PUBLIC DVBStreamData : virtual public MPEGStreamData
+class MTV_PUBLIC DVBStreamData :
+    virtual public MPEGStreamData, public SectionHandler
 {
   public:
     DVBStreamData(uint desired_netid, uint desired_tsid,
@@ -37,13 +39,18 @@ class MTV_PUBLIC DVBStreamData : virtual public MPEGStreamData
 
     // DVB table monitoring
     void SetDesiredService(uint netid, uint tsid, int serviceid);
-    uint DesiredNetworkID(void)   const { return _desired_netid; }
-    uint DesiredTransportID(void) const { return _desired_tsid;  }
+    uint DesiredNetworkID(void) const;
+    uint DesiredTransportID(void) const;
 
     // Table processing
     bool HandleTables(uint pid, const PSIPTable&);
     bool IsRedundant(uint pid, const PSIPTable&) const;
     void ProcessSDT(uint tsid, const ServiceDescriptionTable*);
+    void HandleQueuedTable(uint pid, const PSIPTable&);
+
+    // SDT, BAT and EIT parsing off the stream thread
+    void SetSectionWorkers(bool enable);
+    void SetEITHelper(EITHelper *eit_helper);
 
     // NIT for broken providers
     inline void SetRealNetworkID(int);
@@ -105,6 +112,11 @@ class MTV_PUBLIC DVBStreamData : virtual public MPEGStreamData
     void RemoveDVBEITListener(DVBEITStreamListener*);
 
   private:
+    bool QueueTable(uint pid, const PSIPTable&);
+    void SetSectionSeen(uint pid, const PSIPTable&);
+    bool IsEITTable(uint pid, const PSIPTable&) const;
+    bool IsCITTable(uint pid, const PSIPTable&) const;
+
     // Caching
     void CacheNIT(NetworkInformationTable*);
     void CacheSDT(ServiceDescriptionTable*);
@@ -112,7 +124,8 @@ class MTV_PUBLIC DVBStreamData : virtual public MPEGStreamData
     virtual bool DeleteCachedTable(PSIPTable *psip) const;
 
   private:
-    /// DVB table monitoring
+    /// DVB table monitoring, read by the section workers, so these
+    /// are only changed with _listener_lock held
     uint                      _desired_netid;
     uint                      _desired_tsid;
 
@@ -128,6 +141,9 @@ class MTV_PUBLIC DVBStreamData : virtual public MPEGStreamData
     dvb_main_listener_vec_t   _dvb_main_listeners;
     dvb_other_listener_vec_t  _dvb_other_listeners;
     dvb_eit_listener_vec_t    _dvb_eit_listeners;
+    /// Held while HandleQueuedTable() calls the EIT listeners and
+    /// the EIT helper, taken after _listener_lock is released
+    QMutex                    _eit_dispatch_lock;
 
     // Table versions
     TableStatus               _nit_status;
@@ -142,6 +158,10 @@ class MTV_PUBLIC DVBStreamData : virtual public MPEGStreamData
     // Caching
     mutable nit_cache_t       _cached_nit;  // section -> sdt
     mutable sdt_cache_t       _cached_sdts; // tsid+section -> sdt
+
+    // SDT, BAT and EIT parsing
+    QMutex                    _section_workers_lock;
+    SectionWorkerPool        *_section_workers;
 };
 
 inline void DVBStreamData::SetDishNetEIT(bool use_dishnet_eit)
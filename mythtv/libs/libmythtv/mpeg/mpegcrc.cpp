@@ -0,0 +1,258 @@
+// -*- Mode: c++ -*-
+
+// MythTV headers
+#include "mythconfig.h"
+#include "mpegcrc.h"
+
+extern "C" {
+#include "libavutil/crc.h"
+#include "libavutil/bswap.h"
+}
+
+// The PCLMULQDQ version is built with a per function target attribute,
+// so the rest of libmythtv keeps its baseline instruction set.
+#if ARCH_X86_64 && (defined(__clang__) || \
+    (defined(__GNUC__) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define MPEGCRC_CLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define MPEGCRC_CLMUL 0
+#endif
+
+MPEGCRC::CalcFunc MPEGCRC::s_calc = MPEGCRC::Dispatch;
+
+static const uint32_t kPoly = 0x04C11DB7;
+
+/// Lookup tables for slicing-by-8, t[k][n] is the CRC of byte n
+/// followed by k zero bytes
+class SliceTables
+{
+  public:
+    SliceTables()
+    {
+        for (uint n = 0; n < 256; n++)
+        {
+            uint32_t crc = n << 24;
+            for (uint i = 0; i < 8; i++)
+                crc = (crc << 1) ^ ((crc & 0x80000000) ? kPoly : 0);
+            t[0][n] = crc;
+        }
+        for (uint k = 1; k < 8; k++)
+        {
+            for (uint n = 0; n < 256; n++)
+                t[k][n] = (t[k-1][n] << 8) ^ t[0][t[k-1][n] >> 24];
+        }
+    }
+
+    uint32_t t[8][256];
+};
+
+static const SliceTables s_tables;
+
+static uint32_t calc_avcrc(const unsigned char *data, uint len, uint32_t crc)
+{
+    return av_bswap32(av_crc(av_crc_get_table(AV_CRC_32_IEEE),
+                             av_bswap32(crc), data, len));
+}
+
+static uint32_t calc_slice8(const unsigned char *data, uint len, uint32_t crc)
+{
+    const uint32_t (*t)[256] = s_tables.t;
+
+    for (; len >= 8; data += 8, len -= 8)
+    {
+        crc ^= ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) |
+               ((uint32_t) data[2] <<  8) |  (uint32_t) data[3];
+        crc = t[7][crc >> 24] ^ t[6][(crc >> 16) & 0xff] ^
+              t[5][(crc >> 8) & 0xff] ^ t[4][crc & 0xff] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+    }
+
+    for (; len; data++, len--)
+        crc = (crc << 8) ^ t[0][(crc >> 24) ^ *data];
+
+    return crc;
+}
+
+#if MPEGCRC_CLMUL
+
+// x^n mod P, for folding and the final reduction
+static const uint64_t kXpow64  = 0x490d678d;
+static const uint64_t kXpow96  = 0xf200aa66;
+static const uint64_t kXpow128 = 0xe8a45605;
+static const uint64_t kXpow192 = 0xc5b9cd4c;
+static const uint64_t kXpow512 = 0xe6228b11;
+static const uint64_t kXpow576 = 0x8833794c;
+/// floor(x^64 / P), for the Barrett reduction
+static const uint64_t kMu      = 0x104d101dfULL;
+static const uint64_t kP       = 0x104c11db7ULL;
+
+/// The 16 bytes at p with the first one in the most significant bits
+__attribute__((target("sse2,ssse3")))
+static inline __m128i load_be(const unsigned char *p)
+{
+    const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                      8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) p), swap);
+}
+
+/// r * x^n mod P, as far as is needed, with k holding
+/// x^(n+64) mod P high and x^n mod P low
+__attribute__((target("sse2,pclmul")))
+static inline __m128i fold(__m128i r, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(r, k, 0x11),
+                         _mm_clmulepi64_si128(r, k, 0x00));
+}
+
+/** \brief Folds the data with carry-less multiplies.
+ *
+ *  Blocks are kept as 128 bit polynomials congruent to the data read
+ *  so far modulo P. Four run side by side over each 64 bytes to hide
+ *  the multiply latency, then collapse into one that moves 16 bytes
+ *  at a time. The remainder is reduced to 32 bits with a Barrett
+ *  reduction and any tail goes through the tables.
+ */
+__attribute__((target("sse2,ssse3,pclmul")))
+static uint32_t calc_pclmul(const unsigned char *data, uint len, uint32_t crc)
+{
+    if (len < 32)
+        return calc_slice8(data, len, crc);
+
+    const __m128i k128 = _mm_set_epi64x(kXpow192, kXpow128);
+    __m128i r = _mm_xor_si128(load_be(data),
+                              _mm_set_epi32(crc, 0, 0, 0));
+    data += 16;
+    len  -= 16;
+
+    if (len >= 112)
+    {
+        const __m128i k512 = _mm_set_epi64x(kXpow576, kXpow512);
+        __m128i r1 = load_be(data);
+        __m128i r2 = load_be(data + 16);
+        __m128i r3 = load_be(data + 32);
+        data += 48;
+        len  -= 48;
+
+        for (; len >= 64; data += 64, len -= 64)
+        {
+            r  = _mm_xor_si128(fold(r,  k512), load_be(data));
+            r1 = _mm_xor_si128(fold(r1, k512), load_be(data + 16));
+            r2 = _mm_xor_si128(fold(r2, k512), load_be(data + 32));
+            r3 = _mm_xor_si128(fold(r3, k512), load_be(data + 48));
+        }
+
+        r = _mm_xor_si128(fold(r, k128), r1);
+        r = _mm_xor_si128(fold(r, k128), r2);
+        r = _mm_xor_si128(fold(r, k128), r3);
+    }
+
+    for (; len >= 16; data += 16, len -= 16)
+        r = _mm_xor_si128(fold(r, k128), load_be(data));
+
+    // r * x^32 mod P: first to 96 bits, then to 64
+    const __m128i k96 = _mm_set_epi64x(0, kXpow96);
+    __m128i t = _mm_xor_si128(_mm_clmulepi64_si128(r, k96, 0x01),
+                              _mm_slli_si128(_mm_move_epi64(r), 4));
+    const __m128i k64 = _mm_set_epi64x(0, kXpow64);
+    t = _mm_xor_si128(_mm_clmulepi64_si128(_mm_srli_si128(t, 8), k64, 0x00),
+                      _mm_move_epi64(t));
+
+    // Barrett: q = ((t / x^32) * mu) / x^32, crc = t - q * P
+    const __m128i barrett = _mm_set_epi64x(kP, kMu);
+    __m128i q = _mm_clmulepi64_si128(_mm_srli_epi64(t, 32), barrett, 0x00);
+    q = _mm_srli_epi64(q, 32);
+    __m128i rem = _mm_xor_si128(t, _mm_clmulepi64_si128(q, barrett, 0x10));
+    crc = (uint32_t) _mm_cvtsi128_si32(rem);
+
+    return len ? calc_slice8(data, len, crc) : crc;
+}
+
+/// libavutil has no flag for PCLMULQDQ, so ask the CPU once
+static bool has_pclmul(void)
+{
+    static int s_has = -1;
+    if (s_has < 0)
+    {
+        uint eax, ebx, ecx, edx;
+        s_has = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+            (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+    }
+    return s_has;
+}
+
+#endif // MPEGCRC_CLMUL
+
+/** \fn MPEGCRC::Calc(Implementation,const unsigned char*,uint,uint32_t)
+ *  \brief Like Calc(), but with a specific implementation.
+ *
+ *  Mostly useful for testing, an implementation that is not available
+ *  on this CPU falls back to slicing-by-8.
+ */
+uint32_t MPEGCRC::Calc(Implementation impl, const unsigned char *data,
+                       uint len, uint32_t crc)
+{
+    return GetFunc(impl)(data, len, crc);
+}
+
+bool MPEGCRC::IsAvailable(Implementation impl)
+{
+    switch (impl)
+    {
+        case kAuto:
+        case kAVCRC:
+        case kSliceBy8:
+            return true;
+#if MPEGCRC_CLMUL
+        case kPCLMUL:
+            return has_pclmul();
+#endif
+        default:
+            return false;
+    }
+}
+
+MPEGCRC::Implementation MPEGCRC::GetBest(void)
+{
+    if (IsAvailable(kPCLMUL))
+        return kPCLMUL;
+    return kSliceBy8;
+}
+
+QString MPEGCRC::toString(Implementation impl)
+{
+    switch (impl)
+    {
+        case kAuto:     return "auto";
+        case kAVCRC:    return "av_crc";
+        case kSliceBy8: return "slice-by-8";
+        case kPCLMUL:   return "pclmul";
+    }
+    return "unknown";
+}
+
+MPEGCRC::CalcFunc MPEGCRC::GetFunc(Implementation impl)
+{
+    if (impl == kAuto)
+        impl = GetBest();
+    if (!IsAvailable(impl))
+        return calc_slice8;
+
+    switch (impl)
+    {
+        case kAVCRC:  return calc_avcrc;
+#if MPEGCRC_CLMUL
+        case kPCLMUL: return calc_pclmul;
+#endif
+        default:      return calc_slice8;
+    }
+}
+
+/// Resolves s_calc on first use
+uint32_t MPEGCRC::Dispatch(const unsigned char *data, uint len, uint32_t crc)
+{
+    s_calc = GetFunc(kAuto);
+    return s_calc(data, len, crc);
+}
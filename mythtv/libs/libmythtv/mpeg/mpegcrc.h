@@ -0,0 +1,56 @@
+// -*- Mode: c++ -*-
+#ifndef _MPEG_CRC_H_
+#define _MPEG_CRC_H_
+
+#include <stdint.h>
+
+#include <QString>
+
+#include "mythtvexp.h"
+
+/** \class MPEGCRC
+ *  \brief The CRC-32 of ISO/IEC 13818-1 Annex A that PSI and SI
+ *         sections end with.
+ *
+ *  This is the MSB first CRC with polynomial 0x04C11DB7, an initial
+ *  value of 0xFFFFFFFF and no final xor. Calc() gives the same result
+ *  as byte swapping libavutil's av_crc() with the AV_CRC_32_IEEE
+ *  table, which processes one byte per table lookup.
+ *
+ *  The portable version uses slicing-by-8, eight bytes per round of
+ *  lookups. On x86-64 CPUs with PCLMULQDQ the bulk of a section is
+ *  folded 64 bytes at a time with carry-less multiplies instead.
+ */
+class MTV_PUBLIC MPEGCRC
+{
+  public:
+    typedef enum
+    {
+        kAuto = 0,
+        kAVCRC,     ///< libavutil, the reference
+        kSliceBy8,
+        kPCLMUL,
+    } Implementation;
+
+    static uint32_t Calc(const unsigned char *data, uint len,
+                         uint32_t crc = 0xFFFFFFFF)
+    {
+        return s_calc(data, len, crc);
+    }
+    static uint32_t Calc(Implementation impl, const unsigned char *data,
+                         uint len, uint32_t crc = 0xFFFFFFFF);
+
+    static bool IsAvailable(Implementation impl);
+    static Implementation GetBest(void);
+    static QString toString(Implementation impl);
+
+  private:
+    typedef uint32_t (*CalcFunc)(const unsigned char*, uint, uint32_t);
+    static CalcFunc GetFunc(Implementation impl);
+    static uint32_t Dispatch(const unsigned char *data, uint len,
+                             uint32_t crc);
+
+    static CalcFunc s_calc;
+};
+
+#endif // _MPEG_CRC_H_
@@ -13,6 +13,7 @@ using namespace std;
 // MythTV headers
 #include "mpegstreamdata.h"
 #include "mpegtables.h"
+#include "tssync.h"
 #include "ringbuffer.h"
 #include "mpegtables.h"
 
@@ -43,7 +44,8 @@ MPEGStreamData::MPEGStreamData(int desiredProgram, int cardnum,
       _si_time_offset_cnt(0),
       _si_time_offset_indx(0),
       _eit_helper(NULL), _eit_rate(0.0f),
-      _listening_disabled(false),
+      _listening_disabled(false), _batch_processing(false),
+      _pid_flags_gen(0),
       _encryption_lock(QMutex::Recursive), _listener_lock(QMutex::Recursive),
       _cache_tables(cacheTables), _cache_lock(QMutex::Recursive),
       // Single program stuff
@@ -59,6 +61,7 @@ MPEGStreamData::MPEGStreamData(int desiredProgram, int cardnum,
       _invalid_pat_seen(false), _invalid_pat_warning(false)
 {
     memset(_si_time_offsets, 0, sizeof(_si_time_offsets));
+    memset(_pid_flags, 0, sizeof(_pid_flags));
 
     AddListeningPID(MPEG_PAT_PID);
     AddListeningPID(MPEG_CAT_PID);
@@ -161,12 +164,13 @@ void MPEGStreamData::Reset(int desiredProgram)
         DeletePartialPSIP(it.key());
     _partial_psip_packet_cache.clear();
 
-    _pids_listening.clear();
-    _pids_notlistening.clear();
-    _pids_writing.clear();
-    _pids_audio.clear();
+    ClearListeningPIDs();
+    ClearNotListeningPIDs();
+    ClearWritingPIDs();
+    ClearAudioPIDs();
 
     _pid_video_single_program = _pid_pmt_single_program = 0xffffffff;
+    _pid_flags_gen++;
 
     _pat_status.clear();
 
@@ -613,12 +617,13 @@ bool MPEGStreamData::CreatePMTSingleProgram(const ProgramMapTable &pmt)
             AddListeningPID(cad.PID());
     }
 
-    _pids_audio.clear();
+    ClearAudioPIDs();
     for (uint i = 0; i < audioPIDs.size(); i++)
         AddAudioPID(audioPIDs[i]);
 
-    _pids_writing.clear();
+    ClearWritingPIDs();
     _pid_video_single_program = !videoPIDs.empty() ? videoPIDs[0] : 0xffffffff;
+    _pid_flags_gen++;
     for (uint i = 1; i < videoPIDs.size(); i++)
         AddWritingPID(videoPIDs[i]);
 
@@ -979,47 +984,76 @@ int MPEGStreamData::ProcessData(const unsigned char *buffer, int len)
         return 0;
     }
 
+    if (_batch_processing)
+        return ProcessDataBatch(buffer, len);
+
     while (pos + int(TSPacket::kSize) <= len)
     { // while we have a whole packet left...
         if (buffer[pos] != SYNC_BYTE || resync)
         {
-            int newpos = ResyncStream(buffer, pos+1, len);
-            LOG(VB_RECORD, LOG_DEBUG, LOC +
-                QString("Resyncing @ %1+1 w/len %2 -> %3")
-                .arg(pos).arg(len).arg(newpos));
-            if (newpos == -1)
-                return len - pos;
-            if (newpos == -2)
-                return TSPacket::kSize;
-            pos = newpos;
+            int remainder;
+            pos = Resync(buffer, pos, len, remainder);
+            if (pos < 0)
+                return remainder;
         }
 
         const TSPacket *pkt = reinterpret_cast<const TSPacket*>(&buffer[pos]);
-        pos += TSPacket::kSize; // Advance to next TS packet
-        resync = false;
-        if (!ProcessTSPacket(*pkt))
-        {
-            if (pos + int(TSPacket::kSize) > len)
-                continue;
-            if (buffer[pos] != SYNC_BYTE)
-            {
-                // if ProcessTSPacket fails, and we don't appear to be
-                // in sync on the next packet, then resync. Otherwise
-                // just process the next packet normally.
-                pos -= TSPacket::kSize;
-                resync = true;
-            }
-        }
+        resync = !ProcessTSPacket(*pkt) && LostSyncAfter(buffer, pos, len);
+        if (!resync)
+            pos += TSPacket::kSize; // Advance to next TS packet
     }
 
     return len - pos;
 }
 
+/** rief Returns true if the packet at pos failed ProcessTSPacket()
+ *         and is followed by a whole packet without a sync byte.
+ *
+ *  The stream is then resynced from inside the bad packet, otherwise
+ *  the next packet is processed normally. ProcessData() and
+ *  ProcessDataBatch() both use this, so they skip the same bytes.
+ */
+bool MPEGStreamData::LostSyncAfter(const unsigned char *buffer, int pos,
+                                   int len)
+{
+    int next = pos + TSPacket::kSize;
+    return next + int(TSPacket::kSize) <= len && buffer[next] != SYNC_BYTE;
+}
+
+/** rief Returns the offset of the first packet start after pos.
+ *
+ *  Returns -1 if there is none, then \a remainder is set to what
+ *  ProcessData() returns: the bytes from pos on when more data may
+ *  complete a packet, or one packet size when no packet start was found.
+ */
+int MPEGStreamData::Resync(const unsigned char *buffer, int pos, int len,
+                           int &remainder)
+{
+    int newpos = ResyncStream(buffer, pos+1, len);
+    LOG(VB_RECORD, LOG_DEBUG, LOC +
+        QString("Resyncing @ %1+1 w/len %2 -> %3")
+        .arg(pos).arg(len).arg(newpos));
+    if (newpos == -1)
+    {
+        remainder = len - pos;
+        return -1;
+    }
+    if (newpos == -2)
+    {
+        remainder = TSPacket::kSize;
+        return -1;
+    }
+    return newpos;
+}
+
 bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
 {
     bool ok = !tspacket.TransportError();
+    const uint pid = tspacket.PID();
+    const uint flags = _pid_flags[pid];
 
-    if (IsEncryptionTestPID(tspacket.PID()))
+    // The flag is only a hint, the locked lookup is authoritative
+    if ((flags & kPIDEncryptionTest) && IsEncryptionTestPID(pid))
     {
         ProcessEncryptedPacket(tspacket);
     }
@@ -1030,7 +1064,7 @@ bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
     if (tspacket.Scrambled())
         return true;
 
-    if (IsVideoPID(tspacket.PID()))
+    if (IsVideoPID(pid))
     {
         for (uint j = 0; j < _ts_av_listeners.size(); j++)
             _ts_av_listeners[j]->ProcessVideoTSPacket(tspacket);
@@ -1038,7 +1072,7 @@ bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
         return true;
     }
 
-    if (IsAudioPID(tspacket.PID()))
+    if (flags & kPIDAudio)
     {
         for (uint j = 0; j < _ts_av_listeners.size(); j++)
             _ts_av_listeners[j]->ProcessAudioTSPacket(tspacket);
@@ -1046,13 +1080,14 @@ bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
         return true;
     }
 
-    if (IsWritingPID(tspacket.PID()))
+    if (flags & kPIDWriting)
     {
         for (uint j = 0; j < _ts_writing_listeners.size(); j++)
             _ts_writing_listeners[j]->ProcessTSPacket(tspacket);
     }
 
-    if (IsListeningPID(tspacket.PID()) && tspacket.HasPayload())
+    if (((flags & (kPIDListening | kPIDNotListening)) == kPIDListening) &&
+        !_listening_disabled && tspacket.HasPayload())
     {
         HandleTSTables(&tspacket);
     }
@@ -1060,50 +1095,135 @@ bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
     return true;
 }
 
-int MPEGStreamData::ResyncStream(const unsigned char *buffer, int curr_pos,
-                                 int len)
+/** \brief Batch variant of ProcessData().
+ *
+ *  The in-sync part of the buffer is classified first using the PID
+ *  flag table. Consecutive clean packets on the video PID or on an
+ *  audio PID are then handed to each TSPacketListenerAV as one run,
+ *  everything else goes through ProcessTSPacket() in stream order.
+ *  If handling a table changes the PID set, the rest of the buffer
+ *  is classified again before it is dispatched. A packet that fails
+ *  ProcessTSPacket() is skipped or resynced from like in ProcessData().
+ */
+int MPEGStreamData::ProcessDataBatch(const unsigned char *buffer, int len)
 {
-    // Search for two sync bytes 188 bytes apart,
-    int pos = curr_pos;
-    int nextpos = pos + TSPacket::kSize;
-    if (nextpos >= len)
-        return -1; // not enough bytes; caller should try again
+    enum { kOther = 0, kVideo = 1, kAudio = 2 };
 
-    while (buffer[pos] != SYNC_BYTE || buffer[nextpos] != SYNC_BYTE)
+    int pos = 0;
+    while (pos + int(TSPacket::kSize) <= len)
     {
-        pos++;
-        nextpos++;
-        if (nextpos == len)
-            return -2; // not found
+        if (buffer[pos] != SYNC_BYTE)
+        {
+            int remainder;
+            pos = Resync(buffer, pos, len, remainder);
+            if (pos < 0)
+                return remainder;
+        }
+
+        // Classify the in-sync packets starting at pos
+        const TSPacket *pkts = reinterpret_cast<const TSPacket*>(&buffer[pos]);
+        uint max_pkts = (len - pos) / TSPacket::kSize;
+        if (_batch_class.size() < max_pkts)
+            _batch_class.resize(max_pkts);
+
+        uint npkts = 0;
+        for (; npkts < max_pkts && pkts[npkts].HasSync(); ++npkts)
+        {
+            const TSPacket &pkt = pkts[npkts];
+            const uint pid   = pkt.PID();
+            unsigned char cls = kOther;
+            if (!pkt.TransportError() && !pkt.Scrambled() &&
+                !(_pid_flags[pid] & kPIDEncryptionTest))
+            {
+                if (IsVideoPID(pid))
+                    cls = kVideo;
+                else if (_pid_flags[pid] & kPIDAudio)
+                    cls = kAudio;
+            }
+            _batch_class[npkts] = cls;
+        }
+
+        // Dispatch, one listener call per run of A/V packets
+        const uint gen = _pid_flags_gen;
+        uint i = 0;
+        bool resync = false;
+        while (i < npkts && !resync && gen == _pid_flags_gen)
+        {
+            const unsigned char cls = _batch_class[i];
+            if (cls == kOther)
+            {
+                resync = !ProcessTSPacket(pkts[i]) &&
+                    LostSyncAfter(buffer, pos + i * TSPacket::kSize, len);
+                if (!resync)
+                    ++i;
+                continue;
+            }
+
+            uint j = i + 1;
+            while (j < npkts && _batch_class[j] == cls)
+                ++j;
+            for (uint k = 0; k < _ts_av_listeners.size(); k++)
+            {
+                if (cls == kVideo)
+                    _ts_av_listeners[k]->ProcessVideoTSPackets(&pkts[i], j - i);
+                else
+                    _ts_av_listeners[k]->ProcessAudioTSPackets(&pkts[i], j - i);
+            }
+            i = j;
+        }
+        pos += i * TSPacket::kSize;
+
+        if (resync)
+        {
+            int remainder;
+            pos = Resync(buffer, pos, len, remainder);
+            if (pos < 0)
+                return remainder;
+        }
     }
 
-    return pos;
+    return len - pos;
+}
+
+/** \fn MPEGStreamData::ResyncStream(const unsigned char*,int,int)
+ *  \brief Returns the offset of the next packet start at or after
+ *         curr_pos, -1 if more bytes are needed and -2 if none was found.
+ *  \sa TSSyncScanner
+ */
+int MPEGStreamData::ResyncStream(const unsigned char *buffer, int curr_pos,
+                                 int len)
+{
+    return TSSyncScanner::Find(buffer, curr_pos, len);
+}
+
+void MPEGStreamData::ClearPIDFlags(uint flag)
+{
+    for (uint pid = 0; pid <= 0x1fff; ++pid)
+        _pid_flags[pid] &= ~flag;
+    _pid_flags_gen++;
 }
 
 bool MPEGStreamData::IsListeningPID(uint pid) const
 {
-    if (_listening_disabled || IsNotListeningPID(pid))
+    if (_listening_disabled)
         return false;
-    pid_map_t::const_iterator it = _pids_listening.find(pid);
-    return it != _pids_listening.end();
+    return (GetPIDFlags(pid) & (kPIDListening | kPIDNotListening)) ==
+        kPIDListening;
 }
 
 bool MPEGStreamData::IsNotListeningPID(uint pid) const
 {
-    pid_map_t::const_iterator it = _pids_notlistening.find(pid);
-    return it != _pids_notlistening.end();
+    return GetPIDFlags(pid) & kPIDNotListening;
 }
 
 bool MPEGStreamData::IsWritingPID(uint pid) const
 {
-    pid_map_t::const_iterator it = _pids_writing.find(pid);
-    return it != _pids_writing.end();
+    return GetPIDFlags(pid) & kPIDWriting;
 }
 
 bool MPEGStreamData::IsAudioPID(uint pid) const
 {
-    pid_map_t::const_iterator it = _pids_audio.find(pid);
-    return it != _pids_audio.end();
+    return GetPIDFlags(pid) & kPIDAudio;
 }
 
 uint MPEGStreamData::GetPIDs(pid_map_t &pids) const
@@ -1750,6 +1870,7 @@ void MPEGStreamData::AddEncryptionTestPID(uint pnum, uint pid, bool isvideo)
     AddListeningPID(pid);
 
     _encryption_pid_to_info[pid] = CryptInfo((isvideo) ? 10000 : 500, 8);
+    SetPIDFlag(pid, kPIDEncryptionTest);
 
     _encryption_pid_to_pnums[pid].push_back(pnum);
     _encryption_pnum_to_pids[pnum].push_back(pid);
@@ -1793,6 +1914,7 @@ void MPEGStreamData::RemoveEncryptionTestPIDs(uint pnum)
             {
                 _encryption_pid_to_pnums.remove(pid);
                 _encryption_pid_to_info.remove(pid);
+                ClearPIDFlag(pid, kPIDEncryptionTest);
             }
         }
     }
@@ -1843,6 +1965,7 @@ void MPEGStreamData::ResetDecryptionMonitoringState(void)
     _encryption_pid_to_info.clear();
     _encryption_pid_to_pnums.clear();
     _encryption_pnum_to_pids.clear();
+    ClearPIDFlags(kPIDEncryptionTest);
 }
 
 bool MPEGStreamData::IsProgramDecrypted(uint pnum) const
@@ -123,24 +123,38 @@ class MTV_PUBLIC MPEGStreamData : public EITSource
     virtual int  ProcessData(const unsigned char *buffer, int len);
     inline  void HandleAdaptationFieldControl(const TSPacket* tspacket);
 
+    /// \brief Enables classifying a whole buffer in ProcessData before
+    ///        handing runs of A/V packets to the listeners.
+    void SetBatchProcessing(bool batch) { _batch_processing = batch; }
+    bool IsBatchProcessing(void) const  { return _batch_processing;  }
+
     // Listening
     virtual void AddListeningPID(
         uint pid, PIDPriority priority = kPIDPriorityNormal)
-        { _pids_listening[pid] = priority; }
+        { _pids_listening[pid] = priority; SetPIDFlag(pid, kPIDListening); }
     virtual void AddNotListeningPID(uint pid)
-        { _pids_notlistening[pid] = kPIDPriorityNormal; }
+    {
+        _pids_notlistening[pid] = kPIDPriorityNormal;
+        SetPIDFlag(pid, kPIDNotListening);
+    }
     virtual void AddWritingPID(
         uint pid, PIDPriority priority = kPIDPriorityHigh)
-        { _pids_writing[pid] = priority; }
+        { _pids_writing[pid] = priority; SetPIDFlag(pid, kPIDWriting); }
     virtual void AddAudioPID(
         uint pid, PIDPriority priority = kPIDPriorityHigh)
-        { _pids_audio[pid] = priority; }
+        { _pids_audio[pid] = priority; SetPIDFlag(pid, kPIDAudio); }
 
-    virtual void RemoveListeningPID(uint pid) { _pids_listening.remove(pid);  }
+    virtual void RemoveListeningPID(uint pid)
+        { _pids_listening.remove(pid); ClearPIDFlag(pid, kPIDListening); }
     virtual void RemoveNotListeningPID(uint pid)
-        { _pids_notlistening.remove(pid); }
-    virtual void RemoveWritingPID(uint pid) { _pids_writing.remove(pid);    }
-    virtual void RemoveAudioPID(uint pid)   { _pids_audio.remove(pid);      }
+    {
+        _pids_notlistening.remove(pid);
+        ClearPIDFlag(pid, kPIDNotListening);
+    }
+    virtual void RemoveWritingPID(uint pid)
+        { _pids_writing.remove(pid); ClearPIDFlag(pid, kPIDWriting); }
+    virtual void RemoveAudioPID(uint pid)
+        { _pids_audio.remove(pid); ClearPIDFlag(pid, kPIDAudio); }
 
     virtual bool IsListeningPID(uint pid) const;
     virtual bool IsNotListeningPID(uint pid) const;
@@ -302,6 +316,34 @@ class MTV_PUBLIC MPEGStreamData : public EITSource
     void ProcessEncryptedPacket(const TSPacket&);
 
     static int ResyncStream(const unsigned char *buffer, int curr_pos, int len);
+    static bool LostSyncAfter(const unsigned char *buffer, int pos, int len);
+    int Resync(const unsigned char *buffer, int pos, int len, int &remainder);
+    int ProcessDataBatch(const unsigned char *buffer, int len);
+
+    // PID classification table, kept in sync with the pid maps
+    void SetPIDFlag(uint pid, uint flag)
+    {
+        if (pid <= 0x1fff)
+            _pid_flags[pid] |= flag;
+        _pid_flags_gen++;
+    }
+    void ClearPIDFlag(uint pid, uint flag)
+    {
+        if (pid <= 0x1fff)
+            _pid_flags[pid] &= ~flag;
+        _pid_flags_gen++;
+    }
+    void ClearPIDFlags(uint flag);
+    uint GetPIDFlags(uint pid) const
+        { return (pid <= 0x1fff) ? _pid_flags[pid] : 0; }
+    void ClearListeningPIDs(void)
+        { _pids_listening.clear(); ClearPIDFlags(kPIDListening); }
+    void ClearNotListeningPIDs(void)
+        { _pids_notlistening.clear(); ClearPIDFlags(kPIDNotListening); }
+    void ClearWritingPIDs(void)
+        { _pids_writing.clear(); ClearPIDFlags(kPIDWriting); }
+    void ClearAudioPIDs(void)
+        { _pids_audio.clear(); ClearPIDFlags(kPIDAudio); }
 
     void UpdateTimeOffset(uint64_t si_utc_time);
 
@@ -333,6 +375,17 @@ class MTV_PUBLIC MPEGStreamData : public EITSource
     pid_map_t                 _pids_writing;
     pid_map_t                 _pids_audio;
     bool                      _listening_disabled;
+    bool                      _batch_processing;
+
+    // One byte per PID so ProcessTSPacket avoids the map lookups
+    static const unsigned char kPIDListening      = 0x01;
+    static const unsigned char kPIDNotListening   = 0x02;
+    static const unsigned char kPIDWriting        = 0x04;
+    static const unsigned char kPIDAudio          = 0x08;
+    static const unsigned char kPIDEncryptionTest = 0x10;
+    unsigned char             _pid_flags[0x1fff + 1];
+    uint                      _pid_flags_gen;
+    vector<unsigned char>     _batch_class;
 
     // Encryption monitoring
     mutable QMutex            _encryption_lock;
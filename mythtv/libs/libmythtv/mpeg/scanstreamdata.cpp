@@ -12,7 +12,7 @@ ScanStreamData::ScanStreamData(bool no_default_pid) :
     m_no_default_pid(no_default_pid)
 {
     if (m_no_default_pid)
-        _pids_listening.clear();
+        ClearListeningPIDs();
 }
 
 ScanStreamData::~ScanStreamData() { ; }
@@ -49,7 +49,7 @@ void ScanStreamData::Reset(void)
 
     if (m_no_default_pid)
     {
-        _pids_listening.clear();
+        ClearListeningPIDs();
         return;
     }
 
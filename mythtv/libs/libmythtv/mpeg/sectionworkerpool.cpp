@@ -0,0 +1,191 @@
+// -*- Mode: c++ -*-
+
+#include <algorithm>
+#include <cstring>
+
+#include "sectionworkerpool.h"
+#include "mpegtables.h"
+#include "mythlogging.h"
+
+#define LOC QString("SectionWorkers[%1]: ").arg(m_name)
+
+const uint SectionWorkerPool::kDefaultWorkers;
+const uint SectionWorkerPool::kDefaultMaxPerTable;
+const uint SectionWorkerPool::kMaxQueued;
+
+void SectionWorker::run(void)
+{
+    RunProlog();
+    m_pool->Work(m_id);
+    RunEpilog();
+}
+
+SectionWorkerPool::SectionWorkerPool(
+    SectionHandler *handler, const QString &name,
+    uint workers, uint max_per_table) :
+    m_handler(handler), m_name(name),
+    m_maxPerTable(max_per_table ? max_per_table : kDefaultMaxPerTable),
+    m_queues(max(workers, 1U)), m_total(0), m_dropped(0),
+    m_stop(false)
+{
+    memset(m_queued, 0, sizeof(m_queued));
+
+    for (uint i = 0; i < m_queues.size(); i++)
+    {
+        m_workers.push_back(
+            new SectionWorker(this, i, QString("SI%1-%2").arg(name).arg(i)));
+        m_workers.back()->start();
+    }
+}
+
+SectionWorkerPool::~SectionWorkerPool()
+{
+    m_lock.lock();
+    m_stop = true;
+    m_wake.wakeAll();
+    m_lock.unlock();
+
+    for (uint i = 0; i < m_workers.size(); i++)
+        delete m_workers[i];
+    m_workers.clear();
+
+    Clear();
+
+    if (m_dropped)
+    {
+        LOG(VB_EIT, LOG_INFO, LOC +
+            QString("Dropped %1 sections while busy").arg(m_dropped));
+    }
+}
+
+/** \brief Identifies one section of one version of a table.
+ *
+ *  pid:13, table_id:8, table_id_extension:16, version:5, section:8
+ */
+uint64_t SectionWorkerPool::MakeKey(uint pid, const PSIPTable &psip)
+{
+    return ((uint64_t) (pid & 0x1fff)          << 40) |
+           ((uint64_t) (psip.TableID() & 0xff) << 32) |
+           ((uint64_t) psip.TableIDExtension() << 16) |
+           ((uint64_t) psip.Version()          <<  8) |
+           ((uint64_t) psip.Section());
+}
+
+/** \brief Queues a copy of psip for a worker.
+ *
+ *  \return false if psip was dropped because its table id has too
+ *          many sections queued already or the pool is full
+ */
+bool SectionWorkerPool::Enqueue(uint pid, const PSIPTable &psip)
+{
+    uint64_t key = MakeKey(pid, psip);
+    uint table_id = psip.TableID() & 0xff;
+
+    QMutexLocker locker(&m_lock);
+
+    if (m_pending.contains(key))
+        return true;
+
+    if (m_stop || m_queued[table_id] >= m_maxPerTable ||
+        m_total >= kMaxQueued)
+    {
+        if ((++m_dropped % 1000) == 1)
+        {
+            LOG(VB_EIT, LOG_INFO, LOC +
+                QString("Queue full for table 0x%1, %2 sections queued, "
+                        "%3 dropped")
+                    .arg(table_id, 2, 16, QChar('0')).arg(m_total)
+                    .arg(m_dropped));
+        }
+        return false;
+    }
+
+    // keep each table on one worker so its sections stay in order
+    uint worker = (table_id * 31 + psip.TableIDExtension()) % m_queues.size();
+    Item item = { pid, key, new PSIPTable(psip) };
+    m_queues[worker].push_back(item);
+    m_pending.insert(key);
+    m_queued[table_id]++;
+    m_total++;
+
+    m_wake.wakeAll();
+
+    return true;
+}
+
+/// Drops the sections that are waiting, ones being handled are finished
+void SectionWorkerPool::Clear(void)
+{
+    QMutexLocker locker(&m_lock);
+    for (uint i = 0; i < m_queues.size(); i++)
+    {
+        while (!m_queues[i].empty())
+        {
+            Item &item = m_queues[i].front();
+            m_pending.remove(item.key);
+            m_queued[(item.key >> 32) & 0xff]--;
+            m_total--;
+            delete item.psip;
+            m_queues[i].pop_front();
+        }
+    }
+    m_idle.wakeAll();
+}
+
+/// Waits until every queued section has been handled
+bool SectionWorkerPool::WaitForIdle(unsigned long timeout_ms)
+{
+    QMutexLocker locker(&m_lock);
+    while (m_total)
+    {
+        if (!m_idle.wait(&m_lock, timeout_ms))
+            return false;
+    }
+    return true;
+}
+
+uint SectionWorkerPool::GetQueued(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_total;
+}
+
+uint SectionWorkerPool::GetQueued(uint table_id) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_queued[table_id & 0xff];
+}
+
+uint64_t SectionWorkerPool::GetDropped(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_dropped;
+}
+
+void SectionWorkerPool::Work(uint id)
+{
+    QMutexLocker locker(&m_lock);
+    while (!m_stop)
+    {
+        if (m_queues[id].empty())
+        {
+            m_wake.wait(&m_lock);
+            continue;
+        }
+
+        Item item = m_queues[id].front();
+        m_queues[id].pop_front();
+
+        locker.unlock();
+        m_handler->HandleQueuedTable(item.pid, *item.psip);
+        delete item.psip;
+        locker.relock();
+
+        // still counted while it was being handled, so a repeat of
+        // it is not queued behind it
+        m_pending.remove(item.key);
+        m_queued[(item.key >> 32) & 0xff]--;
+        m_total--;
+        m_idle.wakeAll();
+    }
+}
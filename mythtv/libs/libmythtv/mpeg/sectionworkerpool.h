@@ -0,0 +1,110 @@
+// -*- Mode: c++ -*-
+#ifndef _SECTION_WORKER_POOL_H_
+#define _SECTION_WORKER_POOL_H_
+
+#include <stdint.h>
+#include <climits>
+
+#include <deque>
+#include <vector>
+using namespace std;
+
+#include <QWaitCondition>
+#include <QMutex>
+#include <QString>
+#include <QSet>
+
+#include "mythtvexp.h"
+#include "mthread.h"
+
+class PSIPTable;
+class SectionWorkerPool;
+
+/// Gets the sections queued on a SectionWorkerPool, on a worker thread
+class SectionHandler
+{
+  public:
+    virtual void HandleQueuedTable(uint pid, const PSIPTable &psip) = 0;
+
+  protected:
+    virtual ~SectionHandler() {}
+};
+
+class SectionWorker : public MThread
+{
+  public:
+    SectionWorker(SectionWorkerPool *pool, uint id, const QString &name) :
+        MThread(name), m_pool(pool), m_id(id) {}
+    virtual ~SectionWorker() { wait(); }
+    virtual void run(void);
+  private:
+    SectionWorkerPool *m_pool;
+    uint               m_id;
+};
+
+/** \class SectionWorkerPool
+ *  \brief Moves the parsing of SI tables the recorder does not need
+ *         right away, like EIT, off the thread reading the stream.
+ *
+ *  Enqueue() copies the section and returns at once. All sections of
+ *  one table id and extension go to the same worker, so they are
+ *  handled in the order they arrived, different tables are spread
+ *  over the workers.
+ *
+ *  No table id may have more than the per table limit queued, and
+ *  the queue as a whole is bounded too. Enqueue() refuses a section
+ *  rather than wait, so a flood of EIT schedule sections can neither
+ *  stall the stream nor crowd out present/following EIT or the SDT.
+ *  A section already queued is not queued again.
+ */
+class MTV_PUBLIC SectionWorkerPool
+{
+    friend class SectionWorker;
+
+  public:
+    SectionWorkerPool(SectionHandler *handler, const QString &name,
+                      uint workers = kDefaultWorkers,
+                      uint max_per_table = kDefaultMaxPerTable);
+   ~SectionWorkerPool();
+
+    bool Enqueue(uint pid, const PSIPTable &psip);
+    void Clear(void);
+    bool WaitForIdle(unsigned long timeout_ms = ULONG_MAX);
+
+    uint GetQueued(void) const;
+    uint GetQueued(uint table_id) const;
+    uint64_t GetDropped(void) const;
+
+    static const uint kDefaultWorkers     = 2;
+    static const uint kDefaultMaxPerTable = 128;
+    static const uint kMaxQueued          = 1024;
+
+  private:
+    typedef struct
+    {
+        uint       pid;
+        uint64_t   key;
+        PSIPTable *psip;
+    } Item;
+
+    static uint64_t MakeKey(uint pid, const PSIPTable &psip);
+    void Work(uint id);
+
+    SectionHandler         *m_handler;
+    QString                 m_name;
+    uint                    m_maxPerTable;
+
+    mutable QMutex          m_lock;
+    QWaitCondition          m_wake;    ///< work queued or stopping
+    QWaitCondition          m_idle;    ///< a section has been handled
+    vector<deque<Item> >    m_queues;  ///< one per worker
+    QSet<uint64_t>          m_pending;
+    uint                    m_queued[256];
+    uint                    m_total;
+    uint64_t                m_dropped;
+    bool                    m_stop;
+
+    vector<SectionWorker*>  m_workers;
+};
+
+#endif // _SECTION_WORKER_POOL_H_
@@ -74,6 +74,21 @@ class TSPacketListenerAV
     virtual bool ProcessVideoTSPacket(const TSPacket& tspacket) = 0;
     virtual bool ProcessAudioTSPacket(const TSPacket& tspacket) = 0;
 
+    /// Called with a run of consecutive packets on the video PID when
+    /// MPEGStreamData is in batch mode. Override to avoid a virtual call
+    /// per packet.
+    virtual void ProcessVideoTSPackets(const TSPacket *tspackets, uint count)
+    {
+        for (uint i = 0; i < count; ++i)
+            ProcessVideoTSPacket(tspackets[i]);
+    }
+    /// Called with a run of consecutive audio packets in batch mode.
+    virtual void ProcessAudioTSPackets(const TSPacket *tspackets, uint count)
+    {
+        for (uint i = 0; i < count; ++i)
+            ProcessAudioTSPacket(tspackets[i]);
+    }
+
   protected:
     virtual ~TSPacketListenerAV() { }
 };
@@ -0,0 +1,210 @@
+// -*- Mode: c++ -*-
+
+// C headers
+#include <cstring>
+
+// MythTV headers
+#include "mythconfig.h"
+#include "tssync.h"
+#include "tspacket.h"
+
+extern "C" {
+#include "libavutil/cpu.h"
+}
+
+// The vector versions are built with per function target attributes,
+// so the rest of libmythtv keeps its baseline instruction set.
+#if ARCH_X86 && (defined(__clang__) || \
+    (defined(__GNUC__) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define TSSYNC_X86 1
+#include <immintrin.h>
+#else
+#define TSSYNC_X86 0
+#endif
+
+const int TSSyncScanner::kDepth;
+
+TSSyncScanner::FindFunc TSSyncScanner::s_find = TSSyncScanner::Dispatch;
+
+static const int kPacket = TSPacket::kSize;
+/// Distance from a candidate to the last packet start checked
+static const int kSpan   = (TSSyncScanner::kDepth - 1) * TSPacket::kSize;
+
+/** \brief Checks the packet starts following pos.
+ *
+ *  The caller has already matched buffer[pos] and made sure that at
+ *  least the next packet start lies inside the buffer.
+ */
+static inline bool confirm_sync(const unsigned char *buffer, int pos, int len)
+{
+    for (int i = 1; i < TSSyncScanner::kDepth; ++i)
+    {
+        pos += kPacket;
+        if (pos >= len)
+            return true; // as far as the buffer reaches
+        if (buffer[pos] != SYNC_BYTE)
+            return false;
+    }
+    return true;
+}
+
+/// Byte wise search of the candidates in [pos, len - 188)
+static int scan_scalar(const unsigned char *buffer, int pos, int len)
+{
+    const int end = len - kPacket;
+    while (pos < end)
+    {
+        const unsigned char *p = (const unsigned char*)
+            memchr(buffer + pos, SYNC_BYTE, end - pos);
+        if (!p)
+            break;
+        pos = p - buffer;
+        if (confirm_sync(buffer, pos, len))
+            return pos;
+        ++pos;
+    }
+    return -2;
+}
+
+static int find_scalar(const unsigned char *buffer, int pos, int len)
+{
+    if (pos + kPacket >= len)
+        return -1; // not enough bytes; caller should try again
+    return scan_scalar(buffer, pos, len);
+}
+
+#if TSSYNC_X86
+__attribute__((target("sse2")))
+static int find_sse2(const unsigned char *buffer, int pos, int len)
+{
+    if (pos + kPacket >= len)
+        return -1;
+
+    const __m128i sync = _mm_set1_epi8(SYNC_BYTE);
+
+    // Every lane of a block has all kDepth packet starts in the buffer,
+    // the rest is left to the scalar search.
+    while (pos + kSpan + 16 <= len)
+    {
+        const unsigned char *p = buffer + pos;
+        __m128i match = _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)p), sync);
+        for (int i = 1; i < TSSyncScanner::kDepth; ++i)
+        {
+            p += kPacket;
+            match = _mm_and_si128(match, _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i*)p), sync));
+        }
+        uint mask = _mm_movemask_epi8(match);
+        if (mask)
+            return pos + __builtin_ctz(mask);
+        pos += 16;
+    }
+
+    return scan_scalar(buffer, pos, len);
+}
+
+__attribute__((target("avx2")))
+static int find_avx2(const unsigned char *buffer, int pos, int len)
+{
+    if (pos + kPacket >= len)
+        return -1;
+
+    const __m256i sync = _mm256_set1_epi8(SYNC_BYTE);
+
+    while (pos + kSpan + 32 <= len)
+    {
+        const unsigned char *p = buffer + pos;
+        __m256i match = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)p), sync);
+        for (int i = 1; i < TSSyncScanner::kDepth; ++i)
+        {
+            p += kPacket;
+            match = _mm256_and_si256(match, _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i*)p), sync));
+        }
+        uint mask = _mm256_movemask_epi8(match);
+        if (mask)
+            return pos + __builtin_ctz(mask);
+        pos += 32;
+    }
+
+    return scan_scalar(buffer, pos, len);
+}
+#endif // TSSYNC_X86
+
+/** \fn TSSyncScanner::Find(Implementation,const unsigned char*,int,int)
+ *  \brief Like Find(), but with a specific implementation.
+ *
+ *  Mostly useful for testing, an implementation that is not available
+ *  on this CPU falls back to the scalar one.
+ */
+int TSSyncScanner::Find(Implementation impl, const unsigned char *buffer,
+                        int pos, int len)
+{
+    return GetFunc(impl)(buffer, pos, len);
+}
+
+bool TSSyncScanner::IsAvailable(Implementation impl)
+{
+    switch (impl)
+    {
+        case kAuto:
+        case kScalar:
+            return true;
+#if TSSYNC_X86
+        case kSSE2:
+            return av_get_cpu_flags() & AV_CPU_FLAG_SSE2;
+        case kAVX2:
+            return av_get_cpu_flags() & AV_CPU_FLAG_AVX2;
+#endif
+        default:
+            return false;
+    }
+}
+
+TSSyncScanner::Implementation TSSyncScanner::GetBest(void)
+{
+    if (IsAvailable(kAVX2))
+        return kAVX2;
+    if (IsAvailable(kSSE2))
+        return kSSE2;
+    return kScalar;
+}
+
+QString TSSyncScanner::toString(Implementation impl)
+{
+    switch (impl)
+    {
+        case kAuto:   return "auto";
+        case kScalar: return "scalar";
+        case kSSE2:   return "sse2";
+        case kAVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+TSSyncScanner::FindFunc TSSyncScanner::GetFunc(Implementation impl)
+{
+    if (impl == kAuto)
+        impl = GetBest();
+    if (!IsAvailable(impl))
+        return find_scalar;
+
+    switch (impl)
+    {
+#if TSSYNC_X86
+        case kSSE2: return find_sse2;
+        case kAVX2: return find_avx2;
+#endif
+        default:    return find_scalar;
+    }
+}
+
+/// Resolves s_find on first use, av_get_cpu_flags() is not free
+int TSSyncScanner::Dispatch(const unsigned char *buffer, int pos, int len)
+{
+    s_find = GetFunc(kAuto);
+    return s_find(buffer, pos, len);
+}
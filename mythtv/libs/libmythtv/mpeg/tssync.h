@@ -0,0 +1,57 @@
+// -*- Mode: c++ -*-
+#ifndef _TS_SYNC_H_
+#define _TS_SYNC_H_
+
+#include <QString>
+
+#include "mythtvexp.h"
+
+/** \class TSSyncScanner
+ *  \brief Finds the start of the next transport stream packet in a
+ *         buffer that has lost sync.
+ *
+ *  A position is accepted when it holds a SYNC_BYTE and so do the
+ *  following kDepth-1 packet starts 188 bytes apart, as far as the
+ *  buffer reaches, with at least one confirming sync byte required.
+ *  The candidate bytes are compared a whole vector at a time with
+ *  SSE2 or AVX2 when the CPU has them, so a burst of garbage costs
+ *  a few instructions per 16 or 32 bytes rather than a loop
+ *  iteration per byte.
+ *
+ *  Find() returns the offset of the packet, -1 if there are not
+ *  enough bytes left to tell, and -2 if no packet start was found.
+ */
+class MTV_PUBLIC TSSyncScanner
+{
+  public:
+    typedef enum
+    {
+        kAuto = 0,
+        kScalar,
+        kSSE2,
+        kAVX2,
+    } Implementation;
+
+    static int Find(const unsigned char *buffer, int pos, int len)
+    {
+        return s_find(buffer, pos, len);
+    }
+    static int Find(Implementation impl, const unsigned char *buffer,
+                    int pos, int len);
+
+    static bool IsAvailable(Implementation impl);
+    static Implementation GetBest(void);
+    static QString toString(Implementation impl);
+
+    /// Number of packet starts that must agree, including the first
+    static const int kDepth = 3;
+
+  private:
+    typedef int (*FindFunc)(const unsigned char*, int, int);
+    static FindFunc GetFunc(Implementation impl);
+    static int Dispatch(const unsigned char *buffer, int pos, int len);
+
+    static FindFunc s_find;
+};
+
+#endif // _TS_SYNC_H_
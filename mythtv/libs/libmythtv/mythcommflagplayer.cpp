@@ -2,9 +2,13 @@
 #include "mythcommflagplayer.h"
 
 #include <QRunnable>
+#include <QFile>
 
 #include "mthreadpool.h"
 #include "mythlogging.h"
+#include "ringbuffer.h"
+#include "seekindex.h"
+#include "seektablebuilder.h"
 
 #include <unistd.h> // for usleep()
 #include <iostream> // for cout()
@@ -62,8 +66,114 @@ QMutex                  RebuildSaver::s_lock;
 QWaitCondition          RebuildSaver::s_wait;
 QMap<DecoderBase*,uint> RebuildSaver::s_cnt;
 
-bool MythCommFlagPlayer::RebuildSeekTable(
+typedef struct
+{
+    PlayerContext  *ctx;
+    MythTimer       inuse_timer;
+    bool            showPercentage;
+    StatusCallback  cb;
+    void           *cbData;
+} ParseProgress;
+
+static void parse_progress(int percentage, void *data)
+{
+    ParseProgress *p = (ParseProgress*) data;
+
+    if (p->inuse_timer.elapsed() > 2534)
+    {
+        p->inuse_timer.restart();
+        p->ctx->LockPlayingInfo(__FILE__, __LINE__);
+        if (p->ctx->playingInfo)
+            p->ctx->playingInfo->UpdateInUseMark();
+        p->ctx->UnlockPlayingInfo(__FILE__, __LINE__);
+    }
+
+    if (p->cb)
+        (*p->cb)(percentage, p->cbData);
+
+    if (p->showPercentage)
+    {
+        QString str = QString("\r%1%  \r").arg(percentage,3);
+        cout << qPrintable(str) << flush;
+    }
+    else if (percentage % 10 == 0)
+    {
+        LOG(VB_GENERAL, LOG_INFO, QString("Progress %1%").arg(percentage,3));
+    }
+}
+
+/** \brief Builds the seek table by parsing the MPEG-2 or H.264
+ *         stream with a SeekTableBuilder, without decoding it.
+ *
+ *  This reads the file once at the speed of the disk and saves the
+ *  whole table in one transaction at the end.
+ *  \return false if the file can't be parsed or the table can't be
+ *          saved, nothing is saved then
+ */
+bool MythCommFlagPlayer::ParseSeekTable(
     bool showPercentage, StatusCallback cb, void* cbData)
+{
+    if (!player_ctx->buffer)
+        return false;
+
+    ParseProgress progress;
+    progress.ctx            = player_ctx;
+    progress.showPercentage = showPercentage;
+    progress.cb             = cb;
+    progress.cbData         = cbData;
+    progress.inuse_timer.start();
+
+    MythTimer flagTime;
+    flagTime.start();
+
+    SeekTableBuilder builder;
+    bool ok = builder.Scan(player_ctx->buffer, parse_progress, &progress);
+    player_ctx->buffer->Seek(0, SEEK_SET);
+
+    if (showPercentage)
+        cout << "\r                         \r" << flush;
+
+    if (!ok)
+        return false;
+
+    frm_pos_map_t posMap = builder.GetPositionMap();
+    frm_pos_map_t durMap = builder.GetDurationMap();
+
+    bool saved = false;
+    player_ctx->LockPlayingInfo(__FILE__, __LINE__);
+    if (player_ctx->playingInfo &&
+        player_ctx->playingInfo->SaveSeekTable(posMap, durMap))
+    {
+        player_ctx->playingInfo->SaveTotalFrames(builder.GetTotalFrames());
+        player_ctx->playingInfo->SaveTotalDuration(
+            builder.GetTotalDuration() * 1000);
+        saved = true;
+    }
+    player_ctx->UnlockPlayingInfo(__FILE__, __LINE__);
+
+    if (!saved)
+    {
+        LOG(VB_GENERAL, LOG_ERR,
+            "Could not save the parsed seek table, decoding instead");
+        return false;
+    }
+
+    LOG(VB_GENERAL, LOG_INFO,
+        QString("Parsed %1 frames, %2 keyframes, in %3 seconds")
+            .arg(builder.GetTotalFrames()).arg(posMap.size())
+            .arg(flagTime.elapsed() * 0.001f, 0, 'f', 1));
+
+    return true;
+}
+
+/** \brief Rebuilds the seek table of the recording.
+ *
+ *  MPEG-2 and H.264 transport and program streams are parsed by
+ *  ParseSeekTable(), anything else, or everything if decodeAll is
+ *  set, is run through the decoder.
+ */
+bool MythCommFlagPlayer::RebuildSeekTable(
+    bool showPercentage, StatusCallback cb, void* cbData, bool decodeAll)
 {
     int percentage = 0;
     uint64_t myFramesPlayed = 0, pmap_first = 0,  pmap_last  = 0;
@@ -71,6 +181,17 @@ bool MythCommFlagPlayer::RebuildSeekTable(
     killdecoder = false;
     framesPlayed = 0;
 
+    // a seek index left next to the file is from before the rebuild
+    if (player_ctx->buffer)
+    {
+        QString filename = player_ctx->buffer->GetFilename();
+        if (filename.startsWith('/'))
+            QFile::remove(SeekIndex::GetFilename(filename));
+    }
+
+    if (!decodeAll && ParseSeekTable(showPercentage, cb, cbData))
+        return true;
+
     // clear out any existing seektables
     player_ctx->LockPlayingInfo(__FILE__, __LINE__);
     if (player_ctx->playingInfo)
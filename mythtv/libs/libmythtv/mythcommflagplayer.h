@@ -9,7 +9,11 @@ class MTV_PUBLIC MythCommFlagPlayer : public MythPlayer
     MythCommFlagPlayer(PlayerFlags flags = kNoFlags) : MythPlayer(flags) { }
     MythCommFlagPlayer(MythCommFlagPlayer& rhs);
     bool RebuildSeekTable(bool showPercentage = true, StatusCallback cb = NULL,
-                          void* cbData = NULL);
+                          void* cbData = NULL, bool decodeAll = false);
+
+  private:
+    bool ParseSeekTable(bool showPercentage, StatusCallback cb,
+                        void* cbData);
 };
 
 #endif // MYTHCOMMFLAGPLAYER_H
@@ -383,9 +383,8 @@ int NuppelDecoder::OpenFile(RingBuffer *rbuffer, bool novideo,
                                      ste.file_offset};
                     m_positionMap.push_back(e);
                     uint64_t frame_num = ste.keyframe_number * keyframedist;
-                    m_frameToDurMap[frame_num] =
-                        frame_num * 1000 / video_frame_rate;
-                    m_durToFrameMap[m_frameToDurMap[frame_num]] = frame_num;
+                    m_durationMap.Insert(
+                        frame_num, frame_num * 1000 / video_frame_rate);
                 }
                 hasFullPositionMap = true;
                 totalLength = (int)((ste.keyframe_number * keyframedist * 1.0) /
@@ -1156,9 +1155,8 @@ bool NuppelDecoder::GetFrame(DecodeType decodetype)
                     {
                         PosMapEntry e = {this_index, lastKey, currentposition};
                         m_positionMap.push_back(e);
-                        m_frameToDurMap[lastKey] =
-                            lastKey * 1000 / video_frame_rate;
-                        m_durToFrameMap[m_frameToDurMap[lastKey]] = lastKey;
+                        m_durationMap.Insert(
+                            lastKey, lastKey * 1000 / video_frame_rate);
                     }
                 }
             }
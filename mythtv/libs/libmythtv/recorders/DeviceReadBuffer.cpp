@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <chrono>
 using namespace std;
 
 #include "DeviceReadBuffer.h"
@@ -12,12 +13,91 @@ using namespace std;
 #ifndef _WIN32
 #include <sys/poll.h>
 #endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 /// Set this to 1 to report on statistics
 #define REPORT_RING_STATS 0
 
 #define LOC QString("DevRdB(%1): ").arg(videodevice)
 
+/// Monotonic microseconds, only meaningful as a difference
+static inline uint now_us(void)
+{
+    return static_cast<uint>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// Opens the eventfd, or pipe where eventfd is unavailable, in fd
+static void open_wake_fd(int fd[2], long flags[2])
+{
+#ifdef __linux__
+    (void) flags;
+    fd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd[0] < 0)
+        LOG(VB_GENERAL, LOG_WARNING, "DevRdB: eventfd() failed" + ENO);
+#else
+    setup_pipe(fd, flags);
+#endif
+}
+
+/// Queues a wakeup on an fd opened by open_wake_fd()
+static void signal_wake_fd(const int fd[2])
+{
+#ifdef __linux__
+    if (fd[0] >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t wret = ::write(fd[0], &one, sizeof(one));
+        (void) wret; // EAGAIN means a wakeup is already queued
+    }
+#else
+    if (fd[1] >= 0)
+    {
+        char buf[1] = { '0' };
+        ssize_t wret = ::write(fd[1], buf, 1);
+        (void) wret;
+    }
+#endif
+}
+
+/// Waits up to max_wait ms for signal_wake_fd(), true if it was signalled
+static bool wait_wake_fd(const int fd[2], const long flags[2], uint max_wait)
+{
+#ifdef _WIN32
+    (void) fd;
+    (void) flags;
+    usleep(max_wait * 1000);
+    return false;
+#else
+    if (fd[0] < 0)
+    {
+        usleep(max_wait * 1000);
+        return false;
+    }
+
+    struct pollfd pfd;
+    pfd.fd      = fd[0];
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, max_wait) <= 0 || !(pfd.revents & POLLIN))
+        return false;
+
+    char dummy[128];
+#ifdef __linux__
+    (void) flags;
+    ssize_t rret = ::read(fd[0], dummy, sizeof(uint64_t));
+#else
+    int cnt = (flags[0] & O_NONBLOCK) ? 128 : 1;
+    ssize_t rret = ::read(fd[0], dummy, cnt);
+#endif
+    (void) rret;
+    return true;
+#endif // !_WIN32
+}
+
 DeviceReadBuffer::DeviceReadBuffer(
     DeviceReaderCB *cb, bool use_poll, bool error_exit_on_poll_timeout)
     : MThread("DeviceReadBuffer"),
@@ -38,17 +118,27 @@ DeviceReadBuffer::DeviceReadBuffer(
 
       buffer(NULL),                 readPtr(NULL),
       writePtr(NULL),               endPtr(NULL),
+      dropBuffer(NULL),
+
+      spsc(false),
 
       // statistics
+      report_stats(REPORT_RING_STATS),
       max_used(0),                  avg_used(0),
       avg_buf_write_cnt(0),         avg_buf_read_cnt(0),
-      avg_buf_sleep_cnt(0)
+      avg_buf_sleep_cnt(0),
+      drop_cnt(0),                  drop_bytes(0),
+      total_dropped(0),             dropping(false)
 {
     for (int i = 0; i < 2; i++)
     {
         wake_pipe[i] = -1;
         wake_pipe_flags[i] = 0;
+        data_wake_fd[i] = -1;
+        data_wake_flags[i] = 0;
     }
+    memset(fill_hist, 0, sizeof(fill_hist));
+    memset(wake_hist, 0, sizeof(wake_hist));
 
 #ifdef USING_MINGW
 #warning mingw DeviceReadBuffer::Poll
@@ -69,6 +159,14 @@ DeviceReadBuffer::~DeviceReadBuffer()
         delete[] buffer;
         buffer = NULL;
     }
+    delete[] dropBuffer;
+    dropBuffer = NULL;
+    for (uint i = 0; i < 2; i++)
+    {
+        if (data_wake_fd[i] >= 0)
+            ::close(data_wake_fd[i]);
+        data_wake_fd[i] = -1;
+    }
 }
 
 bool DeviceReadBuffer::Setup(const QString &streamName, int streamfd,
@@ -79,6 +177,7 @@ bool DeviceReadBuffer::Setup(const QString &streamName, int streamfd,
 
     if (buffer)
         delete[] buffer;
+    delete[] dropBuffer;
 
     videodevice   = streamName;
     videodevice   = (videodevice == QString::null) ? "" : videodevice;
@@ -104,9 +203,17 @@ bool DeviceReadBuffer::Setup(const QString &streamName, int streamfd,
     readPtr       = buffer;
     writePtr      = buffer;
     endPtr        = buffer + size;
+    dropBuffer    = new (nothrow) unsigned char[dev_read_size];
+
+    spsc          = gCoreContext->GetNumSetting("HDRingbufferLockFree", 0);
+    spsc_head.fetchAndStoreOrdered(0);
+    spsc_tail.fetchAndStoreOrdered(0);
+    spsc_waiting.fetchAndStoreOrdered(0);
+    if (spsc && data_wake_fd[0] < 0)
+        open_wake_fd(data_wake_fd, data_wake_flags);
 
     // Initialize buffer, if it exists
-    if (!buffer)
+    if (!buffer || !dropBuffer)
     {
         LOG(VB_GENERAL, LOG_ERR, LOC +
             QString("Failed to allocate buffer of size %1 = %2 + %3")
@@ -116,14 +223,23 @@ bool DeviceReadBuffer::Setup(const QString &streamName, int streamfd,
     memset(buffer, 0xFF, size + read_quanta);
 
     // Initialize statistics
+    report_stats  = REPORT_RING_STATS ||
+        VERBOSE_LEVEL_CHECK(VB_RECORD, LOG_DEBUG);
     max_used      = 0;
     avg_used      = 0;
     avg_buf_write_cnt = 0;
     avg_buf_read_cnt  = 0;
     avg_buf_sleep_cnt = 0;
+    drop_cnt      = 0;
+    drop_bytes    = 0;
+    total_dropped = 0;
+    dropping      = false;
+    memset(fill_hist, 0, sizeof(fill_hist));
+    memset(wake_hist, 0, sizeof(wake_hist));
     lastReport.start();
 
-    LOG(VB_RECORD, LOG_INFO, LOC + QString("buffer size %1 KB").arg(size/1024));
+    LOG(VB_RECORD, LOG_INFO, LOC + QString("buffer size %1 KB%2")
+        .arg(size/1024).arg(spsc ? ", lock-free" : ""));
 
     return true;
 }
@@ -164,9 +280,35 @@ void DeviceReadBuffer::Reset(const QString &streamName, int streamfd)
     videodevice   = (videodevice == QString::null) ? "" : videodevice;
     _stream_fd    = streamfd;
 
-    used          = 0;
-    readPtr       = buffer;
-    writePtr      = buffer;
+    if (spsc)
+    {
+        // The write position belongs to the device thread, when called
+        // from any other thread pause it while the ring is emptied.
+        bool pause = isRunning() && !paused && !request_pause &&
+            (QThread::currentThread() != qthread());
+        if (pause)
+        {
+            request_pause = true;
+            WakePoll();
+            while (!paused && isRunning())
+                pauseWait.wait(locker.mutex(), 100);
+        }
+
+        // Drop whatever is buffered by catching up with the reader.
+        uint tail = spsc_tail.fetchAndAddAcquire(0);
+        spsc_head.fetchAndStoreOrdered(tail);
+        writePtr  = buffer + (tail % size);
+
+        // HandlePausing() resumes the device thread
+        if (pause)
+            request_pause = false;
+    }
+    else
+    {
+        used      = 0;
+        readPtr   = buffer;
+        writePtr  = buffer;
+    }
 
     error         = false;
 }
@@ -285,45 +427,118 @@ bool DeviceReadBuffer::IsRunning(void) const
 
 uint DeviceReadBuffer::GetUnused(void) const
 {
+    if (spsc)
+        return size - SPSCUsed();
     QMutexLocker locker(&lock);
     return size - used;
 }
 
 uint DeviceReadBuffer::GetUsed(void) const
 {
+    if (spsc)
+        return SPSCUsed();
     QMutexLocker locker(&lock);
     return used;
 }
 
 uint DeviceReadBuffer::GetContiguousUnused(void) const
 {
+    if (spsc)
+        return endPtr - writePtr; // writePtr belongs to the device thread
     QMutexLocker locker(&lock);
     return endPtr - writePtr;
 }
 
 void DeviceReadBuffer::IncrWritePointer(uint len)
 {
+    if (spsc)
+    {
+        uint head = spsc_head.fetchAndAddRelaxed(0);
+        writePtr += len;
+        writePtr  = (writePtr >= endPtr) ?
+            buffer + (writePtr - endPtr) : writePtr;
+        spsc_head.fetchAndStoreOrdered((head + len) % (2 * size));
+        if (report_stats)
+            UpdateFillStats(SPSCUsed());
+        SPSCSignalData();
+        return;
+    }
+
     QMutexLocker locker(&lock);
     used     += len;
     writePtr += len;
     writePtr  = (writePtr >= endPtr) ? buffer + (writePtr - endPtr) : writePtr;
-#if REPORT_RING_STATS
-    max_used = max(used, max_used);
-    avg_used = ((avg_used * avg_buf_write_cnt) + used) / (avg_buf_write_cnt+1);
-    ++avg_buf_write_cnt;
-#endif
+    if (report_stats)
+        UpdateFillStats(used);
     dataWait.wakeAll();
 }
 
 void DeviceReadBuffer::IncrReadPointer(uint len)
 {
+    if (spsc)
+    {
+        uint tail = spsc_tail.fetchAndAddRelaxed(0);
+        readPtr += len;
+        readPtr  = (readPtr == endPtr) ? buffer : readPtr;
+        spsc_tail.fetchAndStoreRelease((tail + len) % (2 * size));
+        ++avg_buf_read_cnt;
+        return;
+    }
+
     QMutexLocker locker(&lock);
     used    -= len;
     readPtr += len;
     readPtr  = (readPtr == endPtr) ? buffer : readPtr;
-#if REPORT_RING_STATS
     ++avg_buf_read_cnt;
-#endif
+}
+
+/// Called by the device thread after each write when collecting stats
+void DeviceReadBuffer::UpdateFillStats(size_t used_now)
+{
+    max_used = max(used_now, max_used);
+    avg_used = ((avg_used * avg_buf_write_cnt) + used_now) /
+        (avg_buf_write_cnt+1);
+    ++avg_buf_write_cnt;
+    ++fill_hist[min((size_t)kFillBuckets - 1, used_now * kFillBuckets / size)];
+}
+
+/// Bytes buffered in lock-free mode, safe to call from either thread
+uint DeviceReadBuffer::SPSCUsed(void) const
+{
+    uint head = spsc_head.fetchAndAddAcquire(0);
+    uint tail = spsc_tail.fetchAndAddAcquire(0);
+    return (head + 2 * size - tail) % (2 * size);
+}
+
+/// Wakes the reader, but only if it is waiting for data
+void DeviceReadBuffer::SPSCSignalData(void)
+{
+    if (!spsc_waiting.fetchAndAddOrdered(0))
+        return;
+
+    if (report_stats)
+        spsc_signal_us.fetchAndStoreRelaxed(now_us());
+
+    signal_wake_fd(data_wake_fd);
+}
+
+/// Reader side wait for SPSCSignalData(), returns after max_wait at most
+void DeviceReadBuffer::SPSCWaitForData(uint max_wait) const
+{
+    if (!wait_wake_fd(data_wake_fd, data_wake_flags, max_wait))
+        return;
+
+    if (report_stats)
+    {
+        uint latency = now_us() - (uint)spsc_signal_us.fetchAndAddRelaxed(0);
+        uint bucket = 0;
+        for (uint limit = 100; bucket < kWakeBuckets - 1 && latency >= limit;
+             limit *= 10)
+        {
+            ++bucket;
+        }
+        ++wake_hist[bucket];
+    }
 }
 
 void DeviceReadBuffer::run(void)
@@ -375,6 +590,22 @@ void DeviceReadBuffer::run(void)
         {
             // Limit read size for faster return from read
             unused = static_cast<size_t>(WaitForUnused(read_quanta));
+            if (unused < read_quanta && dorun && IsOpen() &&
+                !IsPauseRequested())
+            {
+                // The ring is full, rather than leave the data to
+                // overflow the driver's buffers drop it here
+                if (!DropRead(errcnt))
+                    break;
+                continue;
+            }
+            if (dropping)
+            {
+                LOG(VB_RECORD, LOG_WARNING, LOC +
+                    QString("Ring buffer has room again, %1 KB dropped "
+                            "so far").arg(total_dropped / 1024));
+                dropping = false;
+            }
             read_size = min(dev_read_size, unused);
 
             // if read_size > 0 do the read...
@@ -411,6 +642,9 @@ void DeviceReadBuffer::run(void)
     unpauseWait.wakeAll();
     lock.unlock();
 
+    if (spsc)
+        SPSCSignalData();
+
     RunEpilog();
 }
 
@@ -673,36 +907,53 @@ uint DeviceReadBuffer::Read(unsigned char *buf, const uint count)
         IncrReadPointer(cnt);
     }
 
-#if REPORT_RING_STATS
-    ReportStats();
-#endif
+    if (report_stats)
+        ReportStats();
 
     return cnt;
 }
 
 /** \fn DeviceReadBuffer::WaitForUnused(uint) const
  *  \param needed Number of bytes we want to write
- *  \return bytes available for writing
+ *  \return bytes available for writing, this never waits for the
+ *          reader, a full ring is left to DropRead()
  */
 uint DeviceReadBuffer::WaitForUnused(uint needed) const
 {
-    size_t unused = GetUnused();
+    (void) needed;
+
+    if (IsPauseRequested() || !IsOpen() || !dorun)
+        return 0;
+
+    return GetUnused();
+}
+
+/** \brief Reads from the device into dropBuffer while the ring is
+ *         full, and counts what is lost.
+ *
+ *  \return false if the read failed for good
+ */
+bool DeviceReadBuffer::DropRead(uint &err_cnt)
+{
+    ssize_t len = read(_stream_fd, dropBuffer, dev_read_size);
+    if (!CheckForErrors(len, dev_read_size, err_cnt))
+        return false;
+    err_cnt = 0;
 
-    if (unused > read_quanta)
+    if (len > 0)
     {
-        while (unused < needed)
+        if (!dropping)
         {
-            unused = GetUnused();
-            if (IsPauseRequested() || !IsOpen() || !dorun)
-                return 0;
-            usleep(5000);
+            LOG(VB_RECORD, LOG_WARNING, LOC +
+                "Ring buffer full, dropping data read from the device");
+            dropping = true;
         }
-        if (IsPauseRequested() || !IsOpen() || !dorun)
-            return 0;
-        unused = GetUnused();
+        ++drop_cnt;
+        drop_bytes    += len;
+        total_dropped += len;
     }
 
-    return unused;
+    return true;
 }
 
 /** \fn DeviceReadBuffer::WaitForUsed(uint,uint) const
@@ -715,6 +966,25 @@ uint DeviceReadBuffer::WaitForUsed(uint needed, uint max_wait) const
     MythTimer timer;
     timer.start();
 
+    if (spsc)
+    {
+        // The flags are only read here, a stale value costs one more
+        // 10ms wait at most.
+        size_t avail = SPSCUsed();
+        while ((needed > avail) && isRunning() &&
+               !request_pause && !error && !eof &&
+               (timer.elapsed() < (int)max_wait))
+        {
+            spsc_waiting.fetchAndStoreOrdered(1);
+            avail = SPSCUsed();
+            if (needed > avail)
+                SPSCWaitForData(10);
+            spsc_waiting.fetchAndStoreOrdered(0);
+            avail = SPSCUsed();
+        }
+        return avail;
+    }
+
     QMutexLocker locker(&lock);
     size_t avail = used;
     while ((needed > avail) && isRunning() &&
@@ -727,31 +997,58 @@ uint DeviceReadBuffer::WaitForUsed(uint needed, uint max_wait) const
     return avail;
 }
 
+/** \brief Logs ring statistics every 20 seconds.
+ *
+ *  Enabled by REPORT_RING_STATS or "-v record --loglevel debug".
+ *  Besides the averages this logs a histogram of the fill level seen
+ *  after each device write and, in lock-free mode, of the time from
+ *  the device thread signalling data to the reader waking up.
+ *  In lock-free mode the device thread counters are read and reset
+ *  without synchronisation, so a report may be off by a few samples.
+ */
 void DeviceReadBuffer::ReportStats(void)
 {
-#if REPORT_RING_STATS
     static const int secs = 20;
     static const double d1_s = 1.0 / secs;
-    if (lastReport.elapsed() > secs * 1000 /* msg every 20 seconds */)
+    if (!report_stats || lastReport.elapsed() <= secs * 1000)
+        return;
+
+    QMutexLocker locker(spsc ? NULL : &lock);
+    double rsize = 100.0 / size;
+    QString msg  = QString("fill avg(%1%) ").arg(avg_used*rsize,5,'f',2);
+    msg         += QString("fill max(%1%) ").arg(max_used*rsize,5,'f',2);
+    msg         += QString("writes/sec(%1) ").arg(avg_buf_write_cnt*d1_s);
+    msg         += QString("reads/sec(%1) ").arg(avg_buf_read_cnt*d1_s);
+    msg         += QString("drops/sec(%1) ").arg(drop_cnt*d1_s);
+    msg         += QString("dropped(%1 KB)").arg(drop_bytes / 1024);
+
+    QString fill = "fill hist(";
+    for (uint i = 0; i < kFillBuckets; ++i)
+        fill += QString("%1%2").arg(i ? " " : "").arg(fill_hist[i]);
+    fill += ")";
+
+    QString wake;
+    if (spsc)
     {
-        QMutexLocker locker(&lock);
-        double rsize = 100.0 / size;
-        QString msg  = QString("fill avg(%1%) ").arg(avg_used*rsize,5,'f',2);
-        msg         += QString("fill max(%1%) ").arg(max_used*rsize,5,'f',2);
-        msg         += QString("writes/sec(%1) ").arg(avg_buf_write_cnt*d1_s);
-        msg         += QString("reads/sec(%1) ").arg(avg_buf_read_cnt*d1_s);
-        msg         += QString("sleeps/sec(%1)").arg(avg_buf_sleep_cnt*d1_s);
+        wake = QString(" wake hist(<0.1ms %1 <1ms %2 <10ms %3 "
+                       "<100ms %4 >=100ms %5)")
+            .arg(wake_hist[0]).arg(wake_hist[1]).arg(wake_hist[2])
+            .arg(wake_hist[3]).arg(wake_hist[4]);
+    }
 
-        avg_used    = 0;
-        avg_buf_write_cnt = 0;
-        avg_buf_read_cnt = 0;
-        avg_buf_sleep_cnt = 0;
-        max_used    = 0;
-        lastReport.start();
+    avg_used    = 0;
+    avg_buf_write_cnt = 0;
+    avg_buf_read_cnt = 0;
+    avg_buf_sleep_cnt = 0;
+    drop_cnt    = 0;
+    drop_bytes  = 0;
+    max_used    = 0;
+    memset(fill_hist, 0, sizeof(fill_hist));
+    memset(wake_hist, 0, sizeof(wake_hist));
+    lastReport.start();
 
-        LOG(VB_GENERAL, LOG_INFO, LOC + msg);
-    }
-#endif
+    LOG(VB_RECORD, LOG_DEBUG, LOC + msg);
+    LOG(VB_RECORD, LOG_DEBUG, LOC + fill + wake);
 }
 
 /*
@@ -6,6 +6,7 @@
 
 #include <unistd.h>
 
+#include <QAtomicInt>
 #include <QMutex>
 #include <QWaitCondition>
 #include <QString>
@@ -29,6 +30,18 @@ class DeviceReaderCB
  *  This allows us to read the device regularly even in the presence
  *  of long blocking conditions on writing to disk or accessing the
  *  database.
+ *
+ *  When the "HDRingbufferLockFree" setting is enabled the ring is run
+ *  as a single producer/single consumer queue: the read and write
+ *  positions are atomics owned by the consumer and the device thread
+ *  respectively, and the reader is woken through an eventfd (a pipe
+ *  where eventfd is unavailable) only when it is actually waiting.
+ *  Neither Read() nor the device thread take the mutex per transfer.
+ *  Reset() pauses the device thread while it empties the ring.
+ *
+ *  The device thread never waits for the reader: when the ring is
+ *  full it keeps reading the device and drops what it reads, so the
+ *  driver's buffers don't overflow, and counts the bytes dropped.
  */
 class DeviceReadBuffer : protected MThread
 {
@@ -71,6 +84,7 @@ class DeviceReadBuffer : protected MThread
     bool Poll(void) const;
     void WakePoll(void) const;
     uint WaitForUnused(uint bytes_needed) const;
+    bool DropRead(uint &err_cnt);
     uint WaitForUsed  (uint bytes_needed, uint max_wait /*ms*/) const;
 
     bool IsPauseRequested(void) const;
@@ -82,6 +96,12 @@ class DeviceReadBuffer : protected MThread
     bool CheckForErrors(ssize_t read_len, size_t requested_len, uint &err_cnt);
     void ReportStats(void);
 
+    // Lock-free single producer/single consumer mode
+    uint SPSCUsed(void) const;
+    void SPSCSignalData(void);
+    void SPSCWaitForData(uint max_wait /*ms*/) const;
+    void UpdateFillStats(size_t used_now);
+
     QString          videodevice;
     int              _stream_fd;
     mutable int      wake_pipe[2];
@@ -110,18 +130,38 @@ class DeviceReadBuffer : protected MThread
     unsigned char   *readPtr;
     unsigned char   *writePtr;
     unsigned char   *endPtr;
+    unsigned char   *dropBuffer;  ///< what is read while the ring is full
 
     mutable QWaitCondition dataWait;
     QWaitCondition   runWait;
     QWaitCondition   pauseWait;
     QWaitCondition   unpauseWait;
 
+    // Lock-free single producer/single consumer mode. The positions
+    // count bytes modulo 2 * size so that full and empty differ.
+    bool             spsc;
+    mutable QAtomicInt spsc_head;     ///< written by the device thread
+    mutable QAtomicInt spsc_tail;     ///< written by the reader
+    mutable QAtomicInt spsc_waiting;  ///< reader is waiting for data
+    mutable QAtomicInt spsc_signal_us; ///< time of last wakeup sent
+    mutable int      data_wake_fd[2]; ///< eventfd in [0], or a pipe
+    mutable long     data_wake_flags[2];
+
     // statistics
+    bool             report_stats;
     size_t           max_used;
     size_t           avg_used;
     size_t           avg_buf_write_cnt;
     size_t           avg_buf_read_cnt;
     size_t           avg_buf_sleep_cnt;
+    size_t           drop_cnt;      ///< reads dropped since the last report
+    uint64_t         drop_bytes;    ///< bytes dropped since the last report
+    uint64_t         total_dropped; ///< bytes dropped since Setup()
+    bool             dropping;
+    static const uint kFillBuckets = 10;
+    size_t           fill_hist[kFillBuckets];  ///< 10% steps of size
+    static const uint kWakeBuckets = 5;
+    mutable size_t   wake_hist[kWakeBuckets];  ///< <0.1,<1,<10,<100,>=100ms
     MythTimer        lastReport;
 };
 
@@ -22,6 +22,8 @@
 #include "mpegstreamdata.h"
 #include "dvbstreamdata.h"
 #include "dtvrecorder.h"
+#include "livecommdetector.h"
+#include "jobqueue.h"
 #include "programinfo.h"
 #include "mythlogging.h"
 #include "mpegtables.h"
@@ -70,6 +72,9 @@ DTVRecorder::DTVRecorder(TVRec *rec) :
     // state
     _error(),
     _stream_data(NULL),
+    m_liveCommDetector(NULL),
+    m_liveCommPID(0),
+    m_liveCommCodec(AV_CODEC_ID_NONE),
     // TS packet buffer
     // keyframe TS buffer
     _buffer_packets(false),
@@ -110,6 +115,7 @@ DTVRecorder::~DTVRecorder(void)
 {
     StopRecording();
 
+    StopLiveCommDetector(false);
     SetStreamData(NULL);
 
     if (_input_pat)
@@ -174,9 +180,100 @@ void DTVRecorder::FinishRecording(void)
         SetTotalFrames(_frames_written_count);
     }
 
+    StopLiveCommDetector(true);
+    m_liveCommPID   = 0;
+    m_liveCommCodec = AV_CODEC_ID_NONE;
+
     RecorderBase::FinishRecording();
 }
 
+/** \brief Starts flagging commercials from the video stream, when
+ *         enabled and the recording is to be flagged.
+ *
+ *  This is called for every PMT. A detector already running is
+ *  started over when the video PID or codec changed. The detector
+ *  takes over a flagging job queued when the recording started, and
+ *  queues it again if it can not save the breaks.
+ */
+void DTVRecorder::StartLiveCommDetector(uint videoPID, AVCodecID codec)
+{
+    if (!curRecording || !_stream_data)
+        return;
+
+    if (m_liveCommPID == videoPID && m_liveCommCodec == codec)
+        return;
+    bool changed = m_liveCommPID != 0;
+    m_liveCommPID   = videoPID;
+    m_liveCommCodec = codec;
+
+    bool canFlag =
+        gCoreContext->GetNumSetting("AutoCommflagInRecorder", 0) &&
+        curRecording->GetRecordingGroup() != "LiveTV" &&
+        (curRecording->GetAutoRunJobs() & JOB_COMMFLAG) &&
+        !curRecording->IsCommercialFree();
+
+    if (canFlag && !LiveCommDetector::IsSupported(codec))
+    {
+        LOG(VB_RECORD, LOG_INFO, LOC +
+            QString("Can not flag %1 video while recording")
+            .arg(ff_codec_id_string(codec)));
+        canFlag = false;
+    }
+
+    bool replacesJob = false;
+    if (m_liveCommDetector)
+    {
+        LOG(VB_RECORD, LOG_INFO, LOC +
+            "Video stream changed, flagging commercials from the start");
+        // A detector that replaced the flagging job queues it again as
+        // it stops, unless the new one takes the job over.
+        if (canFlag)
+        {
+            replacesJob = m_liveCommDetector->GetReplacesJob();
+            m_liveCommDetector->SetReplacesJob(false);
+        }
+        StopLiveCommDetector(false);
+    }
+    else if (changed && canFlag)
+    {
+        LOG(VB_RECORD, LOG_INFO, LOC +
+            "Video stream changed, flagging commercials from here on");
+    }
+
+    if (!canFlag)
+        return;
+
+    LiveCommAnalyzer::Settings settings;
+    settings.Load();
+
+    m_liveCommDetector = new LiveCommDetector(
+        *curRecording, videoPID, codec,
+        gCoreContext->GetNumSetting("AutoCommflagInRecorderCPU", 25),
+        settings);
+    m_liveCommDetector->SetReplacesJob(replacesJob);
+    _stream_data->AddAVListener(m_liveCommDetector);
+    m_liveCommDetector->Start();
+}
+
+/** \brief Stops flagging commercials, and when save is set leaves the
+ *         detector to save the commercial breaks found on its own thread.
+ */
+void DTVRecorder::StopLiveCommDetector(bool save)
+{
+    if (!m_liveCommDetector)
+        return;
+
+    if (_stream_data)
+        _stream_data->RemoveAVListener(m_liveCommDetector);
+    if (save)
+        LiveCommDetector::Finish(m_liveCommDetector,
+                                 (uint64_t) _total_duration);
+    else
+        delete m_liveCommDetector;
+
+    m_liveCommDetector = NULL;
+}
+
 void DTVRecorder::ResetForNewFile(void)
 {
     LOG(VB_RECORD, LOG_INFO, LOC + "ResetForNewFile(void)");
@@ -259,16 +356,25 @@ void DTVRecorder::SetStreamData(MPEGStreamData *data)
     MPEGStreamData *old_data = _stream_data;
     _stream_data = data;
     if (old_data)
+    {
+        if (m_liveCommDetector)
+            old_data->RemoveAVListener(m_liveCommDetector);
         delete old_data;
+    }
 
     if (_stream_data)
+    {
         InitStreamData();
+        if (m_liveCommDetector)
+            _stream_data->AddAVListener(m_liveCommDetector);
+    }
 }
 
 void DTVRecorder::InitStreamData(void)
 {
     _stream_data->AddMPEGSPListener(this);
     _stream_data->AddMPEGListener(this);
+    _stream_data->SetBatchProcessing(true);
 
     DVBStreamData *dvb = dynamic_cast<DVBStreamData*>(_stream_data);
     if (dvb)
@@ -1350,6 +1456,29 @@ void DTVRecorder::HandleSingleProgramPAT(ProgramAssociationTable *pat,
         DTVRecorder::BufferedWrite(_scratch[i], insert);
 }
 
+static AVCodecID video_codec_id(uint stream_type)
+{
+    switch (stream_type)
+    {
+        case StreamID::MPEG1Video:
+            return AV_CODEC_ID_MPEG1VIDEO;
+        case StreamID::MPEG2Video:
+            return AV_CODEC_ID_MPEG2VIDEO;
+        case StreamID::MPEG4Video:
+            return AV_CODEC_ID_MPEG4;
+        case StreamID::H264Video:
+            return AV_CODEC_ID_H264;
+        case StreamID::H265Video:
+            return AV_CODEC_ID_H265;
+        case StreamID::OpenCableVideo:
+            return AV_CODEC_ID_MPEG2VIDEO; // TODO Will it always be MPEG2?
+        case StreamID::VC1Video:
+            return AV_CODEC_ID_VC1;
+        default:
+            return AV_CODEC_ID_NONE;
+    }
+}
+
 void DTVRecorder::HandleSingleProgramPMT(ProgramMapTable *pmt, bool insert)
 {
     if (!pmt)
@@ -1362,6 +1491,8 @@ void DTVRecorder::HandleSingleProgramPMT(ProgramMapTable *pmt, bool insert)
     bool seenVideo = (m_primaryVideoCodec != AV_CODEC_ID_NONE);
     bool seenAudio = (m_primaryAudioCodec != AV_CODEC_ID_NONE);
     uint bestAudioCodec = 0;
+    uint videoPID = 0;
+    AVCodecID videoCodec = AV_CODEC_ID_NONE;
     // collect stream types for H.264 (MPEG-4 AVC) keyframe detection
     for (uint i = 0; i < pmt->StreamCount(); ++i)
     {
@@ -1370,37 +1501,20 @@ void DTVRecorder::HandleSingleProgramPMT(ProgramMapTable *pmt, bool insert)
             StreamID::IsVideo(pmt->StreamType(i)))
         {
             seenVideo = true; // Ignore other video streams
-            switch (pmt->StreamType(i))
-            {
-                case StreamID::MPEG1Video:
-                    m_primaryVideoCodec = AV_CODEC_ID_MPEG1VIDEO;
-                    break;
-                case StreamID::MPEG2Video:
-                    m_primaryVideoCodec = AV_CODEC_ID_MPEG2VIDEO;
-                    break;
-                case StreamID::MPEG4Video:
-                    m_primaryVideoCodec = AV_CODEC_ID_MPEG4;
-                    break;
-                case StreamID::H264Video:
-                    m_primaryVideoCodec = AV_CODEC_ID_H264;
-                    break;
-                case StreamID::H265Video:
-                    m_primaryVideoCodec = AV_CODEC_ID_H265;
-                    break;
-                case StreamID::OpenCableVideo:
-                    m_primaryVideoCodec = AV_CODEC_ID_MPEG2VIDEO; // TODO Will it always be MPEG2?
-                    break;
-                case StreamID::VC1Video:
-                    m_primaryVideoCodec = AV_CODEC_ID_VC1;
-                    break;
-                default:
-                    break;
-            }
+            m_primaryVideoCodec = video_codec_id(pmt->StreamType(i));
 
             if (m_primaryVideoCodec != AV_CODEC_ID_NONE)
                 VideoCodecChange(m_primaryVideoCodec);
         }
 
+        // The commercial detector follows the video stream of every
+        // PMT, it may move to another PID or codec mid-recording
+        if (!videoPID && StreamID::IsVideo(pmt->StreamType(i)))
+        {
+            videoPID   = pmt->StreamPID(i);
+            videoCodec = video_codec_id(pmt->StreamType(i));
+        }
+
         // We want the 'best' identifiable audio stream, where 'best' is
         // subjective and no-one will likely agree.
         // For now it's the 'best' codec, assuming mpeg stream types range
@@ -1447,6 +1561,9 @@ void DTVRecorder::HandleSingleProgramPMT(ProgramMapTable *pmt, bool insert)
         _stream_id[pmt->StreamPID(i)] = pmt->StreamType(i);
     }
 
+    if (videoPID)
+        StartLiveCommDetector(videoPID, videoCodec);
+
     // If the PCRPID is valid and the PCR is not contained
     // in another stream, make sure the PCR stream is not
     // discarded (use PrivSec type as dummy 'valid' value)
@@ -1541,6 +1658,18 @@ bool DTVRecorder::ProcessVideoTSPacket(const TSPacket &tspacket)
     return ProcessAVTSPacket(tspacket);
 }
 
+void DTVRecorder::ProcessVideoTSPackets(const TSPacket *tspackets, uint count)
+{
+    for (uint i = 0; i < count; ++i)
+        DTVRecorder::ProcessVideoTSPacket(tspackets[i]);
+}
+
+void DTVRecorder::ProcessAudioTSPackets(const TSPacket *tspackets, uint count)
+{
+    for (uint i = 0; i < count; ++i)
+        DTVRecorder::ProcessAudioTSPacket(tspackets[i]);
+}
+
 bool DTVRecorder::ProcessAudioTSPacket(const TSPacket &tspacket)
 {
     if (!ringBuffer)
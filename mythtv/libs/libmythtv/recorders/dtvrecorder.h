@@ -20,6 +20,7 @@ using namespace std;
 #include "recorderbase.h"
 #include "H264Parser.h"
 
+class LiveCommDetector;
 class MPEGStreamData;
 class TSPacket;
 class QTime;
@@ -86,6 +87,8 @@ class DTVRecorder :
     // TSPacketListenerAV
     bool ProcessVideoTSPacket(const TSPacket& tspacket);
     bool ProcessAudioTSPacket(const TSPacket& tspacket);
+    void ProcessVideoTSPackets(const TSPacket *tspackets, uint count);
+    void ProcessAudioTSPackets(const TSPacket *tspackets, uint count);
 
     // Common audio/visual processing
     bool ProcessAVTSPacket(const TSPacket &tspacket);
@@ -118,6 +121,10 @@ class DTVRecorder :
     // For handling other (non audio/video) packets
     bool FindOtherKeyframes(const TSPacket *tspacket);
 
+    // commercial detection while recording
+    void StartLiveCommDetector(uint videoPID, AVCodecID codec);
+    void StopLiveCommDetector(bool save);
+
     inline bool CheckCC(uint pid, uint cc);
 
     virtual QString GetSIStandard(void) const { return "mpeg"; }
@@ -159,6 +166,10 @@ class DTVRecorder :
     QString _error;
 
     MPEGStreamData          *_stream_data;
+    LiveCommDetector        *m_liveCommDetector;
+    /// video stream the detector was last started for, 0 if none
+    uint                     m_liveCommPID;
+    AVCodecID                m_liveCommCodec;
 
     // keyframe finding buffer
     bool                  _buffer_packets;
@@ -100,6 +100,7 @@ DVBStreamHandler::DVBStreamHandler(const QString &dvb_device) :
     _drb(NULL)
 {
     setObjectName("DVBRead");
+    _packet_ring = new PacketRing();
 }
 
 void DVBStreamHandler::SetRunningDesired(bool desired)
@@ -261,24 +262,10 @@ void DVBStreamHandler::RunTS(void)
             continue;
         }
 
-        _listener_lock.lock();
-
-        if (_stream_data_list.empty())
-        {
-            _listener_lock.unlock();
-            continue;
-        }
-
-        StreamDataList::const_iterator sit = _stream_data_list.begin();
-        for (; sit != _stream_data_list.end(); ++sit)
-            remainder = sit.key()->ProcessData(buffer, len);
-
-        WriteMPTS(buffer, len - remainder);
-
-        _listener_lock.unlock();
-
-        if (remainder > 0 && (len > remainder)) // leftover bytes
-            memmove(buffer, &(buffer[len - remainder]), remainder);
+        // Read once, each listener and the MPTS writer process this
+        // block on their own thread and carry their own leftover bytes.
+        PushData(QByteArray(reinterpret_cast<const char*>(buffer), len));
+        remainder = 0;
     }
     LOG(VB_RECORD, LOG_DEBUG, LOC + "RunTS(): " + "shutdown");
 
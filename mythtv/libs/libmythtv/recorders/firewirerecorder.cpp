@@ -10,6 +10,7 @@
 #include "mythlogging.h"
 #include "mpegtables.h"
 #include "mpegstreamdata.h"
+#include "tssync.h"
 #include "tv_rec.h"
 
 #define LOC QString("FireRecBase[%1](%2): ") \
@@ -117,19 +118,20 @@ void FirewireRecorder::AddData(const unsigned char *data, uint len)
     buffer.insert(buffer.end(), data, data + len);
     bufsz += len;
 
-    int sync_at = -1;
-    for (uint i = 0; (i < bufsz) && (sync_at < 0); i++)
+    if (bufsz < 30 * TSPacket::kSize)
+        return; // build up a little buffer
+
+    int sync_at = TSSyncScanner::Find(&buffer[0], 0, bufsz);
+    if (sync_at == -2)
     {
-        if (buffer[i] == SYNC_BYTE)
-            sync_at = i;
+        // nothing before the last packet can start one, drop it
+        buffer.erase(buffer.begin(), buffer.end() - TSPacket::kSize);
+        return;
     }
 
     if (sync_at < 0)
         return;
 
-    if (bufsz < 30 * TSPacket::kSize)
-        return; // build up a little buffer
-
     while (sync_at + TSPacket::kSize < bufsz)
     {
         ProcessTSPacket(*(reinterpret_cast<const TSPacket*>(
@@ -108,6 +108,7 @@ HDHRStreamHandler::HDHRStreamHandler(const QString &device) :
     _hdhr_lock(QMutex::Recursive)
 {
     setObjectName("HDHRStreamHandler");
+    _packet_ring = new PacketRing();
 }
 
 /** \fn HDHRStreamHandler::run(void)
@@ -144,7 +145,6 @@ void HDHRStreamHandler::run(void)
 
     LOG(VB_RECORD, LOG_INFO, LOC + "RunTS(): begin");
 
-    int remainder = 0;
     QTime last_update;
     while (_running_desired && !_error)
     {
@@ -174,27 +174,10 @@ void HDHRStreamHandler::run(void)
 
         // Assume data_length is a multiple of 188 (packet size)
 
-        _listener_lock.lock();
-
-        if (_stream_data_list.empty())
-        {
-            _listener_lock.unlock();
-            continue;
-        }
-
-        StreamDataList::const_iterator sit = _stream_data_list.begin();
-        for (; sit != _stream_data_list.end(); ++sit)
-            remainder = sit.key()->ProcessData(data_buffer, data_length);
-
-        WriteMPTS(data_buffer, data_length - remainder);
-
-        _listener_lock.unlock();
-        if (remainder != 0)
-        {
-            LOG(VB_RECORD, LOG_INFO, LOC +
-                QString("RunTS(): data_length = %1 remainder = %2")
-                    .arg(data_length).arg(remainder));
-        }
+        // The library reuses data_buffer, so this is the only copy;
+        // each listener processes the block on its own thread.
+        PushData(QByteArray(reinterpret_cast<const char*>(data_buffer),
+                            data_length));
     }
     LOG(VB_RECORD, LOG_INFO, LOC + "RunTS(): " + "shutdown");
 
@@ -116,6 +116,8 @@ IPTVStreamHandler::IPTVStreamHandler(const IPTVTuningData &tuning) :
     memset(m_sockets, 0, sizeof(m_sockets));
     memset(m_read_helpers, 0, sizeof(m_read_helpers));
     m_use_rtp_streaming = m_tuning.IsRTP();
+    // Datagrams are small, keep about as much data queued as the DVB ring
+    _packet_ring = new PacketRing(8 * PacketRing::kDefaultSize);
 }
 
 void IPTVStreamHandler::run(void)
@@ -444,26 +446,8 @@ void IPTVStreamHandlerWriteHelper::timerEvent(QTimerEvent* event)
         if (packet.GetDataReference().isEmpty())
             break;
 
-        int remainder = 0;
-        {
-            QMutexLocker locker(&m_parent->_listener_lock);
-            QByteArray &data = packet.GetDataReference();
-            IPTVStreamHandler::StreamDataList::const_iterator sit;
-            sit = m_parent->_stream_data_list.begin();
-            for (; sit != m_parent->_stream_data_list.end(); ++sit)
-            {
-                remainder = sit.key()->ProcessData(
-                    reinterpret_cast<const unsigned char*>(data.data()),
-                    data.size());
-            }
-        }
-
-        if (remainder != 0)
-        {
-            LOG(VB_RECORD, LOG_INFO, LOC_WH +
-                QString("data_length = %1 remainder = %2")
-                .arg(packet.GetDataReference().size()).arg(remainder));
-        }
+        // Shares the datagram with the listeners, no copy
+        m_parent->PushData(packet.GetDataReference());
 
         m_parent->m_buffer->FreePacket(packet);
     }
@@ -505,25 +489,9 @@ void IPTVStreamHandlerWriteHelper::timerEvent(QTimerEvent* event)
                 QString("Processing RTP packet(seq:%1 ts:%2)")
                 .arg(m_last_sequence_number).arg(m_last_timestamp));
 
-            m_parent->_listener_lock.lock();
-
-            int remainder = 0;
-            IPTVStreamHandler::StreamDataList::const_iterator sit;
-            sit = m_parent->_stream_data_list.begin();
-            for (; sit != m_parent->_stream_data_list.end(); ++sit)
-            {
-                remainder = sit.key()->ProcessData(
-                    ts_packet.GetTSData(), ts_packet.GetTSDataSize());
-            }
-
-            m_parent->_listener_lock.unlock();
-
-            if (remainder != 0)
-            {
-                LOG(VB_RECORD, LOG_INFO, LOC_WH +
-                    QString("data_length = %1 remainder = %2")
-                    .arg(ts_packet.GetTSDataSize()).arg(remainder));
-            }
+            m_parent->PushData(QByteArray(
+                reinterpret_cast<const char*>(ts_packet.GetTSData()),
+                ts_packet.GetTSDataSize()));
         }
         m_parent->m_buffer->FreePacket(packet);
     }
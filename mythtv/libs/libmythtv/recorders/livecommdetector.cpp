@@ -0,0 +1,1072 @@
+// -*- Mode: c++ -*-
+
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+#include <QElapsedTimer>
+#include <QRunnable>
+
+#include "livecommdetector.h"
+#include "mythcorecontext.h"
+#include "mthreadpool.h"
+#include "framekernels.h"
+#include "jobqueue.h"
+#include "mythlogging.h"
+#include "tspacket.h"
+
+#define LOC QString("LiveComm(%1): ").arg(m_pginfo.MakeUniqueKey())
+
+/// The edge differences a logo is looked for with, in this order
+const int LiveCommAnalyzer::kLogoEdgeDiffs[] = { 10, 20, 40, 0 };
+
+/// Commercial lengths in seconds, a part of the recording this long
+/// that is not known to show the logo is taken to be a commercial
+static const int kCommLengths[] = { 10, 15, 20, 30, 45, 60, 90, 120, 0 };
+/// How far in milliseconds a length may be from a commercial length
+static const int64_t kCommLengthSlack = 600;
+/// Blank frames closer than this in milliseconds make a single cut
+static const int64_t kMinSegmentLength = 1000;
+/// A break this close in milliseconds to the start or end of the
+/// recording is taken to start or end it
+static const int64_t kEdgeSlack = 30 * 1000;
+/// Frames a second there must be in a part of the recording to count
+/// its scene changes, fewer means frames were skipped to keep up
+static const double kMinSceneFps = 10.0;
+
+LiveCommAnalyzer::Settings::Settings() :
+    blankMaxDiff(25),
+    blankMaxBrightness(120),
+    sceneThreshold(0.85),
+    commSceneRate(1.0),
+    minBreakLength(60),
+    maxBreakLength(395),
+    maxCommLength(125),
+    logoSamples(30),
+    logoSampleSpacing(2),
+    logoGoodEdges(0.75)
+{
+}
+
+/// Takes the settings shared with the classic commercial detector
+void LiveCommAnalyzer::Settings::Load(void)
+{
+    blankMaxDiff =
+        gCoreContext->GetNumSetting("CommDetectBlankFrameMaxDiff", 25);
+    blankMaxBrightness =
+        gCoreContext->GetNumSetting("CommDetectDimBrightness", 120);
+    minBreakLength =
+        gCoreContext->GetNumSetting("CommDetectMinCommBreakLength", 60);
+    maxBreakLength =
+        gCoreContext->GetNumSetting("CommDetectMaxCommBreakLength", 395);
+    maxCommLength =
+        gCoreContext->GetNumSetting("CommDetectMaxCommLength", 125);
+    logoSampleSpacing = max(1,
+        gCoreContext->GetNumSetting("CommDetectLogoSampleSpacing", 2));
+    logoGoodEdges =
+        gCoreContext->GetSetting("CommDetectLogoGoodEdgeThreshold", "0.75")
+        .toDouble();
+}
+
+LiveCommAnalyzer::LiveCommAnalyzer(const Settings &settings) :
+    m_settings(settings),
+    m_width(0),             m_height(0),
+    m_border(0),            m_lastSceneChange(false),
+    m_logoSamples(0),       m_lastLogoSample(-1),
+    m_logoKnown(false),     m_logoEdgeDiff(0),
+    m_logoPixels(0),
+    m_logoMinX(0),          m_logoMaxX(0),
+    m_logoMinY(0),          m_logoMaxY(0)
+{
+}
+
+void LiveCommAnalyzer::Resize(int width, int height)
+{
+    LOG(VB_COMMFLAG, LOG_INFO, QString("LiveComm: Frames are %1x%2")
+        .arg(width).arg(height));
+
+    m_width  = width;
+    m_height = height;
+    m_border = max(kEdgeRadius, 20 * height / 720);
+
+    m_all.assign(width, 0xff);
+    m_colmax.assign(width, 0);
+    m_pixels.resize(width);
+    m_histogram.assign(256, 0);
+    m_lastHistogram.clear();
+    m_lastSceneChange = false;
+
+    // the logo is learned again, it is not where it was
+    m_edgeCounts.clear();
+    for (int i = 0; kLogoEdgeDiffs[i]; ++i)
+        m_edgeCounts.push_back(vector<uint16_t>(width * height, 0));
+    m_logoSamples    = 0;
+    m_lastLogoSample = -1;
+    m_logoKnown      = false;
+    m_logoMask.clear();
+    m_edgeFlags.resize(width);
+}
+
+/** \brief Analyzes the next frame.
+ *  \param luma  the luma plane of the frame
+ *  \param ms    milliseconds since the start of the recording, frames
+ *               not after the last one are ignored
+ */
+void LiveCommAnalyzer::AddFrame(const uint8_t *luma, int pitch,
+                                int width, int height, int64_t ms)
+{
+    if (width < 8 * kEdgeRadius || height < 8 * kEdgeRadius)
+        return;
+    if (!m_frames.empty() && ms <= m_frames.back().ms)
+        return;
+    if (width != m_width || height != m_height)
+        Resize(width, height);
+
+    Frame frame;
+    frame.ms = ms;
+    frame.flags = 0;
+
+    if (IsBlank(luma, pitch))
+    {
+        frame.flags |= kBlank;
+    }
+    else
+    {
+        if (IsSceneChange(luma, pitch))
+            frame.flags |= kSceneChange;
+
+        if (!m_logoKnown)
+            LearnLogo(luma, pitch, ms);
+
+        if (m_logoKnown)
+        {
+            frame.flags |= kLogoKnown;
+            if (HasLogo(luma, pitch))
+                frame.flags |= kLogo;
+        }
+    }
+
+    m_frames.push_back(frame);
+}
+
+/// Every other row inside the border must be dark and flat
+bool LiveCommAnalyzer::IsBlank(const uint8_t *luma, int pitch)
+{
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+    int count = m_width - 2 * m_border;
+    int min = 255, max = 0;
+
+    for (int y = m_border; y < m_height - m_border; y += 2)
+    {
+        uint8_t rowmin, rowmax;
+        uint32_t sum;
+        kernels.rowStats(luma + y * pitch + m_border, &m_all[0], count,
+                         &m_colmax[0], &rowmin, &rowmax, &sum);
+        min = std::min(min, (int)rowmin);
+        max = std::max(max, (int)rowmax);
+
+        if ((max - min) > m_settings.blankMaxDiff ||
+            max >= m_settings.blankMaxBrightness)
+            return false;
+    }
+
+    return true;
+}
+
+/// Compares the histogram of every 4th pixel of every 4th row with the
+/// last frame's, a scene change is never followed by another.
+bool LiveCommAnalyzer::IsSceneChange(const uint8_t *luma, int pitch)
+{
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+    int count = (m_width - 2 * m_border) / 4;
+    int total = 0;
+
+    std::fill(m_histogram.begin(), m_histogram.end(), 0);
+    for (int y = m_border; y < m_height - m_border; y += 4)
+    {
+        kernels.gather(luma + y * pitch + m_border, count, 4, &m_pixels[0]);
+        kernels.histogram(&m_pixels[0], count, &m_histogram[0], NULL, NULL);
+        total += count;
+    }
+
+    bool change = false;
+    if (!m_lastHistogram.empty() && total)
+    {
+        int same = 0;
+        for (uint i = 0; i < 256; ++i)
+            same += std::min(m_histogram[i], m_lastHistogram[i]);
+        change = ((double)same / total < m_settings.sceneThreshold) &&
+            !m_lastSceneChange;
+    }
+
+    m_lastHistogram = m_histogram;
+    m_lastSceneChange = change;
+    return change;
+}
+
+/** \brief Counts the edges of a frame every logoSampleSpacing seconds,
+ *         and after logoSamples of them looks for the logo, as
+ *         ClassicLogoDetector does.
+ *
+ *  Only the corners are looked at. When no logo is found it is looked
+ *  for again in the frames to come.
+ */
+void LiveCommAnalyzer::LearnLogo(const uint8_t *luma, int pitch, int64_t ms)
+{
+    if (m_lastLogoSample >= 0 &&
+        ms - m_lastLogoSample < m_settings.logoSampleSpacing * 1000)
+        return;
+    m_lastLogoSample = ms;
+
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+    int count = m_width - 2 * m_border;
+
+    for (uint i = 0; i < m_edgeCounts.size(); ++i)
+    {
+        uint16_t *counts = &m_edgeCounts[i][0];
+        for (int y = m_border; y < m_height - m_border; ++y)
+        {
+            if (y >= m_height / 3 && y < m_height * 2 / 3)
+                continue;
+
+            kernels.edgeFlags(luma + y * pitch + m_border, pitch, count,
+                              kEdgeRadius, kLogoEdgeDiffs[i],
+                              &m_edgeFlags[0]);
+            uint16_t *row = counts + y * m_width + m_border;
+            for (int x = 0; x < count; ++x)
+                row[x] += m_edgeFlags[x] ? 1 : 0;
+        }
+    }
+
+    if (++m_logoSamples < m_settings.logoSamples)
+        return;
+
+    for (uint i = 0; i < m_edgeCounts.size() && !m_logoKnown; ++i)
+        m_logoKnown = BuildLogoMask(kLogoEdgeDiffs[i], m_edgeCounts[i]);
+
+    if (m_logoKnown)
+    {
+        LOG(VB_COMMFLAG, LOG_INFO,
+            QString("LiveComm: Found logo at %1x%2 to %3x%4 "
+                    "with edgeDiff == %5, %6 pixels")
+            .arg(m_logoMinX).arg(m_logoMinY).arg(m_logoMaxX).arg(m_logoMaxY)
+            .arg(m_logoEdgeDiff).arg(m_logoPixels));
+        m_edgeCounts.clear();
+        return;
+    }
+
+    LOG(VB_COMMFLAG, LOG_INFO,
+        "LiveComm: No logo found, looking again in the frames to come");
+    for (uint i = 0; i < m_edgeCounts.size(); ++i)
+        std::fill(m_edgeCounts[i].begin(), m_edgeCounts[i].end(), 0);
+    m_logoSamples = 0;
+}
+
+/// A logo is the pixels with an edge in 2/3 of the samples, in one
+/// corner and neither too few nor too many of them.
+bool LiveCommAnalyzer::BuildLogoMask(int diff, const vector<uint16_t> &counts)
+{
+    int needed = m_settings.logoSamples * 2 / 3;
+    uint pixels = 0;
+    int minX = m_width, maxX = -1, minY = m_height, maxY = -1;
+
+    m_logoMask.assign(m_width * m_height, 0);
+    for (int y = 0; y < m_height; ++y)
+    {
+        for (int x = 0; x < m_width; ++x)
+        {
+            int pos = y * m_width + x;
+            if (counts[pos] <= needed)
+                continue;
+            if (x >= m_width / 3 && x < m_width * 2 / 3)
+                continue;
+
+            m_logoMask[pos] = 0xff;
+            pixels++;
+            minX = min(minX, x);
+            maxX = max(maxX, x);
+            minY = min(minY, y);
+            maxY = max(maxY, y);
+        }
+    }
+
+    uint minPixels = max(8, m_width * m_height / 2000);
+    uint maxPixels = m_width * m_height / 30;
+    if (pixels < minPixels || pixels > maxPixels ||
+        (maxX - minX) > m_width / 3 || (maxY - minY) > m_height / 3)
+    {
+        LOG(VB_COMMFLAG, LOG_DEBUG,
+            QString("LiveComm: No logo with edgeDiff == %1, %2 pixels")
+            .arg(diff).arg(pixels));
+        m_logoMask.clear();
+        return false;
+    }
+
+    m_logoEdgeDiff = diff;
+    m_logoPixels   = pixels;
+    m_logoMinX     = minX;
+    m_logoMaxX     = maxX;
+    m_logoMinY     = minY;
+    m_logoMaxY     = maxY;
+    return true;
+}
+
+bool LiveCommAnalyzer::HasLogo(const uint8_t *luma, int pitch)
+{
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+    int count = m_logoMaxX - m_logoMinX + 1;
+    uint found = 0;
+
+    for (int y = m_logoMinY; y <= m_logoMaxY; ++y)
+    {
+        kernels.edgeFlags(luma + y * pitch + m_logoMinX, pitch, count,
+                          kEdgeRadius, m_logoEdgeDiff, &m_edgeFlags[0]);
+        found += kernels.countBoth(&m_edgeFlags[0],
+                                   &m_logoMask[y * m_width + m_logoMinX],
+                                   count);
+    }
+
+    return (double)found / m_logoPixels > m_settings.logoGoodEdges;
+}
+
+bool LiveCommAnalyzer::IsStandardLength(int64_t length) const
+{
+    for (uint i = 0; kCommLengths[i]; ++i)
+    {
+        if (llabs(length - kCommLengths[i] * 1000LL) <= kCommLengthSlack)
+            return true;
+    }
+    return false;
+}
+
+/** \brief Whether frames first to end, lasting length milliseconds, are
+ *         a commercial.
+ *
+ *  Once the logo is known a commercial is what does not show it.
+ *  Before that it is what lasts as long as a commercial usually does,
+ *  or changes scenes as often as a commercial usually does.
+ */
+bool LiveCommAnalyzer::IsCommercial(uint first, uint end,
+                                    int64_t length) const
+{
+    if (length <= 0 || length > m_settings.maxCommLength * 1000LL)
+        return false;
+
+    uint frames = 0, known = 0, logo = 0, scenes = 0;
+    for (uint i = first; i < end; ++i)
+    {
+        uint flags = m_frames[i].flags;
+        if (flags & kBlank)
+            continue;
+        frames++;
+        known  += (flags & kLogoKnown)   ? 1 : 0;
+        logo   += (flags & kLogo)        ? 1 : 0;
+        scenes += (flags & kSceneChange) ? 1 : 0;
+    }
+
+    if (known && known * 2 >= frames)
+        return logo < known / 4;
+
+    if (IsStandardLength(length))
+        return true;
+
+    return (frames * 1000.0 / length >= kMinSceneFps) &&
+        (scenes * 1000.0 / length >= m_settings.commSceneRate);
+}
+
+/** \brief The commercial breaks found so far, as the frame numbers of
+ *         their MARK_COMM_START and MARK_COMM_END marks at fps.
+ */
+frm_dir_map_t LiveCommAnalyzer::GetBreaks(double fps) const
+{
+    frm_dir_map_t breaks;
+    if (m_frames.size() < 2 || fps <= 0.0)
+        return breaks;
+
+    // Cut the recording in the middle of each run of blank frames
+    vector<uint> bounds;
+    bounds.push_back(0);
+    for (uint i = 0; i < m_frames.size(); ++i)
+    {
+        if (!(m_frames[i].flags & kBlank))
+            continue;
+
+        uint last = i;
+        while (last + 1 < m_frames.size() &&
+               (m_frames[last + 1].flags & kBlank))
+            last++;
+
+        uint cut = (i + last) / 2;
+        if (m_frames[cut].ms - m_frames[bounds.back()].ms >=
+            kMinSegmentLength &&
+            m_frames.back().ms - m_frames[cut].ms >= kMinSegmentLength)
+            bounds.push_back(cut);
+        i = last;
+    }
+    bounds.push_back(m_frames.size() - 1);
+
+    // Join the commercials next to each other into breaks
+    vector< pair<int64_t,int64_t> > found;
+    int64_t start = -1, end = -1;
+    for (uint i = 0; i + 1 < bounds.size(); ++i)
+    {
+        int64_t from = m_frames[bounds[i]].ms;
+        int64_t to   = m_frames[bounds[i + 1]].ms;
+        if (IsCommercial(bounds[i], bounds[i + 1], to - from))
+        {
+            if (start < 0)
+                start = from;
+            end = to;
+        }
+        else if (start >= 0)
+        {
+            found.push_back(pair<int64_t,int64_t>(start, end));
+            start = -1;
+        }
+    }
+    if (start >= 0)
+        found.push_back(pair<int64_t,int64_t>(start, end));
+
+    int64_t first = m_frames.front().ms;
+    int64_t last  = m_frames.back().ms;
+    for (uint i = 0; i < found.size(); ++i)
+    {
+        start = found[i].first;
+        end   = found[i].second;
+
+        bool atStart = (start - first) <= kEdgeSlack;
+        bool atEnd   = (last - end) <= kEdgeSlack;
+        if (atStart)
+            start = first;
+        if (atEnd)
+            end = last;
+
+        int64_t length = end - start;
+        if (length > m_settings.maxBreakLength * 1000LL)
+            continue;
+        if (length < m_settings.minBreakLength * 1000LL &&
+            !atStart && !atEnd)
+            continue;
+
+        breaks[(uint64_t) llround(start * fps / 1000.0)] = MARK_COMM_START;
+        breaks[(uint64_t) llround(end   * fps / 1000.0)] = MARK_COMM_END;
+    }
+
+    return breaks;
+}
+
+/// How long the worker has in milliseconds to catch up after Finish()
+static const ulong kFinishTimeout = 30 * 1000;
+/// Frames that must have been analyzed to save the breaks
+static const uint64_t kMinFrames = 1000;
+/// Part of the PES packets that may have been dropped to save the breaks
+static const uint kMaxDroppedPercent = 5;
+/// Part of the recording that must have been analyzed to save the breaks
+static const uint kMinCoveredPercent = 95;
+/// The longest the worker sleeps at a time, in microseconds
+static const int64_t kMaxSleep = 200 * 1000;
+
+static inline int64_t read_timestamp(const uint8_t *p)
+{
+    return ((int64_t)(p[0] & 0x0e) << 29) | ((int64_t)p[1] << 22) |
+        ((int64_t)(p[2] & 0xfe) << 14) | ((int64_t)p[3] << 7) |
+        ((int64_t)p[4] >> 1);
+}
+
+LiveCommDetector::LiveCommDetector(
+    const ProgramInfo &pginfo, uint videoPID, AVCodecID codec,
+    uint cpuPercent, const LiveCommAnalyzer::Settings &settings) :
+    MThread("LiveCommDetector"),
+    m_pginfo(pginfo),       m_videoPID(videoPID),
+    m_codecID(codec),       m_cpuPercent(max(1U, min(cpuPercent, 100U))),
+    m_lastCC(-1),           m_pesBroken(true),
+    m_queueSize(0),         m_discontinuity(false),
+    m_replacesJob(false),
+    m_finishing(false),     m_durationMs(0),
+    m_abort(false),
+    m_queued(0),            m_dropped(0),
+    m_context(NULL),        m_parser(NULL),
+    m_frame(NULL),          m_waitForKeyframe(true),
+    m_firstPTS(AV_NOPTS_VALUE), m_lastPTS(AV_NOPTS_VALUE),
+    m_ptsOffset(0),         m_fps(0.0),
+    m_sleepDebt(0),         m_decodeErrors(0),
+    m_analyzer(settings)
+{
+}
+
+QMutex        LiveCommDetector::s_activeLock;
+QSet<QString> LiveCommDetector::s_active;
+
+/// Deletes a LiveCommDetector once its worker is done
+class LiveCommDetectorReaper : public QRunnable
+{
+  public:
+    explicit LiveCommDetectorReaper(LiveCommDetector *detector) :
+        m_detector(detector) {}
+    void run(void) { delete m_detector; }
+
+  private:
+    LiveCommDetector *m_detector;
+};
+
+/// Waits for a worker given to Finish(), stops any other
+LiveCommDetector::~LiveCommDetector()
+{
+    {
+        QMutexLocker locker(&m_lock);
+        if (!m_finishing)
+            m_abort = true;
+        m_wait.wakeAll();
+    }
+    wait();
+}
+
+/// The video codecs that can be decoded cheaply enough
+bool LiveCommDetector::IsSupported(AVCodecID codec)
+{
+    return (codec == AV_CODEC_ID_MPEG1VIDEO ||
+            codec == AV_CODEC_ID_MPEG2VIDEO ||
+            codec == AV_CODEC_ID_H264);
+}
+
+void LiveCommDetector::Start(void)
+{
+    {
+        QMutexLocker locker(&s_activeLock);
+        s_active.insert(m_pginfo.MakeUniqueKey());
+    }
+
+    LOG(VB_COMMFLAG, LOG_INFO, LOC +
+        QString("Flagging commercials of PID 0x%1 using %2% of a CPU")
+        .arg(m_videoPID, 0, 16).arg(m_cpuPercent));
+    start(QThread::LowPriority);
+}
+
+/// True from Start() until the worker has saved the breaks of pginfo,
+/// or queued the flagging job for it
+bool LiveCommDetector::IsActive(const ProgramInfo &pginfo)
+{
+    QMutexLocker locker(&s_activeLock);
+    return s_active.contains(pginfo.MakeUniqueKey());
+}
+
+void LiveCommDetector::SetReplacesJob(bool replaces)
+{
+    QMutexLocker locker(&m_lock);
+    m_replacesJob = replaces;
+}
+
+bool LiveCommDetector::GetReplacesJob(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_replacesJob;
+}
+
+uint64_t LiveCommDetector::GetQueuedCount(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_queued;
+}
+
+uint64_t LiveCommDetector::GetDroppedCount(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_dropped;
+}
+
+/// Bytes of PES packets waiting for the worker
+uint64_t LiveCommDetector::GetQueueSize(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_queueSize;
+}
+
+void LiveCommDetector::ProcessVideoTSPackets(const TSPacket *tspackets,
+                                             uint count)
+{
+    for (uint i = 0; i < count; ++i)
+        LiveCommDetector::ProcessVideoTSPacket(tspackets[i]);
+}
+
+/** \brief Adds the payload of a packet of the video stream to the PES
+ *         packet it is part of, and queues that packet once the next
+ *         one starts.
+ *
+ *  This is called by the recorder's thread, and never waits on the
+ *  worker. A PES packet with a packet of it missing is dropped.
+ */
+bool LiveCommDetector::ProcessVideoTSPacket(const TSPacket &tspacket)
+{
+    if (tspacket.PID() != m_videoPID || tspacket.TransportError() ||
+        tspacket.Scrambled() || !tspacket.HasPayload())
+        return true;
+
+    int cc = tspacket.ContinuityCounter();
+    if (cc == m_lastCC)
+        return true; // a duplicate packet
+    if (m_lastCC >= 0 && cc != ((m_lastCC + 1) & 0xf))
+        m_pesBroken = true;
+    m_lastCC = cc;
+
+    if (tspacket.PayloadStart())
+    {
+        QueuePES();
+        m_pesBroken = false;
+    }
+
+    if (m_pesBroken)
+        return true;
+
+    uint offset = tspacket.AFCOffset();
+    if (offset >= TSPacket::kSize ||
+        m_pes.size() + TSPacket::kSize - offset > kMaxPESSize)
+    {
+        m_pesBroken = true;
+        return true;
+    }
+
+    m_pes.append((const char*) tspacket.data() + offset,
+                 TSPacket::kSize - offset);
+    return true;
+}
+
+void LiveCommDetector::QueuePES(void)
+{
+    QMutexLocker locker(&m_lock);
+
+    if (m_abort)
+    {
+        m_pes.clear();
+        return;
+    }
+
+    if (m_pesBroken || m_queueSize + m_pes.size() > kMaxQueueSize)
+    {
+        if (!m_pes.isEmpty())
+            m_dropped++;
+        m_discontinuity = true;
+    }
+    else if (!m_pes.isEmpty())
+    {
+        Unit unit;
+        unit.pes = m_pes;
+        unit.discontinuity = m_discontinuity;
+        m_discontinuity = false;
+
+        if (m_queue.isEmpty())
+            m_wait.wakeAll();
+        m_queue.enqueue(unit);
+        m_queueSize += m_pes.size();
+        m_queued++;
+    }
+
+    m_pes.clear();
+}
+
+/** \brief Lets the worker of detector analyze what is queued and save
+ *         the commercial breaks, then deletes detector.
+ *
+ *  Returns at once, the recorder's thread never waits for the worker.
+ *
+ *  \param durationMs how long the recording is, the breaks are only
+ *                    saved if nearly all of it was analyzed
+ */
+void LiveCommDetector::Finish(LiveCommDetector *detector,
+                              uint64_t durationMs)
+{
+    detector->QueuePES();
+
+    {
+        QMutexLocker locker(&detector->m_lock);
+        detector->m_finishing = true;
+        detector->m_durationMs = durationMs;
+        detector->m_finishTimer.start();
+        detector->m_wait.wakeAll();
+    }
+
+    MThreadPool::globalInstance()->start(
+        new LiveCommDetectorReaper(detector), "LiveCommFinish");
+}
+
+/** \brief Saves the commercial breaks, called by the worker once done.
+ *
+ *  \return true if the breaks were saved and the recording marked as
+ *          flagged.
+ */
+bool LiveCommDetector::Save(void)
+{
+    uint64_t queued, dropped, durationMs;
+    {
+        QMutexLocker locker(&m_lock);
+        m_dropped += m_queue.size();
+        m_queued  -= m_queue.size();
+        m_queue.clear();
+        m_queueSize = 0;
+        queued     = m_queued;
+        dropped    = m_dropped;
+        durationMs = m_durationMs;
+    }
+
+    uint64_t frames = m_analyzer.GetFrameCount();
+    LOG(VB_COMMFLAG, LOG_INFO, LOC +
+        QString("Analyzed %1 frames from %2 PES packets, dropped %3, "
+                "%4 decode errors, logo %5")
+        .arg(frames).arg(queued).arg(dropped).arg(m_decodeErrors)
+        .arg(m_analyzer.IsLogoKnown() ? "found" : "not found"));
+
+    if (frames < kMinFrames || m_fps <= 0.0)
+    {
+        LOG(VB_COMMFLAG, LOG_INFO, LOC +
+            "Too few frames analyzed, leaving flagging to the job queue");
+        return false;
+    }
+
+    if (dropped * 100 > (queued + dropped) * kMaxDroppedPercent)
+    {
+        LOG(VB_GENERAL, LOG_WARNING, LOC +
+            QString("Dropped %1 of %2 PES packets, "
+                    "leaving flagging to the job queue")
+            .arg(dropped).arg(queued + dropped));
+        return false;
+    }
+
+    // Packets on a PID the detector was not following are not counted
+    // as dropped, so check how much of the recording was covered too
+    uint64_t analyzedMs = 0;
+    if (m_firstPTS != AV_NOPTS_VALUE && m_lastPTS != AV_NOPTS_VALUE)
+        analyzedMs = (m_lastPTS - m_firstPTS) / 90;
+    if (analyzedMs * 100 < durationMs * kMinCoveredPercent)
+    {
+        LOG(VB_GENERAL, LOG_WARNING, LOC +
+            QString("Analyzed %1 s of a %2 s recording, "
+                    "leaving flagging to the job queue")
+            .arg(analyzedMs / 1000).arg(durationMs / 1000));
+        return false;
+    }
+
+    frm_dir_map_t breaks = m_analyzer.GetBreaks(m_fps);
+    m_pginfo.SaveCommBreakList(breaks);
+    m_pginfo.SaveCommFlagged(COMM_FLAG_DONE);
+
+    LOG(VB_GENERAL, LOG_INFO, LOC +
+        QString("Found %1 commercial breaks while recording")
+        .arg(breaks.size() / 2));
+    return true;
+}
+
+/** \brief Takes over the flagging job queued for the recording, the
+ *         worker calls this so the recorder never waits on the database.
+ *
+ *  \return false if the job is already running, nothing is flagged
+ *          here then
+ */
+bool LiveCommDetector::ClaimJob(void)
+{
+    int jobID = JobQueue::GetJobID(JOB_COMMFLAG, m_pginfo.GetChanID(),
+                                   m_pginfo.GetRecordingStartTime());
+    if (jobID < 0)
+        return true;
+
+    int status = JobQueue::GetJobStatus(jobID);
+    if (JobQueue::IsJobStatusRunning(status))
+    {
+        LOG(VB_COMMFLAG, LOG_INFO, LOC +
+            "A flagging job is already running for this recording");
+        return false;
+    }
+
+    if (JobQueue::IsJobStatusQueued(status) && JobQueue::DeleteJob(jobID))
+    {
+        QMutexLocker locker(&m_lock);
+        m_replacesJob = true;
+    }
+
+    return true;
+}
+
+/// Queues the flagging job TVRec left to us
+void LiveCommDetector::QueueFlaggingJob(void)
+{
+    QString host;
+    if (gCoreContext->GetNumSetting("JobsRunOnRecordHost", 0))
+        host = gCoreContext->GetHostName();
+
+    if (!JobQueue::QueueJob(JOB_COMMFLAG, m_pginfo.GetChanID(),
+                            m_pginfo.GetRecordingStartTime(), "", "", host))
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC + "Could not queue the flagging job");
+    }
+}
+
+void LiveCommDetector::run(void)
+{
+    RunProlog();
+
+    bool claimed = GetReplacesJob() || ClaimJob();
+    bool ok = claimed && OpenDecoder();
+
+    QMutexLocker locker(&m_lock);
+    if (!ok)
+    {
+        // stop queueing, Finish() finds nothing was analyzed
+        m_abort = true;
+        m_queue.clear();
+        m_queueSize = 0;
+    }
+
+    while (!m_abort)
+    {
+        if (m_finishing && m_finishTimer.elapsed() > (qint64)kFinishTimeout)
+        {
+            LOG(VB_GENERAL, LOG_WARNING, LOC +
+                "Analysis did not catch up with the recording, giving up");
+            break;
+        }
+
+        if (m_queue.isEmpty())
+        {
+            if (m_finishing)
+                break;
+            // waiting counts as sleeping
+            QElapsedTimer waited;
+            waited.start();
+            m_wait.wait(&m_lock);
+            m_sleepDebt = max((int64_t)0,
+                              m_sleepDebt - waited.nsecsElapsed() / 1000);
+            continue;
+        }
+
+        // keep to our share of the CPU, unless the recording has ended
+        if (m_sleepDebt > 0 && !m_finishing)
+        {
+            QElapsedTimer slept;
+            slept.start();
+            m_wait.wait(&m_lock, max((int64_t)1, m_sleepDebt / 1000));
+            m_sleepDebt -= slept.nsecsElapsed() / 1000;
+            continue;
+        }
+
+        Unit unit = m_queue.dequeue();
+        m_queueSize -= unit.pes.size();
+        uint64_t queueSize = m_queueSize;
+        locker.unlock();
+
+        SetSkipFrame(queueSize);
+
+        QElapsedTimer timer;
+        timer.start();
+        DecodePES(unit);
+        int64_t work = timer.nsecsElapsed() / 1000;
+        m_sleepDebt = min(kMaxSleep, m_sleepDebt +
+                          work * (100 - m_cpuPercent) / m_cpuPercent);
+
+        locker.relock();
+    }
+
+    bool finishing = m_finishing;
+    locker.unlock();
+    CloseDecoder();
+
+    // Once the detector is active TVRec does not queue the flagging
+    // job, so it is queued here unless the breaks are saved, or the
+    // job was found running.
+    bool saved = finishing && ok && Save();
+    if (claimed && !saved && (finishing || GetReplacesJob()))
+        QueueFlaggingJob();
+
+    {
+        QMutexLocker active_locker(&s_activeLock);
+        s_active.remove(m_pginfo.MakeUniqueKey());
+    }
+
+    RunEpilog();
+}
+
+bool LiveCommDetector::OpenDecoder(void)
+{
+    QMutexLocker locker(avcodeclock);
+    avcodec_register_all();
+
+    AVCodec *codec = avcodec_find_decoder(m_codecID);
+    if (!codec)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("No decoder for %1").arg(ff_codec_id_string(m_codecID)));
+        return false;
+    }
+
+    m_context = avcodec_alloc_context3(codec);
+    m_parser  = av_parser_init(m_codecID);
+    m_frame   = av_frame_alloc();
+    if (!m_context || !m_parser || !m_frame)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC + "Could not allocate the decoder");
+        return false;
+    }
+
+    // decode what is needed and no more, in this thread only
+    m_context->thread_count     = 1;
+    m_context->lowres           = min(1, av_codec_get_max_lowres(codec));
+    m_context->flags2          |= AV_CODEC_FLAG2_FAST;
+    m_context->skip_loop_filter = AVDISCARD_ALL;
+    av_codec_set_pkt_timebase(m_context, av_make_q(1, 90000));
+
+    if (avcodec_open2(m_context, codec, NULL) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Could not open the %1 decoder")
+            .arg(ff_codec_id_string(m_codecID)));
+        return false;
+    }
+
+    return true;
+}
+
+void LiveCommDetector::CloseDecoder(void)
+{
+    if (m_parser)
+    {
+        av_parser_close(m_parser);
+        m_parser = NULL;
+    }
+
+    if (m_context)
+    {
+        QMutexLocker locker(avcodeclock);
+        avcodec_close(m_context);
+        avcodec_free_context(&m_context);
+    }
+
+    if (m_frame)
+        av_frame_free(&m_frame);
+}
+
+/** \brief Decodes fewer frames the further behind the worker is, first
+ *         only the reference frames then only the keyframes.
+ */
+void LiveCommDetector::SetSkipFrame(uint64_t queued)
+{
+    AVDiscard skip = AVDISCARD_DEFAULT;
+    if (queued > kMaxQueueSize / 2)
+        skip = AVDISCARD_NONKEY;
+    else if (queued > kMaxQueueSize / 8)
+        skip = AVDISCARD_NONREF;
+
+    if (skip == m_context->skip_frame)
+        return;
+
+    LOG(VB_COMMFLAG, LOG_DEBUG, LOC +
+        QString("%1 KB behind, decoding %2 frames")
+        .arg(queued / 1024)
+        .arg((skip == AVDISCARD_DEFAULT) ? "all" :
+             (skip == AVDISCARD_NONREF) ? "reference" : "key"));
+    m_context->skip_frame = skip;
+}
+
+void LiveCommDetector::DecodePES(const Unit &unit)
+{
+    if (unit.discontinuity)
+    {
+        // a PES packet was lost, start again from a keyframe
+        avcodec_flush_buffers(m_context);
+        av_parser_close(m_parser);
+        m_parser = av_parser_init(m_codecID);
+        m_waitForKeyframe = true;
+    }
+
+    const uint8_t *pes = (const uint8_t*) unit.pes.constData();
+    int size = unit.pes.size();
+    if (size < 9 || pes[0] || pes[1] || pes[2] != 0x01)
+        return;
+
+    int header = 9 + pes[8];
+    if (header > size)
+        return;
+
+    int64_t pts = AV_NOPTS_VALUE, dts = AV_NOPTS_VALUE;
+    if ((pes[7] & 0x80) && header >= 14)
+        pts = read_timestamp(pes + 9);
+    if ((pes[7] & 0x40) && header >= 19)
+        dts = read_timestamp(pes + 14);
+
+    const uint8_t *buf = pes + header;
+    int len = size - header;
+    while (len > 0)
+    {
+        uint8_t *data = NULL;
+        int dataSize = 0;
+        int used = av_parser_parse2(m_parser, m_context, &data, &dataSize,
+                                    buf, len, pts, dts, 0);
+        if (used <= 0 && dataSize <= 0)
+            break;
+
+        buf += max(used, 0);
+        len -= max(used, 0);
+        pts = dts = AV_NOPTS_VALUE;
+
+        if (dataSize > 0)
+            DecodePacket(data, dataSize, m_parser->pts, m_parser->dts);
+    }
+}
+
+void LiveCommDetector::DecodePacket(uint8_t *data, int size,
+                                    int64_t pts, int64_t dts)
+{
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = data;
+    packet.size = size;
+    packet.pts  = pts;
+    packet.dts  = dts;
+
+    int gotPicture = 0;
+    if (avcodec_decode_video2(m_context, m_frame, &gotPicture, &packet) < 0)
+    {
+        m_decodeErrors++;
+        return;
+    }
+    if (!gotPicture)
+        return;
+
+    if (m_waitForKeyframe)
+    {
+        if (!m_frame->key_frame && m_frame->pict_type != AV_PICTURE_TYPE_I)
+            return;
+        m_waitForKeyframe = false;
+    }
+
+    int64_t ts = av_frame_get_best_effort_timestamp(m_frame);
+    if (ts == AV_NOPTS_VALUE)
+        return;
+
+    // the 33 bit timestamps wrap around about every 26 hours
+    ts += m_ptsOffset;
+    if (m_lastPTS != AV_NOPTS_VALUE && ts < m_lastPTS - (1LL << 32))
+    {
+        m_ptsOffset += 1LL << 33;
+        ts += 1LL << 33;
+    }
+    else if (m_lastPTS != AV_NOPTS_VALUE && ts > m_lastPTS + (1LL << 32))
+    {
+        // a frame from just before the last wrap around
+        ts -= 1LL << 33;
+    }
+    if (m_lastPTS == AV_NOPTS_VALUE || ts > m_lastPTS)
+        m_lastPTS = ts;
+
+    if (m_firstPTS == AV_NOPTS_VALUE)
+        m_firstPTS = ts;
+
+    if (m_fps <= 0.0)
+    {
+        if (m_context->framerate.num > 0 && m_context->framerate.den > 0)
+            m_fps = av_q2d(m_context->framerate);
+        else if (m_context->time_base.num > 0)
+            m_fps = 1.0 / (av_q2d(m_context->time_base) *
+                           max(1, m_context->ticks_per_frame));
+    }
+
+    m_analyzer.AddFrame(m_frame->data[0], m_frame->linesize[0],
+                        m_frame->width, m_frame->height,
+                        (ts - m_firstPTS) / 90);
+}
@@ -0,0 +1,244 @@
+// -*- Mode: c++ -*-
+
+#ifndef _LIVE_COMM_DETECTOR_H_
+#define _LIVE_COMM_DETECTOR_H_
+
+#include <stdint.h>
+
+#include <vector>
+using namespace std;
+
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+
+#include "mythtvexp.h"
+#include "mthread.h"
+#include "programinfo.h"
+#include "programtypes.h"
+#include "streamlisteners.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+/** \class LiveCommAnalyzer
+ *  \brief Finds commercial breaks from the luma of the frames of a
+ *         recording, given one frame at a time in display order.
+ *
+ *  Each frame is tested for being blank, for being a scene change and,
+ *  once a station logo has been learned from the first minutes of the
+ *  recording, for showing the logo. Only these flags and the time of
+ *  the frame are kept, so the frames can be dropped as soon as they
+ *  are given. GetBreaks() splits the recording at the blank frames and
+ *  joins the parts that look like commercials into breaks, with the
+ *  same limits on their length as the classic commercial detector.
+ */
+class MTV_PUBLIC LiveCommAnalyzer
+{
+  public:
+    class Settings
+    {
+      public:
+        Settings();
+        void Load(void);
+
+        int    blankMaxDiff;      ///< max luma range of a blank frame
+        int    blankMaxBrightness;
+        double sceneThreshold;    ///< histogram similarity of a new scene
+        double commSceneRate;     ///< scene changes a second of a commercial
+        int    minBreakLength;    ///< in seconds
+        int    maxBreakLength;    ///< in seconds
+        int    maxCommLength;     ///< in seconds
+        int    logoSamples;       ///< frames the logo is learned from
+        int    logoSampleSpacing; ///< in seconds
+        double logoGoodEdges;     ///< part of the logo edges of a logo frame
+    };
+
+    /// The flags kept for each frame
+    enum
+    {
+        kBlank       = 0x01,
+        kSceneChange = 0x02,
+        kLogo        = 0x04,
+        kLogoKnown   = 0x08,
+    };
+
+    explicit LiveCommAnalyzer(const Settings &settings = Settings());
+
+    void AddFrame(const uint8_t *luma, int pitch, int width, int height,
+                  int64_t ms);
+    frm_dir_map_t GetBreaks(double fps) const;
+
+    uint64_t GetFrameCount(void) const { return m_frames.size(); }
+    bool IsLogoKnown(void) const { return m_logoKnown; }
+    /// The flags of frame i
+    uint GetFlags(uint i) const { return m_frames[i].flags; }
+
+  private:
+    typedef struct
+    {
+        int64_t ms;
+        uint8_t flags;
+    } Frame;
+
+    void Resize(int width, int height);
+    bool IsBlank(const uint8_t *luma, int pitch);
+    bool IsSceneChange(const uint8_t *luma, int pitch);
+    void LearnLogo(const uint8_t *luma, int pitch, int64_t ms);
+    bool BuildLogoMask(int diff, const vector<uint16_t> &counts);
+    bool HasLogo(const uint8_t *luma, int pitch);
+    bool IsCommercial(uint first, uint end, int64_t length) const;
+    bool IsStandardLength(int64_t length) const;
+
+    Settings              m_settings;
+    vector<Frame>         m_frames;
+
+    int                   m_width;
+    int                   m_height;
+    int                   m_border;
+    vector<uint8_t>       m_all;       ///< a row mask of 0xff
+    vector<uint8_t>       m_colmax;
+    vector<uint8_t>       m_pixels;
+    vector<int>           m_histogram;
+    vector<int>           m_lastHistogram;
+    bool                  m_lastSceneChange;
+
+    // the logo
+    vector< vector<uint16_t> > m_edgeCounts; ///< one a kLogoEdgeDiffs entry
+    int                   m_logoSamples;
+    int64_t               m_lastLogoSample;
+    bool                  m_logoKnown;
+    int                   m_logoEdgeDiff;
+    vector<uint8_t>       m_logoMask;  ///< 0xff on the logo edges
+    uint                  m_logoPixels;
+    int                   m_logoMinX, m_logoMaxX;
+    int                   m_logoMinY, m_logoMaxY;
+    vector<uint8_t>       m_edgeFlags;
+
+    static const int      kEdgeRadius = 2;
+    static const int      kLogoEdgeDiffs[];
+};
+
+/** \class LiveCommDetector
+ *  \brief Flags the commercials of a recording while it is recorded,
+ *         from the video packets DTVRecorder gets.
+ *
+ *  The recorder's thread only copies the PES packets of the video
+ *  stream into a queue, it never waits. A worker thread decodes them at
+ *  reduced cost, at low resolution with the loop filter skipped, and
+ *  gives the frames to a LiveCommAnalyzer. The worker uses no more
+ *  than its share of a CPU core, sleeping between packets as needed.
+ *  When it still falls behind it decodes fewer frames, first only the
+ *  reference frames then only the keyframes, and once the queue is
+ *  full whole packets are dropped.
+ *
+ *  Before it decodes anything the worker takes over a flagging job
+ *  queued for the recording, or stops if one is already running.
+ *  Finish() is called when the recording ends and returns at once.
+ *  The worker empties the queue at full speed, saves the breaks and
+ *  marks the recording as flagged, unless too much of it was dropped
+ *  or missed. Then it queues the usual flagging job instead. TVRec
+ *  leaves the flagging job of a recording to the detector while
+ *  IsActive().
+ */
+class MTV_PUBLIC LiveCommDetector : public TSPacketListenerAV,
+                                    protected MThread
+{
+  public:
+    LiveCommDetector(const ProgramInfo &pginfo, uint videoPID,
+                     AVCodecID codec, uint cpuPercent,
+                     const LiveCommAnalyzer::Settings &settings);
+    ~LiveCommDetector();
+
+    void Start(void);
+    static void Finish(LiveCommDetector *detector, uint64_t durationMs);
+
+    /// Queue the flagging job if nothing is saved, even when stopped
+    void SetReplacesJob(bool replaces);
+    bool GetReplacesJob(void) const;
+
+    uint GetVideoPID(void) const { return m_videoPID; }
+    AVCodecID GetCodec(void) const { return m_codecID; }
+
+    uint64_t GetQueuedCount(void) const;
+    uint64_t GetDroppedCount(void) const;
+    uint64_t GetQueueSize(void) const;
+
+    static bool IsSupported(AVCodecID codec);
+    static bool IsActive(const ProgramInfo &pginfo);
+
+    // TSPacketListenerAV
+    bool ProcessVideoTSPacket(const TSPacket &tspacket);
+    bool ProcessAudioTSPacket(const TSPacket&) { return true; }
+    void ProcessVideoTSPackets(const TSPacket *tspackets, uint count);
+
+    /// bytes of PES packets the worker may be behind
+    static const uint kMaxQueueSize = 8 * 1024 * 1024;
+    /// bytes of a single PES packet
+    static const uint kMaxPESSize = 4 * 1024 * 1024;
+
+  protected:
+    void run(void);
+
+  private:
+    typedef struct
+    {
+        QByteArray pes;
+        bool       discontinuity;
+    } Unit;
+
+    bool ClaimJob(void);
+    bool Save(void);
+    void QueueFlaggingJob(void);
+    void QueuePES(void);
+    bool OpenDecoder(void);
+    void CloseDecoder(void);
+    void SetSkipFrame(uint64_t queued);
+    void DecodePES(const Unit &unit);
+    void DecodePacket(uint8_t *data, int size, int64_t pts, int64_t dts);
+
+    ProgramInfo           m_pginfo;
+    uint                  m_videoPID;
+    AVCodecID             m_codecID;
+    uint                  m_cpuPercent;
+
+    // used by the recorder's thread only
+    QByteArray            m_pes;
+    int                   m_lastCC;
+    bool                  m_pesBroken;
+
+    mutable QMutex        m_lock;
+    QWaitCondition        m_wait;
+    QQueue<Unit>          m_queue;
+    uint64_t              m_queueSize;
+    bool                  m_discontinuity;
+    bool                  m_replacesJob;
+    bool                  m_finishing;
+    QElapsedTimer         m_finishTimer;
+    uint64_t              m_durationMs; ///< of the recording, from Finish()
+    bool                  m_abort;
+    uint64_t              m_queued;
+    uint64_t              m_dropped;
+
+    // used by the worker only
+    AVCodecContext       *m_context;
+    AVCodecParserContext *m_parser;
+    AVFrame              *m_frame;
+    bool                  m_waitForKeyframe;
+    int64_t               m_firstPTS;
+    int64_t               m_lastPTS;
+    int64_t               m_ptsOffset;
+    double                m_fps;
+    int64_t               m_sleepDebt; ///< in microseconds
+    uint64_t              m_decodeErrors;
+    LiveCommAnalyzer      m_analyzer;
+
+    static QMutex         s_activeLock;
+    static QSet<QString>  s_active; ///< ProgramInfo::MakeUniqueKey()
+};
+
+#endif // _LIVE_COMM_DETECTOR_H_
@@ -0,0 +1,138 @@
+// -*- Mode: c++ -*-
+
+#include <algorithm>
+using namespace std;
+
+#include "packetring.h"
+#include "mythlogging.h"
+
+#define LOC QString("PacketRing: ")
+
+PacketRing::PacketRing(uint size) :
+    m_blocks(max(size, 2U)), m_head(0)
+{
+}
+
+PacketRing::~PacketRing()
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_cursors.empty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("dtor & %1 cursors still attached").arg(m_cursors.size()));
+    }
+    for (uint i = 0; i < m_cursors.size(); ++i)
+        delete m_cursors[i];
+}
+
+/** \brief Attaches a new consumer.
+ *
+ *  The consumer starts with the next block published, it does not
+ *  see data that was pushed before it was attached.
+ */
+PacketRingCursor *PacketRing::AddCursor(const QString &name)
+{
+    QMutexLocker locker(&m_lock);
+    PacketRingCursor *cursor = new PacketRingCursor(name);
+    cursor->m_next = m_head;
+    m_cursors.push_back(cursor);
+    return cursor;
+}
+
+void PacketRing::RemoveCursor(PacketRingCursor *cursor)
+{
+    QMutexLocker locker(&m_lock);
+    vector<PacketRingCursor*>::iterator it =
+        find(m_cursors.begin(), m_cursors.end(), cursor);
+    if (it == m_cursors.end())
+        return;
+
+    LOG(VB_RECORD, cursor->m_overruns ? LOG_WARNING : LOG_INFO, LOC +
+        QString("%1 read %2 blocks (%3 KB), %4 overruns dropped %5 blocks, "
+                "max lag %6 blocks")
+            .arg(cursor->m_name).arg(cursor->m_blocks_read)
+            .arg(cursor->m_bytes_read >> 10).arg(cursor->m_overruns)
+            .arg(cursor->m_blocks_dropped).arg(cursor->m_max_lag));
+
+    m_cursors.erase(it);
+    delete cursor;
+}
+
+/// Publishes a block to all consumers, never blocks on a consumer.
+void PacketRing::Push(const QByteArray &block)
+{
+    if (block.isEmpty())
+        return;
+
+    QMutexLocker locker(&m_lock);
+    // Overwriting releases our reference to the oldest block, consumers
+    // that still hold it keep their own reference.
+    m_blocks[m_head % m_blocks.size()] = block;
+    m_head++;
+    m_wait.wakeAll();
+}
+
+/** \brief Returns the next block for this cursor.
+ *
+ *  Waits up to timeout_ms for a block to be published.
+ *  \return false if no block was available.
+ */
+bool PacketRing::Pop(PacketRingCursor *cursor, QByteArray &block,
+                     ulong timeout_ms)
+{
+    QMutexLocker locker(&m_lock);
+
+    if (cursor->m_next == m_head && timeout_ms)
+        m_wait.wait(&m_lock, timeout_ms);
+
+    if (cursor->m_next == m_head)
+        return false;
+
+    uint64_t oldest = (m_head > m_blocks.size()) ?
+        m_head - m_blocks.size() : 0;
+    if (cursor->m_next < oldest)
+    {
+        // The cursor is left at the oldest block, so it has to fall a
+        // whole ring behind again before this is logged the next time.
+        uint64_t dropped = oldest - cursor->m_next;
+        cursor->m_overruns++;
+        cursor->m_blocks_dropped += dropped;
+        LOG(VB_RECORD, LOG_WARNING, LOC +
+            QString("%1 fell behind, dropping %2 blocks (overrun %3)")
+                .arg(cursor->m_name).arg(dropped).arg(cursor->m_overruns));
+        cursor->m_next = oldest;
+    }
+
+    cursor->m_lag = m_head - cursor->m_next - 1;
+    cursor->m_max_lag = max(cursor->m_max_lag, cursor->m_lag);
+
+    block = m_blocks[cursor->m_next % m_blocks.size()];
+    cursor->m_next++;
+    cursor->m_blocks_read++;
+    cursor->m_bytes_read += block.size();
+
+    return true;
+}
+
+void PacketRing::WakeAll(void)
+{
+    QMutexLocker locker(&m_lock);
+    m_wait.wakeAll();
+}
+
+/// Returns one line per consumer with its lag counters
+QString PacketRing::GetLagStats(void) const
+{
+    QMutexLocker locker(&m_lock);
+    QString msg;
+    for (uint i = 0; i < m_cursors.size(); ++i)
+    {
+        const PacketRingCursor *c = m_cursors[i];
+        msg += QString("%1: read %2 blocks (%3 KB), overruns %4, "
+                       "dropped %5, lag %6, max lag %7\n")
+            .arg(c->m_name).arg(c->m_blocks_read)
+            .arg(c->m_bytes_read >> 10).arg(c->m_overruns)
+            .arg(c->m_blocks_dropped).arg(c->m_lag).arg(c->m_max_lag);
+    }
+    return msg;
+}
@@ -0,0 +1,88 @@
+// -*- Mode: c++ -*-
+
+#ifndef _PACKET_RING_H_
+#define _PACKET_RING_H_
+
+#include <stdint.h>
+
+#include <vector>
+using namespace std;
+
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QString>
+#include <QMutex>
+
+/** \class PacketRingCursor
+ *  \brief Read position and lag counters of one PacketRing consumer.
+ */
+class PacketRingCursor
+{
+    friend class PacketRing;
+  public:
+    explicit PacketRingCursor(const QString &name) :
+        m_name(name), m_next(0),
+        m_blocks_read(0), m_blocks_dropped(0), m_bytes_read(0),
+        m_overruns(0), m_max_lag(0), m_lag(0) {}
+
+    QString  Name(void)          const { return m_name;           }
+    uint64_t BlocksRead(void)    const { return m_blocks_read;    }
+    uint64_t BlocksDropped(void) const { return m_blocks_dropped; }
+    uint64_t BytesRead(void)     const { return m_bytes_read;     }
+    /// Times this cursor fell more than the ring size behind
+    uint64_t Overruns(void)      const { return m_overruns;       }
+    /// Blocks published but not yet read when this cursor last read
+    uint     Lag(void)           const { return m_lag;            }
+    uint     MaxLag(void)        const { return m_max_lag;        }
+
+  private:
+    QString  m_name;
+    uint64_t m_next;            ///< sequence number of next block to read
+    uint64_t m_blocks_read;
+    uint64_t m_blocks_dropped;
+    uint64_t m_bytes_read;
+    uint64_t m_overruns;
+    uint     m_max_lag;
+    uint     m_lag;
+};
+
+/** \class PacketRing
+ *  \brief Single producer, multiple consumer ring of reference counted
+ *         blocks of TS data.
+ *
+ *  The producer publishes each block it reads exactly once. Every
+ *  consumer reads it through its own PacketRingCursor and gets an
+ *  implicitly shared, read only QByteArray, so the data is never copied
+ *  per consumer. The producer never waits on a consumer; a consumer
+ *  that falls more than the ring size behind skips the oldest blocks,
+ *  which is logged and counted against its cursor as an overrun. The
+ *  counters of each cursor are logged when it is removed.
+ */
+class PacketRing
+{
+  public:
+    explicit PacketRing(uint size = kDefaultSize);
+    ~PacketRing();
+
+    PacketRingCursor *AddCursor(const QString &name);
+    void RemoveCursor(PacketRingCursor *cursor);
+
+    void Push(const QByteArray &block);
+    bool Pop(PacketRingCursor *cursor, QByteArray &block, ulong timeout_ms);
+
+    /// Wakes all consumers waiting in Pop()
+    void WakeAll(void);
+
+    QString GetLagStats(void) const;
+
+    static const uint kDefaultSize = 512;
+
+  private:
+    mutable QMutex            m_lock;
+    QWaitCondition            m_wait;
+    vector<QByteArray>        m_blocks;
+    uint64_t                  m_head;    ///< sequence number of next Push
+    vector<PacketRingCursor*> m_cursors;
+};
+
+#endif // _PACKET_RING_H_
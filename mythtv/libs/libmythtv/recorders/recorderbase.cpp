@@ -32,6 +32,7 @@ using namespace std;
 #include "cardutil.h"
 #include "tv_rec.h"
 #include "mythdate.h"
+#include "seekindex.h"
 #if CONFIG_LIBMP3LAME
 #include "NuppelVideoRecorder.h"
 #endif
@@ -43,6 +44,7 @@ using namespace std;
             .arg(TVREC_CARDNUM).arg(videodevice)
 
 const uint RecorderBase::kTimeOfLatestDataIntervalTarget = 5000;
+const uint RecorderBase::kSeekIndexDBRows = 30;
 
 RecorderBase::RecorderBase(TVRec *rec)
     : tvrec(rec),               ringBuffer(NULL),
@@ -60,8 +62,11 @@ RecorderBase::RecorderBase(TVRec *rec)
       request_recording(false), recording(false),
       nextRingBuffer(NULL),     nextRecording(NULL),
       positionMapType(MARK_GOP_BYFRAME),
+      useSeekIndex(false),      seekIndex(NULL),
+      seekIndexDBRows(0),
       estimatedProgStartMS(0), lastSavedKeyframe(0), lastSavedDuration(0)
 {
+    useSeekIndex = gCoreContext->GetNumSetting("SeekIndexFile", 1);
     ClearStatistics();
     QMutexLocker locker(avcodeclock);
 #if 0
@@ -88,6 +93,7 @@ RecorderBase::~RecorderBase(void)
         delete nextRecording;
         nextRecording = NULL;
     }
+    delete seekIndex;
 }
 
 void RecorderBase::SetRingBuffer(RingBuffer *rbuf)
@@ -585,11 +591,20 @@ bool RecorderBase::GetKeyframeDurations(
  *         is true or there are 30 frames in the map or there are five
  *         frames in the map with less than 30 frames in the non-delta
  *         position map.
+ *
+ *  When the seek index file is in use the delta is appended to it
+ *  about once a second instead, and only the first kSeekIndexDBRows
+ *  entries go to the database so that players can tell the type of
+ *  the map. The whole map is saved to the database once, when the
+ *  recording is finished.
+ *
  *  \param force If true this forces a DB sync.
+ *  \param finished If true this is the final call for the recording.
  */
 void RecorderBase::SavePositionMap(bool force, bool finished)
 {
     bool needToSave = force;
+    bool toIndex = curRecording && useSeekIndex && OpenSeekIndex();
     positionMapLock.lock();
 
     bool has_delta = !positionMapDelta.empty();
@@ -605,9 +620,14 @@ void RecorderBase::SavePositionMap(bool force, bool finished)
     // positionMapDelta and implicitly use the same logic about when
     // to same durationMapDelta.
 
-    if (curRecording && needToSave)
+    // appending to the seek index is cheap, keep it close behind
+    bool needToIndex = toIndex && has_delta &&
+        (!seekIndexTimer.isRunning() || seekIndexTimer.elapsed() >= 1000);
+
+    if (curRecording && (needToSave || needToIndex))
     {
-        positionMapTimer.start();
+        if (needToSave)
+            positionMapTimer.start();
         if (has_delta)
         {
             // copy the delta map because most times we are called it will be in
@@ -619,9 +639,21 @@ void RecorderBase::SavePositionMap(bool force, bool finished)
             durationMapDelta.clear();
             positionMapLock.unlock();
 
-            curRecording->SavePositionMapDelta(deltaCopy, positionMapType);
-            curRecording->SavePositionMapDelta(durationDeltaCopy,
-                                               MARK_DURATION_MS);
+            if (toIndex)
+            {
+                seekIndexTimer.start();
+                QMutexLocker locker(&seekIndexLock);
+                seekIndex->Append(deltaCopy, positionMapType);
+                seekIndex->Append(durationDeltaCopy, MARK_DURATION_MS);
+            }
+
+            if (!toIndex || seekIndexDBRows < kSeekIndexDBRows)
+            {
+                curRecording->SavePositionMapDelta(deltaCopy, positionMapType);
+                curRecording->SavePositionMapDelta(durationDeltaCopy,
+                                                   MARK_DURATION_MS);
+                seekIndexDBRows += deltaCopy.size();
+            }
 
             TryWriteProgStartMark(durationDeltaCopy);
         }
@@ -630,7 +662,7 @@ void RecorderBase::SavePositionMap(bool force, bool finished)
             positionMapLock.unlock();
         }
 
-        if (ringBuffer && !finished) // Finished Recording will update the final size for us
+        if (needToSave && ringBuffer && !finished) // Finished Recording will update the final size for us
         {
             curRecording->SaveFilesize(ringBuffer->GetWritePosition());
         }
@@ -640,6 +672,9 @@ void RecorderBase::SavePositionMap(bool force, bool finished)
         positionMapLock.unlock();
     }
 
+    if (finished && toIndex)
+        FinishSeekIndex();
+
     // Make sure a ringbuffer switch is checked at least every 10
     // seconds.  Otherwise, this check is only performed on keyframes,
     // and if there is a problem with the input we may never see one
@@ -653,6 +688,49 @@ void RecorderBase::SavePositionMap(bool force, bool finished)
     }
 }
 
+/** \brief Makes sure the seek index for the current RingBuffer is open.
+ *  \return false if it could not be created, the database is used then
+ */
+bool RecorderBase::OpenSeekIndex(void)
+{
+    QMutexLocker locker(&seekIndexLock);
+
+    if (!ringBuffer)
+        return false;
+
+    QString filename = SeekIndex::GetFilename(ringBuffer->GetFilename());
+    if (seekIndex && seekIndex->GetFilename() == filename)
+        return seekIndex->IsOpen();
+
+    delete seekIndex;
+    seekIndexDBRows = 0;
+    seekIndex = new SeekIndexWriter(filename);
+    return seekIndex->Open();
+}
+
+/** \brief Bulk saves the whole position and duration maps to the
+ *         database and closes the seek index.
+ *
+ *  The file is left in place, players may still have it mapped.
+ */
+void RecorderBase::FinishSeekIndex(void)
+{
+    positionMapLock.lock();
+    frm_pos_map_t posMap(positionMap);
+    frm_pos_map_t durMap(durationMap);
+    positionMapLock.unlock();
+
+    LOG(VB_RECORD, LOG_INFO, LOC +
+        QString("Saving %1 entry position map from seek index")
+        .arg(posMap.size()));
+
+    curRecording->SavePositionMap(posMap, positionMapType);
+    curRecording->SavePositionMap(durMap, MARK_DURATION_MS);
+
+    QMutexLocker locker(&seekIndexLock);
+    seekIndex->Close();
+}
+
 void RecorderBase::TryWriteProgStartMark(const frm_pos_map_t &durationDeltaCopy)
 {
     // Note: all log strings contain "progstart mark" for searching.
@@ -30,6 +30,7 @@ class RecordingInfo;
 class DVBDBOptions;
 class RecorderBase;
 class ChannelBase;
+class SeekIndexWriter;
 class RingBuffer;
 class TVRec;
 
@@ -294,6 +295,9 @@ class MTV_PUBLIC RecorderBase : public QRunnable
 
     void TryWriteProgStartMark(const frm_pos_map_t &durationDeltaCopy);
 
+    bool OpenSeekIndex(void);
+    void FinishSeekIndex(void);
+
     TVRec         *tvrec;
     RingBuffer    *ringBuffer;
     bool           weMadeBuffer;
@@ -344,6 +348,15 @@ class MTV_PUBLIC RecorderBase : public QRunnable
     frm_pos_map_t  durationMapDelta;
     MythTimer      positionMapTimer;
 
+    // Seek index file support
+    bool             useSeekIndex;
+    QMutex           seekIndexLock;
+    SeekIndexWriter *seekIndex;       // protected by seekIndexLock
+    uint             seekIndexDBRows;
+    MythTimer        seekIndexTimer;
+    /// Position map entries still saved to the DB with a seek index
+    static const uint kSeekIndexDBRows;
+
     // ProgStart mark support
     qint64         estimatedProgStartMS;
     long long      lastSavedKeyframe;
@@ -26,8 +26,11 @@ StreamHandler::StreamHandler(const QString &device) :
     _pid_lock(QMutex::Recursive),
     _open_pid_filters(0),
     _mpts_tfw(NULL),
+    _mpts_listener(NULL),
 
-    _listener_lock(QMutex::Recursive)
+    _listener_lock(QMutex::Recursive),
+    _listener_count(0),
+    _packet_ring(NULL)
 {
 }
 
@@ -47,6 +50,19 @@ StreamHandler::~StreamHandler()
     // This should never be triggered.. just to be safe..
     if (_running)
         Stop();
+
+    RingListenerMap listeners;
+    {
+        QMutexLocker locker2(&_listener_lock);
+        listeners = _ring_listeners;
+        _ring_listeners.clear();
+    }
+    qDeleteAll(listeners);
+
+    delete _mpts_listener;
+    _mpts_listener = NULL;
+    delete _packet_ring;
+    _packet_ring = NULL;
 }
 
 void StreamHandler::AddRecorderId(int id)
@@ -114,7 +130,17 @@ void StreamHandler::AddListener(MPEGStreamData *data,
     else
     {
         _stream_data_list[data] = output_file;
+
+        if (_packet_ring)
+        {
+            StreamListenerThread *listener = new StreamListenerThread(
+                _packet_ring, QString("%1 SD 0x%2").arg(_device)
+                .arg((uint64_t)data,0,16), data);
+            _ring_listeners[data] = listener;
+            listener->Start();
+        }
     }
+    _listener_count.fetchAndStoreRelease(_stream_data_list.size());
 
     _listener_lock.unlock();
 
@@ -151,9 +177,17 @@ void StreamHandler::RemoveListener(MPEGStreamData *data)
             RemoveNamedOutputFile(*it);
         _stream_data_list.erase(it);
     }
+    _listener_count.fetchAndStoreRelease(_stream_data_list.size());
+
+    // The listener thread is joined after _listener_lock is released,
+    // so the handler thread is not held up while it finishes a block.
+    StreamListenerThread *listener = _ring_listeners.take(data);
 
     _listener_lock.unlock();
 
+    // Once this returns the listener no longer sees any data
+    delete listener;
+
     if (_stream_data_list.empty())
         Stop();
 
@@ -309,6 +343,7 @@ void StreamHandler::UpdateListeningForEIT(void)
     for (; it != _stream_data_list.end(); ++it)
     {
         MPEGStreamData *sd = it.key();
+        QMutexLocker data_locker(GetListenerDataLock(sd));
         if (sd->HasEITPIDChanges(_eit_pids) &&
             sd->GetEITPIDChanges(_eit_pids, add_eit, del_eit))
         {
@@ -340,9 +375,14 @@ bool StreamHandler::UpdateFiltersFromStreamData(void)
         QMutexLocker read_locker(&_listener_lock);
         StreamDataList::const_iterator it = _stream_data_list.begin();
         for (; it != _stream_data_list.end(); ++it)
+        {
+            QMutexLocker data_locker(GetListenerDataLock(it.key()));
             it.key()->GetPIDs(pids);
+        }
     }
 
+    LogListenerLag();
+
     QMap<uint, PIDInfo*> add_pids;
     vector<uint>         del_pids;
 
@@ -396,14 +436,49 @@ PIDPriority StreamHandler::GetPIDPriority(uint pid) const
 
     StreamDataList::const_iterator it = _stream_data_list.begin();
     for (; it != _stream_data_list.end(); ++it)
+    {
+        QMutexLocker data_locker(GetListenerDataLock(it.key()));
         tmp = max(tmp, it.key()->GetPIDPriority(pid));
+    }
 
     return tmp;
 }
 
+/// Returns the lock held by the listener's thread while it processes
+/// data, or NULL when this handler does not use a packet ring.
+QMutex *StreamHandler::GetListenerDataLock(MPEGStreamData *data) const
+{
+    RingListenerMap::const_iterator it = _ring_listeners.find(data);
+    return (it == _ring_listeners.end()) ? NULL : (*it)->DataLock();
+}
+
+QString StreamHandler::GetListenerLagStats(void) const
+{
+    if (!_packet_ring)
+        return QString();
+    return _packet_ring->GetLagStats();
+}
+
+/// Logs the per listener lag counters once a minute
+void StreamHandler::LogListenerLag(void)
+{
+    if (!_packet_ring)
+        return;
+
+    if (_lag_log_timer.isRunning() && _lag_log_timer.elapsed() < 60000)
+        return;
+    _lag_log_timer.start();
+
+    QString stats = _packet_ring->GetLagStats().trimmed();
+    if (stats.isEmpty())
+        return;
+
+    LOG(VB_RECORD, LOG_INFO, LOC + "Listener lag:\n" + stats);
+}
+
 void StreamHandler::WriteMPTS(unsigned char * buffer, uint len)
 {
-    if (_mpts_tfw == NULL)
+    if (_mpts_tfw == NULL || _mpts_listener)
         return;
     _mpts_tfw->Write(buffer, len);
 }
@@ -428,6 +503,13 @@ bool StreamHandler::AddNamedOutputFile(const QString &file)
             _mpts_tfw = NULL;
             return false;
         }
+        if (_packet_ring)
+        {
+            _mpts_listener = new StreamListenerThread(
+                _packet_ring, QString("%1 MPTS").arg(_device), NULL,
+                _mpts_tfw);
+            _mpts_listener->Start();
+        }
         LOG(VB_RECORD, LOG_INFO, LOC +
             QString("Opened '%1'").arg(_mpts_base_file));
     }
@@ -465,9 +547,80 @@ void StreamHandler::RemoveNamedOutputFile(const QString &file)
         _mpts_files.erase(it);
         if (_mpts_files.isEmpty())
         {
+            // The MPTS listener writes to _mpts_tfw, stop it first
+            delete _mpts_listener;
+            _mpts_listener = NULL;
             delete _mpts_tfw;
             _mpts_tfw = NULL;
         }
     }
 #endif //  !defined( USING_MINGW ) && !defined( _MSC_VER )
 }
+
+StreamListenerThread::StreamListenerThread(
+    PacketRing *ring, const QString &name,
+    MPEGStreamData *data, ThreadedFileWriter *tfw) :
+    MThread("StreamListener"),
+    m_ring(ring), m_cursor(ring->AddCursor(name)),
+    m_data(data), m_tfw(tfw),
+    m_running_desired(false)
+{
+}
+
+StreamListenerThread::~StreamListenerThread()
+{
+    Stop();
+    m_ring->RemoveCursor(m_cursor);
+}
+
+void StreamListenerThread::Start(void)
+{
+    m_running_desired = true;
+    MThread::start();
+}
+
+void StreamListenerThread::Stop(void)
+{
+    m_running_desired = false;
+    m_ring->WakeAll();
+    wait();
+}
+
+void StreamListenerThread::run(void)
+{
+    RunProlog();
+
+    QByteArray block;
+    while (m_running_desired)
+    {
+        if (!m_ring->Pop(m_cursor, block, 100))
+            continue;
+
+        if (m_tfw)
+        {
+            m_tfw->Write(block.constData(), block.size());
+            continue;
+        }
+
+        if (!m_carry.isEmpty())
+        {
+            m_carry.append(block);
+            block = m_carry;
+        }
+
+        const unsigned char *buffer =
+            reinterpret_cast<const unsigned char*>(block.constData());
+        int len = block.size();
+
+        m_data_lock.lock();
+        int remainder = m_data->ProcessData(buffer, len);
+        m_data_lock.unlock();
+
+        if (remainder > 0 && (len > remainder)) // leftover bytes
+            m_carry = block.right(remainder);
+        else
+            m_carry.clear();
+    }
+
+    RunEpilog();
+}
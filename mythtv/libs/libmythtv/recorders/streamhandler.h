@@ -7,12 +7,14 @@
 using namespace std;
 
 #include <QWaitCondition>
+#include <QAtomicInt>
 #include <QString>
 #include <QMutex>
 #include <QMap>
 
 #include "DeviceReadBuffer.h" // for ReaderPausedCB
 #include "mpegstreamdata.h" // for PIDPriority
+#include "packetring.h"
 #include "mthread.h"
 #include "mythdate.h"
 
@@ -47,10 +49,43 @@ class PIDInfo
 // iterator returning these in order of ascending pid number.
 typedef QMap<uint,PIDInfo*> PIDInfoMap;
 
+/** \class StreamListenerThread
+ *  \brief Feeds one StreamHandler listener from the shared PacketRing.
+ *
+ *  Either passes each block to an MPEGStreamData, or when constructed
+ *  with a ThreadedFileWriter, writes the raw MPTS to it.
+ */
+class StreamListenerThread : public MThread
+{
+  public:
+    StreamListenerThread(PacketRing *ring, const QString &name,
+                         MPEGStreamData *data, ThreadedFileWriter *tfw = NULL);
+    ~StreamListenerThread();
+
+    void Start(void);
+    void Stop(void);
+
+    /// Held while the stream data is processing a block
+    QMutex *DataLock(void) { return &m_data_lock; }
+
+  private:
+    virtual void run(void); // MThread
+
+  private:
+    PacketRing         *m_ring;
+    PacketRingCursor   *m_cursor;
+    MPEGStreamData     *m_data;
+    ThreadedFileWriter *m_tfw;
+    QMutex              m_data_lock;
+    volatile bool       m_running_desired;
+    QByteArray          m_carry; ///< partial packet left over by ProcessData
+};
+
 // locking order
 // _pid_lock -> _listener_lock
 // _add_rm_lock -> _listener_lock
 //              -> _start_stop_lock
+// _listener_lock -> StreamListenerThread::DataLock()
 
 class StreamHandler : protected MThread, public DeviceReaderCB
 {
@@ -68,6 +103,11 @@ class StreamHandler : protected MThread, public DeviceReaderCB
     /// Called with _listener_lock locked just before removing old output file.
     virtual void RemoveNamedOutputFile(const QString &filename);
 
+    /// Per listener read, overrun, drop and lag counters, one line per
+    /// listener. The lag is how many blocks were still queued for the
+    /// listener when it last read.
+    QString GetListenerLagStats(void) const;
+
   protected:
     explicit StreamHandler(const QString &device);
     ~StreamHandler();
@@ -100,6 +140,13 @@ class StreamHandler : protected MThread, public DeviceReaderCB
     virtual PIDInfo *CreatePIDInfo(uint pid, uint stream_type, int pes_type)
         { return new PIDInfo(pid, stream_type, pes_type); }
 
+    /// Publishes a block read from the device to all listeners.
+    /// Only valid for handlers that use a packet ring.
+    void PushData(const QByteArray &block)
+        { if (_listener_count.load()) _packet_ring->Push(block); }
+    QMutex *GetListenerDataLock(MPEGStreamData *data) const;
+    void LogListenerLag(void);
+
   protected:
     /// Write out a copy of the raw MPTS
     void WriteMPTS(unsigned char * buffer, uint len);
@@ -135,10 +182,20 @@ class StreamHandler : protected MThread, public DeviceReaderCB
     QSet<QString>       _mpts_files;
     QString             _mpts_base_file;
     QMutex              _mpts_lock;
+    StreamListenerThread *_mpts_listener;
 
     typedef QMap<MPEGStreamData*,QString> StreamDataList;
     mutable QMutex    _listener_lock;
     StreamDataList    _stream_data_list;
+    /// Size of _stream_data_list, for PushData() on the reader thread
+    QAtomicInt        _listener_count;
+
+    /// When set by the subclass each block read is published once to
+    /// this ring and every listener processes it on its own thread.
+    PacketRing       *_packet_ring;
+    typedef QMap<MPEGStreamData*,StreamListenerThread*> RingListenerMap;
+    RingListenerMap   _ring_listeners;
+    MythTimer         _lag_log_timer;
 };
 
 #endif // _STREAM_HANDLER_H_
@@ -0,0 +1,250 @@
+// -*- Mode: c++ -*-
+
+// POSIX headers
+#include <fcntl.h>
+
+// C++ headers
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// MythTV headers
+#include "seekindex.h"
+#include "threadedfilewriter.h"
+#include "programinfo.h"
+#include "mythlogging.h"
+
+#ifndef O_LARGEFILE
+#define O_LARGEFILE 0
+#endif
+
+#define LOC QString("SeekIndex: ")
+
+const uint32_t SeekIndex::kVersion;
+const char    *SeekIndex::kMagic = "MYTHSEEK";
+
+uint32_t SeekIndex::Check(const SeekIndexRecord &rec)
+{
+    return 0x4d534b31 ^ rec.type ^
+        (uint32_t) rec.mark   ^ (uint32_t) (rec.mark   >> 32) ^
+        (uint32_t) rec.offset ^ (uint32_t) (rec.offset >> 32);
+}
+
+/** \brief Saves the whole seek index in filename to the database,
+ *         replacing whatever is there for pginfo.
+ */
+bool SeekIndex::Import(const ProgramInfo &pginfo, const QString &filename)
+{
+    SeekIndexReader reader(filename);
+    if (!reader.Open() || !reader.GetCount())
+        return false;
+
+    MarkTypes type = reader.GetPositionMapType();
+    frm_pos_map_t posMap, durMap;
+    reader.Read(0, &posMap, type, &durMap);
+
+    LOG(VB_RECORD, LOG_INFO, LOC + QString("Importing %1 positions and "
+                                           "%2 durations from %3")
+        .arg(posMap.size()).arg(durMap.size()).arg(filename));
+
+    if (!posMap.empty())
+        pginfo.SavePositionMap(posMap, type);
+    if (!durMap.empty())
+        pginfo.SavePositionMap(durMap, MARK_DURATION_MS);
+
+    return true;
+}
+
+SeekIndexWriter::SeekIndexWriter(const QString &filename) :
+    m_filename(filename), m_tfw(NULL)
+{
+}
+
+SeekIndexWriter::~SeekIndexWriter()
+{
+    Close();
+}
+
+/// Creates the file, replacing any earlier one, and writes the header
+bool SeekIndexWriter::Open(void)
+{
+    Close();
+
+    m_tfw = new ThreadedFileWriter(
+        m_filename, O_WRONLY | O_TRUNC | O_CREAT | O_LARGEFILE, 0644);
+    // Playback reads the index while it is written, the O_DIRECT
+    // backends would keep the last records from it until a flush
+    m_tfw->SetWriteBackend("write");
+    if (!m_tfw->Open())
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Could not create '%1'").arg(m_filename));
+        delete m_tfw;
+        m_tfw = NULL;
+        return false;
+    }
+
+    SeekIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SeekIndex::kMagic, sizeof(header.magic));
+    header.version     = SeekIndex::kVersion;
+    header.record_size = sizeof(SeekIndexRecord);
+    m_tfw->Write(&header, sizeof(header));
+
+    LOG(VB_RECORD, LOG_INFO, LOC + QString("Writing '%1'").arg(m_filename));
+
+    return true;
+}
+
+void SeekIndexWriter::Append(const frm_pos_map_t &map, MarkTypes type)
+{
+    if (!m_tfw || map.empty())
+        return;
+
+    vector<SeekIndexRecord> recs(map.size());
+    frm_pos_map_t::const_iterator it = map.begin();
+    for (uint i = 0; it != map.end(); ++it, ++i)
+    {
+        recs[i].mark   = it.key();
+        recs[i].offset = *it;
+        recs[i].type   = type;
+        recs[i].check  = SeekIndex::Check(recs[i]);
+    }
+
+    m_tfw->Write(&recs[0], recs.size() * sizeof(SeekIndexRecord));
+}
+
+void SeekIndexWriter::Flush(void)
+{
+    if (m_tfw)
+        m_tfw->Flush();
+}
+
+void SeekIndexWriter::Close(void)
+{
+    delete m_tfw; // flushes
+    m_tfw = NULL;
+}
+
+SeekIndexReader::SeekIndexReader(const QString &filename) :
+    m_file(filename), m_data(NULL), m_size(0), m_count(0)
+{
+}
+
+SeekIndexReader::~SeekIndexReader()
+{
+    Close();
+}
+
+bool SeekIndexReader::Open(void)
+{
+    Close();
+
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    if (!Map())
+    {
+        Close();
+        return false;
+    }
+
+    const SeekIndexHeader *header =
+        reinterpret_cast<const SeekIndexHeader*>(m_data);
+    if (memcmp(header->magic, SeekIndex::kMagic, sizeof(header->magic)) ||
+        header->version != SeekIndex::kVersion ||
+        header->record_size != sizeof(SeekIndexRecord))
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("'%1' is not a seek index").arg(m_file.fileName()));
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+/// Picks up records appended since the last call, returns true if any
+bool SeekIndexReader::Refresh(void)
+{
+    if (!m_data)
+        return Open() && m_count;
+
+    if (m_file.size() == m_size)
+        return false;
+
+    uint old_count = m_count;
+    m_file.unmap(m_data);
+    m_data = NULL;
+    if (!Map())
+    {
+        Close();
+        return false;
+    }
+
+    return m_count > old_count;
+}
+
+void SeekIndexReader::Close(void)
+{
+    if (m_data)
+        m_file.unmap(m_data);
+    m_data  = NULL;
+    m_size  = 0;
+    m_count = 0;
+    m_file.close();
+}
+
+bool SeekIndexReader::Map(void)
+{
+    qint64 size = m_file.size();
+    if (size < (qint64) sizeof(SeekIndexHeader))
+        return false;
+
+    m_data = m_file.map(0, size);
+    if (!m_data)
+        return false;
+    m_size = size;
+
+    // Only whole records the recorder has finished writing count
+    uint count = (size - sizeof(SeekIndexHeader)) / sizeof(SeekIndexRecord);
+    const SeekIndexRecord *recs = GetRecords();
+    uint i = min(m_count, count);
+    while (i < count && recs[i].check == SeekIndex::Check(recs[i]))
+        ++i;
+    m_count = i;
+
+    return true;
+}
+
+/** \brief Adds records first and later to the maps.
+ *
+ *  Records of posType go to posMap and those of MARK_DURATION_MS to
+ *  durMap, either may be NULL.
+ *  \return the index to pass as first to read only newer records
+ */
+uint SeekIndexReader::Read(uint first, frm_pos_map_t *posMap,
+                           MarkTypes posType, frm_pos_map_t *durMap) const
+{
+    const SeekIndexRecord *recs = GetRecords();
+    for (uint i = first; i < m_count; ++i)
+    {
+        if (posMap && recs[i].type == (uint32_t) posType)
+            posMap->insert(recs[i].mark, recs[i].offset);
+        else if (durMap && recs[i].type == (uint32_t) MARK_DURATION_MS)
+            durMap->insert(recs[i].mark, recs[i].offset);
+    }
+    return max(first, m_count);
+}
+
+/// Returns the type of the position records, MARK_UNSET if there are none
+MarkTypes SeekIndexReader::GetPositionMapType(void) const
+{
+    const SeekIndexRecord *recs = GetRecords();
+    for (uint i = 0; i < m_count; ++i)
+    {
+        if (recs[i].type != (uint32_t) MARK_DURATION_MS)
+            return (MarkTypes) recs[i].type;
+    }
+    return MARK_UNSET;
+}
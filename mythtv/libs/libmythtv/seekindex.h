@@ -0,0 +1,117 @@
+// -*- Mode: c++ -*-
+#ifndef _SEEK_INDEX_H_
+#define _SEEK_INDEX_H_
+
+#include <stdint.h>
+
+#include <QString>
+#include <QFile>
+
+#include "mythtvexp.h"
+#include "programtypes.h"
+
+class ThreadedFileWriter;
+class ProgramInfo;
+
+/** \file seekindex.h
+ *  \brief Side-car seek index written next to a recording.
+ *
+ *  The file is "<recording>.seek". It starts with a SeekIndexHeader
+ *  followed by fixed size SeekIndexRecords which are only ever
+ *  appended, so a reader can map the file while the recorder is still
+ *  writing it and pick up new records by looking at the file size.
+ *  Each record carries the MarkTypes of the recordedseek row it
+ *  stands for, position and duration entries are interleaved.
+ */
+
+typedef struct SeekIndexHeader
+{
+    char     magic[8];      ///< "MYTHSEEK"
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved[4];
+} SeekIndexHeader;
+
+typedef struct SeekIndexRecord
+{
+    int64_t  mark;          ///< frame or keyframe number
+    int64_t  offset;        ///< byte offset or duration in ms
+    uint32_t type;          ///< MarkTypes
+    uint32_t check;         ///< detects a torn record at the end
+} SeekIndexRecord;
+
+class MTV_PUBLIC SeekIndex
+{
+  public:
+    static QString GetFilename(const QString &recording)
+        { return recording + ".seek"; }
+    static uint32_t Check(const SeekIndexRecord &rec);
+    static bool Import(const ProgramInfo &pginfo, const QString &filename);
+
+    static const uint32_t kVersion = 1;
+    static const char    *kMagic;
+};
+
+/** \class SeekIndexWriter
+ *  \brief Appends position and duration map deltas to a seek index
+ *         through a ThreadedFileWriter, so the recorder never blocks
+ *         on it.
+ */
+class MTV_PUBLIC SeekIndexWriter
+{
+  public:
+    explicit SeekIndexWriter(const QString &filename);
+   ~SeekIndexWriter();
+
+    bool Open(void);
+    void Append(const frm_pos_map_t &map, MarkTypes type);
+    void Flush(void);
+    void Close(void);
+
+    bool IsOpen(void) const { return m_tfw; }
+    QString GetFilename(void) const { return m_filename; }
+
+  private:
+    QString             m_filename;
+    ThreadedFileWriter *m_tfw;
+};
+
+/** \class SeekIndexReader
+ *  \brief Maps a seek index read only and hands out its records.
+ *
+ *  Refresh() remaps the file after the recorder has appended to it.
+ *  Records past the first torn or short one are never returned.
+ */
+class MTV_PUBLIC SeekIndexReader
+{
+  public:
+    explicit SeekIndexReader(const QString &filename);
+   ~SeekIndexReader();
+
+    bool Open(void);
+    bool Refresh(void);
+    void Close(void);
+
+    bool IsOpen(void) const { return m_data; }
+    QString GetFilename(void) const { return m_file.fileName(); }
+    uint GetCount(void) const { return m_count; }
+    const SeekIndexRecord *GetRecords(void) const
+    {
+        return reinterpret_cast<const SeekIndexRecord*>(
+            m_data + sizeof(SeekIndexHeader));
+    }
+
+    uint Read(uint first, frm_pos_map_t *posMap, MarkTypes posType,
+              frm_pos_map_t *durMap) const;
+    MarkTypes GetPositionMapType(void) const;
+
+  private:
+    bool Map(void);
+
+    QFile   m_file;
+    uchar  *m_data;
+    qint64  m_size;
+    uint    m_count;
+};
+
+#endif // _SEEK_INDEX_H_
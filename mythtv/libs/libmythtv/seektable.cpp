@@ -0,0 +1,98 @@
+// -*- Mode: c++ -*-
+
+#include <algorithm>
+using namespace std;
+
+#include "seektable.h"
+
+static bool key_less(const SeekTable::Entry &e, int64_t key)
+{
+    return e.key < key;
+}
+
+static bool value_less(const SeekTable::Entry &e, int64_t value)
+{
+    return e.value < value;
+}
+
+/// Adds or replaces the entry for key
+void SeekTable::Insert(int64_t key, int64_t value)
+{
+    Entry e = { key, value };
+    if (m_entries.empty() || m_entries.back().key < key)
+    {
+        m_entries.push_back(e);
+        return;
+    }
+
+    vector<Entry>::iterator it =
+        lower_bound(m_entries.begin(), m_entries.end(), key, key_less);
+    if (it != m_entries.end() && it->key == key)
+        it->value = value;
+    else
+        m_entries.insert(it, e);
+}
+
+/// Returns the index of the first entry with a key >= key, or size()
+size_t SeekTable::LowerBound(int64_t key) const
+{
+    return lower_bound(m_entries.begin(), m_entries.end(), key, key_less) -
+        m_entries.begin();
+}
+
+/// Returns the index of the first entry with a value >= value, or size()
+size_t SeekTable::LowerBoundValue(int64_t value) const
+{
+    return lower_bound(m_entries.begin(), m_entries.end(), value,
+                       value_less) - m_entries.begin();
+}
+
+/** \brief Linearly interpolates the value for key between the entries
+ *         around it.
+ *
+ *  Outside the range of keys in the table the value is extrapolated
+ *  using fallback_ratio, from (0,0) before the first entry.
+ */
+uint64_t SeekTable::Translate(int64_t key, float fallback_ratio) const
+{
+    return Interpolate(LowerBound(key), false, key, fallback_ratio);
+}
+
+/// Like Translate(), but maps a value back to its key
+uint64_t SeekTable::TranslateValue(int64_t value, float fallback_ratio) const
+{
+    return Interpolate(LowerBoundValue(value), true, value, fallback_ratio);
+}
+
+uint64_t SeekTable::Interpolate(size_t upper, bool by_value, int64_t key,
+                                float fallback_ratio) const
+{
+#define KEY(i) (by_value ? m_entries[i].value : m_entries[i].key)
+#define VAL(i) (by_value ? m_entries[i].key : m_entries[i].value)
+
+    // The entry <= key, the one found is >= key
+    size_t lower = upper;
+    if (lower != 0 && (lower == m_entries.size() || KEY(lower) > key))
+        --lower;
+
+    uint64_t key1 = 0, val1 = 0;
+    if (lower != m_entries.size() && KEY(lower) <= key)
+    {
+        key1 = KEY(lower);
+        val1 = VAL(lower);
+    }
+
+    if (upper == m_entries.size())
+        return val1 + fallback_ratio * (key - key1) + 0.5;
+
+    uint64_t key2 = KEY(upper);
+    uint64_t val2 = VAL(upper);
+
+#undef KEY
+#undef VAL
+
+    if (key1 == key2) // this happens for an exact match
+        return val2;
+
+    return val1 + (double) (key - key1) * (val2 - val1) / (key2 - key1) + 0.5;
+}
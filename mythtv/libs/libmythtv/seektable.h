@@ -0,0 +1,55 @@
+// -*- Mode: c++ -*-
+#ifndef _SEEK_TABLE_H_
+#define _SEEK_TABLE_H_
+
+#include <stdint.h>
+
+#include <vector>
+using namespace std;
+
+#include "mythtvexp.h"
+
+/** \class SeekTable
+ *  \brief Sorted array of (key, value) pairs where both keys and values
+ *         increase, such as the frame to duration map of a recording.
+ *
+ *  This takes 16 bytes an entry, against well over 100 for the pair
+ *  of QMaps it replaces, and is searched in either direction with a
+ *  binary search. Entries are normally appended in key order, an out
+ *  of order Insert() still works but costs a move of the tail.
+ */
+class MTV_PUBLIC SeekTable
+{
+  public:
+    typedef struct
+    {
+        int64_t key;
+        int64_t value;
+    } Entry;
+
+    void Insert(int64_t key, int64_t value);
+    void Reserve(size_t count) { m_entries.reserve(count); }
+    void Clear(void) { m_entries.clear(); }
+
+    bool empty(void) const { return m_entries.empty(); }
+    size_t size(void) const { return m_entries.size(); }
+    const Entry &operator[](size_t i) const { return m_entries[i]; }
+    const Entry &back(void) const { return m_entries.back(); }
+
+    size_t LowerBound(int64_t key) const;
+    size_t LowerBoundValue(int64_t value) const;
+
+    uint64_t Translate(int64_t key, float fallback_ratio) const;
+    uint64_t TranslateValue(int64_t value, float fallback_ratio) const;
+
+    size_t GetMemoryUsage(void) const
+        { return m_entries.capacity() * sizeof(Entry); }
+
+  private:
+    uint64_t Interpolate(size_t upper, bool by_value, int64_t key,
+                         float fallback_ratio) const;
+
+    vector<Entry> m_entries;
+};
+
+#endif // _SEEK_TABLE_H_
@@ -0,0 +1,598 @@
+// -*- Mode: c++ -*-
+
+// C++ headers
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+// MythTV headers
+#include "seektablebuilder.h"
+#include "mpegstreamdata.h"
+#include "mpegtables.h"
+#include "tspacket.h"
+#include "tssync.h"
+#include "ringbuffer.h"
+#include "mythtimer.h"
+#include "mythlogging.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+#define LOC QString("SeekTableBuilder: ")
+
+const uint SeekTableBuilder::kMaxProbeSize;
+const uint SeekTableBuilder::kMaxKeyFrameDistance;
+
+// The frame rates of the MPEG-2 frame_rate_code, as DTVRecorder has them
+static const FrameRate frameRateMap[16] = {
+    FrameRate(0),  FrameRate(24000, 1001), FrameRate(24),
+    FrameRate(25), FrameRate(30000, 1001), FrameRate(30),
+    FrameRate(50), FrameRate(60000, 1001), FrameRate(60),
+    FrameRate(0),  FrameRate(0),           FrameRate(0),
+    FrameRate(0),  FrameRate(0),           FrameRate(0),
+    FrameRate(0)
+};
+
+// Bytes of a start code's header DTVRecorder looks at, the picture
+// coding extension is the longest
+static const uint kStartCodeHeader = 5;
+
+SeekTableBuilder::SeekTableBuilder() :
+    m_container(kUnknown), m_videoPID(0), m_streamType(0), m_isH264(false),
+    m_streamData(NULL), m_programNumber(-1), m_probed(0), m_offset(0),
+    m_startCode(0xffffffff), m_pesSynced(false), m_pesOffset(0),
+    m_packOffset(0), m_videoBytesLeft(0), m_otherBytesLeft(0),
+    m_framesSeen(0), m_lastGopSeen(0), m_lastSeqSeen(0),
+    m_lastKeyframeSeen(0), m_progressiveSequence(false), m_repeatPict(0),
+    m_frameRate(0), m_tdTickFramerate(0), m_tdBase(0), m_tdTickCount(0),
+    m_totalDuration(0)
+{
+}
+
+SeekTableBuilder::~SeekTableBuilder()
+{
+    delete m_streamData;
+}
+
+/// True for the video streams whose keyframes can be found by parsing
+bool SeekTableBuilder::IsSupported(uint streamType)
+{
+    return ((StreamID::MPEG1Video     == streamType) ||
+            (StreamID::MPEG2Video     == streamType) ||
+            (StreamID::OpenCableVideo == streamType) ||
+            (StreamID::H264Video      == streamType));
+}
+
+/** \brief Looks for the video stream in the start of the file.
+ *
+ *  Give it consecutive buffers from the start of the file until it
+ *  returns true, or kMaxProbeSize bytes have been given to it.
+ *  \return true once the video stream is known
+ */
+bool SeekTableBuilder::Probe(const unsigned char *data, uint len)
+{
+    if (IsProbed())
+        return true;
+    if (!len)
+        return false;
+
+    if (!m_probed)
+    {
+        // a program stream starts with a pack header
+        if (len >= 4 && data[0] == 0x00 && data[1] == 0x00 &&
+            data[2] == 0x01 && data[3] == PESStreamID::PackHeader)
+        {
+            SetVideoStream(kProgramStream, 0, StreamID::MPEG2Video);
+            return true;
+        }
+
+        m_streamData = new MPEGStreamData(-1, -1, false);
+        m_streamData->AddMPEGListener(this);
+    }
+
+    m_probed += len;
+
+    m_carry.insert(m_carry.end(), data, data + len);
+    int left = m_streamData->ProcessData(&m_carry[0], m_carry.size());
+    m_carry.erase(m_carry.begin(), m_carry.end() - left);
+
+    if (!IsProbed())
+        return false;
+
+    delete m_streamData;
+    m_streamData = NULL;
+    m_carry.clear();
+    return true;
+}
+
+/// Picks the first program of the PAT, as a recording has only one
+void SeekTableBuilder::HandlePAT(const ProgramAssociationTable *pat)
+{
+    if (m_programNumber >= 0)
+        return;
+
+    for (uint i = 0; i < pat->ProgramCount(); i++)
+    {
+        if (!pat->ProgramNumber(i))
+            continue;   // the network PID
+
+        m_programNumber = pat->ProgramNumber(i);
+        m_streamData->AddListeningPID(pat->ProgramPID(i));
+        LOG(VB_COMMFLAG, LOG_DEBUG, LOC + QString("Program %1, PMT PID 0x%2")
+                .arg(m_programNumber).arg(pat->ProgramPID(i), 0, 16));
+        return;
+    }
+}
+
+void SeekTableBuilder::HandlePMT(uint program_num, const ProgramMapTable *pmt)
+{
+    if (IsProbed() || (int)program_num != m_programNumber)
+        return;
+
+    for (uint i = 0; i < pmt->StreamCount(); i++)
+    {
+        if (pmt->IsVideo(i, "mpeg"))
+        {
+            SetVideoStream(kTransportStream, pmt->StreamPID(i),
+                           pmt->StreamType(i));
+            return;
+        }
+    }
+}
+
+/// Sets the video stream, for when it is known without Probe()
+void SeekTableBuilder::SetVideoStream(Container container, uint pid,
+                                      uint streamType)
+{
+    m_container  = container;
+    m_videoPID   = pid;
+    m_streamType = streamType;
+    m_isH264     = (StreamID::H264Video == streamType);
+
+    LOG(VB_COMMFLAG, LOG_INFO, LOC + QString("%1 video %2 on PID 0x%3")
+            .arg(container == kProgramStream ? "PS" : "TS")
+            .arg(StreamID::toString(streamType)).arg(pid, 0, 16));
+}
+
+/** \brief Parses the next len bytes of the file.
+ *
+ *  The first call is given the first byte of the file, whatever was
+ *  given to Probe(). A packet or start code cut in two by the end of
+ *  the buffer is kept until the next call.
+ */
+void SeekTableBuilder::Parse(const unsigned char *data, uint len)
+{
+    if (!IsProbed() || !IsSupported(m_streamType))
+        return;
+
+    const unsigned char *buf = data;
+    uint size = len;
+    if (!m_carry.empty())
+    {
+        m_carry.insert(m_carry.end(), data, data + len);
+        buf = &m_carry[0];
+        size = m_carry.size();
+    }
+
+    uint used = (m_container == kProgramStream) ?
+        ParsePS(buf, size) : ParseTS(buf, size);
+    m_offset += used;
+
+    if (m_carry.empty())
+        m_carry.assign(data + used, data + len);
+    else
+        m_carry.erase(m_carry.begin(), m_carry.begin() + used);
+}
+
+/// Called after the last Parse(), what is left over is not a frame
+void SeekTableBuilder::Finish(void)
+{
+    m_offset += m_carry.size();
+    m_carry.clear();
+
+    LOG(VB_COMMFLAG, LOG_INFO, LOC +
+        QString("%1 frames, %2 keyframes, %3 ms in %4 bytes")
+            .arg(m_framesSeen).arg(m_positionMap.size())
+            .arg(GetTotalDuration()).arg(m_offset));
+}
+
+/// \return the number of bytes parsed, the rest must be given again
+uint SeekTableBuilder::ParseTS(const unsigned char *data, uint len)
+{
+    uint pos = 0;
+    while (pos + TSPacket::kSize <= len)
+    {
+        if (data[pos] != SYNC_BYTE)
+        {
+            int next = TSSyncScanner::Find(data, pos, len);
+            if (next == -1)
+                return pos;
+            if (next == -2)
+                return len - TSPacket::kSize;
+            LOG(VB_COMMFLAG, LOG_DEBUG, LOC + QString("Resync @ %1 -> %2")
+                    .arg(m_offset + pos).arg(m_offset + next));
+            pos = next;
+            continue;
+        }
+
+        const TSPacket *pkt = reinterpret_cast<const TSPacket*>(data + pos);
+        if (pkt->PID() == m_videoPID && pkt->HasPayload() &&
+            !pkt->TransportError())
+        {
+            if (m_isH264)
+                FindH264Keyframes(*pkt, m_offset + pos);
+            else
+                FindMPEG2Keyframes(*pkt, m_offset + pos);
+        }
+        pos += TSPacket::kSize;
+    }
+    return pos;
+}
+
+/** \brief Adds the next frame to the maps as a keyframe at offset,
+ *         as DTVRecorder::HandleKeyframe() does.
+ */
+void SeekTableBuilder::AddKeyframe(uint64_t offset)
+{
+    m_lastKeyframeSeen = m_framesSeen;
+    if (!m_positionMap.contains(m_framesSeen))
+    {
+        m_positionMap[m_framesSeen] = offset;
+        m_durationMap[m_framesSeen] = m_totalDuration + 0.5;
+    }
+}
+
+/// Counts a frame and its duration, as DTVRecorder::UpdateFramesWritten()
+void SeekTableBuilder::AddFrame(void)
+{
+    m_framesSeen++;
+    if (!m_tdTickFramerate.isNonzero())
+        m_tdTickFramerate = m_frameRate;
+    if (m_tdTickFramerate != m_frameRate)
+    {
+        m_tdBase = m_totalDuration;
+        m_tdTickCount = 0;
+        m_tdTickFramerate = m_frameRate;
+    }
+    m_tdTickCount += (2 + m_repeatPict);
+    if (m_tdTickFramerate.isNonzero())
+    {
+        m_totalDuration = m_tdBase + (int64_t) 500 * m_tdTickCount *
+            m_tdTickFramerate.getDen() / (double) m_tdTickFramerate.getNum();
+    }
+}
+
+/** \brief DTVRecorder::FindMPEG2Keyframes() without the recording.
+ *
+ *  A keyframe is at the start of the PES packet holding its GOP or
+ *  sequence header.
+ */
+void SeekTableBuilder::FindMPEG2Keyframes(const TSPacket &tspacket,
+                                          uint64_t offset)
+{
+    if (tspacket.PayloadStart())
+    {
+        m_startCode = 0xffffffff;
+        m_pesOffset = offset;
+    }
+
+    const uint maxKFD = kMaxKeyFrameDistance;
+    bool hasFrame     = false;
+    bool hasKeyFrame  = false;
+    FrameRate frameRate(0);
+
+    const uint8_t *bufptr = tspacket.data() + tspacket.AFCOffset();
+    const uint8_t *bufend = tspacket.data() + TSPacket::kSize;
+    m_repeatPict = 0;
+
+    while (bufptr < bufend)
+    {
+        bufptr = avpriv_find_start_code(bufptr, bufend, &m_startCode);
+        int bytes_left = bufend - bufptr;
+        if ((m_startCode & 0xffffff00) != 0x00000100)
+            continue;
+
+        const int stream_id = m_startCode & 0x000000ff;
+        if (PESStreamID::PictureStartCode == stream_id)
+        {
+            hasFrame = true;
+        }
+        else if (PESStreamID::GOPStartCode == stream_id)
+        {
+            m_lastGopSeen = m_framesSeen;
+            hasKeyFrame   = true;
+        }
+        else if (PESStreamID::SequenceStartCode == stream_id)
+        {
+            m_lastSeqSeen = m_framesSeen;
+            hasKeyFrame  |= (m_lastGopSeen + maxKFD) < m_framesSeen;
+            if (bytes_left >= 4)
+                frameRate = frameRateMap[(bufptr[3] & 0x0000000f)];
+        }
+        else if (PESStreamID::MPEG2ExtensionStartCode == stream_id &&
+                 bytes_left >= 1)
+        {
+            int ext_type = (bufptr[0] >> 4);
+            if (ext_type == 0x1 && bytes_left >= 6)
+            {
+                /* sequence extension */
+                m_progressiveSequence = bufptr[1] & (1 << 3);
+            }
+            else if (ext_type == 0x8 && bytes_left >= 5)
+            {
+                /* picture coding extension */
+                int top_field_first = bufptr[3] & (1 << 7);
+                int repeat_first_field = bufptr[3] & (1 << 1);
+                int progressive_frame = bufptr[4] & (1 << 7);
+
+                m_repeatPict = 1;
+                if (repeat_first_field)
+                {
+                    if (m_progressiveSequence)
+                        m_repeatPict = top_field_first ? 5 : 3;
+                    else if (progressive_frame)
+                        m_repeatPict = 2;
+                }
+                --m_repeatPict;
+            }
+        }
+    }
+
+    if (hasFrame && !hasKeyFrame)
+    {
+        // As DTVRecorder, pretend this picture is a keyframe when
+        // there has been no GOP or SEQ for kMaxKeyFrameDistance frames.
+        hasKeyFrame = !(m_framesSeen & 0xf);
+        hasKeyFrame &= (m_lastGopSeen + maxKFD) < m_framesSeen;
+        hasKeyFrame &= (m_lastSeqSeen + maxKFD) < m_framesSeen;
+    }
+
+    if (hasKeyFrame)
+        AddKeyframe(m_pesOffset);
+    if (hasFrame)
+        AddFrame();
+
+    if (frameRate.isNonzero() && frameRate != m_frameRate)
+        m_frameRate = frameRate;
+}
+
+/// DTVRecorder::FindH264Keyframes() without the recording
+void SeekTableBuilder::FindH264Keyframes(const TSPacket &tspacket,
+                                         uint64_t offset)
+{
+    const bool payloadStart = tspacket.PayloadStart();
+    if (payloadStart)
+    {
+        // reset PES sync state
+        m_pesSynced = false;
+        m_startCode = 0xffffffff;
+    }
+
+    FrameRate frameRate(0);
+    bool hasFrame = false;
+    bool hasKeyFrame = false;
+
+    // scan for PES packets and H.264 NAL units
+    uint i = tspacket.AFCOffset();
+    for (; i < TSPacket::kSize; ++i)
+    {
+        // skip the PES header of a new PES packet
+        if (payloadStart && !m_pesSynced)
+        {
+            const unsigned char *pes = tspacket.data() + i;
+            if (i + 8 >= TSPacket::kSize ||
+                pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01)
+            {
+                LOG(VB_COMMFLAG, LOG_DEBUG, LOC + QString(
+                        "No PES header in packet @ %1").arg(offset));
+                break;
+            }
+
+            // start code (3), stream_id (1), PES packet length (2),
+            // flags (2) and the PES header length (1), which follows
+            i += 9 + pes[8];
+            if (i >= TSPacket::kSize)
+            {
+                LOG(VB_COMMFLAG, LOG_DEBUG, LOC + QString(
+                        "PES header overflows packet @ %1").arg(offset));
+                break;
+            }
+            m_pesSynced = true;
+        }
+
+        // ain't going nowhere if we're not PES synced
+        if (!m_pesSynced)
+            break;
+
+        uint32_t bytes_used = m_h264Parser.addBytes
+                              (tspacket.data() + i, TSPacket::kSize - i,
+                               offset);
+        i += (bytes_used - 1);
+
+        if (m_h264Parser.stateChanged())
+        {
+            if (m_h264Parser.onFrameStart() &&
+                m_h264Parser.FieldType() != H264Parser::FIELD_BOTTOM)
+            {
+                hasKeyFrame = m_h264Parser.onKeyFrameStart();
+                hasFrame = true;
+                m_h264Parser.getFrameRate(frameRate);
+            }
+        }
+    }
+
+    // If it has been more than 511 frames since the last keyframe,
+    // pretend we have one.
+    if (hasFrame && !hasKeyFrame &&
+        (m_framesSeen - m_lastKeyframeSeen) > 511)
+    {
+        hasKeyFrame = true;
+    }
+
+    if (hasKeyFrame)
+        AddKeyframe(m_h264Parser.keyframeAUstreamOffset());
+    if (hasFrame)
+        AddFrame();
+
+    if (frameRate.isNonzero() && frameRate != m_frameRate)
+        m_frameRate = frameRate;
+}
+
+/** \brief DTVRecorder::FindPSKeyFrames() without the recording.
+ *
+ *  Only start codes inside video PES packets are looked at, all other
+ *  PES packets are skipped by their length. A keyframe is at the
+ *  pack header before the PES packet holding its GOP or sequence
+ *  header.
+ *  \return the number of bytes parsed, the rest must be given again
+ */
+uint SeekTableBuilder::ParsePS(const unsigned char *data, uint len)
+{
+    const uint maxKFD = kMaxKeyFrameDistance;
+    const uint8_t *bufptr = data;
+    // the last few bytes are kept for the next call, so the header of
+    // every start code found is there
+    const uint8_t *bufend = data + len - min(len, kStartCodeHeader);
+
+    while (bufptr < bufend)
+    {
+        uint skip = min(m_otherBytesLeft, (uint)(bufend - bufptr));
+        bufptr += skip;
+        m_otherBytesLeft -= skip;
+        if (skip)
+            m_startCode = 0xffffffff;
+        if (bufptr == bufend)
+            break;
+
+        const uint8_t *tmp = bufptr;
+        bufptr = avpriv_find_start_code(bufptr, bufend, &m_startCode);
+        m_videoBytesLeft -= min((uint)(bufptr - tmp), m_videoBytesLeft);
+
+        if ((m_startCode & 0xffffff00) != 0x00000100)
+            continue;
+
+        const int stream_id = m_startCode & 0x000000ff;
+        m_startCode = 0xffffffff;
+
+        bool hasFrame    = false;
+        bool hasKeyFrame = false;
+
+        if (m_videoBytesLeft)
+        {
+            if (PESStreamID::PictureStartCode == stream_id)
+            {
+                uint frmtypei = (bufptr[1] >> 3) & 0x7;
+                hasFrame = (1 <= frmtypei) && (frmtypei <= 5);
+            }
+            else if (PESStreamID::GOPStartCode == stream_id)
+            {
+                m_lastGopSeen = m_framesSeen;
+                hasKeyFrame   = true;
+            }
+            else if (PESStreamID::SequenceStartCode == stream_id)
+            {
+                m_lastSeqSeen = m_framesSeen;
+                hasKeyFrame  |= (m_lastGopSeen + maxKFD) < m_framesSeen;
+                FrameRate frameRate = frameRateMap[(bufptr[3] & 0x0f)];
+                if (frameRate.isNonzero())
+                    m_frameRate = frameRate;
+            }
+        }
+        else if (PESStreamID::PackHeader == stream_id)
+        {
+            // the start code may have begun in the last call
+            m_packOffset = (int64_t)m_offset + (bufptr - data) - 4;
+        }
+        else if ((stream_id >= PESStreamID::MPEGVideoStreamBegin) &&
+                 (stream_id <= PESStreamID::MPEGVideoStreamEnd))
+        {
+            m_videoBytesLeft = 2 + ((bufptr[0] << 8) | bufptr[1]);
+        }
+        else if (stream_id >= PESStreamID::SystemHeader)
+        {
+            // audio, padding and every other PES packet
+            m_otherBytesLeft = 2 + ((bufptr[0] << 8) | bufptr[1]);
+        }
+
+        if (hasFrame && !hasKeyFrame)
+        {
+            hasKeyFrame = !(m_framesSeen & 0xf);
+            hasKeyFrame &= (m_lastGopSeen + maxKFD) < m_framesSeen;
+            hasKeyFrame &= (m_lastSeqSeen + maxKFD) < m_framesSeen;
+        }
+
+        if (hasKeyFrame)
+            AddKeyframe(m_packOffset);
+        if (hasFrame)
+            AddFrame();
+    }
+
+    return bufptr - data;
+}
+
+/** \brief Builds the maps of the file the RingBuffer reads.
+ *  \return false if the file is not an MPEG-2 or H.264 transport or
+ *          program stream, or could not be read
+ */
+bool SeekTableBuilder::Scan(RingBuffer *rbuffer, ProgressCallback cb,
+                            void *cbData)
+{
+    const int kReadSize = 1024 * 1024;
+    vector<unsigned char> buf(kReadSize);
+
+    rbuffer->Seek(0, SEEK_SET);
+    uint probed = 0;
+    while (!IsProbed() && probed < kMaxProbeSize)
+    {
+        int len = rbuffer->Read(&buf[0], kReadSize);
+        if (len <= 0)
+            break;
+        Probe(&buf[0], len);
+        probed += len;
+    }
+
+    if (!IsProbed() || !IsSupported(m_streamType))
+    {
+        LOG(VB_GENERAL, LOG_INFO, LOC + QString("No %1 video found in %2")
+                .arg(IsProbed() ? StreamID::toString(m_streamType) :
+                     "MPEG-2 or H.264")
+                .arg(rbuffer->GetFilename()));
+        return false;
+    }
+
+    const int64_t size = rbuffer->GetRealFileSize();
+    MythTimer timer;
+    timer.start();
+    int lastPercent = -1;
+
+    rbuffer->Seek(0, SEEK_SET);
+    for (;;)
+    {
+        int len = rbuffer->Read(&buf[0], kReadSize);
+        if (len < 0)
+        {
+            LOG(VB_GENERAL, LOG_ERR, LOC + QString("Read error @ %1 in %2")
+                    .arg(m_offset).arg(rbuffer->GetFilename()));
+            return false;
+        }
+        if (len == 0)
+            break;
+
+        Parse(&buf[0], len);
+
+        int percent = (size > 0) ? (int)((int64_t)m_offset * 100 / size) : 0;
+        if (cb && percent != lastPercent)
+        {
+            lastPercent = percent;
+            (*cb)(percent, cbData);
+        }
+    }
+    Finish();
+
+    int elapsed = max(timer.elapsed(), 1);
+    LOG(VB_COMMFLAG, LOG_INFO, LOC + QString("Scanned %1 MB at %2 MB/s")
+            .arg(m_offset >> 20).arg((m_offset >> 10) / elapsed));
+
+    return m_framesSeen > 0;
+}
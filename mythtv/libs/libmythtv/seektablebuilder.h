@@ -0,0 +1,137 @@
+// -*- Mode: c++ -*-
+#ifndef _SEEK_TABLE_BUILDER_H_
+#define _SEEK_TABLE_BUILDER_H_
+
+#include <stdint.h>
+
+#include <vector>
+using namespace std;
+
+#include <QString>
+
+#include "mythtvexp.h"
+#include "programtypes.h"
+#include "recorderbase.h"
+#include "H264Parser.h"
+#include "streamlisteners.h"
+
+class MPEGStreamData;
+class RingBuffer;
+class TSPacket;
+
+/** \class SeekTableBuilder
+ *  \brief Builds the keyframe position and duration maps of an MPEG-2
+ *         or H.264 recording by parsing its transport or program
+ *         stream, without decoding any video.
+ *
+ *  The frames and keyframes are found the way DTVRecorder finds them
+ *  while recording, with the MPEG-2 start codes and H264Parser, so the
+ *  maps match those the recorder would have written. The whole file
+ *  is read once, at the speed of the disk.
+ *
+ *  Probe() is given the start of the file until it finds the video
+ *  stream, from the PAT and PMT of a transport stream or the pack
+ *  headers of a program stream. The whole file is then given to
+ *  Parse(), from its first byte, and Finish() is called at its end.
+ *  Scan() does all of that with a RingBuffer.
+ */
+class MTV_PUBLIC SeekTableBuilder : public MPEGStreamListener
+{
+  public:
+    typedef enum
+    {
+        kUnknown = 0,
+        kTransportStream,
+        kProgramStream,
+    } Container;
+
+    typedef void (*ProgressCallback)(int percent, void *data);
+
+    SeekTableBuilder();
+    ~SeekTableBuilder();
+
+    bool Probe(const unsigned char *data, uint len);
+    void SetVideoStream(Container container, uint pid, uint streamType);
+    void Parse(const unsigned char *data, uint len);
+    void Finish(void);
+
+    bool Scan(RingBuffer *rbuffer, ProgressCallback cb = NULL,
+              void *cbData = NULL);
+
+    bool IsProbed(void) const { return m_container != kUnknown; }
+    Container GetContainer(void) const { return m_container; }
+    uint GetVideoPID(void) const { return m_videoPID; }
+    uint GetStreamType(void) const { return m_streamType; }
+
+    /// keyframe number to byte offset, as MARK_GOP_BYFRAME
+    const frm_pos_map_t &GetPositionMap(void) const { return m_positionMap; }
+    /// keyframe number to milliseconds, as MARK_DURATION_MS
+    const frm_pos_map_t &GetDurationMap(void) const { return m_durationMap; }
+    uint64_t GetTotalFrames(void) const { return m_framesSeen; }
+    /// in milliseconds
+    uint64_t GetTotalDuration(void) const
+        { return (uint64_t)(m_totalDuration + 0.5); }
+
+    static bool IsSupported(uint streamType);
+
+    // MPEGStreamListener
+    virtual void HandlePAT(const ProgramAssociationTable *pat);
+    virtual void HandleCAT(const ConditionalAccessTable*) { }
+    virtual void HandlePMT(uint program_num, const ProgramMapTable *pmt);
+    virtual void HandleEncryptionStatus(uint, bool) { }
+
+    /// bytes of a file Probe() looks at before giving up
+    static const uint kMaxProbeSize = 16 * 1024 * 1024;
+    /// frames after which a frame is made a keyframe, as DTVRecorder
+    static const uint kMaxKeyFrameDistance = 80;
+
+  private:
+    uint ParseTS(const unsigned char *data, uint len);
+    uint ParsePS(const unsigned char *data, uint len);
+    void FindMPEG2Keyframes(const TSPacket &tspacket, uint64_t offset);
+    void FindH264Keyframes(const TSPacket &tspacket, uint64_t offset);
+    void AddKeyframe(uint64_t offset);
+    void AddFrame(void);
+
+    Container              m_container;
+    uint                   m_videoPID;
+    uint                   m_streamType;
+    bool                   m_isH264;
+
+    // probing a transport stream
+    MPEGStreamData        *m_streamData;
+    int                    m_programNumber;
+    uint                   m_probed;
+
+    /// bytes of the last Parse() not parsed yet
+    vector<unsigned char>  m_carry;
+    /// file offset of the first byte given to the next Parse()
+    uint64_t               m_offset;
+
+    // what DTVRecorder keeps to find keyframes
+    uint32_t               m_startCode;
+    bool                   m_pesSynced;
+    uint64_t               m_pesOffset;
+    uint64_t               m_packOffset;
+    uint                   m_videoBytesLeft;
+    uint                   m_otherBytesLeft;
+    uint64_t               m_framesSeen;
+    uint64_t               m_lastGopSeen;
+    uint64_t               m_lastSeqSeen;
+    uint64_t               m_lastKeyframeSeen;
+    bool                   m_progressiveSequence;
+    int                    m_repeatPict;
+    H264Parser             m_h264Parser;
+
+    // and to add up the duration
+    FrameRate              m_frameRate;
+    FrameRate              m_tdTickFramerate;
+    double                 m_tdBase;
+    uint64_t               m_tdTickCount;
+    double                 m_totalDuration;
+
+    frm_pos_map_t          m_positionMap;
+    frm_pos_map_t          m_durationMap;
+};
+
+#endif // _SEEK_TABLE_BUILDER_H_
@@ -0,0 +1,467 @@
+/*
+ *  Class TestFrameKernels
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <cstring>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#include "test_framekernels.h"
+
+#include "framekernels.h"
+
+Q_DECLARE_METATYPE(FrameKernels::Implementation)
+
+/// Small deterministic generator, so failures can be reproduced
+class Random
+{
+  public:
+    explicit Random(uint seed) : m_state(seed * 2654435761U + 1) { }
+    uint Next(uint range)
+    {
+        m_state = m_state * 1103515245U + 12345U;
+        return (m_state >> 8) % range;
+    }
+  private:
+    uint m_state;
+};
+
+/// Random pixels, mostly close to a level so ranges and edges vary
+static vector<uint8_t> pixels(int size, uint seed)
+{
+    Random rnd(seed);
+    vector<uint8_t> data(size);
+    int level = rnd.Next(256);
+    for (int i = 0; i < size; i++)
+    {
+        if (rnd.Next(4))
+            data[i] = max(0, min(255, level + (int) rnd.Next(17) - 8));
+        else
+            data[i] = rnd.Next(256);
+    }
+    return data;
+}
+
+static void add_impl_rows(void)
+{
+    QTest::addColumn<FrameKernels::Implementation>("impl");
+    QTest::newRow("scalar") << FrameKernels::kScalar;
+    QTest::newRow("sse2")   << FrameKernels::kSSE2;
+    QTest::newRow("avx2")   << FrameKernels::kAVX2;
+}
+
+// Every count up to a few vectors, to cover all the tails
+static const int kMaxCount = 100;
+
+void TestFrameKernels::RowStats_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::RowStats_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+
+    for (int count = 0; count <= kMaxCount; count++)
+    {
+        vector<uint8_t> row = pixels(count + 1, count);
+        vector<uint8_t> colmax = pixels(count + 1, count + 1000);
+        vector<uint8_t> expectmax = colmax;
+        vector<uint8_t> mask(count + 1, 0xff);
+
+        // a "logo" in the middle of the row
+        for (int i = count / 3; i < count / 2; i++)
+            mask[i] = 0;
+
+        uint8_t lo = 255, hi = 0;
+        uint32_t sum = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (!mask[i])
+                continue;
+            lo = min(lo, row[i]);
+            hi = max(hi, row[i]);
+            sum += row[i];
+            expectmax[i] = max(expectmax[i], row[i]);
+        }
+
+        uint8_t gotlo = 0, gothi = 0;
+        uint32_t gotsum = 0;
+        kernels.rowStats(&row[0], &mask[0], count, &colmax[0],
+                         &gotlo, &gothi, &gotsum);
+
+        QCOMPARE (gotlo, lo);
+        QCOMPARE (gothi, hi);
+        QCOMPARE (gotsum, sum);
+        QVERIFY (colmax == expectmax);
+    }
+}
+
+void TestFrameKernels::Gather_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::Gather_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+
+    for (int step = 1; step <= 5; step++)
+    {
+        for (int count = 0; count <= kMaxCount; count++)
+        {
+            // exactly the pixels read, so nothing past them is needed
+            vector<uint8_t> src = pixels(max(1, (count - 1) * step + 1),
+                                         step * 1000 + count);
+            vector<uint8_t> dst(count + 1, 0);
+            kernels.gather(&src[0], count, step, &dst[0]);
+
+            for (int i = 0; i < count; i++)
+                QCOMPARE (dst[i], src[i * step]);
+            QCOMPARE (dst[count], (uint8_t) 0);
+        }
+    }
+}
+
+void TestFrameKernels::Histogram_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::Histogram_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+
+    for (int count = 0; count <= 4 * kMaxCount; count += 7)
+    {
+        vector<uint8_t> src = pixels(count + 1, count);
+        if (count > 10)
+            src[count / 2] = 255;   // the largest square
+
+        int expect[256], bins[256], binsonly[256];
+        memset(expect, 0, sizeof(expect));
+        uint64_t sum = 11, sumsq = 13;
+        for (int i = 0; i < count; i++)
+        {
+            expect[src[i]]++;
+            sum += src[i];
+            sumsq += src[i] * src[i];
+        }
+
+        // the sums are added to what is already there
+        memset(bins, 0, sizeof(bins));
+        uint64_t gotsum = 11, gotsumsq = 13;
+        kernels.histogram(&src[0], count, bins, &gotsum, &gotsumsq);
+        QCOMPARE (gotsum, sum);
+        QCOMPARE (gotsumsq, sumsq);
+        QVERIFY (!memcmp(bins, expect, sizeof(bins)));
+
+        memset(binsonly, 0, sizeof(binsonly));
+        kernels.histogram(&src[0], count, binsonly, NULL, NULL);
+        QVERIFY (!memcmp(binsonly, expect, sizeof(binsonly)));
+    }
+}
+
+void TestFrameKernels::EdgeFlags_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::EdgeFlags_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+    const FrameKernels::Table &scalar =
+        FrameKernels::Get(FrameKernels::kScalar);
+
+    // one bright pixel on black has an edge in every direction
+    const int pitch = 16;
+    vector<uint8_t> dot(pitch * 7, 0);
+    dot[3 * pitch + 5] = 200;
+    uint8_t flag = 0;
+    kernels.edgeFlags(&dot[3 * pitch + 5], pitch, 1, 2, 100, &flag);
+    QCOMPARE ((int) flag, (int) (FrameKernels::kEdgeHoriz |
+                                 FrameKernels::kEdgeVert |
+                                 FrameKernels::kEdgeLDiag |
+                                 FrameKernels::kEdgeRDiag));
+    kernels.edgeFlags(&dot[3 * pitch + 5], pitch, 1, 2, 201, &flag);
+    QCOMPARE ((int) flag, 0);
+
+    static const int diffs[] = { -5, 0, 1, 8, 32, 255, 256, 1000 };
+    for (int radius = 1; radius <= 3; radius++)
+    {
+        for (uint d = 0; d < sizeof(diffs) / sizeof(diffs[0]); d++)
+        {
+            for (int count = 0; count <= kMaxCount; count += 3)
+            {
+                const int width = count + 2 * radius;
+                const int height = 2 * radius + 1;
+                vector<uint8_t> frame = pixels(max(1, width * height),
+                                               radius * 100 + count);
+                const uint8_t *src = &frame[radius * width + radius];
+
+                vector<uint8_t> expect(count + 1, 0x55);
+                vector<uint8_t> flags(count + 1, 0x55);
+                scalar.edgeFlags(src, width, count, radius, diffs[d],
+                                 &expect[0]);
+                kernels.edgeFlags(src, width, count, radius, diffs[d],
+                                  &flags[0]);
+                if (flags != expect)
+                {
+                    QFAIL(qPrintable(QString("radius %1 diff %2 count %3")
+                                     .arg(radius).arg(diffs[d])
+                                     .arg(count)));
+                }
+            }
+        }
+    }
+}
+
+void TestFrameKernels::Count_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::Count_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+
+    for (int count = 0; count <= 3 * kMaxCount; count++)
+    {
+        vector<uint8_t> a = pixels(count + 1, count);
+        vector<uint8_t> b = pixels(count + 1, count + 5000);
+        // plenty of zeros in both, as in edge maps
+        Random rnd(count);
+        for (int i = 0; i < count; i++)
+        {
+            if (rnd.Next(3) == 0)
+                a[i] = 0;
+            if (rnd.Next(3) == 0)
+                b[i] = 0;
+        }
+
+        uint32_t bits = 0, both = 0;
+        for (int i = 0; i < count; i++)
+        {
+            for (uint8_t x = a[i] & b[i]; x; x >>= 1)
+                bits += x & 1;
+            both += (a[i] && b[i]) ? 1 : 0;
+        }
+
+        QCOMPARE (kernels.countBits(&a[0], &b[0], count), bits);
+        QCOMPARE (kernels.countBoth(&a[0], &b[0], count), both);
+    }
+}
+
+void TestFrameKernels::Gradient_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::Gradient_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+
+    for (int count = 0; count <= kMaxCount; count++)
+    {
+        // full range pixels, for the largest squares
+        Random rnd(count);
+        vector<uint8_t> r0(count + 1), r1(count + 1);
+        for (int i = 0; i <= count; i++)
+        {
+            r0[i] = rnd.Next(2) ? 255 : rnd.Next(256);
+            r1[i] = rnd.Next(2) ? 0 : rnd.Next(256);
+        }
+
+        vector<uint32_t> sgm(count + 1, 7);
+        kernels.gradient(&r0[0], &r1[0], count, &sgm[0]);
+
+        for (int i = 0; i < count; i++)
+        {
+            int dx = r1[i + 1] - r0[i];
+            int dy = r1[i] - r0[i + 1];
+            QCOMPARE (sgm[i], (uint32_t) (dx * dx + dy * dy));
+        }
+        QCOMPARE (sgm[count], (uint32_t) 7);
+    }
+}
+
+void TestFrameKernels::Convolve_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::Convolve_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+    const FrameKernels::Table &scalar =
+        FrameKernels::Get(FrameKernels::kScalar);
+
+    for (int radius = 0; radius <= 4; radius++)
+    {
+        // a gaussian, as pgm_convolve_radial is given
+        vector<double> mask(2 * radius + 1);
+        double total = 0;
+        for (int k = -radius; k <= radius; k++)
+            total += mask[k + radius] = exp(-k * k / 2.0);
+        for (int k = 0; k <= 2 * radius; k++)
+            mask[k] /= total;
+
+        for (int count = 0; count <= kMaxCount; count += 3)
+        {
+            const int width = count + 2 * radius;
+            const int height = 2 * radius + 1;
+            vector<uint8_t> frame = pixels(max(1, width * height),
+                                           radius * 1000 + count);
+            const uint8_t *src = &frame[radius * width + radius];
+
+            // along a row and down a column
+            const int taps[2] = { 1, width };
+            for (int t = 0; t < 2; t++)
+            {
+                const int tap = taps[t];
+                vector<uint8_t> expect(count + 1, 0x55);
+                vector<uint8_t> dst(count + 1, 0x55);
+                scalar.convolve(src, tap, count, &mask[0], radius,
+                                &expect[0]);
+                kernels.convolve(src, tap, count, &mask[0], radius,
+                                 &dst[0]);
+                if (dst != expect)
+                {
+                    QFAIL(qPrintable(QString("radius %1 tap %2 count %3")
+                                     .arg(radius).arg(tap).arg(count)));
+                }
+            }
+        }
+    }
+}
+
+void TestFrameKernels::RangeRun_test_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::RangeRun_test(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+
+    for (uint seed = 1; seed <= 200; seed++)
+    {
+        Random rnd(seed);
+        int count = rnd.Next(3 * kMaxCount);
+        int maxrange = 1 + rnd.Next(48);
+        int level = rnd.Next(256 - maxrange);
+
+        // a bar within the range, broken by an outlier somewhere
+        vector<uint8_t> src(count + 1);
+        for (int i = 0; i <= count; i++)
+            src[i] = level + rnd.Next(maxrange);
+        if (count && rnd.Next(4))
+            src[rnd.Next(count)] = rnd.Next(256);
+
+        // start empty or from the range of an earlier run
+        uint8_t lo = 255, hi = 0;
+        if (rnd.Next(2))
+            lo = hi = level + maxrange / 2;
+
+        uint8_t explo = lo, exphi = hi;
+        int expected = 0;
+        for (; expected < count; expected++)
+        {
+            uint8_t val = src[expected];
+            if (max(exphi, val) - min(explo, val) + 1 > maxrange)
+                break;
+            explo = min(explo, val);
+            exphi = max(exphi, val);
+        }
+
+        int got = kernels.rangeRun(&src[0], count, &lo, &hi, maxrange);
+        QCOMPARE (got, expected);
+        QCOMPARE (lo, explo);
+        QCOMPARE (hi, exphi);
+    }
+}
+
+void TestFrameKernels::EdgeFlags_benchmark_data(void)
+{
+    add_impl_rows();
+}
+
+void TestFrameKernels::EdgeFlags_benchmark(void)
+{
+    QFETCH(FrameKernels::Implementation, impl);
+
+    if (!FrameKernels::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    const FrameKernels::Table &kernels = FrameKernels::Get(impl);
+
+    const int width = 720, height = 576, radius = 2;
+    vector<uint8_t> frame = pixels(max(1, width * height), 1);
+    vector<uint8_t> flags(width);
+
+    QBENCHMARK
+    {
+        for (int y = radius; y < height - radius; y++)
+        {
+            kernels.edgeFlags(&frame[y * width + radius], width,
+                              width - 2 * radius, radius, 32, &flags[0]);
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(TestFrameKernels)
@@ -0,0 +1,79 @@
+/*
+ *  Class TestFrameKernels
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#define MSKIP(MSG) QSKIP(MSG, SkipSingle)
+#else
+#define MSKIP(MSG) QSKIP(MSG)
+#endif
+
+class TestFrameKernels: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    /** test the row statistics of the blank frame check, with masked
+     *  out logo pixels
+     */
+    void RowStats_test_data(void);
+    void RowStats_test(void);
+
+    /** test gathering every step'th pixel
+     */
+    void Gather_test_data(void);
+    void Gather_test(void);
+
+    /** test the histogram and its sums against a plain count
+     */
+    void Histogram_test_data(void);
+    void Histogram_test(void);
+
+    /** test the logo edge flags for each implementation against the
+     *  scalar one, including differences of 0 and above 255
+     */
+    void EdgeFlags_test_data(void);
+    void EdgeFlags_test(void);
+
+    /** test counting matching bits and matching non-zero pixels
+     */
+    void Count_test_data(void);
+    void Count_test(void);
+
+    /** test the squared gradient magnitude of the edge detector
+     */
+    void Gradient_test_data(void);
+    void Gradient_test(void);
+
+    /** test that the vector convolutions round exactly as the scalar
+     *  one does, along rows and down columns
+     */
+    void Convolve_test_data(void);
+    void Convolve_test(void);
+
+    /** test the border detector's runs of pixels within a range
+     */
+    void RangeRun_test_data(void);
+    void RangeRun_test(void);
+
+    /** time the edge flags of a standard definition frame
+     */
+    void EdgeFlags_benchmark_data(void);
+    void EdgeFlags_benchmark(void);
+};
@@ -0,0 +1,205 @@
+/*
+ *  Class TestLiveCommDetector
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "test_livecommdetector.h"
+
+#include <vector>
+using namespace std;
+
+#include "livecommdetector.h"
+
+static const int    kWidth   = 96;
+static const int    kHeight  = 72;
+static const int    kPitch   = kWidth + 32;
+static const int    kFrameMs = 200;
+static const double kFps     = 5.0;
+
+/// Gives a LiveCommAnalyzer the flat frames of a made up recording
+class Recording
+{
+  public:
+    Recording() : m_frame(kPitch * kHeight), m_ms(0), m_scene(0) {}
+
+    /// The show changes scenes every 10 seconds
+    void Show(int seconds, bool logo)
+    {
+        for (int i = 0; i < seconds * 1000 / kFrameMs; i++)
+        {
+            if (!(m_ms % 10000))
+                m_scene++;
+            Add(150 + 10 * (m_scene % 5), logo);
+        }
+    }
+
+    void Commercial(int seconds, uint8_t level)
+    {
+        for (int i = 0; i < seconds * 1000 / kFrameMs; i++)
+            Add(level, false);
+    }
+
+    /// Adds a blank frame and returns its number
+    uint64_t Blank(void)
+    {
+        uint64_t frame = Next();
+        Add(16, false);
+        return frame;
+    }
+
+    uint64_t Next(void) const { return m_ms / kFrameMs; }
+    uint64_t Last(void) const { return Next() - 1; }
+
+    /// A frame of level, with a white square in the top right corner
+    void Add(uint8_t level, bool logo)
+    {
+        std::fill(m_frame.begin(), m_frame.end(), level);
+        if (logo)
+        {
+            for (int y = 6; y < 12; y++)
+                for (int x = 80; x < 86; x++)
+                    m_frame[y * kPitch + x] = 255;
+        }
+        analyzer.AddFrame(&m_frame[0], kPitch, kWidth, kHeight, m_ms);
+        m_ms += kFrameMs;
+    }
+
+    LiveCommAnalyzer analyzer;
+
+  private:
+    vector<uint8_t> m_frame;
+    int64_t         m_ms;
+    int             m_scene;
+};
+
+static void compare(const frm_dir_map_t &breaks,
+                    const vector<uint64_t> &expected)
+{
+    QCOMPARE ((size_t)breaks.size(), expected.size());
+
+    frm_dir_map_t::const_iterator it = breaks.begin();
+    for (uint i = 0; it != breaks.end(); ++it, ++i)
+    {
+        QCOMPARE (it.key(), expected[i]);
+        QCOMPARE (*it, (i & 1) ? MARK_COMM_END : MARK_COMM_START);
+    }
+}
+
+void TestLiveCommDetector::BlankBreak_test(void)
+{
+    Recording rec;
+    vector<uint64_t> expected;
+
+    rec.Show(300, false);
+    expected.push_back(rec.Blank());
+    uint64_t end = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        rec.Commercial(30, 130 + i * 20);
+        end = rec.Blank();
+    }
+    expected.push_back(end);
+    rec.Show(300, false);
+
+    QVERIFY (!rec.analyzer.IsLogoKnown());
+    compare(rec.analyzer.GetBreaks(kFps), expected);
+}
+
+void TestLiveCommDetector::LogoBreak_test(void)
+{
+    Recording rec;
+    vector<uint64_t> expected;
+
+    rec.Show(300, true);
+    rec.Blank();
+    // as long as a commercial, but with the logo
+    rec.Show(30, true);
+    expected.push_back(rec.Blank());
+    // no commercials are this long
+    rec.Commercial(37, 140);
+    rec.Commercial(41, 170);
+    expected.push_back(rec.Blank());
+    rec.Show(200, true);
+
+    QVERIFY (rec.analyzer.IsLogoKnown());
+    compare(rec.analyzer.GetBreaks(kFps), expected);
+}
+
+void TestLiveCommDetector::EdgeBreak_test(void)
+{
+    Recording rec;
+    vector<uint64_t> expected;
+
+    expected.push_back(0);
+    rec.Commercial(20, 140);
+    expected.push_back(rec.Blank());
+    rec.Show(300, false);
+    expected.push_back(rec.Blank());
+    rec.Commercial(15, 140);
+    expected.push_back(rec.Last());
+
+    compare(rec.analyzer.GetBreaks(kFps), expected);
+}
+
+void TestLiveCommDetector::ShortBreak_test(void)
+{
+    Recording rec;
+
+    rec.Show(300, false);
+    rec.Blank();
+    rec.Commercial(30, 140);
+    rec.Blank();
+    rec.Show(300, false);
+
+    compare(rec.analyzer.GetBreaks(kFps), vector<uint64_t>());
+}
+
+void TestLiveCommDetector::FrameFlags_test(void)
+{
+    Recording rec;
+
+    rec.Add(16, false);
+    rec.Add(150, false);
+    rec.Add(200, false);
+    rec.Add(150, false);
+    rec.Add(200, false);
+    rec.Add(200, false);
+    // dark and flat enough to be blank
+    rec.Add(100, false);
+    rec.Add(16, true);
+
+    static const uint flags[] =
+    {
+        LiveCommAnalyzer::kBlank,
+        0,
+        LiveCommAnalyzer::kSceneChange,
+        0,
+        LiveCommAnalyzer::kSceneChange,
+        0,
+        LiveCommAnalyzer::kBlank,
+        LiveCommAnalyzer::kSceneChange,
+    };
+
+    QCOMPARE (rec.analyzer.GetFrameCount(), (uint64_t)8);
+    for (uint i = 0; i < 8; i++)
+        QCOMPARE (rec.analyzer.GetFlags(i), flags[i]);
+
+    // frames not after the last one are ignored
+    rec.analyzer.AddFrame(NULL, kPitch, kWidth, kHeight, 0);
+    QCOMPARE (rec.analyzer.GetFrameCount(), (uint64_t)8);
+}
+
+QTEST_APPLESS_MAIN(TestLiveCommDetector)
@@ -0,0 +1,51 @@
+/*
+ *  Class TestLiveCommDetector
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#define MSKIP(MSG) QSKIP(MSG, SkipSingle)
+#else
+#define MSKIP(MSG) QSKIP(MSG)
+#endif
+
+class TestLiveCommDetector: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    /** test that a break between blank frames is found from the length
+     *  of its commercials when there is no logo
+     */
+    void BlankBreak_test(void);
+
+    /** test that once the logo is learned, what does not show it is a
+     *  commercial and what does is not, whatever its length
+     */
+    void LogoBreak_test(void);
+
+    /** test that short breaks are only taken at the start and end of
+     *  the recording
+     */
+    void EdgeBreak_test(void);
+    void ShortBreak_test(void);
+
+    /** test the frames found to be blank and scene changes
+     */
+    void FrameFlags_test(void);
+};
@@ -0,0 +1,379 @@
+/*
+ *  Class TestMPEGStreamData
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "test_mpegstreamdata.h"
+
+#include "mpegstreamdata.h"
+#include "mpegtables.h"
+#include "sectionworkerpool.h"
+
+static const uint kPrograms = 4;
+static const uint kPacketsPerProgram = 2000;
+
+/// Records which packets arrive on which callback
+class AVRecorder : public TSPacketListenerAV, public TSPacketListener
+{
+  public:
+    AVRecorder() : m_video(0), m_audio(0), m_other(0), m_keep(false) { }
+    bool ProcessVideoTSPacket(const TSPacket &tspacket)
+    {
+        m_video++;
+        if (m_keep)
+            m_order.push_back((tspacket.PID() << 4) | 1);
+        return true;
+    }
+    bool ProcessAudioTSPacket(const TSPacket &tspacket)
+    {
+        m_audio++;
+        if (m_keep)
+            m_order.push_back((tspacket.PID() << 4) | 2);
+        return true;
+    }
+    bool ProcessTSPacket(const TSPacket &tspacket)
+    {
+        m_other++;
+        if (m_keep)
+            m_order.push_back((tspacket.PID() << 4) | 4);
+        return true;
+    }
+
+    uint         m_video;
+    uint         m_audio;
+    uint         m_other;
+    bool         m_keep;
+    vector<uint> m_order;
+};
+
+/// Records the sections it is handed, once it has been let go
+class SectionRecorder : public SectionHandler
+{
+  public:
+    SectionRecorder() : m_open(false) { }
+    void HandleQueuedTable(uint, const PSIPTable &psip)
+    {
+        QMutexLocker locker(&m_lock);
+        while (!m_open)
+            m_wait.wait(&m_lock);
+        m_seen.push_back((psip.TableID() << 24) |
+                         (psip.TableIDExtension() << 8) | psip.Section());
+    }
+    void Open(void)
+    {
+        QMutexLocker locker(&m_lock);
+        m_open = true;
+        m_wait.wakeAll();
+    }
+
+    QMutex         m_lock;
+    QWaitCondition m_wait;
+    bool           m_open;
+    vector<uint>   m_seen;
+};
+
+static PSIPTable *make_section(uint table_id, uint ext, uint section)
+{
+    vector<uint> pnums(1, 1), pids(1, 0x100);
+    PSIPTable *psip = ProgramAssociationTable::Create(ext, 0, pnums, pids);
+    psip->SetTableID(table_id);
+    psip->SetSection(section);
+    psip->SetLastSection(0xff);
+    return psip;
+}
+
+static void append_packets(QByteArray &mux, const PSIPTable &psip, uint &cc)
+{
+    vector<TSPacket> pkts;
+    psip.GetAsTSPackets(pkts, cc);
+    for (uint i = 0; i < pkts.size(); i++)
+        mux.append((const char*)pkts[i].data(), TSPacket::kSize);
+    cc = (cc + pkts.size()) & 0xf;
+}
+
+/// Builds a mux of kPrograms programs, each with one video and one
+/// audio PID plus null packets, with the tables repeated.
+static QByteArray make_mux(void)
+{
+    QByteArray mux;
+    vector<uint> pnums, pids;
+    for (uint p = 1; p <= kPrograms; p++)
+    {
+        pnums.push_back(p);
+        pids.push_back(0x100 * p);
+    }
+
+    ProgramAssociationTable *pat =
+        ProgramAssociationTable::Create(1, 0, pnums, pids);
+    vector<ProgramMapTable*> pmts;
+    for (uint p = 1; p <= kPrograms; p++)
+    {
+        vector<uint> spids, types;
+        spids.push_back(VIDEO_PID(0x100 * p));
+        types.push_back(StreamID::MPEG2Video);
+        spids.push_back(AUDIO_PID(0x100 * p));
+        types.push_back(StreamID::MPEG2Audio);
+        pmts.push_back(ProgramMapTable::Create(
+                           p, 0x100 * p, VIDEO_PID(0x100 * p), 0,
+                           spids, types));
+    }
+
+    uint table_cc = 0;
+    uint cc[0x2000];
+    memset(cc, 0, sizeof(cc));
+    TSPacket pkt;
+    memset(pkt.data(), 0xff, TSPacket::kSize);
+
+    for (uint i = 0; i < kPacketsPerProgram; i++)
+    {
+        if (i % 500 == 0)
+        {
+            append_packets(mux, *pat, table_cc);
+            for (uint p = 0; p < pmts.size(); p++)
+                append_packets(mux, *pmts[p], table_cc);
+        }
+
+        for (uint p = 1; p <= kPrograms; p++)
+        {
+            // bursty video as seen in real muxes, then audio
+            uint vpid = VIDEO_PID(0x100 * p);
+            uint apid = AUDIO_PID(0x100 * p);
+            uint npkts = (i % 8 == 0) ? 2 : 1;
+            for (uint j = 0; j < 4 * npkts; j++)
+            {
+                pkt.InitHeader(TSHeader::kPayloadOnlyHeader);
+                pkt.SetPID(vpid);
+                pkt.SetContinuityCounter(cc[vpid]++ & 0xf);
+                mux.append((const char*)pkt.data(), TSPacket::kSize);
+            }
+            pkt.InitHeader(TSHeader::kPayloadOnlyHeader);
+            pkt.SetPID(apid);
+            pkt.SetContinuityCounter(cc[apid]++ & 0xf);
+            mux.append((const char*)pkt.data(), TSPacket::kSize);
+        }
+
+        pkt.InitHeader(TSHeader::kPayloadOnlyHeader);
+        pkt.SetPID(0x1fff);
+        mux.append((const char*)pkt.data(), TSPacket::kSize);
+    }
+
+    delete pat;
+    for (uint p = 0; p < pmts.size(); p++)
+        delete pmts[p];
+
+    return mux;
+}
+
+/// Feeds the mux through ProcessData in chunks the size of a
+/// DeviceReadBuffer read, carrying over partial packets.
+static void feed(MPEGStreamData &sd, const QByteArray &mux)
+{
+    const uint kChunk = 188 * 348;
+    const unsigned char *data = (const unsigned char*)mux.constData();
+    uint len = mux.size();
+    uint pos = 0;
+    while (pos < len)
+    {
+        uint sz = min(kChunk, len - pos);
+        int remainder = sd.ProcessData(data + pos, sz);
+        if (remainder >= (int)sz)
+            break;
+        pos += sz - max(remainder, 0);
+    }
+}
+
+void TestMPEGStreamData::initTestCase(void)
+{
+    QString path = QString::fromLocal8Bit(qgetenv("MYTHTV_TEST_TS"));
+    if (!path.isEmpty())
+    {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly))
+            m_mux = file.readAll();
+    }
+    if (m_mux.isEmpty())
+        m_mux = make_mux();
+}
+
+void TestMPEGStreamData::PIDFlags_test(void)
+{
+    MPEGStreamData sd(-1, 0, false);
+
+    QVERIFY (sd.IsListeningPID(MPEG_PAT_PID));
+    QVERIFY (!sd.IsListeningPID(0x101));
+    QVERIFY (!sd.IsAudioPID(0x104));
+
+    sd.AddListeningPID(0x100);
+    sd.AddAudioPID(0x104);
+    sd.AddWritingPID(0x105);
+    QVERIFY (sd.IsListeningPID(0x100));
+    QVERIFY (sd.IsAudioPID(0x104));
+    QVERIFY (sd.IsWritingPID(0x105));
+    QVERIFY (!sd.IsWritingPID(0x104));
+
+    sd.AddNotListeningPID(0x100);
+    QVERIFY (!sd.IsListeningPID(0x100));
+    sd.RemoveNotListeningPID(0x100);
+    QVERIFY (sd.IsListeningPID(0x100));
+
+    sd.SetListeningDisabled(true);
+    QVERIFY (!sd.IsListeningPID(0x100));
+    sd.SetListeningDisabled(false);
+
+    sd.RemoveListeningPID(0x100);
+    sd.RemoveAudioPID(0x104);
+    QVERIFY (!sd.IsListeningPID(0x100));
+    QVERIFY (!sd.IsAudioPID(0x104));
+    QVERIFY (sd.IsWritingPID(0x105));
+
+    // out of range PIDs must not alias a real PID
+    sd.AddListeningPID(0x2000);
+    sd.RemoveListeningPID(0x2000);
+    QVERIFY (sd.IsListeningPID(MPEG_PAT_PID));
+
+    sd.Reset();
+    QVERIFY (!sd.IsWritingPID(0x105));
+    QVERIFY (sd.IsListeningPID(MPEG_PAT_PID));
+}
+
+void TestMPEGStreamData::BatchEquivalence_test(void)
+{
+    QByteArray mux = make_mux();
+
+    // Corrupt a few bytes so both resync paths are exercised too
+    mux[188 * 100 + 7] = 0x47;
+    // a failing packet followed by one without a sync byte
+    mux[188 * 2000 + 1] = char(mux[188 * 2000 + 1] | 0x80);
+    mux[188 * 2001] = 0;
+    mux.remove(188 * 5000 + 3, 17);
+    mux[188 * 9000 + 1] = char(mux[188 * 9000 + 1] | 0x80);
+
+    AVRecorder unbatched, batched;
+    unbatched.m_keep = batched.m_keep = true;
+
+    MPEGStreamData sd0(1, 0, false);
+    sd0.AddAVListener(&unbatched);
+    sd0.AddWritingListener(&unbatched);
+    feed(sd0, mux);
+
+    MPEGStreamData sd1(1, 0, false);
+    sd1.SetBatchProcessing(true);
+    sd1.AddAVListener(&batched);
+    sd1.AddWritingListener(&batched);
+    feed(sd1, mux);
+
+    QVERIFY (unbatched.m_video > 0);
+    QVERIFY (unbatched.m_audio > 0);
+    QCOMPARE (batched.m_video, unbatched.m_video);
+    QCOMPARE (batched.m_audio, unbatched.m_audio);
+    QCOMPARE (batched.m_other, unbatched.m_other);
+
+    // With a single listener the runs arrive in stream order
+    QVERIFY (batched.m_order == unbatched.m_order);
+}
+
+void TestMPEGStreamData::SectionWorkers_test(void)
+{
+    SectionRecorder handler;
+    SectionWorkerPool pool(&handler, "test", 3, 4);
+
+    // EIT schedule for two services, present/following for one
+    vector<PSIPTable*> sections;
+    for (uint i = 0; i < 6; i++)
+    {
+        sections.push_back(make_section(TableID::SC_EITbeg, 1, i));
+        sections.push_back(make_section(TableID::SC_EITbeg, 2, i));
+    }
+    sections.push_back(make_section(TableID::PF_EIT, 1, 0));
+
+    uint accepted = 0, refused = 0;
+    for (uint i = 0; i < sections.size(); i++)
+    {
+        if (pool.Enqueue(0x12, *sections[i]))
+            accepted++;
+        else
+            refused++;
+    }
+
+    // repeats of a queued section are not queued again
+    QVERIFY (pool.Enqueue(0x12, *sections[0]));
+    QVERIFY (pool.Enqueue(0x12, *sections.back()));
+
+    QCOMPARE (accepted, 5U);
+    QCOMPARE (refused, 8U);
+    QCOMPARE (pool.GetQueued(TableID::SC_EITbeg), 4U);
+    QCOMPARE (pool.GetQueued(TableID::PF_EIT), 1U);
+    QCOMPARE (pool.GetDropped(), (uint64_t) 8);
+
+    handler.Open();
+    QVERIFY (pool.WaitForIdle(10000));
+    QCOMPARE (pool.GetQueued(), 0U);
+    QCOMPARE (handler.m_seen.size(), (size_t) 5);
+
+    // the refused ones are taken once there is room again
+    for (uint i = 4; i < 12; i++)
+    {
+        while (!pool.Enqueue(0x12, *sections[i]))
+            QVERIFY (pool.WaitForIdle(10000));
+    }
+    QVERIFY (pool.WaitForIdle(10000));
+    QCOMPARE (handler.m_seen.size(), (size_t) 13);
+
+    // sections of each table were handled in the order queued
+    QMap<uint, int> last;
+    for (uint i = 0; i < handler.m_seen.size(); i++)
+    {
+        uint table = handler.m_seen[i] >> 8;
+        int section = handler.m_seen[i] & 0xff;
+        if (last.contains(table))
+            QVERIFY (section > last[table]);
+        last[table] = section;
+    }
+    QCOMPARE (last.size(), 3);
+
+    for (uint i = 0; i < sections.size(); i++)
+        delete sections[i];
+}
+
+void TestMPEGStreamData::ProcessData_benchmark_data(void)
+{
+    QTest::addColumn<bool>("batch");
+    QTest::newRow("per-packet") << false;
+    QTest::newRow("batch")      << true;
+}
+
+void TestMPEGStreamData::ProcessData_benchmark(void)
+{
+    QFETCH(bool, batch);
+
+    AVRecorder listener;
+    MPEGStreamData sd(1, 0, false);
+    sd.SetBatchProcessing(batch);
+    sd.AddAVListener(&listener);
+    sd.AddWritingListener(&listener);
+
+    // Let the tables settle so every iteration does the same work
+    feed(sd, m_mux);
+
+    QBENCHMARK
+    {
+        feed(sd, m_mux);
+    }
+
+    QVERIFY (listener.m_video + listener.m_audio > 0);
+}
+
+QTEST_APPLESS_MAIN(TestMPEGStreamData)
@@ -0,0 +1,58 @@
+/*
+ *  Class TestMPEGStreamData
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#define MSKIP(MSG) QSKIP(MSG, SkipSingle)
+#else
+#define MSKIP(MSG) QSKIP(MSG)
+#endif
+
+class TestMPEGStreamData: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase(void);
+
+    /** test that the PID table follows Add/Remove*PID
+     */
+    void PIDFlags_test(void);
+
+    /** test that batch mode hands the listeners the same packets
+     *  in the same order as the per-packet path
+     */
+    void BatchEquivalence_test(void);
+
+    /** test that the section workers keep each table in order,
+     *  skip repeats and refuse sections of a table id that has
+     *  too many queued without holding up the others
+     */
+    void SectionWorkers_test(void);
+
+    /** micro-benchmark ProcessData over a multi-program TS.
+     *  Set MYTHTV_TEST_TS to the path of a captured mux to use
+     *  it instead of the synthetic one.
+     */
+    void ProcessData_benchmark_data(void);
+    void ProcessData_benchmark(void);
+
+  private:
+    QByteArray m_mux;
+};
@@ -23,6 +23,7 @@
 #include "atsctables.h"
 #include "mpegtables.h"
 #include "dvbtables.h"
+#include "mpegcrc.h"
 
 void TestMPEGTables::pat_test(void)
 {
@@ -369,4 +370,91 @@ void TestMPEGTables::OTAChannelName_test (void)
     QCOMPARE (tvct.GetExtendedChannelName(999), QString());
 }
 
+Q_DECLARE_METATYPE(MPEGCRC::Implementation)
+
+void TestMPEGTables::CRC_test_data(void)
+{
+    QTest::addColumn<MPEGCRC::Implementation>("impl");
+    QTest::newRow("slice-by-8") << MPEGCRC::kSliceBy8;
+    QTest::newRow("pclmul")     << MPEGCRC::kPCLMUL;
+    QTest::newRow("auto")       << MPEGCRC::kAuto;
+}
+
+void TestMPEGTables::CRC_test(void)
+{
+    QFETCH(MPEGCRC::Implementation, impl);
+
+    if (!MPEGCRC::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    // the check value of CRC-32/MPEG-2
+    const unsigned char check[] = "123456789";
+    QCOMPARE (MPEGCRC::Calc(impl, check, 9), (uint32_t) 0x0376E6E7);
+    QCOMPARE (MPEGCRC::Calc(MPEGCRC::kAVCRC, check, 9),
+              (uint32_t) 0x0376E6E7);
+
+    // real sections end in their CRC
+    const PSIPTable eit(eit_data_0000);
+    QCOMPARE (MPEGCRC::Calc(impl, eit.pesdata(), eit.Length() - 1),
+              eit.CRC());
+    const PSIPTable tvct(tvct_data_0000);
+    QCOMPARE (MPEGCRC::Calc(impl, tvct.pesdata(), tvct.Length() - 1),
+              tvct.CRC());
+
+    QByteArray data(4200, 0);
+    uint32_t seed = 1;
+    for (int i = 0; i < data.size(); i++)
+    {
+        seed = seed * 1103515245U + 12345U;
+        data[i] = char(seed >> 16);
+    }
+    const unsigned char *buf =
+        reinterpret_cast<const unsigned char*>(data.constData());
+
+    for (uint off = 0; off < 16; off += 5)
+    {
+        for (uint len = 0; len < 4096; len += (len < 300) ? 1 : 61)
+        {
+            uint32_t init = (len & 1) ? 0xFFFFFFFF : (len * 2654435761U);
+            uint32_t expected =
+                MPEGCRC::Calc(MPEGCRC::kAVCRC, buf + off, len, init);
+            uint32_t got = MPEGCRC::Calc(impl, buf + off, len, init);
+            if (got != expected)
+            {
+                QFAIL(qPrintable(QString("len %1 offset %2: 0x%3 != 0x%4")
+                                 .arg(len).arg(off).arg(got, 8, 16)
+                                 .arg(expected, 8, 16)));
+            }
+        }
+    }
+}
+
+void TestMPEGTables::CRC_benchmark_data(void)
+{
+    QTest::addColumn<MPEGCRC::Implementation>("impl");
+    QTest::newRow("av_crc")     << MPEGCRC::kAVCRC;
+    QTest::newRow("slice-by-8") << MPEGCRC::kSliceBy8;
+    QTest::newRow("pclmul")     << MPEGCRC::kPCLMUL;
+}
+
+void TestMPEGTables::CRC_benchmark(void)
+{
+    QFETCH(MPEGCRC::Implementation, impl);
+
+    if (!MPEGCRC::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    QByteArray data(1021, 0x5a);
+    const unsigned char *buf =
+        reinterpret_cast<const unsigned char*>(data.constData());
+
+    uint32_t crc = 0;
+    QBENCHMARK
+    {
+        crc = MPEGCRC::Calc(impl, buf, data.size());
+    }
+
+    QCOMPARE (crc, MPEGCRC::Calc(MPEGCRC::kAVCRC, buf, data.size()));
+}
+
 QTEST_APPLESS_MAIN(TestMPEGTables)
@@ -80,4 +80,15 @@ class TestMPEGTables: public QObject
     /** test US channel names for trailing \0 characters, #12612
       */
     void OTAChannelName_test (void);
+
+    /** test that every CRC implementation agrees with av_crc on
+     *  real sections and on any length, alignment and start value
+     */
+    void CRC_test_data (void);
+    void CRC_test (void);
+
+    /** CRC throughput on a typical EIT section size
+     */
+    void CRC_benchmark_data (void);
+    void CRC_benchmark (void);
 };
@@ -0,0 +1,277 @@
+/*
+ *  Class TestSeekIndex
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <unistd.h>
+
+#include <QDir>
+#include <QFile>
+
+#include "test_seekindex.h"
+
+#include "seekindex.h"
+#include "seektable.h"
+#include "mythcorecontext.h"
+
+/// A keyframe every 12 frames, 8 bytes a frame, 40 ms a frame
+static void make_maps(long long first, long long count,
+                      frm_pos_map_t &posMap, frm_pos_map_t &durMap)
+{
+    for (long long i = first; i < first + count; i++)
+    {
+        posMap[i * 12] = i * 12 * 8;
+        durMap[i * 12] = i * 12 * 40;
+    }
+}
+
+/// The QMap interpolation DecoderBase::TranslatePosition used to do
+static uint64_t reference_translate(const frm_pos_map_t &map, long long key,
+                                    float fallback_ratio)
+{
+    uint64_t key1 = 0, val1 = 0;
+    frm_pos_map_t::const_iterator lower = map.lowerBound(key);
+    if (lower != map.begin() && (lower == map.end() || lower.key() > key))
+        --lower;
+    if (lower != map.end() && lower.key() <= key)
+    {
+        key1 = lower.key();
+        val1 = lower.value();
+    }
+
+    frm_pos_map_t::const_iterator upper = map.lowerBound(key);
+    if (upper == map.end())
+        return val1 + fallback_ratio * (key - key1) + 0.5;
+
+    uint64_t key2 = upper.key();
+    uint64_t val2 = upper.value();
+    if (key1 == key2)
+        return val2;
+    return val1 + (double) (key - key1) * (val2 - val1) / (key2 - key1) + 0.5;
+}
+
+void TestSeekIndex::initTestCase(void)
+{
+    gCoreContext = new MythCoreContext("bin_version", NULL);
+
+    m_dir = QDir::tempPath() + QString("/test_seekindex_%1").arg(getpid());
+    QVERIFY (QDir().mkpath(m_dir));
+}
+
+void TestSeekIndex::cleanupTestCase(void)
+{
+    QDir dir(m_dir);
+    QStringList files = dir.entryList(QDir::Files);
+    for (int i = 0; i < files.size(); i++)
+        dir.remove(files[i]);
+    QDir().rmdir(m_dir);
+
+    delete gCoreContext;
+    gCoreContext = NULL;
+}
+
+void TestSeekIndex::RoundTrip_test(void)
+{
+    QString fname = SeekIndex::GetFilename(m_dir + "/roundtrip.ts");
+    QCOMPARE (fname, m_dir + "/roundtrip.ts.seek");
+
+    frm_pos_map_t posMap, durMap;
+    make_maps(0, 1000, posMap, durMap);
+
+    SeekIndexWriter writer(fname);
+    QVERIFY (writer.Open());
+    writer.Append(posMap, MARK_GOP_BYFRAME);
+    writer.Append(durMap, MARK_DURATION_MS);
+    writer.Close();
+
+    SeekIndexReader reader(fname);
+    QVERIFY (reader.Open());
+    QCOMPARE (reader.GetCount(), 2000U);
+    QCOMPARE (reader.GetPositionMapType(), MARK_GOP_BYFRAME);
+
+    frm_pos_map_t readPos, readDur;
+    QCOMPARE (reader.Read(0, &readPos, MARK_GOP_BYFRAME, &readDur), 2000U);
+    QVERIFY (readPos == posMap);
+    QVERIFY (readDur == durMap);
+
+    // a type that is not in the file reads nothing
+    readPos.clear();
+    reader.Read(0, &readPos, MARK_KEYFRAME, NULL);
+    QVERIFY (readPos.empty());
+}
+
+void TestSeekIndex::Refresh_test(void)
+{
+    QString fname = SeekIndex::GetFilename(m_dir + "/refresh.ts");
+
+    frm_pos_map_t pos1, dur1, pos2, dur2;
+    make_maps(0, 100, pos1, dur1);
+    make_maps(100, 50, pos2, dur2);
+
+    SeekIndexWriter writer(fname);
+    QVERIFY (writer.Open());
+    writer.Append(pos1, MARK_GOP_BYFRAME);
+    writer.Append(dur1, MARK_DURATION_MS);
+    writer.Flush();
+
+    SeekIndexReader reader(fname);
+    QVERIFY (reader.Open());
+    frm_pos_map_t readPos, readDur;
+    uint next = reader.Read(0, &readPos, MARK_GOP_BYFRAME, &readDur);
+    QCOMPARE (next, 200U);
+    QVERIFY (readPos == pos1);
+
+    // nothing new yet
+    QVERIFY (!reader.Refresh());
+
+    writer.Append(pos2, MARK_GOP_BYFRAME);
+    writer.Append(dur2, MARK_DURATION_MS);
+    writer.Flush();
+
+    QVERIFY (reader.Refresh());
+    readPos.clear();
+    readDur.clear();
+    QCOMPARE (reader.Read(next, &readPos, MARK_GOP_BYFRAME, &readDur), 300U);
+    QVERIFY (readPos == pos2);
+    QVERIFY (readDur == dur2);
+}
+
+void TestSeekIndex::TornRecord_test(void)
+{
+    QString fname = SeekIndex::GetFilename(m_dir + "/torn.ts");
+
+    frm_pos_map_t posMap, durMap;
+    make_maps(0, 10, posMap, durMap);
+
+    SeekIndexWriter writer(fname);
+    QVERIFY (writer.Open());
+    writer.Append(posMap, MARK_GOP_BYFRAME);
+    writer.Close();
+
+    // half a record, then a whole one of zeros
+    QFile file(fname);
+    QVERIFY (file.open(QIODevice::WriteOnly | QIODevice::Append));
+    QByteArray zeros(sizeof(SeekIndexRecord) + 10, 0);
+    file.write(zeros);
+    file.close();
+
+    SeekIndexReader reader(fname);
+    QVERIFY (reader.Open());
+    QCOMPARE (reader.GetCount(), 10U);
+
+    frm_pos_map_t readPos;
+    reader.Read(0, &readPos, MARK_GOP_BYFRAME, NULL);
+    QVERIFY (readPos == posMap);
+}
+
+void TestSeekIndex::Translate_test(void)
+{
+    // uneven steps, starting past zero like a recording joined late
+    frm_pos_map_t frameToDur, durToFrame;
+    SeekTable table;
+    long long frame = 50, ms = 1700;
+    for (uint i = 0; i < 500; i++)
+    {
+        frameToDur[frame] = ms;
+        durToFrame[ms] = frame;
+        table.Insert(frame, ms);
+        frame += 1 + (i * 7) % 31;
+        ms += 20 + (i * 13) % 47;
+    }
+    QCOMPARE (table.size(), (size_t) 500);
+
+    for (long long key = 0; key < frame + 100; key++)
+    {
+        QCOMPARE (table.Translate(key, 40.0f),
+                  reference_translate(frameToDur, key, 40.0f));
+    }
+    for (long long val = 0; val < ms + 1000; val++)
+    {
+        QCOMPARE (table.TranslateValue(val, 0.025f),
+                  reference_translate(durToFrame, val, 0.025f));
+    }
+
+    // an empty table falls back to the ratio alone
+    SeekTable empty;
+    QCOMPARE (empty.Translate(100, 40.0f), (uint64_t) 4000);
+
+    // an out of order insert lands in place and a repeat replaces
+    table.Insert(49, 1);
+    table.Insert(50, 2);
+    QCOMPARE (table.size(), (size_t) 501);
+    QCOMPARE (table[0].key, (int64_t) 49);
+    QCOMPARE (table[1].value, (int64_t) 2);
+}
+
+void TestSeekIndex::Load_benchmark_data(void)
+{
+    QTest::addColumn<bool>("table");
+    QTest::newRow("qmap")      << false;
+    QTest::newRow("seektable") << true;
+}
+
+void TestSeekIndex::Load_benchmark(void)
+{
+    QFETCH(bool, table);
+
+    // four hours at 25 fps, a keyframe every 12 frames
+    QString fname = SeekIndex::GetFilename(m_dir + "/bench.ts");
+    frm_pos_map_t posMap, durMap;
+    make_maps(0, 4 * 3600 * 25 / 12, posMap, durMap);
+
+    SeekIndexWriter writer(fname);
+    QVERIFY (writer.Open());
+    writer.Append(posMap, MARK_GOP_BYFRAME);
+    writer.Append(durMap, MARK_DURATION_MS);
+    writer.Close();
+
+    SeekIndexReader reader(fname);
+    QVERIFY (reader.Open());
+
+    uint64_t ms = 0;
+    QBENCHMARK
+    {
+        const SeekIndexRecord *recs = reader.GetRecords();
+        if (table)
+        {
+            SeekTable durTable;
+            durTable.Reserve(durMap.size());
+            for (uint i = 0; i < reader.GetCount(); i++)
+            {
+                if (recs[i].type == (uint32_t) MARK_DURATION_MS)
+                    durTable.Insert(recs[i].mark, recs[i].offset);
+            }
+            ms = durTable.TranslateValue(3600 * 1000, 0.025f);
+        }
+        else
+        {
+            frm_pos_map_t frameToDur, durToFrame;
+            for (uint i = 0; i < reader.GetCount(); i++)
+            {
+                if (recs[i].type == (uint32_t) MARK_DURATION_MS)
+                {
+                    frameToDur[recs[i].mark] = recs[i].offset;
+                    durToFrame[recs[i].offset] = recs[i].mark;
+                }
+            }
+            ms = reference_translate(durToFrame, 3600 * 1000, 0.025f);
+        }
+    }
+
+    QCOMPARE (ms, (uint64_t) 3600 * 25);
+}
+
+QTEST_APPLESS_MAIN(TestSeekIndex)
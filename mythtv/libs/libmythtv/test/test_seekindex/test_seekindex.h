@@ -0,0 +1,61 @@
+/*
+ *  Class TestSeekIndex
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#define MSKIP(MSG) QSKIP(MSG, SkipSingle)
+#else
+#define MSKIP(MSG) QSKIP(MSG)
+#endif
+
+class TestSeekIndex: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase(void);
+    void cleanupTestCase(void);
+
+    /** test that what the writer appends is read back per type
+     */
+    void RoundTrip_test(void);
+
+    /** test that a reader picks up records appended after it
+     *  mapped the file, and only those when asked
+     */
+    void Refresh_test(void);
+
+    /** test that a torn record at the end is not returned
+     */
+    void TornRecord_test(void);
+
+    /** test that SeekTable interpolates and extrapolates in both
+     *  directions like the QMap lookup it replaced
+     */
+    void Translate_test(void);
+
+    /** time loading a four hour position map from a seek index into
+     *  the QMaps the DB path uses and into a SeekTable
+     */
+    void Load_benchmark_data(void);
+    void Load_benchmark(void);
+
+  private:
+    QString m_dir;
+};
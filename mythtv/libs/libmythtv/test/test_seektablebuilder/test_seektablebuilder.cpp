@@ -0,0 +1,272 @@
+/*
+ *  Class TestSeekTableBuilder
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "test_seektablebuilder.h"
+
+#include "seektablebuilder.h"
+#include "mpegtables.h"
+#include "tspacket.h"
+
+static const uint kVideoPID = 0x100;
+static const uint kGOPs     = 4;
+static const uint kGOPSize  = 12;
+
+/// A stream and the maps DTVRecorder would have written for it
+typedef struct
+{
+    QByteArray    data;
+    frm_pos_map_t posMap;
+    frm_pos_map_t durMap;
+    uint64_t      frames;
+    uint64_t      duration;
+} Stream;
+
+static void append(QByteArray &buf, const char *bytes, int len)
+{
+    buf.append(QByteArray(bytes, len));
+}
+
+/** The elementary stream of one frame at 25 fps, a GOP starts with a
+ *  sequence header and a GOP header. The slice is long enough to
+ *  spread the frame over a few transport packets.
+ */
+static QByteArray es_frame(bool keyframe)
+{
+    static const char seq[] = { 0, 0, 1, (char)0xb3,
+                                0x2d, 0x02, 0x40, 0x23,
+                                (char)0xff, (char)0xff, (char)0xe0, 0x18 };
+    static const char gop[] = { 0, 0, 1, (char)0xb8, 0x00, 0x08, 0x00, 0x00 };
+    static const char ipic[] = { 0, 0, 1, 0x00, 0x00, 0x0f, (char)0xff,
+                                 (char)0xf8 };
+    static const char ppic[] = { 0, 0, 1, 0x00, 0x00, 0x10, (char)0xff,
+                                 (char)0xf8 };
+    static const char slice[] = { 0, 0, 1, 0x01 };
+
+    QByteArray es;
+    if (keyframe)
+    {
+        append(es, seq, sizeof(seq));
+        append(es, gop, sizeof(gop));
+        append(es, ipic, sizeof(ipic));
+    }
+    else
+    {
+        append(es, ppic, sizeof(ppic));
+    }
+    append(es, slice, sizeof(slice));
+    es.append(QByteArray(400, 0x5a));
+    return es;
+}
+
+/** MPEG-2 video in a transport stream, a PES packet a frame, with
+ *  garbage bytes before the first packet of each GOP.
+ */
+static Stream make_ts(uint garbage)
+{
+    static const char pes[] = { 0, 0, 1, (char)0xe0, 0, 0,
+                                (char)0x80, 0x00, 0x00 };
+    Stream s;
+    s.frames = kGOPs * kGOPSize;
+    s.duration = s.frames * 40;
+
+    uint cc = 0;
+    for (uint frame = 0; frame < s.frames; frame++)
+    {
+        bool keyframe = !(frame % kGOPSize);
+        if (keyframe)
+        {
+            s.data.append(QByteArray(garbage, 0x00));
+            s.posMap[frame] = s.data.size();
+            s.durMap[frame] = frame * 40;
+        }
+
+        QByteArray payload;
+        append(payload, pes, sizeof(pes));
+        payload.append(es_frame(keyframe));
+        // stuffing at the end of the ES is ignored by the decoder
+        int packets = (payload.size() + TSPacket::kPayloadSize - 1) /
+            TSPacket::kPayloadSize;
+        payload.append(QByteArray(packets * TSPacket::kPayloadSize -
+                                  payload.size(), (char)0xff));
+
+        for (int i = 0; i < packets; i++)
+        {
+            char header[4] = { (char)SYNC_BYTE,
+                               (char)((i ? 0x00 : 0x40) | (kVideoPID >> 8)),
+                               (char)(kVideoPID & 0xff),
+                               (char)(0x10 | (cc++ & 0xf)) };
+            append(s.data, header, sizeof(header));
+            s.data.append(payload.mid(i * TSPacket::kPayloadSize,
+                                      TSPacket::kPayloadSize));
+        }
+    }
+    return s;
+}
+
+/** MPEG-2 video in a program stream, a pack a frame holding the video
+ *  and an audio PES packet full of things that look like start codes.
+ */
+static Stream make_ps(void)
+{
+    static const char pack[] = { 0, 0, 1, (char)0xba,
+                                  0x44, 0x00, 0x04, 0x00, 0x04, 0x01,
+                                  0x01, (char)0x89, (char)0xc3, (char)0xf8 };
+    static const char fake[] = { 0, 0, 1, (char)0xb8, 0, 0, 1, 0x00,
+                                 0x00, 0x0f, 0, 0, 1, (char)0xe0 };
+
+    Stream s;
+    s.frames = kGOPs * kGOPSize;
+    s.duration = s.frames * 40;
+
+    for (uint frame = 0; frame < s.frames; frame++)
+    {
+        bool keyframe = !(frame % kGOPSize);
+        if (keyframe)
+        {
+            s.posMap[frame] = s.data.size();
+            s.durMap[frame] = frame * 40;
+        }
+
+        append(s.data, pack, sizeof(pack));
+
+        QByteArray es = es_frame(keyframe);
+        int len = 3 + es.size();
+        char video[] = { 0, 0, 1, (char)0xe0,
+                         (char)(len >> 8), (char)(len & 0xff),
+                         (char)0x80, 0x00, 0x00 };
+        append(s.data, video, sizeof(video));
+        s.data.append(es);
+
+        QByteArray mp2;
+        for (int i = 0; i < 8; i++)
+            append(mp2, fake, sizeof(fake));
+        char audio[] = { 0, 0, 1, (char)0xc0,
+                         (char)(mp2.size() >> 8), (char)(mp2.size() & 0xff) };
+        append(s.data, audio, sizeof(audio));
+        s.data.append(mp2);
+    }
+    return s;
+}
+
+/// Gives the builder the stream chunk bytes at a time
+static void parse(SeekTableBuilder &builder, const QByteArray &data,
+                  int chunk)
+{
+    const unsigned char *buf = (const unsigned char*) data.constData();
+    for (int pos = 0; pos < data.size(); pos += chunk)
+        builder.Parse(buf + pos, qMin(chunk, data.size() - pos));
+    builder.Finish();
+}
+
+static void compare(const SeekTableBuilder &builder, const Stream &s)
+{
+    QCOMPARE (builder.GetTotalFrames(), s.frames);
+    QCOMPARE (builder.GetTotalDuration(), s.duration);
+    QCOMPARE (builder.GetPositionMap().size(), s.posMap.size());
+
+    frm_pos_map_t::const_iterator it = s.posMap.begin();
+    for (; it != s.posMap.end(); ++it)
+    {
+        QVERIFY (builder.GetPositionMap().contains(it.key()));
+        QCOMPARE (builder.GetPositionMap()[it.key()], *it);
+        QCOMPARE (builder.GetDurationMap()[it.key()], s.durMap[it.key()]);
+    }
+}
+
+static void add_chunks(void)
+{
+    QTest::addColumn<int>("chunk");
+
+    QTest::newRow("whole")     << (1 << 20);
+    QTest::newRow("1000")      << 1000;
+    QTest::newRow("packet")    << (int)TSPacket::kSize;
+    QTest::newRow("packet-1")  << (int)TSPacket::kSize - 1;
+    QTest::newRow("7")         << 7;
+    QTest::newRow("1")         << 1;
+}
+
+void TestSeekTableBuilder::TransportStream_test_data(void)
+{
+    add_chunks();
+}
+
+void TestSeekTableBuilder::TransportStream_test(void)
+{
+    QFETCH(int, chunk);
+
+    Stream s = make_ts(0);
+    SeekTableBuilder builder;
+    builder.SetVideoStream(SeekTableBuilder::kTransportStream, kVideoPID,
+                           StreamID::MPEG2Video);
+    parse(builder, s.data, chunk);
+    compare(builder, s);
+}
+
+void TestSeekTableBuilder::Resync_test_data(void)
+{
+    QTest::addColumn<int>("chunk");
+    QTest::addColumn<int>("garbage");
+
+    QTest::newRow("whole, 37")   << (1 << 20) << 37;
+    QTest::newRow("whole, 1")    << (1 << 20) << 1;
+    QTest::newRow("1000, 37")    << 1000      << 37;
+    QTest::newRow("1000, 500")   << 1000      << 500;
+    QTest::newRow("7, 37")       << 7         << 37;
+}
+
+void TestSeekTableBuilder::Resync_test(void)
+{
+    QFETCH(int, chunk);
+    QFETCH(int, garbage);
+
+    Stream s = make_ts(garbage);
+    SeekTableBuilder builder;
+    builder.SetVideoStream(SeekTableBuilder::kTransportStream, kVideoPID,
+                           StreamID::MPEG2Video);
+    parse(builder, s.data, chunk);
+    compare(builder, s);
+}
+
+void TestSeekTableBuilder::ProgramStream_test_data(void)
+{
+    add_chunks();
+}
+
+void TestSeekTableBuilder::ProgramStream_test(void)
+{
+    QFETCH(int, chunk);
+
+    Stream s = make_ps();
+    SeekTableBuilder builder;
+    QVERIFY (builder.Probe((const unsigned char*) s.data.constData(),
+                           s.data.size()));
+    QCOMPARE (builder.GetContainer(), SeekTableBuilder::kProgramStream);
+    parse(builder, s.data, chunk);
+    compare(builder, s);
+}
+
+void TestSeekTableBuilder::IsSupported_test(void)
+{
+    QVERIFY (SeekTableBuilder::IsSupported(StreamID::MPEG1Video));
+    QVERIFY (SeekTableBuilder::IsSupported(StreamID::MPEG2Video));
+    QVERIFY (SeekTableBuilder::IsSupported(StreamID::H264Video));
+    QVERIFY (!SeekTableBuilder::IsSupported(StreamID::MPEG4Video));
+    QVERIFY (!SeekTableBuilder::IsSupported(StreamID::MPEG2AudioAmd1));
+}
+
+QTEST_APPLESS_MAIN(TestSeekTableBuilder)
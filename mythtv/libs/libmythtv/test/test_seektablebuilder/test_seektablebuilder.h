@@ -0,0 +1,52 @@
+/*
+ *  Class TestSeekTableBuilder
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#define MSKIP(MSG) QSKIP(MSG, SkipSingle)
+#else
+#define MSKIP(MSG) QSKIP(MSG)
+#endif
+
+class TestSeekTableBuilder: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    /** test the frames, keyframe offsets and durations found in an
+     *  MPEG-2 transport stream, given whole and in awkward pieces
+     */
+    void TransportStream_test_data(void);
+    void TransportStream_test(void);
+
+    /** same as TransportStream_test with garbage between the packets
+     */
+    void Resync_test_data(void);
+    void Resync_test(void);
+
+    /** test an MPEG-2 program stream, with start codes in the audio
+     *  that must be skipped
+     */
+    void ProgramStream_test_data(void);
+    void ProgramStream_test(void);
+
+    /** test that only the stream types that can be parsed are taken
+     */
+    void IsSupported_test(void);
+};
@@ -0,0 +1,316 @@
+/*
+ *  Class TestTSSync
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "test_tssync.h"
+
+#include "tssync.h"
+#include "tspacket.h"
+
+Q_DECLARE_METATYPE(TSSyncScanner::Implementation)
+
+static const int kPkt = TSPacket::kSize;
+
+/// Small deterministic generator, so failures can be reproduced
+class Random
+{
+  public:
+    explicit Random(uint seed) : m_state(seed * 2654435761U + 1) { }
+    uint Next(uint range)
+    {
+        m_state = m_state * 1103515245U + 12345U;
+        return (m_state >> 8) % range;
+    }
+  private:
+    uint m_state;
+};
+
+/// The obvious byte at a time search, which the scanners must match
+static int reference_find(const unsigned char *buf, int pos, int len)
+{
+    if (pos + kPkt >= len)
+        return -1;
+    for (; pos + kPkt < len; ++pos)
+    {
+        int i = 0;
+        while (i < TSSyncScanner::kDepth && pos + i * kPkt < len &&
+               buf[pos + i * kPkt] == SYNC_BYTE)
+        {
+            ++i;
+        }
+        if (i == TSSyncScanner::kDepth || pos + i * kPkt >= len)
+            return pos;
+    }
+    return -2;
+}
+
+/// What MPEGStreamData::ResyncStream used to do, for the benchmark
+static int legacy_find(const unsigned char *buf, int pos, int len)
+{
+    int nextpos = pos + kPkt;
+    if (nextpos >= len)
+        return -1;
+    while (buf[pos] != SYNC_BYTE || buf[nextpos] != SYNC_BYTE)
+    {
+        pos++;
+        nextpos++;
+        if (nextpos == len)
+            return -2;
+    }
+    return pos;
+}
+
+/// Bytes that never contain a sync byte
+static QByteArray garbage(uint size, uint seed)
+{
+    Random rnd(seed);
+    QByteArray data(size, 0);
+    for (uint i = 0; i < size; i++)
+    {
+        uchar c = rnd.Next(256);
+        data[i] = char(c == SYNC_BYTE ? 0xb8 : c);
+    }
+    return data;
+}
+
+/// Packets with payloads free of sync bytes
+static QByteArray packets(uint count, uint seed)
+{
+    QByteArray data = garbage(count * kPkt, seed);
+    for (uint i = 0; i < count; i++)
+        data[i * kPkt] = SYNC_BYTE;
+    return data;
+}
+
+static int find(TSSyncScanner::Implementation impl, const QByteArray &data,
+                int start)
+{
+    return TSSyncScanner::Find(
+        impl, reinterpret_cast<const unsigned char*>(data.constData()),
+        start, data.size());
+}
+
+static void add_impl_rows(const char *name, const QByteArray &data,
+                          int start, int expected)
+{
+    static const TSSyncScanner::Implementation impls[] =
+    {
+        TSSyncScanner::kScalar, TSSyncScanner::kSSE2,
+        TSSyncScanner::kAVX2,   TSSyncScanner::kAuto,
+    };
+    for (uint i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+    {
+        QString row = QString("%1 %2").arg(name)
+            .arg(TSSyncScanner::toString(impls[i]));
+        QTest::newRow(row.toLatin1().constData())
+            << impls[i] << data << start << expected;
+    }
+}
+
+static void add_columns(void)
+{
+    QTest::addColumn<TSSyncScanner::Implementation>("impl");
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("start");
+    QTest::addColumn<int>("expected");
+}
+
+void TestTSSync::Limits_test_data(void)
+{
+    add_columns();
+
+    QByteArray two = packets(2, 1).left(kPkt + 1);
+    add_impl_rows("short",       packets(1, 1),             0, -1);
+    add_impl_rows("at end",      packets(4, 1),     3 * kPkt, -1);
+    add_impl_rows("two at end",  two,                       0,  0);
+    add_impl_rows("one past",    two,                       1, -1);
+    add_impl_rows("none",        garbage(kPkt + 1, 2),      0, -2);
+    add_impl_rows("none long",   garbage(5000, 3),          0, -2);
+    add_impl_rows("clean",       packets(10, 4),            0,  0);
+    add_impl_rows("next packet", packets(10, 4),            1, kPkt);
+}
+
+void TestTSSync::Limits_test(void)
+{
+    QFETCH(TSSyncScanner::Implementation, impl);
+    QFETCH(QByteArray, data);
+    QFETCH(int, start);
+    QFETCH(int, expected);
+
+    QCOMPARE (find(impl, data, start), expected);
+}
+
+void TestTSSync::Corruption_test_data(void)
+{
+    add_columns();
+
+    // garbage before the first packet
+    add_impl_rows("leading garbage",
+                  garbage(100, 5) + packets(10, 6), 0, 100);
+
+    // bytes inserted between two packets
+    add_impl_rows("inserted bytes",
+                  packets(3, 7) + garbage(5, 8) + packets(5, 9),
+                  1, 3 * kPkt + 5);
+
+    // a packet cut short, the one before it only has one good successor
+    add_impl_rows("dropped bytes",
+                  packets(3, 10).left(3 * kPkt - 20) + packets(5, 11),
+                  1, 3 * kPkt - 20);
+
+    // two stray sync bytes a packet apart, but not three
+    QByteArray stray = garbage(400, 12) + packets(5, 13);
+    stray[10] = SYNC_BYTE;
+    stray[10 + kPkt] = SYNC_BYTE;
+    add_impl_rows("false pair", stray, 0, 400);
+
+    // a sync byte lost inside a run of good packets
+    QByteArray lost = packets(8, 14);
+    lost[2 * kPkt] = 0;
+    add_impl_rows("lost sync", lost, 1, 3 * kPkt);
+
+    // candidates in every lane of a vector
+    add_impl_rows("all sync", QByteArray(1000, SYNC_BYTE), 5, 5);
+
+    // a match in the last lane of a block and in the scalar tail
+    for (int off = 28; off < 36; off += 3)
+    {
+        QByteArray late = garbage(off, 15 + off) + packets(3, 16);
+        QString name = QString("lane %1").arg(off);
+        add_impl_rows(name.toLatin1().constData(), late, 0, off);
+    }
+}
+
+void TestTSSync::Corruption_test(void)
+{
+    QFETCH(TSSyncScanner::Implementation, impl);
+    QFETCH(QByteArray, data);
+    QFETCH(int, start);
+    QFETCH(int, expected);
+
+    const unsigned char *buf =
+        reinterpret_cast<const unsigned char*>(data.constData());
+    QCOMPARE (reference_find(buf, start, data.size()), expected);
+    QCOMPARE (find(impl, data, start), expected);
+}
+
+void TestTSSync::Random_test_data(void)
+{
+    QTest::addColumn<TSSyncScanner::Implementation>("impl");
+    QTest::newRow("scalar") << TSSyncScanner::kScalar;
+    QTest::newRow("sse2")   << TSSyncScanner::kSSE2;
+    QTest::newRow("avx2")   << TSSyncScanner::kAVX2;
+}
+
+void TestTSSync::Random_test(void)
+{
+    QFETCH(TSSyncScanner::Implementation, impl);
+
+    if (!TSSyncScanner::IsAvailable(impl))
+        MSKIP("not supported by this CPU");
+
+    for (uint seed = 1; seed <= 20; seed++)
+    {
+        Random rnd(seed);
+
+        // payloads may contain sync bytes here
+        QByteArray data(40 * kPkt, 0);
+        for (int i = 0; i < data.size(); i++)
+            data[i] = char(rnd.Next(256));
+        for (int i = 0; i < data.size(); i += kPkt)
+            data[i] = SYNC_BYTE;
+
+        for (uint n = rnd.Next(8); n; --n)
+        {
+            int at = rnd.Next(data.size());
+            switch (rnd.Next(4))
+            {
+                case 0: // insert a few bytes
+                    data.insert(at, garbage(1 + rnd.Next(20), seed + n));
+                    break;
+                case 1: // drop a few bytes
+                    data.remove(at, 1 + rnd.Next(200));
+                    break;
+                case 2: // damage a sync byte
+                    data[(at / kPkt) * kPkt] = char(rnd.Next(256));
+                    break;
+                default: // plant a false one
+                    data[at] = SYNC_BYTE;
+                    break;
+            }
+        }
+
+        const unsigned char *buf =
+            reinterpret_cast<const unsigned char*>(data.constData());
+        for (int start = 0; start <= data.size(); start++)
+        {
+            int expected = reference_find(buf, start, data.size());
+            int got = TSSyncScanner::Find(impl, buf, start, data.size());
+            if (got != expected)
+            {
+                QFAIL(qPrintable(QString("seed %1 start %2: got %3 want %4")
+                                 .arg(seed).arg(start).arg(got)
+                                 .arg(expected)));
+            }
+        }
+    }
+}
+
+void TestTSSync::Garbage_benchmark_data(void)
+{
+    QTest::addColumn<int>("impl");
+    QTest::newRow("legacy") << -1;
+    QTest::newRow("scalar") << (int) TSSyncScanner::kScalar;
+    QTest::newRow("sse2")   << (int) TSSyncScanner::kSSE2;
+    QTest::newRow("avx2")   << (int) TSSyncScanner::kAVX2;
+}
+
+void TestTSSync::Garbage_benchmark(void)
+{
+    QFETCH(int, impl);
+
+    if (impl >= 0 &&
+        !TSSyncScanner::IsAvailable((TSSyncScanner::Implementation) impl))
+    {
+        MSKIP("not supported by this CPU");
+    }
+
+    // random noise, with the odd sync byte a scanner has to look at
+    QByteArray data = garbage(1024 * 1024, 17);
+    Random rnd(18);
+    for (int i = 0; i < data.size(); i += 1 + rnd.Next(512))
+        data[i] = SYNC_BYTE;
+    data += packets(4, 19);
+    const unsigned char *buf =
+        reinterpret_cast<const unsigned char*>(data.constData());
+    const int expected = data.size() - 4 * kPkt;
+
+    int pos = 0;
+    QBENCHMARK
+    {
+        if (impl < 0)
+            pos = legacy_find(buf, 0, data.size());
+        else
+            pos = TSSyncScanner::Find((TSSyncScanner::Implementation) impl,
+                                      buf, 0, data.size());
+    }
+
+    if (impl >= 0)
+        QCOMPARE (pos, expected);
+}
+
+QTEST_APPLESS_MAIN(TestTSSync)
@@ -0,0 +1,53 @@
+/*
+ *  Class TestTSSync
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#define MSKIP(MSG) QSKIP(MSG, SkipSingle)
+#else
+#define MSKIP(MSG) QSKIP(MSG)
+#endif
+
+class TestTSSync: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    /** test the not enough bytes / not found results at buffer ends
+     */
+    void Limits_test_data(void);
+    void Limits_test(void);
+
+    /** test each implementation against a plain reference search
+     *  on streams with inserted, dropped and false sync bytes
+     */
+    void Corruption_test_data(void);
+    void Corruption_test(void);
+
+    /** same as Corruption_test on randomly damaged streams,
+     *  searching from every offset
+     */
+    void Random_test_data(void);
+    void Random_test(void);
+
+    /** time the search through a buffer of garbage
+     */
+    void Garbage_benchmark_data(void);
+    void Garbage_benchmark(void);
+};
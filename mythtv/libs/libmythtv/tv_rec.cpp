@@ -20,6 +20,7 @@
 #include "channelgroup.h"
 #include "storagegroup.h"
 #include "tvremoteutil.h"
+#include "livecommdetector.h"
 #include "dtvrecorder.h"
 #include "livetvchain.h"
 #include "programinfo.h"
@@ -1010,6 +1011,21 @@ void TVRec::FinishedRecording(RecordingInfo *curRec, RecordingQuality *recq)
         JobQueue::RemoveJobsFromMask(JOB_COMMFLAG,  *autoJob);
         JobQueue::RemoveJobsFromMask(JOB_TRANSCODE, *autoJob);
     }
+    else if (JobQueue::JobIsInMask(JOB_COMMFLAG, *autoJob) &&
+             (curRec->QueryCommFlagStatus() == COMM_FLAG_DONE))
+    {
+        LOG(VB_JOBQUEUE, LOG_INFO, LOC +
+            "Commercials were flagged while recording");
+        JobQueue::RemoveJobsFromMask(JOB_COMMFLAG, *autoJob);
+    }
+    else if (JobQueue::JobIsInMask(JOB_COMMFLAG, *autoJob) &&
+             LiveCommDetector::IsActive(*curRec))
+    {
+        // it queues the job itself if it can not save the breaks
+        LOG(VB_JOBQUEUE, LOG_INFO, LOC +
+            "Commercials are being flagged by the recorder");
+        JobQueue::RemoveJobsFromMask(JOB_COMMFLAG, *autoJob);
+    }
     if (*autoJob != JOB_NONE)
         JobQueue::QueueRecordingJobs(*curRec, *autoJob);
     autoRunJobs.erase(autoJob);
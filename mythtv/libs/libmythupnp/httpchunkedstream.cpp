@@ -0,0 +1,193 @@
+//////////////////////////////////////////////////////////////////////////////
+// Program Name: httpchunkedstream.cpp
+//
+// Purpose     : Sends a response body as it is written, with chunked
+//               transfer encoding and optionally gzip'd
+//
+// Licensed under the GPL v2 or later, see COPYING for details
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+
+#include "zlib.h"
+
+#include "httpchunkedstream.h"
+#include "httprequest.h"
+#include "mythlogging.h"
+
+const int HttpChunkedStream::kThreshold;
+const int HttpChunkedStream::kChunkSize;
+
+HttpChunkedStream::HttpChunkedStream(HTTPRequest *pRequest, bool bGzip) :
+    m_pRequest(pRequest), m_bGzip(bGzip), m_bStreaming(false),
+    m_bFailed(false), m_bFinished(false), m_pZStream(NULL), m_nBytesSent(0)
+{
+    open(QIODevice::WriteOnly);
+}
+
+HttpChunkedStream::~HttpChunkedStream()
+{
+    if (m_pZStream)
+    {
+        deflateEnd(m_pZStream);
+        delete m_pZStream;
+    }
+}
+
+qint64 HttpChunkedStream::readData(char *, qint64)
+{
+    return -1;
+}
+
+qint64 HttpChunkedStream::writeData(const char *data, qint64 len)
+{
+    if (m_bFinished)
+        return -1;
+
+    // Serializers write a few bytes at a time, so they are gathered
+    // up rather than each one going through deflate() on its own
+    m_buffer.append(data, len);
+
+    if (!m_bStreaming)
+    {
+        if (m_buffer.size() >= kThreshold)
+            Start();
+    }
+    else if (m_buffer.size() >= kChunkSize)
+    {
+        Flush(false);
+    }
+
+    return len;
+}
+
+/// Sends the response header and whatever has been written so far
+bool HttpChunkedStream::Start(void)
+{
+    m_bStreaming = true;
+
+    if (m_bGzip)
+    {
+        m_pZStream = new z_stream;
+        memset(m_pZStream, 0, sizeof(z_stream));
+
+        // 16 more window bits for a gzip wrapper rather than zlib's
+        if (deflateInit2(m_pZStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            LOG(VB_HTTP, LOG_WARNING,
+                "HttpChunkedStream: deflateInit2() failed, not compressing");
+            delete m_pZStream;
+            m_pZStream = NULL;
+            m_bGzip = false;
+        }
+    }
+
+    if (!m_pRequest->SendChunkedResponseHeader(m_bGzip))
+        m_bFailed = true;
+
+    Flush(false);
+
+    return !m_bFailed;
+}
+
+void HttpChunkedStream::Flush(bool bFinish)
+{
+    Encode(m_buffer.constData(), m_buffer.size(), bFinish);
+    m_buffer.resize(0);
+}
+
+void HttpChunkedStream::Encode(const char *data, qint64 len, bool bFinish)
+{
+    if (m_bFailed)
+        return;
+
+    if (!m_pZStream)
+    {
+        m_chunk.append(data, len);
+        WriteChunk();
+        return;
+    }
+
+    m_pZStream->next_in  = (Bytef*)data;
+    m_pZStream->avail_in = len;
+
+    while (!m_bFailed)
+    {
+        int used = m_chunk.size();
+        m_chunk.resize(used + kChunkSize);
+        m_pZStream->next_out  = (Bytef*)(m_chunk.data() + used);
+        m_pZStream->avail_out = kChunkSize;
+
+        int ret = deflate(m_pZStream, bFinish ? Z_FINISH : Z_NO_FLUSH);
+        m_chunk.resize(used + kChunkSize - m_pZStream->avail_out);
+
+        if (ret == Z_STREAM_ERROR)
+        {
+            LOG(VB_GENERAL, LOG_ERR, "HttpChunkedStream: deflate() failed");
+            m_bFailed = true;
+            break;
+        }
+
+        if (m_chunk.size() >= kChunkSize)
+            WriteChunk();
+
+        if (bFinish ? (ret == Z_STREAM_END) :
+                      (m_pZStream->avail_in == 0 &&
+                       m_pZStream->avail_out != 0))
+            break;
+    }
+}
+
+void HttpChunkedStream::WriteChunk(void)
+{
+    if (m_chunk.isEmpty() || m_bFailed)
+        return;
+
+    QByteArray out = QByteArray::number(m_chunk.size(), 16) + "\r\n";
+    out += m_chunk;
+    out += "\r\n";
+    m_chunk.resize(0);
+
+    qint64 written = m_pRequest->WriteBlock(out.constData(), out.size());
+    if (written > 0)
+        m_nBytesSent += written;
+
+    if (written != out.size())
+    {
+        LOG(VB_HTTP, LOG_ERR, QString("HttpChunkedStream: Incomplete write "
+                                      "of chunk, %1 written of %2")
+                                      .arg(written).arg(out.size()));
+        m_bFailed = true;
+    }
+}
+
+/** \brief Sends what is left and the last chunk, if the response
+ *         has been started.
+ *
+ *  \return false if the response could not be sent in full
+ */
+bool HttpChunkedStream::Finish(void)
+{
+    if (!m_bStreaming || m_bFinished)
+        return !m_bFailed;
+
+    m_bFinished = true;
+
+    Flush(true);
+    WriteChunk();
+
+    if (!m_bFailed)
+    {
+        static const char kLastChunk[] = "0\r\n\r\n";
+        qint64 written = m_pRequest->WriteBlock(kLastChunk,
+                                                sizeof(kLastChunk) - 1);
+        if (written > 0)
+            m_nBytesSent += written;
+        if (written != (qint64)sizeof(kLastChunk) - 1)
+            m_bFailed = true;
+    }
+
+    return !m_bFailed;
+}
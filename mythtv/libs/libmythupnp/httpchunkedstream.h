@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////////////
+// Program Name: httpchunkedstream.h
+//
+// Purpose     : Sends a response body as it is written, with chunked
+//               transfer encoding and optionally gzip'd
+//
+// Licensed under the GPL v2 or later, see COPYING for details
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HTTPCHUNKEDSTREAM_H__
+#define __HTTPCHUNKEDSTREAM_H__
+
+#include <QIODevice>
+#include <QByteArray>
+
+#include "upnpexp.h"
+
+class HTTPRequest;
+struct z_stream_s;
+
+/** \class HttpChunkedStream
+ *  \brief A write only device a Serializer can write a response to
+ *         without the whole of it being held in memory.
+ *
+ *  Whatever is written is kept until kThreshold bytes have been, so
+ *  small responses are still sent by HTTPRequest::SendResponse() with
+ *  a Content-Length and an ETag. Past that the response header is sent
+ *  and everything from then on goes out in kChunkSize chunks as it is
+ *  written, gzip'd on the way if the client accepts it. Finish() sends
+ *  the last chunk.
+ */
+class UPNP_PUBLIC HttpChunkedStream : public QIODevice
+{
+  public:
+    HttpChunkedStream(HTTPRequest *pRequest, bool bGzip);
+    ~HttpChunkedStream();
+
+    bool isSequential(void) const { return true; }
+
+    /// true once the response header has been sent
+    bool IsStreaming(void) const { return m_bStreaming; }
+    /// What was written, for a response that never got to kThreshold
+    QByteArray &Buffer(void) { return m_buffer; }
+
+    bool   Finish(void);
+    qint64 BytesSent(void) const { return m_nBytesSent; }
+
+    /// bytes held back before the response is committed to
+    static const int kThreshold = 64 * 1024;
+    /// bytes encoded at once, and sent in each chunk
+    static const int kChunkSize = 32 * 1024;
+
+  protected:
+    qint64 readData(char *data, qint64 maxlen);
+    qint64 writeData(const char *data, qint64 len);
+
+  private:
+    bool Start(void);
+    void Flush(bool bFinish);
+    void Encode(const char *data, qint64 len, bool bFinish);
+    void WriteChunk(void);
+
+    HTTPRequest *m_pRequest;
+    bool         m_bGzip;
+    bool         m_bStreaming;
+    bool         m_bFailed;
+    bool         m_bFinished;
+    z_stream_s  *m_pZStream;
+    QByteArray   m_buffer;     ///< written, not encoded yet
+    QByteArray   m_chunk;      ///< encoded, not sent yet
+    qint64       m_nBytesSent;
+};
+
+#endif
@@ -0,0 +1,424 @@
+//////////////////////////////////////////////////////////////////////////////
+// Program Name: httpmultiplexer.cpp
+//
+// Purpose     : Waits on idle keep-alive connections and streams file
+//               responses for HttpServer without holding a pool thread
+//
+// Licensed under the GPL v2 or later, see COPYING for details
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Own headers
+#include "httpmultiplexer.h"
+
+// POSIX headers
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+// C++ headers
+#include <algorithm>
+using namespace std;
+
+// MythTV headers
+#include "httpserver.h"
+#include "mythlogging.h"
+
+#define LOC QString("HttpMultiplexer: ")
+
+const int64_t HttpMultiplexer::kChunkSize;
+const int     HttpMultiplexer::kChunkBudget;
+const int     HttpMultiplexer::kStallTimeout;
+
+HttpMultiplexer::HttpMultiplexer(HttpServer &server) :
+    MThread("HttpMultiplexer"), m_server(server), m_epoll(-1),
+    m_running(false)
+{
+    m_wake[0] = m_wake[1] = -1;
+    m_clock.start();
+}
+
+HttpMultiplexer::~HttpMultiplexer()
+{
+    Stop();
+}
+
+HttpMultiplexerStats HttpMultiplexer::GetStats(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
+
+#ifdef __linux__
+
+bool HttpMultiplexer::Start(void)
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC + "epoll_create1() failed " + ENO);
+        return false;
+    }
+
+    if (pipe2(m_wake, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC + "pipe2() failed " + ENO);
+        close(m_epoll);
+        m_epoll = -1;
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wake[0];
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake[0], &ev);
+
+    m_running = true;
+    start();
+    return true;
+}
+
+void HttpMultiplexer::Stop(void)
+{
+    if (m_running)
+    {
+        m_running = false;
+        char c = 0;
+        if (write(m_wake[1], &c, 1) < 0)
+            LOG(VB_GENERAL, LOG_ERR, LOC + "Failed to wake thread " + ENO);
+        wait();
+    }
+
+    QMutexLocker locker(&m_lock);
+    QHash<int,Connection*>::iterator it = m_connections.begin();
+    for (; it != m_connections.end(); ++it)
+    {
+        if ((*it)->file >= 0)
+            close((*it)->file);
+        close((*it)->sock);
+        delete *it;
+    }
+    m_connections.clear();
+    m_stats.idle = m_stats.streaming = 0;
+
+    if (m_epoll >= 0)
+    {
+        close(m_epoll);
+        close(m_wake[0]);
+        close(m_wake[1]);
+        m_epoll = m_wake[0] = m_wake[1] = -1;
+    }
+}
+
+/** \brief Waits for the next request on sock, or closes it after
+ *         timeout_ms.
+ *
+ *  \return false if sock was closed right away
+ */
+bool HttpMultiplexer::Watch(int sock, int timeout_ms)
+{
+    Connection *conn = new Connection;
+    conn->sock      = sock;
+    conn->file      = -1;
+    conn->offset    = 0;
+    conn->left      = 0;
+    conn->keepAlive = true;
+    conn->timeout   = timeout_ms;
+    conn->deadline  = m_clock.elapsed() + timeout_ms;
+
+    return Add(conn, EPOLLIN | EPOLLRDHUP);
+}
+
+/** \brief Sends bytes from offset in file to sock, then waits for the
+ *         next request if keep_alive is set.
+ *
+ *  The response header must already have been written.
+ *
+ *  \return false if both were closed right away
+ */
+bool HttpMultiplexer::Stream(int sock, int file, int64_t offset,
+                             int64_t bytes, bool keep_alive, int timeout_ms)
+{
+    Connection *conn = new Connection;
+    conn->sock      = sock;
+    conn->file      = file;
+    conn->offset    = offset;
+    conn->left      = bytes;
+    conn->keepAlive = keep_alive;
+    conn->timeout   = timeout_ms;
+    conn->deadline  = m_clock.elapsed() + kStallTimeout;
+
+    return Add(conn, EPOLLOUT);
+}
+
+bool HttpMultiplexer::Add(Connection *conn, uint32_t events)
+{
+    QMutexLocker locker(&m_lock);
+
+    if (m_running)
+    {
+        m_connections[conn->sock] = conn;
+
+        struct epoll_event ev;
+        ev.events = events;
+        ev.data.fd = conn->sock;
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, conn->sock, &ev) == 0)
+        {
+            if (conn->file >= 0)
+                m_stats.streaming++;
+            else
+                m_stats.idle++;
+            return true;
+        }
+
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Can not watch socket %1 ").arg(conn->sock) + ENO);
+        m_connections.remove(conn->sock);
+    }
+
+    if (conn->file >= 0)
+        close(conn->file);
+    close(conn->sock);
+    delete conn;
+    return false;
+}
+
+/// Forgets conn and closes its socket, m_lock must be held
+void HttpMultiplexer::Close(Connection *conn, bool error)
+{
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, conn->sock, NULL);
+    m_connections.remove(conn->sock);
+
+    if (conn->file >= 0)
+    {
+        close(conn->file);
+        m_stats.streaming--;
+        if (error)
+            m_stats.stream_errors++;
+    }
+    else
+    {
+        m_stats.idle--;
+    }
+
+    close(conn->sock);
+    delete conn;
+}
+
+void HttpMultiplexer::run(void)
+{
+    RunProlog();
+
+    const int kMaxEvents = 64;
+    struct epoll_event events[kMaxEvents];
+
+    while (m_running)
+    {
+        int timeout = ExpireConnections();
+        int n = epoll_wait(m_epoll, events, kMaxEvents, timeout);
+        if (n < 0 && errno != EINTR)
+        {
+            LOG(VB_GENERAL, LOG_ERR, LOC + "epoll_wait() failed " + ENO);
+            break;
+        }
+
+        for (int i = 0; i < n && m_running; i++)
+        {
+            if (events[i].data.fd == m_wake[0])
+            {
+                char buf[16];
+                while (read(m_wake[0], buf, sizeof(buf)) > 0);
+                continue;
+            }
+            HandleEvent(events[i].data.fd, events[i].events);
+        }
+    }
+
+    RunEpilog();
+}
+
+void HttpMultiplexer::HandleEvent(int sock, uint32_t events)
+{
+    m_lock.lock();
+    Connection *conn = m_connections.value(sock, NULL);
+    if (!conn)
+    {
+        m_lock.unlock();
+        return;
+    }
+
+    if (conn->file < 0)
+    {
+        // A request, or the client went away. Either way the pool
+        // deals with it, as it would have while blocked on the socket.
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, sock, NULL);
+        m_connections.remove(sock);
+        m_stats.idle--;
+        m_stats.requests++;
+        m_lock.unlock();
+        delete conn;
+
+        m_server.StartWorker(sock, kTCPServer);
+        return;
+    }
+
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        LOG(VB_HTTP, LOG_INFO, LOC +
+            QString("Socket %1 closed with %2 bytes left to send")
+                .arg(sock).arg(conn->left));
+        Close(conn, true);
+        m_lock.unlock();
+        return;
+    }
+    m_lock.unlock();
+
+    int64_t before = conn->left;
+    bool ok = SendSome(conn);
+
+    QMutexLocker locker(&m_lock);
+    m_stats.bytes_sent += before - conn->left;
+
+    if (!ok)
+    {
+        Close(conn, true);
+        return;
+    }
+
+    if (conn->left > 0)
+        return;
+
+    // All sent, wait for the next request or hang up
+    m_stats.streams++;
+    close(conn->file);
+    conn->file = -1;
+    m_stats.streaming--;
+    m_stats.idle++;
+
+    if (!conn->keepAlive)
+    {
+        Close(conn, false);
+        return;
+    }
+
+    conn->deadline = m_clock.elapsed() + conn->timeout;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.fd = conn->sock;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_MOD, conn->sock, &ev) < 0)
+        Close(conn, false);
+}
+
+/** \brief Sends up to kChunkBudget chunks, or until the socket is full.
+ *
+ *  \return false if the connection has to be closed
+ */
+bool HttpMultiplexer::SendSome(Connection *conn)
+{
+    for (int i = 0; i < kChunkBudget && conn->left > 0; )
+    {
+        off_t offset = conn->offset;
+        ssize_t ret = sendfile(conn->sock, conn->file, &offset,
+                               min(conn->left, kChunkSize));
+        if (ret > 0)
+        {
+            conn->offset = offset;
+            conn->left  -= ret;
+            conn->deadline = m_clock.elapsed() + kStallTimeout;
+            i++;
+            continue;
+        }
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0 && errno == EAGAIN)
+            return true;
+
+        if (ret == 0)
+        {
+            // the file got shorter than the Content-Length sent
+            LOG(VB_HTTP, LOG_WARNING, LOC +
+                QString("Socket %1: file ended %2 bytes early")
+                    .arg(conn->sock).arg(conn->left));
+        }
+        else
+        {
+            LOG(VB_HTTP, LOG_INFO, LOC +
+                QString("Socket %1: sendfile() failed ").arg(conn->sock) +
+                ENO);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/** \brief Closes connections that are past their deadline.
+ *
+ *  \return milliseconds until the next deadline, for epoll_wait(),
+ *          but at most a second as connections added since are not
+ *          in the reckoning
+ */
+int HttpMultiplexer::ExpireConnections(void)
+{
+    QMutexLocker locker(&m_lock);
+
+    int64_t now = m_clock.elapsed();
+    int64_t next = now + 1000;
+
+    QList<Connection*> expired;
+    QHash<int,Connection*>::iterator it = m_connections.begin();
+    for (; it != m_connections.end(); ++it)
+    {
+        if ((*it)->deadline <= now)
+            expired.push_back(*it);
+        else
+            next = min(next, (*it)->deadline);
+    }
+
+    for (int i = 0; i < expired.size(); i++)
+    {
+        LOG(VB_HTTP, LOG_INFO, LOC +
+            QString("Socket %1 timed out while %2")
+                .arg(expired[i]->sock)
+                .arg(expired[i]->file < 0 ? "idle" : "streaming"));
+        m_stats.timeouts++;
+        Close(expired[i], true);
+    }
+
+    return (int)(next - now);
+}
+
+#else // !__linux__
+
+// Without epoll and sendfile() there is nothing to run, so HttpServer
+// keeps every connection on its pool thread as it did before.
+
+bool HttpMultiplexer::Start(void)
+{
+    return false;
+}
+
+void HttpMultiplexer::Stop(void)
+{
+}
+
+bool HttpMultiplexer::Watch(int, int)
+{
+    return false;
+}
+
+bool HttpMultiplexer::Stream(int, int, int64_t, int64_t, bool, int)
+{
+    return false;
+}
+
+void HttpMultiplexer::run(void)
+{
+}
+
+#endif // !__linux__
@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////////
+// Program Name: httpmultiplexer.h
+//
+// Purpose     : Waits on idle keep-alive connections and streams file
+//               responses for HttpServer without holding a pool thread
+//
+// Licensed under the GPL v2 or later, see COPYING for details
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HTTPMULTIPLEXER_H__
+#define __HTTPMULTIPLEXER_H__
+
+#include <stdint.h>
+
+// Qt headers
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QHash>
+
+// MythTV headers
+#include "mthread.h"
+#include "upnpexp.h"
+
+class HttpServer;
+
+class UPNP_PUBLIC HttpMultiplexerStats
+{
+  public:
+    HttpMultiplexerStats() :
+        idle(0), streaming(0), requests(0), streams(0),
+        stream_errors(0), timeouts(0), bytes_sent(0) {}
+
+    uint     idle;          ///< connections waiting for a request
+    uint     streaming;     ///< connections being sent a file
+    uint64_t requests;      ///< connections handed back to the pool
+    uint64_t streams;       ///< files sent to the end
+    uint64_t stream_errors; ///< files not sent to the end
+    uint64_t timeouts;      ///< connections closed for being idle or stalled
+    uint64_t bytes_sent;
+};
+
+/** \class HttpMultiplexer
+ *  \brief Looks after HttpServer connections that are not in the
+ *         middle of a request, on one epoll thread.
+ *
+ *  An HttpWorker used to block a pool thread on its socket for as
+ *  long as the client kept the connection alive, and while a file was
+ *  written out to it. Now a plain TCP connection is handed here with
+ *  Watch() whenever the worker would wait for the next request, and a
+ *  new worker is started for it once it becomes readable. The body of
+ *  a file response is handed here with Stream() and sent with
+ *  sendfile() as the socket drains, after which the connection waits
+ *  for its next request like any other.
+ *
+ *  Both take ownership of the descriptors passed in, and close them
+ *  on a timeout, an error, or when the multiplexer is stopped.
+ */
+class UPNP_PUBLIC HttpMultiplexer : public MThread
+{
+  public:
+    explicit HttpMultiplexer(HttpServer &server);
+    ~HttpMultiplexer();
+
+    bool Start(void);
+    void Stop(void);
+
+    bool Watch(int sock, int timeout_ms);
+    bool Stream(int sock, int file, int64_t offset, int64_t bytes,
+                bool keep_alive, int timeout_ms);
+
+    HttpMultiplexerStats GetStats(void) const;
+
+    /// bytes sendfile() is asked for at once
+    static const int64_t kChunkSize   = 256 * 1024;
+    /// chunks sent to one connection before the others get a turn
+    static const int     kChunkBudget = 4;
+    /// how long a client may stop reading before it is dropped
+    static const int     kStallTimeout = 30 * 1000;
+
+  protected:
+    virtual void run(void);
+
+  private:
+    typedef struct
+    {
+        int     sock;
+        int     file;       ///< -1 while waiting for a request
+        int64_t offset;
+        int64_t left;
+        bool    keepAlive;
+        int     timeout;    ///< keep-alive timeout once the file is sent
+        int64_t deadline;   ///< on m_clock
+    } Connection;
+
+    bool Add(Connection *conn, uint32_t events);
+    void Close(Connection *conn, bool error);
+    void HandleEvent(int sock, uint32_t events);
+    bool SendSome(Connection *conn);
+    int  ExpireConnections(void);
+
+    HttpServer            &m_server;
+    int                    m_epoll;
+    int                    m_wake[2];
+    volatile bool          m_running;
+    QElapsedTimer          m_clock;
+
+    mutable QMutex         m_lock;
+    QHash<int,Connection*> m_connections;
+    HttpMultiplexerStats   m_stats;
+};
+
+#endif
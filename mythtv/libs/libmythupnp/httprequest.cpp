@@ -52,6 +52,7 @@
 #include "serializers/soapSerializer.h"
 #include "serializers/jsonSerializer.h"
 #include "serializers/xmlplistSerializer.h"
+#include "httpchunkedstream.h"
 
 #include <unistd.h> // for gethostname
 
@@ -59,6 +60,9 @@
 #define O_LARGEFILE 0
 #endif
 
+// Smaller files are sent by the worker, it has the thread already
+#define DEFERRED_FILE_MIN (256 * 1024)
+
 using namespace std;
 
 static MIMETypes g_MIMETypes[] =
@@ -170,7 +174,13 @@ HTTPRequest::HTTPRequest() : m_procReqLineExp ( "[ \r\n][ \r\n]*"  ),
                              m_bSOAPRequest   ( false ),
                              m_eResponseType  ( ResponseTypeUnknown),
                              m_nResponseStatus( 200 ),
+                             m_pChunkedStream ( NULL ),
+                             m_bAllowChunked  ( true ),
                              m_pPostProcess   ( NULL ),
+                             m_bAllowDeferredFile( false ),
+                             m_nDeferredFile  (  -1 ),
+                             m_llDeferredStart(   0 ),
+                             m_llDeferredBytes(   0 ),
                              m_bKeepAlive     ( true ),
                              m_nKeepAliveTimeout ( 0 )
 {
@@ -181,6 +191,18 @@ HTTPRequest::HTTPRequest() : m_procReqLineExp ( "[ \r\n][ \r\n]*"  ),
 //
 /////////////////////////////////////////////////////////////////////////////
 
+HTTPRequest::~HTTPRequest()
+{
+    if (m_nDeferredFile >= 0)
+        close( m_nDeferredFile );
+
+    delete m_pChunkedStream;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+/////////////////////////////////////////////////////////////////////////////
+
 RequestType HTTPRequest::SetRequestType( const QString &sType )
 {
     // HTTP
@@ -251,7 +273,9 @@ QString HTTPRequest::BuildResponseHeader( long long nSize )
             SetResponseHeader("Content-Disposition", QString("inline; filename=\"%2\"").arg(QString(filename.toLatin1())));
         }
 
-        SetResponseHeader("Content-Length", QString::number(nSize));
+        // Unknown for a chunked response
+        if (nSize >= 0)
+            SetResponseHeader("Content-Length", QString::number(nSize));
 
         // See DLNA  7.4.1.3.11.4.3 Tolerance to unavailable contentFeatures.dlna.org header
         //
@@ -319,6 +343,31 @@ qint64 HTTPRequest::SendResponse( void )
 {
     qint64      nBytes    = 0;
 
+    // ----------------------------------------------------------------------
+    // A serialized response may be on its way already, or small enough
+    // that it was kept to be sent below
+    // ----------------------------------------------------------------------
+
+    if (m_pChunkedStream != NULL)
+    {
+        if (m_pChunkedStream->IsStreaming())
+        {
+            bool bOk = m_pChunkedStream->Finish();
+
+            LOG(VB_HTTP, LOG_INFO,
+                QString("HTTPRequest::SendResponse( Chunked ) :%1 -> %2: "
+                        "%3 bytes")
+                    .arg(GetResponseStatus()) .arg(GetPeerAddress())
+                    .arg(m_pChunkedStream->BytesSent()));
+
+            return bOk ? m_pChunkedStream->BytesSent() : -1;
+        }
+
+        m_response.buffer() = m_pChunkedStream->Buffer();
+        delete m_pChunkedStream;
+        m_pChunkedStream = NULL;
+    }
+
     switch( m_eResponseType )
     {
         // The following are all eligable for gzip compression
@@ -419,12 +468,13 @@ qint64 HTTPRequest::SendResponse( void )
     LOG(VB_HTTP, LOG_DEBUG, QString("Reponse Content Length: %1").arg(nContentLen));
 
     // ----------------------------------------------------------------------
-    // Should we try to return data gzip'd?
+    // Should we try to return data gzip'd? (unless it already is)
     // ----------------------------------------------------------------------
 
     QBuffer compBuffer;
 
-    if (( nContentLen > 0 ) && m_mapHeaders[ "accept-encoding" ].contains( "gzip" ))
+    if (( nContentLen > 0 ) && m_mapHeaders[ "accept-encoding" ].contains( "gzip" ) &&
+        !m_mapRespHeaders.contains( "Content-Encoding" ))
     {
         QByteArray compressed = gzipCompress( m_response.buffer() );
         compBuffer.setData( compressed );
@@ -626,7 +676,23 @@ qint64 HTTPRequest::SendResponseFile( QString sFileName )
         QString("SendResponseFile : size = %1, start = %2, end = %3")
             .arg(llSize).arg(llStart).arg(llEnd));
 #endif
-    if (( m_eType != RequestTypeHead ) && (llSize != 0))
+    if (( m_eType != RequestTypeHead ) && (llSize != 0) &&
+        m_bAllowDeferredFile && (llSize >= DEFERRED_FILE_MIN) &&
+        (nBytes == sHeader.length()))
+    {
+        // Leave the body to the multiplexer, see HttpWorker::run()
+
+        m_nDeferredFile = dup( tmpFile.handle() );
+
+        if (m_nDeferredFile >= 0)
+        {
+            m_llDeferredStart = llStart;
+            m_llDeferredBytes = llSize;
+        }
+    }
+
+    if (( m_eType != RequestTypeHead ) && (llSize != 0) &&
+        (m_nDeferredFile < 0))
     {
         long long sent = SendFile( tmpFile, llStart, llSize );
 
@@ -661,6 +727,31 @@ qint64 HTTPRequest::SendResponseFile( QString sFileName )
     return nBytes;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// Sends the body SendResponseFile() left in m_nDeferredFile over this
+// connection after all, for when it can not be handed to the multiplexer.
+/////////////////////////////////////////////////////////////////////////////
+
+qint64 HTTPRequest::SendDeferredFile( void )
+{
+    if (m_nDeferredFile < 0)
+        return 0;
+
+    qint64 sent = -1;
+    QFile  file;
+
+    if (file.open( m_nDeferredFile, QIODevice::ReadOnly ))
+    {
+        sent = SendFile( file, m_llDeferredStart, m_llDeferredBytes );
+        file.close();
+    }
+
+    close( m_nDeferredFile );
+    m_nDeferredFile = -1;
+
+    return sent;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //
 /////////////////////////////////////////////////////////////////////////////
@@ -1758,32 +1849,86 @@ bool HTTPRequest::ProcessSOAPPayload( const QString &sSOAPAction )
 Serializer *HTTPRequest::GetSerializer()
 {
     Serializer *pSerializer = NULL;
+    QIODevice  *pDevice     = &m_response;
+
+    // ----------------------------------------------------------------------
+    // Large responses are sent while they are serialized, rather than
+    // built up here first. Only HTTP/1.1 clients understand chunks, UPnP
+    // devices are left alone, and a client asking for If-None-Match
+    // wants the ETag, which is only known at the end.
+    // ----------------------------------------------------------------------
+
+    if (m_bAllowChunked && !m_bSOAPRequest && m_eType != RequestTypeHead &&
+        (m_nMajor > 1 || (m_nMajor == 1 && m_nMinor >= 1)) &&
+        GetRequestHeader( "If-None-Match", "" ).isEmpty() &&
+        m_pChunkedStream == NULL)
+    {
+        bool bGzip = m_mapHeaders[ "accept-encoding" ].contains( "gzip" );
+
+        m_pChunkedStream = new HttpChunkedStream( this, bGzip );
+        pDevice = m_pChunkedStream;
+    }
 
     if (m_bSOAPRequest)
-        pSerializer = (Serializer *)new SoapSerializer(&m_response,
+        pSerializer = (Serializer *)new SoapSerializer(pDevice,
                                                        m_sNameSpace, m_sMethod);
     else
     {
         QString sAccept = GetRequestHeader( "Accept", "*/*" );
 
         if (sAccept.contains( "application/json", Qt::CaseInsensitive ))
-            pSerializer = (Serializer *)new JSONSerializer(&m_response,
+            pSerializer = (Serializer *)new JSONSerializer(pDevice,
                                                            m_sMethod);
         else if (sAccept.contains( "text/javascript", Qt::CaseInsensitive ))
-            pSerializer = (Serializer *)new JSONSerializer(&m_response,
+            pSerializer = (Serializer *)new JSONSerializer(pDevice,
                                                            m_sMethod);
         else if (sAccept.contains( "text/x-apple-plist+xml", Qt::CaseInsensitive ))
-            pSerializer = (Serializer *)new XmlPListSerializer(&m_response);
+            pSerializer = (Serializer *)new XmlPListSerializer(pDevice);
     }
 
     // Default to XML
 
     if (pSerializer == NULL)
-        pSerializer = (Serializer *)new XmlSerializer(&m_response, m_sMethod);
+        pSerializer = (Serializer *)new XmlSerializer(pDevice, m_sMethod);
+
+    // Needed before FormatActionResponse() if the response is streamed
+    m_sResponseTypeText = pSerializer->GetContentType();
 
     return pSerializer;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// Called by m_pChunkedStream once the response is too large to keep,
+// everything after the header is sent by it as chunks.
+/////////////////////////////////////////////////////////////////////////////
+
+bool HTTPRequest::SendChunkedResponseHeader( bool bGzip )
+{
+    m_eResponseType   = ResponseTypeOther;
+    m_nResponseStatus = 200;
+
+    // What Serializer::AddHeaders() would say, less the ETag
+    m_mapRespHeaders[ "Cache-Control" ] = "no-cache=\"Ext\", "
+                                          "max-age = 7200"; // 2 hours
+    SetResponseHeader( "Transfer-Encoding", "chunked" );
+    if (bGzip)
+        SetResponseHeader( "Content-Encoding", "gzip" );
+
+    QByteArray sHeader = BuildResponseHeader( -1 ).toUtf8();
+    qint64     nBytes  = WriteBlock( sHeader.constData(), sHeader.length() );
+
+    if (nBytes < sHeader.length())
+    {
+        LOG( VB_HTTP, LOG_ERR, QString("HttpRequest::SendChunkedResponseHeader(): "
+                                       "Incomplete write of header, "
+                                       "%1 written of %2")
+                                        .arg(nBytes).arg(sHeader.length()));
+        return false;
+    }
+
+    return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //
 /////////////////////////////////////////////////////////////////////////////
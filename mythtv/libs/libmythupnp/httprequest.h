@@ -26,6 +26,8 @@
 #include "upnputil.h"
 #include "serializers/serializer.h"
 
+class HttpChunkedStream;
+
 #define SOAP_ENVELOPE_BEGIN  "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" " \
                              "s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">"     \
                              "<s:Body>"
@@ -151,12 +153,23 @@ class UPNP_PUBLIC HTTPRequest
         QString             m_sFileName;
 
         QBuffer             m_response;
+        HttpChunkedStream  *m_pChunkedStream; // Serializer output, if streamed
+        bool                m_bAllowChunked;  // false to keep it all for a cache
 
         IPostProcess       *m_pPostProcess;
 
         QString             m_sPrivateToken;
         MythUserSession     m_userSession;
 
+        // Set by the worker when an HttpMultiplexer can send the body of
+        // a file response, SendResponseFile() then only sends the header
+        // and leaves a descriptor for the rest here.
+
+        bool                m_bAllowDeferredFile;
+        int                 m_nDeferredFile;
+        qint64              m_llDeferredStart;
+        qint64              m_llDeferredBytes;
+
     private:
 
         bool                m_bKeepAlive;
@@ -204,7 +217,7 @@ class UPNP_PUBLIC HTTPRequest
     public:
 
                         HTTPRequest     ();
-        virtual        ~HTTPRequest     () {};
+        virtual        ~HTTPRequest     ();
 
         bool            ParseRequest    ();
 
@@ -219,6 +232,8 @@ class UPNP_PUBLIC HTTPRequest
 
         qint64          SendResponse    ( void );
         qint64          SendResponseFile( QString sFileName );
+        qint64          SendDeferredFile( void );
+        bool            SendChunkedResponseHeader( bool bGzip );
 
         void            SetResponseHeader ( const QString &sKey,
                                             const QString &sValue,
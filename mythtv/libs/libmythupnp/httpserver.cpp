@@ -39,6 +39,7 @@
 #include "mythdirs.h"
 #include "mythlogging.h"
 #include "htmlserver.h"
+#include "httpmultiplexer.h"
 #include "mythversion.h"
 #include "mythcorecontext.h"
 
@@ -116,7 +117,7 @@ QString  HttpServer::s_platform;
 
 HttpServer::HttpServer() :
     ServerPool(), m_sSharePath(GetShareDir()),
-    m_threadPool("HttpServerPool"), m_running(true),
+    m_threadPool("HttpServerPool"), m_multiplexer(NULL), m_running(true),
     m_privateToken(QUuid::createUuid().toString()) // Cryptographically random and sufficiently long enough to act as a secure token
 {
     // Number of connections processed concurrently
@@ -129,6 +130,16 @@ HttpServer::HttpServer() :
     LOG(VB_HTTP, LOG_NOTICE, QString("HttpServer(): Max Thread Count %1")
                                 .arg(m_threadPool.maxThreadCount()));
 
+    // Connections between requests and file bodies are looked after
+    // by one thread, so the pool only runs while a request is handled.
+    // Start() fails where there is no epoll, and the pool does it all.
+    m_multiplexer = new HttpMultiplexer(*this);
+    if (!m_multiplexer->Start())
+    {
+        delete m_multiplexer;
+        m_multiplexer = NULL;
+    }
+
     // ----------------------------------------------------------------------
     // Build Platform String
     // ----------------------------------------------------------------------
@@ -174,8 +185,15 @@ HttpServer::~HttpServer()
     m_running = false;
     m_rwlock.unlock();
 
+    // Workers handing connections over once it has stopped close them
+    if (m_multiplexer)
+        m_multiplexer->Stop();
+
     m_threadPool.Stop();
 
+    delete m_multiplexer;
+    m_multiplexer = NULL;
+
     while (!m_extensions.empty())
     {
         delete m_extensions.takeFirst();
@@ -310,6 +328,22 @@ void HttpServer::newTcpConnection(qt_socket_fd_t socket)
     if (server)
         type = server->GetServerType();
 
+    // Wait for the first request the way HttpWorker would
+    if (m_multiplexer && type != kSSLServer)
+    {
+        m_multiplexer->Watch(socket, 5 * 1000);
+        return;
+    }
+
+    StartWorker(socket, type);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+/////////////////////////////////////////////////////////////////////////////
+
+void HttpServer::StartWorker(qt_socket_fd_t socket, PoolServerType type)
+{
     m_threadPool.startReserved(
         new HttpWorker(*this, socket, type
 #ifndef QT_NO_OPENSSL
@@ -470,6 +504,27 @@ HttpWorker::HttpWorker(HttpServer &httpServer, qt_socket_fd_t sock,
 //
 /////////////////////////////////////////////////////////////////////////////
 
+/**
+ * \brief Takes the descriptor away from a QTcpSocket, which has no way
+ *        to let go of it, by keeping a duplicate open and letting the
+ *        socket close its own.
+ */
+static int ReleaseSocket(QTcpSocket *pSocket)
+{
+    int fd = -1;
+#ifndef _WIN32
+    if (pSocket->bytesToWrite() == 0 && pSocket->bytesAvailable() == 0)
+        fd = dup(pSocket->socketDescriptor());
+    if (fd >= 0)
+        pSocket->abort();
+#endif
+    return fd;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+/////////////////////////////////////////////////////////////////////////////
+
 void HttpWorker::run(void)
 {
 #if 0
@@ -482,6 +537,11 @@ void HttpWorker::run(void)
     HTTPRequest            *pRequest   = NULL;
     QTcpSocket             *pSocket;
     bool                    bEncrypted = false;
+    bool                    bHandedOver = false;
+    HttpMultiplexer        *pMultiplexer = NULL;
+
+    if (m_connectionType != kSSLServer)
+        pMultiplexer = m_httpServer.GetMultiplexer();
 
     if (m_connectionType == kSSLServer)
     {
@@ -556,6 +616,7 @@ void HttpWorker::run(void)
                 if (pRequest != NULL)
                 {
                     pRequest->m_bEncrypted = bEncrypted;
+                    pRequest->m_bAllowDeferredFile = (pMultiplexer != NULL);
                     if ( pRequest->ParseRequest() )
                     {
                         bKeepAlive = pRequest->GetKeepAlive();
@@ -589,8 +650,10 @@ void HttpWorker::run(void)
                     // -------------------------------------------------------
                     // Always MUST send a response.
                     // -------------------------------------------------------
+                    bool bSent = true;
                     if (pRequest->SendResponse() < 0)
                     {
+                        bSent = false;
                         bKeepAlive = false;
                         LOG(VB_HTTP, LOG_ERR,
                             QString("socket(%1) - Error returned from "
@@ -604,8 +667,46 @@ void HttpWorker::run(void)
                     if ( pRequest->m_pPostProcess != NULL )
                         pRequest->m_pPostProcess->ExecutePostProcess();
 
+                    // -------------------------------------------------------
+                    // Leave the body of a file and the wait for the next
+                    // request to the multiplexer, rather than block here.
+                    // -------------------------------------------------------
+                    if (pRequest->m_nDeferredFile >= 0 && bSent)
+                    {
+                        int fd = ReleaseSocket(pSocket);
+                        if (fd >= 0)
+                        {
+                            pMultiplexer->Stream(fd, pRequest->m_nDeferredFile,
+                                                 pRequest->m_llDeferredStart,
+                                                 pRequest->m_llDeferredBytes,
+                                                 bKeepAlive, m_socketTimeout);
+                            pRequest->m_nDeferredFile = -1;
+                            bHandedOver = true;
+                        }
+                        else if (pRequest->SendDeferredFile() < 0)
+                        {
+                            // The next request is already here, so the
+                            // body goes out from this thread after all
+                            bKeepAlive = false;
+                        }
+                    }
+                    else if (pMultiplexer && bKeepAlive)
+                    {
+                        // Nothing left to read means waiting for the
+                        // next request, which the multiplexer does
+                        int fd = ReleaseSocket(pSocket);
+                        if (fd >= 0)
+                        {
+                            pMultiplexer->Watch(fd, m_socketTimeout);
+                            bHandedOver = true;
+                        }
+                    }
+
                     delete pRequest;
                     pRequest = NULL;
+
+                    if (bHandedOver)
+                        break;
                 }
                 else
                 {
@@ -628,6 +729,16 @@ void HttpWorker::run(void)
 
     delete pRequest;
 
+    if (bHandedOver)
+    {
+        LOG(VB_HTTP, LOG_DEBUG, QString("HttpWorker(%1): Connection handed "
+                                        "over after %2 requests")
+                                            .arg(m_socket)
+                                            .arg(nRequestsHandled));
+        delete pSocket;
+        return;
+    }
+
     if ((pSocket->error() != QAbstractSocket::UnknownSocketError) &&
         !(bKeepAlive && pSocket->error() == QAbstractSocket::SocketTimeoutError)) // This 'error' isn't an error when keep-alive is active
     {
@@ -45,6 +45,7 @@
 typedef struct timeval  TaskTime;
 
 class HttpWorkerThread;
+class HttpMultiplexer;
 class QScriptEngine;
 class HttpServer;
 #ifndef QT_NO_OPENSSL
@@ -141,6 +142,11 @@ class UPNP_PUBLIC HttpServer : public ServerPool
     static QString GetPlatform(void);
     static QString GetServerVersion(void);
 
+    void StartWorker(qt_socket_fd_t socket, PoolServerType type);
+
+    /// NULL where there is no epoll, workers then keep their connection
+    HttpMultiplexer *GetMultiplexer(void) const { return m_multiplexer; }
+
   protected:
     mutable QReadWriteLock  m_rwlock;
     HttpServerExtensionList m_extensions;
@@ -148,6 +154,7 @@ class UPNP_PUBLIC HttpServer : public ServerPool
     QMultiMap< QString, HttpServerExtension* >  m_basePaths;
     QString                 m_sSharePath;
     MThreadPool             m_threadPool;
+    HttpMultiplexer        *m_multiplexer;
     bool                    m_running; // protected by m_rwlock
 
     static QMutex           s_platformLock;
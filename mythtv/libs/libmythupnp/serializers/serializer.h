@@ -68,6 +68,7 @@ class UPNP_PUBLIC Serializer
 
 
         inline Serializer();
+        virtual ~Serializer() {}
 };
 
 Q_DECLARE_METATYPE( QList<QObject*> )
@@ -0,0 +1,260 @@
+/*
+ *  Class TestHttpChunkedStream
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QElapsedTimer>
+#include <QBuffer>
+
+#include "test_httpchunkedstream.h"
+
+#include "mythcorecontext.h"
+#include "mythcoreutil.h"
+#include "mythdb.h"
+#include "httprequest.h"
+#include "httpchunkedstream.h"
+#include "serializers/jsonSerializer.h"
+#include "serializers/xmlSerializer.h"
+
+/// Keeps whatever is written to the client
+class FakeRequest : public HTTPRequest
+{
+  public:
+    FakeRequest() : m_writes(0) {}
+
+    QString ReadLine(int) { return QString(); }
+    qint64  ReadBlock(char *, qint64, int) { return -1; }
+    qint64  WriteBlock(const char *pData, qint64 nLen)
+    {
+        m_sent.append(pData, nLen);
+        m_writes++;
+        return nLen;
+    }
+    QString GetHostAddress(void) { return "127.0.0.1"; }
+    quint16 GetHostPort(void)    { return 6544; }
+    QString GetPeerAddress(void) { return "127.0.0.1"; }
+    int     getSocketHandle(void) { return -1; }
+
+    QByteArray m_sent;
+    int        m_writes;
+};
+
+static QByteArray make_text(int size)
+{
+    QByteArray data;
+    for (int i = 0; data.size() < size; i++)
+        data += QString("<Program><Title>Show %1</Title></Program>")
+                    .arg(i % 977).toLatin1();
+    data.truncate(size);
+    return data;
+}
+
+/// Checks the header and puts the chunks back together
+static bool dechunk(const QByteArray &sent, QByteArray &body, QString &error)
+{
+    int end = sent.indexOf("\r\n\r\n");
+    if (end < 0)
+    {
+        error = "no header";
+        return false;
+    }
+
+    QByteArray header = sent.left(end);
+    if (!header.contains("Transfer-Encoding: chunked") ||
+        header.contains("Content-Length"))
+    {
+        error = "not a chunked header: " + QString(header);
+        return false;
+    }
+
+    int pos = end + 4;
+    while (true)
+    {
+        int eol = sent.indexOf("\r\n", pos);
+        if (eol < 0)
+        {
+            error = QString("no chunk size at %1").arg(pos);
+            return false;
+        }
+
+        bool ok = false;
+        int size = sent.mid(pos, eol - pos).toInt(&ok, 16);
+        if (!ok || eol + 2 + size + 2 > sent.size() ||
+            sent.mid(eol + 2 + size, 2) != "\r\n")
+        {
+            error = QString("bad chunk at %1").arg(pos);
+            return false;
+        }
+
+        pos = eol + 2 + size + 2;
+        if (size == 0)
+            break;
+        body += sent.mid(eol + 2, size);
+    }
+
+    if (pos != sent.size())
+    {
+        error = QString("%1 bytes after the last chunk").arg(sent.size() - pos);
+        return false;
+    }
+    return true;
+}
+
+void TestHttpChunkedStream::initTestCase(void)
+{
+    gCoreContext = new MythCoreContext("bin_version", NULL);
+    gCoreContext->GetDB()->IgnoreDatabase(true);
+}
+
+void TestHttpChunkedStream::cleanupTestCase(void)
+{
+    delete gCoreContext;
+    gCoreContext = NULL;
+}
+
+void TestHttpChunkedStream::Small_test(void)
+{
+    FakeRequest request;
+    HttpChunkedStream stream(&request, true);
+
+    QByteArray data = make_text(HttpChunkedStream::kThreshold - 1);
+    QCOMPARE (stream.write(data), (qint64) data.size());
+    QVERIFY  (stream.Finish());
+
+    QVERIFY  (!stream.IsStreaming());
+    QCOMPARE (stream.Buffer(), data);
+    QCOMPARE (request.m_writes, 0);
+}
+
+void TestHttpChunkedStream::Large_test_data(void)
+{
+    QTest::addColumn<bool>("gzip");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("write");
+
+    QTest::newRow("plain, threshold")
+        << false << (int) HttpChunkedStream::kThreshold << 1000;
+    QTest::newRow("plain, 1 MB in 7 byte writes")
+        << false << 1024 * 1024 << 7;
+    QTest::newRow("plain, 1 MB at once") << false << 1024 * 1024 << 1024 * 1024;
+    QTest::newRow("gzip, threshold")
+        << true << (int) HttpChunkedStream::kThreshold << 1000;
+    QTest::newRow("gzip, 4 MB in 13 byte writes")
+        << true << 4 * 1024 * 1024 << 13;
+    QTest::newRow("gzip, 4 MB at once") << true << 4 * 1024 * 1024
+                                        << 4 * 1024 * 1024;
+}
+
+void TestHttpChunkedStream::Large_test(void)
+{
+    QFETCH(bool, gzip);
+    QFETCH(int, size);
+    QFETCH(int, write);
+
+    QByteArray data = make_text(size);
+
+    FakeRequest request;
+    HttpChunkedStream stream(&request, gzip);
+    for (int pos = 0; pos < data.size(); pos += write)
+        stream.write(data.constData() + pos, qMin(write, data.size() - pos));
+    QVERIFY (stream.IsStreaming());
+    QVERIFY (stream.Finish());
+    QCOMPARE (stream.BytesSent(), (qint64) (request.m_sent.size() -
+              request.m_sent.indexOf("\r\n\r\n") - 4));
+
+    QByteArray body;
+    QString error;
+    QVERIFY2 (dechunk(request.m_sent, body, error), qPrintable(error));
+    QCOMPARE (request.m_sent.contains("Content-Encoding: gzip"), gzip);
+
+    if (gzip)
+    {
+        QVERIFY (body.size() < data.size() / 4);
+        body = gzipUncompress(body);
+    }
+    QCOMPARE (body.size(), data.size());
+    QVERIFY  (body == data);
+}
+
+void TestHttpChunkedStream::Serializer_test_data(void)
+{
+    QTest::addColumn<bool>("json");
+    QTest::addColumn<int>("items");
+
+    QTest::newRow("xml, 100 items")    << false << 100;
+    QTest::newRow("xml, 50000 items")  << false << 50000;
+    QTest::newRow("json, 100 items")   << true  << 100;
+    QTest::newRow("json, 50000 items") << true  << 50000;
+}
+
+void TestHttpChunkedStream::Serializer_test(void)
+{
+    QFETCH(bool, json);
+    QFETCH(int, items);
+
+    QVariantList list;
+    for (int i = 0; i < items; i++)
+    {
+        QVariantMap item;
+        item["Title"]    = QString("Show %1").arg(i % 977);
+        item["SubTitle"] = QString("Episode \"%1\"").arg(i);
+        item["ChanId"]   = 1000 + i % 50;
+        list << item;
+    }
+    QVariant value(list);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    Serializer *pSer;
+    if (json)
+        pSer = new JSONSerializer(&buffer, "GetList");
+    else
+        pSer = new XmlSerializer(&buffer, "GetList");
+    pSer->Serialize(value, "List");
+    delete pSer;
+
+    FakeRequest request;
+    HttpChunkedStream stream(&request, false);
+    if (json)
+        pSer = new JSONSerializer(&stream, "GetList");
+    else
+        pSer = new XmlSerializer(&stream, "GetList");
+
+    QElapsedTimer timer;
+    timer.start();
+    pSer->Serialize(value, "List");
+    delete pSer;
+    QVERIFY (stream.Finish());
+    qint64 elapsed = timer.elapsed();
+
+    if (buffer.buffer().size() < HttpChunkedStream::kThreshold)
+    {
+        QVERIFY (!stream.IsStreaming());
+        QCOMPARE (stream.Buffer(), buffer.buffer());
+        return;
+    }
+
+    QByteArray body;
+    QString error;
+    QVERIFY2 (dechunk(request.m_sent, body, error), qPrintable(error));
+    QVERIFY  (body == buffer.buffer());
+
+    qDebug() << qPrintable(QString("%1 KB in %2 ms, %3 writes to the socket")
+                           .arg(body.size() / 1024).arg(elapsed)
+                           .arg(request.m_writes));
+}
+
+QTEST_APPLESS_MAIN(TestHttpChunkedStream)
@@ -0,0 +1,45 @@
+/*
+ *  Class TestHttpChunkedStream
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+
+class TestHttpChunkedStream: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase(void);
+    void cleanupTestCase(void);
+
+    /** test that a response smaller than the threshold is kept for
+     *  SendResponse() and nothing is sent
+     */
+    void Small_test(void);
+
+    /** test that a large response is sent as chunks after one header,
+     *  plain and gzip'd, whatever size the writes come in
+     */
+    void Large_test_data(void);
+    void Large_test(void);
+
+    /** test that a serializer writes the same document to the stream
+     *  as it does to a buffer, and report how fast
+     */
+    void Serializer_test_data(void);
+    void Serializer_test(void);
+};
@@ -0,0 +1,683 @@
+/*
+ *  Class TestHttpServer
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QThread>
+
+#include "test_httpserver.h"
+
+#include "mythcorecontext.h"
+#include "mythdb.h"
+#include "httpserver.h"
+#include "httprequest.h"
+#include "httpmultiplexer.h"
+
+static QByteArray make_pattern(uint size, uint seed)
+{
+    QByteArray data;
+    data.resize(size);
+    for (uint i = 0; i < size; i++)
+        data[i] = char((i * 31 + seed) ^ (i >> 9));
+    return data;
+}
+
+static int env_int(const char *name, int defaultval)
+{
+    bool ok = false;
+    int val = qgetenv(name).toInt(&ok);
+    return (ok && val > 0) ? val : defaultval;
+}
+
+/// Serves /test/file from a file on disk, and /test/ping
+class TestFileExtension : public HttpServerExtension
+{
+  public:
+    explicit TestFileExtension(const QString &file) :
+        HttpServerExtension("TestFile", QString()), m_file(file) {}
+
+    QStringList GetBasePaths() { return QStringList("/test"); }
+
+    bool ProcessRequest(HTTPRequest *pRequest)
+    {
+        if (pRequest->m_sMethod == "file")
+        {
+            pRequest->FormatFileResponse(m_file);
+            return true;
+        }
+        if (pRequest->m_sMethod == "ping")
+        {
+            pRequest->FormatRawResponse("<ping/>");
+            return true;
+        }
+        return false;
+    }
+
+  private:
+    QString m_file;
+};
+
+/// One GET and what is expected back
+typedef struct
+{
+    QByteArray path;
+    QByteArray range;   ///< Range header, if any
+    int        status;
+    qint64     start;   ///< offset of the body in the file, -1 for none
+    qint64     length;  ///< length of the body, -1 for any
+} HttpGet;
+
+/// GETs sent one after another over one connection
+class HttpJob
+{
+  public:
+    HttpJob() : keepAlive(false), done(false), elapsed(0), received(0) {}
+
+    QList<HttpGet> gets;
+    bool           keepAlive; ///< don't ask to close after the last one
+    bool           done;
+    QString        error;
+    qint64         elapsed;   ///< ms from connect to the end
+    qint64         received;
+};
+
+/** \brief Runs HttpJobs at the same time on nonblocking sockets with
+ *         poll(), so hundreds of connections need only one thread.
+ */
+class HttpClient
+{
+  public:
+    HttpClient(quint16 port, const QByteArray &data) :
+        m_port(port), m_data(data) {}
+
+    /// \return true if every job got what it expected
+    bool Run(vector<HttpJob> &jobs, int timeout_ms = 120 * 1000)
+    {
+        const size_t kMaxConnecting = 50;
+
+        vector<Conn> conns(jobs.size());
+        size_t next = 0, connecting = 0, finished = 0;
+        QElapsedTimer clock;
+        clock.start();
+
+        while (finished < jobs.size())
+        {
+            for (; next < jobs.size() && connecting < kMaxConnecting; next++)
+            {
+                conns[next].job = &jobs[next];
+                if (Open(conns[next]))
+                    connecting++;
+                else
+                    finished++;
+            }
+
+            vector<struct pollfd> fds;
+            vector<Conn*> polled;
+            for (size_t i = 0; i < next; i++)
+            {
+                Conn &c = conns[i];
+                if (c.state == kDone)
+                    continue;
+                struct pollfd pfd;
+                pfd.fd = c.fd;
+                pfd.events = (c.state <= kSending) ? POLLOUT : POLLIN;
+                pfd.revents = 0;
+                fds.push_back(pfd);
+                polled.push_back(&c);
+            }
+
+            if (clock.elapsed() > timeout_ms)
+            {
+                for (size_t i = 0; i < polled.size(); i++)
+                    Finish(*polled[i], "timed out");
+                break;
+            }
+
+            if (poll(&fds[0], fds.size(), 100) < 0 && errno != EINTR)
+                break;
+
+            for (size_t i = 0; i < fds.size(); i++)
+            {
+                if (!fds[i].revents)
+                    continue;
+                Conn &c = *polled[i];
+                if (c.state == kConnecting)
+                    connecting--;
+                Step(c);
+                if (c.state == kDone)
+                    finished++;
+            }
+        }
+
+        bool ok = true;
+        for (size_t i = 0; i < jobs.size(); i++)
+            ok &= jobs[i].done && jobs[i].error.isEmpty();
+        return ok;
+    }
+
+  private:
+    typedef enum
+    {
+        kConnecting = 0,
+        kSending,
+        kHeader,
+        kBody,
+        kClosing,   ///< waiting for the server to hang up
+        kDone,
+    } State;
+
+    class Conn
+    {
+      public:
+        Conn() : job(NULL), fd(-1), state(kDone), get(0), sent(0),
+                 status(0), length(0), got(0) {}
+
+        HttpJob      *job;
+        int           fd;
+        State         state;
+        int           get;      ///< index into job->gets
+        QByteArray    out;
+        int           sent;
+        QByteArray    header;
+        int           status;
+        qint64        length;
+        qint64        got;
+        QElapsedTimer timer;
+    };
+
+    bool Open(Conn &c)
+    {
+        c.timer.start();
+        c.job->received = 0;
+        c.fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (c.fd < 0)
+        {
+            Finish(c, QString("socket() failed: %1").arg(strerror(errno)));
+            return false;
+        }
+        fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL) | O_NONBLOCK);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(m_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        c.state = kConnecting;
+        if (connect(c.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 &&
+            errno != EINPROGRESS)
+        {
+            Finish(c, QString("connect() failed: %1").arg(strerror(errno)));
+            return false;
+        }
+        return true;
+    }
+
+    void StartGet(Conn &c)
+    {
+        const HttpGet &get = c.job->gets[c.get];
+        bool last = (c.get + 1 == c.job->gets.size());
+
+        c.out = "GET " + get.path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+        if (!get.range.isEmpty())
+            c.out += "Range: " + get.range + "\r\n";
+        if (last && !c.job->keepAlive)
+            c.out += "Connection: close\r\n";
+        c.out += "\r\n";
+
+        c.sent = 0;
+        c.header.clear();
+        c.got = 0;
+        c.state = kSending;
+    }
+
+    void Step(Conn &c)
+    {
+        if (c.state == kConnecting)
+        {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err)
+            {
+                Finish(c, QString("connect failed: %1").arg(strerror(err)));
+                return;
+            }
+            StartGet(c);
+        }
+
+        if (c.state == kSending)
+        {
+            ssize_t ret = write(c.fd, c.out.constData() + c.sent,
+                                c.out.size() - c.sent);
+            if (ret < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                Finish(c, QString("write failed: %1").arg(strerror(errno)));
+                return;
+            }
+            if (ret > 0)
+                c.sent += ret;
+            if (c.sent == c.out.size())
+                c.state = kHeader;
+            return;
+        }
+
+        char buf[64 * 1024];
+        while (c.state != kDone)
+        {
+            ssize_t ret = read(c.fd, buf, sizeof(buf));
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN)
+                    Finish(c, QString("read failed: %1").arg(strerror(errno)));
+                return;
+            }
+            if (ret == 0)
+            {
+                Finish(c, (c.state == kClosing) ? QString() :
+                       QString("closed with %1 of %2 bytes of get %3")
+                           .arg(c.got).arg(c.length).arg(c.get));
+                return;
+            }
+            c.job->received += ret;
+            Received(c, buf, ret);
+        }
+    }
+
+    void Received(Conn &c, const char *buf, qint64 size)
+    {
+        if (c.state == kClosing)
+        {
+            Finish(c, "more data after the last response");
+            return;
+        }
+
+        if (c.state == kHeader)
+        {
+            c.header.append(buf, size);
+            int end = c.header.indexOf("\r\n\r\n");
+            if (end < 0)
+                return;
+
+            QByteArray body = c.header.mid(end + 4);
+            c.header.truncate(end);
+            if (!ParseHeader(c))
+                return;
+
+            c.state = kBody;
+            Body(c, body.constData(), body.size());
+            return;
+        }
+
+        Body(c, buf, size);
+    }
+
+    bool ParseHeader(Conn &c)
+    {
+        const HttpGet &get = c.job->gets[c.get];
+        QList<QByteArray> lines = c.header.split('\n');
+
+        c.status = lines[0].split(' ').value(1).toInt();
+        c.length = -1;
+        for (int i = 1; i < lines.size(); i++)
+        {
+            QByteArray line = lines[i].trimmed();
+            if (line.toLower().startsWith("content-length:"))
+                c.length = line.mid(15).trimmed().toLongLong();
+        }
+
+        if (c.status != get.status)
+        {
+            Finish(c, QString("get %1 expected %2 got '%3'")
+                       .arg(c.get).arg(get.status)
+                       .arg(QString(lines[0].trimmed())));
+            return false;
+        }
+        if (c.length < 0 || (get.length >= 0 && c.length != get.length))
+        {
+            Finish(c, QString("get %1 expected %2 bytes, Content-Length %3")
+                       .arg(c.get).arg(get.length).arg(c.length));
+            return false;
+        }
+        return true;
+    }
+
+    void Body(Conn &c, const char *buf, qint64 size)
+    {
+        const HttpGet &get = c.job->gets[c.get];
+
+        qint64 now = min(size, c.length - c.got);
+        if (get.start >= 0 &&
+            memcmp(buf, m_data.constData() + get.start + c.got, now) != 0)
+        {
+            Finish(c, QString("get %1 differs in bytes %2 to %3")
+                       .arg(c.get).arg(c.got).arg(c.got + now));
+            return;
+        }
+        c.got += now;
+
+        if (c.got < c.length)
+            return;
+
+        if (++c.get < c.job->gets.size())
+        {
+            if (size > now)
+            {
+                Finish(c, "response longer than Content-Length");
+                return;
+            }
+            StartGet(c);
+        }
+        else if (c.job->keepAlive)
+        {
+            Finish(c, QString());
+        }
+        else
+        {
+            c.state = kClosing;
+            if (size > now)
+                Received(c, buf + now, size - now);
+        }
+    }
+
+    void Finish(Conn &c, const QString &error)
+    {
+        if (c.fd >= 0)
+            close(c.fd);
+        c.fd = -1;
+        c.state = kDone;
+        c.job->done = true;
+        c.job->error = error;
+        c.job->elapsed = c.timer.elapsed();
+    }
+
+    quint16           m_port;
+    const QByteArray &m_data;
+};
+
+/// Runs an HttpClient so the server can use the main thread
+class ClientThread : public QThread
+{
+  public:
+    ClientThread(quint16 port, const QByteArray &data, vector<HttpJob> &jobs) :
+        m_client(port, data), m_jobs(jobs), m_ok(false) {}
+
+    void run(void) { m_ok = m_client.Run(m_jobs); }
+
+    bool Wait(void)
+    {
+        start();
+        while (!wait(10))
+            QCoreApplication::processEvents();
+        return m_ok;
+    }
+
+  private:
+    HttpClient       m_client;
+    vector<HttpJob> &m_jobs;
+    bool             m_ok;
+};
+
+/// Times one small request after another until stopped
+class PingThread : public QThread
+{
+  public:
+    PingThread(quint16 port, const QByteArray &data) :
+        m_client(port, data), m_stop(false),
+        m_count(0), m_failed(0), m_total(0), m_max(0) {}
+
+    void run(void)
+    {
+        HttpGet ping = { "/test/ping", QByteArray(), 200, -1, -1 };
+        while (!m_stop)
+        {
+            vector<HttpJob> jobs(1);
+            jobs[0].gets.push_back(ping);
+            if (m_client.Run(jobs, 30 * 1000))
+            {
+                m_count++;
+                m_total += jobs[0].elapsed;
+                m_max = max(m_max, jobs[0].elapsed);
+            }
+            else
+            {
+                m_failed++;
+            }
+            msleep(20);
+        }
+    }
+
+    HttpClient    m_client;
+    volatile bool m_stop;
+    int           m_count;
+    int           m_failed;
+    qint64        m_total;
+    qint64        m_max;
+};
+
+static QString job_errors(const vector<HttpJob> &jobs)
+{
+    QStringList errors;
+    for (size_t i = 0; i < jobs.size() && errors.size() < 5; i++)
+    {
+        if (!jobs[i].done)
+            errors << QString("job %1 not done").arg(i);
+        else if (!jobs[i].error.isEmpty())
+            errors << QString("job %1: %2").arg(i).arg(jobs[i].error);
+    }
+    return errors.join("; ");
+}
+
+void TestHttpServer::initTestCase(void)
+{
+    gCoreContext = new MythCoreContext("bin_version", NULL);
+    gCoreContext->GetDB()->IgnoreDatabase(true);
+
+    m_data = make_pattern(8 * 1024 * 1024, 7);
+    QVERIFY (m_file.open());
+    QCOMPARE (m_file.write(m_data), (qint64) m_data.size());
+    QVERIFY (m_file.flush());
+
+    // ServerPool does not say which port it got for 0, so find one
+    QTcpServer probe;
+    QVERIFY (probe.listen(QHostAddress::LocalHost));
+    m_port = probe.serverPort();
+    probe.close();
+
+    m_server = new HttpServer();
+    m_extension = new TestFileExtension(m_file.fileName());
+    m_server->RegisterExtension(m_extension);
+    QVERIFY (m_server->listen(QList<QHostAddress>() <<
+                              QHostAddress(QHostAddress::LocalHost), m_port));
+
+    if (!m_server->GetMultiplexer())
+        qDebug() << "No HttpMultiplexer, every connection holds a thread";
+}
+
+void TestHttpServer::cleanupTestCase(void)
+{
+    // The server deletes its extensions
+    delete m_server;
+    m_server = NULL;
+
+    delete gCoreContext;
+    gCoreContext = NULL;
+}
+
+void TestHttpServer::Range_test_data(void)
+{
+    QTest::addColumn<QByteArray>("range");
+    QTest::addColumn<int>("status");
+    QTest::addColumn<qint64>("start");
+    QTest::addColumn<qint64>("length");
+
+    qint64 size = 8 * 1024 * 1024;
+
+    QTest::newRow("whole file") << QByteArray() << 200 << 0LL << size;
+    QTest::newRow("small range")
+        << QByteArray("bytes=0-99") << 206 << 0LL << 100LL;
+    QTest::newRow("large range")
+        << QByteArray("bytes=300000-1299999") << 206 << 300000LL << 1000000LL;
+    QTest::newRow("open range")
+        << QByteArray("bytes=1000-") << 206 << 1000LL << size - 1000;
+    QTest::newRow("suffix range")
+        << QByteArray("bytes=-5000") << 206 << size - 5000 << 5000LL;
+    QTest::newRow("beyond the end")
+        << QByteArray("bytes=9000000-9000100") << 416 << -1LL << 0LL;
+}
+
+void TestHttpServer::Range_test(void)
+{
+    QFETCH(QByteArray, range);
+    QFETCH(int, status);
+    QFETCH(qint64, start);
+    QFETCH(qint64, length);
+
+    HttpGet get = { "/test/file", range, status, start, length };
+
+    vector<HttpJob> jobs(2);
+    jobs[0].gets.push_back(get);
+    jobs[1].gets.push_back(get);
+    jobs[1].keepAlive = true;
+
+    ClientThread client(m_port, m_data, jobs);
+    QVERIFY2 (client.Wait(), qPrintable(job_errors(jobs)));
+}
+
+void TestHttpServer::KeepAlive_test(void)
+{
+    qint64 size = m_data.size();
+    HttpGet small = { "/test/file", "bytes=10-1009", 206, 10, 1000 };
+    HttpGet large = { "/test/file", "bytes=4096-", 206, 4096, size - 4096 };
+    HttpGet whole = { "/test/file", QByteArray(), 200, 0, size };
+    HttpGet ping  = { "/test/ping", QByteArray(), 200, -1, -1 };
+
+    vector<HttpJob> jobs(1);
+    jobs[0].gets << ping << large << small << whole << ping << large << ping;
+
+    ClientThread client(m_port, m_data, jobs);
+    QVERIFY2 (client.Wait(), qPrintable(job_errors(jobs)));
+
+#ifdef __linux__
+    if (m_server->GetMultiplexer())
+    {
+        HttpMultiplexerStats stats = m_server->GetMultiplexer()->GetStats();
+        QVERIFY (stats.streams >= 3);
+        QCOMPARE (stats.stream_errors, (uint64_t) 0);
+    }
+#endif
+}
+
+void TestHttpServer::Load_benchmark(void)
+{
+    int clients = env_int("MYTHTV_HTTP_CLIENTS", 200);
+    qint64 range = env_int("MYTHTV_HTTP_RANGE_KB", 1024) * 1024LL;
+    range = min(range, (qint64) m_data.size() / 2);
+
+    vector<HttpJob> jobs(clients);
+    for (int i = 0; i < clients; i++)
+    {
+        qint64 start = (i * 7919LL * 1024) % (m_data.size() - range);
+        HttpGet get = { "/test/file",
+                        QString("bytes=%1-%2").arg(start)
+                            .arg(start + range - 1).toLatin1(),
+                        206, start, range };
+        jobs[i].gets.push_back(get);
+    }
+
+#ifdef __linux__
+    HttpMultiplexerStats before;
+    if (m_server->GetMultiplexer())
+        before = m_server->GetMultiplexer()->GetStats();
+#endif
+
+    PingThread ping(m_port, m_data);
+    ClientThread client(m_port, m_data, jobs);
+
+    QElapsedTimer timer;
+    timer.start();
+    ping.start();
+    bool ok = false;
+    QBENCHMARK_ONCE
+    {
+        ok = client.Wait();
+    }
+    qint64 elapsed = max(timer.elapsed(), 1LL);
+    ping.m_stop = true;
+    while (!ping.wait(10))
+        QCoreApplication::processEvents();
+
+    QVERIFY2 (ok, qPrintable(job_errors(jobs)));
+
+    qint64 total = 0, slowest = 0;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        total += jobs[i].received;
+        slowest = max(slowest, jobs[i].elapsed);
+    }
+
+    qDebug() << qPrintable(QString(
+        "%1 clients x %2 KB: %3 MB/s, slowest %4 ms, "
+        "ping during load avg %5 ms max %6 ms (%7 sent, %8 failed)")
+        .arg(clients).arg(range / 1024)
+        .arg(total / 1048576.0 * 1000.0 / elapsed, 0, 'f', 1)
+        .arg(slowest)
+        .arg(ping.m_count ? ping.m_total / (double) ping.m_count : 0.0,
+             0, 'f', 1)
+        .arg(ping.m_max).arg(ping.m_count).arg(ping.m_failed));
+
+#ifdef __linux__
+    if (m_server->GetMultiplexer())
+    {
+        HttpMultiplexerStats after = m_server->GetMultiplexer()->GetStats();
+        qDebug() << qPrintable(QString(
+            "multiplexer: %1 streams, %2 errors, %3 timeouts, %4 MB sent")
+            .arg(after.streams - before.streams)
+            .arg(after.stream_errors - before.stream_errors)
+            .arg(after.timeouts - before.timeouts)
+            .arg((after.bytes_sent - before.bytes_sent) / 1048576.0,
+                 0, 'f', 1));
+    }
+#endif
+
+    QCOMPARE (ping.m_failed, 0);
+}
+
+int main(int argc, char *argv[])
+{
+    // HttpServer accepts connections on the main thread's event loop
+    QCoreApplication app(argc, argv);
+    TestHttpServer test;
+    return QTest::qExec(&test, argc, argv);
+}
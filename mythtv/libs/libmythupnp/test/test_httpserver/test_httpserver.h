@@ -0,0 +1,58 @@
+/*
+ *  Class TestHttpServer
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QtTest/QtTest>
+#include <QTemporaryFile>
+
+class HttpServer;
+class TestFileExtension;
+
+class TestHttpServer: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase(void);
+    void cleanupTestCase(void);
+
+    /** test that whole files and ranges of them come back with the
+     *  right status and the right bytes, small ones sent by the
+     *  worker and large ones by the multiplexer
+     */
+    void Range_test_data(void);
+    void Range_test(void);
+
+    /** test that a keep-alive connection goes on answering requests
+     *  after being handed to the multiplexer and back
+     */
+    void KeepAlive_test(void);
+
+    /** opens many connections at once, each asking for a range of
+     *  a file, and times a small request made while they are served.
+     *  MYTHTV_HTTP_CLIENTS  concurrent range requests (default 200)
+     *  MYTHTV_HTTP_RANGE_KB size of each range (default 1024)
+     */
+    void Load_benchmark(void);
+
+  private:
+    QByteArray         m_data;
+    QTemporaryFile     m_file;
+    HttpServer        *m_server;
+    TestFileExtension *m_extension;
+    quint16            m_port;
+};
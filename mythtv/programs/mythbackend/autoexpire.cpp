@@ -40,6 +40,7 @@ using namespace std;
 #include "mainserver.h"
 #include "compat.h"
 #include "mythlogging.h"
+#include "mythevent.h"
 
 #define LOC     QString("AutoExpire: ")
 #define LOC_ERR QString("AutoExpire Error: ")
@@ -51,6 +52,8 @@ extern AutoExpire *expirer;
  */
 #define SPACE_TOO_BIG_KB 3*1024*1024
 
+const int AutoExpire::kMinRateSpan;
+
 /// \brief This calls AutoExpire::RunExpirer() from within a new thread.
 void ExpireThread::run(void)
 {
@@ -207,10 +210,23 @@ void AutoExpire::CalcParams()
                                 "from used list.").arg(*encit));
                     instance_lock.lock();
                     used_encoders.remove(*encit);
+                    recorder_rates.remove(*encit);
                     instance_lock.unlock();
                     continue;
                 }
 
+                uint64_t encKBperMin = GetRecorderRate(enc);
+                if (encKBperMin)
+                {
+                    thisKBperMin += encKBperMin;
+                    LOG(VB_FILE, LOG_INFO, QString("    Cardid %1: writing "
+                            "%2 KB/min, fsID %3 max is now %4 KB/min")
+                            .arg(enc->GetInputID()).arg(encKBperMin)
+                            .arg(fsit->getFSysID())
+                            .arg(thisKBperMin));
+                    continue;
+                }
+
                 uint64_t maxBitrate = enc->GetMaxBitrate();
                 if (maxBitrate<=0)
                     maxBitrate = 19500000LL;
@@ -263,6 +279,47 @@ void AutoExpire::CalcParams()
     instance_lock.unlock();
 }
 
+/** \brief The rate a recorder is writing at in KB/min, or 0 if it
+ *         is not known.
+ *
+ *  This is measured from the file position of a local recorder over
+ *  at least kMinRateSpan seconds, so it is known from the second call
+ *  of CalcParams() for a recording. Remote recorders can't be asked,
+ *  so their maximum bitrate is used.
+ */
+uint64_t AutoExpire::GetRecorderRate(EncoderLink *enc)
+{
+    if (!enc->IsLocal())
+        return 0;
+
+    int64_t pos = enc->GetFilePosition();
+    if (pos < 0)
+        return 0;
+
+    QDateTime now = MythDate::current();
+    QMutexLocker locker(&instance_lock);
+    RecorderRate &rate = recorder_rates[enc->GetInputID()];
+
+    // A new recording starts a new file
+    if (!rate.when.isValid() || pos < rate.pos)
+    {
+        rate = RecorderRate();
+        rate.when = now;
+        rate.pos = pos;
+        return 0;
+    }
+
+    int64_t secs = rate.when.secsTo(now);
+    if (secs >= kMinRateSpan)
+    {
+        rate.kbPerMin = ((pos - rate.pos) * 60 / secs) >> 10;
+        rate.when = now;
+        rate.pos = pos;
+    }
+
+    return rate.kbPerMin;
+}
+
 /** \brief This contains the main loop for the auto expire process.
  *
  *   Responsible for cleanup of old LiveTV programs as well as deleting as
@@ -270,6 +327,8 @@ void AutoExpire::CalcParams()
  *   maintain enough free space on all directories in MythTV Storage Groups.
  *   The thread deletes short LiveTV programs every 2 minutes and long
  *   LiveTV and regular programs as needed every "desired_freq" minutes.
+ *   When Update() says a recorder is starting, the space needed is
+ *   worked out again and regular programs are expired at once.
  */
 void AutoExpire::RunExpirer(void)
 {
@@ -287,18 +346,21 @@ void AutoExpire::RunExpirer(void)
     while (expire_thread_run)
     {
         curTime = MythDate::current();
-        // recalculate auto expire parameters
-        if (curTime >= next_expire)
+
+        bool updated = false;
+        update_lock.lock();
+        while (!update_queue.empty())
         {
-            update_lock.lock();
-            while (!update_queue.empty())
-            {
-                UpdateEntry ue = update_queue.dequeue();
-                if (ue.encoder > 0)
-                    used_encoders[ue.encoder] = ue.fsID;
-            }
-            update_lock.unlock();
+            UpdateEntry ue = update_queue.dequeue();
+            if (ue.encoder > 0)
+                used_encoders[ue.encoder] = ue.fsID;
+            updated = true;
+        }
+        update_lock.unlock();
 
+        // recalculate auto expire parameters
+        if (updated || curTime >= next_expire)
+        {
             locker.unlock();
             CalcParams();
             locker.relock();
@@ -332,6 +394,11 @@ void AutoExpire::RunExpirer(void)
 
             ExpireRecordings();
         }
+        else if (updated)
+        {
+            LOG(VB_FILE, LOG_INFO, LOC + "Running for a new recording");
+            ExpireRecordings();
+        }
 
         Sleep(60 * 1000 - timer.elapsed());
     }
@@ -339,7 +406,8 @@ void AutoExpire::RunExpirer(void)
 
 /** \fn AutoExpire::Sleep(int sleepTime)
  *  \brief Sleeps for sleepTime milliseconds; unless the expire thread
- *         is told to quit. Must be called with instance_lock held.
+ *         is told to quit or Update() has queued an update.
+ *         Must be called with instance_lock held.
  *
  *  \note Will release instance_lock!
  */
@@ -352,6 +420,12 @@ void AutoExpire::Sleep(int sleepTime)
     int timeleft = sleepTime;
     while (expire_thread_run && (timeleft > 0))
     {
+        update_lock.lock();
+        bool updated = !update_queue.empty();
+        update_lock.unlock();
+        if (updated)
+            return;
+
         instance_cond.wait(&instance_lock, timeleft);
         timeleft = MythDate::current().secsTo(little_tm) * 1000;
     }
@@ -399,10 +473,12 @@ void AutoExpire::ExpireQuickDeleted(void)
 /** \fn AutoExpire::ExpireRecordings()
  *  \brief This expires normal recordings.
  *
+ *  The recordings are taken from expire_candidates, in the order of
+ *  FillExpireList(), and only those in the directories of a filesystem
+ *  short of space are looked at for it.
  */
 void AutoExpire::ExpireRecordings(void)
 {
-    pginfolist_t expireList;
     pginfolist_t deleteList;
     QList<FileSystemInfo> fsInfos;
     QList<FileSystemInfo>::iterator fsit;
@@ -420,7 +496,12 @@ void AutoExpire::ExpireRecordings(void)
         return;
     }
 
-    FillExpireList(expireList);
+    expire_candidates.ProcessEvents();
+    expire_candidates.SetOrder(
+        gCoreContext->GetNumSetting("AutoExpireMethod", 1),
+        gCoreContext->GetNumSetting("AutoExpireWatchedPriority", 0),
+        gCoreContext->GetNumSetting("AutoExpireDayPriority", 3));
+    bool resolved = false;
 
     QMap <int, bool> truncateMap;
     MSqlQuery query(MSqlQuery::InitCon());
@@ -509,7 +590,7 @@ void AutoExpire::ExpireRecordings(void)
                 QString("    Not Enough Free Space!  We want %1 MB")
                     .arg(desired_space[fsit->getFSysID()] / 1024));
 
-            QMap<QString, int> dirList;
+            QSet<QString> dirList;
             QList<FileSystemInfo>::iterator fsit2;
 
             LOG(VB_FILE, LOG_INFO,
@@ -522,92 +603,168 @@ void AutoExpire::ExpireRecordings(void)
                 {
                     LOG(VB_FILE, LOG_INFO, QString("        %1:%2")
                             .arg(fsit2->getHostname()).arg(fsit2->getPath()));
-                    dirList[fsit2->getHostname() + ":" + fsit2->getPath()] = 1;
+                    dirList.insert(fsit2->getHostname() + ":" +
+                                   fsit2->getPath());
                 }
             }
 
+            if (!resolved)
+            {
+                ResolveCandidates();
+                resolved = true;
+            }
+
             LOG(VB_FILE, LOG_INFO,
                 "    Searching for files expirable in these directories");
-            QString myHostName = gCoreContext->GetHostName();
-            pginfolist_t::iterator it = expireList.begin();
-            while ((it != expireList.end()) &&
+            vector<const ExpireCandidates::Candidate*> queue;
+            expire_candidates.GetQueue(dirList, queue);
+            vector<const ExpireCandidates::Candidate*>::iterator it =
+                queue.begin();
+            while ((it != queue.end()) &&
                    (max((int64_t)0LL, fsit->getFreeSpace()) <
                     desired_space[fsit->getFSysID()]))
             {
-                ProgramInfo *p = *it;
+                const ExpireCandidates::Candidate *c = *it;
                 ++it;
 
-                LOG(VB_FILE, LOG_INFO, QString("        Checking %1 => %2")
-                        .arg(p->toString(ProgramInfo::kRecordingKey))
-                        .arg(p->GetTitle()));
-
-                if (!p->IsLocal())
+                if (IsInDontExpireSet(c->chanid, c->recstartts))
                 {
-                    bool foundFile = false;
-                    QMap<int, EncoderLink *>::Iterator eit =
-                         encoderList->begin();
-                    while (eit != encoderList->end())
-                    {
-                        EncoderLink *el = *eit;
-                        eit++;
-
-                        if ((p->GetHostname() == el->GetHostName()) ||
-                            ((p->GetHostname() == myHostName) &&
-                             (el->IsLocal())))
-                        {
-                            if (el->IsConnected())
-                                foundFile = el->CheckFile(p);
-
-                            eit = encoderList->end();
-                        }
-                    }
-
-                    if (!foundFile && (p->GetHostname() != myHostName))
-                    {
-                        // Wasn't found so check locally
-                        QString file = GetPlaybackURL(p);
-
-                        if (file.startsWith("/"))
-                        {
-                            p->SetPathname(file);
-                            p->SetHostname(myHostName);
-                            foundFile = true;
-                        }
-                    }
-
-                    if (!foundFile)
-                    {
-                        LOG(VB_FILE, LOG_ERR, LOC +
-                            QString("        ERROR: Can't find file for %1")
-                                .arg(p->toString(ProgramInfo::kRecordingKey)));
-                        continue;
-                    }
+                    LOG(VB_FILE, LOG_INFO,
+                        QString("        Skipping %1 at %2 because it is in "
+                                "Don't Expire List")
+                            .arg(c->chanid)
+                            .arg(c->recstartts.toString(Qt::ISODate)));
+                    continue;
                 }
 
-                QFileInfo vidFile(p->GetPathname());
-                if (dirList.contains(p->GetHostname() + ':' + vidFile.path()))
+                ProgramInfo *p = new ProgramInfo(c->recordedid);
+                if (!p->GetChanID())
                 {
-                    fsit->setUsedSpace(fsit->getUsedSpace()
-                                                - (p->GetFilesize() / 1024));
-                    deleteList.push_back(p);
+                    LOG(VB_FILE, LOG_INFO,
+                        QString("        Skipping %1 at %2 because it could "
+                                "not be loaded from the DB")
+                            .arg(c->chanid)
+                            .arg(c->recstartts.toString(Qt::ISODate)));
+                    delete p;
+                    continue;
+                }
 
+                // The cached candidate may be out of date, the user may
+                // have protected it since
+                if ((!p->IsAutoExpirable() &&
+                     p->GetRecordingGroup() != "Deleted") ||
+                    p->IsDeletePending())
+                {
                     LOG(VB_FILE, LOG_INFO,
-                        QString("        FOUND file expirable. "
-                                "%1 is located at %2 which is on fsID #%3. "
-                                "Adding to deleteList.  After deleting we "
-                                "should have %4 MB free on this filesystem.")
-                            .arg(p->toString(ProgramInfo::kRecordingKey))
-                            .arg(p->GetPathname()).arg(fsit->getFSysID())
-                            .arg(fsit->getFreeSpace() / 1024));
+                        QString("        Skipping %1 at %2 because it is no "
+                                "longer expirable")
+                            .arg(c->chanid)
+                            .arg(c->recstartts.toString(Qt::ISODate)));
+                    expire_candidates.Remove(c->recordedid);
+                    delete p;
+                    continue;
                 }
+
+                fsit->setUsedSpace(fsit->getUsedSpace() - (c->filesize / 1024));
+                deleteList.push_back(p);
+
+                LOG(VB_FILE, LOG_INFO,
+                    QString("        FOUND file expirable. "
+                            "%1 is located in %2 which is on fsID #%3. "
+                            "Adding to deleteList.  After deleting we "
+                            "should have %4 MB free on this filesystem.")
+                        .arg(p->toString(ProgramInfo::kRecordingKey))
+                        .arg(c->dir).arg(fsit->getFSysID())
+                        .arg(fsit->getFreeSpace() / 1024));
             }
         }
     }
 
     SendDeleteMessages(deleteList);
 
-    ClearExpireList(deleteList, false);
-    ClearExpireList(expireList);
+    // They are gone as far as AutoExpire is concerned, the events
+    // from deleting them would only say so later
+    pginfolist_t::iterator dit = deleteList.begin();
+    for (; dit != deleteList.end(); ++dit)
+        expire_candidates.Remove((*dit)->GetRecordingID());
+
+    ClearExpireList(deleteList);
+}
+
+/** \brief Finds the directory of each candidate not found yet.
+ *
+ *  This looks at the file, on a slave backend if need be, so it is only
+ *  done when some filesystem is short of space, and once for each
+ *  recording, see ExpireCandidates::SetDir().
+ */
+void AutoExpire::ResolveCandidates(void)
+{
+    vector<uint> ids = expire_candidates.Unresolved();
+    if (ids.empty())
+        return;
+
+    LOG(VB_FILE, LOG_INFO, LOC +
+        QString("Looking for the files of %1 recordings").arg(ids.size()));
+
+    QString myHostName = gCoreContext->GetHostName();
+    vector<uint>::const_iterator idit = ids.begin();
+    for (; idit != ids.end(); ++idit)
+    {
+        ProgramInfo pginfo(*idit);
+        ProgramInfo *p = &pginfo;
+        if (!p->GetChanID())
+        {
+            expire_candidates.SetDir(*idit, QString());
+            continue;
+        }
+
+        if (!p->IsLocal())
+        {
+            bool foundFile = false;
+            QMap<int, EncoderLink *>::Iterator eit = encoderList->begin();
+            while (eit != encoderList->end())
+            {
+                EncoderLink *el = *eit;
+                eit++;
+
+                if ((p->GetHostname() == el->GetHostName()) ||
+                    ((p->GetHostname() == myHostName) &&
+                     (el->IsLocal())))
+                {
+                    if (el->IsConnected())
+                        foundFile = el->CheckFile(p);
+
+                    eit = encoderList->end();
+                }
+            }
+
+            if (!foundFile && (p->GetHostname() != myHostName))
+            {
+                // Wasn't found so check locally
+                QString file = GetPlaybackURL(p);
+
+                if (file.startsWith("/"))
+                {
+                    p->SetPathname(file);
+                    p->SetHostname(myHostName);
+                    foundFile = true;
+                }
+            }
+
+            if (!foundFile)
+            {
+                LOG(VB_FILE, LOG_ERR, LOC +
+                    QString("ERROR: Can't find file for %1")
+                        .arg(p->toString(ProgramInfo::kRecordingKey)));
+                expire_candidates.SetDir(*idit, QString());
+                continue;
+            }
+        }
+
+        QFileInfo vidFile(p->GetPathname());
+        expire_candidates.SetDir(*idit, p->GetHostname() + ':' +
+                                 vidFile.path());
+    }
 }
 
 /**
@@ -1071,9 +1228,20 @@ void AutoExpire::Update(int encoder, int fsID, bool immediately)
         expirer->update_lock.lock();
         expirer->update_queue.append(UpdateEntry(encoder, fsID));
         expirer->update_lock.unlock();
+        expirer->instance_cond.wakeAll();
     }
 }
 
+/// Passes on the events expire_candidates is kept up to date from
+void AutoExpire::customEvent(QEvent *e)
+{
+    if ((MythEvent::Type)(e->type()) != MythEvent::MythEventMessage)
+        return;
+
+    MythEvent *me = (MythEvent *)e;
+    expire_candidates.HandleEvent(*me);
+}
+
 void AutoExpire::UpdateDontExpireSet(void)
 {
     dont_expire_set.clear();
@@ -17,6 +17,7 @@ using namespace std;
 #include <QMap>
 
 #include "mthread.h"
+#include "expirecandidates.h"
 
 class ProgramInfo;
 class EncoderLink;
@@ -59,6 +60,17 @@ class UpdateEntry
     int fsID;
 };
 
+/// What a local recorder has written, for AutoExpire::GetRecorderRate()
+class RecorderRate
+{
+  public:
+    RecorderRate() : pos(0), kbPerMin(0) {}
+
+    QDateTime when;
+    int64_t   pos;
+    uint64_t  kbPerMin;
+};
+
 class AutoExpire : public QObject
 {
     Q_OBJECT
@@ -89,8 +101,12 @@ class AutoExpire : public QObject
 
     QMap<int, EncoderLink *> *encoderList;
 
+    /// seconds a recorder's rate is measured over
+    static const int kMinRateSpan = 60;
+
   protected:
     void RunExpirer(void);
+    void customEvent(QEvent *e);
 
   private:
     void ExpireLiveTV(int type);
@@ -99,6 +115,9 @@ class AutoExpire : public QObject
     void ExpireRecordings(void);
     void ExpireEpisodesOverMax(void);
 
+    void ResolveCandidates(void);
+    uint64_t GetRecorderRate(EncoderLink *enc);
+
     void FillExpireList(pginfolist_t &expireList);
     void FillDBOrdered(pginfolist_t &expireList, int expMethod);
     void SendDeleteMessages(pginfolist_t &deleteList);
@@ -117,6 +136,10 @@ class AutoExpire : public QObject
 
     QMap<int, int64_t>  desired_space; // protected by instance_lock
     QMap<int, int>      used_encoders; // protected by instance_lock
+    QMap<int, RecorderRate> recorder_rates; // protected by instance_lock
+
+    // only used by the expire thread
+    ExpireCandidates    expire_candidates;
 
     mutable QMutex instance_lock;
     QWaitCondition instance_cond; // protected by instance_lock
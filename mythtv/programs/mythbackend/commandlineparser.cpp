@@ -24,6 +24,13 @@ void MythBackendCommandLineParser::LoadArguments(void)
          << add("--testsched", "testsched", false,
                 "do some scheduler testing.", "")
 //                    ->SetDeprecated("use mythutil instead")
+         << add("--benchsched", "benchsched", 10,
+                "Time repeated scheduler runs against the database.",
+                "Runs the scheduler the given number of times against the "
+                "database this backend is configured for, without starting "
+                "the backend, and prints how long each phase took and the "
+                "resulting schedule. Meant for a copy of the database or a "
+                "fixture from contrib/development/schedbench.")
          << add("--resched", "resched", false,
                 "Trigger a run of the recording scheduler on the existing "
                 "master backend.",
@@ -67,6 +74,10 @@ void MythBackendCommandLineParser::LoadArguments(void)
 //                    ->SetDeprecated("use mythutil instead");
     );
 
+    add("--nomatchindex", "nomatchindex", false, "",
+            "Intended for debugging use only, match all recording rules "
+            "with database queries rather than the in memory program "
+            "index. Also applies to --benchsched.");
     add("--nosched", "nosched", false, "",
             "Intended for debugging use only, disable the scheduler "
             "on this backend if it is the master backend, preventing "
@@ -0,0 +1,359 @@
+// C++ headers
+#include <algorithm>
+using namespace std;
+
+// MythTV headers
+#include "expirecandidates.h"
+#include "autoexpire.h"
+#include "programinfo.h"
+#include "mythdbcon.h"
+#include "mythdb.h"
+#include "mythlogging.h"
+#include "mythevent.h"
+#include "mythdate.h"
+
+#define LOC QString("ExpireCandidates: ")
+
+const int ExpireCandidates::kMaxAge;
+const int ExpireCandidates::kRetryTime;
+
+static const char *kCandidateQuery =
+    "SELECT recordedid, chanid, starttime, hostname, filesize, "
+    "       recgroup = 'Deleted', autoexpire, watched, recpriority, "
+    "       lastmodified "
+    "FROM recorded "
+    "WHERE (autoexpire > 0 OR recgroup = 'Deleted') "
+    "  AND deletepending = 0 ";
+
+/// The order of AutoExpire::FillExpireList(), recordedid breaks ties
+bool ExpireCandidates::Before::operator()(
+    const Candidate *a, const Candidate *b) const
+{
+    if (a->group != b->group)
+        return a->group < b->group;
+    if (a->autoexpire != b->autoexpire)
+        return a->autoexpire > b->autoexpire;
+    if (a->watched != b->watched)
+        return a->watched > b->watched;
+    if (a->key1 != b->key1)
+        return a->key1 < b->key1;
+    if (a->key2 != b->key2)
+        return a->key2 < b->key2;
+    return a->recordedid < b->recordedid;
+}
+
+ExpireCandidates::ExpireCandidates() :
+    m_loaded(false), m_expMethod(emOldestFirst), m_watchedFirst(false),
+    m_dayPriority(3)
+{
+}
+
+ExpireCandidates::~ExpireCandidates()
+{
+    Clear();
+}
+
+void ExpireCandidates::Clear(void)
+{
+    QHash<uint, Candidate*>::iterator it = m_entries.begin();
+    for (; it != m_entries.end(); ++it)
+        delete *it;
+    m_entries.clear();
+    m_queues.clear();
+    m_loaded = false;
+}
+
+/** \brief Applies the events seen since it was last called, loading
+ *         everything the first time and every kMaxAge.
+ *  \return true if any candidate was added, changed or removed
+ */
+bool ExpireCandidates::ProcessEvents(void)
+{
+    QSet<uint> stale;
+    QMap<uint, uint64_t> filesizes;
+    bool invalidate = m_changes.Take(stale, filesizes);
+
+    if (invalidate || !m_loaded || m_age.elapsed() > kMaxAge)
+        return Load();
+
+    bool changed = false;
+
+    QSet<uint>::const_iterator sit = stale.begin();
+    for (; sit != stale.end(); ++sit)
+        changed |= Reload(*sit);
+
+    QMap<uint, uint64_t>::const_iterator fit = filesizes.begin();
+    for (; fit != filesizes.end(); ++fit)
+    {
+        Candidate *c = m_entries.value(fit.key(), NULL);
+        if (c && c->filesize != *fit)
+        {
+            c->filesize = *fit;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+/** \brief Loads all the candidates with one query.
+ *
+ *  The directories found for the candidates already known are kept,
+ *  unless the recording has moved to another host.
+ */
+bool ExpireCandidates::Load(void)
+{
+    MythTimer timer;
+    timer.start();
+
+    MSqlQuery query(MSqlQuery::InitCon());
+    query.prepare(kCandidateQuery);
+    if (!query.exec())
+    {
+        MythDB::DBError(LOC + "Load", query);
+        return false;
+    }
+
+    QHash<uint, Candidate*> old = m_entries;
+    m_entries.clear();
+    m_queues.clear();
+
+    while (query.next())
+    {
+        Candidate *c = FromQuery(query);
+        Candidate *prev = old.take(c->recordedid);
+        if (prev && prev->hostname == c->hostname)
+        {
+            c->dir   = prev->dir;
+            c->retry = prev->retry;
+        }
+        delete prev;
+        Insert(c);
+    }
+
+    QHash<uint, Candidate*>::iterator it = old.begin();
+    for (; it != old.end(); ++it)
+        delete *it;
+
+    m_loaded = true;
+    m_age.start();
+
+    LOG(VB_FILE, LOG_INFO, LOC + QString("Loaded %1 candidates in %2 ms")
+            .arg(m_entries.size()).arg(timer.elapsed()));
+
+    return true;
+}
+
+/// Loads one candidate again, or drops it if it is no longer one
+bool ExpireCandidates::Reload(uint recordedid)
+{
+    MSqlQuery query(MSqlQuery::InitCon());
+    query.prepare(QString(kCandidateQuery) + "AND recordedid = :RECORDEDID");
+    query.bindValue(":RECORDEDID", recordedid);
+    if (!query.exec())
+    {
+        MythDB::DBError(LOC + "Reload", query);
+        return false;
+    }
+
+    Candidate *prev = m_entries.value(recordedid, NULL);
+    if (prev)
+        Take(prev);
+
+    if (!query.next())
+    {
+        delete prev;
+        return prev != NULL;
+    }
+
+    Candidate *c = FromQuery(query);
+    if (prev && prev->hostname == c->hostname)
+    {
+        c->dir   = prev->dir;
+        c->retry = prev->retry;
+    }
+    delete prev;
+    Insert(c);
+
+    return true;
+}
+
+ExpireCandidates::Candidate *ExpireCandidates::FromQuery(
+    const MSqlQuery &query) const
+{
+    Candidate *c = new Candidate();
+    c->recordedid   = query.value(0).toUInt();
+    c->chanid       = query.value(1).toUInt();
+    c->recstartts   = MythDate::as_utc(query.value(2).toDateTime());
+    c->hostname     = query.value(3).toString();
+    c->filesize     = query.value(4).toULongLong();
+    c->group        = query.value(5).toBool() ? 0 : 1;
+    c->autoexpire   = query.value(6).toInt();
+    c->isWatched    = query.value(7).toBool();
+    c->recpriority  = query.value(8).toInt();
+    c->lastmodified = MythDate::as_utc(query.value(9).toDateTime());
+    SetKeys(c);
+    return c;
+}
+
+/// Works out where the candidate goes, from the order in use
+void ExpireCandidates::SetKeys(Candidate *c) const
+{
+    c->key1 = c->key2 = 0;
+    c->watched = 0;
+
+    if (c->group == 0)
+    {
+        c->key1 = c->lastmodified.toTime_t();
+        return;
+    }
+
+    if (m_watchedFirst)
+        c->watched = c->isWatched ? 1 : 0;
+
+    int64_t start = c->recstartts.toTime_t();
+    switch (m_expMethod)
+    {
+        default:
+        case emOldestFirst:
+            c->key1 = start;
+            break;
+        case emLowestPriorityFirst:
+            c->key1 = c->recpriority;
+            c->key2 = start;
+            break;
+        case emWeightedTimePriority:
+            c->key1 = start +
+                (int64_t)m_dayPriority * c->recpriority * 24 * 60 * 60;
+            break;
+    }
+}
+
+void ExpireCandidates::Insert(Candidate *c)
+{
+    m_entries[c->recordedid] = c;
+    m_queues[c->dir].insert(c);
+}
+
+void ExpireCandidates::Take(Candidate *c)
+{
+    m_entries.remove(c->recordedid);
+
+    QMap<QString, Queue>::iterator it = m_queues.find(c->dir);
+    if (it == m_queues.end())
+        return;
+    (*it).erase(c);
+    if ((*it).empty())
+        m_queues.erase(it);
+}
+
+/** \brief Sets the order from the AutoExpire settings.
+ *  \return true if the order changed
+ */
+bool ExpireCandidates::SetOrder(int expMethod, bool watchedFirst,
+                                int dayPriority)
+{
+    if (expMethod == m_expMethod && watchedFirst == m_watchedFirst &&
+        dayPriority == m_dayPriority)
+    {
+        return false;
+    }
+
+    m_expMethod    = expMethod;
+    m_watchedFirst = watchedFirst;
+    m_dayPriority  = dayPriority;
+
+    m_queues.clear();
+    QHash<uint, Candidate*>::iterator it = m_entries.begin();
+    for (; it != m_entries.end(); ++it)
+    {
+        SetKeys(*it);
+        m_queues[(*it)->dir].insert(*it);
+    }
+
+    return true;
+}
+
+/// The candidates whose directory is still to be found
+vector<uint> ExpireCandidates::Unresolved(void) const
+{
+    vector<uint> ids;
+
+    QMap<QString, Queue>::const_iterator it = m_queues.find(QString());
+    if (it == m_queues.end())
+        return ids;
+
+    QDateTime now = MythDate::current();
+    Queue::const_iterator qit = (*it).begin();
+    for (; qit != (*it).end(); ++qit)
+    {
+        if (!(*qit)->retry.isValid() || (*qit)->retry <= now)
+            ids.push_back((*qit)->recordedid);
+    }
+
+    return ids;
+}
+
+/** \brief Sets the "host:directory" the candidate's file is in.
+ *
+ *  An empty dir means it was not found, it is looked for again after
+ *  kRetryTime.
+ */
+void ExpireCandidates::SetDir(uint recordedid, const QString &dir)
+{
+    Candidate *c = m_entries.value(recordedid, NULL);
+    if (!c)
+        return;
+
+    Take(c);
+    c->dir = dir;
+    c->retry = dir.isEmpty() ?
+        MythDate::current().addSecs(kRetryTime) : QDateTime();
+    Insert(c);
+}
+
+/// Drops a candidate which has been expired
+void ExpireCandidates::Remove(uint recordedid)
+{
+    Candidate *c = m_entries.value(recordedid, NULL);
+    if (!c)
+        return;
+
+    Take(c);
+    delete c;
+}
+
+/** \brief The candidates in the given directories, in the order they
+ *         are to be expired.
+ *
+ *  Those not in the Deleted group are left out unless the expire
+ *  method is one AutoExpire::FillExpireList() knows.
+ */
+void ExpireCandidates::GetQueue(const QSet<QString> &dirs,
+                                vector<const Candidate*> &queue) const
+{
+    queue.clear();
+
+    bool expireAll = (m_expMethod == emOldestFirst ||
+                      m_expMethod == emLowestPriorityFirst ||
+                      m_expMethod == emWeightedTimePriority);
+
+    QSet<QString>::const_iterator dit = dirs.begin();
+    for (; dit != dirs.end(); ++dit)
+    {
+        QMap<QString, Queue>::const_iterator it = m_queues.find(*dit);
+        if (it == m_queues.end() || dit->isEmpty())
+            continue;
+
+        size_t middle = queue.size();
+        Queue::const_iterator qit = (*it).begin();
+        for (; qit != (*it).end(); ++qit)
+        {
+            if (!expireAll && (*qit)->group != 0)
+                break;
+            queue.push_back(*qit);
+        }
+        inplace_merge(queue.begin(), queue.begin() + middle, queue.end(),
+                      Before());
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef _EXPIRECANDIDATES_H_
+#define _EXPIRECANDIDATES_H_
+
+#include <stdint.h>
+
+#include <vector>
+#include <set>
+using namespace std;
+
+#include <QDateTime>
+#include <QString>
+#include <QMutex>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+
+#include "recordingchanges.h"
+#include "mythtimer.h"
+
+class MSqlQuery;
+
+/** \class ExpireCandidates
+ *  \brief The recordings AutoExpire may delete, in memory, in the order
+ *         they are to be deleted for each directory they are in.
+ *
+ *  These are the recordings in the Deleted group and those which may
+ *  be auto expired, as AutoExpire::FillExpireList() finds them. They
+ *  are loaded with one query and then kept up to date from the
+ *  RECORDING_LIST_CHANGE and UPDATE_FILE_SIZE events sent when a
+ *  recording starts, finishes, changes or is deleted. Events are only
+ *  noted when they arrive, and applied by ProcessEvents() in the
+ *  expire thread, which is the only one to use the rest.
+ *
+ *  Which directory, and so which filesystem, a recording is in takes
+ *  a look at the file, on a slave backend for some, so it is found
+ *  once per recording and kept. Recordings not found yet are kept in
+ *  a queue of their own, see Unresolved().
+ */
+class ExpireCandidates
+{
+  public:
+    class Candidate
+    {
+      public:
+        Candidate() :
+            recordedid(0), chanid(0), filesize(0), group(0), autoexpire(0),
+            watched(0), key1(0), key2(0), recpriority(0), isWatched(false) {}
+
+        uint       recordedid;
+        uint       chanid;
+        QDateTime  recstartts;
+        QString    hostname;
+        uint64_t   filesize;
+        QString    dir;       ///< "host:directory" or empty if not found
+        // the order, see SetOrder()
+        int        group;     ///< the Deleted group first
+        int        autoexpire;
+        int        watched;
+        int64_t    key1;
+        int64_t    key2;
+        // the rest of the row, to order it again
+        QDateTime  lastmodified;
+        int        recpriority;
+        bool       isWatched;
+        QDateTime  retry;     ///< when to look for its file again
+    };
+
+    ExpireCandidates();
+    ~ExpireCandidates();
+
+    void HandleEvent(const MythEvent &me) { m_changes.HandleEvent(me); }
+    bool ProcessEvents(void);
+    bool Load(void);
+    void Clear(void);
+
+    bool IsLoaded(void) const { return m_loaded; }
+    uint Count(void) const { return m_entries.size(); }
+
+    bool SetOrder(int expMethod, bool watchedFirst, int dayPriority);
+
+    vector<uint> Unresolved(void) const;
+    void SetDir(uint recordedid, const QString &dir);
+    void Remove(uint recordedid);
+
+    void GetQueue(const QSet<QString> &dirs,
+                  vector<const Candidate*> &queue) const;
+
+    /// a full load after this long, in case an event was missed
+    static const int kMaxAge = 6 * 60 * 60 * 1000;
+    /// seconds before looking again for a file which was not found
+    static const int kRetryTime = 60 * 60;
+
+  private:
+    class Before
+    {
+      public:
+        bool operator()(const Candidate *a, const Candidate *b) const;
+    };
+    typedef set<Candidate*, Before> Queue;
+
+    bool Reload(uint recordedid);
+    Candidate *FromQuery(const MSqlQuery &query) const;
+    void Insert(Candidate *c);
+    void Take(Candidate *c);
+    void SetKeys(Candidate *c) const;
+
+    bool                       m_loaded;
+    MythTimer                  m_age;
+    QHash<uint, Candidate*>    m_entries;   ///< by recordedid
+    QMap<QString, Queue>       m_queues;    ///< by dir, "" if not found
+
+    int                        m_expMethod;
+    bool                       m_watchedFirst;
+    int                        m_dayPriority;
+
+    /// events seen since the last ProcessEvents()
+    RecordingChanges           m_changes;
+};
+
+#endif // _EXPIRECANDIDATES_H_
@@ -8,6 +8,14 @@
 #include "mythsocket.h"
 #include "programinfo.h"
 #include "mythlogging.h"
+#include "remotefilestream.h"
+
+void FileTransferStreamer::run(void)
+{
+    RunProlog();
+    m_ft->StreamBlocks();
+    RunEpilog();
+}
 
 FileTransfer::FileTransfer(QString &filename, MythSocket *remote,
                            bool usereadahead, int timeout_ms) :
@@ -15,7 +23,7 @@ FileTransfer::FileTransfer(QString &filename, MythSocket *remote,
     readthreadlive(true), readsLocked(false),
     rbuffer(RingBuffer::Create(filename, false, usereadahead, timeout_ms, true)),
     sock(remote), ateof(false), lock(QMutex::NonRecursive),
-    writemode(false)
+    writemode(false), streamer(NULL), streamFence(0)
 {
     pginfo = new ProgramInfo(filename);
     pginfo->MarkAsInUse(true, kFileTransferInUseID);
@@ -27,7 +35,7 @@ FileTransfer::FileTransfer(QString &filename, MythSocket *remote, bool write) :
     readthreadlive(true), readsLocked(false),
     rbuffer(RingBuffer::Create(filename, write)),
     sock(remote), ateof(false), lock(QMutex::NonRecursive),
-    writemode(write)
+    writemode(write), streamer(NULL), streamFence(0)
 {
     pginfo = new ProgramInfo(filename);
     pginfo->MarkAsInUse(true, kFileTransferInUseID);
@@ -41,6 +49,10 @@ FileTransfer::~FileTransfer()
 {
     Stop();
 
+    // Stop() ends its loop, it may still be writing the last reply
+    delete streamer;
+    streamer = NULL;
+
     if (sock) // FileTransfer becomes responsible for deleting the socket
         sock->DecrRef();
 
@@ -120,7 +132,8 @@ void FileTransfer::Unpause(void)
 
 int FileTransfer::RequestBlock(int size)
 {
-    if (!readthreadlive || !rbuffer)
+    // once streaming the data socket belongs to the streamer
+    if (!readthreadlive || !rbuffer || streamer)
         return -1;
 
     int tot = 0;
@@ -158,6 +171,111 @@ int FileTransfer::RequestBlock(int size)
     return (ret < 0) ? -1 : tot;
 }
 
+/** \brief Switches to answering block requests that the client sends
+ *         on the data socket, see RemoteFileStream.
+ *
+ *  The client keeps several requests in flight, so the link stays busy
+ *  instead of idling for a round trip after every block.
+ */
+bool FileTransfer::StartStream(void)
+{
+    if (writemode || !readthreadlive || !rbuffer)
+        return false;
+
+    QMutexLocker locker(&lock);
+    if (streamer)
+        return true;
+
+    // the requests are for the streamer, not MainServer::readyRead()
+    sock->SetReadyReadCallbackEnabled(false);
+    streamer = new FileTransferStreamer(this);
+    streamer->start();
+
+    LOG(VB_FILE, LOG_INFO, QString("Streaming %1").arg(GetFileName()));
+
+    return true;
+}
+
+void FileTransfer::StreamBlocks(void)
+{
+    const uint hsize = RemoteFileStream::kHeaderSize;
+    char hdr[hsize];
+    uint got = 0;
+
+    while (readthreadlive && sock->IsConnected())
+    {
+        // poll, so Stop() is noticed
+        int ret = RemoteFileStream::ReadFull(sock, hdr + got, hsize - got, 100);
+        if (ret < 0)
+            break;
+        got += ret;
+        if (got < hsize)
+            continue;
+        got = 0;
+
+        uint32_t seq;
+        int32_t size;
+        RemoteFileStream::GetHeader(hdr, seq, size);
+        size = min(max(size, 0), (int)RemoteFileStream::kMaxBlockSize);
+
+        if (!StreamBlock(seq, size))
+            break;
+    }
+
+    LOG(VB_FILE, LOG_INFO, QString("Done streaming %1").arg(GetFileName()));
+}
+
+/** \brief Answers one request, with a header then the data.
+ *
+ *  A request sent before the client's last seek is answered without
+ *  reading anything, reading would move the file past the new position.
+ */
+bool FileTransfer::StreamBlock(uint32_t seq, int size)
+{
+    const uint hsize = RemoteFileStream::kHeaderSize;
+    int tot = 0;
+    int ret = 0;
+
+    QMutexLocker locker(&lock);
+    while (readsLocked && readthreadlive)
+        readsUnlockedCond.wait(&lock, 100 /*ms*/);
+
+    if (!readthreadlive)
+        return false;
+
+    requestBuffer.resize(max((size_t)size + hsize, requestBuffer.size()));
+    char *buf = &requestBuffer[hsize];
+
+    // signed difference, so this still works once seq wraps
+    bool stale = (int32_t)(seq - streamFence) < 0;
+    while (!stale && tot < size && !rbuffer->GetStopReads())
+    {
+        int request = size - tot;
+
+        ret = rbuffer->Read(buf + tot, request);
+
+        if (rbuffer->GetStopReads() || ret <= 0)
+            break;
+
+        tot += ret;
+        if (ret < request)
+            break; // we hit eof
+    }
+
+    if (ret < 0)
+        tot = -1;
+
+    RemoteFileStream::PutHeader(&requestBuffer[0], seq, tot);
+    int len = hsize + max(tot, 0);
+    if (sock->Write(&requestBuffer[0], len) != len)
+        return false;
+
+    if (pginfo)
+        pginfo->UpdateInUseMark();
+
+    return true;
+}
+
 int FileTransfer::WriteBlock(int size)
 {
     if (!writemode || !rbuffer)
@@ -221,7 +339,13 @@ int FileTransfer::WriteBlock(int size)
     return (ret < 0) ? -1 : tot;
 }
 
-long long FileTransfer::Seek(long long curpos, long long pos, int whence)
+/** \brief Seeks the file.
+ *
+ *  \param fence for a streaming client, the first request sent after
+ *         this seek, or -1
+ */
+long long FileTransfer::Seek(long long curpos, long long pos, int whence,
+                             long long fence)
 {
     if (pginfo)
         pginfo->UpdateInUseMark();
@@ -235,6 +359,12 @@ long long FileTransfer::Seek(long long curpos, long long pos, int whence)
 
     Pause();
 
+    if (fence >= 0)
+    {
+        QMutexLocker locker(&lock);
+        streamFence = (uint32_t) fence;
+    }
+
     if (whence == SEEK_CUR)
     {
         long long desired = curpos + pos;
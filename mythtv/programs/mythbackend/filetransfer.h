@@ -14,15 +14,30 @@ using namespace std;
 
 // MythTV headers
 #include "referencecounter.h"
+#include "mthread.h"
 
 class ProgramInfo;
 class RingBuffer;
 class MythSocket;
 class QString;
+class FileTransfer;
+
+/// Answers the block requests of a streaming client, see StartStream()
+class FileTransferStreamer : public MThread
+{
+  public:
+    FileTransferStreamer(FileTransfer *ft) :
+        MThread("FileTransferStreamer"), m_ft(ft) {}
+    virtual ~FileTransferStreamer() { wait(); }
+    virtual void run(void);
+  private:
+    FileTransfer *m_ft;
+};
 
 class FileTransfer : public ReferenceCounter
 {
     friend class QObject; // quiet OSX gcc warning
+    friend class FileTransferStreamer;
 
   public:
     FileTransfer(QString &filename, MythSocket *remote,
@@ -40,8 +55,10 @@ class FileTransfer : public ReferenceCounter
     void Unpause(void);
     int RequestBlock(int size);
     int WriteBlock(int size);
+    bool StartStream(void);
 
-    long long Seek(long long curpos, long long pos, int whence);
+    long long Seek(long long curpos, long long pos, int whence,
+                   long long fence = -1);
 
     uint64_t GetFileSize(void);
     QString GetFileName(void);
@@ -51,6 +68,9 @@ class FileTransfer : public ReferenceCounter
   private:
    ~FileTransfer();
 
+    void StreamBlocks(void);
+    bool StreamBlock(uint32_t seq, int size);
+
     volatile bool  readthreadlive;
     bool           readsLocked;
     QWaitCondition readsUnlockedCond;
@@ -65,6 +85,9 @@ class FileTransfer : public ReferenceCounter
     QMutex lock;
 
     bool writemode;
+
+    FileTransferStreamer *streamer;
+    uint32_t              streamFence; ///< requests below this are stale
 };
 
 #endif
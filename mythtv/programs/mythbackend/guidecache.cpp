@@ -0,0 +1,430 @@
+// Qt headers
+#include <QStringList>
+#include <QMap>
+
+// MythTV headers
+#include "guidecache.h"
+#include "httprequest.h"
+#include "mythcorecontext.h"
+#include "mythcoreutil.h"
+#include "mythdbcon.h"
+#include "mythdb.h"
+#include "mythlogging.h"
+#include "mythevent.h"
+#include "mythdate.h"
+
+#define LOC QString("GuideCache: ")
+
+const int GuideCache::kMaxAge;
+const int GuideCache::kMaxBytes;
+const int GuideCache::kMaxEntries;
+
+GuideCache::GuideCache() :
+    m_bytes(0), m_useCount(0), m_generation(0)
+{
+    gCoreContext->addListener(this);
+}
+
+GuideCache::~GuideCache()
+{
+    gCoreContext->removeListener(this);
+
+    QMutexLocker locker(&m_lock);
+    Clear();
+}
+
+/// Only plain GET requests for the guide grid are kept, not SOAP ones
+bool GuideCache::IsCacheable(const HTTPRequest *pRequest)
+{
+    if (pRequest->m_bSOAPRequest)
+        return false;
+
+    if (pRequest->m_eType != RequestTypeGet &&
+        pRequest->m_eType != RequestTypeHead)
+        return false;
+
+    return (pRequest->m_sMethod == "GetProgramGuide" ||
+            pRequest->m_sMethod == "ProgramGuide");
+}
+
+/** \brief Builds the key of a request from the parameters
+ *         Guide::GetProgramGuide() takes and the format asked for.
+ *
+ *  Parameter names are matched without regard to case by the service,
+ *  anything else, such as a cache busting "_=" from a web page, is
+ *  left out.
+ */
+QString GuideCache::MakeKey(const HTTPRequest *pRequest)
+{
+    static const char *kParams[] =
+    {
+        "starttime", "endtime", "details", "channelgroupid",
+        "startindex", "count",
+    };
+
+    QMap<QString, QString> params;
+    QStringMap::const_iterator it = pRequest->m_mapParams.begin();
+    for (; it != pRequest->m_mapParams.end(); ++it)
+        params[it.key().toLower()] = *it;
+
+    QString key = pRequest->m_mapHeaders.value("accept", "*/*");
+    for (uint i = 0; i < sizeof(kParams) / sizeof(kParams[0]); ++i)
+        key += QString("\n") + params.value(kParams[i]);
+
+    return key;
+}
+
+/** \brief Fills in the response to a request from the cache.
+ *
+ *  \return true if the request has been answered, otherwise the
+ *          response is kept whole rather than streamed so Store()
+ *          can have it.
+ */
+bool GuideCache::Lookup(HTTPRequest *pRequest)
+{
+    if (!IsCacheable(pRequest))
+        return false;
+
+    QString key = MakeKey(pRequest);
+
+    QMutexLocker locker(&m_lock);
+
+    m_stats.requests++;
+
+    Entry *entry = m_entries.value(key, NULL);
+    if (entry && entry->age.elapsed() > kMaxAge)
+    {
+        Remove(key);
+        m_stats.evictions++;
+        entry = NULL;
+    }
+
+    if (!entry)
+    {
+        m_pending[pRequest] = m_generation;
+        pRequest->m_bAllowChunked = false;
+        return false;
+    }
+
+    m_stats.hits++;
+    entry->lastUsed = ++m_useCount;
+
+    pRequest->m_eResponseType     = ResponseTypeOther;
+    pRequest->m_sResponseTypeText = entry->contentType;
+    pRequest->m_nResponseStatus   = 200;
+    pRequest->m_mapRespHeaders[ "ETag"          ] = entry->etag;
+    pRequest->m_mapRespHeaders[ "Cache-Control" ] = entry->cacheControl;
+
+    // SendResponse() answers with a 304 itself
+    if (pRequest->GetRequestHeader("If-None-Match", "") == entry->etag)
+    {
+        m_stats.not_modified++;
+        return true;
+    }
+
+    QByteArray body     = entry->body;
+    QByteArray gzipBody = entry->gzipBody;
+
+    if (pRequest->m_mapHeaders[ "accept-encoding" ].contains( "gzip" ))
+    {
+        if (gzipBody.isEmpty())
+        {
+            // Other requests are not held up while this is compressed,
+            // the entry may be gone or replaced once the lock is back.
+            locker.unlock();
+            gzipBody = gzipCompress(body);
+            locker.relock();
+
+            entry = m_entries.value(key, NULL);
+            if (entry && entry->gzipBody.isEmpty() &&
+                entry->body.constData() == body.constData())
+            {
+                entry->gzipBody = gzipBody;
+                entry->size    += gzipBody.size();
+                m_bytes        += gzipBody.size();
+                Evict();
+            }
+        }
+
+        if (!gzipBody.isEmpty())
+        {
+            pRequest->m_response.buffer() = gzipBody;
+            pRequest->SetResponseHeader("Content-Encoding", "gzip");
+            return true;
+        }
+    }
+
+    pRequest->m_response.buffer() = body;
+    return true;
+}
+
+/** \brief Keeps the response to a request Lookup() did not find.
+ *
+ *  \param chanids   Channels the guide is for
+ *  \param startTime StartTime of the guide
+ *  \param endTime   EndTime of the guide
+ */
+void GuideCache::Store(HTTPRequest *pRequest, const QSet<uint> &chanids,
+                       const QDateTime &startTime, const QDateTime &endTime)
+{
+    QMutexLocker locker(&m_lock);
+
+    QHash<const HTTPRequest*, uint64_t>::iterator pit =
+        m_pending.find(pRequest);
+    if (pit == m_pending.end())
+        return;
+
+    uint64_t generation = *pit;
+    m_pending.erase(pit);
+
+    if (pRequest->m_nResponseStatus != 200 ||
+        pRequest->m_eResponseType != ResponseTypeOther ||
+        pRequest->m_pChunkedStream != NULL ||
+        pRequest->m_response.buffer().isEmpty() ||
+        pRequest->m_response.buffer().size() > kMaxBytes / 4)
+    {
+        TrimChanges();
+        return;
+    }
+
+    Entry *entry = new Entry();
+    entry->body         = pRequest->m_response.buffer();
+    entry->contentType  = pRequest->m_sResponseTypeText;
+    entry->etag         = pRequest->m_mapRespHeaders.value("ETag");
+    entry->cacheControl = pRequest->m_mapRespHeaders.value("Cache-Control");
+    entry->chanids      = chanids;
+    entry->startTime    = startTime;
+    entry->endTime      = endTime;
+    entry->size         = entry->body.size();
+    entry->lastUsed     = ++m_useCount;
+    entry->age.start();
+
+    // The guide may have been changed while this was being built
+    QList<Change>::const_iterator cit = m_changes.begin();
+    for (; cit != m_changes.end(); ++cit)
+    {
+        if ((*cit).generation > generation && Affects(*cit, entry))
+        {
+            delete entry;
+            TrimChanges();
+            return;
+        }
+    }
+    TrimChanges();
+
+    QString key = MakeKey(pRequest);
+    Remove(key);
+
+    m_entries[key] = entry;
+    m_bytes += entry->size;
+    m_stats.stores++;
+
+    Evict();
+}
+
+/// Drops what Lookup() noted for a request that was not answered
+void GuideCache::Forget(HTTPRequest *pRequest)
+{
+    QMutexLocker locker(&m_lock);
+    if (m_pending.remove(pRequest))
+        TrimChanges();
+}
+
+void GuideCache::Invalidate(void)
+{
+    QMutexLocker locker(&m_lock);
+    Change change;
+    m_stats.invalidations += Apply(change);
+}
+
+GuideCacheStats GuideCache::GetStats(void) const
+{
+    QMutexLocker locker(&m_lock);
+    GuideCacheStats stats = m_stats;
+    stats.entries = m_entries.size();
+    stats.bytes   = m_bytes;
+    return stats;
+}
+
+void GuideCache::customEvent(QEvent *e)
+{
+    if ((MythEvent::Type)(e->type()) != MythEvent::MythEventMessage)
+        return;
+
+    MythEvent *me = (MythEvent *)e;
+    QStringList tokens = me->Message().simplified().split(" ");
+
+    if (tokens[0] == "SCHEDULE_CHANGE" ||
+        tokens[0] == "CLEAR_SETTINGS_CACHE")
+    {
+        Invalidate();
+    }
+    else if (tokens[0] == "LOCAL_GUIDE_CHANGED" ||
+             tokens[0] == "GUIDE_CHANGED")
+    {
+        if (tokens.size() >= 2 && tokens[1] == "CHANNELS")
+            InvalidateChannels(me->ExtraDataList());
+        else if (tokens.size() >= 3 && tokens[1] == "SOURCE")
+            InvalidateSource(tokens[2].toUInt());
+        else
+            Invalidate();
+    }
+}
+
+/** \brief Drops the entries showing any of the channels and times
+ *         in a "LOCAL_GUIDE_CHANGED CHANNELS" event.
+ *
+ *  \param extra chanid, first start time and last end time of the
+ *               events inserted, for each channel
+ */
+void GuideCache::InvalidateChannels(const QStringList &extra)
+{
+    QMutexLocker locker(&m_lock);
+
+    uint dropped = 0;
+    for (int i = 0; i + 2 < extra.size(); i += 3)
+    {
+        Change change;
+        change.chanids.insert(extra[i].toUInt());
+        change.start = MythDate::fromString(extra[i + 1]);
+        change.end   = MythDate::fromString(extra[i + 2]);
+        if (!change.start.isValid() || !change.end.isValid())
+            change.start = change.end = QDateTime();
+
+        dropped += Apply(change);
+    }
+
+    m_stats.invalidations += dropped;
+
+    if (dropped)
+        LOG(VB_HTTP, LOG_DEBUG, LOC +
+            QString("%1 guides dropped for new EIT events").arg(dropped));
+}
+
+/// Drops the entries showing any channel of a source
+void GuideCache::InvalidateSource(uint sourceid)
+{
+    Change change;
+
+    MSqlQuery query(MSqlQuery::InitCon());
+    query.prepare("SELECT chanid FROM channel WHERE sourceid = :SOURCEID");
+    query.bindValue(":SOURCEID", sourceid);
+    if (!query.exec())
+    {
+        MythDB::DBError("GuideCache::InvalidateSource", query);
+        Invalidate();
+        return;
+    }
+    while (query.next())
+        change.chanids.insert(query.value(0).toUInt());
+
+    if (change.chanids.isEmpty())
+        return;
+
+    QMutexLocker locker(&m_lock);
+
+    uint dropped = Apply(change);
+    m_stats.invalidations += dropped;
+
+    LOG(VB_HTTP, LOG_DEBUG, LOC + QString("%1 guides dropped for source %2")
+        .arg(dropped).arg(sourceid));
+}
+
+/** \brief Whether a change to the guide data may show in an entry.
+ *
+ *  Inserting a program removes those it overlaps, which may reach
+ *  further than it does, so anything inserted for one of the channels
+ *  before the end of the guide counts. A guide also shows programs
+ *  which started up to a day before it does.
+ */
+bool GuideCache::Affects(const Change &change, const Entry *entry)
+{
+    if (change.chanids.isEmpty())
+        return true;
+
+    if (!change.chanids.intersects(entry->chanids))
+        return false;
+
+    if (!change.start.isValid())
+        return true;
+
+    return (change.start < entry->endTime &&
+            change.end >= entry->startTime.addDays(-1));
+}
+
+/// Drops the entries a change affects, and notes it for Store()
+uint GuideCache::Apply(Change &change)
+{
+    QStringList keys;
+    QHash<QString, Entry*>::const_iterator it = m_entries.begin();
+    for (; it != m_entries.end(); ++it)
+    {
+        if (Affects(change, *it))
+            keys << it.key();
+    }
+
+    for (int i = 0; i < keys.size(); ++i)
+        Remove(keys[i]);
+
+    change.generation = ++m_generation;
+    if (!m_pending.isEmpty())
+        m_changes << change;
+
+    return keys.size();
+}
+
+/// Forgets the changes no request being built can have missed
+void GuideCache::TrimChanges(void)
+{
+    if (m_pending.isEmpty())
+    {
+        m_changes.clear();
+        return;
+    }
+
+    uint64_t oldest = m_generation;
+    QHash<const HTTPRequest*, uint64_t>::const_iterator it = m_pending.begin();
+    for (; it != m_pending.end(); ++it)
+        oldest = qMin(oldest, *it);
+
+    while (!m_changes.isEmpty() && m_changes.first().generation <= oldest)
+        m_changes.removeFirst();
+}
+
+void GuideCache::Remove(const QString &key)
+{
+    Entry *entry = m_entries.take(key);
+    if (entry)
+    {
+        m_bytes -= entry->size;
+        delete entry;
+    }
+}
+
+void GuideCache::Clear(void)
+{
+    QHash<QString, Entry*>::iterator it = m_entries.begin();
+    for (; it != m_entries.end(); ++it)
+        delete *it;
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+/// Drops the least recently used entries until there is room
+void GuideCache::Evict(void)
+{
+    while (!m_entries.isEmpty() &&
+           (m_bytes > kMaxBytes || m_entries.size() > kMaxEntries))
+    {
+        QHash<QString, Entry*>::const_iterator it = m_entries.begin();
+        QHash<QString, Entry*>::const_iterator oldest = it;
+        for (; it != m_entries.end(); ++it)
+        {
+            if ((*it)->lastUsed < (*oldest)->lastUsed)
+                oldest = it;
+        }
+
+        Remove(oldest.key());
+        m_stats.evictions++;
+    }
+}
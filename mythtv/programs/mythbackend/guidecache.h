@@ -0,0 +1,137 @@
+#ifndef _GUIDECACHE_H_
+#define _GUIDECACHE_H_
+
+#include <stdint.h>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QObject>
+#include <QString>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QSet>
+
+#include "mythtimer.h"
+
+class HTTPRequest;
+class QEvent;
+
+/// Counters of a GuideCache
+class GuideCacheStats
+{
+  public:
+    GuideCacheStats() :
+        requests(0), hits(0), not_modified(0), stores(0),
+        invalidations(0), evictions(0), entries(0), bytes(0) {}
+
+    uint64_t requests;      ///< GetProgramGuide requests looked up
+    uint64_t hits;          ///< answered from memory
+    uint64_t not_modified;  ///< of those, answered with a 304
+    uint64_t stores;        ///< responses kept
+    uint64_t invalidations; ///< entries dropped by an event
+    uint64_t evictions;     ///< entries dropped for room or age
+    uint64_t entries;
+    uint64_t bytes;
+};
+
+/** \class GuideCache
+ *  \brief Keeps serialized Guide/GetProgramGuide responses in memory.
+ *
+ *  A response is kept by its time range, channel group, paging,
+ *  detail flag and the format the client asked for, with its ETag,
+ *  so a repeat request is answered without going to the database
+ *  and a client which already has it gets a 304.
+ *
+ *  Entries are dropped when the guide data under them changes:
+ *  "LOCAL_GUIDE_CHANGED CHANNELS" from the EIT scanner lists the
+ *  channels and times it inserted events for, it is only seen by this
+ *  backend and not passed on to clients. "GUIDE_CHANGED SOURCE <id>" is
+ *  sent by mythfilldatabase for each source it has filled, and a
+ *  plain "GUIDE_CHANGED" drops everything. The guide also shows the
+ *  recording status of each program, so a SCHEDULE_CHANGE drops
+ *  everything as well.
+ */
+class GuideCache : public QObject
+{
+  public:
+    GuideCache();
+    ~GuideCache();
+
+    bool Lookup(HTTPRequest *pRequest);
+    void Store(HTTPRequest *pRequest, const QSet<uint> &chanids,
+               const QDateTime &startTime, const QDateTime &endTime);
+    void Forget(HTTPRequest *pRequest);
+    void Invalidate(void);
+
+    GuideCacheStats GetStats(void) const;
+
+    static bool IsCacheable(const HTTPRequest *pRequest);
+
+    /// an entry is built again after this long, in case an event was
+    /// missed, such as one from the EIT scanner of a slave backend
+    static const int kMaxAge = 30 * 60 * 1000;
+    /// memory kept for all the entries together
+    static const int kMaxBytes = 64 * 1024 * 1024;
+    static const int kMaxEntries = 256;
+
+  protected:
+    void customEvent(QEvent *e);
+
+  private:
+    class Entry
+    {
+      public:
+        Entry() : size(0), lastUsed(0) {}
+
+        QByteArray  body;
+        QByteArray  gzipBody;    ///< compressed, outside the lock, the first time it is asked for
+        QString     contentType;
+        QString     etag;
+        QString     cacheControl;
+        QSet<uint>  chanids;
+        QDateTime   startTime;
+        QDateTime   endTime;
+        int         size;
+        MythTimer   age;
+        uint64_t    lastUsed;
+    };
+
+    /// A change to the guide data, on all channels if chanids is
+    /// empty and at any time if start is not valid
+    class Change
+    {
+      public:
+        Change() : generation(0) {}
+
+        uint64_t    generation;
+        QSet<uint>  chanids;
+        QDateTime   start;
+        QDateTime   end;
+    };
+
+    static QString MakeKey(const HTTPRequest *pRequest);
+    static bool Affects(const Change &change, const Entry *entry);
+
+    void InvalidateChannels(const QStringList &extra);
+    void InvalidateSource(uint sourceid);
+    uint Apply(Change &change);
+    void TrimChanges(void);
+    void Remove(const QString &key);
+    void Clear(void);
+    void Evict(void);
+
+    mutable QMutex          m_lock;
+    QHash<QString, Entry*>  m_entries;
+    qint64                  m_bytes;
+    uint64_t                m_useCount;  ///< orders entries for eviction
+    uint64_t                m_generation; ///< bumped for every change
+    /// generation when each request not found was looked up
+    QHash<const HTTPRequest*, uint64_t> m_pending;
+    /// changes since the oldest of those, a response built while one
+    /// of these happened is not kept if it is affected
+    QList<Change>           m_changes;
+    GuideCacheStats         m_stats;
+};
+
+#endif // _GUIDECACHE_H_
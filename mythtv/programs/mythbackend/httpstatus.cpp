@@ -40,6 +40,7 @@
 #include "jobqueue.h"
 #include "upnp.h"
 #include "mythdate.h"
+#include "threadedfilewriterpool.h"
 
 /////////////////////////////////////////////////////////////////////////////
 //
@@ -77,6 +78,7 @@ HttpStatusMethod HttpStatus::GetMethod( const QString &sURI )
     if (sURI == "GetStatusHTML"        ) return( HSM_GetStatusHTML   );
     if (sURI == "GetStatus"            ) return( HSM_GetStatusXML    );
     if (sURI == "xml"                  ) return( HSM_GetStatusXML    );
+    if (sURI == "GetProtocolStats"     ) return( HSM_GetProtocolXML  );
 
     return( HSM_Unknown );
 }
@@ -110,6 +112,7 @@ bool HttpStatus::ProcessRequest( HTTPRequest *pRequest )
             {
                 case HSM_GetStatusXML   : GetStatusXML   ( pRequest ); return true;
                 case HSM_GetStatusHTML  : GetStatusHTML  ( pRequest ); return true;
+                case HSM_GetProtocolXML : GetProtocolXML ( pRequest ); return true;
 
                 default:
                 {
@@ -171,6 +174,33 @@ void HttpStatus::GetStatusHTML( HTTPRequest *pRequest )
     PrintStatus( stream, &doc );
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+/////////////////////////////////////////////////////////////////////////////
+
+void HttpStatus::GetProtocolXML( HTTPRequest *pRequest )
+{
+    QDomDocument doc( "Status" );
+
+    QDomProcessingInstruction encoding =
+        doc.createProcessingInstruction("xml",
+                                        "version=\"1.0\" encoding=\"UTF-8\"");
+    doc.appendChild(encoding);
+
+    QDomElement root = doc.createElement("Status");
+    doc.appendChild(root);
+    root.setAttribute("ISODate", MythDate::current().toString(Qt::ISODate));
+
+    FillProtocolXML( &doc, root );
+
+    pRequest->m_eResponseType   = ResponseTypeXML;
+    pRequest->m_mapRespHeaders[ "Cache-Control" ] = "no-cache=\"Ext\", max-age = 0";
+
+    QTextStream stream( &pRequest->m_response );
+    stream.setCodec("UTF-8");
+    stream << doc.toString();
+}
+
 static QString setting_to_localtime(const char *setting)
 {
     QString origDateString = gCoreContext->GetSetting(setting);
@@ -429,11 +459,13 @@ void HttpStatus::FillStatusXML( QDomDocument *pDoc )
     QDomElement storage = pDoc->createElement("Storage"    );
     QDomElement load    = pDoc->createElement("Load"       );
     QDomElement guide   = pDoc->createElement("Guide"      );
+    QDomElement wbufs   = pDoc->createElement("WriteBuffers");
 
     root.appendChild (mInfo  );
     mInfo.appendChild(storage);
     mInfo.appendChild(load   );
     mInfo.appendChild(guide  );
+    mInfo.appendChild(wbufs  );
 
     // drive space   ---------------------
 
@@ -535,6 +567,19 @@ void HttpStatus::FillStatusXML( QDomDocument *pDoc )
     }
 #endif
 
+    // recording write buffers (KB) ---------------------
+
+    TFWBufferPoolStats pool = TFWBufferPool::GetPool()->GetStats();
+    wbufs.setAttribute("inUse"    , (qulonglong)(pool.in_use     >> 10));
+    wbufs.setAttribute("inUseMax" , (qulonglong)(pool.in_use_max >> 10));
+    wbufs.setAttribute("pooled"   , (qulonglong)(pool.pooled     >> 10));
+    wbufs.setAttribute("pooledMax", (qulonglong)(pool.pooled_max >> 10));
+    wbufs.setAttribute("totalMax" , (qulonglong)(pool.total_max  >> 10));
+    wbufs.setAttribute("cap"      , (qulonglong)(pool.cap        >> 10));
+    wbufs.setAttribute("allocs"   , (qulonglong) pool.allocs);
+    wbufs.setAttribute("reuses"   , (qulonglong) pool.reuses);
+    wbufs.setAttribute("frees"    , (qulonglong) pool.frees);
+
     // Guide Data ---------------------
 
     QDateTime GuideDataThrough;
@@ -570,6 +615,10 @@ void HttpStatus::FillStatusXML( QDomDocument *pDoc )
         pDoc->createTextNode(gCoreContext->GetSetting("DataDirectMessage"));
     guide.appendChild(dataDirectMessage);
 
+    // Add the protocol request counters
+
+    FillProtocolXML( pDoc, root );
+
     // Add Miscellaneous information
 
     QString info_script = gCoreContext->GetSetting("MiscStatusScript");
@@ -629,6 +678,68 @@ void HttpStatus::FillStatusXML( QDomDocument *pDoc )
 //
 /////////////////////////////////////////////////////////////////////////////
 
+/** \brief Adds a Protocol element with the counters of the requests the
+ *         backend has handled from frontends and other backends.
+ *
+ *  Times are in microseconds.
+ */
+void HttpStatus::FillProtocolXML( QDomDocument *pDoc, QDomElement &root )
+{
+    if (!m_pMainServer)
+        return;
+
+    ProtocolStats::Snapshot stats = m_pMainServer->GetProtocolStats();
+    if (!stats.enabled)
+        return;
+
+    QDomElement protocol = pDoc->createElement("Protocol");
+    root.appendChild(protocol);
+
+    protocol.setAttribute("since"      , stats.since.toString(Qt::ISODate));
+    protocol.setAttribute("requests"   , (qulonglong) stats.requests);
+    protocol.setAttribute("inFlight"   , stats.in_flight);
+    protocol.setAttribute("inFlightMax", stats.in_flight_max);
+    protocol.setAttribute("queued"     , stats.queued);
+    protocol.setAttribute("queuedMax"  , stats.queued_max);
+    protocol.setAttribute("waitP50"    , (qulonglong) stats.wait_p50);
+    protocol.setAttribute("waitP99"    , (qulonglong) stats.wait_p99);
+    protocol.setAttribute("waitMax"    , (qulonglong) stats.wait_max);
+    protocol.setAttribute("threads"    , stats.pool_threads);
+    protocol.setAttribute("active"     , stats.pool_active);
+
+    QList<ProtocolStats::Command>::const_iterator cit = stats.commands.begin();
+    for (; cit != stats.commands.end(); ++cit)
+    {
+        QDomElement command = pDoc->createElement("Command");
+        protocol.appendChild(command);
+
+        command.setAttribute("name" , (*cit).name);
+        command.setAttribute("count", (qulonglong) (*cit).count);
+        command.setAttribute("total", (qulonglong) (*cit).total);
+        command.setAttribute("p50"  , (qulonglong) (*cit).p50);
+        command.setAttribute("p99"  , (qulonglong) (*cit).p99);
+        command.setAttribute("max"  , (qulonglong) (*cit).max);
+    }
+
+    QList<ProtocolStats::Request>::const_iterator rit = stats.slowest.begin();
+    for (; rit != stats.slowest.end(); ++rit)
+    {
+        QDomElement request = pDoc->createElement("Slow");
+        protocol.appendChild(request);
+
+        request.setAttribute("name" , (*rit).name);
+        request.setAttribute("peer" , (*rit).peer);
+        request.setAttribute("time" , (qulonglong) (*rit).usecs);
+        request.setAttribute("wait" , (qulonglong) (*rit).wait);
+        request.setAttribute("finished",
+                             (*rit).finished.toString(Qt::ISODate));
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+/////////////////////////////////////////////////////////////////////////////
+
 void HttpStatus::PrintStatus( QTextStream &os, QDomDocument *pDoc )
 {
     os.setCodec("UTF-8");
@@ -697,6 +808,13 @@ void HttpStatus::PrintStatus( QTextStream &os, QDomDocument *pDoc )
     if (!node.isNull())
         PrintMachineInfo( os, node.toElement());
 
+    // Backend protocol ----------------------
+
+    node = docElem.namedItem( "Protocol" );
+
+    if (!node.isNull())
+        PrintProtocol( os, node.toElement());
+
     // Miscellaneous information ---------------
 
     node = docElem.namedItem( "Miscellaneous" );
@@ -1240,6 +1358,39 @@ int HttpStatus::PrintMachineInfo( QTextStream &os, QDomElement info )
         }
     }
 
+    // recording write buffers ---------------------
+
+    node = info.namedItem( "WriteBuffers" );
+
+    if (!node.isNull())
+    {
+        QDomElement e = node.toElement();
+
+        if (!e.isNull())
+        {
+            QLocale c(QLocale::C);
+            qulonglong nInUse   = e.attribute( "inUse"    , "0" ).toULongLong();
+            qulonglong nTotMax  = e.attribute( "totalMax" , "0" ).toULongLong();
+            qulonglong nPooled  = e.attribute( "pooled"   , "0" ).toULongLong();
+            qulonglong nCap     = e.attribute( "cap"      , "0" ).toULongLong();
+            qulonglong nAllocs  = e.attribute( "allocs"   , "0" ).toULongLong();
+            qulonglong nReuses  = e.attribute( "reuses"   , "0" ).toULongLong();
+
+            os << "    <div class=\"loadstatus\">\r\n"
+               << "      Recording write buffers:"
+               << "\r\n      <ul>\r\n        <li>"
+               << "In use: " << c.toString(nInUse >> 10) << " MB</li>\r\n"
+               << "        <li>Pooled: " << c.toString(nPooled >> 10)
+               << " MB of " << c.toString(nCap >> 10) << " MB</li>\r\n"
+               << "        <li>Peak: " << c.toString(nTotMax >> 10)
+               << " MB</li>\r\n"
+               << "        <li>Reused: " << c.toString(nReuses) << " of "
+               << c.toString(nAllocs + nReuses) << " buffers"
+               << "</li>\r\n      </ul>\r\n"
+               << "    </div>\r\n";
+        }
+    }
+
     // local drive space   ---------------------
     node = info.namedItem( "Storage" );
     QDomElement storage = node.toElement();
@@ -1454,6 +1605,79 @@ int HttpStatus::PrintMachineInfo( QTextStream &os, QDomElement info )
     return( 1 );
 }
 
+static QString usecs_to_ms(const QString &usecs)
+{
+    return QString::number(usecs.toULongLong() / 1000.0, 'f', 1) + " ms";
+}
+
+int HttpStatus::PrintProtocol( QTextStream &os, QDomElement protocol )
+{
+    if (protocol.isNull())
+        return( 0 );
+
+    QLocale c(QLocale::C);
+    QDateTime since = MythDate::fromString(protocol.attribute("since"));
+
+    os << "  <div class=\"content\">\r\n"
+       << "    <h2 class=\"status\">Backend Protocol</h2>\r\n"
+       << "    " << c.toString(protocol.attribute("requests").toULongLong())
+       << " requests from frontends and other backends since "
+       << MythDate::toString(since, MythDate::kDateTimeFull)
+       << ".\r\n    <ul>\r\n"
+       << "      <li>Being handled: " << protocol.attribute("inFlight")
+       << ", at most " << protocol.attribute("inFlightMax")
+       << ", by a pool of " << protocol.attribute("threads")
+       << " threads, " << protocol.attribute("active") << " busy</li>\r\n"
+       << "      <li>Waiting for a thread: " << protocol.attribute("queued")
+       << ", at most " << protocol.attribute("queuedMax")
+       << ", for " << usecs_to_ms(protocol.attribute("waitP50"))
+       << " (median), " << usecs_to_ms(protocol.attribute("waitP99"))
+       << " (99%), " << usecs_to_ms(protocol.attribute("waitMax"))
+       << " (max)</li>\r\n"
+       << "    </ul>\r\n";
+
+    QDomNodeList nodes = protocol.elementsByTagName("Command");
+    if (nodes.count() > 0)
+    {
+        os << "    Commands taking the most time, median / 99% / max:\r\n"
+           << "    <ul>\r\n";
+        for (int i = 0; i < nodes.count() && i < 15; i++)
+        {
+            QDomElement e = nodes.item(i).toElement();
+            os << "      <li>" << HTTPRequest::Encode(e.attribute("name"))
+               << ": " << c.toString(e.attribute("count").toULongLong())
+               << " requests, " << usecs_to_ms(e.attribute("p50"))
+               << " / " << usecs_to_ms(e.attribute("p99"))
+               << " / " << usecs_to_ms(e.attribute("max")) << "</li>\r\n";
+        }
+        os << "    </ul>\r\n";
+    }
+
+    nodes = protocol.elementsByTagName("Slow");
+    if (nodes.count() > 0)
+    {
+        os << "    Slowest requests of the last "
+           << ProtocolStats::kSlowPeriod / 60 << " minutes:\r\n"
+           << "    <ul>\r\n";
+        for (int i = 0; i < nodes.count(); i++)
+        {
+            QDomElement e = nodes.item(i).toElement();
+            QDateTime finished = MythDate::fromString(e.attribute("finished"));
+            os << "      <li>" << HTTPRequest::Encode(e.attribute("name"))
+               << " from " << HTTPRequest::Encode(e.attribute("peer"))
+               << " at " << MythDate::toString(finished, MythDate::kTime)
+               << ": " << usecs_to_ms(e.attribute("time"))
+               << ", after waiting " << usecs_to_ms(e.attribute("wait"))
+               << "</li>\r\n";
+        }
+        os << "    </ul>\r\n";
+    }
+
+    os << "  </div>\r\n\r\n";
+
+    return( 1 );
+}
+
 int HttpStatus::PrintMiscellaneousInfo( QTextStream &os, QDomElement info )
 {
     if (info.isNull())
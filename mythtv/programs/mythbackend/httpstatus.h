@@ -22,7 +22,8 @@ typedef enum
 {
     HSM_Unknown         =  0,
     HSM_GetStatusHTML   =  1,
-    HSM_GetStatusXML    =  2
+    HSM_GetStatusXML    =  2,
+    HSM_GetProtocolXML  =  3
 
 } HttpStatusMethod;
 
@@ -57,8 +58,10 @@ class HttpStatus : public HttpServerExtension
 
         void    GetStatusXML      ( HTTPRequest *pRequest );
         void    GetStatusHTML     ( HTTPRequest *pRequest );
+        void    GetProtocolXML    ( HTTPRequest *pRequest );
 
         void    FillStatusXML     ( QDomDocument *pDoc);
+        void    FillProtocolXML   ( QDomDocument *pDoc, QDomElement &root );
     
         void    PrintStatus       ( QTextStream &os, QDomDocument *pDoc );
         int     PrintEncoderStatus( QTextStream &os, QDomElement encoders );
@@ -67,6 +70,7 @@ class HttpStatus : public HttpServerExtension
         int     PrintBackends     ( QTextStream &os, QDomElement backends );
         int     PrintJobQueue     ( QTextStream &os, QDomElement jobs );
         int     PrintMachineInfo  ( QTextStream &os, QDomElement info );
+        int     PrintProtocol     ( QTextStream &os, QDomElement protocol );
         int     PrintMiscellaneousInfo ( QTextStream &os, QDomElement info );
 
         void    FillProgramInfo   ( QDomDocument *pDoc,
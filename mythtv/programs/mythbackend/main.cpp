@@ -143,7 +143,8 @@ int main(int argc, char **argv)
         cmdline.toBool("setverbose")    || cmdline.toBool("printsched") ||
         cmdline.toBool("testsched")     || cmdline.toBool("resched") ||
         cmdline.toBool("scanvideos")    || cmdline.toBool("clearcache") ||
-        cmdline.toBool("printexpire")   || cmdline.toBool("setloglevel"))
+        cmdline.toBool("printexpire")   || cmdline.toBool("setloglevel") ||
+        cmdline.toBool("benchsched"))
     {
         gCoreContext->SetAsBackend(false);
         return handle_command(cmdline);
@@ -18,6 +18,8 @@
 // C headers
 #include <cstdlib>
 #include <cerrno>
+#include <algorithm>
+#include <vector>
 
 #include <QCoreApplication>
 #include <QFileInfo>
@@ -37,6 +39,7 @@
 
 #include "mythcontext.h"
 #include "mythversion.h"
+#include "threadedfilewriterpool.h"
 #include "mythdb.h"
 #include "dbutil.h"
 #include "exitcodes.h"
@@ -51,6 +54,7 @@
 #include "main_helpers.h"
 #include "backendcontext.h"
 #include "mythtranslation.h"
+#include "enums/recStatus.h"
 #include "mythtimezone.h"
 #include "signalhandling.h"
 #include "hardwareprofile.h"
@@ -286,6 +290,86 @@ void cleanup(void)
     SignalHandler::Done();
 }
 
+/** \brief Calculates the schedule from the database a number of times,
+ *         for contrib/development/schedbench.
+ *
+ *  Prints the resulting schedule in an order and format which do not
+ *  change from one run to another, so two can be compared with diff,
+ *  then the time each phase of the scheduler took.
+ */
+static int bench_scheduler(int runs, bool useIndex)
+{
+    Scheduler *sched = new Scheduler(false, &tvList);
+    sched->SetUseProgramIndex(useIndex);
+    ProgramInfo::CheckProgramIDAuthorities();
+
+    QMap<QString, vector<int64_t> > times;
+    QStringList phases;
+    for (int i = 0; i < max(runs, 1); ++i)
+    {
+        sched->FillRecordListFromDB();
+
+        const QList<QPair<QString, int64_t> > &phaseTimes =
+            sched->GetPhaseTimes();
+        int64_t total = 0;
+        for (int j = 0; j < phaseTimes.size(); ++j)
+        {
+            if (!times.contains(phaseTimes[j].first))
+                phases << phaseTimes[j].first;
+            times[phaseTimes[j].first].push_back(phaseTimes[j].second);
+            total += phaseTimes[j].second;
+        }
+        if (!times.contains("Total"))
+            phases << "Total";
+        times["Total"].push_back(total);
+    }
+
+    RecList reclist;
+    sched->GetAllPending(reclist);
+
+    QMap<QString, int> counts;
+    RecIter it = reclist.begin();
+    for (; it != reclist.end(); ++it)
+    {
+        RecordingInfo *p = *it;
+        counts[RecStatus::toString(p->GetRecordingStatus(),
+                                   p->GetRecordingRuleType())]++;
+        cout << qPrintable(QString("%1 %2 %3 %4 %5 %6")
+                           .arg(p->GetRecordingStartTime(MythDate::ISODate))
+                           .arg(p->GetChanID(), 5)
+                           .arg(p->GetInputID(), 3)
+                           .arg(RecStatus::toString(p->GetRecordingStatus(),
+                                                    p->GetInputID()))
+                           .arg(p->GetRecordingRuleID(), 5)
+                           .arg(p->GetTitle())) << endl;
+        delete p;
+    }
+
+    cout << endl;
+    QMap<QString, int>::const_iterator cit = counts.begin();
+    for (; cit != counts.end(); ++cit)
+        cout << qPrintable(QString("%1 %2").arg(*cit, 6).arg(cit.key()))
+             << endl;
+
+    cout << endl << qPrintable(QString("%1 %2 runs, %3 ms min/median/max")
+                               .arg("Phase", -17).arg(max(runs, 1))
+                               .arg(useIndex ? "index" : "no index"))
+         << endl;
+    for (int i = 0; i < phases.size(); ++i)
+    {
+        vector<int64_t> &t = times[phases[i]];
+        sort(t.begin(), t.end());
+        cout << qPrintable(QString("%1 %2 %3 %4")
+                           .arg(phases[i], -17)
+                           .arg(t.front() / 1000.0, 9, 'f', 1)
+                           .arg(t[t.size() / 2] / 1000.0, 9, 'f', 1)
+                           .arg(t.back() / 1000.0, 9, 'f', 1)) << endl;
+    }
+
+    delete sched;
+    return GENERIC_EXIT_OK;
+}
+
 int handle_command(const MythBackendCommandLineParser &cmdline)
 {
     QString eventString;
@@ -363,6 +447,10 @@ int handle_command(const MythBackendCommandLineParser &cmdline)
         }
     }
 
+    if (cmdline.toBool("benchsched"))
+        return bench_scheduler(cmdline.toInt("benchsched"),
+                               !cmdline.toBool("nomatchindex"));
+
     if (cmdline.toBool("printsched") ||
         cmdline.toBool("testsched"))
     {
@@ -603,6 +691,10 @@ int run_backend(MythBackendCommandLineParser &cmdline)
 
     print_warnings(cmdline);
 
+    // Recording write buffers are shared by all recorders
+    TFWBufferPool::GetPool()->SetCap(
+        (uint64_t) gCoreContext->GetNumSetting("TFWBufferPoolSize", 64) << 20);
+
     bool fatal_error = false;
     bool runsched = setupTVs(ismaster, fatal_error);
     if (fatal_error)
@@ -623,6 +715,8 @@ int run_backend(MythBackendCommandLineParser &cmdline)
 
             if (cmdline.toBool("nosched"))
                 sched->DisableScheduling();
+            if (cmdline.toBool("nomatchindex"))
+                sched->SetUseProgramIndex(false);
         }
 
         if (!cmdline.toBool("noautoexpire"))
@@ -37,6 +37,7 @@ using namespace std;
 #include <QUrl>
 #include <QTcpServer>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QNetworkInterface>
 #include <QNetworkProxy>
 #include <QHostAddress>
@@ -143,6 +144,7 @@ class ProcessRequestRunnable : public QRunnable
         m_parent(parent), m_sock(sock)
     {
         m_sock->IncrRef();
+        m_queued.start();
     }
 
     virtual ~ProcessRequestRunnable()
@@ -156,7 +158,7 @@ class ProcessRequestRunnable : public QRunnable
 
     virtual void run(void)
     {
-        m_parent.ProcessRequest(m_sock);
+        m_parent.ProcessRequest(m_sock, m_queued.nsecsElapsed() / 1000);
         m_sock->DecrRef();
         m_sock = NULL;
     }
@@ -164,6 +166,7 @@ class ProcessRequestRunnable : public QRunnable
   private:
     MainServer &m_parent;
     MythSocket *m_sock;
+    QElapsedTimer m_queued;
 };
 
 class FreeSpaceUpdater : public QRunnable
@@ -246,7 +249,7 @@ MainServer::MainServer(bool master, int port,
     masterBackendOverride(false),
     m_sched(sched), m_expirer(expirer), deferredDeleteTimer(NULL),
     autoexpireUpdateTimer(NULL), m_exitCode(GENERIC_EXIT_OK),
-    m_stopped(false)
+    m_stopped(false), m_recordingList(this)
 {
     PreviewGeneratorQueue::CreatePreviewGeneratorQueue(
         PreviewGenerator::kLocalAndRemote, ~0, 0);
@@ -254,6 +257,9 @@ MainServer::MainServer(bool master, int port,
 
     threadPool.setMaxThreadCount(PRT_STARTUP_THREAD_COUNT);
 
+    m_protocolStats.SetEnabled(
+        gCoreContext->GetNumSetting("BackendProtocolStats", 1));
+
     masterBackendOverride =
         gCoreContext->GetNumSetting("MasterBackendOverride", 0);
 
@@ -445,6 +451,7 @@ void MainServer::NewConnection(qt_socket_fd_t socketDescriptor)
 
 void MainServer::readyRead(MythSocket *sock)
 {
+    m_protocolStats.Queued();
     threadPool.startReserved(
         new ProcessRequestRunnable(*this, sock),
         "ProcessRequest", PRT_TIMEOUT);
@@ -452,16 +459,33 @@ void MainServer::readyRead(MythSocket *sock)
     QCoreApplication::processEvents();
 }
 
-void MainServer::ProcessRequest(MythSocket *sock)
+/** \brief Handles a request on a socket, from a thread of the pool.
+ *
+ *  \param waitUsecs time the request waited for the thread, for
+ *                   GetProtocolStats()
+ */
+void MainServer::ProcessRequest(MythSocket *sock, int64_t waitUsecs)
 {
+    ProtocolStats::Timer timer(m_protocolStats, waitUsecs);
+
     if (sock->IsDataAvailable())
-        ProcessRequestWork(sock);
+        ProcessRequestWork(sock, timer);
     else
         LOG(VB_GENERAL, LOG_INFO, LOC + QString("No data on sock %1")
             .arg(sock->GetSocketDescriptor()));
 }
 
-void MainServer::ProcessRequestWork(MythSocket *sock)
+/// Counters of the requests handled, with the size of the thread pool
+ProtocolStats::Snapshot MainServer::GetProtocolStats(void) const
+{
+    ProtocolStats::Snapshot snap = m_protocolStats.GetSnapshot();
+    snap.pool_threads = threadPool.maxThreadCount();
+    snap.pool_active  = threadPool.activeThreadCount();
+    return snap;
+}
+
+void MainServer::ProcessRequestWork(MythSocket *sock,
+                                    ProtocolStats::Timer &timer)
 {
     sockListLock.lockForRead();
     PlaybackSock *pbs = GetPlaybackBySock(sock);
@@ -499,6 +523,12 @@ void MainServer::ProcessRequestWork(MythSocket *sock)
     QStringList tokens = line.split(' ', QString::SkipEmptyParts);
     QString command = tokens[0];
 
+    if (m_protocolStats.IsEnabled())
+    {
+        timer.SetCommand(ProtocolStats::CommandName(listline, tokens),
+                         sock->GetPeerAddress().toString());
+    }
+
     if (command == "MYTH_PROTO_VERSION")
     {
         if (tokens.size() < 2)
@@ -1494,6 +1524,12 @@ void MainServer::customEvent(QEvent *e)
             me = &mod_me;
         }
 
+        if (me->Message().startsWith("RECORDING_LIST_CHANGE") ||
+            me->Message().startsWith("UPDATE_FILE_SIZE"))
+        {
+            m_recordingList.HandleEvent(*me);
+        }
+
         if (broadcast.empty())
         {
             broadcast.push_back("BACKEND_MESSAGE");
@@ -1642,8 +1678,15 @@ void MainServer::HandleVersion(MythSocket *socket, const QStringList &slist)
         return;
     }
 
+    // A client that asks for the binary framing gets it once it has
+    // read this reply, which still goes out in the legacy one
+    bool binary = slist.contains(MythSocket::kBinaryFramingToken);
+
     retlist << "ACCEPT" << MYTH_PROTO_VERSION;
+    if (binary)
+        retlist << MythSocket::kBinaryFramingToken;
     socket->WriteStringList(retlist);
+    socket->SetBinaryFraming(binary);
 }
 
 /**
@@ -2086,123 +2129,8 @@ void MainServer::SendResponse(MythSocket *socket, QStringList &commands)
 void MainServer::HandleQueryRecordings(QString type, PlaybackSock *pbs)
 {
     MythSocket *pbssock = pbs->getSocket();
-    QString playbackhost = pbs->getHostname();
-
-    QMap<QString,ProgramInfo*> recMap;
-    if (m_sched)
-        recMap = m_sched->GetRecording();
-
-    QMap<QString,uint32_t> inUseMap = ProgramInfo::QueryInUseMap();
-    QMap<QString,bool> isJobRunning =
-        ProgramInfo::QueryJobsRunning(JOB_COMMFLAG);
-
-    int sort = 0;
-    // Allow "Play" and "Delete" for backwards compatibility with protocol
-    // version 56 and below.
-    if ((type == "Ascending") || (type == "Play"))
-        sort = 1;
-    else if ((type == "Descending") || (type == "Delete"))
-        sort = -1;
-
-    ProgramList destination;
-    LoadFromRecorded(
-        destination, (type == "Recording"),
-        inUseMap, isJobRunning, recMap, sort);
-
-    QMap<QString,ProgramInfo*>::iterator mit = recMap.begin();
-    for (; mit != recMap.end(); mit = recMap.erase(mit))
-        delete *mit;
-
-    QStringList outputlist(QString::number(destination.size()));
-    QMap<QString, QString> backendPortMap;
-    QString ip   = gCoreContext->GetBackendServerIP();
-    int port = gCoreContext->GetBackendServerPort();
-    QString host = gCoreContext->GetHostName();
-
-    ProgramList::iterator it = destination.begin();
-    for (it = destination.begin(); it != destination.end(); ++it)
-    {
-        ProgramInfo *proginfo = *it;
-        PlaybackSock *slave = NULL;
 
-        if (proginfo->GetHostname() != gCoreContext->GetHostName())
-            slave = GetSlaveByHostname(proginfo->GetHostname());
-
-        if ((proginfo->GetHostname() == gCoreContext->GetHostName()) ||
-            (!slave && masterBackendOverride))
-        {
-            proginfo->SetPathname(gCoreContext->GenMythURL(host,port,proginfo->GetBasename()));
-            if (!proginfo->GetFilesize())
-            {
-                QString tmpURL = GetPlaybackURL(proginfo);
-                if (tmpURL.startsWith('/'))
-                {
-                    QFile checkFile(tmpURL);
-                    if (!tmpURL.isEmpty() && checkFile.exists())
-                    {
-                        proginfo->SetFilesize(checkFile.size());
-                        if (proginfo->GetRecordingEndTime() <
-                            MythDate::current())
-                        {
-                            proginfo->SaveFilesize(proginfo->GetFilesize());
-                        }
-                    }
-                }
-            }
-        }
-        else if (!slave)
-        {
-            proginfo->SetPathname(GetPlaybackURL(proginfo));
-            if (proginfo->GetPathname().isEmpty())
-            {
-                LOG(VB_GENERAL, LOG_ERR, LOC +
-                    QString("HandleQueryRecordings() "
-                            "Couldn't find backend for:\n\t\t\t%1")
-                        .arg(proginfo->toString(ProgramInfo::kTitleSubtitle)));
-
-                proginfo->SetFilesize(0);
-                proginfo->SetPathname("file not found");
-            }
-        }
-        else
-        {
-            if (!proginfo->GetFilesize())
-            {
-                if (!slave->FillProgramInfo(*proginfo, playbackhost))
-                {
-                    LOG(VB_GENERAL, LOG_ERR, LOC +
-                        "MainServer::HandleQueryRecordings()"
-                        "\n\t\t\tCould not fill program info "
-                        "from backend");
-                }
-                else
-                {
-                    if (proginfo->GetRecordingEndTime() <
-                        MythDate::current())
-                    {
-                        proginfo->SaveFilesize(proginfo->GetFilesize());
-                    }
-                }
-            }
-            else
-            {
-                ProgramInfo *p      = proginfo;
-                QString hostname    = p->GetHostname();
-
-                if (!backendPortMap.contains(hostname))
-                    backendPortMap[hostname] = gCoreContext->GetBackendServerPort(hostname);
-
-                p->SetPathname(gCoreContext->GenMythURL(hostname,
-                                                        backendPortMap[hostname],
-                                                        p->GetBasename()));
-            }
-        }
-
-        if (slave)
-            slave->DecrRef();
-
-        proginfo->ToStringList(outputlist);
-    }
+    QStringList outputlist = m_recordingList.Get(type, pbs->getHostname());
 
     SendResponse(pbssock, outputlist);
 }
@@ -2418,6 +2346,7 @@ void MainServer::DoDeleteThread(DeleteStruct *ds)
     nameFilters.push_back(fInfo.fileName() + ".old");
     nameFilters.push_back(fInfo.fileName() + ".map");
     nameFilters.push_back(fInfo.fileName() + ".tmp.map");
+    nameFilters.push_back(fInfo.fileName() + ".seek");
     nameFilters.push_back(fInfo.baseName() + ".srt");  // e.g. 1234_20150213165800.srt
 
     QDir dir (fInfo.path());
@@ -6929,10 +6858,19 @@ void MainServer::HandleFileTransferQuery(QStringList &slist,
         long long pos = slist[2].toLongLong();
         int whence = slist[3].toInt();
         long long curpos = slist[4].toLongLong();
+        // a streaming client sends the first request after the seek
+        long long fence = (slist.size() > 5) ? slist[5].toLongLong() : -1;
 
-        long long ret = ft->Seek(curpos, pos, whence);
+        long long ret = ft->Seek(curpos, pos, whence, fence);
         retlist << QString::number(ret);
     }
+    else if (command == "START_STREAM")
+    {
+        if (ft->StartStream())
+            retlist << "OK";
+        else
+            retlist << "ERROR" << "cannot_stream";
+    }
     else if (command == "IS_OPEN")
     {
         bool isopen = ft->isOpen();
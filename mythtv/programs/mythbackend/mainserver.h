@@ -23,6 +23,8 @@ using namespace std;
 #include "mythsocket.h"
 #include "mythdeque.h"
 #include "mythdownloadmanager.h"
+#include "recordinglistcache.h"
+#include "protocolstats.h"
 
 #ifdef DeleteFile
 #undef DeleteFile
@@ -115,6 +117,7 @@ class MainServer : public QObject, public MythSocketCBs
     friend class TruncateThread;
     friend class FreeSpaceUpdater;
     friend class RenameThread;
+    friend class RecordingListCache;
   public:
     MainServer(bool master, int port,
                QMap<int, EncoderLink *> *tvList,
@@ -129,7 +132,8 @@ class MainServer : public QObject, public MythSocketCBs
     bool isClientConnected(bool onlyBlockingClients = false);
     void ShutSlaveBackendsDown(QString &haltcmd);
 
-    void ProcessRequest(MythSocket *sock);
+    void ProcessRequest(MythSocket *sock, int64_t waitUsecs = 0);
+    ProtocolStats::Snapshot GetProtocolStats(void) const;
 
     void readyRead(MythSocket *socket);
     void connectionClosed(MythSocket *socket);
@@ -155,7 +159,7 @@ class MainServer : public QObject, public MythSocketCBs
 
   private:
 
-    void ProcessRequestWork(MythSocket *sock);
+    void ProcessRequestWork(MythSocket *sock, ProtocolStats::Timer &timer);
     void HandleAnnounce(QStringList &slist, QStringList commands,
                         MythSocket *socket);
     void HandleDone(MythSocket *socket);
@@ -357,6 +361,9 @@ class MainServer : public QObject, public MythSocketCBs
 
     bool m_stopped;
 
+    RecordingListCache         m_recordingList;
+    ProtocolStats              m_protocolStats;
+
     static const uint kMasterServerReconnectTimeout;
 };
 
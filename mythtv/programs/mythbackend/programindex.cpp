@@ -0,0 +1,525 @@
+// C++ headers
+#include <algorithm>
+
+// Qt headers
+#include <QDateTime>
+
+// MythTV headers
+#include "programindex.h"
+#include "mythdb.h"
+#include "mythlogging.h"
+#include "mythdate.h"
+
+#define LOC QString("ProgramIndex: ")
+
+const int ProgramIndex::kMaxAge;
+
+/// rows in each REPLACE statement written by SaveMatches()
+static const int kSaveBatch = 500;
+
+/// Returns true if the string is ASCII, which Key() folds exactly
+bool ProgramIndex::IsPlain(const QString &str)
+{
+    for (int i = 0; i < str.size(); i++)
+    {
+        if (str[i].unicode() >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+/** \brief Returns a string the way the guide tables compare it.
+ *
+ *  Only ASCII letters are folded. For an ASCII string two keys are
+ *  equal exactly when utf8_general_ci says the strings are, anything
+ *  else is left to MayCollateEqual().
+ *
+ *  \param trim drop trailing spaces, which '=' ignores but LIKE does not
+ */
+QString ProgramIndex::Key(const QString &str, bool trim)
+{
+    QString key = str;
+    for (int i = 0; i < key.size(); i++)
+    {
+        ushort c = key[i].unicode();
+        if (c >= 'A' && c <= 'Z')
+            key[i] = QChar(c + ('a' - 'A'));
+    }
+
+    if (trim)
+    {
+        int len = key.size();
+        while (len > 0 && key[len - 1] == ' ')
+            len--;
+        key.truncate(len);
+    }
+
+    return key;
+}
+
+/** \brief Returns false if the key of an ASCII string can not compare
+ *         equal to the key of a non-ASCII one, or with \a substring
+ *         can not be found in it.
+ *
+ *  utf8_general_ci weighs each character on its own, so every non-ASCII
+ *  character is taken to stand for any one ASCII character. Trailing
+ *  non-ASCII characters are allowed too, in case one weighs as a space.
+ */
+bool ProgramIndex::MayCollateEqual(const QString &plain,
+                                   const QString &other, bool substring)
+{
+    int last = substring ? other.size() - plain.size() : 0;
+    for (int start = 0; start <= last; start++)
+    {
+        int i = 0;
+        for (; i < plain.size() && start + i < other.size(); i++)
+        {
+            QChar c = other[start + i];
+            if (c.unicode() < 0x80 && c != plain[i])
+                break;
+        }
+        if (i < plain.size())
+            continue;
+        if (substring)
+            return true;
+        for (i += start; i < other.size(); i++)
+        {
+            if (other[i].unicode() < 0x80)
+                break;
+        }
+        if (i == other.size())
+            return true;
+    }
+    return false;
+}
+
+void ProgramIndex::Clear(void)
+{
+    m_channels.clear();
+    m_byTitle.clear();
+    m_bySeries.clear();
+    m_otherTitles.clear();
+    m_otherSeries.clear();
+    m_programCount = 0;
+    m_loaded = false;
+}
+
+void ProgramIndex::RemoveChannel(uint chanid)
+{
+    QHash<uint, Channel>::iterator cit = m_channels.find(chanid);
+    if (cit == m_channels.end())
+        return;
+
+    QSet<QString>::const_iterator it = (*cit).titles.begin();
+    for (; it != (*cit).titles.end(); ++it)
+    {
+        QHash<QString, Postings>::iterator pit = m_byTitle.find(*it);
+        if (pit == m_byTitle.end())
+            continue;
+        (*pit).remove(chanid);
+        if ((*pit).isEmpty())
+        {
+            m_byTitle.erase(pit);
+            m_otherTitles.remove(*it);
+        }
+    }
+
+    for (it = (*cit).series.begin(); it != (*cit).series.end(); ++it)
+    {
+        QHash<QString, Postings>::iterator pit = m_bySeries.find(*it);
+        if (pit == m_bySeries.end())
+            continue;
+        (*pit).remove(chanid);
+        if ((*pit).isEmpty())
+        {
+            m_bySeries.erase(pit);
+            m_otherSeries.remove(*it);
+        }
+    }
+
+    m_programCount -= (*cit).programs.size();
+    m_channels.erase(cit);
+}
+
+/** \brief Loads the programs of a source or multiplex again, or of
+ *         every channel if neither is given.
+ *
+ *  These are what RescheduleMatch() is given when the guide data of
+ *  them has changed.
+ */
+bool ProgramIndex::Load(const MSqlQueryInfo &dbConn, uint sourceid,
+                        uint mplexid)
+{
+    MythTimer timer;
+    timer.start();
+
+    QString where;
+    if (sourceid)
+        where += " AND channel.sourceid = :SOURCEID";
+    if (mplexid)
+        where += " AND channel.mplexid = :MPLEXID";
+
+    MSqlQuery query(dbConn);
+    query.prepare(
+        "SELECT program.chanid, program.starttime, program.endtime, "
+        "       program.title, program.seriesid, program.generic, "
+        "       channel.sourceid, channel.mplexid, channel.callsign "
+        "FROM program INNER JOIN channel "
+        "     ON channel.chanid = program.chanid "
+        "WHERE program.manualid = 0 AND channel.visible = 1 AND "
+        "      program.endtime > (NOW() - INTERVAL 480 MINUTE)" + where +
+        " ORDER BY program.chanid, program.starttime");
+    if (sourceid)
+        query.bindValue(":SOURCEID", sourceid);
+    if (mplexid)
+        query.bindValue(":MPLEXID", mplexid);
+
+    if (!query.exec())
+    {
+        MythDB::DBError("ProgramIndex::Load", query);
+        Clear();
+        return false;
+    }
+
+    if (!sourceid && !mplexid)
+        Clear();
+    else
+    {
+        QList<uint> stale;
+        QHash<uint, Channel>::const_iterator cit = m_channels.begin();
+        for (; cit != m_channels.end(); ++cit)
+        {
+            if ((!sourceid || (*cit).sourceid == sourceid) &&
+                (!mplexid  || (*cit).mplexid  == mplexid))
+                stale << cit.key();
+        }
+        for (int i = 0; i < stale.size(); i++)
+            RemoveChannel(stale[i]);
+    }
+
+    uint loaded = 0;
+    Channel *channel = NULL;
+    uint chanid = 0;
+    while (query.next())
+    {
+        if (!channel || query.value(0).toUInt() != chanid)
+        {
+            chanid = query.value(0).toUInt();
+            RemoveChannel(chanid);
+            channel = &m_channels[chanid];
+            channel->sourceid = query.value(6).toUInt();
+            channel->mplexid  = query.value(7).toUInt();
+            QString callsign = query.value(8).toString();
+            channel->callsign = Key(callsign);
+            channel->plainCallsign = IsPlain(callsign);
+        }
+
+        Program program;
+        program.starttime =
+            MythDate::as_utc(query.value(1).toDateTime()).toTime_t();
+        program.endtime   =
+            MythDate::as_utc(query.value(2).toDateTime()).toTime_t();
+        program.generic   = query.value(5).toBool();
+
+        int index = channel->programs.size();
+        channel->programs.push_back(program);
+
+        QString title = query.value(3).toString();
+        bool plain = IsPlain(title);
+        title = Key(title);
+        m_byTitle[title][chanid].push_back(index);
+        channel->titles.insert(title);
+        if (!plain)
+            m_otherTitles.insert(title);
+
+        QString seriesid = query.value(4).toString();
+        if (!seriesid.isEmpty())
+        {
+            plain = IsPlain(seriesid);
+            seriesid = Key(seriesid);
+            m_bySeries[seriesid][chanid].push_back(index);
+            channel->series.insert(seriesid);
+            if (!plain)
+                m_otherSeries.insert(seriesid);
+        }
+
+        loaded++;
+    }
+
+    m_programCount += loaded;
+
+    if (!sourceid && !mplexid)
+    {
+        m_loaded = true;
+        m_age.start();
+    }
+
+    LOG(VB_SCHEDULE, LOG_INFO, LOC +
+        QString("Loaded %1 programs (source %2, multiplex %3) in %4 ms, "
+                "%5 programs in %6 titles")
+            .arg(loaded).arg(sourceid).arg(mplexid).arg(timer.elapsed())
+            .arg(m_programCount).arg(m_byTitle.size()));
+
+    return true;
+}
+
+/** \brief Loads the rules which can be matched from the index.
+ *
+ *  \param filterMask filters with a clause, rules using any of them
+ *                    are left out
+ */
+bool ProgramIndex::LoadRules(const MSqlQueryInfo &dbConn,
+                             const QString &recordTable, uint recordid,
+                             uint filterMask, vector<Rule> &rules)
+{
+    MSqlQuery query(dbConn);
+    query.prepare(QString(
+        "SELECT recordid, type, search, title, seriesid, station, "
+        "       startdate, starttime, findid, description, filter "
+        "FROM %1 "
+        "WHERE (recordid = :RECORDID OR :RECORDID2 = 0) AND "
+        "      type NOT IN (:TEMPLATE, :DAILY, :WEEKLY) AND "
+        "      search IN (:NOSEARCH, :TITLESEARCH) AND "
+        "      (filter & :FILTERMASK) = 0").arg(recordTable));
+    query.bindValue(":RECORDID", recordid);
+    query.bindValue(":RECORDID2", recordid);
+    query.bindValue(":TEMPLATE", kTemplateRecord);
+    query.bindValue(":DAILY", kDailyRecord);
+    query.bindValue(":WEEKLY", kWeeklyRecord);
+    query.bindValue(":NOSEARCH", kNoSearch);
+    query.bindValue(":TITLESEARCH", kTitleSearch);
+    query.bindValue(":FILTERMASK", filterMask);
+
+    if (!query.exec())
+    {
+        MythDB::DBError("ProgramIndex::LoadRules", query);
+        return false;
+    }
+
+    while (query.next())
+    {
+        Rule rule;
+        rule.recordid = query.value(0).toUInt();
+        rule.type     = RecordingType(query.value(1).toInt());
+        rule.search   = RecSearchType(query.value(2).toInt());
+        QString title    = query.value(3).toString();
+        QString seriesid = query.value(4).toString();
+        QString station  = query.value(5).toString();
+
+        // How these compare to non-ASCII guide data is left to the
+        // database's collation
+        if (!IsPlain(seriesid) || !IsPlain(station))
+            continue;
+
+        rule.seriesid = Key(seriesid);
+        rule.station  = Key(station);
+        rule.startts  = QDateTime(query.value(6).toDate(),
+                                  query.value(7).toTime(),
+                                  Qt::UTC).toTime_t();
+        rule.findid   = query.value(8).toInt();
+
+        if (rule.search == kTitleSearch)
+        {
+            QString phrase = query.value(9).toString();
+
+            // Anything LIKE would treat as a pattern is left to it, and
+            // so is a trailing space, which the title keys do not have
+            if (phrase.isEmpty() || phrase.contains('%') ||
+                phrase.contains('_') || phrase.contains('\\') ||
+                phrase.endsWith(' ') || !IsPlain(phrase))
+                continue;
+
+            rule.title = Key(phrase, false);
+        }
+        else
+        {
+            if (!IsPlain(title))
+                continue;
+            rule.title = Key(title);
+        }
+
+        rules.push_back(rule);
+    }
+
+    return true;
+}
+
+/// Returns false if a channel's callsign may match the rule's station
+/// in a way only the database can tell
+bool ProgramIndex::AddPostings(const Postings &postings, const Rule &rule,
+                               uint sourceid, uint mplexid,
+                               int64_t minEndTime, int64_t maxStartTime,
+                               QSet<uint64_t> &seen,
+                               vector<Match> &matches) const
+{
+    bool exact = (rule.type == kSingleRecord ||
+                  rule.type == kOverrideRecord ||
+                  rule.type == kDontRecord);
+
+    Postings::const_iterator pit = postings.begin();
+    for (; pit != postings.end(); ++pit)
+    {
+        uint chanid = pit.key();
+        QHash<uint, Channel>::const_iterator cit = m_channels.find(chanid);
+        if (cit == m_channels.end())
+            continue;
+
+        const Channel &channel = *cit;
+        if ((sourceid && channel.sourceid != sourceid) ||
+            (mplexid  && channel.mplexid  != mplexid))
+            continue;
+        if (exact && channel.callsign != rule.station)
+        {
+            if (!channel.plainCallsign &&
+                MayCollateEqual(rule.station, channel.callsign, false))
+                return false;
+            continue;
+        }
+
+        const QVector<int> &indexes = *pit;
+        for (int i = 0; i < indexes.size(); i++)
+        {
+            const Program &program = channel.programs[indexes[i]];
+
+            if (program.endtime <= minEndTime ||
+                (maxStartTime && program.starttime > maxStartTime))
+                continue;
+            if (exact && program.starttime != rule.startts)
+                continue;
+
+            uint64_t key = ((uint64_t)chanid << 32) | (uint)program.starttime;
+            if (seen.contains(key))
+                continue;
+            seen.insert(key);
+
+            int dupin;
+            int findid = 0;
+            switch (rule.type)
+            {
+                case kSingleRecord:
+                case kDontRecord:
+                    dupin = 0;
+                    break;
+                case kOverrideRecord:
+                    dupin = 0;
+                    findid = rule.findid;
+                    break;
+                case kOneRecord:
+                    dupin = -1;
+                    findid = rule.findid;
+                    break;
+                default:
+                    dupin = program.generic ? 0 : -1;
+                    break;
+            }
+
+            matches.push_back(Match(rule.recordid, chanid, program.starttime,
+                                    dupin, findid));
+        }
+    }
+
+    return true;
+}
+
+/** \brief Finds the programs a rule matches, as
+ *         Scheduler::UpdateMatches() would.
+ *
+ *  Returns false, with some of the matches added perhaps, if a non-ASCII
+ *  title, series or callsign may match the rule. Only the collation of
+ *  the database can tell then, so the rule is left to its queries.
+ *
+ *  \param minEndTime   programs ending at or before this are left out
+ *  \param maxStartTime programs starting after this are left out,
+ *                      unless it is 0
+ */
+bool ProgramIndex::Find(const Rule &rule, uint sourceid, uint mplexid,
+                        int64_t minEndTime, int64_t maxStartTime,
+                        vector<Match> &matches) const
+{
+    QSet<uint64_t> seen;
+
+    if (rule.search == kTitleSearch)
+    {
+        QSet<QString>::const_iterator oit = m_otherTitles.begin();
+        for (; oit != m_otherTitles.end(); ++oit)
+        {
+            if (MayCollateEqual(rule.title, *oit, true))
+                return false;
+        }
+
+        QHash<QString, Postings>::const_iterator it = m_byTitle.begin();
+        for (; it != m_byTitle.end(); ++it)
+        {
+            if (it.key().contains(rule.title) &&
+                !AddPostings(*it, rule, sourceid, mplexid, minEndTime,
+                             maxStartTime, seen, matches))
+                return false;
+        }
+        return true;
+    }
+
+    QSet<QString>::const_iterator oit = m_otherTitles.begin();
+    for (; oit != m_otherTitles.end(); ++oit)
+    {
+        if (MayCollateEqual(rule.title, *oit, false))
+            return false;
+    }
+
+    QHash<QString, Postings>::const_iterator it = m_byTitle.find(rule.title);
+    if (it != m_byTitle.end() &&
+        !AddPostings(*it, rule, sourceid, mplexid, minEndTime, maxStartTime,
+                     seen, matches))
+        return false;
+
+    if (rule.seriesid.isEmpty())
+        return true;
+
+    for (oit = m_otherSeries.begin(); oit != m_otherSeries.end(); ++oit)
+    {
+        if (MayCollateEqual(rule.seriesid, *oit, false))
+            return false;
+    }
+
+    it = m_bySeries.find(rule.seriesid);
+    if (it != m_bySeries.end() &&
+        !AddPostings(*it, rule, sourceid, mplexid, minEndTime, maxStartTime,
+                     seen, matches))
+        return false;
+
+    return true;
+}
+
+/// Writes matches to recordmatch, a few hundred rows at a time
+bool ProgramIndex::SaveMatches(const MSqlQueryInfo &dbConn,
+                               const vector<Match> &matches)
+{
+    MSqlQuery query(dbConn);
+
+    for (size_t first = 0; first < matches.size(); first += kSaveBatch)
+    {
+        size_t last = min(matches.size(), first + kSaveBatch);
+
+        QStringList rows;
+        for (size_t i = first; i < last; i++)
+        {
+            const Match &m = matches[i];
+            rows << QString("(%1,%2,'%3',0,%4,%5)")
+                .arg(m.recordid).arg(m.chanid)
+                .arg(QDateTime::fromTime_t(m.starttime).toUTC()
+                     .toString("yyyy-MM-dd hh:mm:ss"))
+                .arg(m.oldrecduplicate).arg(m.findid);
+        }
+
+        query.prepare(
+            "REPLACE INTO recordmatch (recordid, chanid, starttime, "
+            "                          manualid, oldrecduplicate, findid) "
+            "VALUES " + rows.join(","));
+        if (!query.exec())
+        {
+            MythDB::DBError("ProgramIndex::SaveMatches", query);
+            return false;
+        }
+    }
+
+    return true;
+}
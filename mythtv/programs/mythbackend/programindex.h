@@ -0,0 +1,149 @@
+#ifndef _PROGRAMINDEX_H_
+#define _PROGRAMINDEX_H_
+
+#include <stdint.h>
+
+#include <vector>
+using namespace std;
+
+#include <QStringList>
+#include <QVector>
+#include <QString>
+#include <QHash>
+#include <QSet>
+
+#include "mythdbcon.h"
+#include "mythtimer.h"
+#include "recordingtypes.h"
+
+/** \class ProgramIndex
+ *  \brief The guide, in memory, for matching recording rules.
+ *
+ *  Holds the programs of the visible channels which have not ended
+ *  more than 8 hours ago, with lists of them by title and by series,
+ *  so the recordmatch rows of a rule can be found without a join of
+ *  the record and program tables. Only rules which match by title or
+ *  series, or by a plain title search, are matched here. Keyword,
+ *  people, power and manual searches, Daily and Weekly rules, whose
+ *  findid depends on the time zone of the database server, and rules
+ *  using a recording filter are left to the queries in
+ *  Scheduler::UpdateMatches().
+ *
+ *  ASCII strings are compared the way the utf8_general_ci collation of
+ *  the guide tables does, without case or trailing spaces. Rules with a
+ *  non-ASCII title, series or station, and rules which may match a
+ *  non-ASCII title, series or callsign in the guide, are left to the
+ *  queries as well.
+ *
+ *  The index is only used by the scheduler thread.
+ */
+class ProgramIndex
+{
+  public:
+    /// The parts of a recording rule the index matches on
+    class Rule
+    {
+      public:
+        Rule() : recordid(0), type(kNotRecording), search(kNoSearch),
+                 startts(0), findid(0) {}
+
+        uint           recordid;
+        RecordingType  type;
+        RecSearchType  search;
+        QString        title;     ///< Key() of the title or search phrase
+        QString        seriesid;  ///< Key() of the series
+        QString        station;   ///< Key() of the callsign
+        int64_t        startts;   ///< for single, override and don't record
+        int            findid;
+    };
+
+    /// A row for recordmatch
+    class Match
+    {
+      public:
+        Match(uint r, uint c, int64_t s, int d, int f) :
+            recordid(r), chanid(c), starttime(s), oldrecduplicate(d),
+            findid(f) {}
+
+        uint     recordid;
+        uint     chanid;
+        int64_t  starttime;
+        int      oldrecduplicate;
+        int      findid;
+    };
+
+    ProgramIndex() : m_loaded(false), m_programCount(0) {}
+
+    bool Load(const MSqlQueryInfo &dbConn, uint sourceid = 0,
+              uint mplexid = 0);
+    void Clear(void);
+
+    bool IsLoaded(void) const { return m_loaded; }
+    /// milliseconds since the last full load
+    int  Age(void) const { return m_age.elapsed(); }
+    uint ProgramCount(void) const { return m_programCount; }
+
+    static bool LoadRules(const MSqlQueryInfo &dbConn,
+                          const QString &recordTable, uint recordid,
+                          uint filterMask, vector<Rule> &rules);
+
+    bool Find(const Rule &rule, uint sourceid, uint mplexid,
+              int64_t minEndTime, int64_t maxStartTime,
+              vector<Match> &matches) const;
+
+    static bool SaveMatches(const MSqlQueryInfo &dbConn,
+                            const vector<Match> &matches);
+
+    static bool IsPlain(const QString &str);
+    static QString Key(const QString &str, bool trim = true);
+
+    /// a full load after this long, in case a change was not reported
+    static const int kMaxAge = 6 * 60 * 60 * 1000;
+
+  private:
+    class Program
+    {
+      public:
+        Program() : starttime(0), endtime(0), generic(false) {}
+
+        int64_t  starttime;
+        int64_t  endtime;
+        bool     generic;
+    };
+
+    class Channel
+    {
+      public:
+        Channel() : sourceid(0), mplexid(0), plainCallsign(true) {}
+
+        uint              sourceid;
+        uint              mplexid;
+        QString           callsign;  ///< Key() of the callsign
+        bool              plainCallsign;
+        QVector<Program>  programs;
+        QSet<QString>     titles;    ///< keys of m_byTitle it is in
+        QSet<QString>     series;    ///< keys of m_bySeries it is in
+    };
+
+    /// program indexes, by chanid
+    typedef QHash<uint, QVector<int> > Postings;
+
+    static bool MayCollateEqual(const QString &plain, const QString &other,
+                                bool substring);
+    void RemoveChannel(uint chanid);
+    bool AddPostings(const Postings &postings, const Rule &rule,
+                     uint sourceid, uint mplexid, int64_t minEndTime,
+                     int64_t maxStartTime, QSet<uint64_t> &seen,
+                     vector<Match> &matches) const;
+
+    bool                       m_loaded;
+    uint                       m_programCount;
+    MythTimer                  m_age;
+    QHash<uint, Channel>       m_channels;
+    QHash<QString, Postings>   m_byTitle;
+    QHash<QString, Postings>   m_bySeries;
+    QSet<QString>              m_otherTitles; ///< non-ASCII keys of m_byTitle
+    QSet<QString>              m_otherSeries; ///< non-ASCII keys of m_bySeries
+};
+
+#endif // _PROGRAMINDEX_H_
@@ -0,0 +1,298 @@
+// C++ headers
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+// MythTV headers
+#include "protocolstats.h"
+#include "mythdate.h"
+
+const int ProtocolStats::kSlowPeriod;
+const int ProtocolStats::kSlowKept;
+const int ProtocolStats::kMaxCommands;
+
+/** \brief Counts of times, in buckets which are a quarter of a power of
+ *         two wide, from a microsecond to several days.
+ */
+class ProtocolStats::Histogram
+{
+  public:
+    Histogram() { Clear(); }
+
+    void Clear(void)
+    {
+        memset(m_buckets, 0, sizeof(m_buckets));
+        m_count = m_max = 0;
+    }
+
+    void Add(uint64_t usecs)
+    {
+        m_buckets[Bucket(usecs)]++;
+        m_count++;
+        m_max = max(m_max, usecs);
+    }
+
+    uint64_t Count(void) const { return m_count; }
+    uint64_t Max(void)   const { return m_max; }
+
+    /// The upper bound of the bucket the given percentile falls in
+    uint64_t Percentile(uint percent) const
+    {
+        if (!m_count)
+            return 0;
+
+        uint64_t target = (m_count * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (uint i = 0; i < kBuckets; ++i)
+        {
+            seen += m_buckets[i];
+            if (seen >= target)
+                return min(UpperBound(i), m_max);
+        }
+        return m_max;
+    }
+
+  private:
+    static const uint kBuckets = 8 + 37 * 4;
+
+    /// Below 8 a bucket per microsecond, then 4 per power of two
+    static uint Bucket(uint64_t usecs)
+    {
+        if (usecs < 8)
+            return usecs;
+
+        uint bits = 3;
+        while (bits < 63 && (usecs >> (bits + 1)))
+            bits++;
+        uint bucket = 8 + (bits - 3) * 4 + ((usecs >> (bits - 2)) & 3);
+        return min(bucket, kBuckets - 1);
+    }
+
+    static uint64_t UpperBound(uint bucket)
+    {
+        if (bucket < 8)
+            return bucket;
+
+        uint bits = 3 + (bucket - 8) / 4;
+        uint64_t lower = (uint64_t)(4 + (bucket - 8) % 4) << (bits - 2);
+        return lower + (1ULL << (bits - 2)) - 1;
+    }
+
+    uint32_t  m_buckets[kBuckets];
+    uint64_t  m_count;
+    uint64_t  m_max;
+};
+
+class ProtocolStats::Entry
+{
+  public:
+    Entry() : total(0) {}
+
+    Histogram  times;
+    uint64_t   total;
+};
+
+ProtocolStats::ProtocolStats() :
+    m_enabled(true), m_wait(new Histogram()), m_requests(0),
+    m_queued(0), m_queuedMax(0), m_inFlight(0), m_inFlightMax(0)
+{
+    m_since = MythDate::current();
+}
+
+ProtocolStats::~ProtocolStats()
+{
+    Clear();
+    delete m_wait;
+}
+
+/// Only to be changed before the first request
+void ProtocolStats::SetEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+/// A request is waiting for a thread of the pool
+void ProtocolStats::Queued(void)
+{
+    if (!m_enabled)
+        return;
+
+    QMutexLocker locker(&m_lock);
+    m_queued++;
+    m_queuedMax = max(m_queuedMax, m_queued);
+}
+
+/// A thread has started on a request after waiting for waitUsecs
+void ProtocolStats::Started(int64_t waitUsecs)
+{
+    if (!m_enabled)
+        return;
+
+    QMutexLocker locker(&m_lock);
+    m_queued = max(m_queued - 1, 0);
+    m_inFlight++;
+    m_inFlightMax = max(m_inFlightMax, m_inFlight);
+    m_wait->Add(max(waitUsecs, (int64_t)0));
+}
+
+/** \brief A request has been handled.
+ *
+ *  \param name  CommandName() of the request, or empty if there was
+ *               none to be read, which is not counted
+ *  \param peer  who sent it
+ */
+void ProtocolStats::Finished(const QString &name, const QString &peer,
+                             int64_t usecs, int64_t waitUsecs)
+{
+    if (!m_enabled)
+        return;
+
+    QMutexLocker locker(&m_lock);
+    m_inFlight = max(m_inFlight - 1, 0);
+
+    if (name.isEmpty())
+        return;
+
+    usecs = max(usecs, (int64_t)0);
+    m_requests++;
+
+    Entry *entry = m_commands.value(name, NULL);
+    if (!entry)
+    {
+        QString key = (m_commands.size() < kMaxCommands) ? name : "(other)";
+        entry = m_commands.value(key, NULL);
+        if (!entry)
+        {
+            entry = new Entry();
+            m_commands[key] = entry;
+        }
+    }
+    entry->times.Add(usecs);
+    entry->total += usecs;
+
+    // Keep the slowest kSlowKept of the last kSlowPeriod
+    QDateTime now = MythDate::current();
+    QDateTime expired = now.addSecs(-kSlowPeriod);
+    QList<Request>::iterator it = m_slowest.begin();
+    while (it != m_slowest.end())
+    {
+        if ((*it).finished < expired)
+            it = m_slowest.erase(it);
+        else
+            ++it;
+    }
+
+    if (m_slowest.size() >= kSlowKept &&
+        m_slowest.last().usecs >= (uint64_t)usecs)
+        return;
+
+    Request request;
+    request.name     = name;
+    request.peer     = peer;
+    request.finished = now;
+    request.usecs    = usecs;
+    request.wait     = max(waitUsecs, (int64_t)0);
+
+    it = m_slowest.begin();
+    while (it != m_slowest.end() && (*it).usecs >= (uint64_t)usecs)
+        ++it;
+    m_slowest.insert(it, request);
+
+    if (m_slowest.size() > kSlowKept)
+        m_slowest.removeLast();
+}
+
+static bool comp_total(const ProtocolStats::Command &a,
+                       const ProtocolStats::Command &b)
+{
+    if (a.total != b.total)
+        return a.total > b.total;
+    return a.name < b.name;
+}
+
+ProtocolStats::Snapshot ProtocolStats::GetSnapshot(void) const
+{
+    Snapshot snap;
+
+    QMutexLocker locker(&m_lock);
+
+    snap.enabled       = m_enabled;
+    snap.since         = m_since;
+    snap.requests      = m_requests;
+    snap.queued        = m_queued;
+    snap.queued_max    = m_queuedMax;
+    snap.in_flight     = m_inFlight;
+    snap.in_flight_max = m_inFlightMax;
+    snap.wait_p50      = m_wait->Percentile(50);
+    snap.wait_p99      = m_wait->Percentile(99);
+    snap.wait_max      = m_wait->Max();
+
+    QDateTime expired = MythDate::current().addSecs(-kSlowPeriod);
+    QList<Request>::const_iterator rit = m_slowest.begin();
+    for (; rit != m_slowest.end(); ++rit)
+    {
+        if ((*rit).finished >= expired)
+            snap.slowest << *rit;
+    }
+
+    QHash<QString, Entry*>::const_iterator it = m_commands.begin();
+    for (; it != m_commands.end(); ++it)
+    {
+        Command command;
+        command.name  = it.key();
+        command.count = (*it)->times.Count();
+        command.total = (*it)->total;
+        command.p50   = (*it)->times.Percentile(50);
+        command.p99   = (*it)->times.Percentile(99);
+        command.max   = (*it)->times.Max();
+        snap.commands << command;
+    }
+
+    locker.unlock();
+
+    sort(snap.commands.begin(), snap.commands.end(), comp_total);
+
+    return snap;
+}
+
+void ProtocolStats::Clear(void)
+{
+    QHash<QString, Entry*>::iterator it = m_commands.begin();
+    for (; it != m_commands.end(); ++it)
+        delete *it;
+    m_commands.clear();
+}
+
+/** \brief The name a request is counted under.
+ *
+ *  This is the command, with the query for the commands which pass
+ *  one on to a recorder or file transfer, as those are most of the
+ *  requests from a frontend which is playing something.
+ */
+QString ProtocolStats::CommandName(const QStringList &listline,
+                                   const QStringList &tokens)
+{
+    if (tokens.empty())
+        return QString();
+
+    const QString &command = tokens[0];
+    if ((command == "QUERY_RECORDER" || command == "QUERY_REMOTEENCODER" ||
+         command == "QUERY_FILETRANSFER") && listline.size() >= 2)
+    {
+        return command + " " + listline[1].section(' ', 0, 0);
+    }
+
+    return command;
+}
+
+ProtocolStats::Timer::Timer(ProtocolStats &stats, int64_t waitUsecs) :
+    m_stats(stats), m_wait(waitUsecs)
+{
+    m_timer.start();
+    m_stats.Started(m_wait);
+}
+
+ProtocolStats::Timer::~Timer()
+{
+    m_stats.Finished(m_name, m_peer, m_timer.nsecsElapsed() / 1000, m_wait);
+}
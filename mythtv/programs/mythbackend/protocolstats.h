@@ -0,0 +1,144 @@
+#ifndef _PROTOCOLSTATS_H_
+#define _PROTOCOLSTATS_H_
+
+#include <stdint.h>
+
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QDateTime>
+#include <QString>
+#include <QMutex>
+#include <QList>
+#include <QHash>
+
+/** \class ProtocolStats
+ *  \brief Counts and times the requests MainServer handles from the
+ *         sockets of frontends and slave backends.
+ *
+ *  For each command it keeps the number of requests and a histogram
+ *  of how long they took, from which the 50th and 99th percentiles are
+ *  given to within about 20%. It also keeps how many requests are
+ *  waiting for a thread of the pool and how many are being handled,
+ *  how long they waited, and the slowest requests of the last
+ *  kSlowPeriod, so the command a hung frontend was waiting for can be
+ *  found.
+ *
+ *  Everything is kept under one lock, held for about a microsecond
+ *  per request. It can be turned off with the BackendProtocolStats
+ *  setting.
+ */
+class ProtocolStats
+{
+  public:
+    /// The counters of one command, times are in microseconds
+    class Command
+    {
+      public:
+        Command() : count(0), total(0), p50(0), p99(0), max(0) {}
+
+        QString   name;
+        uint64_t  count;
+        uint64_t  total;
+        uint64_t  p50;
+        uint64_t  p99;
+        uint64_t  max;
+    };
+
+    /// One of the slowest recent requests
+    class Request
+    {
+      public:
+        Request() : usecs(0), wait(0) {}
+
+        QString    name;
+        QString    peer;
+        QDateTime  finished;
+        uint64_t   usecs;
+        uint64_t   wait;  ///< for a thread of the pool
+    };
+
+    /// What ProtocolStats knows at one time, for the status page
+    class Snapshot
+    {
+      public:
+        Snapshot() :
+            enabled(false), requests(0), queued(0), queued_max(0),
+            in_flight(0), in_flight_max(0), wait_p50(0), wait_p99(0),
+            wait_max(0), pool_threads(0), pool_active(0) {}
+
+        bool            enabled;
+        QDateTime       since;      ///< when counting started
+        uint64_t        requests;
+        int             queued;     ///< waiting for a thread
+        int             queued_max;
+        int             in_flight;  ///< being handled
+        int             in_flight_max;
+        uint64_t        wait_p50;
+        uint64_t        wait_p99;
+        uint64_t        wait_max;
+        int             pool_threads;  ///< filled in by MainServer
+        int             pool_active;
+        QList<Command>  commands;   ///< by total time, longest first
+        QList<Request>  slowest;    ///< slowest first
+    };
+
+    /// Times a request from when a thread starts on it, see Started()
+    class Timer
+    {
+      public:
+        Timer(ProtocolStats &stats, int64_t waitUsecs);
+        ~Timer();
+
+        void SetCommand(const QString &name, const QString &peer)
+            { m_name = name; m_peer = peer; }
+
+      private:
+        ProtocolStats  &m_stats;
+        QElapsedTimer   m_timer;
+        int64_t         m_wait;
+        QString         m_name;
+        QString         m_peer;
+    };
+
+    ProtocolStats();
+    ~ProtocolStats();
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled(void) const { return m_enabled; }
+
+    void Queued(void);
+    void Started(int64_t waitUsecs);
+    void Finished(const QString &name, const QString &peer,
+                  int64_t usecs, int64_t waitUsecs);
+
+    Snapshot GetSnapshot(void) const;
+
+    static QString CommandName(const QStringList &listline,
+                               const QStringList &tokens);
+
+    /// how long a request is kept among the slowest
+    static const int kSlowPeriod = 15 * 60;
+    static const int kSlowKept = 20;
+    /// different command names counted, any more are counted together
+    static const int kMaxCommands = 200;
+
+  private:
+    class Histogram;
+    class Entry;
+
+    void Clear(void);
+
+    bool                      m_enabled;
+    mutable QMutex            m_lock;
+    QHash<QString, Entry*>    m_commands;
+    Histogram                *m_wait;
+    QList<Request>            m_slowest;
+    QDateTime                 m_since;
+    uint64_t                  m_requests;
+    int                       m_queued;
+    int                       m_queuedMax;
+    int                       m_inFlight;
+    int                       m_inFlightMax;
+};
+
+#endif // _PROTOCOLSTATS_H_
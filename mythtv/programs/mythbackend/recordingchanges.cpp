@@ -0,0 +1,77 @@
+// MythTV headers
+#include "recordingchanges.h"
+#include "programinfo.h"
+#include "mythevent.h"
+
+/** \brief Notes which recording a RECORDING_LIST_CHANGE,
+ *         MASTER_UPDATE_REC_INFO or UPDATE_FILE_SIZE event is about,
+ *         other events are ignored.
+ *
+ *  A change which does not name a recording invalidates everything.
+ *  MASTER_UPDATE_REC_INFO is what a change to the auto-expire flag,
+ *  watched flag or recording group sends, MainServer only turns it
+ *  into a RECORDING_LIST_CHANGE for its clients.
+ */
+void RecordingChanges::HandleEvent(const MythEvent &me)
+{
+    QStringList tokens = me.Message().simplified().split(" ");
+
+    if (tokens[0] == "UPDATE_FILE_SIZE")
+    {
+        if (tokens.size() >= 3)
+        {
+            QMutexLocker locker(&m_lock);
+            m_filesizes[tokens[1].toUInt()] = tokens[2].toULongLong();
+        }
+        return;
+    }
+
+    if (tokens[0] != "RECORDING_LIST_CHANGE" &&
+        tokens[0] != "MASTER_UPDATE_REC_INFO")
+        return;
+
+    uint recordedid = 0;
+    if (tokens[0] == "MASTER_UPDATE_REC_INFO")
+    {
+        if (tokens.size() >= 2)
+            recordedid = tokens[1].toUInt();
+    }
+    else if (tokens.size() >= 3 && (tokens[1] == "ADD" || tokens[1] == "DELETE"))
+    {
+        recordedid = tokens[2].toUInt();
+    }
+    else if (tokens.size() >= 2 && tokens[1] == "UPDATE")
+    {
+        ProgramInfo evinfo(me.ExtraDataList());
+        recordedid = evinfo.GetRecordingID();
+    }
+
+    QMutexLocker locker(&m_lock);
+    if (recordedid)
+        m_stale.insert(recordedid);
+    else
+        m_invalidate = true;
+}
+
+/// Everything is to be loaded again
+void RecordingChanges::Invalidate(void)
+{
+    QMutexLocker locker(&m_lock);
+    m_invalidate = true;
+}
+
+/** \brief Hands over the changes noted so far and starts over.
+ *  \return true if everything is to be loaded again
+ */
+bool RecordingChanges::Take(QSet<uint> &stale,
+                            QMap<uint, uint64_t> &filesizes)
+{
+    QMutexLocker locker(&m_lock);
+    bool invalidate = m_invalidate;
+    stale = m_stale;
+    filesizes = m_filesizes;
+    m_invalidate = false;
+    m_stale.clear();
+    m_filesizes.clear();
+    return invalidate;
+}
@@ -0,0 +1,37 @@
+#ifndef _RECORDINGCHANGES_H_
+#define _RECORDINGCHANGES_H_
+
+#include <stdint.h>
+
+#include <QMutex>
+#include <QMap>
+#include <QSet>
+
+class MythEvent;
+
+/** \class RecordingChanges
+ *  \brief The recordings RECORDING_LIST_CHANGE, MASTER_UPDATE_REC_INFO
+ *         and UPDATE_FILE_SIZE events were about, since a cache last
+ *         took them.
+ *
+ *  HandleEvent() only notes the recordedids and file sizes, under a
+ *  lock of its own, so the thread delivering the events never waits
+ *  for the cache that applies them.
+ */
+class RecordingChanges
+{
+  public:
+    RecordingChanges() : m_invalidate(false) {}
+
+    void HandleEvent(const MythEvent &me);
+    void Invalidate(void);
+    bool Take(QSet<uint> &stale, QMap<uint, uint64_t> &filesizes);
+
+  private:
+    QMutex                 m_lock;
+    bool                   m_invalidate;
+    QSet<uint>             m_stale;
+    QMap<uint, uint64_t>   m_filesizes;
+};
+
+#endif // _RECORDINGCHANGES_H_
@@ -0,0 +1,498 @@
+// C++ headers
+#include <algorithm>
+using namespace std;
+
+// Qt headers
+#include <QFile>
+#include <QHash>
+#include <QPair>
+
+// MythTV headers
+#include "recordinglistcache.h"
+#include "mainserver.h"
+#include "playbacksock.h"
+#include "scheduler.h"
+#include "backendutil.h"
+#include "programinfo.h"
+#include "mythcorecontext.h"
+#include "mythdbcon.h"
+#include "mythdb.h"
+#include "mythlogging.h"
+#include "mythevent.h"
+#include "mythdate.h"
+#include "jobqueue.h"
+
+#define LOC QString("RecordingListCache: ")
+
+const int RecordingListCache::kMaxAge;
+
+static const uint32_t kInUseFlags =
+    FL_INUSERECORDING | FL_INUSEPLAYING | FL_INUSEOTHER;
+
+RecordingListCache::Entry::Entry(ProgramInfo *p) :
+    pginfo(p),
+    key(ProgramInfo::MakeUniqueKey(p->GetChanID(),
+                                   p->GetRecordingStartTime())),
+    dbflags(p->GetProgramFlags() & ~kInUseFlags),
+    flags(0), recstatus(RecStatus::Unknown), route(kRouteNone)
+{
+}
+
+RecordingListCache::Entry::~Entry()
+{
+    delete pginfo;
+}
+
+RecordingListCache::RecordingListCache(MainServer *parent) :
+    m_parent(parent), m_orderDirty(false), m_valid(false), m_generation(0)
+{
+    m_replyGeneration[0] = m_replyGeneration[1] = 0;
+}
+
+RecordingListCache::~RecordingListCache()
+{
+    Clear();
+}
+
+void RecordingListCache::Clear(void)
+{
+    QMap<uint, Entry*>::iterator it = m_entries.begin();
+    for (; it != m_entries.end(); ++it)
+        delete *it;
+    m_entries.clear();
+    m_order.clear();
+    m_orderDirty = false;
+    m_valid = false;
+    m_reply[0].clear();
+    m_reply[1].clear();
+    m_generation++;
+}
+
+RecordingListCacheStats RecordingListCache::GetStats(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
+
+/** \brief Applies the events seen since the last request, and loads
+ *         everything the first time and every kMaxAge.
+ *
+ *  The database is read without m_lock, so a slow query does not hold
+ *  up other requests, and what was read is swapped in under it.
+ *  m_loadLock keeps a load from replacing the result of a newer one.
+ */
+void RecordingListCache::Update(const QMap<QString,bool> &isJobRunning)
+{
+    QMutexLocker load_locker(&m_loadLock);
+
+    QSet<uint> stale;
+    QMap<uint, uint64_t> filesizes;
+    bool invalidate = m_changes.Take(stale, filesizes);
+
+    bool rebuild;
+    {
+        QMutexLocker locker(&m_lock);
+        rebuild = invalidate || !m_valid || m_age.elapsed() > kMaxAge;
+    }
+
+    if (rebuild)
+    {
+        MythTimer timer;
+        timer.start();
+
+        QMap<uint, Entry*> entries;
+        LoadAll(entries, isJobRunning);
+
+        uint64_t msecs = timer.elapsed();
+
+        QMutexLocker locker(&m_lock);
+        Clear();
+        m_entries = entries;
+        m_orderDirty = true;
+        m_valid = true;
+        m_age.start();
+
+        m_stats.rebuilds++;
+        m_stats.rebuild_total += msecs;
+        m_stats.rebuild_last = msecs;
+        m_stats.rebuild_max = max(m_stats.rebuild_max, msecs);
+
+        LOG(VB_GENERAL, LOG_INFO, LOC +
+            QString("Loaded %1 recordings in %2 ms, %3 of %4 requests hit")
+                .arg(m_entries.size()).arg(msecs)
+                .arg(m_stats.hits).arg(m_stats.requests));
+        return;
+    }
+
+    QMap<uint, Entry*> reloaded;
+    QSet<uint>::const_iterator sit = stale.begin();
+    for (; sit != stale.end(); ++sit)
+        reloaded[*sit] = LoadOne(*sit);
+
+    QMutexLocker locker(&m_lock);
+
+    QMap<uint, Entry*>::iterator rit = reloaded.begin();
+    for (; rit != reloaded.end(); ++rit)
+    {
+        QMap<uint, Entry*>::iterator it = m_entries.find(rit.key());
+        if (it != m_entries.end())
+        {
+            delete *it;
+            m_entries.erase(it);
+        }
+        if (*rit)
+            m_entries[rit.key()] = *rit;
+
+        m_stats.reloads++;
+        m_orderDirty = true;
+        m_generation++;
+    }
+
+    QMap<uint, uint64_t>::const_iterator fit = filesizes.begin();
+    for (; fit != filesizes.end(); ++fit)
+    {
+        QMap<uint, Entry*>::iterator it = m_entries.find(fit.key());
+        if (it == m_entries.end() || stale.contains(fit.key()))
+            continue;
+        Entry *e = *it;
+        if (!e->pginfo->GetFilesize() != !*fit)
+            e->route = kRouteNone; // the pathname depends on it too
+        e->pginfo->SetFilesize(*fit);
+        e->strings.clear();
+    }
+}
+
+/// Loads the whole recorded table
+void RecordingListCache::LoadAll(QMap<uint, Entry*> &entries,
+                                 const QMap<QString,bool> &isJobRunning)
+{
+    // No in use or recording maps, those are applied on each request.
+    // The job map lets LoadFromRecorded() clear stale flagging flags.
+    ProgramList list(false);
+    LoadFromRecorded(list, false, QMap<QString,uint32_t>(), isJobRunning,
+                     QMap<QString,ProgramInfo*>(), 0);
+
+    ProgramList::iterator it = list.begin();
+    for (; it != list.end(); ++it)
+    {
+        Entry *e = new Entry(*it);
+        uint recordedid = e->pginfo->GetRecordingID();
+        if (entries.contains(recordedid))
+            delete entries[recordedid];
+        entries[recordedid] = e;
+    }
+}
+
+/// Loads one recording again, returns NULL if it is gone
+RecordingListCache::Entry *RecordingListCache::LoadOne(uint recordedid)
+{
+    // not the ProgramInfo(uint) constructor, a deleted recording is
+    // expected here and not worth a LOG_CRIT
+    MSqlQuery query(MSqlQuery::InitCon());
+    query.prepare("SELECT chanid, starttime FROM recorded "
+                  "WHERE recordedid = :RECORDEDID");
+    query.bindValue(":RECORDEDID", recordedid);
+    if (!query.exec())
+    {
+        MythDB::DBError("RecordingListCache::LoadOne", query);
+        return NULL;
+    }
+    if (!query.next())
+        return NULL;
+
+    ProgramInfo *p = new ProgramInfo(
+        query.value(0).toUInt(),
+        MythDate::as_utc(query.value(1).toDateTime()));
+    if (!p->GetChanID())
+    {
+        delete p;
+        return NULL;
+    }
+
+    return new Entry(p);
+}
+
+bool RecordingListCache::EntryBefore(const Entry *a, const Entry *b)
+{
+    return a->pginfo->GetRecordingStartTime() <
+        b->pginfo->GetRecordingStartTime();
+}
+
+void RecordingListCache::SortEntries(void)
+{
+    m_order.clear();
+    m_order.reserve(m_entries.size());
+    QMap<uint, Entry*>::const_iterator it = m_entries.begin();
+    for (; it != m_entries.end(); ++it)
+        m_order.push_back(*it);
+    stable_sort(m_order.begin(), m_order.end(), EntryBefore);
+    m_orderDirty = false;
+}
+
+/** \brief Sets the pathname the requester should use, and the file
+ *         size if the database does not know it.
+ */
+void RecordingListCache::Resolve(ProgramInfo &pginfo, Route route,
+                                 PlaybackSock *slave,
+                                 const QString &playbackhost)
+{
+    if (route == kRouteLocal)
+    {
+        QString host = gCoreContext->GetHostName();
+        int port = gCoreContext->GetBackendServerPort();
+        pginfo.SetPathname(
+            gCoreContext->GenMythURL(host, port, pginfo.GetBasename()));
+        if (!pginfo.GetFilesize())
+        {
+            QString tmpURL = GetPlaybackURL(&pginfo);
+            if (tmpURL.startsWith('/'))
+            {
+                QFile checkFile(tmpURL);
+                if (!tmpURL.isEmpty() && checkFile.exists())
+                {
+                    pginfo.SetFilesize(checkFile.size());
+                    if (pginfo.GetRecordingEndTime() < MythDate::current())
+                        pginfo.SaveFilesize(pginfo.GetFilesize());
+                }
+            }
+        }
+    }
+    else if (route == kRouteNoSlave)
+    {
+        pginfo.SetPathname(GetPlaybackURL(&pginfo));
+        if (pginfo.GetPathname().isEmpty())
+        {
+            LOG(VB_GENERAL, LOG_ERR, LOC +
+                QString("Couldn't find backend for:\n\t\t\t%1")
+                    .arg(pginfo.toString(ProgramInfo::kTitleSubtitle)));
+
+            pginfo.SetFilesize(0);
+            pginfo.SetPathname("file not found");
+        }
+    }
+    else if (!pginfo.GetFilesize())
+    {
+        if (!slave->FillProgramInfo(pginfo, playbackhost))
+        {
+            LOG(VB_GENERAL, LOG_ERR, LOC +
+                "Could not fill program info from backend");
+        }
+        else if (pginfo.GetRecordingEndTime() < MythDate::current())
+        {
+            pginfo.SaveFilesize(pginfo.GetFilesize());
+        }
+    }
+    else
+    {
+        QString hostname = pginfo.GetHostname();
+        pginfo.SetPathname(gCoreContext->GenMythURL(
+            hostname, gCoreContext->GetBackendServerPort(hostname),
+            pginfo.GetBasename()));
+    }
+}
+
+/// Drops the references GetSlaveByHostname() gave
+void RecordingListCache::ReleaseSlaves(
+    const QMap<QString, PlaybackSock*> &slaves)
+{
+    QMap<QString, PlaybackSock*>::const_iterator sit = slaves.begin();
+    for (; sit != slaves.end(); ++sit)
+    {
+        if (*sit)
+            (*sit)->DecrRef();
+    }
+}
+
+/** \brief Returns the reply to QUERY_RECORDINGS \e type.
+ *
+ *  \param type          "Recording" for the recordings in progress,
+ *                       "Ascending", "Descending" or "Unsorted"
+ *  \param playbackhost  host the list is for
+ */
+QStringList RecordingListCache::Get(const QString &type,
+                                    const QString &playbackhost)
+{
+    QMap<QString,ProgramInfo*> recMap;
+    if (m_parent->m_sched)
+        recMap = m_parent->m_sched->GetRecording();
+
+    QMap<QString,uint32_t> inUseMap = ProgramInfo::QueryInUseMap();
+    QMap<QString,bool> isJobRunning =
+        ProgramInfo::QueryJobsRunning(JOB_COMMFLAG);
+
+    bool inProgressOnly = (type == "Recording");
+    // Allow "Play" and "Delete" for backwards compatibility with protocol
+    // version 56 and below.
+    bool descending = ((type == "Descending") || (type == "Delete"));
+
+    Update(isJobRunning);
+
+    QMutexLocker locker(&m_lock);
+
+    m_stats.requests++;
+
+    if (m_orderDirty)
+    {
+        SortEntries();
+        m_generation++;
+    }
+
+    QDateTime now = MythDate::current();
+    QDateTime rectime = now.addSecs(
+        -gCoreContext->GetNumSetting("RecordOverTime"));
+    QString localhost = gCoreContext->GetHostName();
+    QMap<QString, PlaybackSock*> slaves;
+    QHash<const Entry*, ProgramInfo*> uncached;
+
+    vector<Entry*>::iterator it = m_order.begin();
+    for (; it != m_order.end(); ++it)
+    {
+        Entry *e = *it;
+        ProgramInfo *p = e->pginfo;
+
+        // what LoadFromRecorded() does with the maps
+        uint32_t flags = e->dbflags | inUseMap.value(e->key, 0);
+        if ((flags & FL_COMMPROCESSING) && !isJobRunning.contains(e->key))
+        {
+            flags &= ~FL_COMMPROCESSING;
+            e->dbflags &= ~FL_COMMPROCESSING;
+            p->SaveCommFlagged(COMM_FLAG_NOT_FLAGGED);
+        }
+        flags &= ~FL_EDITING;
+        if ((flags & FL_REALLYEDITING) || (flags & COMM_FLAG_PROCESSING))
+            flags |= FL_EDITING;
+
+        RecStatus::Type recstatus = RecStatus::Recorded;
+        if (p->GetRecordingEndTime() > rectime && recMap.contains(e->key))
+            recstatus = RecStatus::Recording;
+
+        // what HandleQueryRecordings() did to find the file
+        Route route = kRouteLocal;
+        PlaybackSock *slave = NULL;
+        QString hostname = p->GetHostname();
+        if (hostname != localhost)
+        {
+            QMap<QString, PlaybackSock*>::iterator sit = slaves.find(hostname);
+            if (sit == slaves.end())
+            {
+                sit = slaves.insert(hostname,
+                                    m_parent->GetSlaveByHostname(hostname));
+            }
+            slave = *sit;
+            if (slave)
+                route = kRouteSlave;
+            else if (!m_parent->masterBackendOverride)
+                route = kRouteNoSlave;
+        }
+
+        // Without a file size a slave is asked on every request as
+        // before, its answer depends on the host asking so it is not
+        // kept. A local file found later comes with UPDATE_FILE_SIZE.
+        if (route == kRouteSlave && !p->GetFilesize())
+        {
+            e->strings.clear();
+            if (inProgressOnly &&
+                !(p->GetRecordingStartTime() <= now &&
+                  p->GetRecordingEndTime() >= now))
+            {
+                continue;
+            }
+            ProgramInfo *tmp = new ProgramInfo(*p);
+            tmp->SetProgramFlags(flags);
+            tmp->SetRecordingStatus(recstatus);
+            uncached[e] = tmp;
+            continue;
+        }
+
+        if (e->route != route)
+        {
+            Resolve(*p, route, slave, playbackhost);
+            e->route = route;
+            e->strings.clear();
+        }
+
+        if (e->strings.empty() || e->flags != flags ||
+            e->recstatus != recstatus)
+        {
+            p->SetProgramFlags(flags);
+            p->SetRecordingStatus(recstatus);
+            e->flags = flags;
+            e->recstatus = recstatus;
+            e->strings.clear();
+            p->ToStringList(e->strings);
+            m_stats.serialized++;
+            m_generation++;
+        }
+    }
+
+    QMap<QString,ProgramInfo*>::iterator mit = recMap.begin();
+    for (; mit != recMap.end(); mit = recMap.erase(mit))
+        delete *mit;
+
+    // Put the list together, unless the last one is still good
+    uint r = descending ? 1 : 0;
+    if (!inProgressOnly && uncached.empty() &&
+        m_replyGeneration[r] == m_generation && !m_reply[r].empty())
+    {
+        m_stats.hits++;
+        ReleaseSlaves(slaves);
+        return m_reply[r];
+    }
+
+    // The strings are implicitly shared, so this copies no more than
+    // the list itself. Recordings a slave has to be asked about are
+    // left empty until m_lock is released.
+    QList<QStringList> parts;
+    QList<QPair<int, ProgramInfo*> > pending;
+    for (uint i = 0; i < m_order.size(); i++)
+    {
+        const Entry *e = m_order[descending ? m_order.size() - 1 - i : i];
+        if (inProgressOnly &&
+            !(e->pginfo->GetRecordingStartTime() <= now &&
+              e->pginfo->GetRecordingEndTime() >= now))
+        {
+            continue;
+        }
+        if (e->strings.empty())
+            pending.push_back(qMakePair(parts.size(), uncached.value(e)));
+        parts.push_back(e->strings);
+    }
+
+    if (pending.empty())
+    {
+        QStringList outputlist(QString::number(parts.size()));
+        for (int i = 0; i < parts.size(); i++)
+            outputlist += parts[i];
+
+        if (!inProgressOnly)
+        {
+            m_reply[r] = outputlist;
+            m_replyGeneration[r] = m_generation;
+        }
+
+        ReleaseSlaves(slaves);
+        return outputlist;
+    }
+
+    locker.unlock();
+
+    // Slaves are asked without m_lock, they may take a while to answer
+    for (int i = 0; i < pending.size(); i++)
+    {
+        ProgramInfo *tmp = pending[i].second;
+        Resolve(*tmp, kRouteSlave,
+                slaves.value(tmp->GetHostname()), playbackhost);
+        tmp->ToStringList(parts[pending[i].first]);
+    }
+    ReleaseSlaves(slaves);
+
+    QHash<const Entry*, ProgramInfo*>::iterator uit = uncached.begin();
+    for (; uit != uncached.end(); ++uit)
+        delete *uit;
+
+    QStringList outputlist(QString::number(parts.size()));
+    for (int i = 0; i < parts.size(); i++)
+        outputlist += parts[i];
+
+    return outputlist;
+}
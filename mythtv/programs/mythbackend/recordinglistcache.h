@@ -0,0 +1,128 @@
+#ifndef _RECORDINGLISTCACHE_H_
+#define _RECORDINGLISTCACHE_H_
+
+#include <stdint.h>
+
+#include <vector>
+using namespace std;
+
+#include <QStringList>
+#include <QMutex>
+#include <QMap>
+#include <QSet>
+
+#include "recordingchanges.h"
+#include "mythtimer.h"
+#include "programinfo.h"
+
+class PlaybackSock;
+class MainServer;
+class MythEvent;
+
+/// Counters of a RecordingListCache, times are in milliseconds
+class RecordingListCacheStats
+{
+  public:
+    RecordingListCacheStats() :
+        requests(0), hits(0), rebuilds(0), reloads(0), serialized(0),
+        rebuild_total(0), rebuild_last(0), rebuild_max(0) {}
+
+    uint64_t requests;      ///< QUERY_RECORDINGS answered
+    uint64_t hits;          ///< answered with an already assembled list
+    uint64_t rebuilds;      ///< full loads of the recorded table
+    uint64_t reloads;       ///< single recordings loaded again
+    uint64_t serialized;    ///< recordings serialized again
+    uint64_t rebuild_total;
+    uint64_t rebuild_last;
+    uint64_t rebuild_max;
+};
+
+/** \class RecordingListCache
+ *  \brief Keeps the reply to QUERY_RECORDINGS in memory.
+ *
+ *  Each recording is loaded and serialized once and kept until a
+ *  RECORDING_LIST_CHANGE or UPDATE_FILE_SIZE event for it arrives,
+ *  the recordings that changed are then loaded again one by one on
+ *  the next request. A RECORDING_LIST_CHANGE without a recording,
+ *  such as the one sent when a slave goes away, drops everything.
+ *
+ *  What is in use, which commercial flagging jobs are running and
+ *  what the scheduler is recording changes without an event, so
+ *  those are still queried on every request. Only the recordings
+ *  whose flags or status they change are serialized again, and
+ *  when none did the list assembled for the last request is sent
+ *  as it is.
+ *
+ *  The database and slave backends are not asked with m_lock held,
+ *  the recordings loaded and the slaves' answers are put in under it.
+ */
+class RecordingListCache
+{
+  public:
+    explicit RecordingListCache(MainServer *parent);
+    ~RecordingListCache();
+
+    QStringList Get(const QString &type, const QString &playbackhost);
+    void HandleEvent(const MythEvent &me) { m_changes.HandleEvent(me); }
+    /// Drops everything, the next request loads the whole list again
+    void Invalidate(void) { m_changes.Invalidate(); }
+
+    RecordingListCacheStats GetStats(void) const;
+
+    /// a full reload after this long, in case an event was missed
+    static const int kMaxAge = 60 * 60 * 1000;
+
+  private:
+    class Entry
+    {
+      public:
+        explicit Entry(ProgramInfo *p);
+        ~Entry();
+
+        ProgramInfo     *pginfo;
+        QString          key;       ///< ProgramInfo::MakeUniqueKey()
+        uint32_t         dbflags;   ///< flags as loaded, none in use
+        uint32_t         flags;     ///< flags when last serialized
+        RecStatus::Type  recstatus; ///< status when last serialized
+        int              route;     ///< how the pathname was found
+        QStringList      strings;   ///< empty until serialized
+    };
+
+    typedef enum
+    {
+        kRouteNone = 0,
+        kRouteLocal,
+        kRouteNoSlave,
+        kRouteSlave,
+    } Route;
+
+    void Update(const QMap<QString,bool> &isJobRunning);
+    static void LoadAll(QMap<uint, Entry*> &entries,
+                        const QMap<QString,bool> &isJobRunning);
+    static Entry *LoadOne(uint recordedid);
+    void Clear(void);
+    void SortEntries(void);
+    static bool EntryBefore(const Entry *a, const Entry *b);
+    void Resolve(ProgramInfo &pginfo, Route route, PlaybackSock *slave,
+                 const QString &playbackhost);
+    static void ReleaseSlaves(const QMap<QString, PlaybackSock*> &slaves);
+
+    MainServer            *m_parent;
+
+    QMutex                 m_loadLock;  ///< held while loading, see Update()
+    mutable QMutex         m_lock;
+    QMap<uint, Entry*>     m_entries;   ///< by recordedid
+    vector<Entry*>         m_order;     ///< by recording start time
+    bool                   m_orderDirty;
+    bool                   m_valid;
+    MythTimer              m_age;
+    uint64_t               m_generation; ///< bumped when a reply changes
+    QStringList            m_reply[2];   ///< ascending, descending
+    uint64_t               m_replyGeneration[2];
+    RecordingListCacheStats m_stats;
+
+    /// events seen since the last request
+    RecordingChanges       m_changes;
+};
+
+#endif // _RECORDINGLISTCACHE_H_
@@ -72,7 +72,8 @@ Scheduler::Scheduler(bool runthread, QMap<int, EncoderLink *> *tvList,
     error(0),
     livetvTime(QDateTime()),
     lastPrepareTime(QDateTime()),
-    m_openEnd(openEndNever)
+    m_openEnd(openEndNever),
+    m_useProgramIndex(runthread)
 {
     char *debug = getenv("DEBUG_CONFLICTS");
     debugConflicts = (debug != NULL);
@@ -442,31 +443,41 @@ static bool comp_retry(RecordingInfo *a, RecordingInfo *b)
 
 bool Scheduler::FillRecordList(void)
 {
+    QElapsedTimer timer;
+    timer.start();
+
     schedTime = MythDate::current();
 
     LOG(VB_SCHEDULE, LOG_INFO, "BuildWorkList...");
     BuildWorkList();
+    NotePhase("BuildWorkList", timer);
 
     schedLock.unlock();
 
     LOG(VB_SCHEDULE, LOG_INFO, "AddNewRecords...");
     AddNewRecords();
+    NotePhase("AddNewRecords", timer);
     LOG(VB_SCHEDULE, LOG_INFO, "AddNotListed...");
     AddNotListed();
+    NotePhase("AddNotListed", timer);
 
     LOG(VB_SCHEDULE, LOG_INFO, "Sort by time...");
     SORT_RECLIST(worklist, comp_overlap);
     LOG(VB_SCHEDULE, LOG_INFO, "PruneOverlaps...");
     PruneOverlaps();
+    NotePhase("PruneOverlaps", timer);
 
     LOG(VB_SCHEDULE, LOG_INFO, "Sort by priority...");
     SORT_RECLIST(worklist, comp_priority);
     LOG(VB_SCHEDULE, LOG_INFO, "BuildListMaps...");
     BuildListMaps();
+    NotePhase("BuildListMaps", timer);
     LOG(VB_SCHEDULE, LOG_INFO, "SchedNewRecords...");
     SchedNewRecords();
+    NotePhase("SchedNewRecords", timer);
     LOG(VB_SCHEDULE, LOG_INFO, "SchedLiveTV...");
     SchedLiveTV();
+    NotePhase("SchedLiveTV", timer);
     LOG(VB_SCHEDULE, LOG_INFO, "ClearListMaps...");
     ClearListMaps();
 
@@ -476,15 +487,24 @@ bool Scheduler::FillRecordList(void)
     SORT_RECLIST(worklist, comp_redundant);
     LOG(VB_SCHEDULE, LOG_INFO, "PruneRedundants...");
     PruneRedundants();
+    NotePhase("PruneRedundants", timer);
 
     LOG(VB_SCHEDULE, LOG_INFO, "Sort by time...");
     SORT_RECLIST(worklist, comp_recstart);
     LOG(VB_SCHEDULE, LOG_INFO, "ClearWorkList...");
     bool res = ClearWorkList();
+    NotePhase("ClearWorkList", timer);
 
     return res;
 }
 
+/// Notes the time since the last phase, for GetPhaseTimes()
+void Scheduler::NotePhase(const QString &phase, QElapsedTimer &timer)
+{
+    m_phaseTimes << qMakePair(phase, (int64_t)(timer.nsecsElapsed() / 1000));
+    timer.restart();
+}
+
 /** \fn Scheduler::FillRecordListFromDB(int)
  *  \param recordid Record ID of recording that has changed,
  *                  or 0 if anything might have been changed.
@@ -535,8 +555,13 @@ void Scheduler::FillRecordListFromDB(uint recordid)
 
     QMutexLocker locker(&schedLock);
 
+    QElapsedTimer timer;
+    m_phaseTimes.clear();
+
     gettimeofday(&fillstart, NULL);
+    timer.start();
     UpdateMatches(recordid, 0, 0, QDateTime());
+    NotePhase("UpdateMatches", timer);
     gettimeofday(&fillend, NULL);
     matchTime = ((fillend.tv_sec - fillstart.tv_sec ) * 1000000 +
                  (fillend.tv_usec - fillstart.tv_usec)) / 1000000.0;
@@ -546,7 +571,9 @@ void Scheduler::FillRecordListFromDB(uint recordid)
 
     gettimeofday(&fillstart, NULL);
     LOG(VB_SCHEDULE, LOG_INFO, "UpdateDuplicates...");
+    timer.restart();
     UpdateDuplicates();
+    NotePhase("UpdateDuplicates", timer);
     gettimeofday(&fillend, NULL);
     checkTime = ((fillend.tv_sec - fillstart.tv_sec ) * 1000000 +
                  (fillend.tv_usec - fillstart.tv_usec)) / 1000000.0;
@@ -2330,6 +2357,7 @@ bool Scheduler::HandleReschedule(void)
     QString msg;
     bool deleteFuture = false;
     bool runCheck = false;
+    m_phaseTimes.clear();
 
     while (HaveQueuedRequests())
     {
@@ -3773,12 +3801,17 @@ void Scheduler::UpdateManuals(uint recordid)
 
 void Scheduler::BuildNewRecordsQueries(uint recordid, QStringList &from,
                                        QStringList &where,
-                                       MSqlBindings &bindings)
+                                       MSqlBindings &bindings,
+                                       const QSet<uint> &indexed)
 {
     MSqlQuery result(dbConn);
     QString query;
     QString qphrase;
 
+    // Already matched from m_programIndex
+    if (recordid && indexed.contains(recordid))
+        return;
+
     query = QString("SELECT recordid,search,subtitle,description "
                     "FROM %1 WHERE search <> %2 AND "
                     "(recordid = %3 OR %4 = 0) ")
@@ -3795,6 +3828,9 @@ void Scheduler::BuildNewRecordsQueries(uint recordid, QStringList &from,
     int count = 0;
     while (result.next())
     {
+        if (indexed.contains(result.value(0).toUInt()))
+            continue;
+
         QString prefix = QString(":NR%1").arg(count);
         qphrase = result.value(3).toString();
 
@@ -3879,6 +3915,15 @@ void Scheduler::BuildNewRecordsQueries(uint recordid, QStringList &from,
         QString recidmatch = "";
         if (recordid != 0)
             recidmatch = "RECTABLE.recordid = :NRRECORDID AND ";
+        else if (!indexed.isEmpty())
+        {
+            QStringList ids;
+            QSet<uint>::const_iterator it = indexed.begin();
+            for (; it != indexed.end(); ++it)
+                ids << QString::number(*it);
+            recidmatch = QString("RECTABLE.recordid NOT IN (%1) AND ")
+                .arg(ids.join(","));
+        }
         QString s1 = recidmatch +
             "RECTABLE.type <> :NRTEMPLATE AND "
             "RECTABLE.search = :NRST AND "
@@ -3991,10 +4036,12 @@ void Scheduler::UpdateMatches(uint recordid, uint sourceid, uint mplexid,
         MythDB::DBError("UpdateMatches2", query);
         return;
     }
+    uint filterMask = 0;
     while (query.next())
     {
         filterClause += QString(" AND (((RECTABLE.filter & %1) = 0) OR (%2))")
             .arg(1 << query.value(0).toInt()).arg(query.value(1).toString());
+        filterMask |= 1 << query.value(0).toInt();
     }
 
     // Make sure all FindOne rules have a valid findid before scheduling.
@@ -4019,10 +4066,16 @@ void Scheduler::UpdateMatches(uint recordid, uint sourceid, uint mplexid,
             MythDB::DBError("UpdateMatches4", query);
     }
 
+    QSet<uint> indexed;
+    if (m_useProgramIndex)
+        MatchFromIndex(recordid, sourceid, mplexid, maxstarttime, filterMask,
+                       indexed);
+
     int clause;
     QStringList fromclauses, whereclauses;
 
-    BuildNewRecordsQueries(recordid, fromclauses, whereclauses, bindings);
+    BuildNewRecordsQueries(recordid, fromclauses, whereclauses, bindings,
+                           indexed);
 
     if (VERBOSE_LEVEL_CHECK(VB_SCHEDULE, LOG_INFO))
     {
@@ -4104,6 +4157,66 @@ void Scheduler::UpdateMatches(uint recordid, uint sourceid, uint mplexid,
     LOG(VB_SCHEDULE, LOG_INFO, " +-- Done.");
 }
 
+/** \brief Writes the recordmatch rows of the rules m_programIndex can
+ *         match, and returns those rules so the rest of UpdateMatches()
+ *         leaves them alone.
+ *
+ *  The index is loaded again for the source or multiplex a request is
+ *  for, which is how new guide data is reported, and entirely when a
+ *  request is for everything. A request for a single rule only loads
+ *  it if it has not been, or has not been for a while.
+ */
+void Scheduler::MatchFromIndex(uint recordid, uint sourceid, uint mplexid,
+                               const QDateTime &maxstarttime,
+                               uint filterMask, QSet<uint> &indexed)
+{
+    struct timeval dbstart, dbend;
+    gettimeofday(&dbstart, NULL);
+
+    bool ok = true;
+    if (!m_programIndex.IsLoaded() ||
+        m_programIndex.Age() > ProgramIndex::kMaxAge ||
+        (!recordid && !sourceid && !mplexid))
+        ok = m_programIndex.Load(dbConn);
+    else if (!recordid)
+        ok = m_programIndex.Load(dbConn, sourceid, mplexid);
+
+    vector<ProgramIndex::Rule> rules;
+    if (!ok || !ProgramIndex::LoadRules(dbConn, recordTable, recordid,
+                                        filterMask, rules))
+        return;
+
+    int64_t minEndTime = MythDate::current().toTime_t() - 480 * 60;
+    int64_t maxStartTime = maxstarttime.isValid() ?
+        maxstarttime.toTime_t() : 0;
+
+    vector<ProgramIndex::Match> matches;
+    QSet<uint> found;
+    for (size_t i = 0; i < rules.size(); i++)
+    {
+        // Rules the index can not decide are left to the queries
+        size_t count = matches.size();
+        if (m_programIndex.Find(rules[i], sourceid, mplexid, minEndTime,
+                                maxStartTime, matches))
+            found.insert(rules[i].recordid);
+        else
+            matches.erase(matches.begin() + count, matches.end());
+    }
+
+    if (!ProgramIndex::SaveMatches(dbConn, matches))
+        return;
+
+    indexed += found;
+
+    gettimeofday(&dbend, NULL);
+
+    LOG(VB_SCHEDULE, LOG_INFO, QString(" |-- %1 rules, %2 results in %3 sec. "
+                                       "from the program index")
+        .arg(found.size()).arg(matches.size())
+        .arg(((dbend.tv_sec  - dbstart.tv_sec) * 1000000 +
+              (dbend.tv_usec - dbstart.tv_usec)) / 1000000.0));
+}
+
 void Scheduler::CreateTempTables(void)
 {
     MSqlQuery result(dbConn);
@@ -8,11 +8,14 @@ using namespace std;
 
 // Qt headers
 #include <QWaitCondition>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QString>
 #include <QMutex>
 #include <QMap>
 #include <QSet>
+#include <QList>
+#include <QPair>
 
 // MythTV headers
 #include "filesysteminfo.h"
@@ -23,6 +26,7 @@ using namespace std;
 #include "mythscheduler.h"
 #include "mthread.h"
 #include "scheduledrecording.h"
+#include "programindex.h"
 
 class EncoderLink;
 class MainServer;
@@ -120,6 +124,11 @@ class Scheduler : public MThread, public MythScheduler
 
     int GetError(void) const { return error; }
 
+    void SetUseProgramIndex(bool use) { m_useProgramIndex = use; }
+    /// microseconds taken by each step of the last run, in order
+    const QList<QPair<QString, int64_t> > &GetPhaseTimes(void) const
+        { return m_phaseTimes; }
+
   protected:
     virtual void run(void); // MThread
 
@@ -135,6 +144,8 @@ class Scheduler : public MThread, public MythScheduler
 
     bool VerifyCards(void);
 
+    void NotePhase(const QString &phase, QElapsedTimer &timer);
+
     void InitInputInfoMap(void);
     void CreateTempTables(void);
     void DeleteTempTables(void);
@@ -148,7 +159,11 @@ class Scheduler : public MThread, public MythScheduler
     void AddNewRecords(void);
     void AddNotListed(void);
     void BuildNewRecordsQueries(uint recordid, QStringList &from,
-                                QStringList &where, MSqlBindings &bindings);
+                                QStringList &where, MSqlBindings &bindings,
+                                const QSet<uint> &indexed);
+    void MatchFromIndex(uint recordid, uint sourceid, uint mplexid,
+                        const QDateTime &maxstarttime, uint filterMask,
+                        QSet<uint> &indexed);
     void PruneOverlaps(void);
     void BuildListMaps(void);
     void ClearListMaps(void);
@@ -283,6 +298,12 @@ class Scheduler : public MThread, public MythScheduler
 
     OpenEndType m_openEnd;
 
+    // guide data for UpdateMatches(), only used by the scheduler thread
+    ProgramIndex m_programIndex;
+    bool m_useProgramIndex;
+
+    QList<QPair<QString, int64_t> > m_phaseTimes;
+
     // cache IsSameProgram()
     typedef pair<const RecordingInfo*,const RecordingInfo*> IsSameKey;
     typedef QMap<IsSameKey,bool> IsSameCacheType;
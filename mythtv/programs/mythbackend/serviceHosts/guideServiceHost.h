@@ -30,6 +30,7 @@
 
 #include "servicehost.h"
 #include "services/guide.h"
+#include "guidecache.h"
 
 /////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -54,6 +55,57 @@ class GuideServiceHost : public ServiceHost
         virtual ~GuideServiceHost()
         {
         }
+
+        virtual bool ProcessRequest( HTTPRequest *pRequest )
+        {
+            if (m_cache.Lookup( pRequest ))
+                return true;
+
+            bool bHandled = ServiceHost::ProcessRequest( pRequest );
+
+            m_cache.Forget( pRequest );
+
+            return bHandled;
+        }
+
+        GuideCache &GetCache() { return m_cache; }
+
+    protected:
+
+        virtual bool FormatResponse( HTTPRequest *pRequest, QObject *pResults )
+        {
+            DTC::ProgramGuide *pGuide =
+                qobject_cast< DTC::ProgramGuide* >( pResults );
+
+            if (pGuide == NULL || !GuideCache::IsCacheable( pRequest ))
+                return ServiceHost::FormatResponse( pRequest, pResults );
+
+            // Note what the guide shows before it is serialized and deleted
+
+            QSet< uint > chanids;
+            QVariantList::const_iterator it = pGuide->Channels().begin();
+            for (; it != pGuide->Channels().end(); ++it)
+            {
+                const DTC::ChannelInfo *pChannel =
+                    qobject_cast< DTC::ChannelInfo* >( (*it).value< QObject* >() );
+                if (pChannel)
+                    chanids.insert( pChannel->ChanId() );
+            }
+
+            QDateTime dtStartTime = pGuide->StartTime();
+            QDateTime dtEndTime   = pGuide->EndTime();
+
+            bool bResult = ServiceHost::FormatResponse( pRequest, pResults );
+
+            if (bResult)
+                m_cache.Store( pRequest, chanids, dtStartTime, dtEndTime );
+
+            return bResult;
+        }
+
+    private:
+
+        GuideCache m_cache;
 };
 
 #endif
@@ -664,4 +664,10 @@ BlankFrameDetector::reportTime(void) const
     return histogramAnalyzer->reportTime();
 }
 
+void
+BlankFrameDetector::getTimes(QMap<QString, double> *times) const
+{
+    histogramAnalyzer->getTimes(times);
+}
+
 /* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -7,6 +7,7 @@ extern "C" {
 }
 #include "mythcorecontext.h"    /* gContext */
 #include "compat.h"
+#include "framekernels.h"
 
 #include "CommDetector2.h"
 #include "FrameAnalyzer.h"
@@ -61,6 +62,48 @@ BorderDetector::setLogoState(TemplateFinder *finder)
     }
 }
 
+bool
+BorderDetector::rowinrange(const AVPicture *pgm, int rr, int mincol,
+        int maxcol1, int maxrange, int maxoutliers, unsigned char *pminval,
+        unsigned char *pmaxval) const
+{
+    /*
+     * Widen [*pminval, *pmaxval] with the pixels of row "rr" in [mincol,
+     * maxcol1), leaving out those of the logo, and return false once more
+     * than "maxoutliers" of them fall outside of a range of "maxrange".
+     */
+    const FrameKernels::Table   &kernels = FrameKernels::Get();
+    const unsigned char         *data = pgm->data[0] + rr * pgm->linesize[0];
+    int                         skip0 = maxcol1, skip1 = maxcol1;
+    int                         cc, end, outliers;
+
+    if (logo && rr >= logorow && rr < logorow + logoheight)
+    {
+        skip0 = logocol;        /* Exclude logo area from analysis. */
+        skip1 = logocol + logowidth;
+    }
+
+    outliers = 0;
+    cc = mincol;
+    while (cc < maxcol1)
+    {
+        if (cc >= skip0 && cc < skip1)
+        {
+            cc = skip1;
+            continue;
+        }
+        end = cc < skip0 ? min(maxcol1, skip0) : maxcol1;
+        cc += kernels.rangeRun(data + cc, end - cc, pminval, pmaxval,
+                maxrange);
+        if (cc == end)
+            continue;
+        if (outliers++ >= maxoutliers)
+            return false;
+        cc++;                   /* Skip the outlier. */
+    }
+    return true;
+}
+
 int
 BorderDetector::getDimensions(const AVPicture *pgm, int pgmheight,
         long long _frameno, int *prow, int *pcol, int *pwidth, int *pheight)
@@ -272,35 +315,15 @@ found_right:
         saved = minrow;
         for (rr = minrow; rr < maxrow1; rr++)
         {
-            outliers = 0;
-            inrange = true;
-            for (cc = mincol; cc < maxcol1; cc++)
+            if (!rowinrange(pgm, rr, mincol, maxcol1, MAXRANGE, MAXOUTLIERS,
+                        &minval, &maxval))
             {
-                if (logo && rrccinrect(rr, cc, logorow, logocol,
-                            logowidth, logoheight))
-                    continue;   /* Exclude logo area from analysis. */
-
-                val = pgm->data[0][rr * pgmwidth + cc];
-                range = max(maxval, val) - min(minval, val) + 1;
-                if (range > MAXRANGE)
-                {
-                    if (outliers++ < MAXOUTLIERS)
-                        continue;   /* Next column. */
-                    inrange = false;
-                    if (lines++ < MAXLINES)
-                        break;  /* Next row. */
-                    goto found_top;
-                }
-                if (val < minval)
-                    minval = val;
-                if (val > maxval)
-                    maxval = val;
-            }
-            if (inrange)
-            {
-                saved = rr;
-                lines = 0;
+                if (lines++ < MAXLINES)
+                    continue;   /* Next row. */
+                goto found_top;
             }
+            saved = rr;
+            lines = 0;
         }
 found_top:
         if (newrow != saved + 1 + VERTSLOP)
@@ -321,35 +344,15 @@ found_top:
         saved = maxrow1 - 1;
         for (rr = maxrow1 - 1; rr >= minrow; rr--)
         {
-            outliers = 0;
-            inrange = true;
-            for (cc = mincol; cc < maxcol1; cc++)
-            {
-                if (logo && rrccinrect(rr, cc, logorow, logocol,
-                            logowidth, logoheight))
-                    continue;   /* Exclude logo area from analysis. */
-
-                val = pgm->data[0][rr * pgmwidth + cc];
-                range = max(maxval, val) - min(minval, val) + 1;
-                if (range > MAXRANGE)
-                {
-                    if (outliers++ < MAXOUTLIERS)
-                        continue;   /* Next column. */
-                    inrange = false;
-                    if (lines++ < MAXLINES)
-                        break;  /* Next row. */
-                    goto found_bottom;
-                }
-                if (val < minval)
-                    minval = val;
-                if (val > maxval)
-                    maxval = val;
-            }
-            if (inrange)
+            if (!rowinrange(pgm, rr, mincol, maxcol1, MAXRANGE, MAXOUTLIERS,
+                        &minval, &maxval))
             {
-                saved = rr;
-                lines = 0;
+                if (lines++ < MAXLINES)
+                    continue;   /* Next row. */
+                goto found_bottom;
             }
+            saved = rr;
+            lines = 0;
         }
 found_bottom:
         if (newheight != saved - minrow - VERTSLOP)
@@ -408,4 +411,10 @@ BorderDetector::reportTime(void)
     return 0;
 }
 
+void
+BorderDetector::getTimes(QMap<QString, double> *times) const
+{
+    (*times)["BorderDetector"] = timevalSeconds(&analyze_time);
+}
+
 /* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -12,6 +12,9 @@
 #ifndef __BORDERDETECTOR_H__
 #define __BORDERDETECTOR_H__
 
+#include <QMap>
+#include <QString>
+
 typedef struct AVPicture AVPicture;
 class MythPlayer;
 class TemplateFinder;
@@ -30,8 +33,13 @@ public:
             int *prow, int *pcol, int *pwidth, int *pheight);
 
     int reportTime(void);
+    void getTimes(QMap<QString, double> *times) const;
 
 private:
+    bool rowinrange(const AVPicture *pgm, int rr, int mincol, int maxcol1,
+            int maxrange, int maxoutliers, unsigned char *pminval,
+            unsigned char *pmaxval) const;
+
     TemplateFinder          *logoFinder;
     const struct AVPicture  *logo;
     int                     logorow, logocol;
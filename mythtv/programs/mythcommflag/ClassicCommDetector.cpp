@@ -15,12 +15,18 @@ using namespace std;
 // Qt headers
 #include <QString>
 #include <QCoreApplication>
+#include <QWaitCondition>
+#include <QRunnable>
+#include <QMutex>
 
 // MythTV headers
 #include "mythmiscutil.h"
 #include "mythcontext.h"
 #include "programinfo.h"
 #include "mythplayer.h"
+#include "playercontext.h"
+#include "mthreadpool.h"
+#include "framekernels.h"
 
 // Commercial Flagging headers
 #include "ClassicCommDetector.h"
@@ -42,6 +48,12 @@ enum frameFormats {
     COMM_FORMAT_MAX       = 4,
 } FrameFormats;
 
+/// Segments of a finished recording are at least this long, see
+/// ClassicCommDetector::GoSegmented()
+static const int kMinSegmentSecs = 5 * 60;
+/// Frames before a segment it analyses first, see FlagSegment()
+static const long long kSegmentWarmUp = 2;
+
 static QString toStringFrameMaskValues(int mask, bool verbose)
 {
     QString msg;
@@ -147,10 +159,13 @@ ClassicCommDetector::ClassicCommDetector(SkipType commDetectMethod_in,
     totalMinBrightness(0),                     detectBlankFrames(false),
     detectSceneChanges(false),                 detectStationLogo(false),
     logoInfoAvailable(false),                  logoDetector(0),
+    sampleCount(0),                            sampleMaskLogo(false),
     frameIsBlank(false),
     sceneHasChanged(false),                    stationLogoPresent(false),
     lastFrameWasBlank(false),                  lastFrameWasSceneChange(false),
     decoderFoundAspectChanges(false),          sceneChangeDetector(0),
+    segmentJobs(1),                            segmentFactory(NULL),
+    segmentFactoryData(NULL),
     player(player_in),
     startedAt(startedAt_in),                   stopsAt(stopsAt_in),
     recordingStartedAt(recordingStartedAt_in),
@@ -160,6 +175,12 @@ ClassicCommDetector::ClassicCommDetector(SkipType commDetectMethod_in,
     fps(0.0),                                  framesProcessed(0),
     preRoll(0),                                postRoll(0)
 {
+    memset(&getFrameTime, 0, sizeof(getFrameTime));
+    memset(&logoSearchTime, 0, sizeof(logoSearchTime));
+    memset(&blankTime, 0, sizeof(blankTime));
+    memset(&sceneTime, 0, sizeof(sceneTime));
+    memset(&logoTime, 0, sizeof(logoTime));
+
     commDetectBlankFrameMaxDiff =
         gCoreContext->GetNumSetting("CommDetectBlankFrameMaxDiff", 25);
     commDetectDarkBrightness =
@@ -391,7 +412,10 @@ bool ClassicCommDetector::go()
         }
         LOG(VB_GENERAL, LOG_INFO, "Finding Logo");
 
+        struct timeval start;
+        (void)gettimeofday(&start, NULL);
         logoInfoAvailable = logoDetector->searchForLogo(player);
+        AddTime(&logoSearchTime, start);
 
         if (showProgress)
         {
@@ -436,14 +460,22 @@ bool ClassicCommDetector::go()
 
     player->ResetTotalDuration();
 
+    if (segmentJobs > 1 && segmentFactory && !stillRecording && fps > 0)
+    {
+        int jobs = min((long long)segmentJobs,
+                       (long long)(myTotalFrames / (fps * kMinSegmentSecs)));
+        if (jobs > 1)
+            return GoSegmented(jobs, myTotalFrames);
+    }
+
     while (player->GetEof() == kEofStateNone)
     {
         struct timeval startTime;
-        if (stillRecording)
-            gettimeofday(&startTime, NULL);
+        gettimeofday(&startTime, NULL);
 
         VideoFrame* currentFrame = player->GetRawVideoFrame();
         currentFrameNumber = currentFrame->frameNumber;
+        AddTime(&getFrameTime, startTime);
 
         //Lucas: maybe we should make the nuppelvideoplayer send out a signal
         //when the aspect ratio changes.
@@ -626,6 +658,342 @@ bool ClassicCommDetector::go()
     return true;
 }
 
+/// What the threads of GoSegmented() have done
+class ClassicCommDetector::SegmentProgress
+{
+  public:
+    SegmentProgress() : frames(0), running(0) {}
+
+    QMutex          lock;
+    QWaitCondition  changed;
+    uint64_t        frames;   ///< analysed by all the segments
+    int             running;
+};
+
+/// Runs ClassicCommDetector::FlagSegment() in a thread of the pool
+class ClassicCommDetector::SegmentRunner : public QRunnable
+{
+  public:
+    SegmentRunner(ClassicCommDetector *segment, long long start,
+                  long long end, SegmentProgress *progress) :
+        m_segment(segment), m_start(start), m_end(end),
+        m_progress(progress), m_ok(false)
+    {
+        setAutoDelete(false);
+    }
+
+    virtual void run(void)
+    {
+        m_ok = m_segment->FlagSegment(m_start, m_end, m_progress);
+
+        QMutexLocker locker(&m_progress->lock);
+        m_progress->running--;
+        m_progress->changed.wakeAll();
+    }
+
+    bool IsOK(void) const { return m_ok; }
+
+  private:
+    ClassicCommDetector *m_segment;
+    long long            m_start;
+    long long            m_end;
+    SegmentProgress     *m_progress;
+    bool                 m_ok;
+};
+
+/** \brief Flags a finished recording in jobs parts at once, each with
+ *         its own player, and merges what they found into this one.
+ *
+ *  The break lists are then built from the merged frame info as they
+ *  are after a serial run. Each part starts where the decoder's seek
+ *  table puts it on the keyframe before it, so the parts give the
+ *  same frame numbers as one player playing the whole recording.
+ */
+bool ClassicCommDetector::GoSegmented(int jobs, long long totalFrames)
+{
+    QList<PlayerContext*> contexts;
+    QList<ClassicCommDetector*> segments;
+    QList<SegmentRunner*> runners;
+    SegmentProgress progress;
+    bool ok = true;
+
+    LOG(VB_GENERAL, LOG_INFO,
+        QString("Flagging %1 frames in %2 segments at once")
+            .arg(totalFrames).arg(jobs));
+
+    for (int i = 0; i < jobs; ++i)
+    {
+        PlayerContext *ctx = segmentFactory(segmentFactoryData);
+        if (!ctx || !ctx->player)
+        {
+            LOG(VB_GENERAL, LOG_ERR,
+                "Unable to create a player for a segment of the recording.");
+            delete ctx;
+            ok = false;
+            break;
+        }
+        contexts << ctx;
+
+        ClassicCommDetector *segment = new ClassicCommDetector(
+            commDetectMethod, false, true, ctx->player, startedAt, stopsAt,
+            recordingStartedAt, recordingStopsAt);
+        segment->InitSegment(*this);
+        segments << segment;
+
+        long long start = totalFrames * i / jobs;
+        long long end = (i + 1 < jobs) ? totalFrames * (i + 1) / jobs : -1;
+        runners << new SegmentRunner(segment, start, end, &progress);
+    }
+
+    MThreadPool pool("CommFlagSegments");
+    pool.setMaxThreadCount(jobs);
+
+    if (ok)
+    {
+        progress.running = runners.size();
+        for (int i = 0; i < runners.size(); ++i)
+            pool.start(runners[i], QString("CommFlagSegment%1").arg(i));
+    }
+
+    QTime flagTime;
+    flagTime.start();
+    int prevpercent = -1;
+
+    progress.lock.lock();
+    while (progress.running > 0)
+    {
+        progress.changed.wait(&progress.lock, 1000);
+        uint64_t frames = progress.frames;
+        progress.lock.unlock();
+
+        emit breathe();
+        for (int i = 0; i < segments.size(); ++i)
+        {
+            if (m_bStop)
+                segments[i]->stop();
+            else if (m_bPaused)
+                segments[i]->pause();
+            else
+                segments[i]->resume();
+        }
+
+        float elapsed = flagTime.elapsed() / 1000.0;
+        float flagFPS = (elapsed) ? frames / elapsed : 0.0;
+        int percentage = min((long long)(frames * 100 / totalFrames), 100LL);
+
+        if (showProgress)
+        {
+            QString tmp = QString("\r%1%/%2fps  \r")
+                .arg(percentage, 3).arg((int)flagFPS, 4);
+            cerr << qPrintable(tmp) << flush;
+        }
+
+        emit statusUpdate(QCoreApplication::translate("(mythcommflag)",
+            "%1% Completed @ %2 fps.")
+                .arg(percentage).arg(flagFPS));
+
+        if (percentage % 10 == 0 && prevpercent != percentage)
+        {
+            prevpercent = percentage;
+            LOG(VB_GENERAL, LOG_INFO, QString("%1%% Completed @ %2 fps.")
+                .arg(percentage) .arg(flagFPS));
+        }
+
+        progress.lock.lock();
+    }
+    progress.lock.unlock();
+    pool.waitForDone();
+
+    if (showProgress)
+    {
+        cerr << "\b\b\b\b\b\b      \b\b\b\b\b\b";
+        cerr.flush();
+    }
+
+    for (int i = 0; i < runners.size(); ++i)
+        ok &= runners[i]->IsOK();
+    ok &= !m_bStop;
+
+    for (int i = 0; i < segments.size() && ok; ++i)
+    {
+        long long start = totalFrames * i / jobs;
+        long long end = (i + 1 < jobs) ? totalFrames * (i + 1) / jobs : -1;
+        MergeSegment(*segments[i], start, end);
+    }
+
+    for (int i = 0; i < segments.size(); ++i)
+    {
+        // The logo detector is this one's
+        segments[i]->logoDetector = NULL;
+        segments[i]->deleteLater();
+    }
+    for (int i = 0; i < runners.size(); ++i)
+        delete runners[i];
+    for (int i = 0; i < contexts.size(); ++i)
+        delete contexts[i];
+
+    return ok;
+}
+
+/** \brief Sets up a detector for a segment of the recording from the
+ *         one which has been through Init() and found the logo.
+ *
+ *  The segment uses the logo detector of the parent, which only reads
+ *  what it found when checking a frame.
+ */
+void ClassicCommDetector::InitSegment(const ClassicCommDetector &parent)
+{
+    width               = parent.width;
+    height              = parent.height;
+    fps                 = parent.fps;
+    preRoll             = parent.preRoll;
+    postRoll            = parent.postRoll;
+    commDetectBorder    = parent.commDetectBorder;
+    horizSpacing        = parent.horizSpacing;
+    vertSpacing         = parent.vertSpacing;
+    verboseDebugging    = parent.verboseDebugging;
+    aggressiveDetection = parent.aggressiveDetection;
+    currentAspect       = parent.currentAspect;
+    logoInfoAvailable   = parent.logoInfoAvailable;
+    logoDetector        = parent.logoDetector;
+    stillRecording      = false;
+
+    // Frames are processed in a thread of the pool, so the scene change
+    // detector has to call back directly rather than through this thread
+    sceneChangeDetector = new ClassicSceneChangeDetector(width, height,
+        commDetectBorder, horizSpacing, vertSpacing);
+    connect(
+         sceneChangeDetector,
+         SIGNAL(haveNewInformation(unsigned int,bool,float)),
+         this,
+         SLOT(sceneChangeDetectorHasNewInformation(unsigned int,bool,float)),
+         Qt::DirectConnection
+    );
+
+    ClearAllMaps();
+}
+
+/** \brief Analyses frames [start, end) of the recording, or from start
+ *         to the end of it when end is -1.
+ *
+ *  This runs in a thread of the pool of GoSegmented(). A few frames
+ *  before start are analysed first, so the scene change detector has
+ *  the frame before start to compare it with, but those are left for
+ *  the segment before this one.
+ */
+bool ClassicCommDetector::FlagSegment(long long start, long long end,
+                                      SegmentProgress *progress)
+{
+    if (player->OpenFile() < 0 || !player->InitVideo())
+    {
+        LOG(VB_GENERAL, LOG_ERR,
+            QString("Unable to open the segment from frame %1.").arg(start));
+        return false;
+    }
+    player->EnableSubtitles(false);
+
+    long long first = max(0LL, start - kSegmentWarmUp);
+    lastFrameNumber = (first) ? first - 1 : -2;
+    curFrameNumber = -1;
+    ((ClassicSceneChangeDetector*)sceneChangeDetector)->setFrameNumber(first);
+
+    float aspect = 0.0;
+    bool jump = true;
+    uint64_t counted = 0;
+
+    while (player->GetEof() == kEofStateNone)
+    {
+        struct timeval start;
+        (void)gettimeofday(&start, NULL);
+        VideoFrame* currentFrame = player->GetRawVideoFrame(jump ? first : -1);
+        long long currentFrameNumber = currentFrame->frameNumber;
+        AddTime(&getFrameTime, start);
+
+        if (end >= 0 && currentFrameNumber >= end)
+        {
+            player->DiscardVideoFrame(currentFrame);
+            break;
+        }
+
+        // The first frame only says which aspect the segment starts with
+        float newAspect = currentFrame->aspect;
+        if (jump)
+        {
+            SetVideoParams(newAspect);
+            aspect = newAspect;
+            jump = false;
+        }
+        else if (newAspect != aspect)
+        {
+            SetVideoParams(aspect);
+            aspect = newAspect;
+        }
+
+        ProcessFrame(currentFrame, currentFrameNumber);
+        player->DiscardVideoFrame(currentFrame);
+
+        if ((++counted % 100) == 0)
+        {
+            QMutexLocker locker(&progress->lock);
+            progress->frames += 100;
+        }
+
+        while (m_bPaused && !m_bStop)
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        if (m_bStop)
+            return false;
+    }
+
+    return true;
+}
+
+/// Adds what a segment found for frames [start, end) to this detector
+void ClassicCommDetector::MergeSegment(const ClassicCommDetector &segment,
+                                       long long start, long long end)
+{
+    QMap<long long, FrameInfoEntry>::const_iterator it =
+        (start) ? segment.frameInfo.lowerBound(start)
+                : segment.frameInfo.begin();
+    for (; it != segment.frameInfo.end() && (end < 0 || it.key() < end); ++it)
+    {
+        frameInfo[it.key()] = *it;
+
+        if (it.key() < 0 || ((*it).flagMask & COMM_FRAME_SKIPPED))
+            continue;
+
+        framesProcessed++;
+        if ((*it).minBrightness >= 0)
+            totalMinBrightness += (*it).minBrightness;
+    }
+
+    frm_dir_map_t::const_iterator mit =
+        segment.blankFrameMap.lowerBound(start);
+    for (; mit != segment.blankFrameMap.end() &&
+             (end < 0 || (long long)mit.key() < end); ++mit)
+    {
+        blankFrameMap[mit.key()] = *mit;
+        blankFrameCount++;
+    }
+
+    mit = segment.sceneMap.lowerBound(start);
+    for (; mit != segment.sceneMap.end() &&
+             (end < 0 || (long long)mit.key() < end); ++mit)
+    {
+        sceneMap[mit.key()] = *mit;
+    }
+
+    decoderFoundAspectChanges |= segment.decoderFoundAspectChanges;
+    timeradd(&getFrameTime, &segment.getFrameTime, &getFrameTime);
+    timeradd(&blankTime, &segment.blankTime, &blankTime);
+    timeradd(&sceneTime, &segment.sceneTime, &sceneTime);
+    timeradd(&logoTime, &segment.logoTime, &logoTime);
+    lastFrameNumber      = segment.lastFrameNumber;
+    curFrameNumber       = segment.curFrameNumber;
+    currentAspect        = segment.currentAspect;
+    commDetectDimAverage = segment.commDetectDimAverage;
+}
+
 void ClassicCommDetector::sceneChangeDetectorHasNewInformation(
     unsigned int framenum,bool isSceneChange,float debugValue)
 {
@@ -722,6 +1090,40 @@ void ClassicCommDetector::recordingFinished(long long totalFileSize)
     stillRecording = false;
 }
 
+/** \brief Lets go() flag a finished recording in up to jobs segments
+ *         at once, with players made by factory.
+ */
+void ClassicCommDetector::setSegmentJobs(int jobs,
+                                         SegmentPlayerFactory factory,
+                                         void *data)
+{
+    segmentJobs = jobs;
+    segmentFactory = factory;
+    segmentFactoryData = data;
+}
+
+void ClassicCommDetector::GetAnalyzerTimes(QMap<QString, double> &times) const
+{
+    const struct timeval *tvs[] =
+        { &getFrameTime, &logoSearchTime, &blankTime, &sceneTime, &logoTime };
+    const char *names[] =
+        { "GetRawVideoFrame", "LogoSearch", "BlankFrames", "SceneChange",
+          "LogoMatch" };
+
+    for (uint i = 0; i < sizeof(tvs) / sizeof(tvs[0]); ++i)
+        times[names[i]] += tvs[i]->tv_sec + tvs[i]->tv_usec / 1000000.0;
+}
+
+/// Adds the time since start to total
+void ClassicCommDetector::AddTime(struct timeval *total,
+                                  const struct timeval &start)
+{
+    struct timeval end, elapsed;
+    (void)gettimeofday(&end, NULL);
+    timersub(&end, &start, &elapsed);
+    timeradd(total, &elapsed, total);
+}
+
 void ClassicCommDetector::requestCommBreakMapUpdate(void)
 {
     commBreakMapUpdateRequested = true;
@@ -772,7 +1174,6 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
     int max = 0;
     int min = 255;
     int avg = 0;
-    unsigned char pixel;
     int blankPixelsChecked = 0;
     long long totBrightness = 0;
     unsigned char *rowMax = new unsigned char[height];
@@ -841,51 +1242,40 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
     if (commDetectMethod & COMM_DETECT_BLANKS)
         frameIsBlank = false;
 
+    struct timeval start;
+    (void)gettimeofday(&start, NULL);
+
     if (commDetectMethod & COMM_DETECT_SCENE)
     {
         sceneChangeDetector->processFrame(frame);
+        AddTime(&sceneTime, start);
+        (void)gettimeofday(&start, NULL);
     }
 
     stationLogoPresent = false;
 
-    for(int y = commDetectBorder; y < (height - commDetectBorder);
-            y += vertSpacing)
+    if (commDetectMethod & COMM_DETECT_BLANKS)
     {
-        for(int x = commDetectBorder; x < (width - commDetectBorder);
-                x += horizSpacing)
-        {
-            pixel = framePtr[y * bytesPerLine + x];
-
-            if (commDetectMethod & COMM_DETECT_BLANKS)
-            {
-                 bool checkPixel = false;
-                 if (!commDetectBlankCanHaveLogo)
-                     checkPixel = true;
-
-                 if (!logoInfoAvailable)
-                     checkPixel = true;
-                 else if (!logoDetector->pixelInsideLogo(x,y))
-                     checkPixel=true;
-
-                 if (checkPixel)
-                 {
-                     blankPixelsChecked++;
-                     totBrightness += pixel;
+        if (sampleMask.empty() || sampleMaskLogo != logoInfoAvailable)
+            BuildSampleMask();
 
-                     if (pixel < min)
-                          min = pixel;
-
-                     if (pixel > max)
-                          max = pixel;
-
-                     if (pixel > rowMax[y])
-                         rowMax[y] = pixel;
-
-                     if (pixel > colMax[x])
-                         colMax[x] = pixel;
-                 }
-            }
+        const FrameKernels::Table &kernels = FrameKernels::Get();
+        const unsigned char *mask = &sampleMask[0];
+        for(int y = commDetectBorder; y < (height - commDetectBorder);
+                y += vertSpacing, mask += width)
+        {
+            unsigned char rmin, rmax;
+            uint32_t rsum;
+            kernels.rowStats(framePtr + y * bytesPerLine, mask, width,
+                             colMax, &rmin, &rmax, &rsum);
+            totBrightness += rsum;
+            rowMax[y] = rmax;
+            if (rmin < min)
+                min = rmin;
+            if (rmax > max)
+                max = rmax;
         }
+        blankPixelsChecked = sampleCount;
     }
 
     if ((commDetectMethod & COMM_DETECT_BLANKS) && blankPixelsChecked)
@@ -965,12 +1355,16 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
             ((max < commDetectDarkBrightness) ||
              ((max < commDetectDimBrightness) && (avg < commDetectDimAverage))))
             frameIsBlank = true;
+
+        AddTime(&blankTime, start);
+        (void)gettimeofday(&start, NULL);
     }
 
     if ((logoInfoAvailable) && (commDetectMethod & COMM_DETECT_LOGO))
     {
         stationLogoPresent =
             logoDetector->doesThisFrameContainTheFoundLogo(frame);
+        AddTime(&logoTime, start);
     }
 
 #if 0
@@ -1021,6 +1415,39 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
     delete[] colMax;
 }
 
+/** \brief Works out which pixels ProcessFrame() samples for blank frame
+ *         detection, which leaves out the logo unless a blank frame may
+ *         have one.
+ */
+void ClassicCommDetector::BuildSampleMask(void)
+{
+    sampleMask.clear();
+    sampleCount = 0;
+    sampleMaskLogo = logoInfoAvailable;
+
+    for(int y = commDetectBorder; y < (height - commDetectBorder);
+            y += vertSpacing)
+    {
+        size_t row = sampleMask.size();
+        sampleMask.resize(row + width, 0);
+
+        for(int x = commDetectBorder; x < (width - commDetectBorder);
+                x += horizSpacing)
+        {
+            if (commDetectBlankCanHaveLogo && logoInfoAvailable &&
+                logoDetector->pixelInsideLogo(x,y))
+                continue;
+
+            sampleMask[row + x] = 0xff;
+            sampleCount++;
+        }
+    }
+
+    // keep &sampleMask[0] valid when no row is sampled
+    if (sampleMask.empty())
+        sampleMask.resize(1, 0);
+}
+
 void ClassicCommDetector::ClearAllMaps(void)
 {
     LOG(VB_COMMFLAG, LOG_INFO, "CommDetect::ClearAllMaps()");
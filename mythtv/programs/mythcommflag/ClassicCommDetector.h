@@ -3,6 +3,10 @@
 
 // POSIX headers
 #include <stdint.h>
+#include <sys/time.h>
+
+// C++ headers
+#include <vector>
 
 // Qt headers
 #include <QObject>
@@ -60,6 +64,9 @@ class ClassicCommDetector : public CommDetectorBase
         void GetCommercialBreakList(frm_dir_map_t &comms);
         void recordingFinished(long long totalFileSize);
         void requestCommBreakMapUpdate(void);
+        void setSegmentJobs(int jobs, SegmentPlayerFactory factory,
+                            void *data);
+        void GetAnalyzerTimes(QMap<QString, double> &times) const;
 
         void PrintFullMap(
             ostream &out, const frm_dir_map_t *comm_breaks,
@@ -73,6 +80,9 @@ class ClassicCommDetector : public CommDetectorBase
         virtual ~ClassicCommDetector() {}
 
     private:
+        class SegmentProgress;
+        class SegmentRunner;
+
         typedef struct frameblock
         {
             long start;
@@ -111,6 +121,14 @@ class ClassicCommDetector : public CommDetectorBase
             frm_dir_map_t &out, const show_map_t &in);
         void CleanupFrameInfo(void);
         void GetLogoCommBreakMap(show_map_t &map);
+        void BuildSampleMask(void);
+
+        bool GoSegmented(int jobs, long long totalFrames);
+        void InitSegment(const ClassicCommDetector &parent);
+        bool FlagSegment(long long start, long long end,
+                         SegmentProgress *progress);
+        void MergeSegment(const ClassicCommDetector &segment,
+                          long long start, long long end);
 
         enum SkipTypes commDetectMethod;
         frm_dir_map_t lastSentCommBreakMap;
@@ -153,6 +171,12 @@ class ClassicCommDetector : public CommDetectorBase
         bool logoInfoAvailable;
         LogoDetectorBase* logoDetector;
 
+        /// 0xff for the pixels ProcessFrame() samples, width bytes for
+        /// each row it samples
+        std::vector<unsigned char> sampleMask;
+        int sampleCount;
+        bool sampleMaskLogo;
+
         frm_dir_map_t blankFrameMap;
         frm_dir_map_t blankCommMap;
         frm_dir_map_t blankCommBreakMap;
@@ -171,6 +195,10 @@ class ClassicCommDetector : public CommDetectorBase
 
         SceneChangeDetectorBase* sceneChangeDetector;
 
+        int segmentJobs;
+        SegmentPlayerFactory segmentFactory;
+        void *segmentFactoryData;
+
 protected:
         MythPlayer *player;
         QDateTime startedAt, stopsAt;
@@ -184,6 +212,13 @@ protected:
         long long preRoll;
         long long postRoll;
 
+        /// Time spent in each stage, see GetAnalyzerTimes()
+        struct timeval getFrameTime;
+        struct timeval logoSearchTime;
+        struct timeval blankTime;
+        struct timeval sceneTime;
+        struct timeval logoTime;
+        static void AddTime(struct timeval *total, const struct timeval &start);
 
         void Init();
         void SetVideoParams(float aspect);
@@ -1,12 +1,17 @@
 // ANSI C headers
 #include <cstdlib>
+
+// C++ headers
 #include <chrono> // for milliseconds
 #include <thread> // for sleep_for
+#include <vector>
+using namespace std;
 
 // MythTV headers
 #include "mythcorecontext.h"
 #include "mythplayer.h"
 #include "libavutil/frame.h"
+#include "framekernels.h"
 
 // Commercial Flagging headers
 #include "ClassicLogoDetector.h"
@@ -29,13 +34,14 @@ ClassicLogoDetector::ClassicLogoDetector(ClassicCommDetector* commdetector,
                                          unsigned int xspacing_in,
                                          unsigned int yspacing_in)
     : LogoDetectorBase(w,h),
-      commDetector(commdetector),                       frameNumber(0),
+      commDetector(commdetector),
       previousFrameWasSceneChange(false),
       xspacing(xspacing_in),                            yspacing(yspacing_in),
       commDetectBorder(commdetectborder_in),            edgeMask(new EdgeMaskEntry[width * height]),
       logoMaxValues(new unsigned char[width * height]), logoMinValues(new unsigned char[width * height]),
       logoFrame(new unsigned char[width * height]),     logoMask(new unsigned char[width * height]),
-      logoCheckMask(new unsigned char[width * height]), tmpBuf(new unsigned char[width * height]),
+      logoCheckMask(new unsigned char[width * height]), logoCheckNotMask(new unsigned char[width * height]),
+      logoTestEdges(0),                                 logoTestNotEdges(0),
       logoEdgeDiff(0),                                  logoFrameCount(0),
       logoMinX(0),                                      logoMaxX(0),
       logoMinY(0),                                      logoMaxY(0),
@@ -75,8 +81,8 @@ void ClassicLogoDetector::deleteLater(void)
         delete [] logoMaxValues;
     if (logoMinValues)
         delete [] logoMinValues;
-    if (tmpBuf)
-        delete [] tmpBuf;
+    if (logoCheckNotMask)
+        delete [] logoCheckNotMask;
 
     LogoDetectorBase::deleteLater();
 }
@@ -273,7 +279,9 @@ bool ClassicLogoDetector::searchForLogo(MythPlayer* player)
 
     delete [] edgeCounts;
 
-    if (!logoInfoAvailable)
+    if (logoInfoAvailable)
+        SetLogoCheckMask();
+    else
         LOG(VB_COMMFLAG, LOG_NOTICE, "No suitable logo area found.");
 
     player->DiscardVideoFrame(player->GetRawVideoFrame(0));
@@ -281,6 +289,37 @@ bool ClassicLogoDetector::searchForLogo(MythPlayer* player)
 }
 
 
+/// Sets the masks of the logo area doesThisFrameContainTheFoundLogo() uses
+void ClassicLogoDetector::SetLogoCheckMask()
+{
+    const unsigned char both =
+        FrameKernels::kEdgeHoriz | FrameKernels::kEdgeVert;
+
+    logoTestEdges = 0;
+    logoTestNotEdges = 0;
+
+    for (unsigned int y = logoMinY; y <= logoMaxY; y++)
+    {
+        for (unsigned int x = logoMinX; x <= logoMaxX; x++)
+        {
+            unsigned int pos = y * width + x;
+            unsigned char mask = 0;
+
+            if (edgeMask[pos].horiz)
+                mask |= FrameKernels::kEdgeHoriz;
+            if (edgeMask[pos].vert)
+                mask |= FrameKernels::kEdgeVert;
+
+            logoCheckMask[pos] = mask;
+            logoCheckNotMask[pos] = both & ~mask;
+            logoTestEdges += !!edgeMask[pos].horiz + !!edgeMask[pos].vert;
+        }
+    }
+
+    logoTestNotEdges = 2 * (logoMaxX - logoMinX + 1) *
+        (logoMaxY - logoMinY + 1) - logoTestEdges;
+}
+
 void ClassicLogoDetector::SetLogoMaskArea()
 {
     LOG(VB_COMMFLAG, LOG_INFO, "SetLogoMaskArea()");
@@ -380,62 +419,33 @@ bool ClassicLogoDetector::doesThisFrameContainTheFoundLogo(
     VideoFrame* frame)
 {
     int radius = 2;
-    unsigned int x, y;
-    int pos1, pos2, pos3;
-    int edgePos;
-    int pixel;
     int goodEdges = 0;
     int badEdges = 0;
-    int testEdges = 0;
-    int testNotEdges = 0;
+    int testEdges = logoTestEdges;
+    int testNotEdges = logoTestNotEdges;
 
     unsigned char* framePtr = frame->buf;
     int bytesPerLine = frame->pitches[0];
+    int count = logoMaxX - logoMinX + 1;
 
-    for (y = logoMinY; y <= logoMaxY; y++ )
-    {
-        for (x = logoMinX; x <= logoMaxX; x++ )
-        {
-            pos1 = y * bytesPerLine + x;
-            edgePos = y * width + x;
-            pos2 = (y - radius) * bytesPerLine + x;
-            pos3 = (y + radius) * bytesPerLine + x;
-
-            pixel = framePtr[pos1];
-
-            if (edgeMask[edgePos].horiz)
-            {
-                if ((abs(framePtr[pos1 - radius] - pixel) >= logoEdgeDiff) ||
-                    (abs(framePtr[pos1 + radius] - pixel) >= logoEdgeDiff))
-                    goodEdges++;
-                testEdges++;
-            }
-            else
-            {
-                if ((abs(framePtr[pos1 - radius] - pixel) >= logoEdgeDiff) ||
-                    (abs(framePtr[pos1 + radius] - pixel) >= logoEdgeDiff))
-                    badEdges++;
-                testNotEdges++;
-            }
+    // This may be called by several threads at once, see
+    // ClassicCommDetector::GoSegmented(), so it keeps to its own buffer
+    vector<unsigned char> flags(count);
+    const FrameKernels::Table &kernels = FrameKernels::Get();
 
-            if (edgeMask[edgePos].vert)
-            {
-                if ((abs(framePtr[pos2] - pixel) >= logoEdgeDiff) ||
-                    (abs(framePtr[pos3] - pixel) >= logoEdgeDiff))
-                    goodEdges++;
-                testEdges++;
-            }
-            else
-            {
-                if ((abs(framePtr[pos2] - pixel) >= logoEdgeDiff) ||
-                    (abs(framePtr[pos3] - pixel) >= logoEdgeDiff))
-                    badEdges++;
-                testNotEdges++;
-            }
-        }
+    for (unsigned int y = logoMinY; y <= logoMaxY; y++ )
+    {
+        unsigned int edgePos = y * width + logoMinX;
+
+        kernels.edgeFlags(framePtr + y * bytesPerLine + logoMinX,
+                          bytesPerLine, count, radius, logoEdgeDiff,
+                          &flags[0]);
+        goodEdges += kernels.countBits(&flags[0], logoCheckMask + edgePos,
+                                       count);
+        badEdges += kernels.countBits(&flags[0], logoCheckNotMask + edgePos,
+                                      count);
     }
 
-    frameNumber++;
     double goodEdgeRatio = (testEdges) ?
         (double)goodEdges / (double)testEdges : 0.0;
     double badEdgeRatio = (testNotEdges) ?
@@ -462,53 +472,64 @@ void ClassicLogoDetector::DetectEdges(VideoFrame *frame, EdgeMaskEntry *edges,
     int r = 2;
     unsigned char *buf = frame->buf;
     int bytesPerLine = frame->pitches[0];
-    unsigned char p;
-    unsigned int pos, x, y;
+    int minX = commDetectBorder + r;
+    int maxX = width - commDetectBorder - r;
 
-    for (y = commDetectBorder + r; y < (height - commDetectBorder - r); y++)
+    // Only the left and right quarters of the frame are looked at
+    int spans[2][2];
+    spans[0][0] = minX;
+    spans[0][1] = max(minX, min(maxX, (int)(width / 4) + 1));
+    spans[1][0] = max(spans[0][1], (int)(width * 3 / 4));
+    spans[1][1] = max(spans[1][0], maxX);
+
+    vector<unsigned char> flags(width);
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+
+    for (unsigned int y = commDetectBorder + r;
+         y < (height - commDetectBorder - r); y++)
     {
         if ((y > (height/4)) && (y < (height * 3 / 4)))
             continue;
 
-        for (x = commDetectBorder + r; x < (width - commDetectBorder - r); x++)
+        for (int i = 0; i < 2; i++)
         {
-            int edgeCount = 0;
-
-            if ((x > (width/4)) && (x < (width * 3 / 4)))
+            int x = spans[i][0];
+            int count = spans[i][1] - x;
+            if (count <= 0)
                 continue;
 
-            pos = y * width + x;
-            p = buf[y * bytesPerLine + x];
+            kernels.edgeFlags(buf + y * bytesPerLine + x, bytesPerLine,
+                              count, r, edgeDiff, &flags[0]);
 
-            if (( abs(buf[y * bytesPerLine + (x - r)] - p) >= edgeDiff) ||
-                ( abs(buf[y * bytesPerLine + (x + r)] - p) >= edgeDiff))
+            EdgeMaskEntry *edge = &edges[y * width + x];
+            for (int j = 0; j < count; j++, edge++)
             {
-                edges[pos].horiz++;
-                edgeCount++;
-            }
-            if (( abs(buf[(y - r) * bytesPerLine + x] - p) >= edgeDiff) ||
-                ( abs(buf[(y + r) * bytesPerLine + x] - p) >= edgeDiff))
-            {
-                edges[pos].vert++;
-                edgeCount++;
-            }
+                int edgeCount = 0;
 
-            if (( abs(buf[(y - r) * bytesPerLine + (x - r)] - p) >= edgeDiff) ||
-                ( abs(buf[(y + r) * bytesPerLine + (x + r)] - p) >= edgeDiff))
-            {
-                edges[pos].ldiag++;
-                edgeCount++;
-            }
+                if (flags[j] & FrameKernels::kEdgeHoriz)
+                {
+                    edge->horiz++;
+                    edgeCount++;
+                }
+                if (flags[j] & FrameKernels::kEdgeVert)
+                {
+                    edge->vert++;
+                    edgeCount++;
+                }
+                if (flags[j] & FrameKernels::kEdgeLDiag)
+                {
+                    edge->ldiag++;
+                    edgeCount++;
+                }
+                if (flags[j] & FrameKernels::kEdgeRDiag)
+                {
+                    edge->rdiag++;
+                    edgeCount++;
+                }
 
-            if (( abs(buf[(y - r) * bytesPerLine + (x + r)] - p) >= edgeDiff) ||
-                ( abs(buf[(y + r) * bytesPerLine + (x - r)] - p) >= edgeDiff))
-            {
-                edges[pos].rdiag++;
-                edgeCount++;
+                if (edgeCount >= 3)
+                    edge->isedge++;
             }
-
-            if (edgeCount >= 3)
-                edges[pos].isedge++;
         }
     }
 }
@@ -26,11 +26,11 @@ class ClassicLogoDetector : public LogoDetectorBase
 
   private:
     void SetLogoMaskArea();
+    void SetLogoCheckMask();
     void DumpLogo(bool fromCurrentFrame,unsigned char* framePtr);
     void DetectEdges(VideoFrame *frame, EdgeMaskEntry *edges, int edgeDiff);
 
     ClassicCommDetector* commDetector;
-    unsigned int frameNumber;
     bool previousFrameWasSceneChange;
     unsigned int xspacing, yspacing;
     unsigned int commDetectBorder;
@@ -47,8 +47,11 @@ class ClassicLogoDetector : public LogoDetectorBase
     unsigned char *logoMinValues;
     unsigned char *logoFrame;
     unsigned char *logoMask;
+    /// the kEdgeHoriz and kEdgeVert edges of the logo, and those it lacks
     unsigned char *logoCheckMask;
-    unsigned char *tmpBuf;
+    unsigned char *logoCheckNotMask;
+    int logoTestEdges;
+    int logoTestNotEdges;
 
     int logoEdgeDiff;
     unsigned int logoFrameCount;
@@ -14,6 +14,7 @@ class ClassicSceneChangeDetector : public SceneChangeDetectorBase
     virtual void deleteLater(void);
 
     void processFrame(VideoFrame* frame);
+    void setFrameNumber(unsigned int frame) { frameNumber = frame; }
 
   private:
     ~ClassicSceneChangeDetector() {}
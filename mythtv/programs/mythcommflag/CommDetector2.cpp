@@ -298,6 +298,11 @@ QString strftimeval(const struct timeval *tv)
     return str.sprintf("%ld.%06ld", tv->tv_sec, tv->tv_usec);
 }
 
+double timevalSeconds(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1000000.0;
+}
+
 };  /* namespace */
 
 using namespace commDetector2;
@@ -330,6 +335,8 @@ CommDetector2::CommDetector2(
     BorderDetector          *borderDetector = NULL;
     HistogramAnalyzer       *histogramAnalyzer = NULL;
 
+    memset(&getFrameTime, 0, sizeof(getFrameTime));
+
     if (useDB)
         debugdir = debugDirectory(chanid, recstartts);
 
@@ -724,6 +731,7 @@ bool CommDetector2::go(void)
 
         LOG(VB_COMMFLAG, LOG_INFO, QString("NVP Time: GetRawVideoFrame=%1s")
                 .arg(strftimeval(&getframetime)));
+        timeradd(&getFrameTime, &getframetime, &getFrameTime);
         if (passReportTime(*currentPass))
             return false;
     }
@@ -841,6 +849,24 @@ void CommDetector2::requestCommBreakMapUpdate(void)
     breakMapUpdateRequested = true;
 }
 
+void CommDetector2::GetAnalyzerTimes(QMap<QString, double> &times) const
+{
+    /* Analyzers share their converters, which are counted once. */
+    QMap<QString, double> passTimes;
+    FrameAnalyzerList::const_iterator pass = frameAnalyzers.begin();
+    for (; pass != frameAnalyzers.end(); ++pass)
+    {
+        FrameAnalyzerItem::const_iterator it = pass->begin();
+        for (; it != pass->end(); ++it)
+            (*it)->getTimes(&passTimes);
+    }
+    passTimes["GetRawVideoFrame"] = timevalSeconds(&getFrameTime);
+
+    QMap<QString, double>::const_iterator it = passTimes.begin();
+    for (; it != passTimes.end(); ++it)
+        times[it.key()] += *it;
+}
+
 static void PrintReportMap(ostream &out,
                            const FrameAnalyzer::FrameMap &frameMap)
 {
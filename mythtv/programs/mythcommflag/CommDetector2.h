@@ -28,6 +28,7 @@ void createDebugDirectory(QString dirname, QString comment);
 QString frameToTimestamp(long long frameno, float fps);
 QString frameToTimestampms(long long frameno, float fps);
 QString strftimeval(const struct timeval *tv);
+double timevalSeconds(const struct timeval *tv);
 
 };  /* namespace */
 
@@ -46,6 +47,7 @@ class CommDetector2 : public CommDetectorBase
     virtual void GetCommercialBreakList(frm_dir_map_t &comms);
     virtual void recordingFinished(long long totalFileSize);
     virtual void requestCommBreakMapUpdate(void);
+    virtual void GetAnalyzerTimes(QMap<QString, double> &times) const;
     virtual void PrintFullMap(
         ostream &out, const frm_dir_map_t *comm_breaks, bool verbose) const;
 
@@ -74,6 +76,7 @@ class CommDetector2 : public CommDetectorBase
     FrameAnalyzerItem       finishedAnalyzers;
 
     FrameAnalyzer::FrameMap breaks;
+    struct timeval          getFrameTime;       /* of all the passes */
 
     TemplateFinder          *logoFinder;
     TemplateMatcher         *logoMatcher;
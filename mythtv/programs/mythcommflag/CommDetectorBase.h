@@ -6,6 +6,7 @@ using namespace std;
 
 #include <QObject>
 #include <QMap>
+#include <QString>
 
 #include "programtypes.h"
 
@@ -19,6 +20,12 @@ typedef enum commMapValues {
 
 typedef QMap<uint64_t, CommMapValue> show_map_t;
 
+class PlayerContext;
+
+/// Makes another player context for the recording being flagged, which
+/// the caller deletes, see CommDetectorBase::setSegmentJobs()
+typedef PlayerContext *(*SegmentPlayerFactory)(void *data);
+
 /** \class CommDetectorBase
  *  \brief Abstract base class for all CommDetectors.
  *   Please use the CommDetectFactory to make actual instances.
@@ -40,6 +47,13 @@ public:
     virtual void recordingFinished(long long totalFileSize)
         { (void)totalFileSize; };
     virtual void requestCommBreakMapUpdate(void) {};
+    virtual void setSegmentJobs(int jobs, SegmentPlayerFactory factory,
+                                void *data)
+        { (void)jobs; (void)factory; (void)data; };
+
+    /// Adds the seconds spent in each stage of flagging, by its name
+    virtual void GetAnalyzerTimes(QMap<QString, double> &times) const
+        { (void)times; };
 
     virtual void PrintFullMap(
         ostream &out, const frm_dir_map_t *comm_breaks, bool verbose) const = 0;
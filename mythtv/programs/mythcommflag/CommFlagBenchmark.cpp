@@ -0,0 +1,570 @@
+// POSIX headers
+#include <sys/time.h> // for gettimeofday
+#ifndef _WIN32
+#include <sys/resource.h> // for getrusage
+#endif
+
+// C++ headers
+#include <algorithm> // for min/max
+#include <vector>
+
+// Qt headers
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QEvent>
+#include <QFile>
+#include <QDir>
+
+// MythTV headers
+#include "mythconfig.h"
+#include "mythlogging.h"
+#include "exitcodes.h"
+#include "programinfo.h"
+#include "playercontext.h"
+#include "ringbuffer.h"
+#include "mythcommflagplayer.h"
+
+// Commercial Flagging headers
+#include "CommDetectorBase.h"
+#include "CommDetectorFactory.h"
+#include "CommFlagBenchmark.h"
+
+#define LOC QString("CommFlagBenchmark: ")
+
+typedef QPair<uint64_t, uint64_t> Break; ///< frames [first, second)
+
+static double seconds(const struct timeval &tv)
+{
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/// User and system time of all the threads so far
+static double cpu_seconds(void)
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+#endif
+    return 0.0;
+}
+
+/// Starts the peak resident set size over, where Linux allows it
+static bool reset_peak_rss(void)
+{
+    QFile file("/proc/self/clear_refs");
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write("5") == 1;
+}
+
+/// The peak resident set size in kB
+static long get_peak_rss(void)
+{
+    QFile file("/proc/self/status");
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QByteArray line;
+        while (!(line = file.readLine()).isEmpty())
+        {
+            if (line.startsWith("VmHWM:"))
+                return line.mid(6).simplified().split(' ')[0].toLong();
+        }
+    }
+
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#if CONFIG_DARWIN
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+static QString json_string(const QString &str)
+{
+    QString res = "\"";
+    for (int i = 0; i < str.size(); i++)
+    {
+        QChar c = str[i];
+        if (c == '"' || c == '\\')
+            res += QString("\\") + c;
+        else if (c.unicode() < 0x20)
+            res += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        else
+            res += c;
+    }
+    return res + "\"";
+}
+
+/// The ratio as JSON, null when there is nothing to divide by
+static QString json_ratio(uint64_t num, uint64_t den)
+{
+    if (!den)
+        return "null";
+    return QString::number((double)num / den, 'f', 4);
+}
+
+/// The ranges of a mark map, a start with no end runs to frames
+static vector<Break> get_breaks(const frm_dir_map_t &marks, uint64_t frames)
+{
+    vector<Break> breaks;
+    uint64_t start = 0;
+    bool inBreak = false;
+
+    frm_dir_map_t::const_iterator it = marks.begin();
+    for (; it != marks.end(); ++it)
+    {
+        if (*it == MARK_COMM_START || *it == MARK_CUT_START)
+        {
+            if (!inBreak)
+                start = it.key();
+            inBreak = true;
+        }
+        else if (*it == MARK_COMM_END || *it == MARK_CUT_END)
+        {
+            if (it.key() > start)
+                breaks.push_back(Break(start, it.key()));
+            inBreak = false;
+            start = it.key();
+        }
+    }
+    if (inBreak && frames > start)
+        breaks.push_back(Break(start, frames));
+
+    return breaks;
+}
+
+CommFlagBenchmark::Result::Result() :
+    frames(0),          seconds(0.0),
+    cpuSeconds(0.0),    peakRSS(0),
+    peakRSSReset(true), breaks(0),
+    trueBreaks(0),      matchedBreaks(0),
+    breakFrames(0),     trueBreakFrames(0),
+    matchedFrames(0)
+{
+}
+
+void CommFlagBenchmark::Result::Add(const Result &other)
+{
+    frames          += other.frames;
+    seconds         += other.seconds;
+    cpuSeconds      += other.cpuSeconds;
+    peakRSS          = max(peakRSS, other.peakRSS);
+    peakRSSReset    &= other.peakRSSReset;
+    breaks          += other.breaks;
+    trueBreaks      += other.trueBreaks;
+    matchedBreaks   += other.matchedBreaks;
+    breakFrames     += other.breakFrames;
+    trueBreakFrames += other.trueBreakFrames;
+    matchedFrames   += other.matchedFrames;
+
+    QMap<QString, double>::const_iterator it = other.analyzerTimes.begin();
+    for (; it != other.analyzerTimes.end(); ++it)
+        analyzerTimes[it.key()] += *it;
+}
+
+/// The fields of the result, without the braces around them
+QString CommFlagBenchmark::Result::ToJSON(void) const
+{
+    QString times;
+    QMap<QString, double>::const_iterator it = analyzerTimes.begin();
+    for (; it != analyzerTimes.end(); ++it)
+    {
+        if (!times.isEmpty())
+            times += ", ";
+        times += QString("%1: %2").arg(json_string(it.key()))
+            .arg(*it, 0, 'f', 3);
+    }
+
+    return QString(
+        "\"frames\": %1, \"seconds\": %2, \"cpu_seconds\": %3, "
+        "\"frames_per_second\": %4, "
+        "\"peak_rss_kb\": %5, \"peak_rss_reset\": %6, "
+        "\"analyzer_seconds\": {%7}, ")
+        .arg(frames)
+        .arg(seconds, 0, 'f', 3)
+        .arg(cpuSeconds, 0, 'f', 3)
+        .arg((seconds > 0.0) ? frames / seconds : 0.0, 0, 'f', 1)
+        .arg(peakRSS)
+        .arg(peakRSSReset ? "true" : "false")
+        .arg(times) +
+        QString(
+        "\"breaks\": %1, \"true_breaks\": %2, \"matched_breaks\": %3, "
+        "\"break_precision\": %4, \"break_recall\": %5, "
+        "\"frame_precision\": %6, \"frame_recall\": %7")
+        .arg(breaks).arg(trueBreaks).arg(matchedBreaks)
+        .arg(json_ratio(matchedBreaks, breaks))
+        .arg(json_ratio(matchedBreaks, trueBreaks))
+        .arg(json_ratio(matchedFrames, breakFrames))
+        .arg(json_ratio(matchedFrames, trueBreakFrames));
+}
+
+CommFlagBenchmark::CommFlagBenchmark(
+    const QMap<QString, SkipTypes> &methodNames) :
+    m_methodNames(methodNames)
+{
+    SetMethods("all,d2_all,prepostroll");
+}
+
+bool CommFlagBenchmark::LoadCorpus(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Unable to open corpus %1").arg(filename));
+        return false;
+    }
+
+    QDir dir = QFileInfo(filename).absoluteDir();
+    QRegExp range("^(\\d+)-(\\d+)$");
+    QTextStream stream(&file);
+
+    m_corpus.clear();
+    for (int lineno = 1; !stream.atEnd(); lineno++)
+    {
+        QString line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QStringList fields = line.split(QRegExp("\\s+"));
+        bool ok = fields.size() == 2 || fields.size() == 4;
+
+        Recording recording;
+        if (ok)
+        {
+            recording.filename = dir.absoluteFilePath(fields[0]);
+            if (fields.size() == 4)
+            {
+                bool ok2;
+                recording.preRoll = fields[2].toInt(&ok);
+                recording.postRoll = fields[3].toInt(&ok2);
+                ok &= ok2 && recording.preRoll >= 0 &&
+                    recording.postRoll >= 0;
+            }
+        }
+
+        if (ok && fields[1] != "-")
+        {
+            QStringList ranges = fields[1].split(',');
+            for (int i = 0; ok && i < ranges.size(); i++)
+            {
+                ok = range.exactMatch(ranges[i]) &&
+                    range.cap(1).toULongLong() < range.cap(2).toULongLong();
+                if (ok)
+                {
+                    recording.breaks[range.cap(1).toULongLong()] =
+                        MARK_COMM_START;
+                    recording.breaks[range.cap(2).toULongLong()] =
+                        MARK_COMM_END;
+                }
+            }
+        }
+
+        if (!ok)
+        {
+            LOG(VB_GENERAL, LOG_ERR, LOC +
+                QString("%1:%2: expected a file name, breaks and "
+                        "optionally pre-roll and post-roll seconds")
+                    .arg(filename).arg(lineno));
+            return false;
+        }
+
+        m_corpus.push_back(recording);
+    }
+
+    if (m_corpus.empty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Corpus %1 lists no recordings").arg(filename));
+        return false;
+    }
+
+    return true;
+}
+
+/** \brief Sets the methods to compare, separated by commas. A method
+ *         is one of the --method names, or several joined by '+'.
+ */
+bool CommFlagBenchmark::SetMethods(const QString &methods)
+{
+    m_methods.clear();
+
+    QStringList list = methods.toLower().split(",", QString::SkipEmptyParts);
+    for (int i = 0; i < list.size(); i++)
+    {
+        int method = COMM_DETECT_OFF;
+        QStringList parts = list[i].split("+", QString::SkipEmptyParts);
+        for (int j = 0; j < parts.size(); j++)
+        {
+            if (!m_methodNames.contains(parts[j]) ||
+                m_methodNames[parts[j]] <= COMM_DETECT_OFF)
+            {
+                LOG(VB_GENERAL, LOG_ERR, LOC +
+                    QString("Unknown method '%1'").arg(parts[j]));
+                return false;
+            }
+            method |= m_methodNames[parts[j]];
+        }
+        if (method != COMM_DETECT_OFF)
+            m_methods.push_back(qMakePair(list[i], (SkipTypes)method));
+    }
+
+    if (m_methods.empty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC + "No methods to compare");
+        return false;
+    }
+
+    return true;
+}
+
+/** \brief Flags every recording of the corpus with every method, runs
+ *         times over, and writes the results to out.
+ */
+int CommFlagBenchmark::Run(int runs, ostream &out, bool showProgress)
+{
+    QMap<QString, Result> totals;
+    QMap<QString, int> okRuns;
+    int failed = 0;
+
+    // The runs are the outer loop, so a slow down of the machine while
+    // the benchmark runs does not all fall on one method
+    for (int run = 1; run <= runs; run++)
+    {
+        for (int i = 0; i < m_corpus.size(); i++)
+        {
+            for (int j = 0; j < m_methods.size(); j++)
+            {
+                const QString &name = m_methods[j].first;
+                QString file = QFileInfo(m_corpus[i].filename).fileName();
+
+                if (showProgress)
+                {
+                    cerr << "Run " << run << "/" << runs << ": "
+                         << qPrintable(file) << " with "
+                         << qPrintable(name) << endl;
+                }
+
+                Result result;
+                bool ok = Flag(m_corpus[i], m_methods[j].second, result);
+
+                QString line = QString(
+                    "{\"type\": \"run\", \"file\": %1, \"method\": %2, "
+                    "\"run\": %3, \"ok\": %4")
+                    .arg(json_string(m_corpus[i].filename))
+                    .arg(json_string(name)).arg(run)
+                    .arg(ok ? "true" : "false");
+                if (ok)
+                {
+                    line += ", " + result.ToJSON();
+                    totals[name].Add(result);
+                    okRuns[name]++;
+                }
+                else
+                {
+                    failed++;
+                }
+                out << qPrintable(line + "}") << endl;
+
+                if (showProgress && ok)
+                {
+                    cerr << "    " << result.frames << " frames at "
+                         << qPrintable(QString::number(
+                                (result.seconds > 0.0) ?
+                                result.frames / result.seconds : 0.0,
+                                'f', 1))
+                         << " fps, " << result.matchedBreaks << " of "
+                         << result.trueBreaks << " breaks found" << endl;
+                }
+            }
+        }
+    }
+
+    for (int j = 0; j < m_methods.size(); j++)
+    {
+        const QString &name = m_methods[j].first;
+        if (!okRuns.contains(name))
+            continue;
+        out << qPrintable(QString(
+                   "{\"type\": \"summary\", \"method\": %1, \"runs\": %2, ")
+                   .arg(json_string(name)).arg(okRuns[name]) +
+                   totals[name].ToJSON() + "}")
+            << endl;
+    }
+
+    if (failed)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("%1 flagging run(s) failed").arg(failed));
+        return GENERIC_EXIT_NOT_OK;
+    }
+
+    return GENERIC_EXIT_OK;
+}
+
+/// Flags the recording with the method, as a --skipdb run would
+bool CommFlagBenchmark::Flag(const Recording &recording, SkipTypes method,
+                             Result &result) const
+{
+    ProgramInfo pginfo(recording.filename);
+    QDateTime recstartts = pginfo.GetRecordingStartTime();
+    QDateTime recendts = pginfo.GetRecordingEndTime();
+    QDateTime startts = recstartts.addSecs(recording.preRoll);
+    QDateTime endts = recendts.addSecs(-recording.postRoll);
+    pginfo.SetScheduledStartTime(startts);
+    pginfo.SetScheduledEndTime(endts);
+
+    if (!QFile::exists(recording.filename))
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Couldn't find file %1").arg(recording.filename));
+        return false;
+    }
+
+    RingBuffer *rbuf = RingBuffer::Create(recording.filename, false);
+    if (!rbuf)
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Unable to create RingBuffer for %1")
+                .arg(recording.filename));
+        return false;
+    }
+
+    // The same as FlagCommercials() uses
+    PlayerFlags flags = (PlayerFlags)(kAudioMuted   |
+                                      kVideoIsNull  |
+                                      kDecodeLowRes |
+                                      kDecodeSingleThreaded |
+                                      kDecodeNoLoopFilter |
+                                      kNoITV);
+    if ((COMM_DETECT_BLANKS  == method) ||
+        (COMM_DETECT_2_BLANK == method))
+    {
+        flags = (PlayerFlags) (flags | kDecodeFewBlocks);
+    }
+
+    MythCommFlagPlayer *cfp = new MythCommFlagPlayer(flags);
+    PlayerContext *ctx = new PlayerContext(kFlaggerInUseID);
+    ctx->SetPlayingInfo(&pginfo);
+    ctx->SetRingBuffer(rbuf);
+    ctx->SetPlayer(cfp);
+    cfp->SetPlayerInfo(NULL, NULL, ctx);
+
+    result.peakRSSReset = reset_peak_rss();
+    double cpuStart = cpu_seconds();
+    struct timeval start, end, elapsed;
+    (void)gettimeofday(&start, NULL);
+
+    CommDetectorFactory factory;
+    CommDetectorBase *commDetector = factory.makeCommDetector(
+        method, false, true, cfp, pginfo.GetChanID(),
+        startts, endts, recstartts, recendts, false);
+
+    bool ok = commDetector->go();
+
+    frm_dir_map_t breaks;
+    if (ok)
+    {
+        struct timeval listStart;
+        (void)gettimeofday(&listStart, NULL);
+        commDetector->GetCommercialBreakList(breaks);
+        (void)gettimeofday(&end, NULL);
+        timersub(&end, &listStart, &elapsed);
+        result.analyzerTimes["BreakList"] = seconds(elapsed);
+    }
+    else
+    {
+        LOG(VB_GENERAL, LOG_ERR, LOC +
+            QString("Flagging %1 failed").arg(recording.filename));
+        (void)gettimeofday(&end, NULL);
+    }
+
+    timersub(&end, &start, &elapsed);
+    result.seconds = seconds(elapsed);
+    result.cpuSeconds = cpu_seconds() - cpuStart;
+    result.peakRSS = get_peak_rss();
+    result.frames = cfp->GetTotalFrameCount();
+    commDetector->GetAnalyzerTimes(result.analyzerTimes);
+
+    if (ok)
+    {
+        Score(breaks, recording.breaks, result.frames, cfp->GetFrameRate(),
+              result);
+    }
+
+    commDetector->deleteLater();
+    QCoreApplication::sendPostedEvents(NULL, QEvent::DeferredDelete);
+    delete ctx;
+
+    return ok;
+}
+
+/** \brief Compares the breaks found with the true ones.
+ *
+ *  A break found is matched to a true break when both its start and
+ *  its end are within kEdgeTolerance seconds of those of the true one.
+ *  The frames in both a break found and a true break are counted too,
+ *  which gives credit to a break found with its edges a little off, or
+ *  found as two.
+ */
+void CommFlagBenchmark::Score(const frm_dir_map_t &breakMap,
+                              const frm_dir_map_t &truthMap,
+                              uint64_t frames, double fps, Result &result)
+{
+    vector<Break> breaks = get_breaks(breakMap, frames);
+    vector<Break> truth = get_breaks(truthMap, frames);
+    uint64_t tolerance = (uint64_t)(kEdgeTolerance * ((fps > 0) ? fps : 30));
+
+    result.breaks = breaks.size();
+    result.trueBreaks = truth.size();
+
+    vector<bool> matched(truth.size(), false);
+    for (uint i = 0; i < breaks.size(); i++)
+    {
+        result.breakFrames += breaks[i].second - breaks[i].first;
+        for (uint j = 0; j < truth.size(); j++)
+        {
+            if (matched[j])
+                continue;
+            uint64_t startDiff = max(breaks[i].first, truth[j].first) -
+                min(breaks[i].first, truth[j].first);
+            uint64_t endDiff = max(breaks[i].second, truth[j].second) -
+                min(breaks[i].second, truth[j].second);
+            if (startDiff <= tolerance && endDiff <= tolerance)
+            {
+                matched[j] = true;
+                result.matchedBreaks++;
+                break;
+            }
+        }
+    }
+
+    for (uint j = 0; j < truth.size(); j++)
+        result.trueBreakFrames += truth[j].second - truth[j].first;
+
+    // both are sorted and the breaks in each do not overlap
+    uint i = 0, j = 0;
+    while (i < breaks.size() && j < truth.size())
+    {
+        uint64_t first = max(breaks[i].first, truth[j].first);
+        uint64_t last = min(breaks[i].second, truth[j].second);
+        if (last > first)
+            result.matchedFrames += last - first;
+        if (breaks[i].second < truth[j].second)
+            i++;
+        else
+            j++;
+    }
+}
+
+/* vim: set expandtab tabstop=4 shiftwidth=4: */
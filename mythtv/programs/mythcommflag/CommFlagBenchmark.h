@@ -0,0 +1,92 @@
+#ifndef _COMMFLAG_BENCHMARK_H_
+#define _COMMFLAG_BENCHMARK_H_
+
+// C++ headers
+#include <iostream>
+using namespace std;
+
+// Qt headers
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <QMap>
+
+// MythTV headers
+#include "programtypes.h"
+
+/** \class CommFlagBenchmark
+ *  \brief Flags a corpus of recordings with each of a list of methods,
+ *         and reports how fast and how accurate each one was.
+ *
+ *  The corpus is a text file with a line for each recording: the file
+ *  name, relative to the corpus, and the true commercial breaks as
+ *  frame ranges, "#-#[,#-#]..." as --setcutlist takes them or "-" for
+ *  none. Two more numbers may follow, the seconds recorded before the
+ *  show started and after it ended, which the detectors are given as
+ *  the recording's pre-roll and post-roll. Blank lines and lines
+ *  starting with '#' are skipped.
+ *
+ *  Each flagging run writes a JSON object on a line of its own, then
+ *  each method gets a line summing its runs up. See
+ *  contrib/development/commflagbench/README for the fields.
+ */
+class CommFlagBenchmark
+{
+  public:
+    explicit CommFlagBenchmark(const QMap<QString, SkipTypes> &methodNames);
+
+    bool LoadCorpus(const QString &filename);
+    bool SetMethods(const QString &methods);
+    int Run(int runs, ostream &out, bool showProgress);
+
+    /// Seconds a detected break edge may be from the true one
+    static const int kEdgeTolerance = 2;
+
+  private:
+    class Recording
+    {
+      public:
+        Recording() : preRoll(0), postRoll(0) {}
+
+        QString       filename;
+        frm_dir_map_t breaks;
+        int           preRoll;  ///< in seconds
+        int           postRoll; ///< in seconds
+    };
+
+    /// What one method did with one recording, or all of the corpus
+    class Result
+    {
+      public:
+        Result();
+        void Add(const Result &other);
+        QString ToJSON(void) const;
+
+        uint64_t              frames;
+        double                seconds;
+        double                cpuSeconds;
+        long                  peakRSS;      ///< in kB
+        bool                  peakRSSReset; ///< peak is of this run only
+        QMap<QString, double> analyzerTimes;
+        uint64_t              breaks;
+        uint64_t              trueBreaks;
+        uint64_t              matchedBreaks;
+        uint64_t              breakFrames;
+        uint64_t              trueBreakFrames;
+        uint64_t              matchedFrames;
+    };
+
+    bool Flag(const Recording &recording, SkipTypes method,
+              Result &result) const;
+    static void Score(const frm_dir_map_t &breaks,
+                      const frm_dir_map_t &truth, uint64_t frames,
+                      double fps, Result &result);
+
+    QMap<QString, SkipTypes>            m_methodNames;
+    QList<QPair<QString, SkipTypes> >   m_methods;
+    QList<Recording>                    m_corpus;
+};
+
+#endif  // _COMMFLAG_BENCHMARK_H_
+
+/* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -15,6 +15,7 @@ extern "C" {
 // MythTV headers
 #include "mythframe.h"          // VideoFrame
 #include "mythplayer.h"
+#include "framekernels.h"
 
 // Commercial Flagging headers
 #include "FrameAnalyzer.h"
@@ -36,26 +37,32 @@ sgm_init_exclude(unsigned int *sgm, const AVPicture *src, int srcheight,
      * that pixel: how much it differs from its neighbors.
      */
     const int       srcwidth = src->linesize[0];
-    int             rr, cc, dx, dy, rr2, cc2;
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+    int             rr, rr2, cc2, exclude1, exclude2;
     unsigned char   *rr0, *rr1;
 
     memset(sgm, 0, srcwidth * srcheight * sizeof(*sgm));
     rr2 = srcheight - 1;
     cc2 = srcwidth - 1;
+
+    /* Columns [exclude1..exclude2) of the excluded rows are left out. */
+    exclude1 = min(max(0, excludecol), cc2);
+    exclude2 = max(exclude1, min(max(0, excludecol + excludewidth), cc2));
+
     for (rr = 0; rr < rr2; rr++)
     {
-        for (cc = 0; cc < cc2; cc++)
+        rr0 = &src->data[0][rr * srcwidth];
+        rr1 = &src->data[0][(rr + 1) * srcwidth];
+
+        if (rr < excluderow || rr >= excluderow + excludeheight)
         {
-            if (!rrccinrect(rr, cc, excluderow, excludecol,
-                        excludewidth, excludeheight))
-            {
-                rr0 = &src->data[0][rr * srcwidth + cc];
-                rr1 = &src->data[0][(rr + 1) * srcwidth + cc];
-                dx = rr1[1] - rr0[0];   /* southeast - northwest */
-                dy = rr1[0] - rr0[1];   /* southwest - northeast */
-                sgm[rr * srcwidth + cc] = dx * dx + dy * dy;
-            }
+            kernels.gradient(rr0, rr1, cc2, &sgm[rr * srcwidth]);
+            continue;
         }
+
+        kernels.gradient(rr0, rr1, exclude1, &sgm[rr * srcwidth]);
+        kernels.gradient(rr0 + exclude2, rr1 + exclude2, cc2 - exclude2,
+                &sgm[rr * srcwidth + exclude2]);
     }
     return sgm;
 }
@@ -12,6 +12,7 @@
 #include <limits.h>
 
 #include <QMap>
+#include <QString>
 
 /*  
  * At least FreeBSD doesn't define LONG_LONG_MAX, but it does define  
@@ -65,6 +66,10 @@ public:
         return 0;
     }
     virtual int reportTime(void) const { return 0; }
+    /* Add the seconds reportTime() logs to *times, by the stage name. */
+    virtual void getTimes(QMap<QString, double> *times) const {
+        (void)times;
+    }
 
     virtual FrameMap GetMap(unsigned int) const = 0;
 };
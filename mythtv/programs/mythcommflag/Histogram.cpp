@@ -2,8 +2,11 @@
 #include <string>
 #include <cmath>
 #include <cstring>
+#include <algorithm>
+using namespace std;
 
 #include "mythframe.h"
+#include "framekernels.h"
 
 Histogram::Histogram()
 {
@@ -31,14 +34,26 @@ void Histogram::generateFromImage(VideoFrame* frame, unsigned int frameWidth,
     if (maxScanY > frameHeight-1)
         maxScanY = frameHeight-1;
 
+    if (maxScanX <= minScanX)
+        return;
+
     unsigned char* framePtr = frame->buf;
     int bytesPerLine = frame->pitches[0];
+    int rowSamples = (maxScanX - minScanX + XSpacing - 1) / XSpacing;
+    unsigned char samples[256];
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+
     for(unsigned int y = minScanY; y < maxScanY; y += YSpacing)
-        for(unsigned int x = minScanX; x < maxScanX; x += XSpacing)
+    {
+        const unsigned char *row = framePtr + y * bytesPerLine + minScanX;
+        for (int done = 0; done < rowSamples; done += sizeof(samples))
         {
-            data[framePtr[y * bytesPerLine + x]]++;
-            numberOfSamples++;
+            int count = min(rowSamples - done, (int)sizeof(samples));
+            kernels.gather(row + done * XSpacing, count, XSpacing, samples);
+            kernels.histogram(samples, count, data, NULL, NULL);
         }
+        numberOfSamples += rowSamples;
+    }
 }
 
 unsigned int Histogram::getAverageIntensity(void) const
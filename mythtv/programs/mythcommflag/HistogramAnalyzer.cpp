@@ -4,10 +4,15 @@
 // ANSI C headers
 #include <cmath>
 
+// C++ headers
+#include <algorithm>
+using namespace std;
+
 // MythTV headers
 #include "mythcorecontext.h"
 #include "mythplayer.h"
 #include "mythlogging.h"
+#include "framekernels.h"
 
 // Commercial Flagging headers
 #include "CommDetector2.h"
@@ -23,6 +28,20 @@ using namespace frameAnalyzer;
 
 namespace {
 
+unsigned char *
+sampleRow(const unsigned char *row, int cc1, int cc2, int cinc,
+        unsigned char *pp)
+{
+    /* Copy every cinc'th pixel of [cc1..cc2) to pp. */
+    if (cc2 <= cc1)
+        return pp;
+
+    const int   count = (cc2 - cc1 + cinc - 1) / cinc;
+
+    FrameKernels::Get().gather(row + cc1, count, cinc, pp);
+    return pp + count;
+}
+
 bool
 readData(QString filename, float *mean, unsigned char *median, float *stddev,
         int *frow, int *fcol, int *fwidth, int *fheight,
@@ -314,7 +333,7 @@ HistogramAnalyzer::analyzeFrame(const VideoFrame *frame, long long frameno)
     int                 croprow, cropcol, cropwidth, cropheight;
     unsigned int        borderpixels, livepixels, npixels, halfnpixels;
     unsigned char       *pp, bordercolor;
-    unsigned long long  sumval, sumsquares;
+    uint64_t            sumval, sumsquares;
     int                 rr, cc, rr1, cc1, rr2, cc2, rr3, cc3;
     struct timeval      start, end, elapsed;
 
@@ -357,28 +376,29 @@ HistogramAnalyzer::analyzeFrame(const VideoFrame *frame, long long frameno)
 
     sumval = 0;
     sumsquares = 0;
-    livepixels = 0;
     pp = &buf[borderpixels];
     memset(histval, 0, sizeof(histval));
     histval[DEFAULT_COLOR] += borderpixels;
     for (rr = rr1; rr < rr2; rr += RINC)
     {
-        int rroffset = rr * pgmwidth;
+        const unsigned char *row = &pgm->data[0][rr * pgmwidth];
 
-        for (cc = cc1; cc < cc2; cc += CINC)
+        if (logo && rr >= logorr1 && rr <= logorr2)
         {
-            if (logo && rr >= logorr1 && rr <= logorr2 &&
-                    cc >= logocc1 && cc <= logocc2)
-                continue; /* Exclude logo area from analysis. */
-
-            unsigned char val = pgm->data[0][rroffset + cc];
-            *pp++ = val;
-            sumval += val;
-            sumsquares += val * val;
-            livepixels++;
-            histval[val]++;
+            /* Exclude logo area from analysis. */
+            cc = min(cc2, logocc1);
+            pp = sampleRow(row, cc1, cc, CINC, pp);
+            pp = sampleRow(row, max(cc1, max(ROUNDUP(cc, CINC),
+                            ROUNDUP(logocc2 + 1, CINC))), cc2, CINC, pp);
+        }
+        else
+        {
+            pp = sampleRow(row, cc1, cc2, CINC, pp);
         }
     }
+    livepixels = pp - &buf[borderpixels];
+    FrameKernels::Get().histogram(&buf[borderpixels], livepixels, histval,
+            &sumval, &sumsquares);
     npixels = borderpixels + livepixels;
 
     /* Scale scores down to [0..255]. */
@@ -455,4 +475,12 @@ HistogramAnalyzer::reportTime(void) const
     return 0;
 }
 
+void
+HistogramAnalyzer::getTimes(QMap<QString, double> *times) const
+{
+    pgmConverter->getTimes(times);
+    borderDetector->getTimes(times);
+    (*times)["HistogramAnalyzer"] = timevalSeconds(&analyze_time);
+}
+
 /* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -137,4 +137,14 @@ PGMConverter::reportTime(void)
     return 0;
 }
 
+void
+PGMConverter::getTimes(QMap<QString, double> *times) const
+{
+#ifdef PGM_CONVERT_GREYSCALE
+    (*times)["PGMConverter"] = timevalSeconds(&convert_time);
+#else  /* !PGM_CONVERT_GREYSCALE */
+    (void)times;
+#endif /* !PGM_CONVERT_GREYSCALE */
+}
+
 /* vim: set expandtab tabstop=4 shiftwidth=4: */
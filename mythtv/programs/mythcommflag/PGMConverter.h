@@ -7,6 +7,9 @@
 #ifndef __PGMCONVERTER_H__
 #define __PGMCONVERTER_H__
 
+#include <QMap>
+#include <QString>
+
 extern "C" {
 #include "libavcodec/avcodec.h"    /* AVPicture */
 }
@@ -38,6 +41,7 @@ public:
     const AVPicture *getImage(const VideoFrame *frame, long long frameno,
             int *pwidth, int *pheight);
     int reportTime(void);
+    void getTimes(QMap<QString, double> *times) const;
 
 private:
     long long       frameno;            /* frame number */
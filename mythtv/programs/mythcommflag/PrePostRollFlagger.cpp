@@ -244,11 +244,11 @@ long long PrePostRollFlagger::findBreakInrange(long long startFrame,
     while (player->GetEof() == kEofStateNone)
     {
         struct timeval startTime;
-        if (stillRecording)
-            gettimeofday(&startTime, NULL);
+        gettimeofday(&startTime, NULL);
 
         VideoFrame* currentFrame = player->GetRawVideoFrame();
         currentFrameNumber = currentFrame->frameNumber;
+        AddTime(&getFrameTime, startTime);
 
         if(currentFrameNumber % 1000 == 0)
         {
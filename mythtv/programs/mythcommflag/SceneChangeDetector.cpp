@@ -226,4 +226,10 @@ SceneChangeDetector::reportTime(void) const
     return histogramAnalyzer->reportTime();
 }
 
+void
+SceneChangeDetector::getTimes(QMap<QString, double> *times) const
+{
+    histogramAnalyzer->getTimes(times);
+}
+
 /* vim: set expandtab tabstop=4 shiftwidth=4: */
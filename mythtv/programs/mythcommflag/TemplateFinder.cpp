@@ -1055,6 +1055,14 @@ TemplateFinder::reportTime(void) const
     return 0;
 }
 
+void
+TemplateFinder::getTimes(QMap<QString, double> *times) const
+{
+    pgmConverter->getTimes(times);
+    borderDetector->getTimes(times);
+    (*times)["TemplateFinder"] = timevalSeconds(&analyze_time);
+}
+
 const struct AVPicture *
 TemplateFinder::getTemplate(int *prow, int *pcol, int *pwidth, int *pheight)
     const
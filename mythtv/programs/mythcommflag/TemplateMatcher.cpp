@@ -17,6 +17,7 @@ using namespace std;
 #include "mythplayer.h"
 #include "mythcorecontext.h"
 #include "mythlogging.h"
+#include "framekernels.h"
 
 // Commercial Flagging headers
 #include "CommDetector2.h"
@@ -37,13 +38,8 @@ int pgm_set(const AVPicture *pict, int height)
 {
     const int   width = pict->linesize[0];
     const int   size = height * width;
-    int         score, ii;
 
-    score = 0;
-    for (ii = 0; ii < size; ii++)
-        if (pict->data[0][ii])
-            score++;
-    return score;
+    return FrameKernels::Get().countBoth(pict->data[0], pict->data[0], size);
 }
 
 int pgm_match(const AVPicture *tmpl, const AVPicture *test, int height,
@@ -61,6 +57,14 @@ int pgm_match(const AVPicture *tmpl, const AVPicture *test, int height,
         return -1;
     }
 
+    if (radius == 0)
+    {
+        /* No jitter: a pixel matches only the same pixel of "test". */
+        *pscore = FrameKernels::Get().countBoth(tmpl->data[0], test->data[0],
+                                                height * width);
+        return 0;
+    }
+
     score = 0;
     for (rr = 0; rr < height; rr++)
     {
@@ -612,6 +616,13 @@ TemplateMatcher::reportTime(void) const
     return 0;
 }
 
+void
+TemplateMatcher::getTimes(QMap<QString, double> *times) const
+{
+    pgmConverter->getTimes(times);
+    (*times)["TemplateMatcher"] = timevalSeconds(&analyze_time);
+}
+
 int
 TemplateMatcher::templateCoverage(long long nframes, bool final) const
 {
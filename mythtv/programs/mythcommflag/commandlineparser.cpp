@@ -25,6 +25,15 @@ void MythCommFlagCommandLineParser::LoadArguments(void)
                     ->SetGroup("Input")
          << add("--video", "video", "", 
                 "Rebuild the seek table for a video (non-recording) file.", "")
+                    ->SetGroup("Input")
+         << add("--benchmark", "benchmark", "",
+                "Flag the recordings listed in a corpus file with each "
+                "method, and report their speed and accuracy.",
+                "Each line of the corpus names a recording, relative to "
+                "the corpus, and its true commercial breaks as frame "
+                "ranges in the form #-#[,#-#]... or - for none. The "
+                "database is not used. A line of JSON is written to "
+                "--outputfile, or stdout, for each flagging run.")
                     ->SetGroup("Input") );
 
     CommandLineArg::AllowOneOf( QList<CommandLineArg*>()
@@ -56,14 +65,37 @@ void MythCommFlagCommandLineParser::LoadArguments(void)
                     ->SetGroup("Commflagging")
                     ->SetBlocks("commmethod") );
 
+    add("--fullrebuild", "fullrebuild", false,
+        "Rebuild the seektable by decoding the whole recording.",
+        "MPEG-2 and H.264 recordings are normally rebuilt by parsing "
+        "the stream, which is much faster. This decodes them as older "
+        "versions did.")
+            ->SetGroup("Commflagging");
+
     add("--method", "commmethod", "",
         "Commercial flagging method[s] to employ:\n"
         "off, blank, scene, blankscene, logo, all, "
-        "d2, d2_logo, d2_blank, d2_scene, d2_all", "")
+        "d2, d2_logo, d2_blank, d2_scene, d2_all, prepostroll", "")
             ->SetGroup("Commflagging");
+    add("--benchmethods", "benchmethods", "all,d2_all,prepostroll",
+        "Methods --benchmark compares, separated by commas. Join "
+        "methods with + to use them together.", "")
+            ->SetGroup("Commflagging")
+            ->SetRequires("benchmark");
+    add("--benchruns", "benchruns", 1,
+        "Number of times --benchmark flags each recording with each "
+        "method.", "")
+            ->SetGroup("Commflagging")
+            ->SetRequires("benchmark");
     add("--outputmethod", "outputmethod", "",
         "Format of output written to outputfile, essentials, full.", "")
             ->SetGroup("Commflagging");
+    add("--jobs", "jobs", 1,
+        "Number of segments of a finished recording to flag at once, "
+        "0 for one per CPU core.",
+        "Overrides the CommFlagJobs setting. Only the classic detection "
+        "methods flag in segments, and only recordings with a seek table.")
+            ->SetGroup("Commflagging");
     add("--queue", "queue", false,
         "Insert flagging job into the JobQueue, rather than "
         "running flagging in the foreground.", "");
@@ -12,6 +12,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <algorithm> // for max
 using namespace std;
 
 // Qt headers
@@ -20,6 +21,7 @@ using namespace std;
 #include <QRegExp>
 #include <QDir>
 #include <QEvent>
+#include <QThread>
 
 // MythTV headers
 #include "mythmiscutil.h"
@@ -46,6 +48,7 @@ using namespace std;
 // Commercial Flagging headers
 #include "CommDetectorBase.h"
 #include "CommDetectorFactory.h"
+#include "CommFlagBenchmark.h"
 #include "SlotRelayer.h"
 #include "CustomEventRelayer.h"
 
@@ -99,6 +102,7 @@ static QMap<QString,SkipTypes> *init_skip_types(void)
     (*tmp)["d2_blank"]    = COMM_DETECT_2_BLANK;
     (*tmp)["d2_scene"]    = COMM_DETECT_2_SCENE;
     (*tmp)["d2_all"]      = COMM_DETECT_2_ALL;
+    (*tmp)["prepostroll"] = COMM_DETECT_PREPOSTROLL_ALL;
     return tmp;
 }
 
@@ -522,11 +526,81 @@ static void incomingCustomEvent(QEvent* e)
     }
 }
 
+/// What new_segment_player() needs to open the recording again
+class SegmentPlayerInfo
+{
+  public:
+    ProgramInfo *program_info;
+    PlayerFlags  flags;
+};
+
+static PlayerContext *new_segment_player(void *data)
+{
+    SegmentPlayerInfo *info = (SegmentPlayerInfo *)data;
+    QString filename = get_filename(info->program_info);
+
+    RingBuffer *rbuf = RingBuffer::Create(filename, false);
+    if (!rbuf)
+    {
+        LOG(VB_GENERAL, LOG_ERR,
+            QString("Unable to create RingBuffer for %1").arg(filename));
+        return NULL;
+    }
+
+    MythCommFlagPlayer *cfp = new MythCommFlagPlayer(info->flags);
+    PlayerContext *ctx = new PlayerContext(kFlaggerInUseID);
+    ctx->SetPlayingInfo(info->program_info);
+    ctx->SetRingBuffer(rbuf);
+    ctx->SetPlayer(cfp);
+    cfp->SetPlayerInfo(NULL, NULL, ctx);
+
+    return ctx;
+}
+
+/** \brief How many segments of the recording to flag at once.
+ *
+ *  Only a finished recording with a seek table in the database is
+ *  split, as the segments are found with it, and only when flagging
+ *  at full speed.
+ */
+static int get_segment_jobs(const ProgramInfo *program_info,
+                            bool useDB, bool fullSpeed)
+{
+    int jobs = gCoreContext->GetNumSetting("CommFlagJobs", 1);
+    if (cmdline.toBool("jobs"))
+        jobs = cmdline.toInt("jobs");
+    if (jobs <= 0)
+        jobs = QThread::idealThreadCount();
+
+    if (jobs <= 1 || !useDB || !fullSpeed || watchingRecording ||
+        program_info->GetRecordingEndTime() > MythDate::current())
+    {
+        return 1;
+    }
+
+    const MarkTypes types[] =
+        { MARK_GOP_BYFRAME, MARK_GOP_START, MARK_KEYFRAME };
+    for (uint i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+    {
+        uint64_t count, last_mark, last_offset;
+        if (program_info->QueryPositionMapSummary(
+                types[i], count, last_mark, last_offset) && count)
+        {
+            return jobs;
+        }
+    }
+
+    LOG(VB_COMMFLAG, LOG_INFO,
+        "There is no seek table, so the recording is flagged in one segment.");
+    return 1;
+}
+
 static int DoFlagCommercials(
     ProgramInfo *program_info,
     bool showPercentage, bool fullSpeed, int jobid,
     MythCommFlagPlayer* cfp, enum SkipTypes commDetectMethod,
-    const QString &outputfilename, bool useDB)
+    const QString &outputfilename, bool useDB,
+    int segmentJobs, SegmentPlayerInfo *segmentInfo)
 {
     CommDetectorFactory factory;
     commDetector = factory.makeCommDetector(
@@ -538,6 +612,10 @@ static int DoFlagCommercials(
         program_info->GetRecordingStartTime(),
         program_info->GetRecordingEndTime(), useDB);
 
+    if (segmentJobs > 1)
+        commDetector->setSegmentJobs(segmentJobs, new_segment_player,
+                                     segmentInfo);
+
     if (jobid > 0)
         LOG(VB_COMMFLAG, LOG_INFO,
             QString("mythcommflag processing JobID %1").arg(jobid));
@@ -921,9 +999,15 @@ static int FlagCommercials(ProgramInfo *program_info, int jobid,
 
     // TODO: Add back insertion of job if not in jobqueue
 
+    SegmentPlayerInfo segmentInfo;
+    segmentInfo.program_info = program_info;
+    segmentInfo.flags = flags;
+    int segmentJobs = get_segment_jobs(program_info, useDB, fullSpeed);
+
     breaksFound = DoFlagCommercials(
         program_info, progress, fullSpeed, jobid,
-        cfp, commDetectMethod, outputfilename, useDB);
+        cfp, commDetectMethod, outputfilename, useDB,
+        segmentJobs, &segmentInfo);
 
     if (progress)
         cerr << breaksFound << "\n";
@@ -1041,7 +1125,8 @@ static int RebuildSeekTable(ProgramInfo *pginfo, int jobid)
         cerr << "Rebuild started at " << qPrintable(time) << endl;
     }
 
-    cfp->RebuildSeekTable(progress);
+    cfp->RebuildSeekTable(progress, NULL, NULL,
+                          cmdline.toBool("fullrebuild"));
 
     if (progress)
     {
@@ -1130,7 +1215,8 @@ int main(int argc, char *argv[])
     if (!gContext->Init( false, /*use gui*/
                          false, /*prompt for backend*/
                          false, /*bypass auto discovery*/
-                         cmdline.toBool("skipdb"))) /*ignoreDB*/
+                         cmdline.toBool("skipdb") ||
+                         cmdline.toBool("benchmark"))) /*ignoreDB*/
     {
         LOG(VB_GENERAL, LOG_EMERG, "Failed to init MythContext, exiting.");
         return GENERIC_EXIT_NO_MYTHCONTEXT;
@@ -1231,6 +1317,30 @@ int main(int argc, char *argv[])
         // build skiplist for video file
         return RebuildSeekTable(cmdline.toString("video"), -1);
     }
+    else if (cmdline.toBool("benchmark"))
+    {
+        // compare the methods on recordings outside the database
+        CommFlagBenchmark benchmark(*skipTypes);
+        if (!benchmark.LoadCorpus(cmdline.toString("benchmark")) ||
+            !benchmark.SetMethods(cmdline.toString("benchmethods")))
+        {
+            return GENERIC_EXIT_INVALID_CMDLINE;
+        }
+
+        ostream *out = &cout;
+        QString outputfile = cmdline.toString("outputfile");
+        if (!outputfile.isEmpty() && outputfile != "-")
+        {
+            QByteArray tmp = outputfile.toLocal8Bit();
+            out = new fstream(tmp.constData(), ios::app | ios::out);
+        }
+
+        result = benchmark.Run(max(1, cmdline.toInt("benchruns")), *out,
+                               !cmdline.toBool("noprogress"));
+
+        if (out != &cout)
+            delete out;
+    }
     else if (cmdline.toBool("file"))
     {
         if (cmdline.toBool("skipdb"))
@@ -33,6 +33,7 @@ HEADERS += PrePostRollFlagger.h
 
 HEADERS += LogoDetectorBase.h SceneChangeDetectorBase.h
 HEADERS += SlotRelayer.h CustomEventRelayer.h
+HEADERS += CommFlagBenchmark.h
 HEADERS += commandlineparser.h
 
 SOURCES += CommDetectorFactory.cpp CommDetectorBase.cpp
@@ -51,6 +52,7 @@ SOURCES += HistogramAnalyzer.cpp
 SOURCES += BlankFrameDetector.cpp
 SOURCES += SceneChangeDetector.cpp
 SOURCES += PrePostRollFlagger.cpp
+SOURCES += CommFlagBenchmark.cpp
 
 SOURCES += main.cpp commandlineparser.cpp
 
@@ -7,6 +7,7 @@ extern "C" {
 }
 #include "mythframe.h"
 #include "mythlogging.h"
+#include "framekernels.h"
 #include "pgm.h"
 
 // TODO: verify this
@@ -225,8 +226,8 @@ int pgm_convolve_radial(AVPicture *dst, AVPicture *s1, AVPicture *s2,
     const int       srcwidth = src->linesize[0];
     const int       newwidth = srcwidth + 2 * mask_radius;
     const int       newheight = srcheight + 2 * mask_radius;
-    int             ii, rr, cc, rr2, cc2;
-    double          sum;
+    const FrameKernels::Table &kernels = FrameKernels::Get();
+    int             rr, rr2, offset;
 
     /* Get a padded copy of the src image for use by the convolutions. */
     if (pgm_expand_uniform(s1, src, srcheight, mask_radius))
@@ -238,34 +239,19 @@ int pgm_convolve_radial(AVPicture *dst, AVPicture *s1, AVPicture *s2,
 
     /* "s1" convolve with column vector => "s2" */
     rr2 = mask_radius + srcheight;
-    cc2 = mask_radius + srcwidth;
     for (rr = mask_radius; rr < rr2; rr++)
     {
-        for (cc = mask_radius; cc < cc2; cc++)
-        {
-            sum = 0;
-            for (ii = -mask_radius; ii <= mask_radius; ii++)
-            {
-                sum += mask[ii + mask_radius] *
-                    s1->data[0][(rr + ii) * newwidth + cc];
-            }
-            s2->data[0][rr * newwidth + cc] = (unsigned char)(sum + 0.5);
-        }
+        offset = rr * newwidth + mask_radius;
+        kernels.convolve(&s1->data[0][offset], newwidth, srcwidth,
+                mask, mask_radius, &s2->data[0][offset]);
     }
 
     /* "s2" convolve with row vector => "dst" */
     for (rr = mask_radius; rr < rr2; rr++)
     {
-        for (cc = mask_radius; cc < cc2; cc++)
-        {
-            sum = 0;
-            for (ii = -mask_radius; ii <= mask_radius; ii++)
-            {
-                sum += mask[ii + mask_radius] *
-                    s2->data[0][rr * newwidth + cc + ii];
-            }
-            dst->data[0][rr * newwidth + cc] = (unsigned char)(sum + 0.5);
-        }
+        offset = rr * newwidth + mask_radius;
+        kernels.convolve(&s2->data[0][offset], 1, srcwidth,
+                mask, mask_radius, &dst->data[0][offset]);
     }
 
     return 0;
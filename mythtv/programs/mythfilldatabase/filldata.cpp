@@ -29,6 +29,7 @@ using namespace std;
 #include "mythsystemlegacy.h"
 #include "videosource.h" // for is_grabber..
 #include "mythcorecontext.h"
+#include "mythevent.h"
 
 // filldata headers
 #include "filldata.h"
@@ -945,6 +946,10 @@ bool FillData::Run(SourceList &sourcelist)
         {
             nonewdata++;
         }
+
+        // Drop the backend's cached guide pages for this source
+        gCoreContext->SendEvent(MythEvent(
+            QString("GUIDE_CHANGED SOURCE %1").arg((*it).id)));
     }
 
     if (!fatalErrors.empty())
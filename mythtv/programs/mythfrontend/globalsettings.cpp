@@ -231,6 +231,22 @@ static GlobalCheckBox *CommFlagFast()
     return gc;
 }
 
+static GlobalSpinBox *CommFlagJobs()
+{
+    GlobalSpinBox *gs = new GlobalSpinBox("CommFlagJobs", 0, 64, 1);
+
+    gs->setLabel(GeneralSettings::tr("Commercial detection segments"));
+
+    gs->setHelpText(GeneralSettings::tr("The number of parts of a finished "
+                                        "recording the classic commercial "
+                                        "detection looks at at the same "
+                                        "time, 0 for one per CPU core."));
+
+    gs->setValue(1);
+
+    return gs;
+}
+
 static HostComboBox *AutoCommercialSkip()
 {
     HostComboBox *gc = new HostComboBox("AutoCommercialSkip");
@@ -4140,6 +4156,7 @@ GeneralSettings::GeneralSettings()
 
     jobs->addChild(CommercialSkipMethod());
     jobs->addChild(CommFlagFast());
+    jobs->addChild(CommFlagJobs());
     jobs->addChild(AggressiveCommDetect());
     jobs->addChild(DeferAutoTranscodeDays());
 
@@ -5,6 +5,7 @@
 #include "mythcorecontext.h"
 #include "settings.h"
 #include "channelsettings.h" // for ChannelTVFormat::GetFormats()
+#include "threadedfilewriter.h"
 #include <unistd.h>
 
 #include <QNetworkInterface>
@@ -232,6 +233,61 @@ static GlobalSpinBox *HDRingbufferSize()
     return bs;
 }
 
+static GlobalCheckBox *HDRingbufferLockFree()
+{
+    GlobalCheckBox *gc = new GlobalCheckBox("HDRingbufferLockFree");
+    gc->setLabel(QObject::tr("Lock-free HD ringbuffer"));
+    gc->setValue(false);
+    gc->setHelpText(QObject::tr("If enabled, the HD device ringbuffer is "
+                    "passed between the device and the recorder without "
+                    "locking, which lowers the CPU use of busy tuners. "
+                    "Takes effect on the next recording."));
+    return gc;
+};
+
+static HostComboBox *TFWWriteBackend()
+{
+    HostComboBox *gc = new HostComboBox("TFWWriteBackend");
+    gc->setLabel(QObject::tr("Recording write method"));
+    QStringList backends = ThreadedFileWriter::GetWriteBackends();
+    gc->addSelection(QObject::tr("Buffered"), "write");
+    if (backends.contains("pwritev"))
+        gc->addSelection(QObject::tr("Direct I/O"), "pwritev");
+    if (backends.contains("io_uring"))
+        gc->addSelection(QObject::tr("Direct I/O with io_uring"), "io_uring");
+    gc->setHelpText(QObject::tr("How recordings on this backend are written "
+                    "to disk. Direct I/O bypasses the page cache, which "
+                    "helps when many recordings are made at once on the "
+                    "same storage. Filesystems that do not support it fall "
+                    "back to buffered writes."));
+    return gc;
+}
+
+static HostSpinBox *TFWBufferPoolSize()
+{
+    HostSpinBox *bs = new HostSpinBox("TFWBufferPoolSize", 0, 1024, 16);
+    bs->setLabel(QObject::tr("Recording write buffer pool (MB)"));
+    bs->setHelpText(QObject::tr("Write buffers freed by one recording are "
+                    "kept for reuse by the next, up to this many megabytes. "
+                    "This keeps the backend's memory use steady over long "
+                    "periods of recording."));
+    bs->setValue(64);
+    return bs;
+}
+
+static HostCheckBox *SeekIndexFile()
+{
+    HostCheckBox *hc = new HostCheckBox("SeekIndexFile");
+    hc->setLabel(QObject::tr("Write seek tables next to recordings"));
+    hc->setValue(true);
+    hc->setHelpText(QObject::tr("If enabled, the seek table of a recording "
+                    "in progress is written to a file next to it and only "
+                    "saved to the database when the recording ends. This "
+                    "greatly reduces database load when many recordings "
+                    "are running."));
+    return hc;
+}
+
 static GlobalComboBox *StorageScheduler()
 {
     GlobalComboBox *gc = new GlobalComboBox("StorageScheduler");
@@ -589,6 +645,34 @@ static GlobalCheckBox *AutoCommflagWhileRecording()
     return gc;
 };
 
+static GlobalCheckBox *AutoCommflagInRecorder()
+{
+    GlobalCheckBox *gc = new GlobalCheckBox("AutoCommflagInRecorder");
+    gc->setLabel(QObject::tr("Detect commercials inside the recorder"));
+    gc->setValue(false);
+    gc->setHelpText(QObject::tr("If enabled, and Auto Commercial Detection is "
+                                "ON for a digital recording, the backend looks "
+                                "for commercials in the stream as it is "
+                                "recorded, so the commercial breaks are known "
+                                "when the recording ends and the file is not "
+                                "read again. When it falls too far behind, the "
+                                "usual flagging job runs after the recording."));
+    return gc;
+};
+
+static GlobalSpinBox *AutoCommflagInRecorderCPU()
+{
+    GlobalSpinBox *gc = new GlobalSpinBox("AutoCommflagInRecorderCPU",
+                                          5, 100, 5);
+    gc->setLabel(QObject::tr("Recorder commercial detection CPU limit (%)"));
+    gc->setValue(25);
+    gc->setHelpText(QObject::tr("The share of one CPU core each recording may "
+                                "use to detect commercials inside the "
+                                "recorder. Less video is decoded when the "
+                                "limit is reached."));
+    return gc;
+};
+
 static GlobalLineEdit *UserJob(uint job_num)
 {
     GlobalLineEdit *gc = new GlobalLineEdit(QString("UserJob%1").arg(job_num));
@@ -861,6 +945,10 @@ BackendSettings::BackendSettings() {
     fmh1->addChild(TruncateDeletes());
     fm->addChild(fmh1);
     fm->addChild(HDRingbufferSize());
+    fm->addChild(HDRingbufferLockFree());
+    fm->addChild(TFWWriteBackend());
+    fm->addChild(TFWBufferPoolSize());
+    fm->addChild(SeekIndexFile());
     fm->addChild(StorageScheduler());
     group2->addChild(fm);
     VerticalConfigurationGroup* upnp = new VerticalConfigurationGroup();
@@ -946,6 +1034,8 @@ BackendSettings::BackendSettings() {
     group6->setLabel(QObject::tr("Job Queue (Global)"));
     group6->addChild(JobsRunOnRecordHost());
     group6->addChild(AutoCommflagWhileRecording());
+    group6->addChild(AutoCommflagInRecorder());
+    group6->addChild(AutoCommflagInRecorderCPU());
     group6->addChild(JobQueueCommFlagCommand());
     group6->addChild(JobQueueTranscodeCommand());
     group6->addChild(AutoTranscodeBeforeAutoCommflag());
@@ -176,6 +176,15 @@ void MythUtilCommandLineParser::LoadArguments(void)
         << add("--checkrecordings", "checkrecordings", false,
                 "Check all recording exist and have a seektable etc.", "")
                 ->SetGroup("Recording Utils")
+        << add("--importseekindex", "importseekindex", false,
+                "Save the seek index file of a recording to the database.",
+                "Replaces the seektable of the recording with the given "
+                "chanid and starttime with the one in the seek index file "
+                "next to it, e.g. after the backend exited before the "
+                "recording finished.")
+                ->SetGroup("Recording Utils")
+                ->SetRequiredChild("chanid")
+                ->SetRequiredChild("starttime")
 
         // eitutils.cpp
         << add("--cleareit", "cleareit", false,
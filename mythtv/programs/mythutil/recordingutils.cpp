@@ -16,6 +16,7 @@ using namespace std;
 #include "remotefile.h"
 #include "mythsystem.h"
 #include "mythdirs.h"
+#include "seekindex.h"
 
 // Local includes
 #include "recordingutils.h"
@@ -232,9 +233,38 @@ static int CheckRecordings(const MythUtilCommandLineParser &cmdline)
     return GENERIC_EXIT_OK;
 }
 
+static int ImportSeekIndex(const MythUtilCommandLineParser &cmdline)
+{
+    ProgramInfo pginfo;
+    if (!GetProgramInfo(cmdline, pginfo))
+        return GENERIC_EXIT_NO_RECORDING_DATA;
+
+    QString url = pginfo.GetPlaybackURL(false, true);
+    if (!url.startsWith('/'))
+    {
+        cout << "ERROR - the recording is not on this host: "
+             << qPrintable(url) << endl;
+        return GENERIC_EXIT_NOT_OK;
+    }
+
+    QString filename = SeekIndex::GetFilename(url);
+    if (!SeekIndex::Import(pginfo, filename))
+    {
+        cout << "ERROR - could not read seek index "
+             << qPrintable(filename) << endl;
+        return GENERIC_EXIT_NOT_OK;
+    }
+
+    cout << "Imported seek index for "
+         << qPrintable(CreateProgramInfoString(pginfo)) << endl;
+
+    return GENERIC_EXIT_OK;
+}
+
 void registerRecordingUtils(UtilMap &utilMap)
 {
     utilMap["checkrecordings"]         = &CheckRecordings;
+    utilMap["importseekindex"]         = &ImportSeekIndex;
 }
 
 /* vim: set expandtab tabstop=4 shiftwidth=4: */